@@ -1,15 +1,26 @@
 use std::{
+    alloc::{GlobalAlloc, Layout, System},
     collections::BTreeMap,
     env, fs,
+    hint::black_box,
+    os::raw::c_void,
     path::{Path, PathBuf},
-    str,
+    process, str,
+    sync::atomic::{AtomicUsize, Ordering::Relaxed},
     time::Instant,
 };
 
 use anyhow::Context;
 use lazy_static::lazy_static;
-use tree_sitter::{Language, Parser, Query};
+use serde::{Deserialize, Serialize};
+use tree_sitter::{Language, Parser, Query, QueryCursor, Tree};
+use tree_sitter_cli::{
+    fuzz::{edits::get_random_edit, random::Rand},
+    parse::perform_edit,
+};
+use tree_sitter_highlight::{HighlightConfiguration, Highlighter};
 use tree_sitter_loader::{CompileConfig, Loader};
+use tree_sitter_tags::{TagsConfiguration, TagsContext};
 
 include!("../src/tests/helpers/dirs.rs");
 
@@ -21,6 +32,20 @@ lazy_static! {
     static ref REPETITION_COUNT: usize = env::var("TREE_SITTER_BENCHMARK_REPETITION_COUNT")
         .map(|s| s.parse::<usize>().unwrap())
         .unwrap_or(5);
+    static ref WARMUP_COUNT: usize = env::var("TREE_SITTER_BENCHMARK_WARMUP_COUNT")
+        .map(|s| s.parse::<usize>().unwrap())
+        .unwrap_or(1);
+    static ref EDIT_COUNT: usize = env::var("TREE_SITTER_BENCHMARK_EDIT_COUNT")
+        .map(|s| s.parse::<usize>().unwrap())
+        .unwrap_or(10);
+    static ref JSON_OUTPUT_PATH: Option<PathBuf> =
+        env::var_os("TREE_SITTER_BENCHMARK_JSON_OUTPUT").map(PathBuf::from);
+    static ref BASELINE_PATH: Option<PathBuf> =
+        env::var_os("TREE_SITTER_BENCHMARK_BASELINE").map(PathBuf::from);
+    static ref MAX_REGRESSION_PERCENT: f64 =
+        env::var("TREE_SITTER_BENCHMARK_MAX_REGRESSION_PERCENT")
+            .map(|s| s.parse::<f64>().unwrap())
+            .unwrap_or(10.0);
     static ref TEST_LOADER: Loader = Loader::with_parser_lib_path(SCRATCH_DIR.clone());
     static ref EXAMPLE_AND_QUERY_PATHS_BY_LANGUAGE_DIR: BTreeMap<PathBuf, (Vec<PathBuf>, Vec<PathBuf>)> = {
         fn process_dir(result: &mut BTreeMap<PathBuf, (Vec<PathBuf>, Vec<PathBuf>)>, dir: &Path) {
@@ -66,7 +91,157 @@ lazy_static! {
     };
 }
 
+// The allocations made by both the Rust code and the C library are counted, so that each
+// benchmark can report how many allocations it makes, and how much memory it uses at most.
+static ALLOCATION_COUNT: AtomicUsize = AtomicUsize::new(0);
+static ALLOCATED_BYTES: AtomicUsize = AtomicUsize::new(0);
+static PEAK_ALLOCATED_BYTES: AtomicUsize = AtomicUsize::new(0);
+
+fn record_alloc(size: usize) {
+    ALLOCATION_COUNT.fetch_add(1, Relaxed);
+    let allocated_bytes = ALLOCATED_BYTES.fetch_add(size, Relaxed) + size;
+    PEAK_ALLOCATED_BYTES.fetch_max(allocated_bytes, Relaxed);
+}
+
+fn record_dealloc(size: usize) {
+    ALLOCATED_BYTES.fetch_sub(size, Relaxed);
+}
+
+struct CountingAllocator;
+
+#[global_allocator]
+static GLOBAL_ALLOCATOR: CountingAllocator = CountingAllocator;
+
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        let result = System.alloc(layout);
+        if !result.is_null() {
+            record_alloc(layout.size());
+        }
+        result
+    }
+
+    unsafe fn alloc_zeroed(&self, layout: Layout) -> *mut u8 {
+        let result = System.alloc_zeroed(layout);
+        if !result.is_null() {
+            record_alloc(layout.size());
+        }
+        result
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        let result = System.realloc(ptr, layout, new_size);
+        if !result.is_null() {
+            record_dealloc(layout.size());
+            record_alloc(new_size);
+        }
+        result
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout);
+        record_dealloc(layout.size());
+    }
+}
+
+// The C library's `free` doesn't receive the size of the allocation, so each allocation is
+// prefixed with its size. The prefix is as large as `malloc`'s alignment, so that the
+// allocations stay aligned.
+const ALLOCATION_PREFIX_SIZE: usize = 16;
+
+extern "C" {
+    fn malloc(size: usize) -> *mut c_void;
+    fn realloc(ptr: *mut c_void, size: usize) -> *mut c_void;
+    fn free(ptr: *mut c_void);
+}
+
+unsafe extern "C" fn ts_counting_malloc(size: usize) -> *mut c_void {
+    let result = malloc(size + ALLOCATION_PREFIX_SIZE).cast::<usize>();
+    if result.is_null() {
+        return result.cast();
+    }
+    *result = size;
+    record_alloc(size);
+    result.cast::<u8>().add(ALLOCATION_PREFIX_SIZE).cast()
+}
+
+unsafe extern "C" fn ts_counting_calloc(count: usize, size: usize) -> *mut c_void {
+    let size = count * size;
+    let result = ts_counting_malloc(size);
+    if !result.is_null() {
+        result.cast::<u8>().write_bytes(0, size);
+    }
+    result
+}
+
+unsafe extern "C" fn ts_counting_realloc(ptr: *mut c_void, size: usize) -> *mut c_void {
+    if ptr.is_null() {
+        return ts_counting_malloc(size);
+    }
+    let allocation = ptr.cast::<u8>().sub(ALLOCATION_PREFIX_SIZE);
+    let old_size = *allocation.cast::<usize>();
+    let result = realloc(allocation.cast(), size + ALLOCATION_PREFIX_SIZE).cast::<usize>();
+    if result.is_null() {
+        return result.cast();
+    }
+    *result = size;
+    record_dealloc(old_size);
+    record_alloc(size);
+    result.cast::<u8>().add(ALLOCATION_PREFIX_SIZE).cast()
+}
+
+unsafe extern "C" fn ts_counting_free(ptr: *mut c_void) {
+    if ptr.is_null() {
+        return;
+    }
+    let allocation = ptr.cast::<u8>().sub(ALLOCATION_PREFIX_SIZE);
+    record_dealloc(*allocation.cast::<usize>());
+    free(allocation.cast());
+}
+
+#[derive(Serialize, Deserialize)]
+struct Report {
+    repetition_count: usize,
+    warmup_count: usize,
+    results: Vec<BenchmarkResult>,
+}
+
+#[derive(Serialize, Deserialize)]
+struct BenchmarkResult {
+    language: String,
+    benchmark: String,
+    input: String,
+    bytes: usize,
+    nanoseconds: u64,
+    bytes_per_ms: usize,
+    allocations: usize,
+    peak_memory_bytes: usize,
+}
+
+/// A tree that was edited and then reparsed, along with the text that it was reparsed with.
+struct EditedTree {
+    input: Vec<u8>,
+    old_tree: Tree,
+    new_tree: Tree,
+}
+
+struct Benchmarks {
+    results: Vec<BenchmarkResult>,
+    max_path_length: usize,
+}
+
 fn main() {
+    // This must happen before the library allocates anything, because the allocations are
+    // prefixed with their size.
+    unsafe {
+        tree_sitter::set_allocator(
+            Some(ts_counting_malloc),
+            Some(ts_counting_calloc),
+            Some(ts_counting_realloc),
+            Some(ts_counting_free),
+        );
+    }
+
     let max_path_length = EXAMPLE_AND_QUERY_PATHS_BY_LANGUAGE_DIR
         .values()
         .flat_map(|(e, q)| {
@@ -77,11 +252,19 @@ fn main() {
         .max()
         .unwrap_or(0);
 
-    eprintln!("Benchmarking with {} repetitions", *REPETITION_COUNT);
+    eprintln!(
+        "Benchmarking with {} repetitions, after {} warmup runs",
+        *REPETITION_COUNT, *WARMUP_COUNT
+    );
 
+    let mut benchmarks = Benchmarks {
+        results: Vec::new(),
+        max_path_length,
+    };
     let mut parser = Parser::new();
-    let mut all_normal_speeds = Vec::new();
-    let mut all_error_speeds = Vec::new();
+    let mut query_cursor = QueryCursor::new();
+    let mut highlighter = Highlighter::new();
+    let mut tags_context = TagsContext::new();
 
     for (language_path, (example_paths, query_paths)) in
         EXAMPLE_AND_QUERY_PATHS_BY_LANGUAGE_DIR.iter()
@@ -97,81 +280,350 @@ fn main() {
         eprintln!("\nLanguage: {language_name}");
         let language = get_language(language_path);
         parser.set_language(&language).unwrap();
+        let first_result_index = benchmarks.results.len();
+
+        let examples = example_paths
+            .iter()
+            .filter(|path| is_selected(path))
+            .map(|path| (path, read(path)))
+            .collect::<Vec<_>>();
+        let queries = query_paths
+            .iter()
+            .map(|path| (path, read(path)))
+            .collect::<Vec<_>>();
+        let trees = examples
+            .iter()
+            .map(|(_, code)| parser.parse(code, None).expect("Failed to parse"))
+            .collect::<Vec<_>>();
 
         eprintln!("  Constructing Queries");
-        for path in query_paths {
-            if let Some(filter) = EXAMPLE_FILTER.as_ref() {
-                if !path.to_str().unwrap().contains(filter.as_str()) {
-                    continue;
-                }
+        for (path, source) in &queries {
+            if !is_selected(path) {
+                continue;
             }
 
-            parse(path, max_path_length, |source| {
-                Query::new(&language, str::from_utf8(source).unwrap())
-                    .with_context(|| format!("Query file path: {path:?}"))
-                    .expect("Failed to parse query");
-            });
+            benchmarks.run(
+                language_name,
+                "query-construction",
+                path,
+                source.len(),
+                || {
+                    Query::new(&language, str::from_utf8(source).unwrap())
+                        .with_context(|| format!("Query file path: {path:?}"))
+                        .expect("Failed to parse query");
+                },
+            );
         }
 
         eprintln!("  Parsing Valid Code:");
-        let mut normal_speeds = Vec::new();
-        for example_path in example_paths {
-            if let Some(filter) = EXAMPLE_FILTER.as_ref() {
-                if !example_path.to_str().unwrap().contains(filter.as_str()) {
-                    continue;
-                }
-            }
-
-            normal_speeds.push(parse(example_path, max_path_length, |code| {
+        for (path, code) in &examples {
+            benchmarks.run(language_name, "parse", path, code.len(), || {
                 parser.parse(code, None).expect("Failed to parse");
-            }));
+            });
+        }
+
+        // Tokens that are too large to be stored inline each need an allocation of their own.
+        parser.set_stats_enabled(true);
+        let (mut heap_tokens, mut lexed_tokens) = (0, 0);
+        for (_, code) in &examples {
+            parser.parse(code, None).expect("Failed to parse");
+            let stats = parser.stats();
+            heap_tokens += stats.heap_tokens;
+            lexed_tokens += stats.lexed_tokens;
+        }
+        parser.set_stats_enabled(false);
+        if lexed_tokens > 0 {
+            eprintln!(
+                "  Heap-allocated tokens: {heap_tokens} of {lexed_tokens} ({:.1}%)",
+                heap_tokens as f64 * 100.0 / lexed_tokens as f64
+            );
         }
 
         eprintln!("  Parsing Invalid Code (mismatched languages):");
-        let mut error_speeds = Vec::new();
         for (other_language_path, (example_paths, _)) in
             EXAMPLE_AND_QUERY_PATHS_BY_LANGUAGE_DIR.iter()
         {
             if other_language_path != language_path {
                 for example_path in example_paths {
-                    if let Some(filter) = EXAMPLE_FILTER.as_ref() {
-                        if !example_path.to_str().unwrap().contains(filter.as_str()) {
-                            continue;
-                        }
+                    if !is_selected(example_path) {
+                        continue;
                     }
 
-                    error_speeds.push(parse(example_path, max_path_length, |code| {
-                        parser.parse(code, None).expect("Failed to parse");
-                    }));
+                    let code = read(example_path);
+                    benchmarks.run(
+                        language_name,
+                        "parse-errors",
+                        example_path,
+                        code.len(),
+                        || {
+                            parser.parse(&code, None).expect("Failed to parse");
+                        },
+                    );
                 }
             }
         }
 
-        if let Some((average_normal, worst_normal)) = aggregate(&normal_speeds) {
-            eprintln!("  Average Speed (normal): {average_normal} bytes/ms");
-            eprintln!("  Worst Speed (normal):   {worst_normal} bytes/ms");
+        // Every example is edited in the same random way on every run, so that the results
+        // can be compared between runs.
+        let edited_trees = examples
+            .iter()
+            .map(|(_, code)| edit_randomly(&mut parser, code))
+            .collect::<Vec<_>>();
+
+        eprintln!("  Reparsing After {} Random Edits:", *EDIT_COUNT);
+        for ((path, _), edited_trees) in examples.iter().zip(&edited_trees) {
+            let byte_count = edited_trees.iter().map(|t| t.input.len()).sum();
+            benchmarks.run(language_name, "reparse", path, byte_count, || {
+                for edited_tree in edited_trees {
+                    parser
+                        .parse(&edited_tree.input, Some(&edited_tree.old_tree))
+                        .expect("Failed to parse");
+                }
+            });
+        }
+
+        eprintln!("  Computing Changed Ranges:");
+        for ((path, _), edited_trees) in examples.iter().zip(&edited_trees) {
+            let byte_count = edited_trees.iter().map(|t| t.input.len()).sum();
+            benchmarks.run(language_name, "changed-ranges", path, byte_count, || {
+                for edited_tree in edited_trees {
+                    black_box(
+                        edited_tree
+                            .old_tree
+                            .changed_ranges(&edited_tree.new_tree)
+                            .count(),
+                    );
+                }
+            });
+        }
+
+        eprintln!("  Traversing Trees With Cursors:");
+        for ((path, code), tree) in examples.iter().zip(&trees) {
+            benchmarks.run(language_name, "cursor-traversal", path, code.len(), || {
+                black_box(traverse(tree));
+            });
+        }
+
+        for (query_path, query_source) in &queries {
+            let query = Query::new(&language, str::from_utf8(query_source).unwrap()).unwrap();
+            let query_name = query_path.file_name().unwrap().to_str().unwrap();
+
+            eprintln!("  Executing Query {query_name} (matches):");
+            for ((path, code), tree) in examples.iter().zip(&trees) {
+                let benchmark = format!("query-matches:{query_name}");
+                benchmarks.run(language_name, &benchmark, path, code.len(), || {
+                    let matches = query_cursor.matches(&query, tree.root_node(), code.as_slice());
+                    black_box(matches.count());
+                });
+            }
+
+            eprintln!("  Executing Query {query_name} (captures):");
+            for ((path, code), tree) in examples.iter().zip(&trees) {
+                let benchmark = format!("query-captures:{query_name}");
+                benchmarks.run(language_name, &benchmark, path, code.len(), || {
+                    let captures = query_cursor.captures(&query, tree.root_node(), code.as_slice());
+                    black_box(captures.count());
+                });
+            }
+        }
+
+        let query_source = |name: &str| {
+            queries
+                .iter()
+                .find(|(path, _)| path.file_name().unwrap() == name)
+                .map(|(_, source)| str::from_utf8(source).unwrap())
+        };
+
+        if let Some(highlights_query) = query_source("highlights.scm") {
+            let mut config = HighlightConfiguration::new(
+                language.clone(),
+                language_name,
+                highlights_query,
+                query_source("injections.scm").unwrap_or_default(),
+                query_source("locals.scm").unwrap_or_default(),
+            )
+            .with_context(|| format!("Highlight queries for {language_name}"))
+            .expect("Failed to parse highlight queries");
+            let highlight_names = config
+                .names()
+                .iter()
+                .map(|name| (*name).to_string())
+                .collect::<Vec<_>>();
+            config.configure(&highlight_names);
+
+            eprintln!("  Highlighting:");
+            for (path, code) in &examples {
+                benchmarks.run(language_name, "highlight", path, code.len(), || {
+                    for event in highlighter
+                        .highlight(&config, code, None, |_| None)
+                        .unwrap()
+                    {
+                        black_box(event.unwrap());
+                    }
+                });
+            }
         }
 
-        if let Some((average_error, worst_error)) = aggregate(&error_speeds) {
-            eprintln!("  Average Speed (errors): {average_error} bytes/ms");
-            eprintln!("  Worst Speed (errors):   {worst_error} bytes/ms");
+        if let Some(tags_query) = query_source("tags.scm") {
+            let config = TagsConfiguration::new(
+                language.clone(),
+                tags_query,
+                query_source("locals.scm").unwrap_or_default(),
+            )
+            .with_context(|| format!("Tags queries for {language_name}"))
+            .expect("Failed to parse tags queries");
+
+            eprintln!("  Tagging:");
+            for (path, code) in &examples {
+                benchmarks.run(language_name, "tags", path, code.len(), || {
+                    let (tags, _) = tags_context.generate_tags(&config, code, None).unwrap();
+                    for tag in tags {
+                        black_box(tag.unwrap());
+                    }
+                });
+            }
         }
 
-        all_normal_speeds.extend(normal_speeds);
-        all_error_speeds.extend(error_speeds);
+        print_aggregates(&benchmarks.results[first_result_index..]);
     }
 
     eprintln!("\n  Overall");
-    if let Some((average_normal, worst_normal)) = aggregate(&all_normal_speeds) {
-        eprintln!("  Average Speed (normal): {average_normal} bytes/ms");
-        eprintln!("  Worst Speed (normal):   {worst_normal} bytes/ms");
+    print_aggregates(&benchmarks.results);
+    eprintln!();
+
+    let report = Report {
+        repetition_count: *REPETITION_COUNT,
+        warmup_count: *WARMUP_COUNT,
+        results: benchmarks.results,
+    };
+
+    if let Some(path) = JSON_OUTPUT_PATH.as_ref() {
+        fs::write(path, serde_json::to_string_pretty(&report).unwrap())
+            .with_context(|| format!("Failed to write {path:?}"))
+            .unwrap();
+        eprintln!("Wrote results to {path:?}");
     }
 
-    if let Some((average_error, worst_error)) = aggregate(&all_error_speeds) {
-        eprintln!("  Average Speed (errors): {average_error} bytes/ms");
-        eprintln!("  Worst Speed (errors):   {worst_error} bytes/ms");
+    if let Some(path) = BASELINE_PATH.as_ref() {
+        let baseline = fs::read_to_string(path)
+            .with_context(|| format!("Failed to read {path:?}"))
+            .unwrap();
+        let baseline: Report = serde_json::from_str(&baseline)
+            .with_context(|| format!("Failed to parse {path:?}"))
+            .unwrap();
+        if !compare(&baseline, &report) {
+            process::exit(1);
+        }
     }
-    eprintln!();
+}
+
+impl Benchmarks {
+    fn run(
+        &mut self,
+        language: &str,
+        benchmark: &str,
+        path: &Path,
+        byte_count: usize,
+        mut action: impl FnMut(),
+    ) {
+        let input = path.file_name().unwrap().to_str().unwrap();
+        eprint!("    {input:width$}\t", width = self.max_path_length);
+
+        for _ in 0..*WARMUP_COUNT {
+            action();
+        }
+
+        let allocation_count = ALLOCATION_COUNT.load(Relaxed);
+        let allocated_bytes = ALLOCATED_BYTES.load(Relaxed);
+        PEAK_ALLOCATED_BYTES.store(allocated_bytes, Relaxed);
+        let time = Instant::now();
+        for _ in 0..*REPETITION_COUNT {
+            action();
+        }
+        let duration = time.elapsed() / (*REPETITION_COUNT as u32);
+        let allocations = (ALLOCATION_COUNT.load(Relaxed) - allocation_count) / *REPETITION_COUNT;
+        let peak_memory_bytes = PEAK_ALLOCATED_BYTES.load(Relaxed) - allocated_bytes;
+
+        let duration_ns = duration.as_nanos().max(1);
+        let speed = ((byte_count as u128) * 1_000_000) / duration_ns;
+        eprintln!(
+            "time {:>7.2} ms\t\tspeed {speed:>6} bytes/ms\t\t{allocations:>7} allocations\t\tpeak {:>8.1} KiB",
+            (duration_ns as f64) / 1e6,
+            (peak_memory_bytes as f64) / 1024.0,
+        );
+
+        self.results.push(BenchmarkResult {
+            language: language.to_string(),
+            benchmark: benchmark.to_string(),
+            input: input.to_string(),
+            bytes: byte_count,
+            nanoseconds: duration_ns as u64,
+            bytes_per_ms: speed as usize,
+            allocations,
+            peak_memory_bytes,
+        });
+    }
+}
+
+/// Print the average and worst speed of each kind of benchmark.
+fn print_aggregates(results: &[BenchmarkResult]) {
+    let mut speeds_by_benchmark = BTreeMap::<&str, Vec<usize>>::new();
+    for result in results {
+        speeds_by_benchmark
+            .entry(&result.benchmark)
+            .or_default()
+            .push(result.bytes_per_ms);
+    }
+    for (benchmark, speeds) in speeds_by_benchmark {
+        if let Some((average, worst)) = aggregate(&speeds) {
+            eprintln!("  Average Speed ({benchmark}): {average} bytes/ms");
+            eprintln!("  Worst Speed ({benchmark}):   {worst} bytes/ms");
+        }
+    }
+}
+
+/// Compare the average speed of each kind of benchmark for each language with a baseline,
+/// over the inputs that were benchmarked in both runs. Returns false if any of them became
+/// slower than the allowed regression.
+fn compare(baseline: &Report, report: &Report) -> bool {
+    let baseline_speeds = baseline
+        .results
+        .iter()
+        .map(|r| ((&r.language, &r.benchmark, &r.input), r.bytes_per_ms))
+        .collect::<BTreeMap<_, _>>();
+    let mut speeds = BTreeMap::<(&str, &str), (Vec<usize>, Vec<usize>)>::new();
+    for result in &report.results {
+        let key = (&result.language, &result.benchmark, &result.input);
+        if let Some(baseline_speed) = baseline_speeds.get(&key) {
+            let (baseline_speeds, new_speeds) = speeds
+                .entry((result.language.as_str(), result.benchmark.as_str()))
+                .or_default();
+            baseline_speeds.push(*baseline_speed);
+            new_speeds.push(result.bytes_per_ms);
+        }
+    }
+
+    eprintln!(
+        "Comparing with the baseline, allowing a {}% regression",
+        *MAX_REGRESSION_PERCENT
+    );
+    let mut passed = true;
+    for ((language, benchmark), (baseline_speeds, new_speeds)) in speeds {
+        let (baseline_speed, _) = aggregate(&baseline_speeds).unwrap();
+        let (new_speed, _) = aggregate(&new_speeds).unwrap();
+        let change = if baseline_speed == 0 {
+            0.0
+        } else {
+            (new_speed as f64 / baseline_speed as f64 - 1.0) * 100.0
+        };
+        let regressed = change < -*MAX_REGRESSION_PERCENT;
+        eprintln!(
+            "  {}{language} {benchmark}: {baseline_speed} -> {new_speed} bytes/ms ({change:+.1}%)",
+            if regressed { "REGRESSION " } else { "" },
+        );
+        passed &= !regressed;
+    }
+    passed
 }
 
 fn aggregate(speeds: &[usize]) -> Option<(usize, usize)> {
@@ -189,28 +641,59 @@ fn aggregate(speeds: &[usize]) -> Option<(usize, usize)> {
     Some((total / speeds.len(), max))
 }
 
-fn parse(path: &Path, max_path_length: usize, mut action: impl FnMut(&[u8])) -> usize {
-    eprint!(
-        "    {:width$}\t",
-        path.file_name().unwrap().to_str().unwrap(),
-        width = max_path_length
-    );
+fn is_selected(path: &Path) -> bool {
+    EXAMPLE_FILTER.as_ref().map_or(true, |filter| {
+        path.to_str().unwrap().contains(filter.as_str())
+    })
+}
 
-    let source_code = fs::read(path)
+fn read(path: &Path) -> Vec<u8> {
+    fs::read(path)
         .with_context(|| format!("Failed to read {path:?}"))
-        .unwrap();
-    let time = Instant::now();
-    for _ in 0..*REPETITION_COUNT {
-        action(&source_code);
-    }
-    let duration = time.elapsed() / (*REPETITION_COUNT as u32);
-    let duration_ns = duration.as_nanos();
-    let speed = ((source_code.len() as u128) * 1_000_000) / duration_ns;
-    eprintln!(
-        "time {:>7.2} ms\t\tspeed {speed:>6} bytes/ms",
-        (duration_ns as f64) / 1e6,
-    );
-    speed as usize
+        .unwrap()
+}
+
+/// Apply a sequence of random edits to some code, reparsing it after each one.
+fn edit_randomly(parser: &mut Parser, code: &[u8]) -> Vec<EditedTree> {
+    let mut rand = Rand::new(0);
+    let mut input = code.to_vec();
+    let mut tree = parser.parse(&input, None).expect("Failed to parse");
+    let mut result = Vec::with_capacity(*EDIT_COUNT);
+    for _ in 0..*EDIT_COUNT {
+        let edit = get_random_edit(&mut rand, &input);
+        let mut old_tree = tree.clone();
+        perform_edit(&mut old_tree, &mut input, &edit).unwrap();
+        tree = parser
+            .parse(&input, Some(&old_tree))
+            .expect("Failed to parse");
+        result.push(EditedTree {
+            input: input.clone(),
+            old_tree,
+            new_tree: tree.clone(),
+        });
+    }
+    result
+}
+
+/// Visit every node of a tree with a tree cursor, and return the number of nodes.
+fn traverse(tree: &Tree) -> usize {
+    let mut cursor = tree.walk();
+    let mut count = 1;
+    loop {
+        if cursor.goto_first_child() || cursor.goto_next_sibling() {
+            count += 1;
+            continue;
+        }
+        loop {
+            if !cursor.goto_parent() {
+                return count;
+            }
+            if cursor.goto_next_sibling() {
+                count += 1;
+                break;
+            }
+        }
+    }
 }
 
 fn get_language(path: &Path) -> Language {
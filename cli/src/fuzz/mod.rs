@@ -8,6 +8,7 @@ use tree_sitter::{Language, Parser};
 pub mod allocations;
 pub mod corpus_test;
 pub mod edits;
+pub mod perf;
 pub mod random;
 pub mod scope_sequence;
 
@@ -68,52 +69,16 @@ pub fn fuzz_language_corpus(
     grammar_dir: &Path,
     options: &mut FuzzOptions,
 ) {
-    fn retain(entry: &mut TestEntry, language_name: &str) -> bool {
-        match entry {
-            TestEntry::Example { attributes, .. } => {
-                attributes.languages[0].is_empty()
-                    || attributes
-                        .languages
-                        .iter()
-                        .any(|lang| lang.as_ref() == language_name)
-            }
-            TestEntry::Group {
-                ref mut children, ..
-            } => {
-                children.retain_mut(|child| retain(child, language_name));
-                !children.is_empty()
-            }
-        }
-    }
-
-    let subdir = options.subdir.take().unwrap_or_default();
-
-    let corpus_dir = grammar_dir.join(subdir).join("test").join("corpus");
-
-    if !corpus_dir.exists() || !corpus_dir.is_dir() {
-        eprintln!("No corpus directory found, ensure that you have a `test/corpus` directory in your grammar directory with at least one test file.");
-        return;
-    }
-
-    if std::fs::read_dir(&corpus_dir).unwrap().count() == 0 {
-        eprintln!("No corpus files found in `test/corpus`, ensure that you have at least one test file in your corpus directory.");
-        return;
-    }
-
-    let mut main_tests = parse_tests(&corpus_dir).unwrap();
-    match main_tests {
-        TestEntry::Group {
-            ref mut children, ..
-        } => {
-            children.retain_mut(|child| retain(child, language_name));
-        }
-        TestEntry::Example { .. } => unreachable!(),
-    }
-    let tests = flatten_tests(
-        main_tests,
+    let subdir = options.subdir.take();
+    let Some(tests) = load_corpus_tests(
+        language_name,
+        grammar_dir,
+        subdir.as_deref(),
         options.include.as_ref(),
         options.exclude.as_ref(),
-    );
+    ) else {
+        return;
+    };
 
     let mut skipped = options.skipped.as_ref().map(|x| {
         x.iter()
@@ -292,6 +257,61 @@ pub fn fuzz_language_corpus(
     }
 }
 
+/// Load the corpus tests of the grammar in `grammar_dir` that apply to the
+/// given language. If the grammar has no corpus, print why and return `None`.
+#[must_use]
+pub fn load_corpus_tests(
+    language_name: &str,
+    grammar_dir: &Path,
+    subdir: Option<&str>,
+    include: Option<&Regex>,
+    exclude: Option<&Regex>,
+) -> Option<Vec<FlattenedTest>> {
+    fn retain(entry: &mut TestEntry, language_name: &str) -> bool {
+        match entry {
+            TestEntry::Example { attributes, .. } => {
+                attributes.languages[0].is_empty()
+                    || attributes
+                        .languages
+                        .iter()
+                        .any(|lang| lang.as_ref() == language_name)
+            }
+            TestEntry::Group {
+                ref mut children, ..
+            } => {
+                children.retain_mut(|child| retain(child, language_name));
+                !children.is_empty()
+            }
+        }
+    }
+
+    let corpus_dir = grammar_dir
+        .join(subdir.unwrap_or_default())
+        .join("test")
+        .join("corpus");
+
+    if !corpus_dir.exists() || !corpus_dir.is_dir() {
+        eprintln!("No corpus directory found, ensure that you have a `test/corpus` directory in your grammar directory with at least one test file.");
+        return None;
+    }
+
+    if std::fs::read_dir(&corpus_dir).unwrap().count() == 0 {
+        eprintln!("No corpus files found in `test/corpus`, ensure that you have at least one test file in your corpus directory.");
+        return None;
+    }
+
+    let mut main_tests = parse_tests(&corpus_dir).unwrap();
+    match main_tests {
+        TestEntry::Group {
+            ref mut children, ..
+        } => {
+            children.retain_mut(|child| retain(child, language_name));
+        }
+        TestEntry::Example { .. } => unreachable!(),
+    }
+    Some(flatten_tests(main_tests, include, exclude))
+}
+
 pub struct FlattenedTest {
     pub name: String,
     pub input: Vec<u8>,
@@ -0,0 +1,271 @@
+use std::{fmt::Write as _, fs, path::Path};
+
+use anyhow::{anyhow, Context, Result};
+use regex::Regex;
+use tree_sitter::{Language, Parser, Query, QueryCursor};
+
+use super::{edits::get_random_edit, load_corpus_tests, random::Rand};
+
+pub struct PerfFuzzOptions {
+    pub subdir: Option<String>,
+    pub edits: usize,
+    pub iterations: usize,
+    pub include: Option<Regex>,
+    pub exclude: Option<Regex>,
+    pub query_path: Option<String>,
+    pub multiple: f64,
+    pub min_bytes: usize,
+    pub output_dir: String,
+}
+
+/// The deterministic cost of processing one input, in operations per byte.
+#[derive(Clone, Copy, Debug, Default)]
+pub struct Cost {
+    pub parse: f64,
+    pub query: f64,
+}
+
+/// The kind of work whose cost exceeded the limit for an input.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+enum CostKind {
+    Parse,
+    Query,
+}
+
+impl CostKind {
+    const fn name(self) -> &'static str {
+        match self {
+            Self::Parse => "parse",
+            Self::Query => "query",
+        }
+    }
+}
+
+struct CostMeter<'a> {
+    parser: Parser,
+    query: Option<&'a Query>,
+    cursor: QueryCursor,
+}
+
+impl<'a> CostMeter<'a> {
+    fn new(language: &Language, query: Option<&'a Query>) -> Self {
+        let mut parser = Parser::new();
+        parser.set_language(language).unwrap();
+        parser.set_stats_enabled(true);
+        Self {
+            parser,
+            query,
+            cursor: QueryCursor::new(),
+        }
+    }
+
+    /// Parse the input from scratch and run the query over the resulting tree,
+    /// counting the operations that each one performs.
+    fn measure(&mut self, input: &[u8]) -> Cost {
+        let byte_count = input.len().max(1) as f64;
+        let tree = self.parser.parse(input, None).unwrap();
+        let parse = self.parser.stats().operations as f64 / byte_count;
+        let query = self.query.map_or(0.0, |query| {
+            for _ in self.cursor.captures(query, tree.root_node(), input) {}
+            self.cursor.operation_count() as f64 / byte_count
+        });
+        Cost { parse, query }
+    }
+}
+
+/// Search for inputs that are pathologically expensive to parse or query.
+///
+/// The corpus examples establish a baseline: the median cost per byte of
+/// parsing each example, and of running the query on it. Each example is
+/// then randomly edited, and any edited input whose cost per byte exceeds
+/// `multiple` times the baseline is minimized while it stays that expensive,
+/// and written to the output directory along with the baseline, so that it
+/// can be replayed with the `perf` fuzzing harness.
+pub fn fuzz_language_performance(
+    language: &Language,
+    language_name: &str,
+    start_seed: usize,
+    grammar_dir: &Path,
+    options: &mut PerfFuzzOptions,
+) -> Result<()> {
+    let subdir = options.subdir.take();
+    let Some(tests) = load_corpus_tests(
+        language_name,
+        grammar_dir,
+        subdir.as_deref(),
+        options.include.as_ref(),
+        options.exclude.as_ref(),
+    ) else {
+        return Ok(());
+    };
+
+    let query_path = options.query_path.as_ref().map_or_else(
+        || {
+            grammar_dir
+                .join(subdir.unwrap_or_default())
+                .join("queries")
+                .join("highlights.scm")
+        },
+        |path| Path::new(path).to_path_buf(),
+    );
+    let query = if query_path.is_file() {
+        let source = fs::read_to_string(&query_path)
+            .with_context(|| format!("Failed to read {}", query_path.display()))?;
+        let query = Query::new(language, &source)
+            .with_context(|| format!("Failed to compile {}", query_path.display()))?;
+        Some(query)
+    } else if options.query_path.is_some() {
+        return Err(anyhow!("Query file {} not found", query_path.display()));
+    } else {
+        None
+    };
+
+    let mut meter = CostMeter::new(language, query.as_ref());
+    let mut parse_costs = Vec::with_capacity(tests.len());
+    let mut query_costs = Vec::with_capacity(tests.len());
+    for test in &tests {
+        if test.input.len() >= options.min_bytes {
+            let cost = meter.measure(&test.input);
+            parse_costs.push(cost.parse);
+            query_costs.push(cost.query);
+        }
+    }
+    if parse_costs.is_empty() {
+        eprintln!(
+            "No corpus examples are at least {} bytes long, so there is no baseline to compare against.",
+            options.min_bytes
+        );
+        return Ok(());
+    }
+    let baseline = Cost {
+        parse: median(&mut parse_costs),
+        query: median(&mut query_costs),
+    };
+    let limit = Cost {
+        parse: baseline.parse * options.multiple,
+        query: baseline.query * options.multiple,
+    };
+
+    println!(
+        "  baseline: {:.2} parse operations and {:.2} query operations per byte",
+        baseline.parse, baseline.query
+    );
+    println!("  start seed: {start_seed}");
+    println!();
+
+    let output_dir = Path::new(&options.output_dir).join(language_name);
+    let mut flagged_count = 0;
+    for (test_index, test) in tests.iter().enumerate() {
+        println!("  {test_index}. {language_name} - {}", test.name);
+
+        for trial in 0..options.iterations {
+            let seed = start_seed + trial;
+            let mut rand = Rand::new(seed);
+            let mut input = test.input.clone();
+            for _ in 0..=rand.unsigned(options.edits) {
+                let edit = get_random_edit(&mut rand, &input);
+                input.splice(
+                    edit.position..edit.position + edit.deleted_length,
+                    edit.inserted_text,
+                );
+            }
+
+            let Some(kind) = exceeded_limit(&mut meter, &input, limit, options.min_bytes) else {
+                continue;
+            };
+            let input = minimize(&mut meter, input, kind, limit, options.min_bytes);
+            let cost = meter.measure(&input);
+            let (cost, baseline_cost) = match kind {
+                CostKind::Parse => (cost.parse, baseline.parse),
+                CostKind::Query => (cost.query, baseline.query),
+            };
+
+            fs::create_dir_all(&output_dir)?;
+            let path = output_dir.join(format!("{}-{test_index}-{seed}", kind.name()));
+            fs::write(&path, &input)?;
+            println!(
+                "    seed {seed}: {:.2} {} operations per byte, {:.1} times the baseline, in {} bytes: {}",
+                cost,
+                kind.name(),
+                cost / baseline_cost,
+                input.len(),
+                path.display()
+            );
+            flagged_count += 1;
+        }
+    }
+
+    if flagged_count == 0 {
+        println!(
+            "\nNo inputs exceeded {} times the baseline",
+            options.multiple
+        );
+        return Ok(());
+    }
+
+    // Record the limits in the form the fuzzing harness reads them, so that
+    // the saved inputs can be reproduced outside of this command.
+    let mut environment = String::new();
+    writeln!(environment, "TS_PERF_PARSE_BASELINE={}", baseline.parse)?;
+    writeln!(environment, "TS_PERF_QUERY_BASELINE={}", baseline.query)?;
+    writeln!(environment, "TS_PERF_MULTIPLE={}", options.multiple)?;
+    writeln!(environment, "TS_PERF_MIN_BYTES={}", options.min_bytes)?;
+    fs::write(output_dir.join("baseline.env"), environment)?;
+
+    Err(anyhow!(
+        "{flagged_count} {language_name} inputs exceeded {} times the baseline cost, and were saved to {}",
+        options.multiple,
+        output_dir.display()
+    ))
+}
+
+fn median(values: &mut [f64]) -> f64 {
+    values.sort_unstable_by(f64::total_cmp);
+    values[values.len() / 2]
+}
+
+fn exceeded_limit(
+    meter: &mut CostMeter,
+    input: &[u8],
+    limit: Cost,
+    min_bytes: usize,
+) -> Option<CostKind> {
+    if input.len() < min_bytes {
+        return None;
+    }
+    let cost = meter.measure(input);
+    if cost.parse > limit.parse {
+        Some(CostKind::Parse)
+    } else if meter.query.is_some() && limit.query > 0.0 && cost.query > limit.query {
+        Some(CostKind::Query)
+    } else {
+        None
+    }
+}
+
+/// Shrink an input while it keeps exceeding the limit for the same kind of
+/// work, by repeatedly removing chunks of it, starting with large chunks and
+/// halving their size whenever no chunk can be removed.
+fn minimize(
+    meter: &mut CostMeter,
+    mut input: Vec<u8>,
+    kind: CostKind,
+    limit: Cost,
+    min_bytes: usize,
+) -> Vec<u8> {
+    let mut chunk_size = input.len() / 2;
+    while chunk_size > 0 {
+        let mut position = 0;
+        while position + chunk_size <= input.len() {
+            let mut candidate = input.clone();
+            candidate.drain(position..position + chunk_size);
+            if exceeded_limit(meter, &candidate, limit, min_bytes) == Some(kind) {
+                input = candidate;
+            } else {
+                position += chunk_size;
+            }
+        }
+        chunk_size /= 2;
+    }
+    input
+}
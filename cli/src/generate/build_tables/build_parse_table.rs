@@ -3,10 +3,14 @@ use std::{
     collections::{BTreeMap, HashMap, HashSet, VecDeque},
     fmt::Write,
     hash::BuildHasherDefault,
+    sync::atomic::{AtomicUsize, Ordering as AtomicOrdering},
+    thread,
+    time::{Duration, Instant},
 };
 
 use anyhow::{anyhow, Result};
 use indexmap::{map::Entry, IndexMap};
+use log::info;
 use rustc_hash::FxHasher;
 
 use super::{
@@ -25,6 +29,10 @@ use crate::generate::{
     },
 };
 
+// The number of queued parse states whose item set closures are computed
+// together, possibly on several threads, before their actions are added.
+const PARSE_STATE_BATCH_SIZE: usize = 256;
+
 // For conflict reporting, each parse state is associated with an example
 // sequence of symbols that could lead to that parse state.
 type SymbolSequence = Vec<Symbol>;
@@ -32,6 +40,13 @@ type SymbolSequence = Vec<Symbol>;
 type AuxiliarySymbolSequence = Vec<AuxiliarySymbolInfo>;
 pub type ParseStateInfo<'a> = (SymbolSequence, ParseItemSet<'a>);
 
+type BuildTableResult<'a> = (
+    ParseTable,
+    Vec<TokenSet>,
+    Vec<ParseStateInfo<'a>>,
+    Vec<String>,
+);
+
 #[derive(Clone, PartialEq)]
 struct AuxiliarySymbolInfo {
     auxiliary_symbol: Symbol,
@@ -52,6 +67,15 @@ struct ParseStateQueueEntry {
     preceding_auxiliary_symbols: AuxiliarySymbolSequence,
 }
 
+// The parts of a parse state's actions that only depend on its item set, and
+// can be computed independently for different states: the closure of its item
+// set, and the item sets of its successor states.
+struct ParseStateClosure<'a> {
+    item_set: ParseItemSet<'a>,
+    terminal_successors: BTreeMap<Symbol, ParseItemSet<'a>>,
+    non_terminal_successors: BTreeMap<Symbol, ParseItemSet<'a>>,
+}
+
 struct ParseTableBuilder<'a> {
     item_set_builder: ParseItemSetBuilder<'a>,
     syntax_grammar: &'a SyntaxGrammar,
@@ -64,10 +88,13 @@ struct ParseTableBuilder<'a> {
     non_terminal_extra_states: Vec<(Symbol, usize)>,
     actual_conflicts: HashSet<Vec<Symbol>>,
     parse_table: ParseTable,
+    conflict_duration: Duration,
 }
 
 impl<'a> ParseTableBuilder<'a> {
-    fn build(mut self) -> Result<(ParseTable, Vec<ParseStateInfo<'a>>)> {
+    /// Build the parse table. This also returns the names of the symbols in each of the
+    /// grammar's declared conflicts that turned out to be unnecessary.
+    fn build(mut self) -> Result<(ParseTable, Vec<ParseStateInfo<'a>>, Vec<String>)> {
         // Ensure that the empty alias sequence has index 0.
         self.parse_table
             .production_infos
@@ -120,34 +147,56 @@ impl<'a> ParseTableBuilder<'a> {
             self.add_parse_state(&Vec::new(), &Vec::new(), item_set);
         }
 
-        while let Some(entry) = self.parse_state_queue.pop_front() {
-            let item_set = self
-                .item_set_builder
-                .transitive_closure(&self.parse_state_info_by_id[entry.state_id].1);
-
-            self.add_actions(
-                self.parse_state_info_by_id[entry.state_id].0.clone(),
-                entry.preceding_auxiliary_symbols,
-                entry.state_id,
-                &item_set,
-            )?;
-        }
-
-        if !self.actual_conflicts.is_empty() {
-            println!("Warning: unnecessary conflicts");
-            for conflict in &self.actual_conflicts {
-                println!(
-                    "  {}",
-                    conflict
-                        .iter()
-                        .map(|symbol| format!("`{}`", self.symbol_name(symbol)))
-                        .collect::<Vec<_>>()
-                        .join(", ")
-                );
+        // Process the queued states in batches. The closures of a batch's item sets don't
+        // depend on each other, so they can be computed in parallel. The actions are then
+        // added in queue order, so that new states are numbered exactly as if every state
+        // were processed one at a time.
+        let thread_count = thread::available_parallelism().map_or(1, usize::from);
+        let mut closure_duration = Duration::ZERO;
+        while !self.parse_state_queue.is_empty() {
+            let batch_size = self.parse_state_queue.len().min(PARSE_STATE_BATCH_SIZE);
+            let batch = self
+                .parse_state_queue
+                .drain(..batch_size)
+                .collect::<Vec<_>>();
+
+            let start = Instant::now();
+            let closures = self.compute_closures(&batch, thread_count);
+            closure_duration += start.elapsed();
+
+            for (entry, closure) in batch.into_iter().zip(closures) {
+                self.add_actions(
+                    self.parse_state_info_by_id[entry.state_id].0.clone(),
+                    entry.preceding_auxiliary_symbols,
+                    entry.state_id,
+                    closure,
+                )?;
             }
         }
+        info!(
+            "computed item set closures for {} parse states in {closure_duration:?}",
+            self.parse_table.states.len()
+        );
+        info!("handled conflicts in {:?}", self.conflict_duration);
+
+        let mut unnecessary_conflicts = self
+            .actual_conflicts
+            .iter()
+            .map(|conflict| {
+                conflict
+                    .iter()
+                    .map(|symbol| format!("`{}`", self.symbol_name(symbol)))
+                    .collect::<Vec<_>>()
+                    .join(", ")
+            })
+            .collect::<Vec<_>>();
+        unnecessary_conflicts.sort_unstable();
 
-        Ok((self.parse_table, self.parse_state_info_by_id))
+        Ok((
+            self.parse_table,
+            self.parse_state_info_by_id,
+            unnecessary_conflicts,
+        ))
     }
 
     fn add_parse_state(
@@ -190,37 +239,69 @@ impl<'a> ParseTableBuilder<'a> {
         }
     }
 
-    fn add_actions(
-        &mut self,
-        mut preceding_symbols: SymbolSequence,
-        mut preceding_auxiliary_symbols: AuxiliarySymbolSequence,
-        state_id: ParseStateId,
-        item_set: &ParseItemSet<'a>,
-    ) -> Result<()> {
+    fn compute_closures(
+        &self,
+        batch: &[ParseStateQueueEntry],
+        thread_count: usize,
+    ) -> Vec<ParseStateClosure<'a>> {
+        let compute_closure = |entry: &ParseStateQueueEntry| {
+            self.compute_closure(&self.parse_state_info_by_id[entry.state_id].1)
+        };
+
+        let thread_count = thread_count.min(batch.len()).max(1);
+        if thread_count == 1 {
+            return batch.iter().map(compute_closure).collect();
+        }
+
+        let next_index = AtomicUsize::new(0);
+        let mut indexed_closures = thread::scope(|scope| {
+            let handles = (0..thread_count)
+                .map(|_| {
+                    let next_index = &next_index;
+                    let compute_closure = &compute_closure;
+                    scope.spawn(move || {
+                        let mut closures = Vec::new();
+                        loop {
+                            let index = next_index.fetch_add(1, AtomicOrdering::Relaxed);
+                            if index >= batch.len() {
+                                break;
+                            }
+                            closures.push((index, compute_closure(&batch[index])));
+                        }
+                        closures
+                    })
+                })
+                .collect::<Vec<_>>();
+            handles
+                .into_iter()
+                .flat_map(|handle| {
+                    handle
+                        .join()
+                        .unwrap_or_else(|e| std::panic::resume_unwind(e))
+                })
+                .collect::<Vec<_>>()
+        });
+        indexed_closures.sort_unstable_by_key(|(index, _)| *index);
+        indexed_closures
+            .into_iter()
+            .map(|(_, closure)| closure)
+            .collect()
+    }
+
+    fn compute_closure(&self, core_item_set: &ParseItemSet<'a>) -> ParseStateClosure<'a> {
+        let item_set = self.item_set_builder.transitive_closure(core_item_set);
         let mut terminal_successors = BTreeMap::new();
         let mut non_terminal_successors = BTreeMap::new();
-        let mut lookaheads_with_conflicts = TokenSet::new();
-        let mut reduction_infos = HashMap::<Symbol, ReductionInfo>::new();
 
-        // Each item in the item set contributes to either or a Shift action or a Reduce
-        // action in this state.
+        // If an item is unfinished, then this state has a transition for the item's
+        // next symbol. Advance the item to its next step and insert the resulting
+        // item into the successor item set.
         for (item, lookaheads) in &item_set.entries {
-            // If the item is unfinished, then this state has a transition for the item's
-            // next symbol. Advance the item to its next step and insert the resulting
-            // item into the successor item set.
             if let Some(next_symbol) = item.symbol() {
                 let mut successor = item.successor();
                 if next_symbol.is_non_terminal() {
                     let variable = &self.syntax_grammar.variables[next_symbol.index];
 
-                    // Keep track of where auxiliary non-terminals (repeat symbols) are
-                    // used within visible symbols. This information may be needed later
-                    // for conflict resolution.
-                    if variable.is_auxiliary() {
-                        preceding_auxiliary_symbols
-                            .push(self.get_auxiliary_node_info(item_set, next_symbol));
-                    }
-
                     // For most parse items, the symbols associated with the preceding children
                     // don't matter: they have no effect on the REDUCE action that would be
                     // performed at the end of the item. But the symbols *do* matter for
@@ -247,6 +328,46 @@ impl<'a> ParseTableBuilder<'a> {
                         .insert(successor, lookaheads);
                 }
             }
+        }
+
+        ParseStateClosure {
+            item_set,
+            terminal_successors,
+            non_terminal_successors,
+        }
+    }
+
+    fn add_actions(
+        &mut self,
+        mut preceding_symbols: SymbolSequence,
+        mut preceding_auxiliary_symbols: AuxiliarySymbolSequence,
+        state_id: ParseStateId,
+        closure: ParseStateClosure<'a>,
+    ) -> Result<()> {
+        let ParseStateClosure {
+            item_set,
+            terminal_successors,
+            non_terminal_successors,
+        } = closure;
+        let item_set = &item_set;
+        let mut lookaheads_with_conflicts = TokenSet::new();
+        let mut reduction_infos = HashMap::<Symbol, ReductionInfo>::new();
+
+        // Each item in the item set contributes to either or a Shift action or a Reduce
+        // action in this state. The successor item sets for the Shift actions have
+        // already been computed.
+        for (item, lookaheads) in &item_set.entries {
+            if let Some(next_symbol) = item.symbol() {
+                // Keep track of where auxiliary non-terminals (repeat symbols) are
+                // used within visible symbols. This information may be needed later
+                // for conflict resolution.
+                if next_symbol.is_non_terminal()
+                    && self.syntax_grammar.variables[next_symbol.index].is_auxiliary()
+                {
+                    preceding_auxiliary_symbols
+                        .push(self.get_auxiliary_node_info(item_set, next_symbol));
+                }
+            }
             // If the item is finished, then add a Reduce action to this state based
             // on this item.
             else {
@@ -361,6 +482,7 @@ impl<'a> ParseTableBuilder<'a> {
         // * choose one action over the others using precedence or associativity
         // * keep multiple actions if this conflict has been whitelisted in the grammar
         // * fail, terminating the parser generation process
+        let start = Instant::now();
         for symbol in lookaheads_with_conflicts.iter() {
             self.handle_conflict(
                 item_set,
@@ -371,6 +493,7 @@ impl<'a> ParseTableBuilder<'a> {
                 reduction_infos.get(&symbol).unwrap(),
             )?;
         }
+        self.conflict_duration += start.elapsed();
 
         // Finally, add actions for the grammar's `extra` symbols.
         let state = &mut self.parse_table.states[state_id];
@@ -973,7 +1096,7 @@ pub fn build_parse_table<'a>(
     lexical_grammar: &'a LexicalGrammar,
     inlines: &'a InlinedProductionMap,
     variable_info: &'a [VariableInfo],
-) -> Result<(ParseTable, Vec<TokenSet>, Vec<ParseStateInfo<'a>>)> {
+) -> Result<BuildTableResult<'a>> {
     let actual_conflicts = syntax_grammar.expected_conflicts.iter().cloned().collect();
     let item_set_builder = ParseItemSetBuilder::new(syntax_grammar, lexical_grammar, inlines);
     let mut following_tokens = vec![TokenSet::new(); lexical_grammar.variables.len()];
@@ -984,7 +1107,7 @@ pub fn build_parse_table<'a>(
         &item_set_builder,
     );
 
-    let (table, item_sets) = ParseTableBuilder {
+    let (table, item_sets, unnecessary_conflicts) = ParseTableBuilder {
         syntax_grammar,
         lexical_grammar,
         item_set_builder,
@@ -1002,8 +1125,9 @@ pub fn build_parse_table<'a>(
             production_infos: Vec::new(),
             max_aliased_production_length: 1,
         },
+        conflict_duration: Duration::ZERO,
     }
     .build()?;
 
-    Ok((table, following_tokens, item_sets))
+    Ok((table, following_tokens, item_sets, unnecessary_conflicts))
 }
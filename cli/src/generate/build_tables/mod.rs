@@ -6,11 +6,15 @@ mod item_set_builder;
 mod minimize_parse_table;
 mod token_conflicts;
 
-use std::collections::{BTreeSet, HashMap};
+use std::{
+    collections::{BTreeSet, HashMap},
+    time::Instant,
+};
 
 use anyhow::Result;
 pub use build_lex_table::LARGE_CHARACTER_RANGE_COUNT;
 use log::info;
+use serde::{Deserialize, Serialize};
 
 use self::{
     build_lex_table::build_lex_table,
@@ -20,6 +24,7 @@ use self::{
     token_conflicts::TokenConflictMap,
 };
 use crate::generate::{
+    cache::ArtifactCache,
     grammars::{InlinedProductionMap, LexicalGrammar, SyntaxGrammar},
     nfa::{CharacterSet, NfaCursor},
     node_types::VariableInfo,
@@ -27,6 +32,7 @@ use crate::generate::{
     tables::{LexTable, ParseAction, ParseTable, ParseTableEntry},
 };
 
+#[derive(Serialize, Deserialize)]
 pub struct Tables {
     pub parse_table: ParseTable,
     pub main_lex_table: LexTable,
@@ -42,10 +48,38 @@ pub fn build_tables(
     variable_info: &[VariableInfo],
     inlines: &InlinedProductionMap,
     report_symbol_name: Option<&str>,
+    cache: Option<&ArtifactCache>,
 ) -> Result<Tables> {
-    let (mut parse_table, following_tokens, parse_state_info) =
+    // The report of a rule's states needs the item sets of the parse states, which aren't
+    // cached. The inlined productions are derived from the syntax grammar, so they don't
+    // need to be part of the key.
+    let tables_cache = cache.filter(|_| report_symbol_name.is_none());
+    let tables_key = tables_cache.map(|_| {
+        let mut aliases = simple_aliases.iter().collect::<Vec<_>>();
+        aliases.sort_unstable();
+        ArtifactCache::key(&(syntax_grammar, lexical_grammar, aliases, variable_info))
+    });
+    if let (Some(cache), Some(key)) = (tables_cache, &tables_key) {
+        // The warnings about the grammar are stored with its tables, so that they are
+        // reported on every run, and not only on the run that built the tables.
+        if let Some((tables, unnecessary_conflicts)) =
+            cache.get::<(Tables, Vec<String>)>("tables", key)
+        {
+            print_unnecessary_conflicts(&unnecessary_conflicts);
+            return Ok(tables);
+        }
+    }
+
+    let start = Instant::now();
+    let (mut parse_table, following_tokens, parse_state_info, unnecessary_conflicts) =
         build_parse_table(syntax_grammar, lexical_grammar, inlines, variable_info)?;
-    let token_conflict_map = TokenConflictMap::new(lexical_grammar, following_tokens);
+    info!("built parse table in {:?}", start.elapsed());
+    print_unnecessary_conflicts(&unnecessary_conflicts);
+
+    let start = Instant::now();
+    let token_conflict_map = TokenConflictMap::with_cache(lexical_grammar, following_tokens, cache);
+    info!("computed token conflicts in {:?}", start.elapsed());
+
     let coincident_token_index = CoincidentTokenIndex::new(&parse_table, lexical_grammar);
     let keywords = identify_keywords(
         lexical_grammar,
@@ -63,6 +97,9 @@ pub fn build_tables(
         &keywords,
     );
     populate_used_symbols(&mut parse_table, syntax_grammar, lexical_grammar);
+
+    let start = Instant::now();
+    let state_count = parse_table.states.len();
     minimize_parse_table(
         &mut parse_table,
         syntax_grammar,
@@ -71,6 +108,12 @@ pub fn build_tables(
         &token_conflict_map,
         &keywords,
     );
+    info!(
+        "minimized parse table from {state_count} to {} states in {:?}",
+        parse_table.states.len(),
+        start.elapsed()
+    );
+
     let lex_tables = build_lex_table(
         &mut parse_table,
         syntax_grammar,
@@ -92,13 +135,26 @@ pub fn build_tables(
         );
     }
 
-    Ok(Tables {
+    let tables = Tables {
         parse_table,
         main_lex_table: lex_tables.main_lex_table,
         keyword_lex_table: lex_tables.keyword_lex_table,
         large_character_sets: lex_tables.large_character_sets,
         word_token: syntax_grammar.word_token,
-    })
+    };
+    if let (Some(cache), Some(key)) = (tables_cache, &tables_key) {
+        cache.put("tables", key, &(&tables, &unnecessary_conflicts));
+    }
+    Ok(tables)
+}
+
+fn print_unnecessary_conflicts(unnecessary_conflicts: &[String]) {
+    if !unnecessary_conflicts.is_empty() {
+        println!("Warning: unnecessary conflicts");
+        for conflict in unnecessary_conflicts {
+            println!("  {conflict}");
+        }
+    }
 }
 
 fn populate_error_state(
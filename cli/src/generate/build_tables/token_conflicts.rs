@@ -1,13 +1,16 @@
 use std::{cmp::Ordering, collections::HashSet, fmt};
 
+use serde::{Deserialize, Serialize};
+
 use crate::generate::{
     build_tables::item::TokenSetDisplay,
+    cache::ArtifactCache,
     grammars::{LexicalGrammar, SyntaxGrammar},
     nfa::{CharacterSet, NfaCursor, NfaTransition},
     rules::TokenSet,
 };
 
-#[derive(Clone, Debug, Default, PartialEq, Eq)]
+#[derive(Clone, Debug, Default, PartialEq, Eq, Serialize, Deserialize)]
 struct TokenConflictStatus {
     matches_prefix: bool,
     does_match_continuation: bool,
@@ -58,6 +61,43 @@ impl<'a> TokenConflictMap<'a> {
         }
     }
 
+    /// Like `new`, but reuse the analysis from a previous run when the lexical grammar and
+    /// the `following_token` map are unchanged.
+    pub fn with_cache(
+        grammar: &'a LexicalGrammar,
+        following_tokens: Vec<TokenSet>,
+        cache: Option<&ArtifactCache>,
+    ) -> Self {
+        let Some(cache) = cache else {
+            return Self::new(grammar, following_tokens);
+        };
+        let key = ArtifactCache::key(&(grammar, &following_tokens));
+        if let Some((status_matrix, starting_chars_by_index, following_chars_by_index)) =
+            cache.get("token-conflicts", &key)
+        {
+            return TokenConflictMap {
+                n: grammar.variables.len(),
+                status_matrix,
+                following_tokens,
+                starting_chars_by_index,
+                following_chars_by_index,
+                grammar,
+            };
+        }
+
+        let result = Self::new(grammar, following_tokens);
+        cache.put(
+            "token-conflicts",
+            &key,
+            &(
+                &result.status_matrix,
+                &result.starting_chars_by_index,
+                &result.following_chars_by_index,
+            ),
+        );
+        result
+    }
+
     /// Does token `i` match any strings that token `j` also matches, such that token `i`
     /// is preferred over token `j`?
     pub fn has_same_conflict_status(&self, a: usize, b: usize, other: usize) -> bool {
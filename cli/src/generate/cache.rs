@@ -0,0 +1,117 @@
+use std::{
+    collections::hash_map::DefaultHasher,
+    fs,
+    hash::{Hash, Hasher},
+    path::PathBuf,
+};
+
+use log::info;
+use serde::{de::DeserializeOwned, Serialize};
+
+/// A directory of build artifacts from previous runs of the parser generator.
+///
+/// Each artifact is stored under the name of the stage that produced it, along with a hash
+/// of that stage's inputs. Only the latest artifact of each stage is kept. Failing to read or
+/// write the cache is never an error: the stage is just run again.
+pub struct ArtifactCache {
+    dir: PathBuf,
+}
+
+impl ArtifactCache {
+    #[must_use]
+    pub const fn new(dir: PathBuf) -> Self {
+        Self { dir }
+    }
+
+    /// Compute the key of a stage's inputs, which also depends on the version of the
+    /// generator, so that artifacts aren't reused across versions.
+    pub fn key(inputs: &impl Hash) -> String {
+        let mut result = String::with_capacity(32);
+        for seed in 0..2_u8 {
+            let mut hasher = DefaultHasher::new();
+            seed.hash(&mut hasher);
+            env!("CARGO_PKG_VERSION").hash(&mut hasher);
+            inputs.hash(&mut hasher);
+            result += &format!("{:016x}", hasher.finish());
+        }
+        result
+    }
+
+    pub fn get<T: DeserializeOwned>(&self, stage: &str, key: &str) -> Option<T> {
+        let path = self.dir.join(format!("{stage}-{key}.json"));
+        let contents = fs::read(&path).ok()?;
+        match serde_json::from_slice(&contents) {
+            Ok(value) => {
+                info!("reusing cached {stage} from {}", path.display());
+                Some(value)
+            }
+            Err(e) => {
+                info!("ignoring invalid cached {stage} in {}: {e}", path.display());
+                None
+            }
+        }
+    }
+
+    pub fn put<T: Serialize>(&self, stage: &str, key: &str, value: &T) {
+        if let Err(e) = self.try_put(stage, key, value) {
+            info!("failed to cache {stage} in {}: {e}", self.dir.display());
+        }
+    }
+
+    fn try_put<T: Serialize>(&self, stage: &str, key: &str, value: &T) -> anyhow::Result<()> {
+        fs::create_dir_all(&self.dir)?;
+        let prefix = format!("{stage}-");
+        for entry in fs::read_dir(&self.dir)? {
+            let path = entry?.path();
+            if path
+                .file_name()
+                .and_then(|name| name.to_str())
+                .is_some_and(|name| name.starts_with(&prefix))
+            {
+                fs::remove_file(path)?;
+            }
+        }
+
+        // Write to a temporary file first, so that an interrupted write can't leave a
+        // truncated artifact behind.
+        let path = self.dir.join(format!("{prefix}{key}.json"));
+        let temp_path = path.with_extension("json.tmp");
+        fs::write(&temp_path, serde_json::to_vec(value)?)?;
+        fs::rename(&temp_path, &path)?;
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::generate::rules::{Symbol, TokenSet};
+
+    #[test]
+    fn test_artifact_cache_keeps_latest_artifact_per_stage() {
+        let dir = tempfile::tempdir().unwrap();
+        let cache = ArtifactCache::new(dir.path().to_owned());
+
+        let mut tokens = TokenSet::new();
+        tokens.insert(Symbol::terminal(3));
+        tokens.insert(Symbol::external(1));
+        tokens.insert(Symbol::end());
+
+        let key1 = ArtifactCache::key(&1);
+        let key2 = ArtifactCache::key(&2);
+        assert_ne!(key1, key2);
+        assert_eq!(cache.get::<TokenSet>("tokens", &key1), None);
+
+        cache.put("tokens", &key1, &tokens);
+        cache.put("other", &key1, &tokens);
+        assert_eq!(cache.get::<TokenSet>("tokens", &key1), Some(tokens.clone()));
+
+        cache.put("tokens", &key2, &TokenSet::new());
+        assert_eq!(cache.get::<TokenSet>("tokens", &key1), None);
+        assert_eq!(
+            cache.get::<TokenSet>("tokens", &key2),
+            Some(TokenSet::new())
+        );
+        assert_eq!(cache.get::<TokenSet>("other", &key1), Some(tokens));
+    }
+}
@@ -5,7 +5,7 @@ use super::{
     rules::{Alias, Associativity, Precedence, Rule, Symbol},
 };
 
-#[derive(Clone, Copy, Debug, PartialEq, Eq, PartialOrd, Ord)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq, PartialOrd, Ord, Hash)]
 pub enum VariableType {
     Hidden,
     Auxiliary,
@@ -43,7 +43,7 @@ pub struct InputGrammar {
 
 // Extracted lexical grammar
 
-#[derive(Debug, PartialEq, Eq)]
+#[derive(Debug, PartialEq, Eq, Hash)]
 pub struct LexicalVariable {
     pub name: String,
     pub kind: VariableType,
@@ -51,7 +51,7 @@ pub struct LexicalVariable {
     pub start_state: u32,
 }
 
-#[derive(Debug, Default, PartialEq, Eq)]
+#[derive(Debug, Default, PartialEq, Eq, Hash)]
 pub struct LexicalGrammar {
     pub nfa: Nfa,
     pub variables: Vec<LexicalVariable>,
@@ -68,7 +68,7 @@ pub struct ProductionStep {
     pub field_name: Option<String>,
 }
 
-#[derive(Clone, Debug, Default, PartialEq, Eq)]
+#[derive(Clone, Debug, Default, PartialEq, Eq, Hash)]
 pub struct Production {
     pub steps: Vec<ProductionStep>,
     pub dynamic_precedence: i32,
@@ -77,24 +77,26 @@ pub struct Production {
 #[derive(Default)]
 pub struct InlinedProductionMap {
     pub productions: Vec<Production>,
-    pub production_map: HashMap<(*const Production, u32), Vec<usize>>,
+    // Keyed by the address of a production, rather than a raw pointer, so that the map can
+    // be shared between threads.
+    pub production_map: HashMap<(usize, u32), Vec<usize>>,
 }
 
-#[derive(Clone, Debug, PartialEq, Eq)]
+#[derive(Clone, Debug, PartialEq, Eq, Hash)]
 pub struct SyntaxVariable {
     pub name: String,
     pub kind: VariableType,
     pub productions: Vec<Production>,
 }
 
-#[derive(Clone, Debug, PartialEq, Eq)]
+#[derive(Clone, Debug, PartialEq, Eq, Hash)]
 pub struct ExternalToken {
     pub name: String,
     pub kind: VariableType,
     pub corresponding_internal_token: Option<Symbol>,
 }
 
-#[derive(Debug, Default)]
+#[derive(Debug, Default, Hash)]
 pub struct SyntaxGrammar {
     pub variables: Vec<SyntaxVariable>,
     pub extra_symbols: Vec<Symbol>,
@@ -240,7 +242,7 @@ impl InlinedProductionMap {
         step_index: u32,
     ) -> Option<impl Iterator<Item = &'a Production> + 'a> {
         self.production_map
-            .get(&(production as *const Production, step_index))
+            .get(&(production as *const Production as usize, step_index))
             .map(|production_indices| {
                 production_indices
                     .iter()
@@ -7,6 +7,7 @@ use std::{
 
 use anyhow::{anyhow, Context, Result};
 use build_tables::build_tables;
+use cache::ArtifactCache;
 use grammar_files::path_in_ignore;
 use grammars::InputGrammar;
 use lazy_static::lazy_static;
@@ -14,9 +15,11 @@ use parse_grammar::parse_grammar;
 use prepare_grammar::prepare_grammar;
 use regex::{Regex, RegexBuilder};
 use render::render_c_code;
+pub use render::LexerMode;
 use semver::Version;
 
 mod build_tables;
+mod cache;
 mod dedup;
 mod grammar_files;
 mod grammars;
@@ -40,16 +43,22 @@ lazy_static! {
 struct GeneratedParser {
     c_code: String,
     node_types_json: String,
+    language_data: Option<Vec<u8>>,
 }
 
 pub const ALLOC_HEADER: &str = include_str!("./templates/alloc.h");
 
+#[allow(clippy::too_many_arguments)]
 pub fn generate_parser_in_directory(
     repo_path: &Path,
     grammar_path: Option<&str>,
     abi_version: usize,
+    lexer_mode: LexerMode,
+    optimize_size: bool,
+    emit_language_data: bool,
     generate_bindings: bool,
     report_symbol_name: Option<&str>,
+    cache_dir: Option<&Path>,
     js_runtime: Option<&str>,
 ) -> Result<()> {
     let mut repo_path = repo_path.to_owned();
@@ -110,9 +119,21 @@ pub fn generate_parser_in_directory(
     let GeneratedParser {
         c_code,
         node_types_json,
-    } = generate_parser_for_grammar_with_opts(&input_grammar, abi_version, report_symbol_name)?;
+        language_data,
+    } = generate_parser_for_grammar_with_opts(
+        &input_grammar,
+        abi_version,
+        lexer_mode,
+        optimize_size,
+        emit_language_data,
+        report_symbol_name,
+        cache_dir,
+    )?;
 
     write_file(&src_path.join("parser.c"), c_code)?;
+    if let Some(language_data) = language_data {
+        write_file(&src_path.join("parser.bin"), language_data)?;
+    }
     write_file(&src_path.join("node-types.json"), node_types_json)?;
     write_file(&header_path.join("alloc.h"), ALLOC_HEADER)?;
     write_file(&header_path.join("array.h"), tree_sitter::ARRAY_HEADER)?;
@@ -126,18 +147,55 @@ pub fn generate_parser_in_directory(
 }
 
 pub fn generate_parser_for_grammar(grammar_json: &str) -> Result<(String, String)> {
+    generate_parser_for_grammar_with_options(grammar_json, LexerMode::default(), false)
+}
+
+pub fn generate_parser_for_grammar_with_options(
+    grammar_json: &str,
+    lexer_mode: LexerMode,
+    optimize_size: bool,
+) -> Result<(String, String)> {
     let grammar_json = JSON_COMMENT_REGEX.replace_all(grammar_json, "\n");
     let input_grammar = parse_grammar(&grammar_json)?;
-    let parser =
-        generate_parser_for_grammar_with_opts(&input_grammar, tree_sitter::LANGUAGE_VERSION, None)?;
+    let parser = generate_parser_for_grammar_with_opts(
+        &input_grammar,
+        tree_sitter::LANGUAGE_VERSION,
+        lexer_mode,
+        optimize_size,
+        false,
+        None,
+        None,
+    )?;
     Ok((input_grammar.name, parser.c_code))
 }
 
+/// Generate a language data file for the given grammar, which can be loaded with
+/// `ts_language_load_mmap` instead of compiling the grammar's parser.
+pub fn generate_language_data_for_grammar(grammar_json: &str) -> Result<(String, Vec<u8>)> {
+    let grammar_json = JSON_COMMENT_REGEX.replace_all(grammar_json, "\n");
+    let input_grammar = parse_grammar(&grammar_json)?;
+    let parser = generate_parser_for_grammar_with_opts(
+        &input_grammar,
+        tree_sitter::LANGUAGE_VERSION,
+        LexerMode::default(),
+        false,
+        true,
+        None,
+        None,
+    )?;
+    Ok((input_grammar.name, parser.language_data.unwrap()))
+}
+
 fn generate_parser_for_grammar_with_opts(
     input_grammar: &InputGrammar,
     abi_version: usize,
+    lexer_mode: LexerMode,
+    optimize_size: bool,
+    emit_language_data: bool,
     report_symbol_name: Option<&str>,
+    cache_dir: Option<&Path>,
 ) -> Result<GeneratedParser> {
+    let cache = cache_dir.map(|dir| ArtifactCache::new(dir.join(&input_grammar.name)));
     let (syntax_grammar, lexical_grammar, inlines, simple_aliases) =
         prepare_grammar(input_grammar)?;
     let variable_info =
@@ -155,18 +213,28 @@ fn generate_parser_for_grammar_with_opts(
         &variable_info,
         &inlines,
         report_symbol_name,
+        cache.as_ref(),
     )?;
-    let c_code = render_c_code(
+    let (c_code, language_data) = render_c_code(
         &input_grammar.name,
         tables,
         syntax_grammar,
         lexical_grammar,
         simple_aliases,
         abi_version,
+        lexer_mode,
+        optimize_size,
+        emit_language_data,
     );
+    if emit_language_data && language_data.is_none() {
+        return Err(anyhow!(
+            "The grammar's lex tables have too many states to be stored in a language data file"
+        ));
+    }
     Ok(GeneratedParser {
         c_code,
         node_types_json: serde_json::to_string_pretty(&node_types_json).unwrap(),
+        language_data,
     })
 }
 
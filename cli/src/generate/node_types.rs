@@ -1,6 +1,7 @@
 use std::{
     cmp::Ordering,
     collections::{BTreeMap, HashMap, HashSet},
+    hash::{Hash, Hasher},
 };
 
 use anyhow::{anyhow, Result};
@@ -17,7 +18,7 @@ pub enum ChildType {
     Aliased(Alias),
 }
 
-#[derive(Clone, Debug, Default, PartialEq, Eq)]
+#[derive(Clone, Debug, Default, PartialEq, Eq, Hash)]
 pub struct FieldInfo {
     pub quantity: ChildQuantity,
     pub types: Vec<ChildType>,
@@ -31,6 +32,19 @@ pub struct VariableInfo {
     pub has_multi_step_production: bool,
 }
 
+// Hash the fields in a fixed order, so that the hash doesn't depend on the order of the
+// `HashMap`.
+impl Hash for VariableInfo {
+    fn hash<H: Hasher>(&self, state: &mut H) {
+        let mut fields = self.fields.iter().collect::<Vec<_>>();
+        fields.sort_unstable_by_key(|(name, _)| *name);
+        fields.hash(state);
+        self.children.hash(state);
+        self.children_without_fields.hash(state);
+        self.has_multi_step_production.hash(state);
+    }
+}
+
 #[derive(Debug, Serialize, PartialEq, Eq, Default, PartialOrd, Ord)]
 pub struct NodeInfoJSON {
     #[serde(rename = "type")]
@@ -58,7 +72,7 @@ pub struct FieldInfoJSON {
     types: Vec<NodeTypeJSON>,
 }
 
-#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash)]
 pub struct ChildQuantity {
     exists: bool,
     required: bool,
@@ -74,7 +74,7 @@ impl InlinedProductionMapBuilder {
                     |variable_index| {
                         &grammar.variables[variable_index].productions[step_id.production_index]
                     },
-                ) as *const Production;
+                ) as *const Production as usize;
                 ((production, step_id.step_index as u32), production_indices)
             })
             .collect();
@@ -1,10 +1,12 @@
 use std::{
     cmp,
-    collections::{HashMap, HashSet},
+    collections::{hash_map::Entry, HashMap, HashSet},
     fmt::Write,
-    mem::swap,
+    mem::{size_of, swap},
 };
 
+use log::info;
+
 use super::{
     build_tables::Tables,
     grammars::{ExternalToken, LexicalGrammar, SyntaxGrammar, VariableType},
@@ -20,6 +22,46 @@ const SMALL_STATE_THRESHOLD: usize = 64;
 const ABI_VERSION_MIN: usize = 13;
 const ABI_VERSION_MAX: usize = tree_sitter::LANGUAGE_VERSION;
 const ABI_VERSION_WITH_PRIMARY_STATES: usize = 14;
+const LEX_TABLE_SKIP: u16 = 0x8000;
+const LEX_TABLE_ROW_LINE_LEN: usize = 16;
+// The size of a `TSParseActionEntry` in `parser.h`.
+const PARSE_ACTION_ENTRY_SIZE: usize = 8;
+
+// The layout of a language data file, which must match the header and the sections that
+// `lib/src/language_data.c` reads.
+const LANGUAGE_DATA_MAGIC: u32 = 0x474c_5354;
+const LANGUAGE_DATA_FORMAT_VERSION: u32 = 1;
+const LANGUAGE_DATA_ALIGNMENT: usize = 8;
+const LANGUAGE_DATA_PARSE_TABLE: usize = 0;
+const LANGUAGE_DATA_SMALL_PARSE_TABLE: usize = 1;
+const LANGUAGE_DATA_SMALL_PARSE_TABLE_MAP: usize = 2;
+const LANGUAGE_DATA_PARSE_ACTIONS: usize = 3;
+const LANGUAGE_DATA_STRINGS: usize = 4;
+const LANGUAGE_DATA_SYMBOL_NAMES: usize = 5;
+const LANGUAGE_DATA_FIELD_NAMES: usize = 6;
+const LANGUAGE_DATA_FIELD_MAP_SLICES: usize = 7;
+const LANGUAGE_DATA_FIELD_MAP_ENTRIES: usize = 8;
+const LANGUAGE_DATA_SYMBOL_METADATA: usize = 9;
+const LANGUAGE_DATA_PUBLIC_SYMBOL_MAP: usize = 10;
+const LANGUAGE_DATA_ALIAS_MAP: usize = 11;
+const LANGUAGE_DATA_ALIAS_SEQUENCES: usize = 12;
+const LANGUAGE_DATA_LEX_MODES: usize = 13;
+const LANGUAGE_DATA_LEX_STATES: usize = 14;
+const LANGUAGE_DATA_KEYWORD_LEX_STATES: usize = 18;
+const LANGUAGE_DATA_EXTERNAL_SCANNER_STATES: usize = 22;
+const LANGUAGE_DATA_EXTERNAL_SCANNER_SYMBOL_MAP: usize = 23;
+const LANGUAGE_DATA_PRIMARY_STATE_IDS: usize = 24;
+const LANGUAGE_DATA_SECTION_COUNT: usize = 25;
+
+/// How the lex functions of a generated parser are implemented.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub enum LexerMode {
+    /// A `switch` statement with the transitions of each lex state as conditions.
+    #[default]
+    Switch,
+    /// Transition tables, which are run by a function in `parser.h`.
+    Table,
+}
 
 macro_rules! add {
     ($this: tt, $($arg: tt)*) => {{
@@ -66,6 +108,7 @@ struct Generator {
     large_character_sets: Vec<(Option<Symbol>, CharacterSet)>,
     large_character_set_info: Vec<LargeCharacterSetInfo>,
     large_state_count: usize,
+    parse_table_sizes: ParseTableSizes,
     keyword_capture_token: Option<Symbol>,
     syntax_grammar: SyntaxGrammar,
     lexical_grammar: LexicalGrammar,
@@ -76,6 +119,9 @@ struct Generator {
     unique_aliases: Vec<Alias>,
     symbol_map: HashMap<Symbol, Symbol>,
     field_names: Vec<String>,
+    lexer_mode: LexerMode,
+    optimize_size: bool,
+    emit_language_data: bool,
 
     #[allow(unused)]
     abi_version: usize,
@@ -86,8 +132,70 @@ struct LargeCharacterSetInfo {
     is_used: bool,
 }
 
+/// The condition under which the `switch` lexer takes one of a lex state's advance actions.
+/// When there is neither a large character set nor any asserted characters, the action is
+/// taken unconditionally.
+struct TransitionCondition {
+    large_char_set_ix: Option<usize>,
+    asserted_chars: CharacterSet,
+    is_included: bool,
+    negated_chars: CharacterSet,
+}
+
+/// The sizes, in bytes, of the arrays that make up the parse table of a generated parser.
+#[derive(Clone, Copy, Default)]
+struct ParseTableSizes {
+    large_table: usize,
+    small_table: usize,
+    small_table_map: usize,
+    parse_actions: usize,
+    shared_small_states: usize,
+}
+
+/// The transition tables of a lex table, as they are stored in a `TSLexTable`.
+struct LexTableData {
+    ascii_classes: [usize; 129],
+    ascii_class_count: usize,
+    rows: Vec<Vec<u16>>,
+    ranges: Vec<(u32, u32, u16)>,
+    states: Vec<LexTableStateData>,
+}
+
+/// The entry of one lex state in a `TSLexTable`.
+#[derive(Clone, Copy)]
+struct LexTableStateData {
+    accept_symbol: Option<Symbol>,
+    eof_action: u16,
+    row_id: usize,
+    range_index: usize,
+    range_count: usize,
+}
+
+/// The contents of the parse table arrays of a generated parser.
+#[allow(clippy::type_complexity)]
+struct ParseTableData {
+    /// The entries of each large state, with its nonterminal entries followed by its terminal
+    /// entries. A nonterminal's value is a state id, and a terminal's is a parse action list id.
+    large_states: Vec<Vec<(Symbol, usize)>>,
+    /// The index in the small parse table of each small state's entries, which may be shared
+    /// with another state.
+    small_state_indices: Vec<usize>,
+    /// The index and the groups of symbols of each small state that has its own entries.
+    small_states: Vec<(usize, Vec<((usize, SymbolType), Vec<Symbol>)>)>,
+    /// The parse action lists, with the index of each one in the list of parse actions.
+    parse_action_lists: Vec<(usize, ParseTableEntry)>,
+}
+
+/// The value that a group of symbols maps to in the "small state" representation of a parse
+/// state.
+#[derive(PartialEq, Eq, Hash)]
+enum SmallStateValue<'a> {
+    Actions(&'a ParseTableEntry),
+    State(usize),
+}
+
 impl Generator {
-    fn generate(mut self) -> String {
+    fn generate(mut self) -> (String, Option<Vec<u8>>) {
         self.init();
         self.add_includes();
         self.add_pragmas();
@@ -113,6 +221,12 @@ impl Generator {
             self.add_primary_state_id_list();
         }
 
+        let language_data = if self.emit_language_data {
+            self.language_data()
+        } else {
+            None
+        };
+
         let buffer_offset_before_lex_functions = self.buffer.len();
 
         let mut main_lex_table = LexTable::default();
@@ -146,7 +260,7 @@ impl Generator {
 
         self.add_parser_export();
 
-        self.buffer
+        (self.buffer, language_data)
     }
 
     fn init(&mut self) {
@@ -159,6 +273,15 @@ impl Generator {
             self.symbol_ids[&Symbol::end()].clone(),
         );
 
+        self.symbol_order.insert(Symbol::end(), 0);
+        let mut i = 1;
+        for symbol in &self.parse_table.symbols {
+            if *symbol != Symbol::end() {
+                self.symbol_order.insert(*symbol, i);
+                i += 1;
+            }
+        }
+
         self.symbol_map = HashMap::new();
 
         for symbol in &self.parse_table.symbols {
@@ -267,17 +390,114 @@ impl Generator {
         }
 
         // Determine which states should use the "small state" representation, and which should
-        // use the normal array representation.
-        let threshold = cmp::min(SMALL_STATE_THRESHOLD, self.parse_table.symbols.len() / 2);
-        self.large_state_count = self
-            .parse_table
-            .states
-            .iter()
-            .enumerate()
-            .take_while(|(i, s)| {
-                *i <= 1 || s.terminal_entries.len() + s.nonterminal_entries.len() > threshold
+        // use the normal array representation. By default, the states with many entries use the
+        // array representation, so that their actions can be looked up directly. When optimizing
+        // for size, the split that minimizes the total size of the parse table is used instead.
+        let state_count = self.parse_table.states.len();
+        let large_state_size = self.parse_table.symbols.len() * size_of::<u16>();
+        let small_table_sizes = self.small_parse_table_sizes();
+        let table_size = |large_state_count: usize| {
+            large_state_count * large_state_size
+                + small_table_sizes[large_state_count].0
+                + (state_count - large_state_count) * size_of::<u32>()
+        };
+        self.large_state_count = if self.optimize_size {
+            // When two splits are equally small, prefer the one with more large states.
+            (cmp::min(2, state_count)..=state_count)
+                .rev()
+                .min_by_key(|count| table_size(*count))
+                .unwrap()
+        } else {
+            let threshold = cmp::min(SMALL_STATE_THRESHOLD, self.parse_table.symbols.len() / 2);
+            self.parse_table
+                .states
+                .iter()
+                .enumerate()
+                .take_while(|(i, s)| {
+                    *i <= 1 || s.terminal_entries.len() + s.nonterminal_entries.len() > threshold
+                })
+                .count()
+        };
+
+        let empty_entry = ParseTableEntry {
+            actions: Vec::new(),
+            reusable: false,
+        };
+        let mut entries = HashSet::new();
+        entries.insert(&empty_entry);
+        for state in &self.parse_table.states {
+            entries.extend(state.terminal_entries.values());
+        }
+        let (small_table, shared_small_states) = small_table_sizes[self.large_state_count];
+        self.parse_table_sizes = ParseTableSizes {
+            large_table: self.large_state_count * large_state_size,
+            small_table,
+            small_table_map: (state_count - self.large_state_count) * size_of::<u32>(),
+            parse_actions: entries
+                .iter()
+                .map(|entry| (1 + entry.actions.len()) * PARSE_ACTION_ENTRY_SIZE)
+                .sum(),
+            shared_small_states,
+        };
+    }
+
+    /// For each possible number of large states, compute the size of the small parse table in
+    /// bytes, and the number of small states that share their entries with another state.
+    fn small_parse_table_sizes(&self) -> Vec<(usize, usize)> {
+        let state_count = self.parse_table.states.len();
+        let mut result = vec![(0, 0); state_count + 1];
+        let mut small_states = HashSet::new();
+        let mut size = 0;
+        let mut shared_count = 0;
+        for i in (0..state_count).rev() {
+            let (groups, entry_count) = self.small_state_groups(i);
+            if self.optimize_size && !small_states.insert(groups) {
+                shared_count += 1;
+            } else {
+                size += entry_count * size_of::<u16>();
+            }
+            result[i] = (size, shared_count);
+        }
+        result
+    }
+
+    /// Group the symbols of a parse state by their value, as in the "small state"
+    /// representation, and compute the number of entries in that representation.
+    fn small_state_groups(
+        &self,
+        state_id: usize,
+    ) -> (Vec<(Vec<Symbol>, SmallStateValue<'_>)>, usize) {
+        let state = &self.parse_table.states[state_id];
+        let mut symbols_by_value = HashMap::<SmallStateValue, Vec<Symbol>>::new();
+        for (symbol, entry) in &state.terminal_entries {
+            symbols_by_value
+                .entry(SmallStateValue::Actions(entry))
+                .or_default()
+                .push(*symbol);
+        }
+        for (symbol, action) in &state.nonterminal_entries {
+            let value = match action {
+                GotoAction::Goto(i) => SmallStateValue::State(*i),
+                GotoAction::ShiftExtra => SmallStateValue::State(state_id),
+            };
+            symbols_by_value.entry(value).or_default().push(*symbol);
+        }
+
+        // Each symbol belongs to exactly one group, so the groups can be ordered by their
+        // symbols alone.
+        let mut groups = symbols_by_value
+            .into_iter()
+            .map(|(value, mut symbols)| {
+                symbols.sort_unstable();
+                (symbols, value)
             })
-            .count();
+            .collect::<Vec<_>>();
+        groups.sort_unstable_by(|a, b| a.0.cmp(&b.0));
+        let entry_count = 1 + groups
+            .iter()
+            .map(|(symbols, _)| 2 + symbols.len())
+            .sum::<usize>();
+        (groups, entry_count)
     }
 
     fn add_includes(&mut self) {
@@ -309,9 +529,8 @@ impl Generator {
         }
     }
 
-    fn add_stats(&mut self) {
-        let token_count = self
-            .parse_table
+    fn token_count(&self) -> usize {
+        self.parse_table
             .symbols
             .iter()
             .filter(|symbol| {
@@ -325,7 +544,11 @@ impl Generator {
                     false
                 }
             })
-            .count();
+            .count()
+    }
+
+    fn add_stats(&mut self) {
+        let token_count = self.token_count();
 
         add_line!(self, "#define LANGUAGE_VERSION {}", self.abi_version);
         add_line!(
@@ -359,23 +582,54 @@ impl Generator {
             self.parse_table.production_infos.len()
         );
         add_line!(self, "");
+
+        let ParseTableSizes {
+            large_table,
+            small_table,
+            small_table_map,
+            parse_actions,
+            shared_small_states,
+        } = self.parse_table_sizes;
+        let small_state_count = self.parse_table.states.len() - self.large_state_count;
+        info!(
+            "parse table sizes: {} large states in {large_table} bytes, {small_state_count} small \
+            states in {small_table} bytes ({shared_small_states} shared) with a \
+            {small_table_map} byte map, {parse_actions} bytes of actions",
+            self.large_state_count,
+        );
+        if self.optimize_size {
+            add_line!(self, "// Parse table sizes, in bytes:");
+            add_line!(self, "//   ts_parse_table: {large_table}");
+            add_line!(
+                self,
+                "//   ts_small_parse_table: {small_table} ({shared_small_states} of {small_state_count} small states shared)"
+            );
+            add_line!(self, "//   ts_small_parse_table_map: {small_table_map}");
+            add_line!(self, "//   ts_parse_actions: {parse_actions}");
+            add_line!(self, "");
+        }
     }
 
     fn add_symbol_enum(&mut self) {
         add_line!(self, "enum ts_symbol_identifiers {{");
         indent!(self);
-        self.symbol_order.insert(Symbol::end(), 0);
-        let mut i = 1;
         for symbol in &self.parse_table.symbols {
             if *symbol != Symbol::end() {
-                self.symbol_order.insert(*symbol, i);
-                add_line!(self, "{} = {i},", self.symbol_ids[symbol]);
-                i += 1;
+                add_line!(
+                    self,
+                    "{} = {},",
+                    self.symbol_ids[symbol],
+                    self.symbol_order[symbol]
+                );
             }
         }
-        for alias in &self.unique_aliases {
-            add_line!(self, "{} = {i},", self.alias_ids[alias]);
-            i += 1;
+        for (i, alias) in self.unique_aliases.iter().enumerate() {
+            add_line!(
+                self,
+                "{} = {},",
+                self.alias_ids[alias],
+                self.parse_table.symbols.len() + i
+            );
         }
         dedent!(self);
         add_line!(self, "}};");
@@ -539,7 +793,9 @@ impl Generator {
         add_line!(self, "");
     }
 
-    fn add_non_terminal_alias_map(&mut self) {
+    /// Find the aliases of each nonterminal symbol other than its default alias, in the order
+    /// of the symbols.
+    fn non_terminal_aliases(&self) -> Vec<(Symbol, Vec<String>)> {
         let mut alias_ids_by_symbol = HashMap::new();
         for variable in &self.syntax_grammar.variables {
             for production in &variable.productions {
@@ -562,17 +818,24 @@ impl Generator {
             }
         }
 
-        let mut alias_ids_by_symbol = alias_ids_by_symbol.iter().collect::<Vec<_>>();
+        let mut alias_ids_by_symbol = alias_ids_by_symbol
+            .into_iter()
+            .map(|(symbol, alias_ids)| (symbol, alias_ids.into_iter().cloned().collect()))
+            .collect::<Vec<_>>();
         alias_ids_by_symbol.sort_unstable_by_key(|e| e.0);
+        alias_ids_by_symbol
+    }
 
+    fn add_non_terminal_alias_map(&mut self) {
+        let alias_ids_by_symbol = self.non_terminal_aliases();
         add_line!(
             self,
             "static const uint16_t ts_non_terminal_alias_map[] = {{"
         );
         indent!(self);
         for (symbol, alias_ids) in alias_ids_by_symbol {
-            let symbol_id = &self.symbol_ids[symbol];
-            let public_symbol_id = &self.symbol_ids[&self.symbol_map[symbol]];
+            let symbol_id = &self.symbol_ids[&symbol];
+            let public_symbol_id = &self.symbol_ids[&self.symbol_map[&symbol]];
             add_line!(self, "{symbol_id}, {},", 1 + alias_ids.len());
             indent!(self);
             add_line!(self, "{public_symbol_id},");
@@ -610,7 +873,15 @@ impl Generator {
         add_line!(self, "");
     }
 
-    fn add_field_sequences(&mut self) {
+    /// Compute the index and length of each production's slice of the field map entries, and
+    /// the lists of field map entries, with the index of each one among all entries.
+    #[allow(clippy::type_complexity)]
+    fn field_map_data(
+        &self,
+    ) -> (
+        Vec<(usize, usize)>,
+        Vec<(usize, Vec<(String, FieldLocation)>)>,
+    ) {
         let mut flat_field_maps = vec![];
         let mut next_flat_field_map_index = 0;
         self.get_field_map_id(
@@ -640,6 +911,11 @@ impl Generator {
                 ));
             }
         }
+        (field_map_ids, flat_field_maps)
+    }
+
+    fn add_field_sequences(&mut self) {
+        let (field_map_ids, flat_field_maps) = self.field_map_data();
 
         add_line!(
             self,
@@ -683,6 +959,12 @@ impl Generator {
     }
 
     fn add_lex_function(&mut self, name: &str, lex_table: LexTable) {
+        // The table actions can't refer to more states than fit beside the skip flag.
+        if self.lexer_mode == LexerMode::Table && lex_table.states.len() < LEX_TABLE_SKIP as usize {
+            self.add_lex_table_function(name, &lex_table);
+            return;
+        }
+
         add_line!(
             self,
             "static bool {name}(TSLexer *lexer, TSStateId state) {{",
@@ -714,15 +996,346 @@ impl Generator {
         add_line!(self, "");
     }
 
+    /// Compute the transition tables that `ts_lex_with_table` runs for the given lex table.
+    fn lex_table_data(&self, lex_table: &LexTable) -> LexTableData {
+        // Find each state's action for every lookahead value from `-1` to 127, and its ranges
+        // of actions for the other characters. Invalid UTF-8, the null character and the end
+        // of the file don't simply match the character sets, so take the `switch` lexer's
+        // actions for those.
+        let lex_action = |action: Option<&AdvanceAction>| {
+            action.map_or(0, |action| {
+                let mut value = action.state as u16 + 1;
+                if !action.in_main_token {
+                    value |= LEX_TABLE_SKIP;
+                }
+                value
+            })
+        };
+        let mut ascii_actions = Vec::with_capacity(lex_table.states.len());
+        let mut range_actions = Vec::with_capacity(lex_table.states.len());
+        let mut eof_actions = Vec::with_capacity(lex_table.states.len());
+        for state in &lex_table.states {
+            let mut ascii = [0; 129];
+            let mut ranges = Vec::new();
+            for (chars, action) in &state.advance_actions {
+                let value = lex_action(Some(action));
+                for range in chars.ranges() {
+                    let start = *range.start() as u32;
+                    let end = *range.end() as u32;
+                    for c in start.max(1)..=end.min(127) {
+                        ascii[c as usize + 1] = value;
+                    }
+                    if end >= 128 {
+                        ranges.push((start.max(128), end, value));
+                    }
+                }
+            }
+            let (mapped_transition_count, conditions) = self.lex_state_conditions(state);
+            let switch_action = |lookahead, eof| {
+                self.switch_lex_action(state, mapped_transition_count, &conditions, lookahead, eof)
+            };
+            ascii[0] = lex_action(switch_action(-1, false));
+            ascii[1] = lex_action(switch_action(0, false));
+            eof_actions.push(match &state.eof_action {
+                Some(eof_action) => eof_action.state as u16 + 1,
+                None => lex_action(switch_action(0, true)),
+            });
+            ranges.sort_unstable();
+            ranges.dedup_by(|next, prev| {
+                let is_adjacent = prev.1 + 1 == next.0 && prev.2 == next.2;
+                if is_adjacent {
+                    prev.1 = next.1;
+                }
+                is_adjacent
+            });
+            ascii_actions.push(ascii);
+            range_actions.push(ranges);
+        }
+
+        // Group the ASCII characters that every state treats the same way into classes, and
+        // share the identical rows and lists of ranges between states.
+        let mut ascii_classes = [0; 129];
+        let mut class_ids = HashMap::new();
+        let mut class_characters = Vec::new();
+        for c in 0..129 {
+            let column = ascii_actions.iter().map(|row| row[c]).collect::<Vec<_>>();
+            ascii_classes[c] = *class_ids.entry(column).or_insert_with(|| {
+                class_characters.push(c);
+                class_characters.len() - 1
+            });
+        }
+        let mut rows = Vec::new();
+        let mut row_ids = HashMap::new();
+        let mut ranges = Vec::new();
+        let mut range_indices = HashMap::new();
+        let mut states = Vec::with_capacity(lex_table.states.len());
+        for (ascii, state_ranges) in ascii_actions.iter().zip(range_actions) {
+            let row = class_characters
+                .iter()
+                .map(|c| ascii[*c])
+                .collect::<Vec<_>>();
+            let row_id = *row_ids.entry(row).or_insert_with_key(|row| {
+                rows.push(row.clone());
+                rows.len() - 1
+            });
+            let range_count = state_ranges.len();
+            let range_index = if range_count == 0 {
+                0
+            } else {
+                *range_indices
+                    .entry(state_ranges)
+                    .or_insert_with_key(|state_ranges| {
+                        ranges.extend_from_slice(state_ranges);
+                        ranges.len() - state_ranges.len()
+                    })
+            };
+            states.push((row_id, range_index, range_count));
+        }
+
+        LexTableData {
+            ascii_classes,
+            ascii_class_count: class_characters.len(),
+            rows,
+            ranges,
+            states: lex_table
+                .states
+                .iter()
+                .zip(eof_actions)
+                .zip(states)
+                .map(
+                    |((state, eof_action), (row_id, range_index, range_count))| LexTableStateData {
+                        accept_symbol: state.accept_action,
+                        eof_action,
+                        row_id,
+                        range_index,
+                        range_count,
+                    },
+                )
+                .collect(),
+        }
+    }
+
+    fn add_lex_table_function(&mut self, name: &str, lex_table: &LexTable) {
+        let LexTableData {
+            ascii_classes,
+            ascii_class_count,
+            rows,
+            ranges,
+            states,
+        } = self.lex_table_data(lex_table);
+
+        add_line!(self, "static const uint8_t {name}_ascii_classes[129] = {{");
+        indent!(self);
+        self.add_number_rows(&ascii_classes);
+        dedent!(self);
+        add_line!(self, "}};");
+        add_line!(self, "");
+
+        add_line!(self, "static const uint16_t {name}_ascii_rows[] = {{");
+        indent!(self);
+        for row in &rows {
+            self.add_number_rows(row);
+        }
+        dedent!(self);
+        add_line!(self, "}};");
+        add_line!(self, "");
+
+        if !ranges.is_empty() {
+            add_line!(self, "static const TSLexTableRange {name}_ranges[] = {{");
+            indent!(self);
+            for (start, end, action) in &ranges {
+                add_line!(self, "{{0x{start:x}, 0x{end:x}, {action}}},");
+            }
+            dedent!(self);
+            add_line!(self, "}};");
+            add_line!(self, "");
+        }
+
+        add_line!(self, "static const TSLexTableState {name}_states[] = {{");
+        indent!(self);
+        for (i, state) in states.iter().enumerate() {
+            let LexTableStateData {
+                accept_symbol,
+                eof_action,
+                row_id,
+                range_index,
+                range_count,
+            } = *state;
+            let mut fields = Vec::new();
+            if let Some(accept_action) = accept_symbol {
+                fields.push(format!(
+                    ".accept_symbol = {}, .accepts = true",
+                    self.symbol_ids[&accept_action]
+                ));
+            }
+            if eof_action > 0 {
+                fields.push(format!(".eof_action = {eof_action}"));
+            }
+            if row_id > 0 {
+                fields.push(format!(".ascii_row = {row_id}"));
+            }
+            if range_count > 0 {
+                fields.push(format!(
+                    ".range_count = {range_count}, .range_index = {range_index}"
+                ));
+            }
+            if fields.is_empty() {
+                add_line!(self, "[{i}] = {{0}},");
+            } else {
+                add_line!(self, "[{i}] = {{{}}},", fields.join(", "));
+            }
+        }
+        dedent!(self);
+        add_line!(self, "}};");
+        add_line!(self, "");
+
+        add_line!(self, "static const TSLexTable {name}_table = {{");
+        indent!(self);
+        add_line!(self, ".states = {name}_states,");
+        add_line!(self, ".ascii_classes = {name}_ascii_classes,");
+        add_line!(self, ".ascii_rows = {name}_ascii_rows,");
+        if !ranges.is_empty() {
+            add_line!(self, ".ranges = {name}_ranges,");
+        }
+        add_line!(self, ".ascii_class_count = {ascii_class_count},");
+        dedent!(self);
+        add_line!(self, "}};");
+        add_line!(self, "");
+
+        add_line!(
+            self,
+            "static bool {name}(TSLexer *lexer, TSStateId state) {{",
+        );
+        indent!(self);
+        add_line!(
+            self,
+            "return ts_lex_with_table(lexer, &{name}_table, state);"
+        );
+        dedent!(self);
+        add_line!(self, "}}");
+        add_line!(self, "");
+    }
+
+    fn add_number_rows<T: std::fmt::Display>(&mut self, numbers: &[T]) {
+        for line in numbers.chunks(LEX_TABLE_ROW_LINE_LEN) {
+            add_whitespace!(self);
+            for (i, number) in line.iter().enumerate() {
+                if i > 0 {
+                    add!(self, " ");
+                }
+                add!(self, "{number},");
+            }
+            add!(self, "\n");
+        }
+    }
+
     fn add_lex_state(&mut self, _state_ix: usize, state: LexState) {
         if let Some(accept_action) = state.accept_action {
             add_line!(self, "ACCEPT_TOKEN({});", self.symbol_ids[&accept_action]);
         }
 
-        if let Some(eof_action) = state.eof_action {
+        if let Some(eof_action) = &state.eof_action {
             add_line!(self, "if (eof) ADVANCE({});", eof_action.state);
         }
 
+        let (mapped_transition_count, conditions) = self.lex_state_conditions(&state);
+        if mapped_transition_count > 0 {
+            add_line!(self, "ADVANCE_MAP(");
+            indent!(self);
+            for (chars, action) in &state.advance_actions[0..mapped_transition_count] {
+                for range in chars.ranges() {
+                    add_whitespace!(self);
+                    self.add_character(*range.start());
+                    add!(self, ", {},\n", action.state);
+                    if range.end() > range.start() {
+                        add_whitespace!(self);
+                        self.add_character(*range.end());
+                        add!(self, ", {},\n", action.state);
+                    }
+                }
+            }
+            dedent!(self);
+            add_line!(self, ");");
+        }
+
+        for (condition, (_, action)) in conditions
+            .into_iter()
+            .zip(&state.advance_actions[mapped_transition_count..])
+        {
+            add_whitespace!(self);
+
+            let mut line_break = "\n".to_string();
+            for _ in 0..self.indent_level + 2 {
+                line_break.push_str("  ");
+            }
+
+            let has_positive_condition =
+                condition.large_char_set_ix.is_some() || !condition.asserted_chars.is_empty();
+            let has_negative_condition = !condition.negated_chars.is_empty();
+            let has_condition = has_positive_condition || has_negative_condition;
+            if has_condition {
+                add!(self, "if (");
+                if has_positive_condition && has_negative_condition {
+                    add!(self, "(");
+                }
+            }
+
+            if let Some(large_char_set_ix) = condition.large_char_set_ix {
+                let large_set = &self.large_character_sets[large_char_set_ix].1;
+
+                // If the character set contains the null character, check that we
+                // are not at the end of the file.
+                let check_eof = large_set.contains('\0');
+                if check_eof {
+                    add!(self, "(!eof && ");
+                }
+
+                let char_set_info = &mut self.large_character_set_info[large_char_set_ix];
+                char_set_info.is_used = true;
+                add!(
+                    self,
+                    "set_contains({}, {}, lookahead)",
+                    &char_set_info.constant_name,
+                    large_set.range_count(),
+                );
+                if check_eof {
+                    add!(self, ")");
+                }
+            }
+
+            if !condition.asserted_chars.is_empty() {
+                if condition.large_char_set_ix.is_some() {
+                    add!(self, " ||{line_break}");
+                }
+                self.add_character_range_conditions(
+                    &condition.asserted_chars,
+                    condition.is_included,
+                    &line_break,
+                );
+            }
+
+            if has_negative_condition {
+                if has_positive_condition {
+                    add!(self, ") &&{line_break}");
+                }
+                self.add_character_range_conditions(&condition.negated_chars, false, &line_break);
+            }
+
+            if has_condition {
+                add!(self, ") ");
+            }
+
+            self.add_advance_action(action);
+            add!(self, "\n");
+        }
+
+        add_line!(self, "END_STATE();");
+    }
+
+    /// Decide how the `switch` lexer checks the advance actions of a lex state. Returns the
+    /// number of leading actions that are checked with an `ADVANCE_MAP`, and the conditions
+    /// of the remaining ones.
+    fn lex_state_conditions(&self, state: &LexState) -> (usize, Vec<TransitionCondition>) {
         let mut chars_copy = CharacterSet::empty();
         let mut large_set = CharacterSet::empty();
         let mut ruled_out_chars = CharacterSet::empty();
@@ -742,38 +1355,23 @@ impl Generator {
                     end <= start + 1 && end <= u16::MAX as u32
                 })
             {
-                leading_simple_transition_count += 1;
-                leading_simple_transition_range_count += chars.range_count();
-            } else {
-                break;
-            }
-        }
-
-        if leading_simple_transition_range_count >= 8 {
-            add_line!(self, "ADVANCE_MAP(");
-            indent!(self);
-            for (chars, action) in &state.advance_actions[0..leading_simple_transition_count] {
-                for range in chars.ranges() {
-                    add_whitespace!(self);
-                    self.add_character(*range.start());
-                    add!(self, ", {},\n", action.state);
-                    if range.end() > range.start() {
-                        add_whitespace!(self);
-                        self.add_character(*range.end());
-                        add!(self, ", {},\n", action.state);
-                    }
-                }
+                leading_simple_transition_count += 1;
+                leading_simple_transition_range_count += chars.range_count();
+            } else {
+                break;
+            }
+        }
+
+        if leading_simple_transition_range_count >= 8 {
+            for (chars, _) in &state.advance_actions[0..leading_simple_transition_count] {
                 ruled_out_chars = ruled_out_chars.add(chars);
             }
-            dedent!(self);
-            add_line!(self, ");");
         } else {
             leading_simple_transition_count = 0;
         }
 
-        for (chars, action) in &state.advance_actions[leading_simple_transition_count..] {
-            add_whitespace!(self);
-
+        let mut conditions = Vec::new();
+        for (chars, _) in &state.advance_actions[leading_simple_transition_count..] {
             // The lex state's advance actions are represented with disjoint
             // sets of characters. When translating these disjoint sets into a
             // sequence of checks, we don't need to re-check conditions that
@@ -818,85 +1416,106 @@ impl Generator {
             // which don't need to be checked for subsequent transitions in this state.
             ruled_out_chars = ruled_out_chars.add(chars);
 
-            let mut large_char_set_ix = None;
-            let mut asserted_chars = simplified_chars;
-            let mut negated_chars = CharacterSet::empty();
+            let mut condition = TransitionCondition {
+                large_char_set_ix: None,
+                asserted_chars: simplified_chars,
+                is_included: true,
+                negated_chars: CharacterSet::empty(),
+            };
             if let Some((char_set_ix, additions, removals)) = best_large_char_set {
-                asserted_chars = additions;
-                negated_chars = removals;
-                large_char_set_ix = Some(char_set_ix);
-            }
-
-            let mut line_break = "\n".to_string();
-            for _ in 0..self.indent_level + 2 {
-                line_break.push_str("  ");
+                condition.large_char_set_ix = Some(char_set_ix);
+                condition.asserted_chars = additions;
+                condition.negated_chars = removals;
             }
 
-            let has_positive_condition = large_char_set_ix.is_some() || !asserted_chars.is_empty();
-            let has_negative_condition = !negated_chars.is_empty();
-            let has_condition = has_positive_condition || has_negative_condition;
-            if has_condition {
-                add!(self, "if (");
-                if has_positive_condition && has_negative_condition {
-                    add!(self, "(");
-                }
+            // If the character set contains the max character, than it probably
+            // corresponds to a negated character class in a regex, so it will be more
+            // concise and readable to express it in terms of negated ranges.
+            if condition.asserted_chars.contains(char::MAX) {
+                condition.is_included = false;
+                condition.asserted_chars = condition.asserted_chars.negate().add_char('\0');
             }
 
-            if let Some(large_char_set_ix) = large_char_set_ix {
-                let large_set = &self.large_character_sets[large_char_set_ix].1;
-
-                // If the character set contains the null character, check that we
-                // are not at the end of the file.
-                let check_eof = large_set.contains('\0');
-                if check_eof {
-                    add!(self, "(!eof && ");
-                }
-
-                let char_set_info = &mut self.large_character_set_info[large_char_set_ix];
-                char_set_info.is_used = true;
-                add!(
-                    self,
-                    "set_contains({}, {}, lookahead)",
-                    &char_set_info.constant_name,
-                    large_set.range_count(),
-                );
-                if check_eof {
-                    add!(self, ")");
-                }
-            }
+            conditions.push(condition);
+        }
 
-            if !asserted_chars.is_empty() {
-                if large_char_set_ix.is_some() {
-                    add!(self, " ||{line_break}");
-                }
+        (leading_simple_transition_count, conditions)
+    }
 
-                // If the character set contains the max character, than it probably
-                // corresponds to a negated character class in a regex, so it will be more
-                // concise and readable to express it in terms of negated ranges.
-                let is_included = !asserted_chars.contains(char::MAX);
-                if !is_included {
-                    asserted_chars = asserted_chars.negate().add_char('\0');
+    /// Find the advance action that the `switch` lexer takes for a lookahead value that isn't
+    /// a character of the input: the null character at the end of the file, or `-1` for
+    /// invalid UTF-8. The lex table stores these explicitly, so that both lexers agree.
+    fn switch_lex_action<'a>(
+        &self,
+        state: &'a LexState,
+        mapped_transition_count: usize,
+        conditions: &[TransitionCondition],
+        lookahead: i32,
+        eof: bool,
+    ) -> Option<&'a AdvanceAction> {
+        if lookahead == 0 {
+            for (chars, action) in &state.advance_actions[0..mapped_transition_count] {
+                if chars.contains('\0') {
+                    return Some(action);
                 }
-
-                self.add_character_range_conditions(&asserted_chars, is_included, &line_break);
             }
+        }
+        conditions
+            .iter()
+            .zip(&state.advance_actions[mapped_transition_count..])
+            .find(|(condition, _)| {
+                let large_set_matches = condition.large_char_set_ix.map(|ix| {
+                    let large_set = &self.large_character_sets[ix].1;
+                    lookahead == 0 && !eof && large_set.contains('\0')
+                });
+                let asserted_chars_match = (!condition.asserted_chars.is_empty()).then(|| {
+                    Self::switch_range_conditions_match(
+                        &condition.asserted_chars,
+                        condition.is_included,
+                        lookahead,
+                        eof,
+                    )
+                });
+                let positive = match (large_set_matches, asserted_chars_match) {
+                    (None, None) => true,
+                    (a, b) => a.unwrap_or(false) || b.unwrap_or(false),
+                };
+                positive
+                    && (condition.negated_chars.is_empty()
+                        || Self::switch_range_conditions_match(
+                            &condition.negated_chars,
+                            false,
+                            lookahead,
+                            eof,
+                        ))
+            })
+            .map(|(_, (_, action))| action)
+    }
 
-            if has_negative_condition {
-                if has_positive_condition {
-                    add!(self, ") &&{line_break}");
+    /// Evaluate the conditions from `add_character_range_conditions` for a lookahead value
+    /// that is `0` or `-1`.
+    fn switch_range_conditions_match(
+        characters: &CharacterSet,
+        is_included: bool,
+        lookahead: i32,
+        eof: bool,
+    ) -> bool {
+        if is_included {
+            characters.ranges().any(|range| {
+                let end = *range.end() as i32;
+                *range.start() == '\0' && !eof && (lookahead == 0 || end > 0)
+            })
+        } else {
+            characters.ranges().all(|range| {
+                let start = *range.start() as i32;
+                let end = *range.end() as i32;
+                if start == 0 && end > 1 {
+                    lookahead > end
+                } else {
+                    lookahead < start || lookahead > end
                 }
-                self.add_character_range_conditions(&negated_chars, false, &line_break);
-            }
-
-            if has_condition {
-                add!(self, ") ");
-            }
-
-            self.add_advance_action(action);
-            add!(self, "\n");
+            })
         }
-
-        add_line!(self, "END_STATE();");
     }
 
     fn add_character_range_conditions(
@@ -1098,7 +1717,9 @@ impl Generator {
         add_line!(self, "");
     }
 
-    fn add_parse_table(&mut self) {
+    /// Compute the entries of the large and small parse tables, and the parse action lists
+    /// that they refer to.
+    fn parse_table_data(&self) -> ParseTableData {
         let mut parse_table_entries = HashMap::new();
         let mut next_parse_action_list_index = 0;
 
@@ -1111,15 +1732,10 @@ impl Generator {
             &mut next_parse_action_list_index,
         );
 
-        add_line!(
-            self,
-            "static const uint16_t ts_parse_table[LARGE_STATE_COUNT][SYMBOL_COUNT] = {{",
-        );
-        indent!(self);
-
         let mut terminal_entries = Vec::new();
         let mut nonterminal_entries = Vec::new();
 
+        let mut large_states = Vec::with_capacity(self.large_state_count);
         for (i, state) in self
             .parse_table
             .states
@@ -1127,9 +1743,6 @@ impl Generator {
             .enumerate()
             .take(self.large_state_count)
         {
-            add_line!(self, "[{i}] = {{");
-            indent!(self);
-
             // Ensure the entries are in a deterministic order, since they are
             // internally represented as a hash map.
             terminal_entries.clear();
@@ -1139,25 +1752,132 @@ impl Generator {
             terminal_entries.sort_unstable_by_key(|e| self.symbol_order.get(e.0));
             nonterminal_entries.sort_unstable_by_key(|k| k.0);
 
+            let mut entries =
+                Vec::with_capacity(nonterminal_entries.len() + terminal_entries.len());
             for (symbol, action) in &nonterminal_entries {
-                add_line!(
-                    self,
-                    "[{}] = STATE({}),",
-                    self.symbol_ids[symbol],
-                    match action {
-                        GotoAction::Goto(state) => *state,
-                        GotoAction::ShiftExtra => i,
-                    }
+                let state_id = match action {
+                    GotoAction::Goto(state) => *state,
+                    GotoAction::ShiftExtra => i,
+                };
+                entries.push((**symbol, state_id));
+            }
+
+            for (symbol, entry) in &terminal_entries {
+                let entry_id = self.get_parse_action_list_id(
+                    entry,
+                    &mut parse_table_entries,
+                    &mut next_parse_action_list_index,
                 );
+                entries.push((**symbol, entry_id));
             }
+            large_states.push(entries);
+        }
+
+        let mut index = 0;
+        let mut small_state_indices = Vec::new();
+        let mut small_states = Vec::new();
+        let mut shared_small_state_indices = HashMap::new();
+        let mut symbols_by_value = HashMap::<(usize, SymbolType), Vec<Symbol>>::new();
+        for state in self.parse_table.states.iter().skip(self.large_state_count) {
+            small_state_indices.push(index);
+            symbols_by_value.clear();
+
+            terminal_entries.clear();
+            terminal_entries.extend(state.terminal_entries.iter());
+            terminal_entries.sort_unstable_by_key(|e| self.symbol_order.get(e.0));
 
+            // In a given parse state, many lookahead symbols have the same actions.
+            // So in the "small state" representation, group symbols by their action
+            // in order to avoid repeating the action.
             for (symbol, entry) in &terminal_entries {
                 let entry_id = self.get_parse_action_list_id(
                     entry,
                     &mut parse_table_entries,
                     &mut next_parse_action_list_index,
                 );
-                add_line!(self, "[{}] = ACTIONS({entry_id}),", self.symbol_ids[symbol]);
+                symbols_by_value
+                    .entry((entry_id, SymbolType::Terminal))
+                    .or_default()
+                    .push(**symbol);
+            }
+            for (symbol, action) in &state.nonterminal_entries {
+                let state_id = match action {
+                    GotoAction::Goto(i) => *i,
+                    GotoAction::ShiftExtra => {
+                        self.large_state_count + small_state_indices.len() - 1
+                    }
+                };
+                symbols_by_value
+                    .entry((state_id, SymbolType::NonTerminal))
+                    .or_default()
+                    .push(*symbol);
+            }
+
+            let mut values_with_symbols = symbols_by_value.drain().collect::<Vec<_>>();
+            values_with_symbols.sort_unstable_by_key(|((value, kind), symbols)| {
+                (symbols.len(), *kind, *value, symbols[0])
+            });
+            for (_, symbols) in &mut values_with_symbols {
+                symbols.sort_unstable();
+            }
+
+            // When optimizing for size, states with identical entries share them.
+            if self.optimize_size {
+                match shared_small_state_indices.entry(values_with_symbols.clone()) {
+                    Entry::Occupied(e) => {
+                        *small_state_indices.last_mut().unwrap() = *e.get();
+                        continue;
+                    }
+                    Entry::Vacant(e) => {
+                        e.insert(index);
+                    }
+                }
+            }
+
+            let entry_count = 1 + values_with_symbols
+                .iter()
+                .map(|(_, symbols)| 2 + symbols.len())
+                .sum::<usize>();
+            small_states.push((index, values_with_symbols));
+            index += entry_count;
+        }
+
+        let mut parse_action_lists = parse_table_entries
+            .into_iter()
+            .map(|(entry, i)| (i, entry))
+            .collect::<Vec<_>>();
+        parse_action_lists.sort_by_key(|(index, _)| *index);
+
+        ParseTableData {
+            large_states,
+            small_state_indices,
+            small_states,
+            parse_action_lists,
+        }
+    }
+
+    fn add_parse_table(&mut self) {
+        let ParseTableData {
+            large_states,
+            small_state_indices,
+            small_states,
+            parse_action_lists,
+        } = self.parse_table_data();
+
+        add_line!(
+            self,
+            "static const uint16_t ts_parse_table[LARGE_STATE_COUNT][SYMBOL_COUNT] = {{",
+        );
+        indent!(self);
+        for (i, entries) in large_states.iter().enumerate() {
+            add_line!(self, "[{i}] = {{");
+            indent!(self);
+            for (symbol, value) in entries {
+                if symbol.is_non_terminal() {
+                    add_line!(self, "[{}] = STATE({value}),", self.symbol_ids[symbol]);
+                } else {
+                    add_line!(self, "[{}] = ACTIONS({value}),", self.symbol_ids[symbol]);
+                }
             }
             dedent!(self);
             add_line!(self, "}},");
@@ -1169,61 +1889,17 @@ impl Generator {
         if self.large_state_count < self.parse_table.states.len() {
             add_line!(self, "static const uint16_t ts_small_parse_table[] = {{");
             indent!(self);
-
-            let mut index = 0;
-            let mut small_state_indices = Vec::new();
-            let mut symbols_by_value = HashMap::<(usize, SymbolType), Vec<Symbol>>::new();
-            for state in self.parse_table.states.iter().skip(self.large_state_count) {
-                small_state_indices.push(index);
-                symbols_by_value.clear();
-
-                terminal_entries.clear();
-                terminal_entries.extend(state.terminal_entries.iter());
-                terminal_entries.sort_unstable_by_key(|e| self.symbol_order.get(e.0));
-
-                // In a given parse state, many lookahead symbols have the same actions.
-                // So in the "small state" representation, group symbols by their action
-                // in order to avoid repeating the action.
-                for (symbol, entry) in &terminal_entries {
-                    let entry_id = self.get_parse_action_list_id(
-                        entry,
-                        &mut parse_table_entries,
-                        &mut next_parse_action_list_index,
-                    );
-                    symbols_by_value
-                        .entry((entry_id, SymbolType::Terminal))
-                        .or_default()
-                        .push(**symbol);
-                }
-                for (symbol, action) in &state.nonterminal_entries {
-                    let state_id = match action {
-                        GotoAction::Goto(i) => *i,
-                        GotoAction::ShiftExtra => {
-                            self.large_state_count + small_state_indices.len() - 1
-                        }
-                    };
-                    symbols_by_value
-                        .entry((state_id, SymbolType::NonTerminal))
-                        .or_default()
-                        .push(*symbol);
-                }
-
-                let mut values_with_symbols = symbols_by_value.drain().collect::<Vec<_>>();
-                values_with_symbols.sort_unstable_by_key(|((value, kind), symbols)| {
-                    (symbols.len(), *kind, *value, symbols[0])
-                });
-
+            for (index, values_with_symbols) in &small_states {
                 add_line!(self, "[{index}] = {},", values_with_symbols.len());
                 indent!(self);
 
-                for ((value, kind), symbols) in &mut values_with_symbols {
+                for ((value, kind), symbols) in values_with_symbols {
                     if *kind == SymbolType::NonTerminal {
                         add_line!(self, "STATE({value}), {},", symbols.len());
                     } else {
                         add_line!(self, "ACTIONS({value}), {},", symbols.len());
                     }
 
-                    symbols.sort_unstable();
                     indent!(self);
                     for symbol in symbols {
                         add_line!(self, "{},", self.symbol_ids[symbol]);
@@ -1232,13 +1908,7 @@ impl Generator {
                 }
 
                 dedent!(self);
-
-                index += 1 + values_with_symbols
-                    .iter()
-                    .map(|(_, symbols)| 2 + symbols.len())
-                    .sum::<usize>();
             }
-
             dedent!(self);
             add_line!(self, "}};");
             add_line!(self, "");
@@ -1248,11 +1918,11 @@ impl Generator {
                 "static const uint32_t ts_small_parse_table_map[] = {{"
             );
             indent!(self);
-            for i in self.large_state_count..self.parse_table.states.len() {
+            for (i, index) in small_state_indices.iter().enumerate() {
                 add_line!(
                     self,
-                    "[SMALL_STATE({i})] = {},",
-                    small_state_indices[i - self.large_state_count]
+                    "[SMALL_STATE({})] = {index},",
+                    self.large_state_count + i
                 );
             }
             dedent!(self);
@@ -1260,12 +1930,7 @@ impl Generator {
             add_line!(self, "");
         }
 
-        let mut parse_table_entries = parse_table_entries
-            .into_iter()
-            .map(|(entry, i)| (i, entry))
-            .collect::<Vec<_>>();
-        parse_table_entries.sort_by_key(|(index, _)| *index);
-        self.add_parse_action_list(parse_table_entries);
+        self.add_parse_action_list(parse_action_lists);
     }
 
     fn add_parse_action_list(&mut self, parse_table_entries: Vec<(usize, ParseTableEntry)>) {
@@ -1443,6 +2108,344 @@ impl Generator {
         add_line!(self, "#endif");
     }
 
+    /// Produce a language data file, which contains the same tables as the generated C code,
+    /// laid out as the runtime reads them, so that `ts_language_load_mmap` can load the
+    /// language without compiling it. Its lex functions are stored as transition tables.
+    ///
+    /// This returns `None` if a lex table has too many states to be stored as a transition
+    /// table.
+    fn language_data(&self) -> Option<Vec<u8>> {
+        let lex_table_fits =
+            |lex_table: &LexTable| lex_table.states.len() < LEX_TABLE_SKIP as usize;
+        if !lex_table_fits(&self.main_lex_table)
+            || (self.keyword_capture_token.is_some() && !lex_table_fits(&self.keyword_lex_table))
+        {
+            return None;
+        }
+
+        // The C code refers to symbols by the identifiers of an enum, so find the value of
+        // each identifier.
+        let symbol_count = self.parse_table.symbols.len();
+        let mut identifier_values = HashMap::new();
+        for symbol in &self.parse_table.symbols {
+            identifier_values.insert(self.symbol_ids[symbol].as_str(), self.symbol_order[symbol]);
+        }
+        for (i, alias) in self.unique_aliases.iter().enumerate() {
+            identifier_values.insert(self.alias_ids[alias].as_str(), symbol_count + i);
+        }
+        let symbol_value =
+            |symbol: &Symbol| identifier_values[self.symbol_ids[symbol].as_str()] as u16;
+        let alias_value = |alias: &Alias| identifier_values[self.alias_ids[alias].as_str()] as u16;
+        let name_count = symbol_count + self.unique_aliases.len();
+
+        let mut sections = vec![Vec::new(); LANGUAGE_DATA_SECTION_COUNT];
+        let mut strings = Vec::new();
+        let mut string_offsets = HashMap::new();
+        let mut add_string = |string: &str| {
+            *string_offsets.entry(string.to_string()).or_insert_with(|| {
+                let offset = strings.len() as u32;
+                strings.extend_from_slice(string.as_bytes());
+                strings.push(0);
+                offset
+            })
+        };
+
+        // Parse table
+        let ParseTableData {
+            large_states,
+            small_state_indices,
+            small_states,
+            parse_action_lists,
+        } = self.parse_table_data();
+        for entries in &large_states {
+            let mut row = vec![0; symbol_count];
+            for (symbol, value) in entries {
+                row[symbol_value(symbol) as usize] = *value as u16;
+            }
+            push_u16s(&mut sections[LANGUAGE_DATA_PARSE_TABLE], row);
+        }
+        let small_parse_table = &mut sections[LANGUAGE_DATA_SMALL_PARSE_TABLE];
+        for (index, values_with_symbols) in &small_states {
+            assert_eq!(small_parse_table.len(), index * size_of::<u16>());
+            push_u16s(small_parse_table, [values_with_symbols.len() as u16]);
+            for ((value, _), symbols) in values_with_symbols {
+                push_u16s(small_parse_table, [*value as u16, symbols.len() as u16]);
+                push_u16s(small_parse_table, symbols.iter().map(symbol_value));
+            }
+        }
+        push_u32s(
+            &mut sections[LANGUAGE_DATA_SMALL_PARSE_TABLE_MAP],
+            small_state_indices.iter().map(|index| *index as u32),
+        );
+        let parse_actions = &mut sections[LANGUAGE_DATA_PARSE_ACTIONS];
+        for (index, entry) in &parse_action_lists {
+            assert_eq!(parse_actions.len(), index * PARSE_ACTION_ENTRY_SIZE);
+            let mut entry_header = [0; PARSE_ACTION_ENTRY_SIZE];
+            entry_header[0] = entry.actions.len() as u8;
+            entry_header[1] = u8::from(entry.reusable);
+            parse_actions.extend_from_slice(&entry_header);
+            for action in &entry.actions {
+                // The layouts of the `shift` and `reduce` variants of a `TSParseAction`.
+                let mut bytes = [0; PARSE_ACTION_ENTRY_SIZE];
+                match action {
+                    ParseAction::Shift {
+                        state,
+                        is_repetition,
+                    } => {
+                        bytes[2..4].copy_from_slice(&(*state as u16).to_le_bytes());
+                        bytes[5] = u8::from(*is_repetition);
+                    }
+                    ParseAction::ShiftExtra => bytes[4] = 1,
+                    ParseAction::Reduce {
+                        symbol,
+                        child_count,
+                        dynamic_precedence,
+                        production_id,
+                        ..
+                    } => {
+                        bytes[0] = 1;
+                        bytes[1] = *child_count as u8;
+                        bytes[2..4].copy_from_slice(&symbol_value(symbol).to_le_bytes());
+                        bytes[4..6].copy_from_slice(&(*dynamic_precedence as i16).to_le_bytes());
+                        bytes[6..8].copy_from_slice(&(*production_id as u16).to_le_bytes());
+                    }
+                    ParseAction::Accept => bytes[0] = 2,
+                    ParseAction::Recover => bytes[0] = 3,
+                }
+                parse_actions.extend_from_slice(&bytes);
+            }
+        }
+
+        // Metadata
+        let mut symbol_names = vec![0; name_count];
+        let mut symbol_metadata = vec![[0; 3]; name_count];
+        let mut public_symbol_map = vec![0; name_count];
+        for symbol in &self.parse_table.symbols {
+            let index = symbol_value(symbol) as usize;
+            symbol_names[index] = add_string(
+                self.default_aliases
+                    .get(symbol)
+                    .map_or(self.metadata_for_symbol(*symbol).0, |alias| {
+                        alias.value.as_str()
+                    }),
+            );
+            let (visible, named, supertype) = match self.default_aliases.get(symbol) {
+                Some(alias) => (true, alias.is_named, false),
+                None => match self.metadata_for_symbol(*symbol).1 {
+                    VariableType::Named => (true, true, false),
+                    VariableType::Anonymous => (true, false, false),
+                    VariableType::Hidden => (
+                        false,
+                        true,
+                        self.syntax_grammar.supertype_symbols.contains(symbol),
+                    ),
+                    VariableType::Auxiliary => (false, false, false),
+                },
+            };
+            symbol_metadata[index] = [u8::from(visible), u8::from(named), u8::from(supertype)];
+            public_symbol_map[index] = symbol_value(&self.symbol_map[symbol]);
+        }
+        for alias in &self.unique_aliases {
+            let index = alias_value(alias) as usize;
+            symbol_names[index] = add_string(&alias.value);
+            symbol_metadata[index] = [1, alias.is_named.into(), 0];
+            public_symbol_map[index] = alias_value(alias);
+        }
+        push_u32s(&mut sections[LANGUAGE_DATA_SYMBOL_NAMES], symbol_names);
+        sections[LANGUAGE_DATA_SYMBOL_METADATA] = symbol_metadata.concat();
+        push_u16s(
+            &mut sections[LANGUAGE_DATA_PUBLIC_SYMBOL_MAP],
+            public_symbol_map,
+        );
+
+        if !self.field_names.is_empty() {
+            let field_names = self
+                .field_names
+                .iter()
+                .map(|name| add_string(name))
+                .collect::<Vec<_>>();
+            push_u32s(&mut sections[LANGUAGE_DATA_FIELD_NAMES], field_names);
+
+            let (field_map_ids, flat_field_maps) = self.field_map_data();
+            for (row_id, length) in field_map_ids {
+                push_u16s(
+                    &mut sections[LANGUAGE_DATA_FIELD_MAP_SLICES],
+                    [row_id as u16, length as u16],
+                );
+            }
+            let field_map_entries = &mut sections[LANGUAGE_DATA_FIELD_MAP_ENTRIES];
+            for (_, field_pairs) in flat_field_maps.into_iter().skip(1) {
+                for (field_name, location) in field_pairs {
+                    let field_id = self.field_names.binary_search(&field_name).unwrap() + 1;
+                    field_map_entries.extend_from_slice(&(field_id as u16).to_le_bytes());
+                    field_map_entries.push(location.index as u8);
+                    field_map_entries.push(location.inherited.into());
+                }
+            }
+        }
+
+        let alias_map = &mut sections[LANGUAGE_DATA_ALIAS_MAP];
+        for (symbol, alias_ids) in self.non_terminal_aliases() {
+            push_u16s(
+                alias_map,
+                [
+                    symbol_value(&symbol),
+                    1 + alias_ids.len() as u16,
+                    symbol_value(&self.symbol_map[&symbol]),
+                ],
+            );
+            push_u16s(
+                alias_map,
+                alias_ids
+                    .iter()
+                    .map(|id| identifier_values[id.as_str()] as u16),
+            );
+        }
+        push_u16s(alias_map, [0]);
+
+        let max_alias_sequence_length = self.parse_table.max_aliased_production_length;
+        for production_info in &self.parse_table.production_infos {
+            let mut aliases = vec![0; max_alias_sequence_length];
+            for (j, alias) in production_info.alias_sequence.iter().enumerate() {
+                if let Some(alias) = alias {
+                    aliases[j] = alias_value(alias);
+                }
+            }
+            push_u16s(&mut sections[LANGUAGE_DATA_ALIAS_SEQUENCES], aliases);
+        }
+
+        // Lexing
+        for state in &self.parse_table.states {
+            let lex_mode = if state.is_end_of_non_terminal_extra() {
+                [u16::MAX, 0]
+            } else {
+                [
+                    state.lex_state_id as u16,
+                    state.external_lex_state_id as u16,
+                ]
+            };
+            push_u16s(&mut sections[LANGUAGE_DATA_LEX_MODES], lex_mode);
+        }
+        let main_lex_table = self.lex_table_data(&self.main_lex_table);
+        self.add_lex_table_data(
+            &mut sections[LANGUAGE_DATA_LEX_STATES..],
+            &main_lex_table,
+            &symbol_value,
+        );
+        let keyword_lex_table = self
+            .keyword_capture_token
+            .map(|_| self.lex_table_data(&self.keyword_lex_table));
+        if let Some(keyword_lex_table) = &keyword_lex_table {
+            self.add_lex_table_data(
+                &mut sections[LANGUAGE_DATA_KEYWORD_LEX_STATES..],
+                keyword_lex_table,
+                &symbol_value,
+            );
+        }
+
+        let external_tokens = &self.syntax_grammar.external_tokens;
+        if !external_tokens.is_empty() {
+            for external_lex_state in &self.parse_table.external_lex_states {
+                let mut states = vec![0; external_tokens.len()];
+                for token in external_lex_state.iter() {
+                    states[token.index] = 1;
+                }
+                sections[LANGUAGE_DATA_EXTERNAL_SCANNER_STATES].extend_from_slice(&states);
+            }
+            for (i, token) in external_tokens.iter().enumerate() {
+                let id_token = token
+                    .corresponding_internal_token
+                    .unwrap_or_else(|| Symbol::external(i));
+                push_u16s(
+                    &mut sections[LANGUAGE_DATA_EXTERNAL_SCANNER_SYMBOL_MAP],
+                    [symbol_value(&id_token)],
+                );
+            }
+        }
+
+        if self.abi_version >= ABI_VERSION_WITH_PRIMARY_STATES {
+            let mut first_state_for_each_core_id = HashMap::new();
+            for (idx, state) in self.parse_table.states.iter().enumerate() {
+                let primary_state = first_state_for_each_core_id
+                    .entry(state.core_id)
+                    .or_insert(idx);
+                push_u16s(
+                    &mut sections[LANGUAGE_DATA_PRIMARY_STATE_IDS],
+                    [*primary_state as u16],
+                );
+            }
+        }
+        sections[LANGUAGE_DATA_STRINGS] = strings;
+
+        let mut data = Vec::new();
+        push_u32s(
+            &mut data,
+            [
+                LANGUAGE_DATA_MAGIC,
+                LANGUAGE_DATA_FORMAT_VERSION,
+                self.abi_version as u32,
+                symbol_count as u32,
+                self.unique_aliases.len() as u32,
+                self.token_count() as u32,
+                external_tokens.len() as u32,
+                self.parse_table.states.len() as u32,
+                self.large_state_count as u32,
+                self.parse_table.production_infos.len() as u32,
+                self.field_names.len() as u32,
+                max_alias_sequence_length as u32,
+                self.keyword_capture_token
+                    .map_or(0, |token| symbol_value(&token).into()),
+                main_lex_table.ascii_class_count as u32,
+                keyword_lex_table.map_or(0, |table| table.ascii_class_count as u32),
+                LANGUAGE_DATA_SECTION_COUNT as u32,
+            ],
+        );
+        let align = |offset: usize| offset.next_multiple_of(LANGUAGE_DATA_ALIGNMENT);
+        let mut offset = align(data.len() + LANGUAGE_DATA_SECTION_COUNT * 2 * size_of::<u32>());
+        for section in &sections {
+            push_u32s(&mut data, [offset as u32, section.len() as u32]);
+            offset = align(offset + section.len());
+        }
+        for section in &sections {
+            data.resize(align(data.len()), 0);
+            data.extend_from_slice(section);
+        }
+        Some(data)
+    }
+
+    /// Write the sections of a `TSLexTable` to the four sections of a language data file that
+    /// hold its states, ASCII classes, ASCII rows and ranges.
+    fn add_lex_table_data(
+        &self,
+        sections: &mut [Vec<u8>],
+        lex_table: &LexTableData,
+        symbol_value: &impl Fn(&Symbol) -> u16,
+    ) {
+        for state in &lex_table.states {
+            let accept_symbol = state.accept_symbol.as_ref().map_or(0, symbol_value);
+            push_u16s(&mut sections[0], [accept_symbol]);
+            sections[0].extend_from_slice(&[state.accept_symbol.is_some().into(), 0]);
+            push_u16s(
+                &mut sections[0],
+                [
+                    state.eof_action,
+                    state.row_id as u16,
+                    state.range_count as u16,
+                    0,
+                ],
+            );
+            push_u32s(&mut sections[0], [state.range_index as u32]);
+        }
+        sections[1].extend(lex_table.ascii_classes.iter().map(|class| *class as u8));
+        for row in &lex_table.rows {
+            push_u16s(&mut sections[2], row.iter().copied());
+        }
+        for (start, end, action) in &lex_table.ranges {
+            push_u32s(&mut sections[3], [*start, *end]);
+            push_u16s(&mut sections[3], [*action, 0]);
+        }
+    }
+
     fn get_parse_action_list_id(
         &self,
         entry: &ParseTableEntry,
@@ -1691,6 +2694,13 @@ impl Generator {
 /// * `abi_version` - The language ABI version that should be generated. Usually you want
 ///   Tree-sitter's current version, but right after making an ABI change, it may be useful to
 ///   generate code with the previous ABI.
+/// * `lexer_mode` - Whether the lex functions should be rendered as `switch` statements or as
+///   transition tables.
+/// * `optimize_size` - Whether the parse table should be laid out to minimize its size, rather
+///   than to make the actions of the states with many entries quick to look up.
+/// * `emit_language_data` - Whether to also produce a language data file, which contains the
+///   same tables, and can be loaded at runtime without being compiled. It is `None` if it was
+///   not requested, or if the grammar's lex tables have too many states to be stored in one.
 #[allow(clippy::too_many_arguments)]
 pub fn render_c_code(
     name: &str,
@@ -1699,7 +2709,10 @@ pub fn render_c_code(
     lexical_grammar: LexicalGrammar,
     default_aliases: AliasMap,
     abi_version: usize,
-) -> String {
+    lexer_mode: LexerMode,
+    optimize_size: bool,
+    emit_language_data: bool,
+) -> (String, Option<Vec<u8>>) {
     assert!(
         (ABI_VERSION_MIN..=ABI_VERSION_MAX).contains(&abi_version),
         "This version of Tree-sitter can only generate parsers with ABI version {ABI_VERSION_MIN} - {ABI_VERSION_MAX}, not {abi_version}",
@@ -1710,6 +2723,7 @@ pub fn render_c_code(
         indent_level: 0,
         language_name: name.to_string(),
         large_state_count: 0,
+        parse_table_sizes: ParseTableSizes::default(),
         parse_table: tables.parse_table,
         main_lex_table: tables.main_lex_table,
         keyword_lex_table: tables.keyword_lex_table,
@@ -1725,7 +2739,22 @@ pub fn render_c_code(
         symbol_map: HashMap::new(),
         unique_aliases: Vec::new(),
         field_names: Vec::new(),
+        lexer_mode,
+        optimize_size,
+        emit_language_data,
         abi_version,
     }
     .generate()
 }
+
+fn push_u16s(data: &mut Vec<u8>, values: impl IntoIterator<Item = u16>) {
+    for value in values {
+        data.extend_from_slice(&value.to_le_bytes());
+    }
+}
+
+fn push_u32s(data: &mut Vec<u8>, values: impl IntoIterator<Item = u32>) {
+    for value in values {
+        data.extend_from_slice(&value.to_le_bytes());
+    }
+}
@@ -1,10 +1,11 @@
 use std::{collections::HashMap, fmt};
 
+use serde::{Deserialize, Deserializer, Serialize, Serializer};
 use smallbitvec::SmallBitVec;
 
 use super::grammars::VariableType;
 
-#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash, PartialOrd, Ord)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash, PartialOrd, Ord, Serialize, Deserialize)]
 pub enum SymbolType {
     External,
     End,
@@ -19,7 +20,7 @@ pub enum Associativity {
     Right,
 }
 
-#[derive(Clone, Debug, PartialEq, Eq, Hash, PartialOrd, Ord)]
+#[derive(Clone, Debug, PartialEq, Eq, Hash, PartialOrd, Ord, Serialize, Deserialize)]
 pub struct Alias {
     pub value: String,
     pub is_named: bool,
@@ -48,7 +49,7 @@ pub struct MetadataParams {
     pub field_name: Option<String>,
 }
 
-#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash, PartialOrd, Ord)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash, PartialOrd, Ord, Serialize, Deserialize)]
 pub struct Symbol {
     pub kind: SymbolType,
     pub index: usize,
@@ -439,6 +440,37 @@ impl TokenSet {
     }
 }
 
+// Token sets are serialized with the exact lengths of their bit vectors, because those
+// lengths affect equality.
+impl Serialize for TokenSet {
+    fn serialize<S: Serializer>(&self, serializer: S) -> Result<S::Ok, S::Error> {
+        (
+            self.terminal_bits.iter().collect::<Vec<_>>(),
+            self.external_bits.iter().collect::<Vec<_>>(),
+            self.eof,
+            self.end_of_nonterminal_extra,
+        )
+            .serialize(serializer)
+    }
+}
+
+impl<'de> Deserialize<'de> for TokenSet {
+    fn deserialize<D: Deserializer<'de>>(deserializer: D) -> Result<Self, D::Error> {
+        let (terminals, externals, eof, end_of_nonterminal_extra) =
+            <(Vec<bool>, Vec<bool>, bool, bool)>::deserialize(deserializer)?;
+        let mut result = Self::new();
+        for bit in terminals {
+            result.terminal_bits.push(bit);
+        }
+        for bit in externals {
+            result.external_bits.push(bit);
+        }
+        result.eof = eof;
+        result.end_of_nonterminal_extra = end_of_nonterminal_extra;
+        Ok(result)
+    }
+}
+
 impl FromIterator<Symbol> for TokenSet {
     fn from_iter<T: IntoIterator<Item = Symbol>>(iter: T) -> Self {
         let mut result = Self::new();
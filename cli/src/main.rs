@@ -9,11 +9,12 @@ use anyhow::{anyhow, Context, Result};
 use clap::{crate_authors, Args, Command, FromArgMatches as _, Subcommand};
 use glob::glob;
 use regex::Regex;
-use tree_sitter::{ffi, Parser, Point};
+use tree_sitter::{ffi, Language, Parser, Point};
 use tree_sitter_cli::{
     fuzz::{
-        fuzz_language_corpus, FuzzOptions, EDIT_COUNT, ITERATION_COUNT, LOG_ENABLED,
-        LOG_GRAPH_ENABLED, START_SEED,
+        fuzz_language_corpus,
+        perf::{fuzz_language_performance, PerfFuzzOptions},
+        FuzzOptions, EDIT_COUNT, ITERATION_COUNT, LOG_ENABLED, LOG_GRAPH_ENABLED, START_SEED,
     },
     generate::{self, lookup_package_json_for_path},
     highlight, logger,
@@ -40,6 +41,7 @@ enum Commands {
     Parse(Parse),
     Test(Test),
     Fuzz(Fuzz),
+    FuzzPerf(FuzzPerf),
     Query(Query),
     Highlight(Highlight),
     Tags(Tags),
@@ -70,8 +72,35 @@ struct Generate {
                 )
     )]
     pub abi_version: Option<String>,
+    #[arg(
+        long,
+        value_name = "MODE",
+        help = concat!(
+            "Select how the lex functions are generated: as `switch` statements (default), ",
+            "or as compact transition `table`s"
+        )
+    )]
+    pub lexer: Option<String>,
+    #[arg(
+        long,
+        help = "Lay out the parse table to minimize its size, rather than its lookup time"
+    )]
+    pub optimize_size: bool,
+    #[arg(
+        long,
+        help = concat!(
+            "Also write the parser's tables to `src/parser.bin`, a language data file that ",
+            "can be loaded at runtime without being compiled"
+        )
+    )]
+    pub emit_language_data: bool,
     #[arg(long, help = "Don't generate language bindings")]
     pub no_bindings: bool,
+    #[arg(
+        long,
+        help = "Don't use the cache of parse and lex tables in the user's cache directory"
+    )]
+    pub no_cache: bool,
     #[arg(
         long,
         short = 'b',
@@ -187,6 +216,13 @@ struct Parse {
     #[arg(long, short = 'n', help = "Parse the contents of a specific test")]
     #[clap(conflicts_with = "paths", conflicts_with = "paths_file")]
     pub test_number: Option<u32>,
+    #[arg(
+        long,
+        short,
+        help = "Parse the files on this many threads, writing their output in the same order"
+    )]
+    #[clap(conflicts_with_all = ["debug", "debug_graph", "output_dot", "wasm"])]
+    pub jobs: Option<usize>,
 }
 
 #[derive(Args)]
@@ -265,6 +301,55 @@ struct Fuzz {
     pub log: bool,
 }
 
+#[derive(Args)]
+#[command(about = "Fuzz a parser and its highlights query for slow inputs")]
+struct FuzzPerf {
+    #[arg(long, help = "Subdirectory to the language")]
+    pub subdir: Option<String>,
+    #[arg(long, help = "Maximum number of edits to perform per fuzz test")]
+    pub edits: Option<usize>,
+    #[arg(long, help = "Number of fuzzing iterations to run per test")]
+    pub iterations: Option<usize>,
+    #[arg(
+        long,
+        short,
+        help = "Only fuzz corpus test cases whose name matches the given regex"
+    )]
+    pub include: Option<Regex>,
+    #[arg(
+        long,
+        short,
+        help = "Only fuzz corpus test cases whose name does not match the given regex"
+    )]
+    pub exclude: Option<Regex>,
+    #[arg(
+        long,
+        short,
+        help = "Path to the query to measure, instead of `queries/highlights.scm`"
+    )]
+    pub query: Option<String>,
+    #[arg(
+        long,
+        short,
+        default_value_t = 10.0,
+        help = "Flag inputs whose cost per byte exceeds this multiple of the corpus baseline"
+    )]
+    pub multiple: f64,
+    #[arg(
+        long,
+        default_value_t = 32,
+        help = "Ignore inputs shorter than this many bytes, whose cost per byte is noisy"
+    )]
+    pub min_bytes: usize,
+    #[arg(
+        long,
+        short,
+        default_value = "fuzz-results",
+        help = "Directory in which to save the slow inputs that are found"
+    )]
+    pub output: String,
+}
+
 #[derive(Args)]
 #[command(about = "Search files using a syntax tree query", alias = "q")]
 struct Query {
@@ -356,6 +441,12 @@ struct Tags {
     pub paths: Option<Vec<String>>,
     #[arg(long, help = "The path to an alternative config.json file")]
     pub config_path: Option<PathBuf>,
+    #[arg(
+        long,
+        short,
+        help = "Tag the files on this many threads, printing each file's tags as a line of JSON"
+    )]
+    pub jobs: Option<usize>,
 }
 
 #[derive(Args)]
@@ -461,12 +552,30 @@ fn run() -> Result<()> {
                     }
                 },
             );
+            let lexer_mode = match generate_options.lexer.as_deref() {
+                None | Some("switch") => generate::LexerMode::Switch,
+                Some("table") => generate::LexerMode::Table,
+                Some(mode) => {
+                    return Err(anyhow!(
+                        "Invalid lexer mode `{mode}`. Expected `switch` or `table`"
+                    ))
+                }
+            };
+            let cache_dir = if generate_options.no_cache {
+                None
+            } else {
+                dirs::cache_dir().map(|dir| dir.join("tree-sitter").join("generate"))
+            };
             generate::generate_parser_in_directory(
                 &current_dir,
                 generate_options.grammar_path.as_deref(),
                 abi_version,
+                lexer_mode,
+                generate_options.optimize_size,
+                generate_options.emit_language_data,
                 !generate_options.no_bindings,
                 generate_options.report_states_for_rule.as_deref(),
+                cache_dir.as_deref(),
                 generate_options.js_runtime.as_deref(),
             )?;
             if generate_options.build {
@@ -548,7 +657,12 @@ fn run() -> Result<()> {
                 match encoding.as_str() {
                     "utf16" => Some(ffi::TSInputEncodingUTF16),
                     "utf8" => Some(ffi::TSInputEncodingUTF8),
-                    _ => return Err(anyhow!("Invalid encoding. Expected one of: utf8, utf16")),
+                    "latin1" => Some(ffi::TSInputEncodingLatin1),
+                    _ => {
+                        return Err(anyhow!(
+                            "Invalid encoding. Expected one of: utf8, utf16, latin1"
+                        ))
+                    }
                 }
             } else {
                 None
@@ -596,51 +710,64 @@ fn run() -> Result<()> {
 
             let should_track_stats = parse_options.stat;
             let mut stats = parse::Stats::default();
-
-            for path in &paths {
-                let path = Path::new(&path);
-
-                let language = if let Some(ref language) = language {
-                    language.clone()
+            let edits = edits
+                .iter()
+                .map(std::string::String::as_str)
+                .collect::<Vec<&str>>();
+            let opts = |path, language: &Language| ParseFileOptions {
+                language: language.clone(),
+                path,
+                edits: &edits,
+                max_path_length,
+                output,
+                print_time: time,
+                timeout,
+                debug: parse_options.debug,
+                debug_graph: parse_options.debug_graph,
+                cancellation_flag: Some(&cancellation_flag),
+                encoding,
+                open_log: parse_options.open_log,
+            };
+            let select_language = |path| {
+                if let Some(ref language) = language {
+                    Ok(language.clone())
                 } else {
-                    loader.select_language(path, &current_dir, parse_options.scope.as_deref())?
-                };
-                parser
-                    .set_language(&language)
-                    .context("incompatible language")?;
-
-                let opts = ParseFileOptions {
-                    language: language.clone(),
-                    path,
-                    edits: &edits
-                        .iter()
-                        .map(std::string::String::as_str)
-                        .collect::<Vec<&str>>(),
-                    max_path_length,
-                    output,
-                    print_time: time,
-                    timeout,
-                    debug: parse_options.debug,
-                    debug_graph: parse_options.debug_graph,
-                    cancellation_flag: Some(&cancellation_flag),
-                    encoding,
-                    open_log: parse_options.open_log,
-                };
-
-                let parse_result = parse::parse_file_at_path(&mut parser, &opts)?;
+                    loader.select_language(path, &current_dir, parse_options.scope.as_deref())
+                }
+            };
 
-                if should_track_stats {
-                    stats.total_parses += 1;
-                    if parse_result.successful {
-                        stats.successful_parses += 1;
+            if let Some(jobs) = parse_options.jobs {
+                // Select the languages up front, since the loader can't be shared across threads.
+                let files = paths
+                    .iter()
+                    .map(|path| {
+                        let path = Path::new(path);
+                        Ok((path, select_language(path)?))
+                    })
+                    .collect::<Result<Vec<_>>>()?;
+                parse::parse_files_in_parallel(&files, jobs, opts, |path, parse_result| {
+                    if should_track_stats {
+                        stats.add(path, parse_result);
                     }
-                    if let Some(duration) = parse_result.duration {
-                        stats.total_bytes += parse_result.bytes;
-                        stats.total_duration += duration;
+                    has_error |= !parse_result.successful;
+                })?;
+            } else {
+                for path in &paths {
+                    let path = Path::new(&path);
+                    let language = select_language(path)?;
+                    parser
+                        .set_language(&language)
+                        .context("incompatible language")?;
+
+                    let parse_result =
+                        parse::parse_file_at_path(&mut parser, &opts(path, &language))?;
+
+                    if should_track_stats {
+                        stats.add(path, &parse_result);
                     }
-                }
 
-                has_error |= !parse_result.successful;
+                    has_error |= !parse_result.successful;
+                }
             }
 
             if should_track_stats {
@@ -757,6 +884,35 @@ fn run() -> Result<()> {
             );
         }
 
+        Commands::FuzzPerf(fuzz_options) => {
+            loader.sanitize_build(true);
+
+            let languages = loader.languages_at_path(&current_dir)?;
+            let (language, language_name) = &languages
+                .first()
+                .ok_or_else(|| anyhow!("No language found"))?;
+
+            let mut fuzz_options = PerfFuzzOptions {
+                subdir: fuzz_options.subdir,
+                edits: fuzz_options.edits.unwrap_or(*EDIT_COUNT),
+                iterations: fuzz_options.iterations.unwrap_or(*ITERATION_COUNT),
+                include: fuzz_options.include,
+                exclude: fuzz_options.exclude,
+                query_path: fuzz_options.query,
+                multiple: fuzz_options.multiple,
+                min_bytes: fuzz_options.min_bytes,
+                output_dir: fuzz_options.output,
+            };
+
+            fuzz_language_performance(
+                language,
+                language_name,
+                *START_SEED,
+                &current_dir,
+                &mut fuzz_options,
+            )?;
+        }
+
         Commands::Query(query_options) => {
             let config = Config::load(query_options.config_path)?;
             let paths = collect_paths(query_options.paths_file.as_deref(), query_options.paths)?;
@@ -917,6 +1073,7 @@ fn run() -> Result<()> {
                 &paths,
                 tags_options.quiet,
                 tags_options.time,
+                tags_options.jobs,
             )?;
         }
 
@@ -1,8 +1,12 @@
 use std::{
     fmt, fs,
     io::{self, Write},
-    path::Path,
-    sync::atomic::AtomicUsize,
+    path::{Path, PathBuf},
+    sync::{
+        atomic::{AtomicBool, AtomicUsize, Ordering},
+        mpsc,
+    },
+    thread,
     time::{Duration, Instant},
 };
 
@@ -12,17 +16,48 @@ use tree_sitter::{ffi, InputEdit, Language, LogType, Parser, Point, Tree};
 use super::util;
 use crate::fuzz::edits::Edit;
 
+// The number of files listed as the slowest ones in the summary of `--stat`.
+const SLOWEST_FILE_COUNT: usize = 10;
+
 #[derive(Debug, Default)]
 pub struct Stats {
     pub successful_parses: usize,
     pub total_parses: usize,
+    pub timed_out_parses: usize,
     pub total_bytes: usize,
     pub total_duration: Duration,
+    /// The path, size and duration of each parse that finished.
+    pub file_timings: Vec<(PathBuf, usize, Duration)>,
+}
+
+impl Stats {
+    pub fn add(&mut self, path: &Path, result: &ParseResult) {
+        self.total_parses += 1;
+        if result.successful {
+            self.successful_parses += 1;
+        }
+        if let Some(duration) = result.duration {
+            self.total_bytes += result.bytes;
+            self.total_duration += duration;
+            self.file_timings
+                .push((path.to_owned(), result.bytes, duration));
+        } else {
+            self.timed_out_parses += 1;
+        }
+    }
+}
+
+fn bytes_per_ms(bytes: usize, duration: Duration) -> u128 {
+    let duration_us = duration.as_micros();
+    if duration_us != 0 {
+        ((bytes as u128) * 1_000) / duration_us
+    } else {
+        0
+    }
 }
 
 impl fmt::Display for Stats {
     fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
-        let duration_us = self.total_duration.as_micros();
         writeln!(
             f,
             "Total parses: {}; successful parses: {}; failed parses: {}; success percentage: {:.2}%; average speed: {} bytes/ms",
@@ -30,12 +65,45 @@ impl fmt::Display for Stats {
             self.successful_parses,
             self.total_parses - self.successful_parses,
             ((self.successful_parses as f64) / (self.total_parses as f64)) * 100.0,
-            if duration_us != 0 {
-                ((self.total_bytes as u128) * 1_000) / duration_us
-            } else {
-                0
-            }
-        )
+            bytes_per_ms(self.total_bytes, self.total_duration),
+        )?;
+        if self.timed_out_parses > 0 {
+            writeln!(f, "Timed out parses: {}", self.timed_out_parses)?;
+        }
+        if self.file_timings.len() < 2 {
+            return Ok(());
+        }
+
+        let mut speeds = self
+            .file_timings
+            .iter()
+            .map(|(_, bytes, duration)| bytes_per_ms(*bytes, *duration))
+            .collect::<Vec<_>>();
+        speeds.sort_unstable();
+        let percentile = |p: usize| speeds[(speeds.len() - 1) * p / 100];
+        writeln!(
+            f,
+            "Speed percentiles: min: {} bytes/ms; p10: {} bytes/ms; p50: {} bytes/ms; p90: {} bytes/ms; max: {} bytes/ms",
+            percentile(0),
+            percentile(10),
+            percentile(50),
+            percentile(90),
+            percentile(100),
+        )?;
+
+        let mut slowest = self.file_timings.iter().collect::<Vec<_>>();
+        slowest.sort_by(|a, b| b.2.cmp(&a.2).then_with(|| a.0.cmp(&b.0)));
+        writeln!(f, "Slowest files:")?;
+        for (path, bytes, duration) in slowest.into_iter().take(SLOWEST_FILE_COUNT) {
+            writeln!(
+                f,
+                "  {}\t{:>7.2} ms\t{:>6} bytes/ms",
+                path.display(),
+                duration.as_micros() as f64 / 1e3,
+                bytes_per_ms(*bytes, *duration),
+            )?;
+        }
+        Ok(())
     }
 }
 
@@ -70,6 +138,15 @@ pub struct ParseResult {
 }
 
 pub fn parse_file_at_path(parser: &mut Parser, opts: &ParseFileOptions) -> Result<ParseResult> {
+    parse_file_at_path_to(parser, opts, &mut io::stdout().lock())
+}
+
+/// Parse a file like [`parse_file_at_path`], writing the output to `stdout`.
+fn parse_file_at_path_to(
+    parser: &mut Parser,
+    opts: &ParseFileOptions,
+    stdout: &mut impl Write,
+) -> Result<ParseResult> {
     let mut _log_session = None;
     parser.set_language(&opts.language)?;
     let mut source_code = fs::read(opts.path)
@@ -111,6 +188,9 @@ pub fn parse_file_at_path(parser: &mut Parser, opts: &ParseFileOptions) -> Resul
                 .collect::<Vec<_>>();
             parser.parse_utf16(&source_code_utf16, None)
         }
+        Some(encoding) if encoding == ffi::TSInputEncodingLatin1 => {
+            parser.parse_latin1(&source_code, None)
+        }
         None if source_code.len() >= 2 && is_utf16_bom(&source_code[0..2]) => {
             let source_code_utf16 = source_code
                 .chunks_exact(2)
@@ -123,12 +203,9 @@ pub fn parse_file_at_path(parser: &mut Parser, opts: &ParseFileOptions) -> Resul
 
     parser.stop_printing_dot_graphs();
 
-    let stdout = io::stdout();
-    let mut stdout = stdout.lock();
-
     if let Some(mut tree) = tree {
         if opts.debug_graph && !opts.edits.is_empty() {
-            println!("BEFORE:\n{}", String::from_utf8_lossy(&source_code));
+            writeln!(stdout, "BEFORE:\n{}", String::from_utf8_lossy(&source_code))?;
         }
 
         for (i, edit) in opts.edits.iter().enumerate() {
@@ -137,7 +214,11 @@ pub fn parse_file_at_path(parser: &mut Parser, opts: &ParseFileOptions) -> Resul
             tree = parser.parse(&source_code, Some(&tree)).unwrap();
 
             if opts.debug_graph {
-                println!("AFTER {i}:\n{}", String::from_utf8_lossy(&source_code));
+                writeln!(
+                    stdout,
+                    "AFTER {i}:\n{}",
+                    String::from_utf8_lossy(&source_code)
+                )?;
             }
         }
 
@@ -176,10 +257,10 @@ pub fn parse_file_at_path(parser: &mut Parser, opts: &ParseFileOptions) -> Resul
                         let start = node.start_position();
                         let end = node.end_position();
                         if let Some(field_name) = cursor.field_name() {
-                            write!(&mut stdout, "{field_name}: ")?;
+                            write!(stdout, "{field_name}: ")?;
                         }
                         write!(
-                            &mut stdout,
+                            stdout,
                             "({} [{}, {}] - [{}, {}]",
                             node.kind(),
                             start.row,
@@ -198,7 +279,7 @@ pub fn parse_file_at_path(parser: &mut Parser, opts: &ParseFileOptions) -> Resul
                 }
             }
             cursor.reset(tree.root_node());
-            println!();
+            writeln!(stdout)?;
         }
 
         if opts.output == ParseOutput::Xml {
@@ -207,7 +288,7 @@ pub fn parse_file_at_path(parser: &mut Parser, opts: &ParseFileOptions) -> Resul
             let mut did_visit_children = false;
             let mut had_named_children = false;
             let mut tags = Vec::<&str>::new();
-            writeln!(&mut stdout, "<?xml version=\"1.0\"?>")?;
+            writeln!(stdout, "<?xml version=\"1.0\"?>")?;
             loop {
                 let node = cursor.node();
                 let is_named = node.is_named();
@@ -219,7 +300,7 @@ pub fn parse_file_at_path(parser: &mut Parser, opts: &ParseFileOptions) -> Resul
                                 stdout.write_all(b"  ")?;
                             }
                         }
-                        write!(&mut stdout, "</{}>", tag.expect("there is a tag"))?;
+                        write!(stdout, "</{}>", tag.expect("there is a tag"))?;
                         // we only write a line in the case where it's the last sibling
                         if let Some(parent) = node.parent() {
                             if parent.child(parent.child_count() - 1).unwrap() == node {
@@ -252,17 +333,17 @@ pub fn parse_file_at_path(parser: &mut Parser, opts: &ParseFileOptions) -> Resul
                         for _ in 0..indent_level {
                             stdout.write_all(b"  ")?;
                         }
-                        write!(&mut stdout, "<{}", node.kind())?;
+                        write!(stdout, "<{}", node.kind())?;
                         if let Some(field_name) = cursor.field_name() {
-                            write!(&mut stdout, " field=\"{field_name}\"")?;
+                            write!(stdout, " field=\"{field_name}\"")?;
                         }
                         let start = node.start_position();
                         let end = node.end_position();
-                        write!(&mut stdout, " srow=\"{}\"", start.row)?;
-                        write!(&mut stdout, " scol=\"{}\"", start.column)?;
-                        write!(&mut stdout, " erow=\"{}\"", end.row)?;
-                        write!(&mut stdout, " ecol=\"{}\"", end.column)?;
-                        write!(&mut stdout, ">")?;
+                        write!(stdout, " srow=\"{}\"", start.row)?;
+                        write!(stdout, " scol=\"{}\"", start.column)?;
+                        write!(stdout, " erow=\"{}\"", end.row)?;
+                        write!(stdout, " ecol=\"{}\"", end.column)?;
+                        write!(stdout, ">")?;
                         tags.push(node.kind());
                         needs_newline = true;
                     }
@@ -287,12 +368,12 @@ pub fn parse_file_at_path(parser: &mut Parser, opts: &ParseFileOptions) -> Resul
                                 stdout.write_all(b"  ")?;
                             }
                         }
-                        write!(&mut stdout, "{}", html_escape::encode_text(value))?;
+                        write!(stdout, "{}", html_escape::encode_text(value))?;
                     }
                 }
             }
             cursor.reset(tree.root_node());
-            println!();
+            writeln!(stdout)?;
         }
 
         if opts.output == ParseOutput::Dot {
@@ -317,7 +398,7 @@ pub fn parse_file_at_path(parser: &mut Parser, opts: &ParseFileOptions) -> Resul
 
         if first_error.is_some() || opts.print_time {
             write!(
-                &mut stdout,
+                stdout,
                 "{:width$}\t{duration_ms:>7.2} ms\t{:>6} bytes/ms",
                 opts.path.to_str().unwrap(),
                 (source_code.len() as u128 * 1_000_000) / duration.as_nanos(),
@@ -326,27 +407,23 @@ pub fn parse_file_at_path(parser: &mut Parser, opts: &ParseFileOptions) -> Resul
             if let Some(node) = first_error {
                 let start = node.start_position();
                 let end = node.end_position();
-                write!(&mut stdout, "\t(")?;
+                write!(stdout, "\t(")?;
                 if node.is_missing() {
                     if node.is_named() {
-                        write!(&mut stdout, "MISSING {}", node.kind())?;
+                        write!(stdout, "MISSING {}", node.kind())?;
                     } else {
-                        write!(
-                            &mut stdout,
-                            "MISSING \"{}\"",
-                            node.kind().replace('\n', "\\n")
-                        )?;
+                        write!(stdout, "MISSING \"{}\"", node.kind().replace('\n', "\\n"))?;
                     }
                 } else {
-                    write!(&mut stdout, "{}", node.kind())?;
+                    write!(stdout, "{}", node.kind())?;
                 }
                 write!(
-                    &mut stdout,
+                    stdout,
                     " [{}, {}] - [{}, {}])",
                     start.row, start.column, end.row, end.column
                 )?;
             }
-            writeln!(&mut stdout)?;
+            writeln!(stdout)?;
         }
 
         return Ok(ParseResult {
@@ -360,7 +437,7 @@ pub fn parse_file_at_path(parser: &mut Parser, opts: &ParseFileOptions) -> Resul
         let duration = time.elapsed();
         let duration_ms = duration.as_micros() as f64 / 1e3;
         writeln!(
-            &mut stdout,
+            stdout,
             "{:width$}\t{duration_ms:>7.2} ms\t(timed out)",
             opts.path.to_str().unwrap(),
             width = opts.max_path_length
@@ -374,6 +451,67 @@ pub fn parse_file_at_path(parser: &mut Parser, opts: &ParseFileOptions) -> Resul
     })
 }
 
+/// Parse many files on `jobs` threads, each with its own parser. Each file's output is
+/// buffered, and written to stdout in the order of `files`, and `on_result` is called in
+/// that order too, so neither depends on how the files were divided among the threads.
+/// Stops at the first file that can't be parsed, after the output of the files before it.
+pub fn parse_files_in_parallel<'a>(
+    files: &[(&'a Path, Language)],
+    jobs: usize,
+    opts: impl Fn(&'a Path, &Language) -> ParseFileOptions<'a> + Sync,
+    mut on_result: impl FnMut(&Path, &ParseResult),
+) -> Result<()> {
+    let next_index = AtomicUsize::new(0);
+    let stopped = AtomicBool::new(false);
+    let (sender, receiver) = mpsc::channel();
+
+    thread::scope(|scope| {
+        for _ in 0..jobs.max(1) {
+            let sender = sender.clone();
+            let (next_index, stopped, opts) = (&next_index, &stopped, &opts);
+            scope.spawn(move || {
+                let mut parser = Parser::new();
+                while !stopped.load(Ordering::Relaxed) {
+                    let index = next_index.fetch_add(1, Ordering::Relaxed);
+                    let Some((path, language)) = files.get(index) else {
+                        break;
+                    };
+                    let mut output = Vec::new();
+                    let result =
+                        parse_file_at_path_to(&mut parser, &opts(path, language), &mut output);
+                    if sender.send((index, output, result)).is_err() {
+                        break;
+                    }
+                }
+            });
+        }
+        drop(sender);
+
+        // Write the results in order, holding on to the ones that arrive early.
+        let mut pending = Vec::new();
+        pending.resize_with(files.len(), || None);
+        let mut next_to_write = 0;
+        let stdout = io::stdout();
+        for (index, output, result) in receiver {
+            pending[index] = Some((output, result));
+            while let Some((output, result)) = pending.get_mut(next_to_write).and_then(Option::take)
+            {
+                let written = stdout.lock().write_all(&output);
+                let result = written.map_err(anyhow::Error::from).and(result);
+                match result {
+                    Ok(result) => on_result(files[next_to_write].0, &result),
+                    Err(e) => {
+                        stopped.store(true, Ordering::Relaxed);
+                        return Err(e);
+                    }
+                }
+                next_to_write += 1;
+            }
+        }
+        Ok(())
+    })
+}
+
 pub fn perform_edit(tree: &mut Tree, input: &mut Vec<u8>, edit: &Edit) -> Result<InputEdit> {
     let start_byte = edit.position;
     let old_end_byte = edit.position + edit.deleted_length;
@@ -1,14 +1,17 @@
 use std::{
     fs,
     io::{self, Write},
+    ops::Range,
     path::Path,
     str,
+    sync::Mutex,
     time::Instant,
 };
 
 use anyhow::{anyhow, Result};
+use serde::Serialize;
 use tree_sitter_loader::{Config, Loader};
-use tree_sitter_tags::TagsContext;
+use tree_sitter_tags::{generate_tags_in_parallel, TagsConfiguration, TagsContext};
 
 use super::util;
 
@@ -19,6 +22,7 @@ pub fn generate_tags(
     paths: &[String],
     quiet: bool,
     time: bool,
+    jobs: Option<usize>,
 ) -> Result<()> {
     let mut lang = None;
     if let Some(scope) = scope {
@@ -28,6 +32,31 @@ pub fn generate_tags(
         }
     }
 
+    if let Some(jobs) = jobs {
+        // Find the configurations up front, since the loader can't be shared across threads.
+        let mut documents = Vec::with_capacity(paths.len());
+        for path in paths {
+            let path = Path::new(path);
+            let (language, language_config) = match lang.clone() {
+                Some(v) => v,
+                None => {
+                    if let Some(v) = loader.language_configuration_for_file_name(path)? {
+                        v
+                    } else {
+                        eprintln!("{}", util::lang_not_found_for_path(path, loader_config));
+                        continue;
+                    }
+                }
+            };
+            if let Some(tags_config) = language_config.tags_config(language)? {
+                documents.push((path, tags_config));
+            } else {
+                eprintln!("No tags config found for path {path:?}");
+            }
+        }
+        return generate_tags_with_jobs(&documents, jobs, quiet, time);
+    }
+
     let mut context = TagsContext::new();
     let cancellation_flag = util::cancel_on_signal();
     let stdout = io::stdout();
@@ -96,3 +125,82 @@ pub fn generate_tags(
 
     Ok(())
 }
+
+/// The tags of one file, as a line of JSON in the output of `--jobs`.
+#[derive(Serialize)]
+struct JsonTags<'a> {
+    path: &'a str,
+    tags: Vec<JsonTag<'a>>,
+}
+
+#[derive(Serialize)]
+struct JsonTag<'a> {
+    name: &'a str,
+    syntax_type: &'a str,
+    is_definition: bool,
+    start: [usize; 2],
+    end: [usize; 2],
+    line: &'a str,
+    #[serde(skip_serializing_if = "Option::is_none")]
+    docs: Option<&'a str>,
+}
+
+fn generate_tags_with_jobs(
+    documents: &[(&Path, &TagsConfiguration)],
+    jobs: usize,
+    quiet: bool,
+    time: bool,
+) -> Result<()> {
+    let cancellation_flag = util::cancel_on_signal();
+    let stdout = Mutex::new(io::stdout());
+    let t0 = Instant::now();
+    generate_tags_in_parallel(
+        documents,
+        jobs,
+        Some(&cancellation_flag),
+        &stdout,
+        |(path, tags_config)| match fs::read(path) {
+            Ok(source) => Some((*tags_config, source)),
+            Err(e) => {
+                eprintln!("Failed to read {}: {e}", path.display());
+                None
+            }
+        },
+        |output, (path, _), tags_config, source, tags| {
+            let tags = match tags {
+                Ok(tags) => tags,
+                Err(e) => {
+                    eprintln!("Failed to tag {}: {e}", path.display());
+                    return Ok(());
+                }
+            };
+            if quiet {
+                return Ok(());
+            }
+            let path = path.to_string_lossy();
+            let text = |range: &Range<usize>| str::from_utf8(&source[range.clone()]).unwrap_or("");
+            let tags = JsonTags {
+                path: &path,
+                tags: tags
+                    .iter()
+                    .map(|tag| JsonTag {
+                        name: text(&tag.name_range),
+                        syntax_type: tags_config.syntax_type_name(tag.syntax_type_id),
+                        is_definition: tag.is_definition,
+                        start: [tag.span.start.row, tag.span.start.column],
+                        end: [tag.span.end.row, tag.span.end.column],
+                        line: text(&tag.line_range),
+                        docs: tag.docs.as_deref(),
+                    })
+                    .collect(),
+            };
+            serde_json::to_writer(&mut *output, &tags)?;
+            output.push(b'\n');
+            Ok(())
+        },
+    )?;
+    if time {
+        eprintln!("time: {}ms", t0.elapsed().as_millis());
+    }
+    Ok(())
+}
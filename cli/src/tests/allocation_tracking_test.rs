@@ -0,0 +1,104 @@
+// For some reasons `Command::spawn` doesn't work in CI env for many exotic arches.
+#![cfg(all(any(target_arch = "x86_64", target_arch = "x86"), not(sanitizing)))]
+
+use std::{
+    env::VarError,
+    process::{Command, Stdio},
+};
+
+use tree_sitter::{
+    allocation_stats, reset_allocation_stats, set_allocation_tracking, total_allocation_stats,
+    AllocationCategory, Parser, Query, QueryCursor,
+};
+
+use super::helpers::fixtures::get_language;
+
+// Allocation tracking can only be switched on or off while the library has no
+// live objects, and its counters are shared by every thread. So the test runs
+// in a child process of its own, where no other test can allocate anything.
+#[test]
+fn test_allocation_tracking() {
+    let test_name = "test_allocation_tracking";
+    let test_var = "CARGO_ALLOCATION_TRACKING_TEST";
+
+    match std::env::var(test_var) {
+        Ok(v) if v == test_name => allocation_tracking_test(),
+
+        Err(VarError::NotPresent) => {
+            let tests_exec_path = std::env::args()
+                .next()
+                .expect("Failed to get tests executable path");
+            let mut command = Command::new(tests_exec_path);
+            command.arg(test_name).env(test_var, test_name);
+            if !std::env::args().any(|x| x == "--nocapture") {
+                command.stdout(Stdio::null()).stderr(Stdio::null());
+            }
+
+            let status = command.status().unwrap();
+            assert!(status.success(), "Child exited with status {status}");
+        }
+
+        Err(e) => panic!("Env var error: {e}"),
+
+        _ => unreachable!(),
+    }
+}
+
+fn allocation_tracking_test() {
+    let language = get_language("json");
+    let source = format!(
+        "[{}]",
+        [r#"{"a": [1, 2, {"b": null}], "c": "d"}"#; 50].join(", ")
+    );
+
+    unsafe { set_allocation_tracking(true) };
+    assert_eq!(total_allocation_stats().live_bytes, 0);
+
+    let mut parser = Parser::new();
+    parser.set_language(&language).unwrap();
+    let tree = parser.parse(&source, None).unwrap();
+    let query = Query::new(&language, "(pair key: (string) @key)").unwrap();
+    let mut cursor = QueryCursor::new();
+    let match_count = cursor
+        .matches(&query, tree.root_node(), source.as_bytes())
+        .count();
+    assert_eq!(match_count, 50 * 3);
+
+    let total = total_allocation_stats();
+    assert!(total.live_bytes > 0);
+    assert!(total.peak_bytes >= total.live_bytes);
+    for category in [
+        AllocationCategory::SubtreePool,
+        AllocationCategory::StackNodes,
+        AllocationCategory::IncludedRanges,
+        AllocationCategory::QueryCursorStates,
+        AllocationCategory::QueryCaptureLists,
+    ] {
+        let stats = allocation_stats(category);
+        assert!(stats.allocations > 0, "No allocations in {category:?}");
+        assert!(stats.live_bytes > 0, "No live bytes in {category:?}");
+    }
+    assert_eq!(
+        AllocationCategory::ALL
+            .iter()
+            .map(|category| allocation_stats(*category).live_bytes)
+            .sum::<usize>(),
+        total.live_bytes
+    );
+
+    // Reparsing measures only the allocations made by the new parse.
+    reset_allocation_stats();
+    let old_tree = tree.clone();
+    let new_tree = parser.parse(&source, Some(&old_tree)).unwrap();
+    assert!(total_allocation_stats().allocations > 0);
+    assert!(total_allocation_stats().allocations < total.allocations);
+
+    drop((cursor, query, new_tree, old_tree, tree, parser));
+    assert_eq!(total_allocation_stats().live_bytes, 0);
+    assert_eq!(total_allocation_stats().live_allocations, 0);
+    for category in AllocationCategory::ALL {
+        assert_eq!(allocation_stats(category).live_bytes, 0, "{category:?}");
+    }
+
+    unsafe { set_allocation_tracking(false) };
+}
@@ -7,8 +7,10 @@ use std::{
 };
 
 use lazy_static::lazy_static;
+use tree_sitter::{InputEdit, Point};
 use tree_sitter_highlight::{
-    c, Error, Highlight, HighlightConfiguration, HighlightEvent, Highlighter, HtmlRenderer,
+    c, Error, Highlight, HighlightConfiguration, HighlightEvent, HighlightSession, Highlighter,
+    HtmlRenderer, StreamingHtmlRenderer,
 };
 
 use super::helpers::fixtures::{get_highlight_config, get_language, get_language_queries_path};
@@ -344,6 +346,60 @@ fn test_highlighting_carriage_returns() {
     );
 }
 
+#[test]
+fn test_highlighting_to_html_stream() {
+    let mut renderer = StreamingHtmlRenderer::new(HTML_ATTRS.len(), |highlight| {
+        HTML_ATTRS[highlight.0].as_bytes()
+    });
+    renderer.set_carriage_return_highlight(
+        HIGHLIGHT_NAMES
+            .iter()
+            .position(|s| s == "carriage-return")
+            .map(Highlight),
+    );
+
+    let mut highlighter = Highlighter::new();
+    let mut output = Vec::new();
+    for source in [
+        "a = \"a\rb\"\r\nb\r",
+        "const a = `one\ntwo <b> & ${'three'}`;\nconst b = \"\u{e9}t\u{e9}\";\n",
+    ] {
+        output.clear();
+        let events = highlighter
+            .highlight(
+                &JS_HIGHLIGHT,
+                source.as_bytes(),
+                None,
+                &test_language_for_injection_string,
+            )
+            .unwrap();
+        renderer
+            .render(events, source.as_bytes(), &mut output)
+            .unwrap();
+        let mut html = to_html(source, &JS_HIGHLIGHT).unwrap().concat();
+        if !source.ends_with('\n') {
+            html.pop();
+        }
+        assert_eq!(str::from_utf8(&output).unwrap(), html);
+    }
+
+    // Rendering into a buffer that is too small fails without writing past its end.
+    let source = "const a = 1;";
+    let mut buffer = [0; 16];
+    let events = highlighter
+        .highlight(
+            &JS_HIGHLIGHT,
+            source.as_bytes(),
+            None,
+            &test_language_for_injection_string,
+        )
+        .unwrap();
+    let error = renderer
+        .render(events, source.as_bytes(), &mut &mut buffer[..])
+        .unwrap_err();
+    assert_eq!(error.kind(), std::io::ErrorKind::WriteZero);
+}
+
 #[test]
 fn test_highlighting_ejs_with_html_and_javascript() {
     let source = ["<div><% foo() %></div><script> bar() </script>"].join("\n");
@@ -379,6 +435,134 @@ fn test_highlighting_ejs_with_html_and_javascript() {
     );
 }
 
+#[test]
+fn test_highlighting_in_parallel() {
+    let sources = [
+        (
+            "<div><% foo() %></div><script> bar() </script>\n".repeat(20),
+            &EJS_HIGHLIGHT,
+        ),
+        (
+            "<body><script>const x = html `<i>${a < b}</i>`;</script></body>\n".repeat(20),
+            &HTML_HIGHLIGHT,
+        ),
+    ];
+
+    let mut highlighter = Highlighter::new();
+    for (source, config) in sources {
+        let serial_events = highlighter
+            .highlight(
+                config,
+                source.as_bytes(),
+                None,
+                &test_language_for_injection_string,
+            )
+            .unwrap()
+            .map(|event| format!("{:?}", event.unwrap()))
+            .collect::<Vec<_>>();
+        for thread_count in [1, 4] {
+            let parallel_events = highlighter
+                .highlight_parallel(
+                    config,
+                    source.as_bytes(),
+                    None,
+                    thread_count,
+                    &test_language_for_injection_string,
+                )
+                .unwrap()
+                .map(|event| format!("{:?}", event.unwrap()))
+                .collect::<Vec<_>>();
+            assert_eq!(parallel_events, serial_events);
+        }
+    }
+}
+
+#[test]
+fn test_highlighting_session() {
+    let mut source = "<p>a</p><script>const x = 1;</script><b>c</b>".repeat(20);
+    let edits = [
+        (270, 0, "<i>d</i>"),
+        (304, 1, "22"),
+        (90, 0, "<!-- e -->"),
+        (90, 10, ""),
+        (904, 0, "f "),
+    ];
+
+    let mut highlighter = Highlighter::new();
+    let mut session = HighlightSession::new();
+    let delta = session
+        .highlight(
+            &mut highlighter,
+            &HTML_HIGHLIGHT,
+            source.as_bytes(),
+            None,
+            &test_language_for_injection_string,
+        )
+        .unwrap();
+    assert_eq!(delta.old_events, 0..0);
+    assert_eq!(delta.range, 0..source.len());
+
+    for (position, deleted_length, inserted_text) in edits {
+        let old_events = session.events().to_vec();
+        let edit = InputEdit {
+            start_byte: position,
+            old_end_byte: position + deleted_length,
+            new_end_byte: position + inserted_text.len(),
+            start_position: Point::new(0, position),
+            old_end_position: Point::new(0, position + deleted_length),
+            new_end_position: Point::new(0, position + inserted_text.len()),
+        };
+        source.replace_range(position..position + deleted_length, inserted_text);
+        session.edit(&edit);
+        let delta = session
+            .highlight(
+                &mut highlighter,
+                &HTML_HIGHLIGHT,
+                source.as_bytes(),
+                None,
+                &test_language_for_injection_string,
+            )
+            .unwrap();
+
+        let expected_events = highlighter
+            .highlight(
+                &HTML_HIGHLIGHT,
+                source.as_bytes(),
+                None,
+                &test_language_for_injection_string,
+            )
+            .unwrap()
+            .map(|event| format!("{:?}", event.unwrap()))
+            .collect::<Vec<_>>();
+        assert_eq!(
+            session
+                .events()
+                .iter()
+                .map(|event| format!("{event:?}"))
+                .collect::<Vec<_>>(),
+            expected_events
+        );
+
+        // Applying the delta to the previous events gives the new events.
+        let shift = |event: &HighlightEvent| match *event {
+            HighlightEvent::Source { start, end } => HighlightEvent::Source {
+                start: start - delta.old_range.end + delta.range.end,
+                end: end - delta.old_range.end + delta.range.end,
+            },
+            event => event,
+        };
+        let events = old_events[..delta.old_events.start]
+            .iter()
+            .chain(&delta.events)
+            .copied()
+            .chain(old_events[delta.old_events.end..].iter().map(shift))
+            .map(|event| format!("{event:?}"))
+            .collect::<Vec<_>>();
+        assert_eq!(events, expected_events);
+        assert!(delta.events.len() < expected_events.len());
+    }
+}
+
 #[test]
 fn test_highlighting_javascript_with_jsdoc() {
     // Regression test: the middle comment has no highlights. This should not prevent
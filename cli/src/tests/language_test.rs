@@ -1,6 +1,9 @@
-use tree_sitter::Parser;
+use std::fs;
 
-use super::helpers::fixtures::get_language;
+use tree_sitter::{Language, LanguageLoadError, Parser};
+
+use super::helpers::fixtures::{get_language, get_test_language, scratch_dir};
+use crate::generate::{generate_language_data_for_grammar, generate_parser_for_grammar};
 
 #[test]
 fn test_lookahead_iterator() {
@@ -63,3 +66,136 @@ fn test_lookahead_iterator_modifiable_only_by_mut() {
     let mut names = lookahead.iter_names();
     let _ = names.next();
 }
+
+const GRAMMAR_WITH_KEYWORDS_AND_FIELDS: &str = r##"{
+  "name": "keywords_and_fields",
+  "word": "identifier",
+  "extras": [
+    {"type": "PATTERN", "value": "\\s+"},
+    {"type": "SYMBOL", "name": "comment"}
+  ],
+  "rules": {
+    "program": {"type": "REPEAT", "content": {"type": "SYMBOL", "name": "statement"}},
+    "statement": {
+      "type": "CHOICE",
+      "members": [
+        {
+          "type": "SEQ",
+          "members": [
+            {"type": "STRING", "value": "let"},
+            {"type": "FIELD", "name": "name", "content": {"type": "SYMBOL", "name": "identifier"}},
+            {"type": "STRING", "value": "="},
+            {"type": "FIELD", "name": "value", "content": {"type": "SYMBOL", "name": "_expression"}},
+            {"type": "STRING", "value": ";"}
+          ]
+        },
+        {
+          "type": "SEQ",
+          "members": [
+            {"type": "ALIAS", "value": "call", "named": true, "content": {"type": "SYMBOL", "name": "_expression"}},
+            {"type": "STRING", "value": ";"}
+          ]
+        }
+      ]
+    },
+    "_expression": {
+      "type": "CHOICE",
+      "members": [
+        {"type": "SYMBOL", "name": "identifier"},
+        {"type": "SYMBOL", "name": "number"},
+        {"type": "STRING", "value": "true"}
+      ]
+    },
+    "identifier": {"type": "PATTERN", "value": "[a-zα-ω_]+"},
+    "number": {"type": "PATTERN", "value": "\\d+"},
+    "comment": {"type": "PATTERN", "value": "#[^\\n]*"}
+  }
+}"##;
+
+#[test]
+fn test_language_load_data() {
+    let (parser_name, parser_code) =
+        generate_parser_for_grammar(GRAMMAR_WITH_KEYWORDS_AND_FIELDS).unwrap();
+    let (_, data) = generate_language_data_for_grammar(GRAMMAR_WITH_KEYWORDS_AND_FIELDS).unwrap();
+    let compiled = get_test_language(&parser_name, &parser_code, None);
+
+    let data_path = scratch_dir().join("keywords_and_fields.bin");
+    fs::write(&data_path, &data).unwrap();
+    let mapped = unsafe { Language::load_file(&data_path, None) }.unwrap();
+    let copied = unsafe { Language::load_data(&data, None) }.unwrap();
+
+    for language in [&mapped, &copied] {
+        assert_eq!(language.version(), compiled.version());
+        assert_eq!(language.node_kind_count(), compiled.node_kind_count());
+        assert_eq!(language.parse_state_count(), compiled.parse_state_count());
+        assert_eq!(language.field_count(), compiled.field_count());
+        for id in 0..compiled.node_kind_count() as u16 {
+            assert_eq!(language.node_kind_for_id(id), compiled.node_kind_for_id(id));
+            assert_eq!(
+                language.node_kind_is_named(id),
+                compiled.node_kind_is_named(id)
+            );
+        }
+        for id in 1..=compiled.field_count() as u16 {
+            assert_eq!(
+                language.field_name_for_id(id),
+                compiled.field_name_for_id(id)
+            );
+        }
+    }
+
+    let mut compiled_parser = Parser::new();
+    compiled_parser.set_language(&compiled).unwrap();
+    let mut parser = Parser::new();
+    parser.set_language(&mapped).unwrap();
+    drop(mapped);
+
+    for source in [
+        "let x = 1; # comment\nlet letter = true; truest; αβ;",
+        "let = ; let let = 2; 3 true",
+        "let x = 1 let y = ;; lettuce",
+    ] {
+        let expected = compiled_parser.parse(source, None).unwrap();
+        let tree = parser.parse(source, None).unwrap();
+        assert_eq!(tree.root_node().to_sexp(), expected.root_node().to_sexp());
+    }
+    let tree = parser.parse("let x = truest;", None).unwrap();
+    assert_eq!(
+        tree.root_node().to_sexp(),
+        "(program (statement name: (identifier) value: (identifier)))"
+    );
+}
+
+#[test]
+fn test_language_load_data_errors() {
+    let (_, data) = generate_language_data_for_grammar(GRAMMAR_WITH_KEYWORDS_AND_FIELDS).unwrap();
+
+    let load = |data: &[u8]| unsafe { Language::load_data(data, None) }.err();
+    assert_eq!(
+        load(&data[..data.len() - 1]),
+        Some(LanguageLoadError::Format)
+    );
+    assert_eq!(load(&data[..100]), Some(LanguageLoadError::Format));
+    assert_eq!(load(&[]), Some(LanguageLoadError::Format));
+
+    let mut bad_magic = data.clone();
+    bad_magic[0] ^= 1;
+    assert_eq!(load(&bad_magic), Some(LanguageLoadError::Format));
+
+    let mut bad_version = data.clone();
+    bad_version[8..12].copy_from_slice(&99u32.to_le_bytes());
+    assert_eq!(load(&bad_version), Some(LanguageLoadError::Version));
+
+    assert_eq!(
+        unsafe { Language::load_file(scratch_dir().join("nonexistent.bin"), None) }.err(),
+        Some(LanguageLoadError::IO)
+    );
+
+    let grammar_with_externals = GRAMMAR_WITH_KEYWORDS_AND_FIELDS.replacen(
+        r#""word""#,
+        r#""externals": [{"type": "SYMBOL", "name": "heredoc"}], "word""#,
+        1,
+    );
+    let (_, data) = generate_language_data_for_grammar(&grammar_with_externals).unwrap();
+    assert_eq!(load(&data), Some(LanguageLoadError::Scanner));
+}
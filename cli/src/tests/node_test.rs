@@ -1,4 +1,4 @@
-use tree_sitter::{Node, Parser, Point, Tree};
+use tree_sitter::{InputEdit, Node, Parser, Point, Tree};
 
 use super::{
     get_random_edit,
@@ -526,6 +526,72 @@ fn test_node_descendant_count() {
     }
 }
 
+#[test]
+fn test_node_structure_hash() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("json")).unwrap();
+
+    let tree = parser
+        .parse(
+            r#"[{"a": [1, 22]}, {"b":[3,44]}, {"a": [1, 2]}, [1, 22], [1, 22, 3]]"#,
+            None,
+        )
+        .unwrap();
+    let array = tree.root_node().child(0).unwrap();
+    let hashes = (0..5)
+        .map(|i| array.named_child(i).unwrap().structure_hash())
+        .collect::<Vec<_>>();
+
+    // Only the position and the text of the tokens differ.
+    assert_eq!(hashes[0], hashes[1]);
+    // The lengths of the tokens differ.
+    assert_ne!(hashes[0], hashes[2]);
+    // The kinds or the number of the nodes differ.
+    assert_ne!(hashes[0], hashes[3]);
+    assert_ne!(hashes[3], hashes[4]);
+
+    // The hashes of edited nodes reflect the edited lengths of their tokens.
+    let hash = tree.root_node().structure_hash();
+    let mut edited_tree = tree.clone();
+    edited_tree.edit(&InputEdit {
+        start_byte: 12,
+        old_end_byte: 12,
+        new_end_byte: 13,
+        start_position: Point::new(0, 12),
+        old_end_position: Point::new(0, 12),
+        new_end_position: Point::new(0, 13),
+    });
+    assert_ne!(edited_tree.root_node().structure_hash(), hash);
+    assert_eq!(tree.root_node().structure_hash(), hash);
+
+    // The hashes don't depend on how the tree was built, or on which of its
+    // nodes were reused from trees whose hashes were already computed.
+    let mut source_code = "[0]".to_string();
+    let mut tree = parser.parse(&source_code, None).unwrap();
+    for i in 1..100 {
+        let position = source_code.len() - 1;
+        let element = format!(", [{i}]");
+        source_code.insert_str(position, &element);
+        tree.root_node().structure_hash();
+        tree.edit(&InputEdit {
+            start_byte: position,
+            old_end_byte: position,
+            new_end_byte: position + element.len(),
+            start_position: Point::new(0, position),
+            old_end_position: Point::new(0, position),
+            new_end_position: Point::new(0, position + element.len()),
+        });
+        tree = parser.parse(&source_code, Some(&tree)).unwrap();
+    }
+    let new_tree = parser.parse(&source_code, None).unwrap();
+    let nodes = get_all_nodes(&tree);
+    let new_nodes = get_all_nodes(&new_tree);
+    assert_eq!(nodes.len(), new_nodes.len());
+    for (node, new_node) in nodes.iter().zip(new_nodes.iter()) {
+        assert_eq!(node.structure_hash(), new_node.structure_hash());
+    }
+}
+
 #[test]
 fn test_descendant_count_single_node_tree() {
     let mut parser = Parser::new();
@@ -1,9 +1,14 @@
 use std::{
+    cell::Cell,
+    ptr,
     sync::atomic::{AtomicUsize, Ordering},
     thread, time,
 };
 
-use tree_sitter::{IncludedRangesError, InputEdit, LogType, Parser, Point, Range};
+use tree_sitter::{
+    ffi, IncludedRangesError, InputEdit, LogType, ParseOptions, Parser, ParserConfig,
+    ParserConfigError, ParserPool, ParserStats, Point, Range, Tree,
+};
 use tree_sitter_proc_macro::retry;
 
 use super::helpers::{
@@ -13,7 +18,10 @@ use super::helpers::{
 };
 use crate::{
     fuzz::edits::Edit,
-    generate::{generate_parser_for_grammar, load_grammar_file},
+    generate::{
+        generate_parser_for_grammar, generate_parser_for_grammar_with_options, load_grammar_file,
+        LexerMode,
+    },
     parse::perform_edit,
     tests::{helpers::fixtures::fixtures_dir, invert_edit},
 };
@@ -214,6 +222,114 @@ fn test_parsing_with_callback_returning_owned_strings() {
     );
 }
 
+#[test]
+fn test_parsing_with_chunks() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("rust")).unwrap();
+
+    let text = "pub fn foo() { \"héllo\"; 1 }";
+    let expected = parser.parse(text, None).unwrap().root_node().to_sexp();
+
+    // Split the text into chunks of different sizes, including empty ones, as
+    // a rope might.
+    let chunks = ["", "pub f", "n", " foo() { \"h", "é", "", "llo\"; 1 }"];
+    let mut tree = parser
+        .parse_chunks(chunks.iter().map(|chunk| chunk.as_bytes()), None)
+        .unwrap();
+    assert_eq!(tree.root_node().to_sexp(), expected);
+    assert_eq!(tree.root_node().end_byte(), text.len());
+
+    // Reparse incrementally after an edit that spans two chunks.
+    tree.edit(&InputEdit {
+        start_byte: 7,
+        old_end_byte: 10,
+        new_end_byte: 10,
+        start_position: Point::new(0, 7),
+        old_end_position: Point::new(0, 10),
+        new_end_position: Point::new(0, 10),
+    });
+    let chunks = ["pub fn", " bar() { \"h", "éllo\"; 1 }"];
+    let tree = parser
+        .parse_chunks(chunks.iter().map(|chunk| chunk.as_bytes()), Some(&tree))
+        .unwrap();
+    assert_eq!(
+        tree.root_node().to_sexp(),
+        parser
+            .parse(chunks.concat(), None)
+            .unwrap()
+            .root_node()
+            .to_sexp()
+    );
+
+    let chunks = chunks
+        .iter()
+        .map(|chunk| chunk.encode_utf16().collect::<Vec<_>>())
+        .collect::<Vec<_>>();
+    let tree = parser
+        .parse_utf16_chunks(chunks.iter().map(Vec::as_slice), None)
+        .unwrap();
+    assert_eq!(tree.root_node().to_sexp(), expected);
+    assert_eq!(tree.root_node().end_byte(), 2 * text.encode_utf16().count());
+
+    // An empty sequence of chunks is an empty document.
+    let tree = parser.parse_chunks([], None).unwrap();
+    assert_eq!(tree.root_node().to_sexp(), "(source_file)");
+}
+
+#[test]
+fn test_parsing_with_invalid_spans() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("rust")).unwrap();
+    let parser = parser.into_raw();
+
+    let span = |byte_offset: u32, text: &str| ffi::TSInputSpan {
+        byte_offset,
+        bytes: text.as_ptr().cast(),
+        length: text.len() as u32,
+    };
+    let valid_spans = [span(0, "fn a"), span(4, "() {}")];
+    let gap_spans = [span(0, "fn a"), span(5, "() {}")];
+    let offset_spans = [span(1, "fn a() {}")];
+    let overflowing_spans = [
+        ffi::TSInputSpan {
+            length: u32::MAX,
+            ..span(0, "")
+        },
+        span(u32::MAX, "a"),
+    ];
+
+    unsafe {
+        assert!(ffi::ts_input_spans_are_valid(ptr::null(), 0));
+        assert!(ffi::ts_input_spans_are_valid(valid_spans.as_ptr(), 2));
+        for spans in [&gap_spans[..], &offset_spans, &overflowing_spans] {
+            let span_count = spans.len() as u32;
+            assert!(!ffi::ts_input_spans_are_valid(spans.as_ptr(), span_count));
+            let tree = ffi::ts_parser_parse_spans(
+                parser,
+                ptr::null(),
+                spans.as_ptr(),
+                span_count,
+                ffi::TSInputEncodingUTF8,
+            );
+            assert!(tree.is_null());
+        }
+
+        // Invalid spans don't leave a parse to resume.
+        let tree = Tree::from_raw(ffi::ts_parser_parse_spans(
+            parser,
+            ptr::null(),
+            valid_spans.as_ptr(),
+            2,
+            ffi::TSInputEncodingUTF8,
+        ));
+        assert_eq!(
+            tree.root_node().to_sexp(),
+            "(source_file (function_item name: (identifier) parameters: (parameters) body: (block)))"
+        );
+        drop(Parser::from_raw(parser));
+    }
+}
+
 #[test]
 fn test_parsing_text_with_byte_order_mark() {
     let mut parser = Parser::new();
@@ -270,6 +386,30 @@ fn test_parsing_text_with_byte_order_mark() {
     assert_eq!(tree.root_node().start_byte(), 3);
 }
 
+#[test]
+fn test_parsing_latin1_text() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("rust")).unwrap();
+
+    // Each byte is one character, including the non-ASCII ones.
+    let tree = parser
+        .parse_latin1(b"fn caf\xe9() {}\nfn \xe9t\xe9() {}", None)
+        .unwrap();
+    let root = tree.root_node();
+    assert_eq!(
+        root.to_sexp(),
+        "(source_file (function_item name: (identifier) parameters: (parameters) body: (block)) (function_item name: (identifier) parameters: (parameters) body: (block)))"
+    );
+
+    let name = root.child(0).unwrap().child_by_field_name("name").unwrap();
+    assert_eq!(name.byte_range(), 3..7);
+    assert_eq!(name.end_position(), Point::new(0, 7));
+
+    let name = root.child(1).unwrap().child_by_field_name("name").unwrap();
+    assert_eq!(name.byte_range(), 16..19);
+    assert_eq!(name.start_position(), Point::new(1, 3));
+}
+
 #[test]
 fn test_parsing_invalid_chars_at_eof() {
     let mut parser = Parser::new();
@@ -412,6 +552,39 @@ fn test_parsing_after_editing_end_of_code() {
     assert_eq!(recorder.strings_read(), vec![" * ", "abc.d)",]);
 }
 
+#[test]
+fn test_parsing_after_editing_one_element_of_a_long_repetition() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("json")).unwrap();
+    parser.set_stats_enabled(true);
+
+    let elements = (0..1000).map(|i| i.to_string()).collect::<Vec<_>>();
+    let mut code = format!("[{}]", elements.join(", ")).into_bytes();
+    let mut tree = parser.parse(&code, None).unwrap();
+
+    // Replace the element `500` with `501`.
+    let position = code.windows(5).position(|w| w == b" 500,").unwrap() + 3;
+    perform_edit(
+        &mut tree,
+        &mut code,
+        &Edit {
+            position,
+            deleted_length: 1,
+            inserted_text: b"1".to_vec(),
+        },
+    )
+    .unwrap();
+
+    // The unchanged elements are reused in large groups, rather than one
+    // at a time.
+    let tree = parser.parse(&code, Some(&tree)).unwrap();
+    assert!(parser.stats().reused_nodes < 100);
+    assert_eq!(
+        tree.root_node().to_sexp(),
+        parser.parse(&code, None).unwrap().root_node().to_sexp()
+    );
+}
+
 #[test]
 fn test_parsing_empty_file_with_reused_tree() {
     let mut parser = Parser::new();
@@ -804,6 +977,74 @@ fn test_parsing_with_timeout_and_no_completion() {
     });
 }
 
+#[test]
+fn test_parsing_with_a_progress_callback_and_a_byte_budget() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("json")).unwrap();
+
+    // Parse an infinitely-long array of numbers, recording how far the parser
+    // has read.
+    let max_offset = Cell::new(0);
+    let mut read = |offset: usize, _| {
+        max_offset.set(max_offset.get().max(offset));
+        if offset == 0 {
+            b"[0"
+        } else {
+            b",0"
+        }
+    };
+
+    // Halt from the progress callback once the parser is past 1000 bytes.
+    let mut states = Vec::new();
+    let tree = parser.parse_with_options(
+        &mut read,
+        None,
+        ParseOptions {
+            progress_callback: Some(&mut |state| {
+                states.push(*state);
+                state.byte_offset > 1000
+            }),
+            ..Default::default()
+        },
+    );
+    assert!(tree.is_none());
+    assert!(states.len() > 1);
+    assert!(states
+        .windows(2)
+        .all(|pair| pair[0].byte_offset <= pair[1].byte_offset
+            && pair[0].operation_count < pair[1].operation_count));
+    assert!(states.iter().all(|state| !state.has_error));
+    assert!(states.last().unwrap().byte_offset > 1000);
+
+    // Resume, and halt after parsing another 1000 bytes.
+    let start_offset = max_offset.get();
+    let tree = parser.parse_with_options(
+        &mut read,
+        None,
+        ParseOptions {
+            byte_budget: 1000,
+            ..Default::default()
+        },
+    );
+    assert!(tree.is_none());
+    assert!(max_offset.get() >= start_offset + 1000);
+    assert!(max_offset.get() < start_offset + 1010);
+
+    // Finish parsing.
+    let tree = parser
+        .parse_with(
+            &mut |offset, _| match offset {
+                5001.. => "".as_bytes(),
+                5000 => "]".as_bytes(),
+                0 => "[0".as_bytes(),
+                _ => ",0".as_bytes(),
+            },
+            None,
+        )
+        .unwrap();
+    assert_eq!(tree.root_node().child(0).unwrap().kind(), "array");
+}
+
 // Included Ranges
 
 #[test]
@@ -1249,6 +1490,78 @@ fn test_parsing_with_a_newly_included_range() {
     );
 }
 
+#[test]
+fn test_parsing_with_edited_and_spliced_included_ranges() {
+    let mut source_code = "<div><%= foo() %></div><span><%= bar() %></span>".to_string();
+    let range1_start = source_code.find(" foo").unwrap();
+    let range2_start = source_code.find(" bar").unwrap();
+    let range1 = simple_range(range1_start, range1_start + 7);
+    let range2 = simple_range(range2_start, range2_start + 7);
+
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("javascript")).unwrap();
+    parser.set_included_ranges(&[range1, range2]).unwrap();
+    let mut tree = parser.parse(&source_code, None).unwrap();
+
+    // Insert some text before both ranges, and edit the parser's ranges along with the tree.
+    source_code.insert_str(0, "<p></p>");
+    let edit = InputEdit {
+        start_byte: 0,
+        old_end_byte: 0,
+        new_end_byte: 7,
+        start_position: Point::new(0, 0),
+        old_end_position: Point::new(0, 0),
+        new_end_position: Point::new(0, 7),
+    };
+    tree.edit(&edit);
+    parser.edit_included_ranges(&edit);
+    let shifted_ranges = [
+        simple_range(range1.start_byte + 7, range1.end_byte + 7),
+        simple_range(range2.start_byte + 7, range2.end_byte + 7),
+    ];
+    assert_eq!(parser.included_ranges(), shifted_ranges);
+    assert_eq!(tree.included_ranges(), shifted_ranges);
+
+    let tree2 = parser.parse(&source_code, Some(&tree)).unwrap();
+    assert_eq!(
+        tree2.root_node().to_sexp(),
+        concat!(
+            "(program",
+            " (expression_statement (call_expression function: (identifier) arguments: (arguments)))",
+            " (expression_statement (call_expression function: (identifier) arguments: (arguments))))",
+        )
+    );
+    assert_eq!(tree2.changed_ranges(&tree).collect::<Vec<_>>(), &[]);
+
+    // Remove the second range, and then put it back.
+    parser.splice_included_ranges(1..2, &[]).unwrap();
+    assert_eq!(parser.included_ranges(), &shifted_ranges[0..1]);
+    assert_eq!(
+        parser.splice_included_ranges(1..1, &[simple_range(0, 1)]),
+        Err(IncludedRangesError(0))
+    );
+    assert_eq!(
+        parser.splice_included_ranges(0..0, &[simple_range(0, range1.start_byte + 8)]),
+        Err(IncludedRangesError(1))
+    );
+    parser
+        .splice_included_ranges(1..1, &shifted_ranges[1..2])
+        .unwrap();
+    assert_eq!(parser.included_ranges(), shifted_ranges);
+
+    // Removing all of the ranges includes the entire document.
+    parser.splice_included_ranges(0..2, &[]).unwrap();
+    assert_eq!(
+        parser.included_ranges(),
+        &[Range {
+            start_byte: 0,
+            end_byte: u32::MAX as usize,
+            start_point: Point::new(0, 0),
+            end_point: Point::new(u32::MAX as usize, u32::MAX as usize),
+        }]
+    );
+}
+
 #[test]
 fn test_parsing_with_included_ranges_and_missing_tokens() {
     let (parser_name, parser_code) = generate_parser_for_grammar(
@@ -1389,6 +1702,251 @@ fn test_grammars_that_can_hang_on_eof() {
     parser.parse("\"", None).unwrap();
 }
 
+#[test]
+fn test_parsing_with_a_table_driven_lexer() {
+    let grammar_json = |name: &str| {
+        r#"
+        {
+            "name": "NAME",
+            "word": "identifier",
+            "rules": {
+                "source_file": { "type": "REPEAT", "content": { "type": "SYMBOL", "name": "_item" } },
+                "_item": {
+                    "type": "CHOICE",
+                    "members": [
+                        { "type": "SYMBOL", "name": "identifier" },
+                        { "type": "SYMBOL", "name": "number" },
+                        { "type": "SYMBOL", "name": "string" },
+                        { "type": "STRING", "value": "let" },
+                        { "type": "STRING", "value": "=>" },
+                        { "type": "STRING", "value": "=" }
+                    ]
+                },
+                "identifier": { "type": "PATTERN", "value": "[\\p{L}_][\\p{L}\\p{Nd}_]*" },
+                "number": { "type": "PATTERN", "value": "\\d+(\\.\\d+)?" },
+                "string": { "type": "PATTERN", "value": "\"([^\"\\\\]|\\\\.)*\"" },
+                "comment": { "type": "PATTERN", "value": "//[^\\n]*" }
+            },
+            "extras": [
+                { "type": "PATTERN", "value": "\\s" },
+                { "type": "SYMBOL", "name": "comment" }
+            ]
+        }
+        "#
+        .replace("NAME", name)
+    };
+
+    let (switch_name, switch_code) = generate_parser_for_grammar_with_options(
+        &grammar_json("test_switch_lexer"),
+        LexerMode::Switch,
+        false,
+    )
+    .unwrap();
+    let (table_name, table_code) = generate_parser_for_grammar_with_options(
+        &grammar_json("test_table_lexer"),
+        LexerMode::Table,
+        false,
+    )
+    .unwrap();
+    assert!(!switch_code.contains("ts_lex_with_table"));
+    assert!(table_code.contains("ts_lex_with_table"));
+
+    let mut switch_parser = Parser::new();
+    switch_parser
+        .set_language(&get_test_language(&switch_name, &switch_code, None))
+        .unwrap();
+    let mut table_parser = Parser::new();
+    table_parser
+        .set_language(&get_test_language(&table_name, &table_code, None))
+        .unwrap();
+
+    for source in [
+        "let größe = 12.5 // the size\nlet x => \"a\\\"b\"".as_bytes(),
+        "letter lets = 日本 ǅx _1".as_bytes(),
+        "\"unterminated\n= 1.".as_bytes(),
+        b"x \xff\xc3 = \"a\0b\" \0 12",
+        b"// comment\0\n\"\x80\"",
+    ] {
+        let switch_tree = switch_parser.parse(source, None).unwrap();
+        let table_tree = table_parser.parse(source, None).unwrap();
+        assert_eq!(
+            switch_tree.root_node().to_sexp(),
+            table_tree.root_node().to_sexp(),
+            "source: {:?}",
+            String::from_utf8_lossy(source)
+        );
+        assert_eq!(
+            switch_tree.root_node().end_byte(),
+            table_tree.root_node().end_byte()
+        );
+    }
+}
+
+#[test]
+fn test_parsing_with_a_size_optimized_parse_table() {
+    let binary_expressions = [
+        "||", "&&", "==", "!=", "<", ">", "+", "-", "*", "/", "%", "<<", ">>", "&", "|", "^",
+    ]
+    .iter()
+    .enumerate()
+    .map(|(i, operator)| {
+        format!(
+            r#"{{
+                "type": "PREC_LEFT",
+                "value": {},
+                "content": {{
+                    "type": "SEQ",
+                    "members": [
+                        {{ "type": "SYMBOL", "name": "_expression" }},
+                        {{ "type": "STRING", "value": "{operator}" }},
+                        {{ "type": "SYMBOL", "name": "_expression" }}
+                    ]
+                }}
+            }}"#,
+            i / 2 + 1
+        )
+    })
+    .collect::<Vec<_>>()
+    .join(",");
+    let grammar_json = |name: &str| {
+        r#"
+        {
+            "name": "NAME",
+            "rules": {
+                "program": { "type": "REPEAT", "content": { "type": "SYMBOL", "name": "statement" } },
+                "statement": {
+                    "type": "CHOICE",
+                    "members": [
+                        {
+                            "type": "SEQ",
+                            "members": [
+                                { "type": "STRING", "value": "let" },
+                                { "type": "SYMBOL", "name": "identifier" },
+                                { "type": "STRING", "value": "=" },
+                                { "type": "SYMBOL", "name": "_expression" },
+                                { "type": "STRING", "value": ";" }
+                            ]
+                        },
+                        {
+                            "type": "SEQ",
+                            "members": [
+                                { "type": "SYMBOL", "name": "_expression" },
+                                { "type": "STRING", "value": ";" }
+                            ]
+                        }
+                    ]
+                },
+                "_expression": {
+                    "type": "CHOICE",
+                    "members": [
+                        { "type": "SYMBOL", "name": "binary_expression" },
+                        { "type": "SYMBOL", "name": "unary_expression" },
+                        { "type": "SYMBOL", "name": "call_expression" },
+                        { "type": "SYMBOL", "name": "parenthesized_expression" },
+                        { "type": "SYMBOL", "name": "identifier" },
+                        { "type": "SYMBOL", "name": "number" }
+                    ]
+                },
+                "binary_expression": {
+                    "type": "CHOICE",
+                    "members": [
+                        BINARY_EXPRESSIONS
+                    ]
+                },
+                "unary_expression": {
+                    "type": "PREC",
+                    "value": 10,
+                    "content": {
+                        "type": "SEQ",
+                        "members": [
+                            {
+                                "type": "CHOICE",
+                                "members": [
+                                    { "type": "STRING", "value": "-" },
+                                    { "type": "STRING", "value": "!" }
+                                ]
+                            },
+                            { "type": "SYMBOL", "name": "_expression" }
+                        ]
+                    }
+                },
+                "call_expression": {
+                    "type": "PREC",
+                    "value": 11,
+                    "content": {
+                        "type": "SEQ",
+                        "members": [
+                            { "type": "SYMBOL", "name": "_expression" },
+                            { "type": "STRING", "value": "(" },
+                            {
+                                "type": "CHOICE",
+                                "members": [
+                                    { "type": "SYMBOL", "name": "_expression" },
+                                    { "type": "BLANK" }
+                                ]
+                            },
+                            { "type": "STRING", "value": ")" }
+                        ]
+                    }
+                },
+                "parenthesized_expression": {
+                    "type": "SEQ",
+                    "members": [
+                        { "type": "STRING", "value": "(" },
+                        { "type": "SYMBOL", "name": "_expression" },
+                        { "type": "STRING", "value": ")" }
+                    ]
+                },
+                "identifier": { "type": "PATTERN", "value": "[a-z]+" },
+                "number": { "type": "PATTERN", "value": "\\d+" }
+            },
+            "extras": [ { "type": "PATTERN", "value": "\\s" } ]
+        }
+        "#
+        .replace("NAME", name)
+        .replace("BINARY_EXPRESSIONS", &binary_expressions)
+    };
+
+    let (default_name, default_code) = generate_parser_for_grammar_with_options(
+        &grammar_json("test_default_parse_table"),
+        LexerMode::Switch,
+        false,
+    )
+    .unwrap();
+    let (optimized_name, optimized_code) = generate_parser_for_grammar_with_options(
+        &grammar_json("test_size_optimized_parse_table"),
+        LexerMode::Switch,
+        true,
+    )
+    .unwrap();
+    assert!(!default_code.contains("// Parse table sizes, in bytes:"));
+    assert!(optimized_code.contains("// Parse table sizes, in bytes:"));
+
+    let mut default_parser = Parser::new();
+    default_parser
+        .set_language(&get_test_language(&default_name, &default_code, None))
+        .unwrap();
+    let mut optimized_parser = Parser::new();
+    optimized_parser
+        .set_language(&get_test_language(&optimized_name, &optimized_code, None))
+        .unwrap();
+
+    for source in [
+        "let a = -b(c + 1) * (d || !e) / 2;",
+        "f(g(h)) < 3 == i && j - k;",
+        "let = (a + ;\nb * c);",
+        "a b ( ) ) ! 1 2;",
+    ] {
+        let default_tree = default_parser.parse(source, None).unwrap();
+        let optimized_tree = optimized_parser.parse(source, None).unwrap();
+        assert_eq!(
+            default_tree.root_node().to_sexp(),
+            optimized_tree.root_node().to_sexp(),
+            "source: {source:?}",
+        );
+    }
+}
+
 #[test]
 fn test_parse_stack_recursive_merge_error_cost_calculation_bug() {
     let source_code = r#"
@@ -1446,6 +2004,358 @@ fn test_parsing_with_scanner_logging() {
     assert!(found);
 }
 
+// Arena allocation
+
+#[test]
+fn test_parsing_with_arena_allocation() {
+    allocations::record(|| {
+        let mut parser = Parser::new();
+        parser.set_language(&get_language("javascript")).unwrap();
+        assert!(!parser.arena_enabled());
+        parser.set_arena_enabled(true);
+        assert!(parser.arena_enabled());
+
+        let mut code = b"const a = [1, 2, 3];\nfunction b(c) { return c * 2; }\n".to_vec();
+        let mut tree = parser.parse(&code, None).unwrap();
+        let old_tree = tree.clone();
+
+        perform_edit(
+            &mut tree,
+            &mut code,
+            &Edit {
+                position: 14,
+                deleted_length: 0,
+                inserted_text: b"x, ".to_vec(),
+            },
+        )
+        .unwrap();
+
+        // Re-parse incrementally, both with and without an arena, and drop
+        // the old trees before the new ones.
+        let arena_tree = parser.parse(&code, Some(&tree)).unwrap();
+        parser.set_arena_enabled(false);
+        let heap_tree = parser.parse(&code, Some(&tree)).unwrap();
+        drop(tree);
+        drop(old_tree);
+
+        let expected = parser.parse(&code, None).unwrap().root_node().to_sexp();
+        assert_eq!(arena_tree.root_node().to_sexp(), expected);
+        assert_eq!(heap_tree.root_node().to_sexp(), expected);
+    });
+}
+
+// Parse table index
+
+#[test]
+fn test_parsing_with_lookup_index() {
+    let source_code = "
+        fn main() {
+            let x = if y { [1, 2, 3] } else { vec![4; 5] };
+            match x { Some(z) => z?, None => { 1 + } }
+        }
+    ";
+
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("rust")).unwrap();
+    let expected = parser
+        .parse(source_code, None)
+        .unwrap()
+        .root_node()
+        .to_sexp();
+
+    assert!(!parser.lookup_index_enabled());
+    parser.set_lookup_index_enabled(true);
+    assert!(parser.lookup_index_enabled());
+    let tree = parser.parse(source_code, None).unwrap();
+    assert_eq!(tree.root_node().to_sexp(), expected);
+
+    // The index is rebuilt when the language changes.
+    parser.set_language(&get_language("javascript")).unwrap();
+    parser.set_language(&get_language("rust")).unwrap();
+    let tree = parser.parse(source_code, None).unwrap();
+    assert_eq!(tree.root_node().to_sexp(), expected);
+}
+
+// Parser pools
+
+#[test]
+fn test_parsing_many_documents_with_a_parser_pool() {
+    let documents = (0..20)
+        .map(|i| {
+            format!("function f{i}() {{ return [{}]; }}\n", "1, ".repeat(i * 10)).repeat(i + 1)
+        })
+        .collect::<Vec<_>>();
+
+    let language = get_language("javascript");
+    let mut parser = Parser::new();
+    parser.set_language(&language).unwrap();
+
+    let mut pool = ParserPool::new(&language, 3).unwrap();
+    let results = pool.parse_many(&documents);
+    assert_eq!(results.len(), documents.len());
+    for (document, result) in documents.iter().zip(&results) {
+        assert_eq!(
+            result.tree.as_ref().unwrap().root_node().to_sexp(),
+            parser.parse(document, None).unwrap().root_node().to_sexp()
+        );
+    }
+
+    // A document that times out doesn't affect the next one.
+    for parser in pool.parsers_mut() {
+        parser.set_timeout_micros(1);
+    }
+    let long_document = "[".to_string() + &"1, ".repeat(100_000) + "]";
+    let results = pool.parse_many(&[long_document.as_str()]);
+    assert!(results[0].tree.is_none());
+    for parser in pool.parsers_mut() {
+        parser.set_timeout_micros(0);
+    }
+    let results = pool.parse_many(&documents[..2]);
+    assert!(results.iter().all(|result| result.tree.is_some()));
+}
+
+// Chunk caching
+
+#[test]
+fn test_parsing_with_a_chunk_cache() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("javascript")).unwrap();
+    let source_code = "const a = [\"é\", \"ü\"];\nfunction b() { return a + 1 }\n".repeat(50);
+    let expected = parser
+        .parse(&source_code, None)
+        .unwrap()
+        .root_node()
+        .to_sexp();
+
+    assert_eq!(parser.chunk_cache_size(), 0);
+    unsafe { parser.set_chunk_cache_size(4) };
+    assert_eq!(parser.chunk_cache_size(), 4);
+
+    // The chunks are borrowed from the source code, so they remain valid for
+    // the whole parse. Small chunks split some of the multi-byte characters.
+    let bytes = source_code.as_bytes();
+    let mut read_count = 0;
+    let tree = parser
+        .parse_with(
+            &mut |offset, _| {
+                read_count += 1;
+                &bytes[offset.min(bytes.len())..(offset + 7).min(bytes.len())]
+            },
+            None,
+        )
+        .unwrap();
+    assert_eq!(tree.root_node().to_sexp(), expected);
+    assert!(read_count > 0);
+}
+
+// Parser statistics
+
+#[test]
+fn test_parsing_with_stats() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("javascript")).unwrap();
+    let mut code = b"const a = [1, 2, 3];\nfunction b() { return a; }\n".repeat(20);
+
+    // Nothing is collected by default.
+    let mut tree = parser.parse(&code, None).unwrap();
+    assert!(!parser.stats_enabled());
+    assert_eq!(parser.stats(), ParserStats::default());
+
+    parser.set_stats_enabled(true);
+    assert!(parser.stats_enabled());
+    parser.parse(&code, None).unwrap();
+    let stats = parser.stats();
+    assert!(stats.lexed_tokens > 0);
+    assert!(stats.heap_tokens < stats.lexed_tokens);
+    assert!(stats.token_cache_misses > 0);
+    assert_eq!(stats.reused_nodes, 0);
+    assert_eq!(stats.recoveries, 0);
+    assert!(stats.operations > 0);
+    assert!(stats.total_time >= stats.lex_time);
+
+    // Unlike the timings, the operation count is the same on every run.
+    parser.parse(&code, None).unwrap();
+    assert_eq!(parser.stats().operations, stats.operations);
+
+    // An incremental parse reuses most of the old tree, and lexes only
+    // the tokens around the edit.
+    perform_edit(
+        &mut tree,
+        &mut code,
+        &Edit {
+            position: 11,
+            deleted_length: 1,
+            inserted_text: b"4".to_vec(),
+        },
+    )
+    .unwrap();
+    let tree = parser.parse(&code, Some(&tree)).unwrap();
+    let incremental_stats = parser.stats();
+    assert!(incremental_stats.reused_nodes > 0);
+    assert!(incremental_stats.lexed_tokens < stats.lexed_tokens);
+    assert!(incremental_stats.operations < stats.operations);
+
+    // Parsing invalid code requires error recovery.
+    parser.parse("const a = [1, 2 3 4;", None).unwrap();
+    assert!(parser.stats().recoveries > 0);
+    assert_eq!(
+        tree.root_node().to_sexp(),
+        parser.parse(&code, None).unwrap().root_node().to_sexp()
+    );
+
+    // Tokens that are a few hundred bytes long can still be stored inline,
+    // but longer ones are allocated on the heap.
+    parser.parse(format!("{};", "a".repeat(500)), None).unwrap();
+    let short_token_stats = parser.stats();
+    parser
+        .parse(format!("{};", "a".repeat(5000)), None)
+        .unwrap();
+    assert!(parser.stats().heap_tokens > short_token_stats.heap_tokens);
+}
+
+// Parser configuration
+
+#[test]
+fn test_parsing_with_config() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("javascript")).unwrap();
+    let default_config = parser.config();
+    assert_eq!(default_config.max_version_count, 6);
+    assert_eq!(default_config.adaptive_threshold, 0);
+
+    // Invalid limits are rejected, and leave the config unchanged.
+    let invalid_configs = [
+        ParserConfig {
+            max_version_count: 0,
+            ..default_config
+        },
+        ParserConfig {
+            max_version_count: 6,
+            max_version_count_overflow: u32::MAX as usize - 5,
+            ..default_config
+        },
+        ParserConfig {
+            adaptive_threshold: 2,
+            adaptive_min_version_count: 0,
+            ..default_config
+        },
+        ParserConfig {
+            adaptive_threshold: 2,
+            adaptive_min_version_count: 7,
+            ..default_config
+        },
+    ];
+    for config in &invalid_configs {
+        assert_eq!(parser.set_config(Some(config)), Err(ParserConfigError));
+        assert_eq!(parser.config(), default_config);
+    }
+
+    // Valid code parses the same way with tighter limits.
+    let code = "const a = [1, 2, 3];\nfunction b() { return a; }\n".repeat(20);
+    let expected = parser.parse(&code, None).unwrap().root_node().to_sexp();
+    let restrictive_config = ParserConfig {
+        max_version_count: 2,
+        max_version_count_overflow: 1,
+        adaptive_threshold: 1,
+        adaptive_min_version_count: 1,
+        ..default_config
+    };
+    parser.set_config(Some(&restrictive_config)).unwrap();
+    assert_eq!(parser.config(), restrictive_config);
+    let tree = parser.parse(&code, None).unwrap();
+    assert_eq!(tree.root_node().to_sexp(), expected);
+
+    // Invalid code still produces a tree spanning the whole input.
+    let invalid_code = "( [ { a < b ( c ) > , ] } ) ".repeat(100);
+    let tree = parser.parse(&invalid_code, None).unwrap();
+    assert!(tree.root_node().has_error());
+    assert_eq!(tree.root_node().end_byte(), invalid_code.len());
+
+    parser.set_config(None).unwrap();
+    assert_eq!(parser.config(), default_config);
+}
+
+#[test]
+fn test_parsing_with_a_recovery_budget() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("javascript")).unwrap();
+    parser.set_stats_enabled(true);
+    assert_eq!(parser.config().recovery_budget_per_byte, 0);
+
+    let code = "const a = [1, 2, 3];\nfunction b() { return a; }\n".repeat(20);
+    let expected = parser.parse(&code, None).unwrap().root_node().to_sexp();
+    let invalid_code = "( [ { a < b ( c ) > , ] } ) ".repeat(100);
+    parser.parse(&invalid_code, None).unwrap();
+    assert_eq!(parser.stats().bounded_recoveries, 0);
+
+    parser
+        .set_config(Some(&ParserConfig {
+            recovery_budget_per_byte: 1,
+            ..parser.config()
+        }))
+        .unwrap();
+
+    // Valid code doesn't need any recovery, so it parses the same way.
+    let tree = parser.parse(&code, None).unwrap();
+    assert_eq!(tree.root_node().to_sexp(), expected);
+
+    // Once the budget is used up, invalid code is recovered from by skipping
+    // tokens, but the tree still spans the whole input.
+    let tree = parser.parse(&invalid_code, None).unwrap();
+    let stats = parser.stats();
+    assert!(stats.bounded_recoveries > 0);
+    assert!(stats.bounded_recoveries <= stats.recoveries);
+    assert!(tree.root_node().has_error());
+    assert_eq!(tree.root_node().end_byte(), invalid_code.len());
+}
+
+// Streaming
+
+#[test]
+fn test_parsing_with_streaming() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("json")).unwrap();
+    let source_code =
+        "{\"id\": 1, \"tags\": [\"a\", \"b\"]}\n// comment\n[true, null]\n".repeat(50);
+    let expected_tree = parser.parse(&source_code, None).unwrap();
+    let expected = expected_tree
+        .root_node()
+        .children(&mut expected_tree.walk())
+        .map(|node| (node.byte_range(), node.to_sexp()))
+        .collect::<Vec<_>>();
+
+    // Each top-level node is either streamed or left in the returned tree,
+    // in order, and with the same position and structure as in a normal parse.
+    let mut nodes = Vec::new();
+    let tree = parser
+        .parse_streaming_with(&mut chunked_input(&source_code, 10), &mut |node| {
+            nodes.push((node.byte_range(), node.to_sexp()));
+        })
+        .unwrap();
+    let streamed_count = nodes.len();
+    assert!(streamed_count > expected.len() - 3);
+    nodes.extend(
+        tree.root_node()
+            .children(&mut tree.walk())
+            .map(|node| (node.byte_range(), node.to_sexp())),
+    );
+    assert_eq!(nodes, expected);
+    assert_eq!(tree.root_node().byte_range(), 0..source_code.len());
+
+    // A document with a single top-level node is not streamed.
+    let mut streamed_count = 0;
+    let tree = parser
+        .parse_streaming_with(&mut chunked_input("[1, [2, 3]]", 4), &mut |_| {
+            streamed_count += 1;
+        })
+        .unwrap();
+    assert_eq!(streamed_count, 0);
+    assert_eq!(
+        tree.root_node().to_sexp(),
+        "(document (array (number) (array (number) (number))))"
+    );
+}
+
 const fn simple_range(start: usize, end: usize) -> Range {
     Range {
         start_byte: start,
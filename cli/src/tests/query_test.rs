@@ -1,11 +1,11 @@
-use std::{env, fmt::Write};
+use std::{env, fmt::Write, mem::MaybeUninit, ptr, slice};
 
 use indoc::indoc;
 use lazy_static::lazy_static;
 use rand::{prelude::StdRng, SeedableRng};
 use tree_sitter::{
-    CaptureQuantifier, Language, Node, Parser, Point, Query, QueryCursor, QueryError,
-    QueryErrorKind, QueryPredicate, QueryPredicateArg, QueryProperty,
+    ffi, CaptureQuantifier, IncludedRangesError, Language, Node, Parser, Point, Query, QueryCursor,
+    QueryError, QueryErrorKind, QueryPredicate, QueryPredicateArg, QueryProperty, Tree,
 };
 use unindent::Unindent;
 
@@ -16,9 +16,11 @@ use super::helpers::{
 };
 use crate::{
     generate::generate_parser_for_grammar,
+    parse::perform_edit,
     tests::{
+        get_random_edit,
         helpers::query_helpers::{collect_captures, collect_matches},
-        ITERATION_COUNT,
+        Rand, ITERATION_COUNT,
     },
 };
 
@@ -2012,6 +2014,56 @@ fn test_query_matches_within_byte_range() {
     });
 }
 
+#[test]
+fn test_query_matches_within_byte_ranges() {
+    allocations::record(|| {
+        let language = get_language("javascript");
+        let query = Query::new(&language, "(identifier) @element").unwrap();
+
+        let source = "[a, b, c, d, e, f, g]";
+
+        let mut parser = Parser::new();
+        parser.set_language(&language).unwrap();
+        let tree = parser.parse(source, None).unwrap();
+
+        let mut cursor = QueryCursor::new();
+
+        // The text between the ranges is skipped.
+        let matches = cursor
+            .set_byte_ranges(&[1..2, 7..11, 13..14])
+            .unwrap()
+            .matches(&query, tree.root_node(), source.as_bytes());
+        assert_eq!(
+            collect_matches(matches, &query, source),
+            &[
+                (0, vec![("element", "a")]),
+                (0, vec![("element", "c")]),
+                (0, vec![("element", "d")]),
+                (0, vec![("element", "e")]),
+            ]
+        );
+
+        assert_eq!(
+            cursor.set_byte_ranges(&[1..5, 4..8]).err(),
+            Some(IncludedRangesError(1))
+        );
+        assert_eq!(
+            cursor.set_byte_ranges(&[5..4]).err(),
+            Some(IncludedRangesError(0))
+        );
+
+        // Setting a single range replaces the ranges.
+        let matches =
+            cursor
+                .set_byte_range(16..0)
+                .matches(&query, tree.root_node(), source.as_bytes());
+        assert_eq!(
+            collect_matches(matches, &query, source),
+            &[(0, vec![("element", "f")]), (0, vec![("element", "g")])]
+        );
+    });
+}
+
 #[test]
 fn test_query_matches_within_point_range() {
     allocations::record(|| {
@@ -3639,6 +3691,170 @@ fn test_query_text_callback_returns_chunks() {
     });
 }
 
+#[test]
+fn test_query_text_predicates_with_unsupported_regexes() {
+    allocations::record(|| {
+        let language = get_language("javascript");
+
+        // The first regex is evaluated by the C library, and the second one,
+        // which uses a Perl class, is evaluated by the Rust binding.
+        let query = Query::new(
+            &language,
+            r#"
+            ((identifier) @lower
+             (#match? @lower "^[a-z]+$"))
+            ((identifier) @numbered
+             (#match? @numbered "^\\w+\\d$"))
+            ((comment)+ @found
+             (#any-eq? @found "// b"))
+            ((comment)+ @missing
+             (#any-eq? @missing "// z"))
+            "#,
+        )
+        .unwrap();
+
+        let source = "foo; bar1; BAZ;\n// a\n// b\n";
+        let mut parser = Parser::new();
+        parser.set_language(&language).unwrap();
+        let tree = parser.parse(source, None).unwrap();
+        let mut cursor = QueryCursor::new();
+        let captures = cursor.captures(&query, tree.root_node(), source.as_bytes());
+
+        assert_eq!(
+            collect_captures(captures, &query, source),
+            &[
+                ("lower", "foo"),
+                ("numbered", "bar1"),
+                ("found", "// a"),
+                ("found", "// b"),
+            ],
+        );
+    });
+}
+
+#[test]
+fn test_query_cursor_reuses_text_buffers_across_iterators() {
+    allocations::record(|| {
+        let language = get_language("javascript");
+
+        // Both regexes are evaluated by the Rust binding, which has to join the
+        // chunks of each identifier before matching it.
+        let query = Query::new(
+            &language,
+            r#"
+            ((identifier) @numbered
+             (#match? @numbered "^\\w+\\d$"))
+            ((identifier) @word
+             (#match? @word "^\\w{4,}$"))
+            ((assignment_expression
+               left: (identifier) @left
+               right: (identifier) @right)
+             (#eq? @left @right))
+            "#,
+        )
+        .unwrap();
+
+        let source = "foo1 = foo1; barbaz = bar2; q = q;";
+        let source_chunks = source.as_bytes().chunks(2).collect::<Vec<_>>();
+        let chunks_in_range = |range: std::ops::Range<usize>| {
+            let mut offset = 0;
+            source_chunks.iter().filter_map(move |chunk| {
+                let end_offset = offset + chunk.len();
+                let result = (offset < range.end && range.start < end_offset).then(|| {
+                    let end_in_chunk = (range.end - offset).min(chunk.len());
+                    let start_in_chunk = range.start.max(offset) - offset;
+                    &chunk[start_in_chunk..end_in_chunk]
+                });
+                offset = end_offset;
+                result
+            })
+        };
+
+        let mut parser = Parser::new();
+        parser.set_language(&language).unwrap();
+        let tree = parser.parse(source, None).unwrap();
+
+        // The cursor's buffers stay valid when the cursor is moved between calls.
+        let mut cursors = vec![QueryCursor::new()];
+        for _ in 0..3 {
+            let mut cursor = cursors.pop().unwrap();
+            let captures = cursor.captures(&query, tree.root_node(), |node: Node| {
+                chunks_in_range(node.byte_range())
+            });
+            assert_eq!(
+                collect_captures(captures, &query, source),
+                &[
+                    ("numbered", "foo1"),
+                    ("word", "foo1"),
+                    ("left", "foo1"),
+                    ("numbered", "foo1"),
+                    ("word", "foo1"),
+                    ("right", "foo1"),
+                    ("word", "barbaz"),
+                    ("numbered", "bar2"),
+                    ("word", "bar2"),
+                    ("left", "q"),
+                    ("right", "q"),
+                ],
+            );
+
+            let matches = cursor.matches(&query, tree.root_node(), |node: Node| {
+                chunks_in_range(node.byte_range())
+            });
+            assert_eq!(matches.count(), 9);
+            cursors.push(cursor);
+        }
+    });
+}
+
+#[test]
+fn test_query_serialization() {
+    allocations::record(|| {
+        let language = get_language("javascript");
+        let mut query = Query::new(
+            &language,
+            r#"
+            (function_declaration name: (identifier) @function)
+            (call_expression function: (identifier) @call (#eq? @call "foo"))
+            ((identifier) @constant (#match? @constant "^[A-Z]+$"))
+            (comment) @comment
+            "#,
+        )
+        .unwrap();
+        query.disable_pattern(3);
+
+        let data = query.serialize();
+        let loaded = Query::deserialize(&language, &data).unwrap();
+        assert_eq!(loaded.pattern_count(), query.pattern_count());
+        assert_eq!(loaded.capture_names(), query.capture_names());
+        assert_eq!(loaded.serialize(), data);
+
+        let source = "function foo() {}\nfoo(BAR); bar(); // ok\n";
+        let mut parser = Parser::new();
+        parser.set_language(&language).unwrap();
+        let tree = parser.parse(source, None).unwrap();
+        let mut cursor = QueryCursor::new();
+        let expected = collect_matches(
+            cursor.matches(&query, tree.root_node(), source.as_bytes()),
+            &query,
+            source,
+        );
+        let actual = collect_matches(
+            cursor.matches(&loaded, tree.root_node(), source.as_bytes()),
+            &loaded,
+            source,
+        );
+        assert_eq!(actual, expected);
+        assert!(!actual.iter().any(|(pattern, _)| *pattern == 3));
+
+        // Truncated buffers, and buffers for other languages, are rejected.
+        for length in 0..data.len() {
+            assert!(Query::deserialize(&language, &data[..length]).is_none());
+        }
+        assert!(Query::deserialize(&get_language("python"), &data).is_none());
+    });
+}
+
 #[test]
 fn test_query_start_end_byte_for_pattern() {
     let language = get_language("javascript");
@@ -3847,6 +4063,62 @@ fn test_query_disable_pattern() {
     });
 }
 
+#[test]
+fn test_query_cursor_disable_pattern_and_capture() {
+    allocations::record(|| {
+        let language = get_language("javascript");
+        let query = Query::new(
+            &language,
+            "
+                (function_declaration
+                    name: (identifier) @name
+                    body: (statement_block) @body)
+                (class_declaration
+                    name: (identifier) @name
+                    body: (class_body) @body)
+            ",
+        )
+        .unwrap();
+
+        let source = "class A { constructor() {} } function b() { return 1; }";
+        let mut parser = Parser::new();
+        parser.set_language(&language).unwrap();
+        let tree = parser.parse(source, None).unwrap();
+
+        // Disabling patterns and captures on the cursor leaves the query intact,
+        // so it can still be used by other cursors.
+        let mut cursor = QueryCursor::new();
+        cursor
+            .disable_pattern(1)
+            .disable_capture(query.capture_index_for_name("body").unwrap());
+        let matches = cursor.matches(&query, tree.root_node(), source.as_bytes());
+        assert_eq!(
+            collect_matches(matches, &query, source),
+            &[(0, vec![("name", "b")])],
+        );
+
+        let mut other_cursor = QueryCursor::new();
+        let matches = other_cursor.matches(&query, tree.root_node(), source.as_bytes());
+        assert_eq!(
+            collect_matches(matches, &query, source),
+            &[
+                (1, vec![("name", "A"), ("body", "{ constructor() {} }")]),
+                (0, vec![("name", "b"), ("body", "{ return 1; }")]),
+            ],
+        );
+
+        cursor.enable_all();
+        let matches = cursor.matches(&query, tree.root_node(), source.as_bytes());
+        assert_eq!(
+            collect_matches(matches, &query, source),
+            &[
+                (1, vec![("name", "A"), ("body", "{ constructor() {} }")]),
+                (0, vec![("name", "b"), ("body", "{ return 1; }")]),
+            ],
+        );
+    });
+}
+
 #[test]
 fn test_query_alternative_predicate_prefix() {
     allocations::record(|| {
@@ -5171,3 +5443,280 @@ fn test_query_execution_with_timeout() {
         .count();
     assert_eq!(matches, 1000);
 }
+
+#[test]
+fn test_query_cursor_operation_count() {
+    let language = get_language("javascript");
+    let mut parser = Parser::new();
+    parser.set_language(&language).unwrap();
+
+    let query = Query::new(&language, "(call_expression function: (identifier) @fn)").unwrap();
+    let mut cursor = QueryCursor::new();
+    assert_eq!(cursor.operation_count(), 0);
+
+    let mut counts = Vec::new();
+    for repetitions in [100, 200] {
+        let source_code = "a(b(c), d);\n".repeat(repetitions);
+        let tree = parser.parse(&source_code, None).unwrap();
+        let captures = cursor
+            .captures(&query, tree.root_node(), source_code.as_bytes())
+            .count();
+        assert_eq!(captures, 2 * repetitions);
+        counts.push(cursor.operation_count());
+    }
+
+    // The count starts over with each execution, and grows with the
+    // size of the document.
+    assert!(counts[0] > 0);
+    assert!(counts[1] > counts[0] * 3 / 2);
+    assert!(counts[1] < counts[0] * 5 / 2);
+}
+
+#[test]
+fn test_query_captures_parallel() {
+    let language = get_language("javascript");
+    let mut parser = Parser::new();
+    parser.set_language(&language).unwrap();
+
+    let source_code = "
+        function one(a) { return a.b + `c${d}`; }
+        class Two { method() { this.x = 1; } }
+        // comment
+        let three = [1, 2, [3, 4]];
+    "
+    .repeat(50);
+    let tree = parser.parse(&source_code, None).unwrap();
+
+    let query = Query::new(
+        &language,
+        r#"
+        (identifier) @variable
+        (property_identifier) @property
+        ((identifier) @constant (#match? @constant "^[A-Z]"))
+        (program (comment) . (lexical_declaration) @after_comment)
+        (array (number) @first . (number) @second)
+        "#,
+    )
+    .unwrap();
+
+    let mut cursor = QueryCursor::new();
+    let expected = cursor
+        .captures(&query, tree.root_node(), source_code.as_bytes())
+        .map(|(m, i)| (m.pattern_index, m.captures[i]))
+        .collect::<Vec<_>>();
+    assert!(!expected.is_empty());
+
+    for thread_count in [1, 2, 3, 7, 16] {
+        let actual = cursor.captures_parallel(
+            &query,
+            tree.root_node(),
+            source_code.as_bytes(),
+            thread_count,
+        );
+        assert_eq!(
+            actual
+                .iter()
+                .map(|(p, c)| (*p, c.index, c.node))
+                .collect::<Vec<_>>(),
+            expected
+                .iter()
+                .map(|(p, c)| (*p, c.index, c.node))
+                .collect::<Vec<_>>(),
+            "thread count {thread_count}",
+        );
+    }
+}
+
+#[test]
+fn test_query_cursor_with_fixed_capacity() {
+    let language = get_language("javascript");
+    let mut parser = Parser::new();
+    parser.set_language(&language).unwrap();
+
+    let source_code = "const a = [b, c.d(e), { f: g }];\n".repeat(100);
+    let tree = parser.parse(&source_code, None).unwrap();
+    let query = Query::new(
+        &language,
+        "
+        (pair key: (_) @key value: (_) @value)
+        (array (identifier) @first . (_) @second)
+        (call_expression function: (_) @function arguments: (_) @arguments)
+        (identifier) @identifier
+        ",
+    )
+    .unwrap();
+
+    let collect = |cursor: &mut QueryCursor| {
+        cursor
+            .captures(&query, tree.root_node(), source_code.as_bytes())
+            .map(|(m, i)| (m.pattern_index, m.captures[i].index, m.captures[i].node))
+            .collect::<Vec<_>>()
+    };
+
+    let expected = collect(&mut QueryCursor::new());
+
+    let mut cursor = QueryCursor::new();
+    cursor.set_capacity(32, 4);
+    assert_eq!(collect(&mut cursor), expected);
+    assert!(!cursor.did_exceed_match_limit());
+
+    cursor.set_capacity(2, 1);
+    assert!(collect(&mut cursor).len() < expected.len());
+    assert!(cursor.did_exceed_match_limit());
+
+    // A zero state count removes the capture limit too.
+    cursor.set_capacity(0, 1);
+    assert_eq!(collect(&mut cursor), expected);
+    assert!(!cursor.did_exceed_match_limit());
+
+    cursor.set_capacity(0, 0);
+    assert_eq!(collect(&mut cursor), expected);
+    assert!(!cursor.did_exceed_match_limit());
+}
+
+#[test]
+fn test_query_cursor_exec_incremental_random_edits() {
+    allocations::record(|| {
+        let language = get_language("javascript");
+        let mut parser = Parser::new();
+        parser.set_language(&language).unwrap();
+
+        let query = Query::new(
+            &language,
+            r#"
+            (function_declaration name: (identifier) @name body: (_) @body)
+            (call_expression function: (identifier) @callee arguments: (arguments (_)* @arg))
+            ((comment) @comment . (expression_statement) @statement)
+            (pair key: (_) @key value: (_)? @value)
+            (string) @string
+            "#,
+        )
+        .unwrap();
+        let query_ptr = query.into_raw();
+        let cursor = unsafe { ffi::ts_query_cursor_new() };
+        let matches = unsafe { ffi::ts_query_match_set_new() };
+        let added = unsafe { ffi::ts_query_match_set_new() };
+        let removed = unsafe { ffi::ts_query_match_set_new() };
+
+        // The matches of a full run, with duplicates removed, in the same form
+        // as the matches that a match set stores.
+        let full_matches = |tree: *const ffi::TSTree| {
+            let mut result = Vec::new();
+            unsafe {
+                ffi::ts_query_cursor_exec(cursor, query_ptr, ffi::ts_tree_root_node(tree));
+                let mut m = MaybeUninit::<ffi::TSQueryMatch>::uninit();
+                while ffi::ts_query_cursor_next_match(cursor, m.as_mut_ptr()) {
+                    let m = m.assume_init_ref();
+                    let captures = slice::from_raw_parts(m.captures, m.capture_count as usize)
+                        .iter()
+                        .map(|c| {
+                            let node = c.node;
+                            (
+                                c.index,
+                                ffi::ts_node_start_byte(node),
+                                ffi::ts_node_end_byte(node),
+                            )
+                        })
+                        .collect::<Vec<_>>();
+                    result.push((u32::from(m.pattern_index), captures));
+                }
+            }
+            result.sort_unstable();
+            result.dedup();
+            result
+        };
+        let set_matches = |set: *const ffi::TSQueryMatchSet| {
+            let mut result = (0..unsafe { ffi::ts_query_match_set_count(set) })
+                .map(|i| unsafe {
+                    let m = ffi::ts_query_match_set_match(set, i);
+                    let captures = slice::from_raw_parts(m.captures, m.capture_count as usize)
+                        .iter()
+                        .map(|c| (c.index, c.range.start_byte, c.range.end_byte))
+                        .collect::<Vec<_>>();
+                    (m.pattern_index, captures)
+                })
+                .collect::<Vec<_>>();
+            result.sort_unstable();
+            result
+        };
+
+        let mut source = indoc! {r#"
+            // Add two numbers.
+            function add(a, b) {
+              return a + b;
+            }
+
+            // Print the sum.
+            console.log(add(1, 2), "three");
+            const config = { name: "example", values: [1, 2, 3], nested: { deep: true } };
+            function main() {
+              // Run it.
+              print(config.name, add(config.values[0], 4));
+            }
+        "#}
+        .as_bytes()
+        .to_vec();
+        let mut tree = parser.parse(&source, None).unwrap().into_raw();
+        assert!(unsafe {
+            ffi::ts_query_cursor_exec_incremental(
+                cursor,
+                query_ptr,
+                matches,
+                ptr::null(),
+                tree,
+                ptr::null_mut(),
+                ptr::null_mut(),
+            )
+        });
+        assert_eq!(set_matches(matches), full_matches(tree));
+
+        for seed in 0..*ITERATION_COUNT {
+            let mut rand = Rand::new(seed);
+            for _ in 0..3 {
+                let edit = get_random_edit(&mut rand, &source);
+                let mut old_tree = unsafe { Tree::from_raw(tree) };
+                let input_edit = perform_edit(&mut old_tree, &mut source, &edit).unwrap();
+                unsafe { ffi::ts_query_match_set_edit(matches, &(&input_edit).into()) };
+                let old_matches = set_matches(matches);
+
+                let new_tree = parser.parse(&source, Some(&old_tree)).unwrap().into_raw();
+                tree = old_tree.into_raw();
+                assert!(unsafe {
+                    ffi::ts_query_cursor_exec_incremental(
+                        cursor, query_ptr, matches, tree, new_tree, added, removed,
+                    )
+                });
+                drop(unsafe { Tree::from_raw(tree) });
+                tree = new_tree;
+
+                let expected = full_matches(tree);
+                assert_eq!(
+                    set_matches(matches),
+                    expected,
+                    "seed: {seed}, source:\n{}",
+                    String::from_utf8_lossy(&source)
+                );
+
+                // The old matches, without the removed ones and with the
+                // added ones, are the new matches.
+                let removed_matches = set_matches(removed);
+                let mut updated_matches = old_matches
+                    .into_iter()
+                    .filter(|m| removed_matches.binary_search(m).is_err())
+                    .chain(set_matches(added))
+                    .collect::<Vec<_>>();
+                updated_matches.sort_unstable();
+                assert_eq!(updated_matches, expected, "seed: {seed}");
+            }
+        }
+
+        unsafe {
+            drop(Tree::from_raw(tree));
+            ffi::ts_query_match_set_delete(matches);
+            ffi::ts_query_match_set_delete(added);
+            ffi::ts_query_match_set_delete(removed);
+            ffi::ts_query_cursor_delete(cursor);
+            ffi::ts_query_delete(query_ptr);
+        }
+    });
+}
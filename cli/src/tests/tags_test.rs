@@ -1,15 +1,19 @@
 use std::{
     ffi::{CStr, CString},
     fs, ptr, slice, str,
+    sync::Mutex,
 };
 
-use tree_sitter::Point;
-use tree_sitter_tags::{c_lib as c, Error, TagsConfiguration, TagsContext};
+use tree_sitter::{InputEdit, Point};
+use tree_sitter_tags::{
+    c_lib as c, generate_tags_in_parallel, Error, Tag, TagsConfiguration, TagsContext, TagsSession,
+};
 
 use super::helpers::{
     allocations,
     fixtures::{get_language, get_language_queries_path},
 };
+use crate::parse::position_for_offset;
 
 const PYTHON_TAG_QUERY: &str = r#"
 (
@@ -293,6 +297,113 @@ fn test_tags_cancellation() {
     });
 }
 
+#[test]
+fn test_tags_in_parallel() {
+    let python_config =
+        TagsConfiguration::new(get_language("python"), PYTHON_TAG_QUERY, "").unwrap();
+    let js_config = TagsConfiguration::new(get_language("javascript"), JS_TAG_QUERY, "").unwrap();
+    let documents = (0..40)
+        .map(|i| {
+            if i % 2 == 0 {
+                (&python_config, format!("def f{i}():\n    g{i}()\n"))
+            } else {
+                (
+                    &js_config,
+                    format!("/* c{i} */\nfunction f{i}() {{ g{i}(); }}\n"),
+                )
+            }
+        })
+        .collect::<Vec<_>>();
+
+    let mut expected = Vec::new();
+    let mut context = TagsContext::new();
+    for (i, (config, source)) in documents.iter().enumerate() {
+        let tags = context
+            .generate_tags(config, source.as_bytes(), None)
+            .unwrap()
+            .0
+            .collect::<Result<Vec<_>, _>>()
+            .unwrap();
+        write_tags(&mut expected, i, config, source.as_bytes(), &tags);
+    }
+    let mut expected = str::from_utf8(&expected)
+        .unwrap()
+        .lines()
+        .collect::<Vec<_>>();
+    expected.sort_unstable();
+
+    for thread_count in [1, 4] {
+        let output = Mutex::new(Vec::new());
+        generate_tags_in_parallel(
+            &(0..documents.len()).collect::<Vec<_>>(),
+            thread_count,
+            None,
+            &output,
+            |i| Some((documents[*i].0, documents[*i].1.clone().into_bytes())),
+            |output, i, config, source, tags| {
+                write_tags(output, *i, config, source, tags.unwrap());
+                Ok(())
+            },
+        )
+        .unwrap();
+        let output = output.into_inner().unwrap();
+        let mut lines = str::from_utf8(&output).unwrap().lines().collect::<Vec<_>>();
+        lines.sort_unstable();
+        assert_eq!(lines, expected);
+    }
+}
+
+#[test]
+fn test_tags_session() {
+    let tags_config = TagsConfiguration::new(get_language("javascript"), JS_TAG_QUERY, "").unwrap();
+    let mut source = "// A.\nclass A {\n  getA() { b(); }\n}\n\nfunction b() { c(); }\n"
+        .repeat(10)
+        .into_bytes();
+    let edits = [
+        (214, 0, "/* B. */\n"),
+        (304, 6, ""),
+        (52, 1, "d"),
+        (502, 0, "e(); "),
+        (598, 0, "\nclass Z {}\n"),
+    ];
+
+    let mut context = TagsContext::new();
+    let mut session = TagsSession::new();
+    session
+        .generate_tags(&mut context, &tags_config, &source, None)
+        .unwrap();
+
+    for (position, deleted_length, inserted_text) in edits {
+        let start_position = position_for_offset(&source, position).unwrap();
+        let old_end_position = position_for_offset(&source, position + deleted_length).unwrap();
+        source.splice(position..position + deleted_length, inserted_text.bytes());
+        let new_end_position =
+            position_for_offset(&source, position + inserted_text.len()).unwrap();
+        session.edit(&InputEdit {
+            start_byte: position,
+            old_end_byte: position + deleted_length,
+            new_end_byte: position + inserted_text.len(),
+            start_position,
+            old_end_position,
+            new_end_position,
+        });
+        let tags = session
+            .generate_tags(&mut context, &tags_config, &source, None)
+            .unwrap()
+            .to_vec();
+
+        let expected_tags = context
+            .generate_tags(&tags_config, &source, None)
+            .unwrap()
+            .0
+            .collect::<Result<Vec<_>, _>>()
+            .unwrap();
+        assert_eq!(tags, expected_tags);
+    }
+    assert_eq!(session.tags()[18].docs.as_deref(), Some("B."));
+    assert_eq!(session.tags()[25].docs, None);
+}
+
 #[test]
 fn test_invalid_capture() {
     let language = get_language("python");
@@ -432,6 +543,30 @@ fn test_tags_via_c_api() {
     });
 }
 
+// Write a document's tags as a line of text, so that the tags of many documents can be
+// compared regardless of their order.
+fn write_tags(
+    output: &mut Vec<u8>,
+    index: usize,
+    config: &TagsConfiguration,
+    source: &[u8],
+    tags: &[Tag],
+) {
+    output.extend(format!("{index}:").as_bytes());
+    for tag in tags {
+        output.extend(
+            format!(
+                " {} {} {:?}",
+                substr(source, &tag.name_range),
+                config.syntax_type_name(tag.syntax_type_id),
+                tag.docs
+            )
+            .as_bytes(),
+        );
+    }
+    output.push(b'\n');
+}
+
 fn substr<'a>(source: &'a [u8], range: &std::ops::Range<usize>) -> &'a str {
     std::str::from_utf8(&source[range.clone()]).unwrap()
 }
@@ -1,6 +1,10 @@
-use std::str;
+use std::{
+    str,
+    sync::atomic::{AtomicBool, Ordering},
+    thread,
+};
 
-use tree_sitter::{InputEdit, Parser, Point, Range, Tree};
+use tree_sitter::{InputEdit, Parser, Point, Range, Tree, TreeCursorWalkOptions, TreeSnapshot};
 
 use super::helpers::fixtures::get_language;
 use crate::{fuzz::edits::Edit, parse::perform_edit, tests::invert_edit};
@@ -453,6 +457,84 @@ fn test_tree_cursor_fields() {
     assert_eq!(cursor.field_name(), Some("parameters"));
 }
 
+#[test]
+fn test_tree_cursor_walk_nodes() {
+    let mut parser = Parser::new();
+    let language = get_language("javascript");
+    parser.set_language(&language).unwrap();
+
+    let source = "function foo(a) { return [a, b]; }";
+    let tree = parser.parse(source, None).unwrap();
+
+    let mut expected = Vec::new();
+    let mut cursor = tree.walk();
+    'walk: loop {
+        expected.push((cursor.node(), cursor.field_id(), cursor.depth()));
+        if cursor.goto_first_child() {
+            continue;
+        }
+        while !cursor.goto_next_sibling() {
+            if !cursor.goto_parent() {
+                break 'walk;
+            }
+        }
+    }
+
+    // Walking in small batches visits the same nodes as moving the cursor.
+    let mut entries = Vec::new();
+    while cursor.walk_nodes(&TreeCursorWalkOptions::default(), &mut entries, 3) {
+        assert_eq!(entries.len() % 3, 0);
+    }
+    assert_eq!(
+        entries
+            .iter()
+            .map(|entry| (entry.node, entry.field_id, entry.depth))
+            .collect::<Vec<_>>(),
+        expected
+    );
+    assert_eq!(cursor.node(), tree.root_node());
+
+    // Only nodes of the given kinds are returned, at any depth.
+    let identifier = language.id_for_node_kind("identifier", true);
+    let mut symbols = vec![0; identifier as usize / 8 + 1];
+    symbols[identifier as usize / 8] |= 1 << (identifier % 8);
+    let options = TreeCursorWalkOptions {
+        symbols: Some(&symbols),
+        ..Default::default()
+    };
+    entries.clear();
+    assert!(!cursor.walk_nodes(&options, &mut entries, 100));
+    assert_eq!(
+        entries
+            .iter()
+            .map(|entry| entry.node.utf8_text(source.as_bytes()).unwrap())
+            .collect::<Vec<_>>(),
+        ["foo", "a", "a", "b"]
+    );
+
+    // Anonymous nodes and deep nodes are skipped.
+    let options = TreeCursorWalkOptions {
+        max_depth: 2,
+        named_only: true,
+        ..Default::default()
+    };
+    entries.clear();
+    assert!(!cursor.walk_nodes(&options, &mut entries, 100));
+    assert_eq!(
+        entries
+            .iter()
+            .map(|entry| (entry.node.kind(), entry.depth))
+            .collect::<Vec<_>>(),
+        [
+            ("program", 0),
+            ("function_declaration", 1),
+            ("identifier", 2),
+            ("formal_parameters", 2),
+            ("statement_block", 2),
+        ]
+    );
+}
+
 #[test]
 fn test_tree_cursor_child_for_point() {
     let mut parser = Parser::new();
@@ -679,6 +761,43 @@ fn test_get_changed_ranges() {
     }
 }
 
+#[test]
+fn test_get_changed_nodes() {
+    let mut source_code = b"{a: null};\nf([1, 2]);\n".to_vec();
+
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("javascript")).unwrap();
+    let mut tree = parser.parse(&source_code, None).unwrap();
+
+    // Replace `null` with `nothing`, and insert an element into the array.
+    let edits = [
+        Edit {
+            position: index_of(&source_code, "2]"),
+            deleted_length: 0,
+            inserted_text: b"3, ".to_vec(),
+        },
+        Edit {
+            position: index_of(&source_code, "ull"),
+            deleted_length: 3,
+            inserted_text: b"othing".to_vec(),
+        },
+    ];
+    for edit in &edits {
+        perform_edit(&mut tree, &mut source_code, edit).unwrap();
+    }
+    let new_tree = parser.parse(&source_code, Some(&tree)).unwrap();
+
+    let ranges = tree.changed_ranges(&new_tree).collect::<Vec<_>>();
+    let nodes = tree.changed_nodes(&new_tree).collect::<Vec<_>>();
+    assert_eq!(ranges.len(), 2);
+    assert_eq!(
+        nodes.iter().map(|n| n.kind()).collect::<Vec<_>>(),
+        vec!["identifier", "array"]
+    );
+    assert_eq!(nodes[0].range(), range_of(&source_code, "nothing"));
+    assert_eq!(nodes[1].range(), range_of(&source_code, "[1, 3, 2]"));
+}
+
 #[test]
 fn test_consistency_with_mid_codepoint_edit() {
     let mut parser = Parser::new();
@@ -729,6 +848,438 @@ fn main() {
     assert_eq!(cursor.node().kind(), "block_comment");
 }
 
+#[test]
+fn test_tree_serialization() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("python")).unwrap();
+
+    let mut source_code =
+        b"def a():\n    if b:\n        c(\"\"\"d\"\"\")\n    e = [f, g\n".to_vec();
+    let mut tree = parser.parse(&source_code, None).unwrap();
+    assert!(tree.root_node().has_error());
+
+    let data = tree.serialize();
+    let mut loaded_tree = Tree::deserialize(&get_language("python"), &data).unwrap();
+    assert_eq!(
+        loaded_tree.root_node().to_sexp(),
+        tree.root_node().to_sexp()
+    );
+    assert_eq!(loaded_tree.included_ranges(), tree.included_ranges());
+    assert_eq!(loaded_tree.serialize(), data);
+
+    // Malformed data, and data for a different language, are rejected.
+    assert!(Tree::deserialize(&get_language("python"), &data[..data.len() - 1]).is_none());
+    assert!(Tree::deserialize(&get_language("python"), &[]).is_none());
+    assert!(Tree::deserialize(&get_language("javascript"), &data).is_none());
+
+    // The buffer doesn't need to be aligned.
+    let mut unaligned_data = vec![0];
+    unaligned_data.extend_from_slice(&data);
+    let unaligned_tree = Tree::deserialize(&get_language("python"), &unaligned_data[1..]).unwrap();
+    assert_eq!(unaligned_tree.included_ranges(), tree.included_ranges());
+
+    // Corrupted data is either rejected, or loads a tree that can be walked.
+    for i in 0..data.len() {
+        let mut corrupted_data = data.clone();
+        corrupted_data[i] ^= 0x5a;
+        if let Some(corrupted_tree) = Tree::deserialize(&get_language("python"), &corrupted_data) {
+            assert!(!corrupted_tree.root_node().to_sexp().is_empty());
+        }
+    }
+
+    // The loaded tree can be used for an incremental parse.
+    let edit = Edit {
+        position: index_of(&source_code, "c("),
+        deleted_length: 1,
+        inserted_text: b"hello".to_vec(),
+    };
+    let mut edited_source_code = source_code.clone();
+    perform_edit(&mut loaded_tree, &mut edited_source_code, &edit).unwrap();
+    perform_edit(&mut tree, &mut source_code, &edit).unwrap();
+    let new_tree = parser.parse(&source_code, Some(&tree)).unwrap();
+    let new_loaded_tree = parser.parse(&source_code, Some(&loaded_tree)).unwrap();
+    assert_eq!(
+        new_loaded_tree.root_node().to_sexp(),
+        parser
+            .parse(&source_code, None)
+            .unwrap()
+            .root_node()
+            .to_sexp()
+    );
+    assert_eq!(
+        loaded_tree
+            .changed_ranges(&new_loaded_tree)
+            .collect::<Vec<_>>(),
+        tree.changed_ranges(&new_tree).collect::<Vec<_>>()
+    );
+}
+
+#[test]
+fn test_tree_child_index() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("javascript")).unwrap();
+
+    let elements = (0..100)
+        .map(|i| {
+            if i % 3 == 0 {
+                format!("a{i}")
+            } else {
+                i.to_string()
+            }
+        })
+        .collect::<Vec<_>>();
+    let source_code = format!("x = [{}];", elements.join(", "));
+    let tree = parser.parse(&source_code, None).unwrap();
+    let mut indexed_tree = tree.clone();
+    indexed_tree.build_child_index();
+
+    let array = tree.root_node().descendant_for_byte_range(4, 5).unwrap();
+    let indexed_array = indexed_tree
+        .root_node()
+        .descendant_for_byte_range(4, 5)
+        .unwrap();
+    assert_eq!(array.kind(), "array");
+    assert_eq!(indexed_array.child_count(), 201);
+    assert_eq!(indexed_array.named_child_count(), 100);
+
+    for i in 0..=array.child_count() {
+        let child = array.child(i);
+        let indexed_child = indexed_array.child(i);
+        assert_eq!(child.map(|n| n.range()), indexed_child.map(|n| n.range()));
+        assert_eq!(child.map(|n| n.kind()), indexed_child.map(|n| n.kind()));
+        if let (Some(child), Some(indexed_child)) = (child, indexed_child) {
+            assert_eq!(
+                child.next_sibling().map(|n| n.range()),
+                indexed_child.next_sibling().map(|n| n.range())
+            );
+            assert_eq!(
+                child.prev_named_sibling().map(|n| n.range()),
+                indexed_child.prev_named_sibling().map(|n| n.range())
+            );
+        }
+    }
+
+    for i in 0..=array.named_child_count() {
+        assert_eq!(
+            array.named_child(i).map(|n| n.range()),
+            indexed_array.named_child(i).map(|n| n.range())
+        );
+    }
+}
+
+#[test]
+fn test_tree_parent_index() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("javascript")).unwrap();
+
+    let source_code = format!("x = {}1{};", "[(".repeat(50), ")]".repeat(50));
+    let tree = parser.parse(&source_code, None).unwrap();
+    let mut indexed_tree = tree.clone();
+    assert_eq!(indexed_tree.index_size(), 0);
+    indexed_tree.build_parent_index();
+    assert!(indexed_tree.index_size() > 0);
+
+    let position = source_code.find('1').unwrap();
+    let leaf = tree
+        .root_node()
+        .descendant_for_byte_range(position, position)
+        .unwrap();
+    let indexed_leaf = indexed_tree
+        .root_node()
+        .descendant_for_byte_range(position, position)
+        .unwrap();
+    let ancestors = leaf.ancestors().collect::<Vec<_>>();
+    let indexed_ancestors = indexed_leaf.ancestors().collect::<Vec<_>>();
+    assert!(ancestors.len() > 100);
+    assert_eq!(ancestors.last().unwrap().kind(), "program");
+    assert_eq!(
+        ancestors.iter().map(|n| n.range()).collect::<Vec<_>>(),
+        indexed_ancestors
+            .iter()
+            .map(|n| n.range())
+            .collect::<Vec<_>>()
+    );
+    assert_eq!(
+        ancestors.iter().map(|n| n.kind()).collect::<Vec<_>>(),
+        indexed_ancestors
+            .iter()
+            .map(|n| n.kind())
+            .collect::<Vec<_>>()
+    );
+
+    indexed_tree.edit(&InputEdit {
+        start_byte: 0,
+        old_end_byte: 0,
+        new_end_byte: 1,
+        start_position: Point::new(0, 0),
+        old_end_position: Point::new(0, 0),
+        new_end_position: Point::new(0, 1),
+    });
+    assert_eq!(indexed_tree.index_size(), 0);
+}
+
+#[test]
+fn test_tree_compact() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("javascript")).unwrap();
+
+    // Build up a long array one element at a time, reparsing after each edit.
+    let mut source_code = "x = [0];".to_string();
+    let mut tree = parser.parse(&source_code, None).unwrap();
+    for i in 1..300 {
+        let position = source_code.len() - 2;
+        let element = format!(", {i}");
+        source_code.insert_str(position, &element);
+        tree.edit(&InputEdit {
+            start_byte: position,
+            old_end_byte: position,
+            new_end_byte: position + element.len(),
+            start_position: Point::new(0, position),
+            old_end_position: Point::new(0, position),
+            new_end_position: Point::new(0, position + element.len()),
+        });
+        tree = parser.parse(&source_code, Some(&tree)).unwrap();
+    }
+
+    let mut compacted_tree = tree.clone();
+    compacted_tree.build_child_index();
+    compacted_tree.compact();
+    assert_eq!(compacted_tree.index_size(), 0);
+    assert_eq!(
+        compacted_tree.root_node().to_sexp(),
+        tree.root_node().to_sexp()
+    );
+    assert_eq!(compacted_tree.changed_ranges(&tree).count(), 0);
+    drop(tree);
+
+    // The compacted tree can be reused by an incremental parse.
+    let position = source_code.find('0').unwrap();
+    source_code.replace_range(position..position + 3, "");
+    compacted_tree.edit(&InputEdit {
+        start_byte: position,
+        old_end_byte: position + 3,
+        new_end_byte: position,
+        start_position: Point::new(0, position),
+        old_end_position: Point::new(0, position + 3),
+        new_end_position: Point::new(0, position),
+    });
+    let tree = parser.parse(&source_code, Some(&compacted_tree)).unwrap();
+    let new_tree = parser.parse(&source_code, None).unwrap();
+    assert_eq!(tree.root_node().to_sexp(), new_tree.root_node().to_sexp());
+    assert_eq!(
+        tree.root_node().child(0).unwrap().end_byte(),
+        new_tree.root_node().child(0).unwrap().end_byte()
+    );
+}
+
+#[test]
+fn test_tree_memory_usage() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("javascript")).unwrap();
+
+    let mut source_code = "const a = [1, 2, 3];\nfunction b(c) { return c.d; }\n".repeat(50);
+    let mut tree = parser.parse(&source_code, None).unwrap();
+
+    // The estimate counts the same nodes as a walk of the tree, and a tree that
+    // hasn't been copied doesn't share any of them.
+    let estimate = tree.memory_usage();
+    let exact = tree.memory_usage_exact();
+    assert_eq!(estimate.inline_nodes, exact.inline_nodes);
+    assert_eq!(estimate.heap_nodes, exact.heap_nodes);
+    assert!(estimate.heap_nodes > 0);
+    assert_eq!(estimate.shared_bytes, 0);
+    assert_eq!(exact.shared_bytes, 0);
+    assert_eq!(
+        estimate.exclusive_bytes + exact.scanner_state_bytes,
+        exact.exclusive_bytes
+    );
+
+    // A clone shares all of its nodes.
+    let clone = tree.clone();
+    let shared = tree.memory_usage_exact();
+    assert!(shared.shared_bytes > 0);
+    assert!(shared.exclusive_bytes < exact.exclusive_bytes);
+    assert_eq!(
+        shared.exclusive_bytes + shared.shared_bytes,
+        exact.exclusive_bytes
+    );
+    assert_eq!(tree.memory_usage().shared_bytes, shared.shared_bytes);
+    drop(clone);
+    assert_eq!(tree.memory_usage_exact(), exact);
+
+    // After an incremental parse, the new tree shares most of its nodes with
+    // the old one, until the old one is dropped.
+    let position = source_code.find('2').unwrap();
+    source_code.replace_range(position..=position, "4");
+    tree.edit(&InputEdit {
+        start_byte: position,
+        old_end_byte: position + 1,
+        new_end_byte: position + 1,
+        start_position: Point::new(0, position),
+        old_end_position: Point::new(0, position + 1),
+        new_end_position: Point::new(0, position + 1),
+    });
+    let new_tree = parser.parse(&source_code, Some(&tree)).unwrap();
+    let reparsed = new_tree.memory_usage_exact();
+    assert!(reparsed.shared_bytes > reparsed.exclusive_bytes);
+    drop(tree);
+    assert_eq!(new_tree.memory_usage_exact().shared_bytes, 0);
+
+    // The indices are part of the tree's own memory.
+    let mut tree = new_tree;
+    let before = tree.memory_usage();
+    tree.build_child_index();
+    assert_eq!(
+        tree.memory_usage().exclusive_bytes,
+        before.exclusive_bytes + tree.index_size()
+    );
+
+    // The indices are shared with the tree's clones, and outlive its edits.
+    let clone = tree.clone();
+    assert_eq!(clone.index_size(), tree.index_size());
+    assert!(tree.memory_usage().shared_bytes > tree.index_size());
+    tree.edit(&InputEdit {
+        start_byte: 0,
+        old_end_byte: 0,
+        new_end_byte: 1,
+        start_position: Point::new(0, 0),
+        old_end_position: Point::new(0, 0),
+        new_end_position: Point::new(0, 1),
+    });
+    assert_eq!(tree.index_size(), 0);
+    assert_eq!(
+        clone.memory_usage().exclusive_bytes,
+        before.exclusive_bytes + clone.index_size()
+    );
+}
+
+#[test]
+fn test_tree_flatten() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("rust")).unwrap();
+
+    let source_code = "
+        struct Stuff {
+            a: A,
+            b: Option<B>,
+        }
+
+        fn main() {
+            let x = Stuff { a: 1, b: None };
+            if (x.a > 2 {
+                return;
+            }
+        }
+    ";
+    let tree = parser.parse(source_code, None).unwrap();
+    let flat_tree = tree.flatten();
+    assert_eq!(
+        flat_tree.language().node_kind_count(),
+        tree.language().node_kind_count()
+    );
+
+    // Walk both trees in preorder, in lockstep.
+    let mut cursor = tree.walk();
+    let mut flat_cursor = flat_tree.walk();
+    let mut node_count = 0;
+    'walk: loop {
+        let node = cursor.node();
+        let flat_node = flat_cursor.node();
+        assert_eq!(flat_cursor.descendant_index(), cursor.descendant_index());
+        assert_eq!(flat_node.kind_id, node.kind_id());
+        assert_eq!(flat_node.field_id, cursor.field_id());
+        assert_eq!(flat_node.range, node.range());
+        assert_eq!(flat_node.is_named, node.is_named());
+        assert_eq!(flat_node.is_extra, node.is_extra());
+        assert_eq!(flat_node.is_missing, node.is_missing());
+        assert_eq!(flat_node.has_error, node.has_error());
+        node_count += 1;
+
+        if cursor.goto_first_child() {
+            assert!(flat_cursor.goto_first_child());
+            continue;
+        }
+        assert!(!flat_cursor.goto_first_child());
+        while !cursor.goto_next_sibling() {
+            assert!(!flat_cursor.goto_next_sibling());
+            if !cursor.goto_parent() {
+                break 'walk;
+            }
+            assert!(flat_cursor.goto_parent());
+        }
+        assert!(flat_cursor.goto_next_sibling());
+    }
+    assert_eq!(node_count, flat_tree.node_count());
+    assert_eq!(node_count, tree.root_node().descendant_count());
+
+    // The snapshot remains valid after the tree is dropped.
+    cursor.goto_descendant(node_count - 1);
+    let last_range = cursor.node().range();
+    drop(cursor);
+    drop(tree);
+    flat_cursor.goto_descendant(node_count - 1);
+    assert_eq!(flat_cursor.node().range, last_range);
+}
+
+#[test]
+fn test_tree_snapshot() {
+    let mut parser = Parser::new();
+    parser.set_language(&get_language("javascript")).unwrap();
+
+    // Each version of the document adds another element to the array.
+    let mut source_code = "x = [a];".to_string();
+    let mut tree = parser.parse(&source_code, None).unwrap();
+    let snapshot = TreeSnapshot::new(Some(&tree));
+    let version_count = 50;
+    let is_done = AtomicBool::new(false);
+
+    thread::scope(|scope| {
+        for _ in 0..4 {
+            scope.spawn(|| {
+                let mut last_version = 0;
+                loop {
+                    let is_last = is_done.load(Ordering::SeqCst);
+                    let tree = snapshot.acquire().unwrap();
+                    let root = tree.root_node();
+                    let version = (root.end_byte() - 8) / 3;
+                    assert!(version >= last_version);
+                    assert_eq!(root.to_sexp().matches("(identifier)").count(), version + 2);
+                    last_version = version;
+                    if is_last {
+                        assert_eq!(version, version_count);
+                        break;
+                    }
+                }
+            });
+        }
+
+        for _ in 0..version_count {
+            let position = source_code.len() - 2;
+            source_code.insert_str(position, ", a");
+            tree.edit(&InputEdit {
+                start_byte: position,
+                old_end_byte: position,
+                new_end_byte: position + 3,
+                start_position: Point::new(0, position),
+                old_end_position: Point::new(0, position),
+                new_end_position: Point::new(0, position + 3),
+            });
+            tree = parser.parse(&source_code, Some(&tree)).unwrap();
+            snapshot.publish(Some(&tree));
+        }
+        is_done.store(true, Ordering::SeqCst);
+    });
+
+    // Trees that were acquired earlier are unaffected by later versions.
+    let acquired_tree = snapshot.acquire().unwrap();
+    snapshot.publish(None);
+    assert!(snapshot.acquire().is_none());
+    assert_eq!(
+        acquired_tree.root_node().to_sexp(),
+        tree.root_node().to_sexp()
+    );
+}
+
 fn index_of(text: &[u8], substring: &str) -> usize {
     str::from_utf8(text).unwrap().find(substring).unwrap()
 }
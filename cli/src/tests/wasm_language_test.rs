@@ -2,7 +2,8 @@ use std::fs;
 
 use lazy_static::lazy_static;
 use tree_sitter::{
-    wasmtime::Engine, Parser, Query, QueryCursor, WasmError, WasmErrorKind, WasmStore,
+    wasmtime::Engine, Parser, Query, QueryCursor, WasmError, WasmErrorKind, WasmModuleCache,
+    WasmStore,
 };
 
 use crate::tests::helpers::{allocations, fixtures::WASM_DIR};
@@ -196,6 +197,53 @@ fn test_load_and_reload_wasm_language() {
     });
 }
 
+#[test]
+fn test_load_wasm_languages_from_a_module_cache() {
+    let cache_dir = tempfile::tempdir().unwrap();
+    let wasm = fs::read(WASM_DIR.join("tree-sitter-ruby.wasm")).unwrap();
+
+    allocations::record(|| {
+        // The second cache starts out empty, but finds the modules that the
+        // first one precompiled in the cache directory.
+        for _ in 0..2 {
+            let mut cache = WasmModuleCache::new(&ENGINE);
+            unsafe { cache.set_directory(cache_dir.path()) };
+
+            let sexps = std::thread::scope(|scope| {
+                let threads = (0..2)
+                    .map(|_| {
+                        scope.spawn(|| {
+                            let mut store = WasmStore::with_cache(&cache).unwrap();
+                            let language = store.load_language("ruby", &wasm).unwrap();
+                            let mut parser = Parser::new();
+                            parser.set_wasm_store(store).unwrap();
+                            parser.set_language(&language).unwrap();
+                            let tree = parser.parse("class A; end", None).unwrap();
+                            tree.root_node().to_sexp()
+                        })
+                    })
+                    .collect::<Vec<_>>();
+                threads
+                    .into_iter()
+                    .map(|thread| thread.join().unwrap())
+                    .collect::<Vec<_>>()
+            });
+            for sexp in sexps {
+                assert_eq!(sexp, "(program (class name: (constant)))");
+            }
+        }
+    });
+
+    // One precompiled module for the wasm stdlib and one for the language, with
+    // no temporary files left behind.
+    let file_names = fs::read_dir(cache_dir.path())
+        .unwrap()
+        .map(|entry| entry.unwrap().file_name().into_string().unwrap())
+        .collect::<Vec<_>>();
+    assert_eq!(file_names.len(), 2);
+    assert!(file_names.iter().all(|name| name.ends_with(".cwasm")));
+}
+
 #[test]
 fn test_reset_wasm_store() {
     allocations::record(|| {
@@ -72,6 +72,8 @@ pub fn compile_language_to_wasm(
         "abort",
         "emscripten_notify_memory_growth",
         "tree_sitter_debug_message",
+        "tree_sitter_lexer_advance_by",
+        "tree_sitter_lexer_peek",
         "proc_exit",
     ];
 
@@ -2,8 +2,8 @@
 
 pub mod c_lib;
 use std::{
-    collections::HashSet,
-    iter, mem, ops, str,
+    collections::{HashMap, HashSet},
+    io, iter, mem, ops, str,
     sync::atomic::{AtomicUsize, Ordering},
 };
 
@@ -11,8 +11,8 @@ pub use c_lib as c;
 use lazy_static::lazy_static;
 use thiserror::Error;
 use tree_sitter::{
-    Language, LossyUtf8, Node, Parser, Point, Query, QueryCaptures, QueryCursor, QueryError,
-    QueryMatch, Range, Tree,
+    InputEdit, Language, LossyUtf8, Node, Parser, Point, Query, QueryCaptures, QueryCursor,
+    QueryError, QueryMatch, Range, Tree,
 };
 
 const CANCELLATION_CHECK_INTERVAL: usize = 100;
@@ -93,6 +93,12 @@ pub enum Error {
     Unknown,
 }
 
+impl From<Error> for io::Error {
+    fn from(error: Error) -> Self {
+        Self::other(error)
+    }
+}
+
 /// Represents a single step in rendering a syntax-highlighted document.
 #[derive(Copy, Clone, Debug)]
 pub enum HighlightEvent {
@@ -129,6 +135,113 @@ pub struct HighlightConfiguration {
 pub struct Highlighter {
     pub parser: Parser,
     cursors: Vec<QueryCursor>,
+    thread_parsers: Vec<Parser>,
+    parsed_trees: HashMap<LayerKey, Tree>,
+    session: Option<SessionState>,
+}
+
+/// Keeps the syntax trees and the events from highlighting a document, so that after the
+/// document is edited, it can be highlighted again by reparsing each language layer
+/// incrementally, and the change in its highlighting can be reported as a [`HighlightDelta`].
+#[derive(Default)]
+pub struct HighlightSession {
+    trees: Vec<(usize, Tree)>,
+    events: Vec<HighlightEvent>,
+    source_len: usize,
+    edit: Option<(usize, usize, usize)>,
+}
+
+/// The change in a document's highlighting between two calls to
+/// [`HighlightSession::highlight`].
+///
+/// The events of the previous highlighting outside of `old_events` are unchanged, apart from
+/// their byte offsets having moved with the edits. Every highlight that is started within
+/// `events` also ends within it.
+#[derive(Clone, Debug)]
+pub struct HighlightDelta {
+    /// The indices of the previous events that were replaced.
+    pub old_events: ops::Range<usize>,
+    /// The byte range of the previous source that the replaced events covered.
+    pub old_range: ops::Range<usize>,
+    /// The byte range of the new source that the new events cover.
+    pub range: ops::Range<usize>,
+    /// The events that replace the previous ones.
+    pub events: Vec<HighlightEvent>,
+}
+
+// The part of the document that a `HighlightSession` queries again after an edit, along
+// with the previous events before and after it.
+struct SessionWindow {
+    range: ops::Range<usize>,
+    prefix_len: usize,
+    suffix_start: usize,
+    old_end: usize,
+    new_end: usize,
+}
+
+impl SessionWindow {
+    // Combine the previous events outside of the window with the new events within it. Source
+    // events that meet at either end of the window are merged, as they would be when
+    // highlighting the whole document.
+    fn splice(
+        &self,
+        old_events: &[HighlightEvent],
+        window_events: Vec<HighlightEvent>,
+    ) -> Vec<HighlightEvent> {
+        fn push(events: &mut Vec<HighlightEvent>, event: HighlightEvent) {
+            if let (
+                Some(HighlightEvent::Source { end, .. }),
+                HighlightEvent::Source {
+                    start: next_start,
+                    end: next_end,
+                },
+            ) = (events.last_mut(), &event)
+            {
+                if *end == *next_start {
+                    *end = *next_end;
+                    return;
+                }
+            }
+            events.push(event);
+        }
+
+        let mut events = Vec::with_capacity(
+            self.prefix_len + window_events.len() + old_events.len() - self.suffix_start,
+        );
+        events.extend_from_slice(&old_events[..self.prefix_len]);
+        for event in window_events {
+            push(&mut events, event);
+        }
+        for event in &old_events[self.suffix_start..] {
+            push(
+                &mut events,
+                match *event {
+                    HighlightEvent::Source { start, end } => HighlightEvent::Source {
+                        start: start - self.old_end + self.new_end,
+                        end: end - self.old_end + self.new_end,
+                    },
+                    event => event,
+                },
+            );
+        }
+        events
+    }
+}
+
+/// The state that [`HighlightSession::highlight`] lends to a [`Highlighter`] while it runs.
+///
+/// * `old_trees` - The edited trees from the previous highlighting, which are used to
+///   reparse each layer incrementally.
+/// * `layer_trees` - The trees of the layers that have been parsed so far.
+/// * `window` - The byte range to query, if only part of the document is queried again.
+/// * `left_window` - Whether a layer or a highlight has changed outside of the window, so
+///   the previous events outside of it cannot be kept.
+#[derive(Default)]
+struct SessionState {
+    old_trees: HashMap<LayerKey, Tree>,
+    layer_trees: Vec<(usize, Tree)>,
+    window: Option<ops::Range<usize>>,
+    left_window: bool,
 }
 
 /// Converts a general-purpose syntax highlighting iterator into a sequence of lines of HTML.
@@ -138,6 +251,35 @@ pub struct HtmlRenderer {
     carriage_return_highlight: Option<Highlight>,
 }
 
+/// Converts a general-purpose syntax highlighting iterator into HTML, writing it directly to
+/// an [`io::Write`], such as a file, a `Vec<u8>`, or a fixed-size `&mut [u8]` buffer.
+///
+/// The markup for every highlight is computed once, when the renderer is created, so that
+/// rendering many documents with the same renderer doesn't allocate. The HTML is the same as
+/// that of [`HtmlRenderer`], except that it isn't split into lines, and no newline is added
+/// at its end.
+pub struct StreamingHtmlRenderer {
+    start_tags: Vec<u8>,
+    start_tag_offsets: Vec<usize>,
+    carriage_return_highlight: Option<Highlight>,
+    highlights: Vec<Highlight>,
+}
+
+// A piece of source code as it is written to HTML.
+enum HtmlPiece<'a> {
+    Text(&'a [u8]),
+    CarriageReturn,
+    LineFeed,
+}
+
+// Splits source code into runs of text that can be written to HTML as they are, the escape
+// sequences for the characters that HTML reserves, and line endings. Invalid UTF-8 is
+// replaced, but text that is all ASCII is split without checking it for UTF-8.
+struct HtmlPieces<'a> {
+    text: &'a [u8],
+    chunks: Option<LossyUtf8<'a>>,
+}
+
 #[derive(Debug)]
 struct LocalDef<'a> {
     name: &'a str,
@@ -159,6 +301,7 @@ where
     source: &'a [u8],
     language_name: &'a str,
     byte_offset: usize,
+    end_byte: usize,
     highlighter: &'a mut Highlighter,
     injection_callback: F,
     cancellation_flag: Option<&'a AtomicUsize>,
@@ -168,6 +311,45 @@ where
     last_highlight_range: Option<(usize, usize, usize)>,
 }
 
+/// A syntax tree parsed by [`Highlighter::highlight_parallel`], along with the language
+/// names and ranges of the injections that were found in it.
+type ParsedLayer = (Tree, Vec<(String, Vec<Range>)>);
+
+/// Identifies a language layer by its configuration and its ranges, so that a tree that
+/// was parsed ahead of time, or by a previous highlighting, can be found when the layer is
+/// created.
+type LayerKey = (usize, Vec<Range>);
+
+fn config_id(config: &HighlightConfiguration) -> usize {
+    config as *const HighlightConfiguration as usize
+}
+
+fn layer_key(config_id: usize, ranges: &[Range]) -> LayerKey {
+    // A syntax tree stores the ranges that extend to the end of the document with 32-bit
+    // maximum values, so treat those as unbounded.
+    let ranges = ranges
+        .iter()
+        .map(|range| {
+            let mut range = *range;
+            if range.end_byte >= u32::MAX as usize {
+                range.end_byte = usize::MAX;
+                range.end_point = Point::new(usize::MAX, usize::MAX);
+            }
+            range
+        })
+        .collect();
+    (config_id, ranges)
+}
+
+// Whether the highlights of a layer can be computed for part of its document on its own.
+// Local variables are tracked from the start of the layer, and a pattern that isn't rooted
+// can relate nodes that lie far apart, so layers that use them are always queried fully.
+fn can_query_window(config: &HighlightConfiguration) -> bool {
+    config.locals_pattern_index == config.highlights_pattern_index
+        && (config.highlights_pattern_index..config.query.pattern_count())
+            .all(|i| config.query.is_pattern_rooted(i))
+}
+
 struct HighlightIterLayer<'a> {
     _tree: Tree,
     cursor: QueryCursor,
@@ -191,6 +373,9 @@ impl Highlighter {
         Self {
             parser: Parser::new(),
             cursors: Vec::new(),
+            thread_parsers: Vec::new(),
+            parsed_trees: HashMap::new(),
+            session: None,
         }
     }
 
@@ -204,8 +389,32 @@ impl Highlighter {
         config: &'a HighlightConfiguration,
         source: &'a [u8],
         cancellation_flag: Option<&'a AtomicUsize>,
-        mut injection_callback: impl FnMut(&str) -> Option<&'a HighlightConfiguration> + 'a,
+        injection_callback: impl FnMut(&str) -> Option<&'a HighlightConfiguration> + 'a,
     ) -> Result<impl Iterator<Item = Result<HighlightEvent, Error>> + 'a, Error> {
+        self.parsed_trees.clear();
+        self.highlight_layers(
+            config,
+            source,
+            cancellation_flag,
+            0..source.len(),
+            injection_callback,
+        )
+    }
+
+    // Create the iterator for `highlight`, `highlight_parallel` and `HighlightSession`, which
+    // emits the events within the given byte range. Layers whose trees were already parsed by
+    // `highlight_parallel` are taken from `parsed_trees`.
+    fn highlight_layers<'a, F>(
+        &'a mut self,
+        config: &'a HighlightConfiguration,
+        source: &'a [u8],
+        cancellation_flag: Option<&'a AtomicUsize>,
+        byte_range: ops::Range<usize>,
+        mut injection_callback: F,
+    ) -> Result<HighlightIter<'a, F>, Error>
+    where
+        F: FnMut(&str) -> Option<&'a HighlightConfiguration> + 'a,
+    {
         let layers = HighlightIterLayer::new(
             source,
             None,
@@ -225,7 +434,8 @@ impl Highlighter {
         let mut result = HighlightIter {
             source,
             language_name: &config.language_name,
-            byte_offset: 0,
+            byte_offset: byte_range.start,
+            end_byte: byte_range.end,
             injection_callback,
             cancellation_flag,
             highlighter: self,
@@ -237,6 +447,469 @@ impl Highlighter {
         result.sort_layers();
         Ok(result)
     }
+
+    /// Iterate over the highlighted regions for a given slice of source code, parsing
+    /// injected languages on up to `thread_count` threads.
+    ///
+    /// Unlike [`highlight`](Highlighter::highlight), which parses each injected layer when
+    /// the iterator reaches it, this finds all of the injections up front. The layers at each
+    /// level of nesting are parsed, and searched for further injections, concurrently, and the
+    /// iterator then uses those syntax trees instead of parsing the layers itself. The
+    /// resulting events are the same as those returned by `highlight`.
+    pub fn highlight_parallel<'a>(
+        &'a mut self,
+        config: &'a HighlightConfiguration,
+        source: &'a [u8],
+        cancellation_flag: Option<&'a AtomicUsize>,
+        thread_count: usize,
+        mut injection_callback: impl FnMut(&str) -> Option<&'a HighlightConfiguration> + 'a,
+    ) -> Result<impl Iterator<Item = Result<HighlightEvent, Error>> + 'a, Error> {
+        self.parsed_trees.clear();
+        let mut pending_layers = vec![(
+            config,
+            0,
+            vec![Range {
+                start_byte: 0,
+                end_byte: usize::MAX,
+                start_point: Point::new(0, 0),
+                end_point: Point::new(usize::MAX, usize::MAX),
+            }],
+        )];
+        while !pending_layers.is_empty() {
+            let results = self.parse_layers(
+                source,
+                &config.language_name,
+                cancellation_flag,
+                thread_count,
+                &pending_layers,
+            );
+            let mut next_layers = Vec::new();
+            for ((layer_config, depth, ranges), result) in pending_layers.into_iter().zip(results) {
+                let Some((tree, injections)) = result? else {
+                    continue;
+                };
+                for (language_name, injection_ranges) in injections {
+                    if let Some(next_config) = (injection_callback)(&language_name) {
+                        if !injection_ranges.is_empty() {
+                            next_layers.push((next_config, depth + 1, injection_ranges));
+                        }
+                    }
+                }
+                self.parsed_trees
+                    .insert(layer_key(config_id(layer_config), &ranges), tree);
+            }
+            pending_layers = next_layers;
+        }
+
+        self.highlight_layers(
+            config,
+            source,
+            cancellation_flag,
+            0..source.len(),
+            injection_callback,
+        )
+    }
+
+    /// Parse each of the given layers, and find the injections within them, returning the
+    /// results in the same order as the layers.
+    ///
+    /// Each thread takes the next layer as soon as it has finished the previous one, using
+    /// its own parser and query cursor.
+    fn parse_layers(
+        &mut self,
+        source: &[u8],
+        root_name: &str,
+        cancellation_flag: Option<&AtomicUsize>,
+        thread_count: usize,
+        layers: &[(&HighlightConfiguration, usize, Vec<Range>)],
+    ) -> Vec<Result<Option<ParsedLayer>, Error>> {
+        let thread_count = std::thread::available_parallelism()
+            .map_or(1, usize::from)
+            .min(thread_count)
+            .min(layers.len())
+            .max(1);
+        while self.thread_parsers.len() + 1 < thread_count {
+            self.thread_parsers.push(Parser::new());
+        }
+        let mut cursors = (0..thread_count)
+            .map(|_| self.cursors.pop().unwrap_or_default())
+            .collect::<Vec<_>>();
+
+        let parse = |parser: &mut Parser, cursor: &mut QueryCursor, index: usize| {
+            let (config, depth, ranges) = &layers[index];
+            HighlightIterLayer::parse_ahead(
+                parser,
+                cursor,
+                source,
+                root_name,
+                cancellation_flag,
+                config,
+                *depth,
+                ranges,
+            )
+        };
+
+        let mut results = Vec::with_capacity(layers.len());
+        if thread_count == 1 {
+            for index in 0..layers.len() {
+                results.push(parse(&mut self.parser, &mut cursors[0], index));
+            }
+        } else {
+            let next_index = AtomicUsize::new(0);
+            let mut indexed_results = std::thread::scope(|scope| {
+                let handles = iter::once(&mut self.parser)
+                    .chain(self.thread_parsers.iter_mut())
+                    .zip(cursors.iter_mut())
+                    .map(|(parser, cursor)| {
+                        let next_index = &next_index;
+                        let parse = &parse;
+                        scope.spawn(move || {
+                            let mut results = Vec::new();
+                            loop {
+                                let index = next_index.fetch_add(1, Ordering::Relaxed);
+                                if index >= layers.len() {
+                                    break;
+                                }
+                                results.push((index, parse(parser, cursor, index)));
+                            }
+                            results
+                        })
+                    })
+                    .collect::<Vec<_>>();
+                handles
+                    .into_iter()
+                    .flat_map(|handle| {
+                        handle
+                            .join()
+                            .unwrap_or_else(|e| std::panic::resume_unwind(e))
+                    })
+                    .collect::<Vec<_>>()
+            });
+            indexed_results.sort_unstable_by_key(|(index, _)| *index);
+            results.extend(indexed_results.into_iter().map(|(_, result)| result));
+        }
+
+        self.cursors.extend(cursors);
+        results
+    }
+}
+
+impl HighlightSession {
+    #[must_use]
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Get the events from the most recent call to [`highlight`](HighlightSession::highlight).
+    #[must_use]
+    pub fn events(&self) -> &[HighlightEvent] {
+        &self.events
+    }
+
+    /// Edit the syntax trees of every language layer to keep them in sync with the source
+    /// code, which has been edited since the last call to
+    /// [`highlight`](HighlightSession::highlight).
+    pub fn edit(&mut self, edit: &InputEdit) {
+        for (_, tree) in &mut self.trees {
+            tree.edit(edit);
+        }
+
+        // Keep a single edit that covers all of the edits since the last highlighting.
+        let (start, old_end, new_end) = (edit.start_byte, edit.old_end_byte, edit.new_end_byte);
+        self.edit = Some(match self.edit {
+            None => (start, old_end, new_end),
+            Some((prev_start, prev_old_end, prev_new_end)) => {
+                let end = prev_new_end.max(old_end);
+                (
+                    prev_start.min(start),
+                    end - prev_new_end + prev_old_end,
+                    end - old_end + new_end,
+                )
+            }
+        });
+    }
+
+    // Choose the part of the document to query again after an edit, which is given in the
+    // coordinates of the new source. It covers the top-level nodes of the document that touch
+    // the edit, and starts and ends within unhighlighted text in the previous events, so that
+    // no highlight, not even an empty one, crosses its boundaries.
+    fn window(
+        &self,
+        config: &HighlightConfiguration,
+        source_len: usize,
+        (start, old_end, new_end): (usize, usize, usize),
+    ) -> Option<SessionWindow> {
+        let (root_id, root_tree) = self.trees.first()?;
+        if *root_id != config_id(config) || !can_query_window(config) {
+            return None;
+        }
+        let (mut window_start, mut window_end) = (start, new_end);
+        let root = root_tree.root_node();
+        for child in root.children(&mut root.walk()) {
+            if child.end_byte() >= start && child.start_byte() <= new_end {
+                window_start = window_start.min(child.start_byte());
+                window_end = window_end.max(child.end_byte());
+            }
+        }
+        let old_window_end = window_end - new_end + old_end;
+
+        let (mut prefix_len, mut prefix_end) = (0, 0);
+        let (mut depth, mut offset) = (0usize, 0);
+        for (i, event) in self.events.iter().enumerate() {
+            match event {
+                HighlightEvent::Source { end, .. } => {
+                    if *end > window_start {
+                        break;
+                    }
+                    offset = *end;
+                }
+                HighlightEvent::HighlightStart(_) => depth += 1,
+                HighlightEvent::HighlightEnd => depth = depth.saturating_sub(1),
+            }
+            if depth == 0 && matches!(event, HighlightEvent::Source { .. }) {
+                (prefix_len, prefix_end) = (i + 1, offset);
+            }
+        }
+
+        let (mut suffix_start, mut old_suffix_offset) = (self.events.len(), self.source_len);
+        let (mut depth, mut offset) = (0usize, self.source_len);
+        for (i, event) in self.events.iter().enumerate().rev() {
+            match event {
+                HighlightEvent::Source { start, .. } => {
+                    if *start < old_window_end {
+                        break;
+                    }
+                    offset = *start;
+                }
+                HighlightEvent::HighlightEnd => depth += 1,
+                HighlightEvent::HighlightStart(_) => depth = depth.saturating_sub(1),
+            }
+            if depth == 0 && matches!(event, HighlightEvent::Source { .. }) {
+                (suffix_start, old_suffix_offset) = (i, offset);
+            }
+        }
+
+        let range = prefix_end..old_suffix_offset - old_end + new_end;
+        (range.start > 0 || range.end < source_len).then_some(SessionWindow {
+            range,
+            prefix_len,
+            suffix_start,
+            old_end,
+            new_end,
+        })
+    }
+
+    /// Highlight the source code again, reusing the syntax trees from the previous call to
+    /// reparse each language layer incrementally, and return the change in the highlighting.
+    ///
+    /// The first call highlights the whole document, so its delta covers every event. If an
+    /// error occurs, the stored trees and events are discarded, and the next call starts
+    /// from scratch.
+    pub fn highlight<'a>(
+        &mut self,
+        highlighter: &mut Highlighter,
+        config: &'a HighlightConfiguration,
+        source: &'a [u8],
+        cancellation_flag: Option<&'a AtomicUsize>,
+        mut injection_callback: impl FnMut(&str) -> Option<&'a HighlightConfiguration>,
+    ) -> Result<HighlightDelta, Error> {
+        let edit = self.edit.take();
+        let window = edit.and_then(|edit| self.window(config, source.len(), edit));
+        let old_trees = mem::take(&mut self.trees)
+            .into_iter()
+            .map(|(config_id, tree)| (layer_key(config_id, &tree.included_ranges()), tree))
+            .collect();
+        highlighter.parsed_trees.clear();
+        highlighter.session = Some(SessionState {
+            old_trees,
+            layer_trees: Vec::new(),
+            window: window.as_ref().map(|window| window.range.clone()),
+            left_window: false,
+        });
+
+        // First query only the part of the document around the edit, and keep the previous
+        // events outside of it. If the highlighting turns out to have changed outside of that
+        // part, or there is no such part, then query the whole document.
+        let mut events = None;
+        if let Some(window) = &window {
+            let result = highlighter
+                .highlight_layers(
+                    config,
+                    source,
+                    cancellation_flag,
+                    window.range.clone(),
+                    |name: &str| injection_callback(name),
+                )
+                .and_then(Iterator::collect::<Result<Vec<_>, _>>);
+            let session = highlighter.session.as_mut().unwrap();
+            // A layer that was not visited again has either been removed, in which case it
+            // must have been within the window, or it lies outside of the window.
+            session.left_window |= session.old_trees.values().any(|tree| {
+                let ranges = tree.included_ranges();
+                let within = |r: &Range| {
+                    window.range.start <= r.start_byte && r.end_byte <= window.range.end
+                };
+                let outside = |r: &Range| {
+                    r.end_byte <= window.range.start || window.range.end <= r.start_byte
+                };
+                !ranges.iter().all(within) && !ranges.iter().all(outside)
+            });
+            match result {
+                Ok(window_events) if !session.left_window => {
+                    events = Some(Ok(window.splice(&self.events, window_events)));
+                }
+                Ok(_) => {
+                    let layer_trees = mem::take(&mut session.layer_trees);
+                    session
+                        .old_trees
+                        .extend(layer_trees.into_iter().map(|(config_id, tree)| {
+                            (layer_key(config_id, &tree.included_ranges()), tree)
+                        }));
+                    session.window = None;
+                }
+                Err(e) => events = Some(Err(e)),
+            }
+        }
+        let events = events.unwrap_or_else(|| {
+            let session = highlighter.session.as_mut().unwrap();
+            session.window = None;
+            highlighter
+                .highlight_layers(
+                    config,
+                    source,
+                    cancellation_flag,
+                    0..source.len(),
+                    |name: &str| injection_callback(name),
+                )
+                .and_then(Iterator::collect::<Result<Vec<_>, _>>)
+        });
+        let session = highlighter.session.take().unwrap();
+        self.trees = session.layer_trees;
+        if session.window.is_some() {
+            // The layers outside of the queried part of the document were not visited, so
+            // keep their trees for the next highlighting.
+            self.trees.extend(
+                session
+                    .old_trees
+                    .into_iter()
+                    .map(|((config_id, _), tree)| (config_id, tree)),
+            );
+        }
+
+        let events = match events {
+            Ok(events) => events,
+            Err(e) => {
+                self.trees.clear();
+                self.events.clear();
+                self.source_len = 0;
+                return Err(e);
+            }
+        };
+        let old_events = mem::replace(&mut self.events, events);
+        let old_source_len = mem::replace(&mut self.source_len, source.len());
+        let new_events = &self.events;
+
+        // Map a byte offset in the previous source to the new source. Offsets before the
+        // edited text are compared with the offsets at the start of the new events, and
+        // offsets after it with those at the end.
+        let map_offset = |offset: usize, after_edit: bool| match edit {
+            None => Some(offset),
+            Some((start, old_end, new_end)) => {
+                if after_edit {
+                    (offset >= old_end).then(|| offset - old_end + new_end)
+                } else {
+                    (offset <= start).then_some(offset)
+                }
+            }
+        };
+        let same_event =
+            |old: &HighlightEvent, new: &HighlightEvent, after_edit: bool| match (old, new) {
+                (
+                    HighlightEvent::Source { start, end },
+                    HighlightEvent::Source {
+                        start: new_start,
+                        end: new_end,
+                    },
+                ) => {
+                    map_offset(*start, after_edit) == Some(*new_start)
+                        && map_offset(*end, after_edit) == Some(*new_end)
+                }
+                (HighlightEvent::HighlightStart(old), HighlightEvent::HighlightStart(new)) => {
+                    old == new
+                }
+                (HighlightEvent::HighlightEnd, HighlightEvent::HighlightEnd) => true,
+                _ => false,
+            };
+        let edit_start = edit.map_or(usize::MAX, |(start, _, _)| start);
+        let edit_end = edit.map_or(0, |(_, _, new_end)| new_end);
+
+        // Find the longest run of unchanged events at the start, which ends before the
+        // edited text and outside of any highlight.
+        let (mut prefix_len, mut prefix_end) = (0, 0);
+        let (mut depth, mut offset) = (0usize, 0);
+        for (i, (old, new)) in old_events.iter().zip(new_events).enumerate() {
+            if !same_event(old, new, false) {
+                break;
+            }
+            match new {
+                HighlightEvent::Source { end, .. } => {
+                    if *end > edit_start {
+                        break;
+                    }
+                    offset = *end;
+                }
+                HighlightEvent::HighlightStart(_) => depth += 1,
+                HighlightEvent::HighlightEnd => depth = depth.saturating_sub(1),
+            }
+            if depth == 0 {
+                (prefix_len, prefix_end) = (i + 1, offset);
+            }
+        }
+
+        // Likewise, find the longest run of unchanged events at the end, which starts after
+        // the edited text.
+        let (mut suffix_len, mut suffix_start) = (0, source.len());
+        let (mut depth, mut offset) = (0usize, source.len());
+        let max_suffix_len = old_events.len().min(new_events.len()) - prefix_len;
+        for (i, (old, new)) in old_events
+            .iter()
+            .rev()
+            .zip(new_events.iter().rev())
+            .take(max_suffix_len)
+            .enumerate()
+        {
+            if !same_event(old, new, true) {
+                break;
+            }
+            match new {
+                HighlightEvent::Source { start, .. } => {
+                    if *start < edit_end {
+                        break;
+                    }
+                    offset = *start;
+                }
+                HighlightEvent::HighlightEnd => depth += 1,
+                HighlightEvent::HighlightStart(_) => depth = depth.saturating_sub(1),
+            }
+            if depth == 0 {
+                (suffix_len, suffix_start) = (i + 1, offset);
+            }
+        }
+
+        let old_suffix_start = if suffix_len == 0 {
+            old_source_len
+        } else {
+            edit.map_or(suffix_start, |(_, old_end, new_end)| {
+                suffix_start - new_end + old_end
+            })
+        };
+        Ok(HighlightDelta {
+            old_events: prefix_len..old_events.len() - suffix_len,
+            old_range: prefix_end..old_suffix_start,
+            range: prefix_end..suffix_start,
+            events: new_events[prefix_len..new_events.len() - suffix_len].to_vec(),
+        })
+    }
 }
 
 impl HighlightConfiguration {
@@ -438,58 +1111,71 @@ impl<'a> HighlightIterLayer<'a> {
         let mut result = Vec::with_capacity(1);
         let mut queue = Vec::new();
         loop {
-            if highlighter.parser.set_included_ranges(&ranges).is_ok() {
-                highlighter
-                    .parser
-                    .set_language(&config.language)
-                    .map_err(|_| Error::InvalidLanguage)?;
-
-                unsafe { highlighter.parser.set_cancellation_flag(cancellation_flag) };
-                let tree = highlighter
-                    .parser
-                    .parse(source, None)
-                    .ok_or(Error::Cancelled)?;
-                unsafe { highlighter.parser.set_cancellation_flag(None) };
+            let key = layer_key(config_id(config), &ranges);
+            let parsed_tree = highlighter.parsed_trees.remove(&key);
+            let old_tree = highlighter
+                .session
+                .as_mut()
+                .and_then(|session| session.old_trees.remove(&key));
+            if parsed_tree.is_some() || highlighter.parser.set_included_ranges(&ranges).is_ok() {
+                let tree = if let Some(tree) = parsed_tree {
+                    tree
+                } else {
+                    highlighter
+                        .parser
+                        .set_language(&config.language)
+                        .map_err(|_| Error::InvalidLanguage)?;
+
+                    unsafe { highlighter.parser.set_cancellation_flag(cancellation_flag) };
+                    let tree = highlighter
+                        .parser
+                        .parse(source, old_tree.as_ref())
+                        .ok_or(Error::Cancelled)?;
+                    unsafe { highlighter.parser.set_cancellation_flag(None) };
+                    tree
+                };
+                if let Some(session) = &mut highlighter.session {
+                    // When only part of the document is queried again, the layer must not
+                    // have changed outside of that part.
+                    if let Some(window) = &session.window {
+                        let within = |range: &Range| {
+                            window.start <= range.start_byte && range.end_byte <= window.end
+                        };
+                        session.left_window |= !can_query_window(config)
+                            || old_tree.as_ref().map_or_else(
+                                || !ranges.iter().all(within),
+                                |old_tree| !old_tree.changed_ranges(&tree).all(|r| within(&r)),
+                            );
+                    }
+                    session.layer_trees.push((key.0, tree.clone()));
+                }
                 let mut cursor = highlighter.cursors.pop().unwrap_or_default();
 
                 // Process combined injections.
-                if let Some(combined_injections_query) = &config.combined_injections_query {
-                    let mut injections_by_pattern_index =
-                        vec![(None, Vec::new(), false); combined_injections_query.pattern_count()];
-                    let matches =
-                        cursor.matches(combined_injections_query, tree.root_node(), source);
-                    for mat in matches {
-                        let entry = &mut injections_by_pattern_index[mat.pattern_index];
-                        let (language_name, content_node, include_children) = injection_for_match(
-                            config,
-                            parent_name,
-                            combined_injections_query,
-                            &mat,
-                            source,
-                        );
-                        if language_name.is_some() {
-                            entry.0 = language_name;
-                        }
-                        if let Some(content_node) = content_node {
-                            entry.1.push(content_node);
-                        }
-                        entry.2 = include_children;
-                    }
-                    for (lang_name, content_nodes, includes_children) in injections_by_pattern_index
-                    {
-                        if let (Some(lang_name), false) = (lang_name, content_nodes.is_empty()) {
-                            if let Some(next_config) = (injection_callback)(lang_name) {
-                                let ranges = Self::intersect_ranges(
-                                    &ranges,
-                                    &content_nodes,
-                                    includes_children,
-                                );
-                                if !ranges.is_empty() {
-                                    queue.push((next_config, depth + 1, ranges));
-                                }
+                Self::combined_injections(
+                    config,
+                    parent_name,
+                    &mut cursor,
+                    &tree,
+                    source,
+                    &ranges,
+                    |lang_name, injection_ranges| {
+                        if let Some(next_config) = (injection_callback)(lang_name) {
+                            if !injection_ranges.is_empty() {
+                                queue.push((next_config, depth + 1, injection_ranges));
                             }
                         }
-                    }
+                    },
+                );
+
+                // Also query the bytes on either side of the window, so that any highlight
+                // which now crosses its boundaries is noticed.
+                if let Some(window) = highlighter
+                    .session
+                    .as_ref()
+                    .and_then(|session| session.window.clone())
+                {
+                    cursor.set_byte_range(window.start.saturating_sub(1)..window.end + 1);
                 }
 
                 // The `captures` iterator borrows the `Tree` and the `QueryCursor`, which
@@ -532,6 +1218,104 @@ impl<'a> HighlightIterLayer<'a> {
         Ok(result)
     }
 
+    /// Parse a layer of the document ahead of time, and find all of the injections within
+    /// it, both combined and not. This returns `None` if the layer's ranges are invalid, as
+    /// [`new`](HighlightIterLayer::new) does when it skips a layer.
+    #[allow(clippy::too_many_arguments)]
+    fn parse_ahead(
+        parser: &mut Parser,
+        cursor: &mut QueryCursor,
+        source: &[u8],
+        root_name: &str,
+        cancellation_flag: Option<&AtomicUsize>,
+        config: &HighlightConfiguration,
+        depth: usize,
+        ranges: &[Range],
+    ) -> Result<Option<ParsedLayer>, Error> {
+        if parser.set_included_ranges(ranges).is_err() {
+            return Ok(None);
+        }
+        parser
+            .set_language(&config.language)
+            .map_err(|_| Error::InvalidLanguage)?;
+        unsafe { parser.set_cancellation_flag(cancellation_flag) };
+        let tree = parser.parse(source, None);
+        unsafe { parser.set_cancellation_flag(None) };
+        let tree = tree.ok_or(Error::Cancelled)?;
+
+        // As in the non-parallel iterator, combined injections in the root layer have no
+        // parent, while all other injections treat the root language as their parent.
+        let mut injections = Vec::new();
+        let combined_parent_name = (depth > 0).then_some(root_name);
+        Self::combined_injections(
+            config,
+            combined_parent_name,
+            cursor,
+            &tree,
+            source,
+            ranges,
+            |lang_name, injection_ranges| {
+                injections.push((lang_name.to_string(), injection_ranges));
+            },
+        );
+
+        // Only search for the injection patterns, which precede all of the others.
+        for pattern_index in config.locals_pattern_index..config.query.pattern_count() {
+            cursor.disable_pattern(pattern_index);
+        }
+        for mat in cursor.matches(&config.query, tree.root_node(), source) {
+            let (language_name, content_node, include_children) =
+                injection_for_match(config, Some(root_name), &config.query, &mat, source);
+            if let (Some(language_name), Some(content_node)) = (language_name, content_node) {
+                let injection_ranges =
+                    Self::intersect_ranges(ranges, &[content_node], include_children);
+                injections.push((language_name.to_string(), injection_ranges));
+            }
+        }
+        cursor.enable_all();
+
+        Ok(Some((tree, injections)))
+    }
+
+    /// Find the combined injections in a layer's syntax tree, calling `f` with the
+    /// language name and the ranges of each one.
+    fn combined_injections(
+        config: &HighlightConfiguration,
+        parent_name: Option<&str>,
+        cursor: &mut QueryCursor,
+        tree: &Tree,
+        source: &[u8],
+        ranges: &[Range],
+        mut f: impl FnMut(&str, Vec<Range>),
+    ) {
+        let Some(combined_injections_query) = &config.combined_injections_query else {
+            return;
+        };
+        let mut injections_by_pattern_index =
+            vec![(None, Vec::new(), false); combined_injections_query.pattern_count()];
+        let matches = cursor.matches(combined_injections_query, tree.root_node(), source);
+        for mat in matches {
+            let entry = &mut injections_by_pattern_index[mat.pattern_index];
+            let (language_name, content_node, include_children) =
+                injection_for_match(config, parent_name, combined_injections_query, &mat, source);
+            if language_name.is_some() {
+                entry.0 = language_name;
+            }
+            if let Some(content_node) = content_node {
+                entry.1.push(content_node);
+            }
+            entry.2 = include_children;
+        }
+        for (lang_name, content_nodes, includes_children) in injections_by_pattern_index {
+            if let (Some(lang_name), false) = (lang_name, content_nodes.is_empty()) {
+                f(
+                    lang_name,
+                    Self::intersect_ranges(ranges, &content_nodes, includes_children),
+                );
+            }
+        }
+    }
+
     // Compute the ranges that should be included when parsing an injection.
     // This takes into account three things:
     // * `parent_ranges` - The ranges must all fall within the *current* layer's ranges.
@@ -660,6 +1444,20 @@ where
         offset: usize,
         event: Option<HighlightEvent>,
     ) -> Option<Result<HighlightEvent, Error>> {
+        // A highlight that starts before the first byte or ends after the last byte can only
+        // occur when part of a document is queried again, and means that the highlighting
+        // has changed outside of that part.
+        let outside = match event {
+            Some(HighlightEvent::HighlightStart(_)) => offset < self.byte_offset,
+            Some(HighlightEvent::HighlightEnd) => offset > self.end_byte,
+            _ => false,
+        };
+        if outside {
+            if let Some(session) = &mut self.highlighter.session {
+                session.left_window = true;
+            }
+        }
+
         let result;
         if self.byte_offset < offset {
             result = Some(Ok(HighlightEvent::Source {
@@ -693,7 +1491,8 @@ where
                 }
                 break;
             }
-            let layer = self.layers.remove(0);
+            let mut layer = self.layers.remove(0);
+            layer.cursor.set_byte_range(0..usize::MAX);
             self.highlighter.cursors.push(layer.cursor);
         }
     }
@@ -744,12 +1543,12 @@ where
 
             // If none of the layers have any more highlight boundaries, terminate.
             if self.layers.is_empty() {
-                return if self.byte_offset < self.source.len() {
+                return if self.byte_offset < self.end_byte {
                     let result = Some(Ok(HighlightEvent::Source {
                         start: self.byte_offset,
-                        end: self.source.len(),
+                        end: self.end_byte,
                     }));
-                    self.byte_offset = self.source.len();
+                    self.byte_offset = self.end_byte;
                     result
                 } else {
                     None
@@ -780,7 +1579,7 @@ where
                     layer.highlight_end_stack.pop();
                     return self.emit_event(end_byte, Some(HighlightEvent::HighlightEnd));
                 }
-                return self.emit_event(self.source.len(), None);
+                return self.emit_event(self.end_byte, None);
             }
 
             let (mut match_, capture_index) = layer.captures.next().unwrap();
@@ -1094,46 +1893,221 @@ impl HtmlRenderer {
     where
         F: Fn(Highlight) -> &'a [u8],
     {
-        pub const fn html_escape(c: u8) -> Option<&'static [u8]> {
-            match c as char {
-                '>' => Some(b"&gt;"),
-                '<' => Some(b"&lt;"),
-                '&' => Some(b"&amp;"),
-                '\'' => Some(b"&#39;"),
-                '"' => Some(b"&quot;"),
-                _ => None,
-            }
-        }
-
         let mut last_char_was_cr = false;
-        for c in LossyUtf8::new(src).flat_map(|p| p.bytes()) {
+        for piece in HtmlPieces::new(src) {
             // Don't render carriage return characters, but allow lone carriage returns (not
             // followed by line feeds) to be styled via the attribute callback.
-            if c == b'\r' {
+            if let HtmlPiece::CarriageReturn = piece {
                 last_char_was_cr = true;
                 continue;
             }
             if last_char_was_cr {
-                if c != b'\n' {
+                if !matches!(piece, HtmlPiece::LineFeed) {
                     self.add_carriage_return(attribute_callback);
                 }
                 last_char_was_cr = false;
             }
 
-            // At line boundaries, close and re-open all of the open tags.
-            if c == b'\n' {
-                highlights.iter().for_each(|_| self.end_highlight());
-                self.html.push(c);
-                self.line_offsets.push(self.html.len() as u32);
-                highlights
-                    .iter()
-                    .for_each(|scope| self.start_highlight(*scope, attribute_callback));
-            } else if let Some(escape) = html_escape(c) {
-                self.html.extend_from_slice(escape);
-            } else {
-                self.html.push(c);
+            match piece {
+                // At line boundaries, close and re-open all of the open tags.
+                HtmlPiece::LineFeed => {
+                    highlights.iter().for_each(|_| self.end_highlight());
+                    self.html.push(b'\n');
+                    self.line_offsets.push(self.html.len() as u32);
+                    highlights
+                        .iter()
+                        .for_each(|scope| self.start_highlight(*scope, attribute_callback));
+                }
+                HtmlPiece::Text(text) => self.html.extend_from_slice(text),
+                HtmlPiece::CarriageReturn => unreachable!(),
+            }
+        }
+    }
+}
+
+impl StreamingHtmlRenderer {
+    /// Create a renderer for the highlights with indices below `highlight_count`, whose
+    /// attributes are given by `attribute_callback`.
+    pub fn new<'a>(
+        highlight_count: usize,
+        attribute_callback: impl Fn(Highlight) -> &'a [u8],
+    ) -> Self {
+        let mut start_tags = Vec::new();
+        let mut start_tag_offsets = Vec::with_capacity(highlight_count + 1);
+        start_tag_offsets.push(0);
+        for i in 0..highlight_count {
+            let attribute_string = attribute_callback(Highlight(i));
+            start_tags.extend(b"<span");
+            if !attribute_string.is_empty() {
+                start_tags.extend(b" ");
+                start_tags.extend(attribute_string);
+            }
+            start_tags.extend(b">");
+            start_tag_offsets.push(start_tags.len());
+        }
+        Self {
+            start_tags,
+            start_tag_offsets,
+            carriage_return_highlight: None,
+            highlights: Vec::new(),
+        }
+    }
+
+    pub fn set_carriage_return_highlight(&mut self, highlight: Option<Highlight>) {
+        self.carriage_return_highlight = highlight;
+    }
+
+    /// Render the highlighted source code, stopping at the first highlighting error or
+    /// write error. A highlighting error is returned as an [`io::Error`] that wraps the
+    /// [`Error`].
+    pub fn render<W: io::Write + ?Sized>(
+        &mut self,
+        highlighter: impl Iterator<Item = Result<HighlightEvent, Error>>,
+        source: &[u8],
+        output: &mut W,
+    ) -> io::Result<()> {
+        self.highlights.clear();
+        for event in highlighter {
+            match event? {
+                HighlightEvent::HighlightStart(s) => {
+                    self.highlights.push(s);
+                    output.write_all(self.start_tag(s))?;
+                }
+                HighlightEvent::HighlightEnd => {
+                    self.highlights.pop();
+                    output.write_all(b"</span>")?;
+                }
+                HighlightEvent::Source { start, end } => {
+                    self.add_text(&source[start..end], output)?;
+                }
+            }
+        }
+        Ok(())
+    }
+
+    fn start_tag(&self, highlight: Highlight) -> &[u8] {
+        match self.start_tag_offsets.get(highlight.0..highlight.0 + 2) {
+            Some(&[start, end]) => &self.start_tags[start..end],
+            _ => b"<span>",
+        }
+    }
+
+    fn add_text<W: io::Write + ?Sized>(&self, src: &[u8], output: &mut W) -> io::Result<()> {
+        let mut last_char_was_cr = false;
+        for piece in HtmlPieces::new(src) {
+            if let HtmlPiece::CarriageReturn = piece {
+                last_char_was_cr = true;
+                continue;
+            }
+            if last_char_was_cr {
+                if !matches!(piece, HtmlPiece::LineFeed) {
+                    if let Some(highlight) = self.carriage_return_highlight {
+                        let start_tag = self.start_tag(highlight);
+                        if start_tag != b"<span>" {
+                            output.write_all(start_tag)?;
+                            output.write_all(b"</span>")?;
+                        }
+                    }
+                }
+                last_char_was_cr = false;
+            }
+
+            match piece {
+                HtmlPiece::LineFeed => {
+                    for _ in &self.highlights {
+                        output.write_all(b"</span>")?;
+                    }
+                    output.write_all(b"\n")?;
+                    for highlight in &self.highlights {
+                        output.write_all(self.start_tag(*highlight))?;
+                    }
+                }
+                HtmlPiece::Text(text) => output.write_all(text)?,
+                HtmlPiece::CarriageReturn => unreachable!(),
             }
         }
+        Ok(())
+    }
+}
+
+impl<'a> HtmlPieces<'a> {
+    fn new(text: &'a [u8]) -> Self {
+        if text.is_ascii() {
+            Self { text, chunks: None }
+        } else {
+            Self {
+                text: &[],
+                chunks: Some(LossyUtf8::new(text)),
+            }
+        }
+    }
+
+    const fn is_special(c: u8) -> bool {
+        matches!(c, b'<' | b'>' | b'&' | b'\'' | b'"' | b'\r' | b'\n')
+    }
+
+    // Find the length of the text before its first special character. Short runs of text
+    // are common, so the first few bytes are checked one at a time. After that, the text is
+    // checked a word at a time, by testing each byte of the word for each special character
+    // at once.
+    fn plain_len(text: &[u8]) -> usize {
+        const LOW_BITS: u64 = u64::from_ne_bytes([0x01; 8]);
+        const HIGH_BITS: u64 = u64::from_ne_bytes([0x80; 8]);
+        const fn has_byte(word: u64, c: u8) -> bool {
+            let word = word ^ (LOW_BITS * c as u64);
+            word.wrapping_sub(LOW_BITS) & !word & HIGH_BITS != 0
+        }
+
+        let head_len = text.len().min(8);
+        let mut len = match text[..head_len].iter().position(|c| Self::is_special(*c)) {
+            Some(len) => return len,
+            None => head_len,
+        };
+        for word in text[head_len..].chunks_exact(8) {
+            let word = u64::from_ne_bytes(word.try_into().unwrap());
+            if has_byte(word, b'<')
+                | has_byte(word, b'>')
+                | has_byte(word, b'&')
+                | has_byte(word, b'\'')
+                | has_byte(word, b'"')
+                | has_byte(word, b'\r')
+                | has_byte(word, b'\n')
+            {
+                break;
+            }
+            len += 8;
+        }
+        len + text[len..]
+            .iter()
+            .position(|c| Self::is_special(*c))
+            .unwrap_or(text.len() - len)
+    }
+}
+
+impl<'a> Iterator for HtmlPieces<'a> {
+    type Item = HtmlPiece<'a>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        while self.text.is_empty() {
+            self.text = self.chunks.as_mut()?.next()?.as_bytes();
+        }
+        let len = Self::plain_len(self.text);
+        if len > 0 {
+            let (text, rest) = self.text.split_at(len);
+            self.text = rest;
+            return Some(HtmlPiece::Text(text));
+        }
+        let (&c, rest) = self.text.split_first()?;
+        self.text = rest;
+        Some(match c {
+            b'\r' => HtmlPiece::CarriageReturn,
+            b'\n' => HtmlPiece::LineFeed,
+            b'>' => HtmlPiece::Text(b"&gt;"),
+            b'<' => HtmlPiece::Text(b"&lt;"),
+            b'&' => HtmlPiece::Text(b"&amp;"),
+            b'\'' => HtmlPiece::Text(b"&#39;"),
+            _ => HtmlPiece::Text(b"&quot;"),
+        })
     }
 }
 
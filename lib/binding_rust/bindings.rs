@@ -32,11 +32,32 @@ pub struct TSQueryCursor {
 }
 #[repr(C)]
 #[derive(Debug)]
+pub struct TSQueryMatchSet {
+    _unused: [u8; 0],
+}
+#[repr(C)]
+#[derive(Debug)]
 pub struct TSLookaheadIterator {
     _unused: [u8; 0],
 }
+#[repr(C)]
+#[derive(Debug)]
+pub struct TSFlatTree {
+    _unused: [u8; 0],
+}
+#[repr(C)]
+#[derive(Debug)]
+pub struct TSTreeSnapshot {
+    _unused: [u8; 0],
+}
+#[repr(C)]
+#[derive(Debug)]
+pub struct TSLexer {
+    _unused: [u8; 0],
+}
 pub const TSInputEncodingUTF8: TSInputEncoding = 0;
 pub const TSInputEncodingUTF16: TSInputEncoding = 1;
+pub const TSInputEncodingLatin1: TSInputEncoding = 2;
 pub type TSInputEncoding = ::core::ffi::c_uint;
 pub const TSSymbolTypeRegular: TSSymbolType = 0;
 pub const TSSymbolTypeAnonymous: TSSymbolType = 1;
@@ -70,6 +91,13 @@ pub struct TSInput {
     >,
     pub encoding: TSInputEncoding,
 }
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSInputSpan {
+    pub byte_offset: u32,
+    pub bytes: *const ::core::ffi::c_char,
+    pub length: u32,
+}
 pub const TSLogTypeParse: TSLogType = 0;
 pub const TSLogTypeLex: TSLogType = 1;
 pub type TSLogType = ::core::ffi::c_uint;
@@ -87,6 +115,60 @@ pub struct TSLogger {
 }
 #[repr(C)]
 #[derive(Debug, Copy, Clone)]
+pub struct TSParserStats {
+    pub lexed_token_count: u32,
+    pub heap_token_count: u32,
+    pub cached_token_count: u32,
+    pub token_cache_miss_count: u32,
+    pub reused_node_count: u32,
+    pub reuse_miss_count: u32,
+    pub version_split_count: u32,
+    pub version_merge_count: u32,
+    pub recovery_count: u32,
+    pub bounded_recovery_count: u32,
+    pub operation_count: u64,
+    pub lex_time_micros: u64,
+    pub recovery_time_micros: u64,
+    pub total_time_micros: u64,
+}
+pub const TSAllocationCategoryOther: TSAllocationCategory = 0;
+pub const TSAllocationCategorySubtreePool: TSAllocationCategory = 1;
+pub const TSAllocationCategoryStackNodes: TSAllocationCategory = 2;
+pub const TSAllocationCategoryIncludedRanges: TSAllocationCategory = 3;
+pub const TSAllocationCategoryQueryCursorStates: TSAllocationCategory = 4;
+pub const TSAllocationCategoryQueryCaptureLists: TSAllocationCategory = 5;
+pub const TSAllocationCategoryWasmStore: TSAllocationCategory = 6;
+pub type TSAllocationCategory = ::core::ffi::c_uint;
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSAllocationStats {
+    pub allocation_count: usize,
+    pub live_allocation_count: usize,
+    pub live_bytes: usize,
+    pub peak_bytes: usize,
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSMemoryReport {
+    pub exclusive_bytes: usize,
+    pub shared_bytes: usize,
+    pub scanner_state_bytes: usize,
+    pub inline_node_count: u32,
+    pub heap_node_count: u32,
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSParserConfig {
+    pub max_version_count: u32,
+    pub max_version_count_overflow: u32,
+    pub max_summary_depth: u32,
+    pub max_cost_difference: u32,
+    pub adaptive_threshold: u32,
+    pub adaptive_min_version_count: u32,
+    pub recovery_budget_per_byte: u32,
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
 pub struct TSInputEdit {
     pub start_byte: u32,
     pub old_end_byte: u32,
@@ -103,6 +185,30 @@ pub struct TSNode {
     pub tree: *const TSTree,
 }
 #[repr(C)]
+#[derive(Debug)]
+pub struct TSStreamCallback {
+    pub payload: *mut ::core::ffi::c_void,
+    pub emit: ::core::option::Option<
+        unsafe extern "C" fn(payload: *mut ::core::ffi::c_void, node: TSNode),
+    >,
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSParseState {
+    pub payload: *mut ::core::ffi::c_void,
+    pub current_byte_offset: u32,
+    pub operation_count: u64,
+    pub has_error: bool,
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSParseOptions {
+    pub payload: *mut ::core::ffi::c_void,
+    pub progress_callback:
+        ::core::option::Option<unsafe extern "C" fn(state: *mut TSParseState) -> bool>,
+    pub byte_budget: u32,
+}
+#[repr(C)]
 #[derive(Debug, Copy, Clone)]
 pub struct TSTreeCursor {
     pub tree: *const ::core::ffi::c_void,
@@ -110,6 +216,41 @@ pub struct TSTreeCursor {
     pub context: [u32; 3usize],
 }
 #[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSTreeCursorWalkOptions {
+    pub symbols: *const u8,
+    pub symbol_count: u32,
+    pub max_depth: u32,
+    pub named_only: bool,
+}
+#[repr(C)]
+#[derive(Debug)]
+pub struct TSTreeCursorWalkEntry {
+    pub node: TSNode,
+    pub field_id: TSFieldId,
+    pub depth: u32,
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSFlatNode {
+    pub symbol: TSSymbol,
+    pub field_id: TSFieldId,
+    pub start_byte: u32,
+    pub end_byte: u32,
+    pub start_point: TSPoint,
+    pub end_point: TSPoint,
+    pub is_named: bool,
+    pub is_extra: bool,
+    pub is_missing: bool,
+    pub has_error: bool,
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSFlatTreeCursor {
+    pub tree: *const TSFlatTree,
+    pub index: u32,
+}
+#[repr(C)]
 #[derive(Debug)]
 pub struct TSQueryCapture {
     pub node: TSNode,
@@ -139,6 +280,31 @@ pub struct TSQueryPredicateStep {
     pub type_: TSQueryPredicateStepType,
     pub value_id: u32,
 }
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSQueryTextProvider {
+    pub payload: *mut ::core::ffi::c_void,
+    pub text: ::core::option::Option<
+        unsafe extern "C" fn(
+            payload: *mut ::core::ffi::c_void,
+            node: TSNode,
+            length: *mut u32,
+        ) -> *const ::core::ffi::c_char,
+    >,
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSQueryStoredCapture {
+    pub range: TSRange,
+    pub index: u32,
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSQueryStoredMatch {
+    pub pattern_index: u32,
+    pub capture_count: u32,
+    pub captures: *const TSQueryStoredCapture,
+}
 pub const TSQueryErrorNone: TSQueryError = 0;
 pub const TSQueryErrorSyntax: TSQueryError = 1;
 pub const TSQueryErrorNodeType: TSQueryError = 2;
@@ -147,6 +313,38 @@ pub const TSQueryErrorCapture: TSQueryError = 4;
 pub const TSQueryErrorStructure: TSQueryError = 5;
 pub const TSQueryErrorLanguage: TSQueryError = 6;
 pub type TSQueryError = ::core::ffi::c_uint;
+pub const TSLanguageLoadErrorNone: TSLanguageLoadError = 0;
+pub const TSLanguageLoadErrorIO: TSLanguageLoadError = 1;
+pub const TSLanguageLoadErrorFormat: TSLanguageLoadError = 2;
+pub const TSLanguageLoadErrorVersion: TSLanguageLoadError = 3;
+pub const TSLanguageLoadErrorScanner: TSLanguageLoadError = 4;
+pub type TSLanguageLoadError = ::core::ffi::c_uint;
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSExternalScanner {
+    pub create: ::core::option::Option<unsafe extern "C" fn() -> *mut ::core::ffi::c_void>,
+    pub destroy: ::core::option::Option<unsafe extern "C" fn(arg1: *mut ::core::ffi::c_void)>,
+    pub scan: ::core::option::Option<
+        unsafe extern "C" fn(
+            arg1: *mut ::core::ffi::c_void,
+            arg2: *mut TSLexer,
+            symbol_whitelist: *const bool,
+        ) -> bool,
+    >,
+    pub serialize: ::core::option::Option<
+        unsafe extern "C" fn(
+            arg1: *mut ::core::ffi::c_void,
+            arg2: *mut ::core::ffi::c_char,
+        ) -> ::core::ffi::c_uint,
+    >,
+    pub deserialize: ::core::option::Option<
+        unsafe extern "C" fn(
+            arg1: *mut ::core::ffi::c_void,
+            arg2: *const ::core::ffi::c_char,
+            arg3: ::core::ffi::c_uint,
+        ),
+    >,
+}
 extern "C" {
     #[doc = " Create a new parser."]
     pub fn ts_parser_new() -> *mut TSParser;
@@ -171,12 +369,70 @@ extern "C" {
         count: u32,
     ) -> bool;
 }
+extern "C" {
+    #[doc = " Replace some of the ranges of text that the parser should include when\n parsing, without copying the rest of them.\n\n The `old_count` ranges starting at `index` are replaced with the `count`\n ranges in the given array. The resulting ranges must satisfy the same\n requirements as those passed to [`ts_parser_set_included_ranges`]. If they\n don't, or if the replaced ranges extend past the end of the parser's\n ranges, the operation will fail, the ranges will not be changed, and this\n function will return `false`. If no ranges remain, the entire document will\n be parsed."]
+    pub fn ts_parser_splice_included_ranges(
+        self_: *mut TSParser,
+        index: u32,
+        old_count: u32,
+        ranges: *const TSRange,
+        count: u32,
+    ) -> bool;
+}
+extern "C" {
+    #[doc = " Edit the ranges of text that the parser will include when parsing, to keep\n them in sync with source code that has been edited.\n\n This adjusts the ranges in the same way as [`ts_tree_edit`] adjusts the\n old syntax tree's ranges, so that when both are edited with the same edits,\n no part of the document is reparsed just because its ranges were set anew.\n Ranges that end before the edit are not visited."]
+    pub fn ts_parser_edit_included_ranges(self_: *mut TSParser, edit: *const TSInputEdit);
+}
 extern "C" {
     #[doc = " Get the ranges of text that the parser will include when parsing.\n\n The returned pointer is owned by the parser. The caller should not free it\n or write to it. The length of the array will be written to the given\n `count` pointer."]
     pub fn ts_parser_included_ranges(self_: *const TSParser, count: *mut u32) -> *const TSRange;
 }
 extern "C" {
-    #[doc = " Use the parser to parse some source code and create a syntax tree.\n\n If you are parsing this document for the first time, pass `NULL` for the\n `old_tree` parameter. Otherwise, if you have already parsed an earlier\n version of this document and the document has since been edited, pass the\n previous syntax tree so that the unchanged parts of it can be reused.\n This will save time and memory. For this to work correctly, you must have\n already edited the old syntax tree using the [`ts_tree_edit`] function in a\n way that exactly matches the source code changes.\n\n The [`TSInput`] parameter lets you specify how to read the text. It has the\n following three fields:\n 1. [`read`]: A function to retrieve a chunk of text at a given byte offset\n    and (row, column) position. The function should return a pointer to the\n    text and write its length to the [`bytes_read`] pointer. The parser does\n    not take ownership of this buffer; it just borrows it until it has\n    finished reading it. The function should write a zero value to the\n    [`bytes_read`] pointer to indicate the end of the document.\n 2. [`payload`]: An arbitrary pointer that will be passed to each invocation\n    of the [`read`] function.\n 3. [`encoding`]: An indication of how the text is encoded. Either\n    `TSInputEncodingUTF8` or `TSInputEncodingUTF16`.\n\n This function returns a syntax tree on success, and `NULL` on failure. There\n are three possible reasons for failure:\n 1. The parser does not have a language assigned. Check for this using the\n[`ts_parser_language`] function.\n 2. Parsing was cancelled due to a timeout that was set by an earlier call to\n    the [`ts_parser_set_timeout_micros`] function. You can resume parsing from\n    where the parser left out by calling [`ts_parser_parse`] again with the\n    same arguments. Or you can start parsing from scratch by first calling\n    [`ts_parser_reset`].\n 3. Parsing was cancelled using a cancellation flag that was set by an\n    earlier call to [`ts_parser_set_cancellation_flag`]. You can resume parsing\n    from where the parser left out by calling [`ts_parser_parse`] again with\n    the same arguments.\n\n [`read`]: TSInput::read\n [`payload`]: TSInput::payload\n [`encoding`]: TSInput::encoding\n [`bytes_read`]: TSInput::read"]
+    #[doc = " Set whether the parser should allocate the nodes of each new syntax tree\n from an arena.\n\n In arena mode, the nodes created during a parse are allocated in large slabs\n instead of individually, and they are all freed at once when the last tree\n that uses them is deleted, rather than by visiting every node. This makes\n both parsing and [`ts_tree_delete`] faster for large documents.\n\n Incremental parsing still works: when an arena-allocated tree is passed as\n the `old_tree`, the new tree keeps the old tree's arena alive for as long as\n it may share nodes with it. Because of this, a long chain of incremental\n parses may hold onto memory from earlier versions of the document until\n the document is parsed again from scratch.\n\n This setting takes effect at the start of the next parse. It is disabled\n by default."]
+    pub fn ts_parser_set_arena_enabled(self_: *mut TSParser, enabled: bool);
+}
+extern "C" {
+    #[doc = " Get whether the parser allocates the nodes of new syntax trees from an arena."]
+    pub fn ts_parser_arena_enabled(self_: *const TSParser) -> bool;
+}
+extern "C" {
+    #[doc = " Set whether the parser should build an index of its language's parse table.\n\n Most of the states in a large grammar's parse table are stored in a compact\n form that must be searched linearly whenever the parser looks up an action.\n When this setting is enabled, the parser builds a bitmap index over those\n states, so that every lookup takes constant time. The index is built once\n each time a language is assigned, and uses additional memory proportional\n to the number of states times the number of symbols in the grammar.\n\n This is disabled by default."]
+    pub fn ts_parser_set_lookup_index_enabled(self_: *mut TSParser, enabled: bool);
+}
+extern "C" {
+    #[doc = " Get whether the parser builds an index of its language's parse table."]
+    pub fn ts_parser_lookup_index_enabled(self_: *const TSParser) -> bool;
+}
+extern "C" {
+    #[doc = " Set the number of chunks of source code that the parser remembers from its\n input's [`read`] callback.\n\n By default, the parser calls the callback again whenever it needs text\n outside of the chunk that it read most recently, which happens often when\n it moves back to an earlier position during incremental parsing or error\n recovery. When this is set to a non-zero value, the parser keeps that many\n of the most recently used chunks, and only calls the callback for text that\n none of them contain.\n\n When this is enabled, every buffer that the callback returns must remain\n valid and unchanged until the call to [`ts_parser_parse`] returns.\n\n This is not needed for [`ts_parser_parse_string`], which never calls a\n callback once it has the whole buffer. It is zero by default.\n\n [`read`]: TSInput::read"]
+    pub fn ts_parser_set_chunk_cache_size(self_: *mut TSParser, size: u32);
+}
+extern "C" {
+    #[doc = " Get the number of chunks of source code that the parser remembers from its\n input's `read` callback."]
+    pub fn ts_parser_chunk_cache_size(self_: *const TSParser) -> u32;
+}
+extern "C" {
+    #[doc = " Set the limits that the parser places on its search for a valid parse.\n\n When the input is ambiguous or contains errors, the parser pursues several\n interpretations of it at once, using a separate version of its stack for\n each one. These settings bound that work:\n\n 1. `max_version_count` - The number of stack versions that are kept after\n    each token. The least promising versions beyond this are discarded.\n 2. `max_version_count_overflow` - The number of extra versions that may be\n    created while processing a single token, before they are discarded.\n 3. `max_summary_depth` - The number of stack entries that are examined\n    when searching for a recovery from a syntax error.\n 4. `max_cost_difference` - The difference in error cost, scaled by the\n    number of nodes since the error, at which a version is discarded in\n    favor of a better one instead of being kept as an alternative.\n\n If `adaptive_threshold` is non-zero, the parser also lowers its limit on\n the number of versions by one each time the number of versions has stayed\n at that limit for more than `adaptive_threshold` consecutive tokens, down\n to `adaptive_min_version_count`. The limit is restored at the start of each\n new parse. This bounds the time spent parsing ambiguous or malformed input,\n at the cost of less precise error recovery.\n\n If `recovery_budget_per_byte` is non-zero, it limits the work that the\n parser spends searching for ways to recover from syntax errors, such as\n examining the entries of its stack, to about that many units for each byte\n of input that it has consumed. Once that budget is used up, the parser\n recovers by skipping tokens, only returning to states near the top of its\n stack, until it has consumed enough input to earn more budget. This makes\n the parse time of binary, minified or adversarial input grow linearly\n with its length, at the cost of larger `ERROR` nodes.\n\n Pass `NULL` to restore the defaults, which are the values returned by\n [`ts_parser_config`] for a new parser, with adaptive mode and the recovery\n budget disabled. This returns `false` and leaves the settings unchanged if\n `max_version_count` is zero, if the sum of `max_version_count` and\n `max_version_count_overflow` does not fit in 32 bits, or if adaptive mode\n is enabled and `adaptive_min_version_count` is zero or greater than\n `max_version_count`."]
+    pub fn ts_parser_set_config(self_: *mut TSParser, config: *const TSParserConfig) -> bool;
+}
+extern "C" {
+    #[doc = " Get the limits that the parser places on its search for a valid parse."]
+    pub fn ts_parser_config(self_: *const TSParser) -> TSParserConfig;
+}
+extern "C" {
+    #[doc = " Set whether the parser should collect statistics about its parses.\n\n When this is enabled, the parser counts the work done during each call to\n [`ts_parser_parse`]: the number of tokens that were lexed, the number that\n were taken from its cache of recently lexed tokens, the number of times\n that cache had no usable token, the number of nodes that were or\n could not be reused from the old tree, the number of times its stack split\n into several versions or merged them back together, the number of error\n recoveries, and how many of those were limited because the parser's\n `recovery_budget_per_byte` was used up. It also counts the operations\n that the parse performed: the parse actions applied to the stack, plus the\n stack entries examined and the versions created while recovering from\n errors. Unlike the timings, which it also measures for lexing, error\n recovery and the parse as a whole, this count is deterministic, so dividing\n it by the length of the input gives a stable measure of how expensive a\n document is to parse.\n\n The statistics are cleared at the start of each new parse. If a parse is\n halted by a timeout or a cancellation and later resumed, they accumulate\n across both calls.\n\n This is disabled by default."]
+    pub fn ts_parser_set_stats_enabled(self_: *mut TSParser, enabled: bool);
+}
+extern "C" {
+    #[doc = " Get whether the parser collects statistics about its parses."]
+    pub fn ts_parser_stats_enabled(self_: *const TSParser) -> bool;
+}
+extern "C" {
+    #[doc = " Get the statistics collected during the parser's most recent parse.\n\n All of the values are zero unless statistics were enabled with\n [`ts_parser_set_stats_enabled`]."]
+    pub fn ts_parser_stats(self_: *const TSParser) -> TSParserStats;
+}
+extern "C" {
+    #[doc = " Use the parser to parse some source code and create a syntax tree.\n\n If you are parsing this document for the first time, pass `NULL` for the\n `old_tree` parameter. Otherwise, if you have already parsed an earlier\n version of this document and the document has since been edited, pass the\n previous syntax tree so that the unchanged parts of it can be reused.\n This will save time and memory. For this to work correctly, you must have\n already edited the old syntax tree using the [`ts_tree_edit`] function in a\n way that exactly matches the source code changes.\n\n The [`TSInput`] parameter lets you specify how to read the text. It has the\n following three fields:\n 1. [`read`]: A function to retrieve a chunk of text at a given byte offset\n    and (row, column) position. The function should return a pointer to the\n    text and write its length to the [`bytes_read`] pointer. The parser does\n    not take ownership of this buffer; it just borrows it until it has\n    finished reading it. The function should write a zero value to the\n    [`bytes_read`] pointer to indicate the end of the document.\n 2. [`payload`]: An arbitrary pointer that will be passed to each invocation\n    of the [`read`] function.\n 3. [`encoding`]: An indication of how the text is encoded. Either\n    `TSInputEncodingUTF8`, `TSInputEncodingUTF16`, or `TSInputEncodingLatin1`.\n    Latin1 text is read one byte per character, so it can also be used for\n    ASCII text.\n\n This function returns a syntax tree on success, and `NULL` on failure. There\n are four possible reasons for failure:\n 1. The parser does not have a language assigned. Check for this using the\n[`ts_parser_language`] function.\n 2. Parsing was cancelled due to a timeout that was set by an earlier call to\n    the [`ts_parser_set_timeout_micros`] function. You can resume parsing from\n    where the parser left out by calling [`ts_parser_parse`] again with the\n    same arguments. Or you can start parsing from scratch by first calling\n    [`ts_parser_reset`].\n 3. Parsing was cancelled using a cancellation flag that was set by an\n    earlier call to [`ts_parser_set_cancellation_flag`]. You can resume parsing\n    from where the parser left out by calling [`ts_parser_parse`] again with\n    the same arguments.\n 4. Parsing was halted by the progress callback or the byte budget that were\n    passed to [`ts_parser_parse_with_options`]. You can resume parsing in\n    the same way.\n\n [`read`]: TSInput::read\n [`payload`]: TSInput::payload\n [`encoding`]: TSInput::encoding\n [`bytes_read`]: TSInput::read"]
     pub fn ts_parser_parse(
         self_: *mut TSParser,
         old_tree: *const TSTree,
@@ -184,7 +440,7 @@ extern "C" {
     ) -> *mut TSTree;
 }
 extern "C" {
-    #[doc = " Use the parser to parse some source code stored in one contiguous buffer.\n The first two parameters are the same as in the [`ts_parser_parse`] function\n above. The second two parameters indicate the location of the buffer and its\n length in bytes."]
+    #[doc = " Use the parser to parse some source code stored in one contiguous buffer.\n The first two parameters are the same as in the [`ts_parser_parse`] function\n above. The second two parameters indicate the location of the buffer and its\n length in bytes.\n\n Because the whole buffer is available up front, the parser reads from it\n directly instead of requesting the text in chunks, so this is the fastest\n way to parse a document that is already in memory."]
     pub fn ts_parser_parse_string(
         self_: *mut TSParser,
         old_tree: *const TSTree,
@@ -193,7 +449,7 @@ extern "C" {
     ) -> *mut TSTree;
 }
 extern "C" {
-    #[doc = " Use the parser to parse some source code stored in one contiguous buffer with\n a given encoding. The first four parameters work the same as in the\n [`ts_parser_parse_string`] method above. The final parameter indicates whether\n the text is encoded as UTF8 or UTF16."]
+    #[doc = " Use the parser to parse some source code stored in one contiguous buffer with\n a given encoding. The first four parameters work the same as in the\n [`ts_parser_parse_string`] method above. The final parameter indicates whether\n the text is encoded as UTF8, UTF16, or Latin1."]
     pub fn ts_parser_parse_string_encoding(
         self_: *mut TSParser,
         old_tree: *const TSTree,
@@ -202,6 +458,37 @@ extern "C" {
         encoding: TSInputEncoding,
     ) -> *mut TSTree;
 }
+extern "C" {
+    #[doc = " Use the parser to parse some source code that is stored in several buffers,\n such as the leaves of a rope. The first two parameters are the same as in the\n [`ts_parser_parse`] function above. The next two parameters are an array of\n spans, ordered by their byte offsets, which together contain the whole text\n of the document. The final parameter indicates whether the text is encoded as\n UTF8, UTF16, or Latin1.\n\n Each span must begin where the previous one ends, the first one must begin\n at offset zero, and their total length must fit in a `uint32_t`. Otherwise,\n this function returns `NULL` without parsing anything. It also returns `NULL`\n in the same cases as [`ts_parser_parse`], so use\n [`ts_input_spans_are_valid`] to tell invalid spans apart from a parse that\n can be resumed. As with the [`read`] function of a [`TSInput`], a character\n should not be split between two spans.\n\n The parser finds the text at a given position by searching the spans\n directly, instead of calling a function to read each chunk, so this is faster\n than [`ts_parser_parse`] for documents that are split into many small pieces.\n The spans are not copied: the array and the text that it points to must stay\n valid until this function returns."]
+    pub fn ts_parser_parse_spans(
+        self_: *mut TSParser,
+        old_tree: *const TSTree,
+        spans: *const TSInputSpan,
+        span_count: u32,
+        encoding: TSInputEncoding,
+    ) -> *mut TSTree;
+}
+extern "C" {
+    #[doc = " Check whether the given spans can be passed to [`ts_parser_parse_spans`],\n as described there. This takes time proportional to the number of spans."]
+    pub fn ts_input_spans_are_valid(spans: *const TSInputSpan, span_count: u32) -> bool;
+}
+extern "C" {
+    #[doc = " Use the parser to parse a long document, passing each of the root node's\n children to a callback as soon as the parser has finished it, instead of\n keeping the whole syntax tree in memory.\n\n This is useful for documents that consist of a long sequence of independent\n top-level nodes, such as logs or JSON Lines. A top-level node is passed to\n the [`emit`] function of the [`TSStreamCallback`] once it has been reduced\n and no longer depends on the text that follows it. The node belongs to a\n temporary tree, which is deleted after the [`emit`] function returns, so\n the function must copy anything that it needs, or copy the node's tree with\n [`ts_tree_copy`].\n\n The returned tree contains the remaining top-level nodes, which were not\n passed to the callback. The text covered by the streamed nodes is skipped\n over by a hidden placeholder node, so the positions of the remaining nodes\n are correct. If this tree is passed as the old tree in a later parse, none\n of the streamed nodes can be reused.\n\n The parser can only determine that a node is finished when there is no\n ambiguity about how the text before it was parsed. If a syntax error later\n in the document would have caused a normal parse to include a streamed node\n inside of an `ERROR` node, that node will have been streamed as it was. If\n parsing is cancelled, it should be resumed by calling this function again.\n\n [`emit`]: TSStreamCallback::emit"]
+    pub fn ts_parser_parse_streaming(
+        self_: *mut TSParser,
+        input: TSInput,
+        callback: TSStreamCallback,
+    ) -> *mut TSTree;
+}
+extern "C" {
+    #[doc = " Use the parser to parse some source code, like [`ts_parser_parse`], with\n some options that allow the parse to be interleaved with other work:\n\n 1. [`progress_callback`]: A function that is called periodically during\n    parsing, with a [`TSParseState`] that holds the given [`payload`], the\n    byte offset that the parser has reached, the number of parse actions\n    that it has processed so far, and whether it has encountered a syntax\n    error. If the function returns `true`, the parse halts early.\n 2. [`byte_budget`]: If this is not zero, the parse halts early once it has\n    advanced over this many bytes since the start of this call.\n\n When the parse halts early, this function returns `NULL`, and the parse can\n be resumed as described in [`ts_parser_parse`], with the same or different\n options. The operation count and the statistics accumulate across calls.\n\n [`progress_callback`]: TSParseOptions::progress_callback\n [`payload`]: TSParseOptions::payload\n [`byte_budget`]: TSParseOptions::byte_budget"]
+    pub fn ts_parser_parse_with_options(
+        self_: *mut TSParser,
+        old_tree: *const TSTree,
+        input: TSInput,
+        options: TSParseOptions,
+    ) -> *mut TSTree;
+}
 extern "C" {
     #[doc = " Instruct the parser to start the next parse from the beginning.\n\n If the parser previously failed because of a timeout or a cancellation, then\n by default, it will resume where it left off on the next call to\n [`ts_parser_parse`] or other parsing functions. If you don't want to resume,\n and instead intend to use this parser to parse some other document, you must\n call [`ts_parser_reset`] first."]
     pub fn ts_parser_reset(self_: *mut TSParser);
@@ -235,7 +522,7 @@ extern "C" {
     pub fn ts_parser_print_dot_graphs(self_: *mut TSParser, fd: ::core::ffi::c_int);
 }
 extern "C" {
-    #[doc = " Create a shallow copy of the syntax tree. This is very fast.\n\n You need to copy a syntax tree in order to use it on more than one thread at\n a time, as syntax trees are not thread safe."]
+    #[doc = " Create a shallow copy of the syntax tree. This is very fast, because the\n copy shares the tree's nodes and its child and parent indices.\n\n You need to copy a syntax tree in order to use it on more than one thread at\n a time, as syntax trees are not thread safe."]
     pub fn ts_tree_copy(self_: *const TSTree) -> *mut TSTree;
 }
 extern "C" {
@@ -254,6 +541,30 @@ extern "C" {
         offset_extent: TSPoint,
     ) -> TSNode;
 }
+extern "C" {
+    #[doc = " Build an index of the children of the nodes in the syntax tree that have\n many children.\n\n Without an index, finding a node's child by its index requires descending\n through the hidden nodes that contain it, which takes time proportional to\n the logarithm of the node's child count. With an index, [`ts_node_child`]\n and [`ts_node_named_child`] take constant time for any node with many\n visible children, and [`ts_node_prev_sibling`], [`ts_node_next_sibling`],\n and their named variants no longer need to search their parent's children.\n Building the index takes time proportional to the size of the tree.\n\n The index is shared by copies made with [`ts_tree_copy`], and discarded by\n [`ts_tree_edit`]."]
+    pub fn ts_tree_build_child_index(self_: *mut TSTree);
+}
+extern "C" {
+    #[doc = " Build an index of the parents of the nodes in the syntax tree.\n\n Without an index, [`ts_node_parent`] finds a node's parent by descending\n from the root node, which takes time proportional to the node's depth.\n With an index, it takes constant time, so walking up from a node to all of\n its ancestors takes time proportional to their number. Building the index\n takes time proportional to the size of the tree.\n\n The index is shared by copies made with [`ts_tree_copy`], and discarded by\n [`ts_tree_edit`]."]
+    pub fn ts_tree_build_parent_index(self_: *mut TSTree);
+}
+extern "C" {
+    #[doc = " Get the number of bytes of memory used by the syntax tree's child index and\n parent index. See [`ts_tree_build_child_index`] and\n [`ts_tree_build_parent_index`]."]
+    pub fn ts_tree_index_size(self_: *const TSTree) -> usize;
+}
+extern "C" {
+    #[doc = " Estimate the memory used by the syntax tree, in constant time.\n\n The report counts the tree's nodes: the small leaves that are stored\n inline in their parent's array of children, and the nodes that are\n allocated on the heap. These counts are exact, because every node keeps\n track of its descendants. Its bytes are the memory used by the heap nodes\n and the arrays of children, along with the tree's own data and the\n indices described in [`ts_tree_index_size`]. The nodes are counted as\n shared if the tree has been copied with [`ts_tree_copy`], and otherwise as\n exclusive, even though some of them may also be part of an earlier or later\n version of the tree, and the indices are counted as shared if a copy of the\n tree refers to them. The `scanner_state_bytes` are always zero, because\n finding the external scanner states requires visiting the tokens.\n\n Use [`ts_tree_memory_usage_exact`] to tell which nodes are shared."]
+    pub fn ts_tree_memory_usage(self_: *const TSTree, report: *mut TSMemoryReport);
+}
+extern "C" {
+    #[doc = " Measure the memory used by the syntax tree, by visiting all of its nodes.\n\n This reports the same node counts as [`ts_tree_memory_usage`], but splits\n the bytes exactly into the memory that is used only by this tree, and the\n memory that it shares with other trees, such as its copies and the trees\n that it was incrementally parsed from or into. Deleting the tree frees its\n exclusive memory, and the shared memory is freed once the last tree that\n uses it is deleted. The report also includes the bytes of the long external\n scanner states that the tree's tokens refer to, which are counted once even\n if several tokens share a state, and which are also included in the\n exclusive or shared bytes.\n\n For a tree that was parsed in arena mode or compacted with\n [`ts_tree_compact`], the bytes are those used by the tree's nodes. The\n arena itself can be larger, because it is only freed as a whole.\n\n This takes time proportional to the size of the tree."]
+    pub fn ts_tree_memory_usage_exact(self_: *const TSTree, report: *mut TSMemoryReport);
+}
+extern "C" {
+    #[doc = " Move all of the syntax tree's nodes into one new block of memory, in the\n order in which they are visited, and rebalance its repetitions.\n\n A tree that has been edited and reparsed many times shares its nodes with\n the earlier versions of the document, and those nodes are spread across the\n memory that was allocated for each parse. Compacting the tree makes walking\n it as fast as walking a freshly parsed tree, and lets the memory of the\n earlier versions be freed once no other tree refers to it. Compacting takes\n time proportional to the size of the tree, and it does not change the\n tree's visible nodes.\n\n Like [`ts_tree_edit`], this invalidates any nodes and tree cursors that were\n obtained from the tree, and discards its child and parent indices."]
+    pub fn ts_tree_compact(self_: *mut TSTree);
+}
 extern "C" {
     #[doc = " Get the language that was used to parse the syntax tree."]
     pub fn ts_tree_language(self_: *const TSTree) -> *const TSLanguage;
@@ -274,6 +585,26 @@ extern "C" {
         length: *mut u32,
     ) -> *mut TSRange;
 }
+extern "C" {
+    #[doc = " Compare an old edited syntax tree to a new syntax tree representing the same\n document, returning the nodes of the new tree whose syntactic structure has\n changed.\n\n For each range returned by [`ts_tree_get_changed_ranges`], this returns the\n smallest node of the new tree that contains the range, omitting any node\n that is contained by another returned node. Work such as syntax highlighting\n can be redone for just these nodes.\n\n The returned array is allocated using `malloc` and the caller is responsible\n for freeing it using `free`. The length of the array will be written to the\n given `length` pointer."]
+    pub fn ts_tree_get_changed_nodes(
+        old_tree: *const TSTree,
+        new_tree: *const TSTree,
+        length: *mut u32,
+    ) -> *mut TSNode;
+}
+extern "C" {
+    #[doc = " Serialize a syntax tree into a compact binary buffer, so that it can be\n stored and later reloaded with [`ts_tree_deserialize`] without parsing the\n document again.\n\n The buffer contains no pointers, but it uses the host's byte order, and\n it can only be read by the same version of the library, using the same\n language that produced the tree.\n\n The returned buffer is allocated using `malloc` and the caller is\n responsible for freeing it using `free`. The length of the buffer will be\n written to the given `length` pointer."]
+    pub fn ts_tree_serialize(self_: *const TSTree, length: *mut u32) -> *mut ::core::ffi::c_char;
+}
+extern "C" {
+    #[doc = " Load a syntax tree from a buffer that was created with [`ts_tree_serialize`].\n\n The resulting tree does not refer to the buffer, and can be used like any\n other tree, including as the old tree for an incremental parse, or with\n [`ts_tree_get_changed_ranges`]. Its source code must be the same as that of\n the tree that was serialized.\n\n This returns `NULL` if the buffer is malformed, if it was created by a\n different version of the library, or if it was created for a different\n language. Every node is checked against the language and against its\n children, so a buffer from an untrusted source can't produce a tree that\n the library would read out of bounds."]
+    pub fn ts_tree_deserialize(
+        language: *const TSLanguage,
+        data: *const ::core::ffi::c_char,
+        length: u32,
+    ) -> *mut TSTree;
+}
 extern "C" {
     #[doc = " Write a DOT graph describing the syntax tree to the given file."]
     pub fn ts_tree_print_dot_graph(self_: *const TSTree, file_descriptor: ::core::ffi::c_int);
@@ -430,6 +761,10 @@ extern "C" {
     #[doc = " Get the node's number of descendants, including one for the node itself."]
     pub fn ts_node_descendant_count(self_: TSNode) -> u32;
 }
+extern "C" {
+    #[doc = " Get a hash of the node's structure.\n\n The hash depends on the node's type, and on the types and the order of all\n of its descendants, along with the length in bytes of each leaf node. It\n does not depend on the node's position, on the whitespace between its\n tokens, or on the tree that contains it, so nodes with the same structure\n in different trees with the same language have the same hash. The text of\n the tokens is not included, so two nodes with the same hash can still have\n different text, and nodes with different structures can very rarely have\n the same hash.\n\n Parsing doesn't compute any hashes. The first call for a node computes the\n hashes within it, in time proportional to its number of descendants, and\n later calls for it or for its descendants take constant time, including in\n copies of the tree and in new trees that reuse it. In an edited tree, the\n hash reflects the edited lengths of the leaf nodes."]
+    pub fn ts_node_hash(self_: TSNode) -> u64;
+}
 extern "C" {
     #[doc = " Get the smallest node within this node that spans the given range of bytes\n or (row, column) positions."]
     pub fn ts_node_descendant_for_byte_range(self_: TSNode, start: u32, end: u32) -> TSNode;
@@ -535,9 +870,79 @@ extern "C" {
         goal_point: TSPoint,
     ) -> i64;
 }
+extern "C" {
+    #[doc = " Walk the tree in preorder, starting at the cursor's current node and\n continuing through the nodes after it, without leaving the original node\n that the cursor was constructed with. Each visited node that passes the\n given filter is written to `entries`, along with its field id and its\n depth relative to the original node. The filter has three parts:\n\n 1. [`symbols`]: If this is not `NULL`, it is a bitset of [`symbol_count`]\n    bits, where bit `i % 8` of byte `i / 8` says whether to include nodes\n    whose symbol is `i`. Nodes whose symbol is not in the bitset are\n    excluded.\n 2. [`max_depth`]: If this is not zero, the walk does not visit nodes that\n    are deeper than this.\n 3. [`named_only`]: If this is `true`, anonymous nodes are excluded.\n\n Excluded nodes are not written, but their descendants are still visited.\n\n The number of entries written is stored in `count`. If the walk stops\n because `capacity` entries have been written, this returns `true`, and\n the cursor is left on the next node to be written, so that the walk can\n be continued with another call. Otherwise, the walk is finished, the\n cursor is moved back to the original node, and this returns `false`.\n\n [`symbols`]: TSTreeCursorWalkOptions::symbols\n [`symbol_count`]: TSTreeCursorWalkOptions::symbol_count\n [`max_depth`]: TSTreeCursorWalkOptions::max_depth\n [`named_only`]: TSTreeCursorWalkOptions::named_only"]
+    pub fn ts_tree_cursor_walk(
+        self_: *mut TSTreeCursor,
+        options: *const TSTreeCursorWalkOptions,
+        entries: *mut TSTreeCursorWalkEntry,
+        capacity: u32,
+        count: *mut u32,
+    ) -> bool;
+}
 extern "C" {
     pub fn ts_tree_cursor_copy(cursor: *const TSTreeCursor) -> TSTreeCursor;
 }
+extern "C" {
+    #[doc = " Create a flat, read-only snapshot of the given syntax tree.\n\n The snapshot stores the tree's visible nodes in preorder, with each of their\n properties in a separate contiguous array, so scanning the whole tree\n repeatedly reads memory sequentially instead of following pointers. Nodes\n are numbered in the same order as by [`ts_tree_cursor_goto_descendant`].\n\n The snapshot does not refer to the syntax tree, so it remains valid after\n the tree is edited or deleted. It is never modified after it is created, so\n it can be read from several threads at once."]
+    pub fn ts_tree_flatten(self_: *const TSTree) -> *mut TSFlatTree;
+}
+extern "C" {
+    #[doc = " Delete a flat tree, freeing all of the memory that it used."]
+    pub fn ts_flat_tree_delete(self_: *mut TSFlatTree);
+}
+extern "C" {
+    #[doc = " Get the number of nodes in a flat tree."]
+    pub fn ts_flat_tree_node_count(self_: *const TSFlatTree) -> u32;
+}
+extern "C" {
+    #[doc = " Get the language of the syntax tree from which a flat tree was created."]
+    pub fn ts_flat_tree_language(self_: *const TSFlatTree) -> *const TSLanguage;
+}
+extern "C" {
+    #[doc = " Create a cursor for a flat tree, starting at its root node.\n\n A flat tree cursor does not own any memory, so it can be copied freely and\n does not need to be deleted. Each of its movements takes constant time."]
+    pub fn ts_flat_tree_cursor_new(self_: *const TSFlatTree) -> TSFlatTreeCursor;
+}
+extern "C" {
+    #[doc = " Move the cursor to the first child of its current node.\n\n This returns `true` if the cursor successfully moved, and returns `false`\n if there were no children."]
+    pub fn ts_flat_tree_cursor_goto_first_child(self_: *mut TSFlatTreeCursor) -> bool;
+}
+extern "C" {
+    #[doc = " Move the cursor to the next sibling of its current node.\n\n This returns `true` if the cursor successfully moved, and returns `false`\n if there was no next sibling node."]
+    pub fn ts_flat_tree_cursor_goto_next_sibling(self_: *mut TSFlatTreeCursor) -> bool;
+}
+extern "C" {
+    #[doc = " Move the cursor to the parent of its current node.\n\n This returns `true` if the cursor successfully moved, and returns `false`\n if there was no parent node (the cursor was already on the root node)."]
+    pub fn ts_flat_tree_cursor_goto_parent(self_: *mut TSFlatTreeCursor) -> bool;
+}
+extern "C" {
+    #[doc = " Move the cursor to the node that is the nth descendant of the root node in\n preorder, where zero represents the root node itself. If the index is out\n of bounds, the cursor does not move."]
+    pub fn ts_flat_tree_cursor_goto_descendant(self_: *mut TSFlatTreeCursor, descendant_index: u32);
+}
+extern "C" {
+    #[doc = " Get the index of the cursor's current node out of all of the nodes in the\n flat tree, in preorder."]
+    pub fn ts_flat_tree_cursor_current_descendant_index(self_: *const TSFlatTreeCursor) -> u32;
+}
+extern "C" {
+    #[doc = " Get the properties of the cursor's current node."]
+    pub fn ts_flat_tree_cursor_current_node(self_: *const TSFlatTreeCursor) -> TSFlatNode;
+}
+extern "C" {
+    #[doc = " Create a tree snapshot, which holds the latest version of a syntax tree so\n that other threads can read it while it is being edited and reparsed.\n\n The snapshot starts out holding a copy of the given tree, which may be\n `NULL`. It can be shared between threads: one or more writers replace its\n tree with [`ts_tree_snapshot_publish`], and any number of readers get the\n current tree with [`ts_tree_snapshot_acquire`], without ever blocking."]
+    pub fn ts_tree_snapshot_new(tree: *const TSTree) -> *mut TSTreeSnapshot;
+}
+extern "C" {
+    #[doc = " Delete a tree snapshot, along with its reference to the current tree.\n\n This must not be called while another thread is using the snapshot. Trees\n that were acquired from the snapshot remain valid."]
+    pub fn ts_tree_snapshot_delete(self_: *mut TSTreeSnapshot);
+}
+extern "C" {
+    #[doc = " Replace the snapshot's tree with a copy of the given tree, which may be\n `NULL`.\n\n The caller keeps ownership of the given tree, and can go on editing it and\n passing it to [`ts_parser_parse`] as the old tree, because the copies share\n their nodes, and editing a tree never modifies nodes that another copy\n refers to. This waits for any readers that are in the middle of acquiring\n the previous tree before releasing it, which takes only as long as a call\n to [`ts_tree_copy`], and doesn't depend on the size of the tree."]
+    pub fn ts_tree_snapshot_publish(self_: *mut TSTreeSnapshot, tree: *const TSTree);
+}
+extern "C" {
+    #[doc = " Get a copy of the snapshot's current tree, or `NULL` if it has none.\n\n This can be called from any thread, at the same time as other readers and\n writers, and never waits for them. The result is an ordinary shallow copy,\n made with [`ts_tree_copy`], which the caller must delete with\n [`ts_tree_delete`]. It keeps its version of the tree alive, so the caller\n can go on reading it after newer versions are published."]
+    pub fn ts_tree_snapshot_acquire(self_: *mut TSTreeSnapshot) -> *mut TSTree;
+}
 extern "C" {
     #[doc = " Create a new query from a string containing one or more S-expression\n patterns. The query is associated with a particular language, and can\n only be run on syntax nodes parsed with that language.\n\n If all of the given patterns are valid, this returns a [`TSQuery`].\n If a pattern is invalid, this returns `NULL`, and provides two pieces\n of information about the problem:\n 1. The byte offset of the error is written to the `error_offset` parameter.\n 2. The type of error is written to the `error_type` parameter."]
     pub fn ts_query_new(
@@ -552,6 +957,18 @@ extern "C" {
     #[doc = " Delete a query, freeing all of the memory that it used."]
     pub fn ts_query_delete(self_: *mut TSQuery);
 }
+extern "C" {
+    #[doc = " Serialize a query into a compact binary buffer, so that it can be stored\n and later reloaded with [`ts_query_deserialize`] without parsing its source\n or analyzing its patterns again.\n\n The buffer contains no pointers, but it uses the host's byte order, and it\n can only be read by the same version of the library. Because the query's\n analysis depends on the language's parse table, it must also be read with\n the same language: the language's version, its numbers of symbols, states\n and fields, and a hash of its symbol and field names are checked. Patterns\n and captures that were disabled remain disabled.\n\n The returned buffer is allocated using `malloc` and the caller is\n responsible for freeing it using `free`. The length of the buffer will be\n written to the given `length` pointer."]
+    pub fn ts_query_serialize(self_: *const TSQuery, length: *mut u32) -> *mut ::core::ffi::c_char;
+}
+extern "C" {
+    #[doc = " Load a query from a buffer that was created with [`ts_query_serialize`].\n\n This returns `NULL` if the buffer is malformed, if it was created by a\n different version of the library, or if it was created for a different\n language."]
+    pub fn ts_query_deserialize(
+        language: *const TSLanguage,
+        data: *const ::core::ffi::c_char,
+        length: u32,
+    ) -> *mut TSQuery;
+}
 extern "C" {
     #[doc = " Get the number of patterns, captures, or string literals in the query."]
     pub fn ts_query_pattern_count(self_: *const TSQuery) -> u32;
@@ -587,6 +1004,14 @@ extern "C" {
 extern "C" {
     pub fn ts_query_is_pattern_guaranteed_at_step(self_: *const TSQuery, byte_offset: u32) -> bool;
 }
+extern "C" {
+    #[doc = " Check if the given predicate of a pattern is evaluated by query cursors that\n have a text provider. See [`ts_query_cursor_set_text_provider`].\n\n The predicate is specified by its index among the pattern's predicates, in\n the order returned by [`ts_query_predicates_for_pattern`]. Bindings that\n evaluate predicates themselves can skip the ones for which this returns\n `true`."]
+    pub fn ts_query_is_predicate_built_in(
+        self_: *const TSQuery,
+        pattern_index: u32,
+        predicate_index: u32,
+    ) -> bool;
+}
 extern "C" {
     #[doc = " Get the name and length of one of the query's captures, or one of the\n query's string literals. Each capture and string is associated with a\n numeric id based on the order that it appeared in the query's source."]
     pub fn ts_query_capture_name_for_id(
@@ -611,7 +1036,7 @@ extern "C" {
     ) -> *const ::core::ffi::c_char;
 }
 extern "C" {
-    #[doc = " Disable a certain capture within a query.\n\n This prevents the capture from being returned in matches, and also avoids\n any resource usage associated with recording the capture. Currently, there\n is no way to undo this."]
+    #[doc = " Disable a certain capture within a query.\n\n This prevents the capture from being returned in matches, and also avoids\n any resource usage associated with recording the capture. Currently, there\n is no way to undo this.\n\n This modifies the query, so it must not be called while the query is being\n used by another thread. To disable a capture for only one use of a shared\n query, see [`ts_query_cursor_disable_capture`]."]
     pub fn ts_query_disable_capture(
         self_: *mut TSQuery,
         name: *const ::core::ffi::c_char,
@@ -619,7 +1044,7 @@ extern "C" {
     );
 }
 extern "C" {
-    #[doc = " Disable a certain pattern within a query.\n\n This prevents the pattern from matching and removes most of the overhead\n associated with the pattern. Currently, there is no way to undo this."]
+    #[doc = " Disable a certain pattern within a query.\n\n This prevents the pattern from matching and removes most of the overhead\n associated with the pattern. Currently, there is no way to undo this.\n\n This modifies the query, so it must not be called while the query is being\n used by another thread. To disable a pattern for only one use of a shared\n query, see [`ts_query_cursor_disable_pattern`]."]
     pub fn ts_query_disable_pattern(self_: *mut TSQuery, pattern_index: u32);
 }
 extern "C" {
@@ -652,6 +1077,10 @@ extern "C" {
     #[doc = " Get the duration in microseconds that query execution is allowed to take.\n\n This is set via [`ts_query_cursor_set_timeout_micros`]."]
     pub fn ts_query_cursor_timeout_micros(self_: *const TSQueryCursor) -> u64;
 }
+extern "C" {
+    #[doc = " Get the number of operations that the query cursor has performed since\n the last call to [`ts_query_cursor_exec`].\n\n Each step that the cursor takes onto or off of a node counts as one\n operation, plus one for each match that is in progress at that step. The\n count is deterministic, so dividing it by the length of the searched text\n gives a stable measure of how expensive a query is to execute on a\n document."]
+    pub fn ts_query_cursor_operation_count(self_: *const TSQueryCursor) -> u64;
+}
 extern "C" {
     #[doc = " Set the range of bytes or (row, column) positions in which the query\n will be executed."]
     pub fn ts_query_cursor_set_byte_range(
@@ -667,6 +1096,21 @@ extern "C" {
         end_point: TSPoint,
     );
 }
+extern "C" {
+    #[doc = " Set several disjoint ranges of bytes in which the query will be executed,\n so that one execution finds the matches in all of them, without searching\n the text in between. Only the ranges' byte offsets are used. The ranges\n must be sorted and must not overlap, although one may end where the next\n begins. A match is found if it would be found when executing the query in\n any one of the ranges, and it is found only once.\n\n These ranges replace the byte range set with\n [`ts_query_cursor_set_byte_range`], and are replaced by it in turn.\n They are combined with the range set with\n [`ts_query_cursor_set_point_range`]. An empty array of ranges removes the\n restriction.\n\n Returns `false` and leaves the cursor unchanged if the ranges are not\n sorted or they overlap."]
+    pub fn ts_query_cursor_set_byte_ranges(
+        self_: *mut TSQueryCursor,
+        ranges: *const TSRange,
+        count: u32,
+    ) -> bool;
+}
+extern "C" {
+    #[doc = " Set the text provider that a query cursor uses to evaluate the text\n predicates of its query.\n\n When a cursor has a text provider, it evaluates well-formed `#eq?`,\n `#match?` and `#any-of?` predicates itself, along with their `not-` and\n `any-` variants, and never returns matches that fail them. The provider's\n `text` function must return the UTF8 text of the given node and write its\n length to `*length`. The text only needs to stay valid until the next call.\n\n The plain variants require every node of a capture to satisfy the predicate,\n while the `any-` variants require at least one of them to satisfy it. A\n predicate on a capture with no nodes is always satisfied. A `#match?`\n predicate whose regex uses syntax that the library does not support, like\n Perl or Unicode classes, is left to the caller, as is any other predicate.\n Use [`ts_query_is_predicate_built_in`] to tell them apart.\n\n Set the `text` function to `NULL` to stop evaluating predicates."]
+    pub fn ts_query_cursor_set_text_provider(
+        self_: *mut TSQueryCursor,
+        provider: TSQueryTextProvider,
+    );
+}
 extern "C" {
     #[doc = " Advance to the next match of the currently running query.\n\n If there is a match, write it to `*match` and return `true`.\n Otherwise, return `false`."]
     pub fn ts_query_cursor_next_match(self_: *mut TSQueryCursor, match_: *mut TSQueryMatch)
@@ -687,6 +1131,65 @@ extern "C" {
     #[doc = " Set the maximum start depth for a query cursor.\n\n This prevents cursors from exploring children nodes at a certain depth.\n Note if a pattern includes many children, then they will still be checked.\n\n The zero max start depth value can be used as a special behavior and\n it helps to destructure a subtree by staying on a node and using captures\n for interested parts. Note that the zero max start depth only limit a search\n depth for a pattern's root node but other nodes that are parts of the pattern\n may be searched at any depth what defined by the pattern structure.\n\n Set to `UINT32_MAX` to remove the maximum start depth."]
     pub fn ts_query_cursor_set_max_start_depth(self_: *mut TSQueryCursor, max_start_depth: u32);
 }
+extern "C" {
+    #[doc = " Preallocate all of the memory that the query cursor uses to track matches,\n so that running a query does not allocate memory after the first call to\n [`ts_query_cursor_exec`] for a tree of a given depth.\n\n The cursor will track at most `state_count` in-progress and finished\n matches at once, and each match can hold at most `capture_count` captures.\n Matches that would exceed these limits are dropped, as with the match limit,\n and [`ts_query_cursor_did_exceed_match_limit`] will return `true`.\n\n Set `state_count` to zero to remove both limits. `capture_count` is then\n ignored."]
+    pub fn ts_query_cursor_set_capacity(
+        self_: *mut TSQueryCursor,
+        state_count: u32,
+        capture_count: u32,
+    );
+}
+extern "C" {
+    #[doc = " Disable a certain pattern for every query that is subsequently executed\n with this cursor.\n\n Unlike [`ts_query_disable_pattern`], this does not modify the query, so a\n single query can be shared by many threads, each using its own cursor with\n its own set of disabled patterns. The pattern remains disabled until\n [`ts_query_cursor_enable_all`] is called."]
+    pub fn ts_query_cursor_disable_pattern(self_: *mut TSQueryCursor, pattern_index: u32);
+}
+extern "C" {
+    #[doc = " Disable a certain capture for every query that is subsequently executed\n with this cursor. The capture is identified by its index, as accepted by\n [`ts_query_capture_name_for_id`].\n\n Unlike [`ts_query_disable_capture`], this does not modify the query. The\n capture remains disabled until [`ts_query_cursor_enable_all`] is called."]
+    pub fn ts_query_cursor_disable_capture(self_: *mut TSQueryCursor, capture_index: u32);
+}
+extern "C" {
+    #[doc = " Re-enable all of the patterns and captures that were disabled with\n [`ts_query_cursor_disable_pattern`] and [`ts_query_cursor_disable_capture`]."]
+    pub fn ts_query_cursor_enable_all(self_: *mut TSQueryCursor);
+}
+extern "C" {
+    #[doc = " Run a query incrementally, updating a set of matches that was computed for\n an older version of a syntax tree so that it holds the matches for a newer\n version, and reporting the difference.\n\n The `matches` set must hold the matches of `query` in `old_tree`, as left\n by a previous call to this function, and it must have received the same\n edits as `old_tree` via [`ts_query_match_set_edit`]. Only the parts of the\n new tree that are affected by those edits or by the tree's changed ranges\n are searched again: a match is searched for again if the node that matches\n the root of its pattern, or the parent of its first node if the pattern has\n several top-level nodes, overlaps them. Patterns that are marked as non-local\n by [`ts_query_is_pattern_non_local`] are handled in the same way, because\n their nodes are all children of that parent.\n\n Pass `NULL` for `old_tree` to search the whole tree and fill an empty set.\n Either of `added` and `removed` may be `NULL`. Otherwise, they are cleared,\n and the matches that the update added to and removed from `matches` are\n stored in them.\n\n The cursor's byte and point ranges are not used, and its text provider is\n used to evaluate any text predicates. This returns `false` and leaves the\n sets unchanged if the cursor's timeout or match limit was reached."]
+    pub fn ts_query_cursor_exec_incremental(
+        self_: *mut TSQueryCursor,
+        query: *const TSQuery,
+        matches: *mut TSQueryMatchSet,
+        old_tree: *const TSTree,
+        new_tree: *const TSTree,
+        added: *mut TSQueryMatchSet,
+        removed: *mut TSQueryMatchSet,
+    ) -> bool;
+}
+extern "C" {
+    #[doc = " Create a new, empty set of query matches.\n\n A match set stores the pattern index and the captured ranges of each match,\n so that it remains valid after the syntax tree that it was computed from\n has been edited or deleted. Identical matches are stored once. The matches\n are ordered by position, but not in the same order in which a query cursor\n returns them."]
+    pub fn ts_query_match_set_new() -> *mut TSQueryMatchSet;
+}
+extern "C" {
+    #[doc = " Delete a match set, freeing all of the memory that it used."]
+    pub fn ts_query_match_set_delete(self_: *mut TSQueryMatchSet);
+}
+extern "C" {
+    #[doc = " Remove all of the matches from a match set."]
+    pub fn ts_query_match_set_clear(self_: *mut TSQueryMatchSet);
+}
+extern "C" {
+    #[doc = " Get the number of matches in a match set."]
+    pub fn ts_query_match_set_count(self_: *const TSQueryMatchSet) -> u32;
+}
+extern "C" {
+    #[doc = " Get the match at the given index in a match set. Its captures remain valid\n until the set is next modified."]
+    pub fn ts_query_match_set_match(
+        self_: *const TSQueryMatchSet,
+        index: u32,
+    ) -> TSQueryStoredMatch;
+}
+extern "C" {
+    #[doc = " Edit the positions of the matches in a set, so that they correspond to the\n edited source code. Apply each edit that is applied to a syntax tree with\n [`ts_tree_edit`] to the set of matches computed for it as well."]
+    pub fn ts_query_match_set_edit(self_: *mut TSQueryMatchSet, edit: *const TSInputEdit);
+}
 extern "C" {
     #[doc = " Get another reference to the given language."]
     pub fn ts_language_copy(self_: *const TSLanguage) -> *const TSLanguage;
@@ -754,6 +1257,23 @@ extern "C" {
         symbol: TSSymbol,
     ) -> TSStateId;
 }
+extern "C" {
+    #[doc = " Load a language from a language data file, which is written by\n `tree-sitter generate --emit-language-data`. The file is mapped into memory\n read-only, and the language's tables point directly into it, so loading a\n language does not require compiling its parser, and processes that load the\n same file share its pages.\n\n A language data file does not contain code, so a grammar's external scanner\n cannot be stored in it. For a grammar with an external scanner, pass the\n scanner's functions, which must be compiled natively. Otherwise, pass `NULL`.\n\n The structure of the file is validated, but the contents of its tables are\n trusted, just as the code of a compiled parser is, so the file must come from\n a trusted source.\n\n This returns `NULL` if the language cannot be loaded, and writes the reason\n to `error`, if it is not `NULL`. Delete the language with\n [`ts_language_delete`] when it is no longer needed."]
+    pub fn ts_language_load_mmap(
+        path: *const ::core::ffi::c_char,
+        scanner: *const TSExternalScanner,
+        error: *mut TSLanguageLoadError,
+    ) -> *const TSLanguage;
+}
+extern "C" {
+    #[doc = " Load a language from the contents of a language data file, like\n [`ts_language_load_mmap`]. The data is copied, so it does not need to\n outlive the language."]
+    pub fn ts_language_load_data(
+        data: *const ::core::ffi::c_void,
+        length: usize,
+        scanner: *const TSExternalScanner,
+        error: *mut TSLanguageLoadError,
+    ) -> *const TSLanguage;
+}
 extern "C" {
     #[doc = " Create a new lookahead iterator for the given language and parse state.\n\n This returns `NULL` if state is invalid for the language.\n\n Repeatedly using [`ts_lookahead_iterator_next`] and\n [`ts_lookahead_iterator_current_symbol`] will generate valid symbols in the\n given parse state. Newly created lookahead iterators will contain the `ERROR`\n symbol.\n\n Lookahead iterators can be useful to generate suggestions and improve syntax\n error diagnostics. To get symbols valid in an ERROR node, use the lookahead\n iterator on its first leaf node state. For `MISSING` nodes, a lookahead\n iterator created on the previous non-extra leaf node may be appropriate."]
     pub fn ts_lookahead_iterator_new(
@@ -809,6 +1329,11 @@ pub type TSWasmEngine = wasm_engine_t;
 pub struct TSWasmStore {
     _unused: [u8; 0],
 }
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct TSWasmModuleCache {
+    _unused: [u8; 0],
+}
 pub const TSWasmErrorKindNone: TSWasmErrorKind = 0;
 pub const TSWasmErrorKindParse: TSWasmErrorKind = 1;
 pub const TSWasmErrorKindCompile: TSWasmErrorKind = 2;
@@ -828,10 +1353,32 @@ extern "C" {
         error: *mut TSWasmError,
     ) -> *mut TSWasmStore;
 }
+extern "C" {
+    #[doc = " Create a Wasm store that uses the given module cache and the cache's\n engine. Stores that share a cache only compile the Wasm standard library,\n and each language's Wasm code, once."]
+    pub fn ts_wasm_store_new_with_cache(
+        cache: *mut TSWasmModuleCache,
+        error: *mut TSWasmError,
+    ) -> *mut TSWasmStore;
+}
 extern "C" {
     #[doc = " Free the memory associated with the given Wasm store."]
     pub fn ts_wasm_store_delete(arg1: *mut TSWasmStore);
 }
+extern "C" {
+    #[doc = " Create a cache of compiled Wasm modules for the given engine.\n\n Wasm stores that are created with [`ts_wasm_store_new_with_cache`] look up\n each module they need in the cache, by a hash of its Wasm bytes, and only\n compile the modules that it doesn't contain yet. Each store still has its\n own instance of every language that it loads. A cache can be shared by\n stores that are used on different threads."]
+    pub fn ts_wasm_module_cache_new(engine: *mut TSWasmEngine) -> *mut TSWasmModuleCache;
+}
+extern "C" {
+    #[doc = " Free the given module cache. Its modules are kept until the last store\n that was created with it is deleted."]
+    pub fn ts_wasm_module_cache_delete(arg1: *mut TSWasmModuleCache);
+}
+extern "C" {
+    #[doc = " Set a directory in which the module cache stores precompiled modules, so\n that they can be reused by later processes instead of compiling them\n again. Pass `NULL` to stop using a directory. This must be called before\n the cache is used by any store.\n\n Precompiled modules are loaded without being validated, so the directory\n must only be writable by trusted users. Files that cannot be loaded, such\n as ones written by a different version of the Wasm runtime, are replaced."]
+    pub fn ts_wasm_module_cache_set_directory(
+        arg1: *mut TSWasmModuleCache,
+        path: *const ::core::ffi::c_char,
+    );
+}
 extern "C" {
     #[doc = " Create a language from a buffer of Wasm. The resulting language behaves\n like any other Tree-sitter language, except that in order to use it with\n a parser, that parser must have a Wasm store. Note that the language\n can be used with any Wasm store, it doesn't need to be the same store that\n was used to originally load it."]
     pub fn ts_wasm_store_load_language(
@@ -876,3 +1423,23 @@ extern "C" {
         new_free: ::core::option::Option<unsafe extern "C" fn(arg1: *mut ::core::ffi::c_void)>,
     );
 }
+extern "C" {
+    #[doc = " Set whether the library should keep statistics about the memory it\n allocates.\n\n While tracking is enabled, each allocation is attributed to a category\n that describes what the memory is used for:\n  - `TSAllocationCategorySubtreePool`: syntax tree nodes and their arrays\n    of children, including arena slabs.\n  - `TSAllocationCategoryStackNodes`: the slabs of nodes in the parse stack.\n  - `TSAllocationCategoryIncludedRanges`: the lexer's included ranges.\n  - `TSAllocationCategoryQueryCursorStates`: the in-progress and finished\n    states of query cursors.\n  - `TSAllocationCategoryQueryCaptureLists`: the capture lists of query\n    cursors.\n  - `TSAllocationCategoryWasmStore`: Wasm stores and the languages loaded\n    into them. The memory that the Wasm runtime allocates itself is not\n    counted.\n  - `TSAllocationCategoryOther`: everything else.\n\n Tracking works by storing the size and category of each allocation in a\n small header in front of it, and wraps the allocation functions that are\n current when it is enabled. So it must be enabled after any call to\n [`ts_set_allocator`], and, like that function, it can only be enabled or\n disabled while no objects allocated by the library exist. While it is\n enabled, buffers that the library returns to the caller, such as the\n string returned by [`ts_node_string`], must be released with\n `ts_current_free` instead of `free`.\n\n Enabling tracking resets all of the statistics."]
+    pub fn ts_set_allocation_tracking(enabled: bool);
+}
+extern "C" {
+    #[doc = " Check whether the library is keeping statistics about its allocations."]
+    pub fn ts_allocation_tracking_enabled() -> bool;
+}
+extern "C" {
+    #[doc = " Get the allocation statistics for the given category. These are only\n collected while tracking is enabled with [`ts_set_allocation_tracking`]."]
+    pub fn ts_allocation_stats(category: TSAllocationCategory) -> TSAllocationStats;
+}
+extern "C" {
+    #[doc = " Get the allocation statistics for all categories combined. The peak is\n the highest number of bytes that were live at once, which can be lower\n than the sum of the peaks of each category."]
+    pub fn ts_allocation_total_stats() -> TSAllocationStats;
+}
+extern "C" {
+    #[doc = " Reset the allocation counts of every category to zero, and their peaks to\n the number of bytes that are currently live, so that the allocations made\n by a single operation can be measured. The live counts are not changed."]
+    pub fn ts_allocation_stats_reset();
+}
@@ -19,7 +19,12 @@ extern "C" {
     pub(crate) fn _ts_dup(handle: *mut std::os::raw::c_void) -> std::os::raw::c_int;
 }
 
-use core::{marker::PhantomData, mem::ManuallyDrop, ptr::NonNull, str};
+use core::{
+    marker::PhantomData,
+    mem::ManuallyDrop,
+    ptr::{self, NonNull},
+    str,
+};
 
 use crate::{
     Language, LookaheadIterator, Node, Parser, Query, QueryCursor, QueryError, Tree, TreeCursor,
@@ -148,13 +153,18 @@ impl QueryCursor {
     pub const unsafe fn from_raw(ptr: *mut TSQueryCursor) -> Self {
         Self {
             ptr: NonNull::new_unchecked(ptr),
+            buffers: ptr::null_mut(),
         }
     }
 
     /// Consumes the [`QueryCursor`], returning a raw pointer to the underlying C structure.
     #[must_use]
     pub fn into_raw(self) -> *mut TSQueryCursor {
-        ManuallyDrop::new(self).ptr.as_ptr()
+        let cursor = ManuallyDrop::new(self);
+        if !cursor.buffers.is_null() {
+            drop(unsafe { Box::from_raw(cursor.buffers) });
+        }
+        cursor.ptr.as_ptr()
     }
 }
 
@@ -19,6 +19,7 @@ use core::{
     ptr::{self, NonNull},
     slice, str,
     sync::atomic::AtomicUsize,
+    time::Duration,
 };
 #[cfg(feature = "std")]
 use std::error;
@@ -107,6 +108,221 @@ pub struct Node<'tree>(ffi::TSNode, PhantomData<&'tree ()>);
 #[doc(alias = "TSParser")]
 pub struct Parser(NonNull<ffi::TSParser>);
 
+/// A set of [`Parser`]s that parse many documents at once, using one parser
+/// per thread.
+#[cfg(feature = "std")]
+pub struct ParserPool {
+    parsers: Vec<Parser>,
+}
+
+/// The result of parsing one document with a [`ParserPool`].
+#[cfg(feature = "std")]
+#[derive(Debug)]
+pub struct BatchParseResult {
+    /// The syntax tree, or `None` if parsing was halted by the parser's
+    /// timeout or cancellation flag.
+    pub tree: Option<Tree>,
+    /// The time spent parsing the document.
+    pub duration: Duration,
+}
+
+/// Statistics about the work done by a [`Parser`] during its most recent
+/// parse.
+///
+/// These are only collected when enabled with
+/// [`Parser::set_stats_enabled`].
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct ParserStats {
+    /// The number of tokens produced by the lexer.
+    pub lexed_tokens: usize,
+    /// The number of lexed tokens that were too large to be stored inline,
+    /// and so were allocated on the heap.
+    pub heap_tokens: usize,
+    /// The number of tokens taken from the parser's token cache instead of
+    /// being lexed again.
+    pub cached_tokens: usize,
+    /// The number of times the parser's token cache had no token that could
+    /// be used at the current position.
+    pub token_cache_misses: usize,
+    /// The number of nodes reused from the old syntax tree.
+    pub reused_nodes: usize,
+    /// The number of nodes from the old syntax tree that were considered for
+    /// reuse, but could not be reused.
+    pub reuse_misses: usize,
+    /// The number of new stack versions created because of ambiguities.
+    pub version_splits: usize,
+    /// The number of times two stack versions were merged into one.
+    pub version_merges: usize,
+    /// The number of times the parser attempted to recover from an error.
+    pub recoveries: usize,
+    /// The number of those recoveries that were limited because the
+    /// parser's [`recovery_budget_per_byte`](ParserConfig::recovery_budget_per_byte)
+    /// was used up.
+    pub bounded_recoveries: usize,
+    /// The number of operations performed: the parse actions applied to the
+    /// stack, plus the stack entries examined and the versions created while
+    /// recovering from errors. Unlike the timings, this is deterministic.
+    pub operations: u64,
+    /// The time spent lexing.
+    pub lex_time: Duration,
+    /// The time spent recovering from errors.
+    pub recovery_time: Duration,
+    /// The total time spent parsing.
+    pub total_time: Duration,
+}
+
+/// A category of memory allocated by the core library, for
+/// [`allocation_stats`].
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash)]
+pub enum AllocationCategory {
+    /// Memory that doesn't belong to any of the other categories.
+    Other,
+    /// Syntax tree nodes and their arrays of children, including arena slabs.
+    SubtreePool,
+    /// The slabs of nodes in the parse stack.
+    StackNodes,
+    /// The lexer's included ranges.
+    IncludedRanges,
+    /// The in-progress and finished states of query cursors.
+    QueryCursorStates,
+    /// The capture lists of query cursors.
+    QueryCaptureLists,
+    /// Wasm stores and the languages loaded into them, not counting the
+    /// memory that the Wasm runtime allocates itself.
+    WasmStore,
+}
+
+impl AllocationCategory {
+    /// All of the categories, in the order that the C library numbers them.
+    pub const ALL: [Self; 7] = [
+        Self::Other,
+        Self::SubtreePool,
+        Self::StackNodes,
+        Self::IncludedRanges,
+        Self::QueryCursorStates,
+        Self::QueryCaptureLists,
+        Self::WasmStore,
+    ];
+}
+
+/// Statistics about the memory allocated by the core library.
+///
+/// These are only collected while tracking is enabled with
+/// [`set_allocation_tracking`].
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct AllocationStats {
+    /// The number of blocks allocated since tracking was enabled or the
+    /// statistics were last reset.
+    pub allocations: usize,
+    /// The number of blocks that are currently allocated.
+    pub live_allocations: usize,
+    /// The number of bytes that are currently allocated.
+    pub live_bytes: usize,
+    /// The highest number of bytes that were allocated at once.
+    pub peak_bytes: usize,
+}
+
+impl From<ffi::TSAllocationStats> for AllocationStats {
+    fn from(stats: ffi::TSAllocationStats) -> Self {
+        Self {
+            allocations: stats.allocation_count,
+            live_allocations: stats.live_allocation_count,
+            live_bytes: stats.live_bytes,
+            peak_bytes: stats.peak_bytes,
+        }
+    }
+}
+
+/// The memory used by a syntax tree.
+///
+/// See [`Tree::memory_usage`] and [`Tree::memory_usage_exact`].
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct MemoryReport {
+    /// The number of bytes that are used only by this tree, and are freed
+    /// when it is dropped.
+    pub exclusive_bytes: usize,
+    /// The number of bytes that are shared with other trees, such as the
+    /// tree's clones and the trees that it was incrementally parsed from.
+    pub shared_bytes: usize,
+    /// The number of bytes used by the long external scanner states that the
+    /// tree's tokens refer to. These are also included in the exclusive or
+    /// shared bytes.
+    pub scanner_state_bytes: usize,
+    /// The number of small leaf nodes that are stored inline in their
+    /// parent's array of children.
+    pub inline_nodes: usize,
+    /// The number of nodes that are allocated on the heap.
+    pub heap_nodes: usize,
+}
+
+impl From<ffi::TSMemoryReport> for MemoryReport {
+    fn from(report: ffi::TSMemoryReport) -> Self {
+        Self {
+            exclusive_bytes: report.exclusive_bytes,
+            shared_bytes: report.shared_bytes,
+            scanner_state_bytes: report.scanner_state_bytes,
+            inline_nodes: report.inline_node_count as usize,
+            heap_nodes: report.heap_node_count as usize,
+        }
+    }
+}
+
+/// The limits that a [`Parser`] places on its search for a valid parse of
+/// ambiguous or invalid input.
+///
+/// See [`Parser::set_config`].
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct ParserConfig {
+    /// The number of stack versions that are kept after each token.
+    pub max_version_count: usize,
+    /// The number of extra stack versions that may be created while
+    /// processing a single token.
+    pub max_version_count_overflow: usize,
+    /// The number of stack entries that are examined when searching for a
+    /// recovery from a syntax error.
+    pub max_summary_depth: usize,
+    /// The difference in error cost at which a stack version is discarded in
+    /// favor of a better one.
+    pub max_cost_difference: usize,
+    /// The number of consecutive tokens for which the number of stack
+    /// versions may stay at its limit before the limit is lowered, or zero
+    /// to never lower it.
+    pub adaptive_threshold: usize,
+    /// The value below which the limit on the number of stack versions is
+    /// never lowered.
+    pub adaptive_min_version_count: usize,
+    /// The amount of work that may be spent searching for recoveries from
+    /// syntax errors per byte of input, or zero for no limit. Beyond it,
+    /// the parser recovers by skipping tokens.
+    pub recovery_budget_per_byte: usize,
+}
+
+/// The progress of a parse, which is passed to the progress callback of
+/// [`ParseOptions`].
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct ParseState {
+    /// The byte offset that the parser has reached.
+    pub byte_offset: usize,
+    /// The number of parse actions that have been processed so far, including
+    /// those processed by earlier calls that were halted.
+    pub operation_count: u64,
+    /// Whether the parser has encountered a syntax error.
+    pub has_error: bool,
+}
+
+/// Options that allow a parse to be interleaved with other work.
+///
+/// See [`Parser::parse_with_options`].
+#[derive(Default)]
+pub struct ParseOptions<'a> {
+    /// A function that is called periodically during parsing. If it returns
+    /// `true`, the parse halts early.
+    pub progress_callback: Option<&'a mut dyn FnMut(&ParseState) -> bool>,
+    /// The number of bytes that the parser may advance over before halting
+    /// early, or zero for no limit.
+    pub byte_budget: usize,
+}
+
 /// A stateful object that is used to look up symbols valid in a specific parse
 /// state
 #[doc(alias = "TSLookaheadIterator")]
@@ -129,6 +345,60 @@ type Logger<'a> = Box<dyn FnMut(LogType, &str) + 'a>;
 #[doc(alias = "TSTreeCursor")]
 pub struct TreeCursor<'cursor>(ffi::TSTreeCursor, PhantomData<&'cursor ()>);
 
+/// Options that select the nodes that [`TreeCursor::walk_nodes`] returns.
+///
+/// The default options select every node.
+#[derive(Clone, Copy, Debug, Default)]
+pub struct TreeCursorWalkOptions<'a> {
+    /// A bitset of the symbols to include, where bit `i % 8` of byte `i / 8`
+    /// says whether to include nodes whose kind id is `i`, or `None` to
+    /// include every kind.
+    pub symbols: Option<&'a [u8]>,
+    /// The depth below which nodes are not visited, or zero for no limit.
+    pub max_depth: u32,
+    /// Whether to exclude anonymous nodes.
+    pub named_only: bool,
+}
+
+/// A node returned by [`TreeCursor::walk_nodes`].
+#[derive(Clone, Copy, Debug)]
+#[repr(C)]
+pub struct TreeCursorWalkEntry<'tree> {
+    /// The node.
+    pub node: Node<'tree>,
+    /// The id of the field that the node belongs to in its parent, if any.
+    pub field_id: Option<FieldId>,
+    /// The node's depth relative to the cursor's original node.
+    pub depth: u32,
+}
+
+/// A flat, read-only snapshot of a syntax [`Tree`], which stores its visible
+/// nodes in preorder for fast repeated scans.
+#[doc(alias = "TSFlatTree")]
+pub struct FlatTree(NonNull<ffi::TSFlatTree>);
+
+/// A cursor for walking a [`FlatTree`], whose movements take constant time.
+#[doc(alias = "TSFlatTreeCursor")]
+#[derive(Clone, Copy)]
+pub struct FlatTreeCursor<'tree>(ffi::TSFlatTreeCursor, PhantomData<&'tree ()>);
+
+/// The properties of a node in a [`FlatTree`].
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct FlatNode {
+    pub kind_id: u16,
+    pub field_id: Option<FieldId>,
+    pub range: Range,
+    pub is_named: bool,
+    pub is_extra: bool,
+    pub is_missing: bool,
+    pub has_error: bool,
+}
+
+/// A shared holder for the latest version of a syntax [`Tree`], which other
+/// threads can read while the tree is being edited and reparsed.
+#[doc(alias = "TSTreeSnapshot")]
+pub struct TreeSnapshot(NonNull<ffi::TSTreeSnapshot>);
+
 /// A set of patterns that match nodes in a syntax tree.
 #[doc(alias = "TSQuery")]
 #[derive(Debug)]
@@ -170,6 +440,17 @@ impl From<ffi::TSQuantifier> for CaptureQuantifier {
 #[doc(alias = "TSQueryCursor")]
 pub struct QueryCursor {
     ptr: NonNull<ffi::TSQueryCursor>,
+    buffers: *mut QueryTextBuffers,
+}
+
+/// The buffers in which a [`QueryCursor`] joins the chunks of a node's text, when a text
+/// predicate needs all of it at once. They are allocated on the heap the first time that
+/// they are needed, so that they stay in place when the cursor is moved, and are reused by
+/// every iterator that the cursor creates.
+#[derive(Default)]
+struct QueryTextBuffers {
+    predicate_text: Vec<u8>,
+    provider_text: Vec<u8>,
 }
 
 /// A key-value pair associated with a particular pattern in a [`Query`].
@@ -204,20 +485,18 @@ pub struct QueryMatch<'cursor, 'tree> {
 /// A sequence of [`QueryMatch`]es associated with a given [`QueryCursor`].
 pub struct QueryMatches<'query, 'cursor, T: TextProvider<I>, I: AsRef<[u8]>> {
     ptr: *mut ffi::TSQueryCursor,
+    buffers: *mut QueryTextBuffers,
     query: &'query Query,
     text_provider: T,
-    buffer1: Vec<u8>,
-    buffer2: Vec<u8>,
     _phantom: PhantomData<(&'cursor (), I)>,
 }
 
 /// A sequence of [`QueryCapture`]s associated with a given [`QueryCursor`].
 pub struct QueryCaptures<'query, 'cursor, T: TextProvider<I>, I: AsRef<[u8]>> {
     ptr: *mut ffi::TSQueryCursor,
+    buffers: *mut QueryTextBuffers,
     query: &'query Query,
     text_provider: T,
-    buffer1: Vec<u8>,
-    buffer2: Vec<u8>,
     _phantom: PhantomData<(&'cursor (), I)>,
 }
 
@@ -245,10 +524,26 @@ pub struct LanguageError {
     version: usize,
 }
 
-/// An error that occurred in [`Parser::set_included_ranges`].
+/// An error that occurred in [`Parser::set_included_ranges`] or
+/// [`QueryCursor::set_byte_ranges`]. It holds the index of the first range
+/// that is out of order.
 #[derive(Debug, PartialEq, Eq)]
 pub struct IncludedRangesError(pub usize);
 
+/// An error that occurred when loading a [`Language`] from a language data
+/// file, in [`Language::load_file`] or [`Language::load_data`].
+#[derive(Debug, PartialEq, Eq)]
+pub enum LanguageLoadError {
+    IO,
+    Format,
+    Version,
+    Scanner,
+}
+
+/// An error that occurred in [`Parser::set_config`].
+#[derive(Debug, PartialEq, Eq)]
+pub struct ParserConfigError;
+
 /// An error that occurred when trying to create a [`Query`].
 #[derive(Debug, PartialEq, Eq)]
 pub struct QueryError {
@@ -296,6 +591,73 @@ impl Language {
         Self(unsafe { builder.into_raw()().cast() })
     }
 
+    /// Load a language from a language data file, which is written by
+    /// `tree-sitter generate --emit-language-data`. The file is mapped into
+    /// memory, so loading the language does not require compiling its parser.
+    ///
+    /// For a grammar with an external scanner, pass the scanner's functions,
+    /// which must be compiled natively. Otherwise, pass `None`.
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if the file cannot be read, if it is not a valid
+    /// language data file, if its version is incompatible, or if the grammar
+    /// needs an external scanner that was not given. The path must be valid
+    /// UTF-8.
+    ///
+    /// # Safety
+    ///
+    /// The contents of the file's tables are trusted, just as the code of a
+    /// compiled parser is, so the file must come from a trusted source. The
+    /// scanner must be the one that was written for the file's grammar.
+    #[doc(alias = "ts_language_load_mmap")]
+    #[cfg(feature = "std")]
+    pub unsafe fn load_file(
+        path: impl AsRef<std::path::Path>,
+        scanner: Option<&ffi::TSExternalScanner>,
+    ) -> Result<Self, LanguageLoadError> {
+        let path = path
+            .as_ref()
+            .to_str()
+            .and_then(|path| std::ffi::CString::new(path).ok())
+            .ok_or(LanguageLoadError::IO)?;
+        let mut error = ffi::TSLanguageLoadErrorNone;
+        let language = ffi::ts_language_load_mmap(
+            path.as_ptr(),
+            scanner.map_or(ptr::null(), |scanner| scanner),
+            &mut error,
+        );
+        LanguageLoadError::check(language, error)
+    }
+
+    /// Load a language from the contents of a language data file, like
+    /// [`Language::load_file`]. The data is copied, so it does not need to
+    /// outlive the language.
+    ///
+    /// # Errors
+    ///
+    /// Returns an error if the data is not a valid language data file, if its
+    /// version is incompatible, or if the grammar needs an external scanner
+    /// that was not given.
+    ///
+    /// # Safety
+    ///
+    /// The same requirements apply as for [`Language::load_file`].
+    #[doc(alias = "ts_language_load_data")]
+    pub unsafe fn load_data(
+        data: &[u8],
+        scanner: Option<&ffi::TSExternalScanner>,
+    ) -> Result<Self, LanguageLoadError> {
+        let mut error = ffi::TSLanguageLoadErrorNone;
+        let language = ffi::ts_language_load_data(
+            data.as_ptr().cast::<c_void>(),
+            data.len(),
+            scanner.map_or(ptr::null(), |scanner| scanner),
+            &mut error,
+        );
+        LanguageLoadError::check(language, error)
+    }
+
     /// Get the ABI version number that indicates which version of the
     /// Tree-sitter CLI that was used to generate this [`Language`].
     #[doc(alias = "ts_language_version")]
@@ -593,11 +955,16 @@ impl Parser {
     #[doc(alias = "ts_parser_parse")]
     pub fn parse(&mut self, text: impl AsRef<[u8]>, old_tree: Option<&Tree>) -> Option<Tree> {
         let bytes = text.as_ref();
-        let len = bytes.len();
-        self.parse_with(
-            &mut |i, _| (i < len).then(|| &bytes[i..]).unwrap_or_default(),
-            old_tree,
-        )
+        let c_old_tree = old_tree.map_or(ptr::null_mut(), |t| t.0.as_ptr());
+        unsafe {
+            let c_new_tree = ffi::ts_parser_parse_string(
+                self.0.as_ptr(),
+                c_old_tree,
+                bytes.as_ptr().cast::<c_char>(),
+                bytes.len() as u32,
+            );
+            NonNull::new(c_new_tree).map(Tree)
+        }
     }
 
     /// Parse a slice of UTF16 text.
@@ -613,11 +980,47 @@ impl Parser {
         old_tree: Option<&Tree>,
     ) -> Option<Tree> {
         let code_points = input.as_ref();
-        let len = code_points.len();
-        self.parse_utf16_with(
-            &mut |i, _| (i < len).then(|| &code_points[i..]).unwrap_or_default(),
-            old_tree,
-        )
+        let c_old_tree = old_tree.map_or(ptr::null_mut(), |t| t.0.as_ptr());
+        unsafe {
+            let c_new_tree = ffi::ts_parser_parse_string_encoding(
+                self.0.as_ptr(),
+                c_old_tree,
+                code_points.as_ptr().cast::<c_char>(),
+                code_points.len() as u32 * 2,
+                ffi::TSInputEncodingUTF16,
+            );
+            NonNull::new(c_new_tree).map(Tree)
+        }
+    }
+
+    /// Parse a slice of Latin1 text, in which each byte is one character.
+    ///
+    /// This can be used to parse ASCII text, or text in a single-byte encoding, without first
+    /// converting it to UTF8. Byte offsets in the resulting tree are offsets into `text`, but the
+    /// text of a node is not valid UTF8 if it contains characters outside of ASCII.
+    ///
+    /// # Arguments:
+    /// * `text` The Latin1-encoded text to parse.
+    /// * `old_tree` A previous syntax tree parsed from the same document. If the text of the
+    ///   document has changed since `old_tree` was created, then you must edit `old_tree` to match
+    ///   the new text using [`Tree::edit`].
+    pub fn parse_latin1(
+        &mut self,
+        text: impl AsRef<[u8]>,
+        old_tree: Option<&Tree>,
+    ) -> Option<Tree> {
+        let bytes = text.as_ref();
+        let c_old_tree = old_tree.map_or(ptr::null_mut(), |t| t.0.as_ptr());
+        unsafe {
+            let c_new_tree = ffi::ts_parser_parse_string_encoding(
+                self.0.as_ptr(),
+                c_old_tree,
+                bytes.as_ptr().cast::<c_char>(),
+                bytes.len() as u32,
+                ffi::TSInputEncodingLatin1,
+            );
+            NonNull::new(c_new_tree).map(Tree)
+        }
     }
 
     /// Parse UTF8 text provided in chunks by a callback.
@@ -724,6 +1127,223 @@ impl Parser {
         }
     }
 
+    /// Parse UTF8 text that is stored in several chunks, such as the leaves of a rope.
+    ///
+    /// Unlike [`Parser::parse_with`], this doesn't call back into Rust for each chunk of text.
+    /// The parser is given all of the chunks up front, and finds the text that it needs by
+    /// itself, which is faster when the chunks are small. The chunks are not copied. A chunk
+    /// should not end in the middle of a character.
+    ///
+    /// # Arguments:
+    /// * `chunks` The UTF8-encoded chunks of the text, in order.
+    /// * `old_tree` A previous syntax tree parsed from the same document. If the text of the
+    ///   document has changed since `old_tree` was created, then you must edit `old_tree` to match
+    ///   the new text using [`Tree::edit`].
+    ///
+    /// Returns `None` in the same cases as [`Parser::parse`], or if the text is longer than
+    /// `u32::MAX` bytes.
+    #[doc(alias = "ts_parser_parse_spans")]
+    pub fn parse_chunks<'a>(
+        &mut self,
+        chunks: impl IntoIterator<Item = &'a [u8]>,
+        old_tree: Option<&Tree>,
+    ) -> Option<Tree> {
+        let chunks = chunks
+            .into_iter()
+            .map(|chunk| (chunk.as_ptr().cast::<c_char>(), chunk.len()));
+        self.parse_spans(chunks, old_tree, ffi::TSInputEncodingUTF8)
+    }
+
+    /// Parse UTF16 text that is stored in several chunks, such as the leaves of a rope.
+    ///
+    /// This works the same as [`Parser::parse_chunks`]. A chunk should not end in the middle of
+    /// a surrogate pair.
+    ///
+    /// # Arguments:
+    /// * `chunks` The UTF16-encoded chunks of the text, in order.
+    /// * `old_tree` A previous syntax tree parsed from the same document. If the text of the
+    ///   document has changed since `old_tree` was created, then you must edit `old_tree` to match
+    ///   the new text using [`Tree::edit`].
+    #[doc(alias = "ts_parser_parse_spans")]
+    pub fn parse_utf16_chunks<'a>(
+        &mut self,
+        chunks: impl IntoIterator<Item = &'a [u16]>,
+        old_tree: Option<&Tree>,
+    ) -> Option<Tree> {
+        let chunks = chunks
+            .into_iter()
+            .map(|chunk| (chunk.as_ptr().cast::<c_char>(), chunk.len() * 2));
+        self.parse_spans(chunks, old_tree, ffi::TSInputEncodingUTF16)
+    }
+
+    fn parse_spans(
+        &mut self,
+        chunks: impl Iterator<Item = (*const c_char, usize)>,
+        old_tree: Option<&Tree>,
+        encoding: ffi::TSInputEncoding,
+    ) -> Option<Tree> {
+        let mut spans = Vec::with_capacity(chunks.size_hint().0);
+        let mut byte_offset = 0_u32;
+        for (bytes, length) in chunks {
+            let length = u32::try_from(length).ok()?;
+            spans.push(ffi::TSInputSpan {
+                byte_offset,
+                bytes,
+                length,
+            });
+            byte_offset = byte_offset.checked_add(length)?;
+        }
+
+        let c_old_tree = old_tree.map_or(ptr::null_mut(), |t| t.0.as_ptr());
+        unsafe {
+            let c_new_tree = ffi::ts_parser_parse_spans(
+                self.0.as_ptr(),
+                c_old_tree,
+                spans.as_ptr(),
+                spans.len() as u32,
+                encoding,
+            );
+            NonNull::new(c_new_tree).map(Tree)
+        }
+    }
+
+    /// Parse UTF8 text provided in chunks by a callback, passing each of the root node's
+    /// children to another callback as soon as it has been parsed, instead of keeping the whole
+    /// syntax tree in memory.
+    ///
+    /// The returned tree only contains the top-level nodes that were not passed to
+    /// `node_callback`. A syntax error can prevent a top-level node from being streamed, and a
+    /// node that has already been streamed will not be included in an `ERROR` node because of a
+    /// later syntax error.
+    ///
+    /// # Arguments:
+    /// * `callback` A function that takes a byte offset and position and returns a slice of
+    ///   UTF8-encoded text starting at that byte offset and position. The slices can be of any
+    ///   length. If the given position is at the end of the text, the callback should return an
+    ///   empty slice.
+    /// * `node_callback` A function that is called with each top-level node once it has been
+    ///   parsed. The node's tree is deleted when the function returns.
+    #[doc(alias = "ts_parser_parse_streaming")]
+    pub fn parse_streaming_with<T: AsRef<[u8]>, F: FnMut(usize, Point) -> T, G: FnMut(Node)>(
+        &mut self,
+        callback: &mut F,
+        node_callback: &mut G,
+    ) -> Option<Tree> {
+        // A pointer to this payload is passed on every call to the `read` C function.
+        // See `parse_with` for why the text is stored in it.
+        let mut payload: (&mut F, Option<T>) = (callback, None);
+
+        unsafe extern "C" fn read<T: AsRef<[u8]>, F: FnMut(usize, Point) -> T>(
+            payload: *mut c_void,
+            byte_offset: u32,
+            position: ffi::TSPoint,
+            bytes_read: *mut u32,
+        ) -> *const c_char {
+            let (callback, text) = payload.cast::<(&mut F, Option<T>)>().as_mut().unwrap();
+            *text = Some(callback(byte_offset as usize, position.into()));
+            let slice = text.as_ref().unwrap().as_ref();
+            *bytes_read = slice.len() as u32;
+            slice.as_ptr().cast::<c_char>()
+        }
+
+        unsafe extern "C" fn emit<G: FnMut(Node)>(payload: *mut c_void, node: ffi::TSNode) {
+            let callback = payload.cast::<G>().as_mut().unwrap();
+            callback(Node::new(node).unwrap());
+        }
+
+        let c_input = ffi::TSInput {
+            payload: core::ptr::addr_of_mut!(payload).cast::<c_void>(),
+            read: Some(read::<T, F>),
+            encoding: ffi::TSInputEncodingUTF8,
+        };
+        let c_callback = ffi::TSStreamCallback {
+            payload: (node_callback as *mut G).cast::<c_void>(),
+            emit: Some(emit::<G>),
+        };
+
+        unsafe {
+            let c_new_tree = ffi::ts_parser_parse_streaming(self.0.as_ptr(), c_input, c_callback);
+            NonNull::new(c_new_tree).map(Tree)
+        }
+    }
+
+    /// Parse UTF8 text provided in chunks by a callback, with options that allow the parse to be
+    /// interleaved with other work.
+    ///
+    /// Returns `None` if the parse was halted early by the options' progress callback or byte
+    /// budget, in addition to the reasons listed in [`Parser::parse`]. The parse can then be
+    /// resumed by calling this method again, with the same or different options.
+    ///
+    /// # Arguments:
+    /// * `callback` A function that takes a byte offset and position and returns a slice of
+    ///   UTF8-encoded text starting at that byte offset and position. The slices can be of any
+    ///   length. If the given position is at the end of the text, the callback should return an
+    ///   empty slice.
+    /// * `old_tree` A previous syntax tree parsed from the same document. If the text of the
+    ///   document has changed since `old_tree` was created, then you must edit `old_tree` to match
+    ///   the new text using [`Tree::edit`].
+    /// * `options` The progress callback and byte budget of the parse.
+    #[doc(alias = "ts_parser_parse_with_options")]
+    pub fn parse_with_options<T: AsRef<[u8]>, F: FnMut(usize, Point) -> T>(
+        &mut self,
+        callback: &mut F,
+        old_tree: Option<&Tree>,
+        options: ParseOptions,
+    ) -> Option<Tree> {
+        type ProgressCallback<'a> = Option<&'a mut dyn FnMut(&ParseState) -> bool>;
+
+        // A pointer to this payload is passed on every call to the `read` C function.
+        // See `parse_with` for why the text is stored in it.
+        let mut payload: (&mut F, Option<T>) = (callback, None);
+
+        unsafe extern "C" fn read<T: AsRef<[u8]>, F: FnMut(usize, Point) -> T>(
+            payload: *mut c_void,
+            byte_offset: u32,
+            position: ffi::TSPoint,
+            bytes_read: *mut u32,
+        ) -> *const c_char {
+            let (callback, text) = payload.cast::<(&mut F, Option<T>)>().as_mut().unwrap();
+            *text = Some(callback(byte_offset as usize, position.into()));
+            let slice = text.as_ref().unwrap().as_ref();
+            *bytes_read = slice.len() as u32;
+            slice.as_ptr().cast::<c_char>()
+        }
+
+        unsafe extern "C" fn progress(state: *mut ffi::TSParseState) -> bool {
+            let state = state.as_ref().unwrap();
+            let callback = state.payload.cast::<ProgressCallback>().as_mut().unwrap();
+            callback.as_mut().unwrap()(&ParseState {
+                byte_offset: state.current_byte_offset as usize,
+                operation_count: state.operation_count,
+                has_error: state.has_error,
+            })
+        }
+
+        let c_input = ffi::TSInput {
+            payload: core::ptr::addr_of_mut!(payload).cast::<c_void>(),
+            read: Some(read::<T, F>),
+            encoding: ffi::TSInputEncodingUTF8,
+        };
+
+        let mut progress_callback: ProgressCallback = options.progress_callback;
+        let c_options = ffi::TSParseOptions {
+            payload: core::ptr::addr_of_mut!(progress_callback).cast::<c_void>(),
+            progress_callback: if progress_callback.is_some() {
+                Some(progress)
+            } else {
+                None
+            },
+            byte_budget: options.byte_budget.min(u32::MAX as usize) as u32,
+        };
+
+        let c_old_tree = old_tree.map_or(ptr::null_mut(), |t| t.0.as_ptr());
+        unsafe {
+            let c_new_tree =
+                ffi::ts_parser_parse_with_options(self.0.as_ptr(), c_old_tree, c_input, c_options);
+            NonNull::new(c_new_tree).map(Tree)
+        }
+    }
+
     /// Instruct the parser to start the next parse from the beginning.
     ///
     /// If the parser previously failed because of a timeout or a cancellation,
@@ -755,29 +1375,265 @@ impl Parser {
         unsafe { ffi::ts_parser_set_timeout_micros(self.0.as_ptr(), timeout_micros) }
     }
 
+    /// Get whether the parser allocates the nodes of new syntax trees from an
+    /// arena.
+    ///
+    /// This is set via [`set_arena_enabled`](Parser::set_arena_enabled).
+    #[doc(alias = "ts_parser_arena_enabled")]
+    #[must_use]
+    pub fn arena_enabled(&self) -> bool {
+        unsafe { ffi::ts_parser_arena_enabled(self.0.as_ptr()) }
+    }
+
+    /// Set whether the parser should allocate the nodes of each new syntax
+    /// tree from an arena.
+    ///
+    /// Arena-allocated trees are built from large slabs of memory and are
+    /// freed all at once when the last [`Tree`] using them is dropped. Trees
+    /// produced by incrementally re-parsing an arena-allocated tree keep the
+    /// old tree's arena alive, so a long chain of edits may retain memory from
+    /// earlier versions of the document until it is parsed from scratch.
+    ///
+    /// The setting takes effect at the start of the next parse.
+    #[doc(alias = "ts_parser_set_arena_enabled")]
+    pub fn set_arena_enabled(&mut self, enabled: bool) {
+        unsafe { ffi::ts_parser_set_arena_enabled(self.0.as_ptr(), enabled) }
+    }
+
+    /// Get whether the parser builds an index of its language's parse table.
+    ///
+    /// This is set via [`set_lookup_index_enabled`](Parser::set_lookup_index_enabled).
+    #[doc(alias = "ts_parser_lookup_index_enabled")]
+    #[must_use]
+    pub fn lookup_index_enabled(&self) -> bool {
+        unsafe { ffi::ts_parser_lookup_index_enabled(self.0.as_ptr()) }
+    }
+
+    /// Set whether the parser should build an index of its language's parse
+    /// table, so that looking up parse actions takes constant time.
+    ///
+    /// The index is built whenever a language is assigned, and uses memory
+    /// proportional to the number of parse states times the number of symbols
+    /// in the grammar.
+    #[doc(alias = "ts_parser_set_lookup_index_enabled")]
+    pub fn set_lookup_index_enabled(&mut self, enabled: bool) {
+        unsafe { ffi::ts_parser_set_lookup_index_enabled(self.0.as_ptr(), enabled) }
+    }
+
+    /// Get the number of chunks of text that the parser remembers from the
+    /// callbacks passed to [`parse_with`](Parser::parse_with) and
+    /// [`parse_utf16_with`](Parser::parse_utf16_with).
+    ///
+    /// This is set via [`set_chunk_cache_size`](Parser::set_chunk_cache_size).
+    #[doc(alias = "ts_parser_chunk_cache_size")]
+    #[must_use]
+    pub fn chunk_cache_size(&self) -> usize {
+        unsafe { ffi::ts_parser_chunk_cache_size(self.0.as_ptr()) as usize }
+    }
+
+    /// Set the number of chunks of text that the parser remembers from the
+    /// callbacks passed to [`parse_with`](Parser::parse_with) and
+    /// [`parse_utf16_with`](Parser::parse_utf16_with), so that it does not
+    /// need to call the callback again when it moves back to an earlier
+    /// position within one of them.
+    ///
+    /// This has no effect on [`parse`](Parser::parse), which reads directly
+    /// from the given text.
+    ///
+    /// # Safety
+    ///
+    /// When the size is non-zero, every slice returned by a callback must
+    /// remain valid until the parse finishes. This is true of slices borrowed
+    /// from a buffer that outlives the call to `parse_with`, but not of owned
+    /// values like vectors, which are dropped on the next call to the
+    /// callback.
+    #[doc(alias = "ts_parser_set_chunk_cache_size")]
+    pub unsafe fn set_chunk_cache_size(&mut self, size: usize) {
+        ffi::ts_parser_set_chunk_cache_size(self.0.as_ptr(), size as u32);
+    }
+
+    /// Get the limits that the parser places on its search for a valid parse.
+    ///
+    /// This is set via [`set_config`](Parser::set_config).
+    #[doc(alias = "ts_parser_config")]
+    #[must_use]
+    pub fn config(&self) -> ParserConfig {
+        let config = unsafe { ffi::ts_parser_config(self.0.as_ptr()) };
+        ParserConfig {
+            max_version_count: config.max_version_count as usize,
+            max_version_count_overflow: config.max_version_count_overflow as usize,
+            max_summary_depth: config.max_summary_depth as usize,
+            max_cost_difference: config.max_cost_difference as usize,
+            adaptive_threshold: config.adaptive_threshold as usize,
+            adaptive_min_version_count: config.adaptive_min_version_count as usize,
+            recovery_budget_per_byte: config.recovery_budget_per_byte as usize,
+        }
+    }
+
+    /// Set the limits that the parser places on its search for a valid parse,
+    /// or restore the defaults by passing `None`.
+    ///
+    /// Lower limits bound the time spent parsing ambiguous or malformed
+    /// input, at the cost of less precise error recovery. When
+    /// `adaptive_threshold` is non-zero, the parser lowers its limit on the
+    /// number of stack versions during a parse whenever that limit is
+    /// reached for more than `adaptive_threshold` consecutive tokens. When
+    /// `recovery_budget_per_byte` is non-zero, the work spent on error
+    /// recovery grows at most linearly with the length of the input.
+    ///
+    /// Returns a [`ParserConfigError`] if `max_version_count` is zero, if the
+    /// sum of `max_version_count` and `max_version_count_overflow` overflows a
+    /// `u32`, or if adaptive mode is enabled and `adaptive_min_version_count`
+    /// is zero or greater than `max_version_count`. Limits that don't fit in a
+    /// `u32` are also rejected.
+    #[doc(alias = "ts_parser_set_config")]
+    pub fn set_config(&mut self, config: Option<&ParserConfig>) -> Result<(), ParserConfigError> {
+        let limit = |value: usize| u32::try_from(value).map_err(|_| ParserConfigError);
+        let config = config
+            .map(|config| {
+                Ok(ffi::TSParserConfig {
+                    max_version_count: limit(config.max_version_count)?,
+                    max_version_count_overflow: limit(config.max_version_count_overflow)?,
+                    max_summary_depth: limit(config.max_summary_depth)?,
+                    max_cost_difference: limit(config.max_cost_difference)?,
+                    adaptive_threshold: limit(config.adaptive_threshold)?,
+                    adaptive_min_version_count: limit(config.adaptive_min_version_count)?,
+                    recovery_budget_per_byte: limit(config.recovery_budget_per_byte)?,
+                })
+            })
+            .transpose()?;
+        let config_ptr = config
+            .as_ref()
+            .map_or(ptr::null(), |config| config as *const _);
+        if unsafe { ffi::ts_parser_set_config(self.0.as_ptr(), config_ptr) } {
+            Ok(())
+        } else {
+            Err(ParserConfigError)
+        }
+    }
+
+    /// Get whether the parser collects statistics about its parses.
+    ///
+    /// This is set via [`set_stats_enabled`](Parser::set_stats_enabled).
+    #[doc(alias = "ts_parser_stats_enabled")]
+    #[must_use]
+    pub fn stats_enabled(&self) -> bool {
+        unsafe { ffi::ts_parser_stats_enabled(self.0.as_ptr()) }
+    }
+
+    /// Set whether the parser should collect statistics about its parses.
+    ///
+    /// The statistics are cleared at the start of each new parse, and can be
+    /// retrieved with [`stats`](Parser::stats) once it finishes. A parse that
+    /// is halted and then resumed accumulates statistics across both calls.
+    #[doc(alias = "ts_parser_set_stats_enabled")]
+    pub fn set_stats_enabled(&mut self, enabled: bool) {
+        unsafe { ffi::ts_parser_set_stats_enabled(self.0.as_ptr(), enabled) }
+    }
+
+    /// Get the statistics collected during the parser's most recent parse.
+    #[doc(alias = "ts_parser_stats")]
+    #[must_use]
+    pub fn stats(&self) -> ParserStats {
+        let stats = unsafe { ffi::ts_parser_stats(self.0.as_ptr()) };
+        ParserStats {
+            lexed_tokens: stats.lexed_token_count as usize,
+            heap_tokens: stats.heap_token_count as usize,
+            cached_tokens: stats.cached_token_count as usize,
+            token_cache_misses: stats.token_cache_miss_count as usize,
+            reused_nodes: stats.reused_node_count as usize,
+            reuse_misses: stats.reuse_miss_count as usize,
+            version_splits: stats.version_split_count as usize,
+            version_merges: stats.version_merge_count as usize,
+            recoveries: stats.recovery_count as usize,
+            bounded_recoveries: stats.bounded_recovery_count as usize,
+            operations: stats.operation_count,
+            lex_time: Duration::from_micros(stats.lex_time_micros),
+            recovery_time: Duration::from_micros(stats.recovery_time_micros),
+            total_time: Duration::from_micros(stats.total_time_micros),
+        }
+    }
+
     /// Set the ranges of text that the parser should include when parsing.
     ///
-    /// By default, the parser will always include entire documents. This
-    /// function allows you to parse only a *portion* of a document but
-    /// still return a syntax tree whose ranges match up with the document
-    /// as a whole. You can also pass multiple disjoint ranges.
+    /// By default, the parser will always include entire documents. This
+    /// function allows you to parse only a *portion* of a document but
+    /// still return a syntax tree whose ranges match up with the document
+    /// as a whole. You can also pass multiple disjoint ranges.
+    ///
+    /// If `ranges` is empty, then the entire document will be parsed.
+    /// Otherwise, the given ranges must be ordered from earliest to latest
+    /// in the document, and they must not overlap. That is, the following
+    /// must hold for all `i` < `length - 1`:
+    /// ```text
+    ///     ranges[i].end_byte <= ranges[i + 1].start_byte
+    /// ```
+    /// If this requirement is not satisfied, method will return
+    /// [`IncludedRangesError`] error with an offset in the passed ranges
+    /// slice pointing to a first incorrect range.
+    #[doc(alias = "ts_parser_set_included_ranges")]
+    pub fn set_included_ranges(&mut self, ranges: &[Range]) -> Result<(), IncludedRangesError> {
+        let ts_ranges = ranges.iter().copied().map(Into::into).collect::<Vec<_>>();
+        let result = unsafe {
+            ffi::ts_parser_set_included_ranges(
+                self.0.as_ptr(),
+                ts_ranges.as_ptr(),
+                ts_ranges.len() as u32,
+            )
+        };
+
+        if result {
+            Ok(())
+        } else {
+            let mut prev_end_byte = 0;
+            for (i, range) in ranges.iter().enumerate() {
+                if range.start_byte < prev_end_byte || range.end_byte < range.start_byte {
+                    return Err(IncludedRangesError(i));
+                }
+                prev_end_byte = range.end_byte;
+            }
+            Err(IncludedRangesError(0))
+        }
+    }
+
+    /// Replace some of the ranges of text that the parser should include
+    /// when parsing, without copying the rest of them.
+    ///
+    /// The ranges at the given `indices` are replaced with `ranges`. The
+    /// resulting ranges must satisfy the same requirements as those passed
+    /// to [`Parser::set_included_ranges`]. If they don't, this method will
+    /// return an [`IncludedRangesError`] with an offset in the passed ranges
+    /// slice pointing to the first incorrect range, or to the end of the
+    /// slice if the parser's next range is incorrect.
+    ///
+    /// # Panics
     ///
-    /// If `ranges` is empty, then the entire document will be parsed.
-    /// Otherwise, the given ranges must be ordered from earliest to latest
-    /// in the document, and they must not overlap. That is, the following
-    /// must hold for all `i` < `length - 1`:
-    /// ```text
-    ///     ranges[i].end_byte <= ranges[i + 1].start_byte
-    /// ```
-    /// If this requirement is not satisfied, method will return
-    /// [`IncludedRangesError`] error with an offset in the passed ranges
-    /// slice pointing to a first incorrect range.
-    #[doc(alias = "ts_parser_set_included_ranges")]
-    pub fn set_included_ranges(&mut self, ranges: &[Range]) -> Result<(), IncludedRangesError> {
+    /// Panics if `indices` extends past the end of the parser's ranges.
+    #[doc(alias = "ts_parser_splice_included_ranges")]
+    pub fn splice_included_ranges(
+        &mut self,
+        indices: ops::Range<usize>,
+        ranges: &[Range],
+    ) -> Result<(), IncludedRangesError> {
+        // Borrow the parser's ranges instead of copying them. They are only
+        // read if the splice fails, in which case they haven't been changed.
+        let mut count = 0u32;
+        let current = unsafe {
+            let ptr =
+                ffi::ts_parser_included_ranges(self.0.as_ptr(), core::ptr::addr_of_mut!(count));
+            slice::from_raw_parts(ptr, count as usize)
+        };
+        assert!(
+            indices.start <= indices.end && indices.end <= current.len(),
+            "included range indices {indices:?} are out of bounds"
+        );
+
         let ts_ranges = ranges.iter().copied().map(Into::into).collect::<Vec<_>>();
         let result = unsafe {
-            ffi::ts_parser_set_included_ranges(
+            ffi::ts_parser_splice_included_ranges(
                 self.0.as_ptr(),
+                indices.start as u32,
+                indices.len() as u32,
                 ts_ranges.as_ptr(),
                 ts_ranges.len() as u32,
             )
@@ -786,17 +1642,33 @@ impl Parser {
         if result {
             Ok(())
         } else {
-            let mut prev_end_byte = 0;
+            let mut prev_end_byte = indices
+                .start
+                .checked_sub(1)
+                .map_or(0, |i| current[i].end_byte as usize);
             for (i, range) in ranges.iter().enumerate() {
                 if range.start_byte < prev_end_byte || range.end_byte < range.start_byte {
                     return Err(IncludedRangesError(i));
                 }
                 prev_end_byte = range.end_byte;
             }
-            Err(IncludedRangesError(0))
+            Err(IncludedRangesError(ranges.len()))
         }
     }
 
+    /// Edit the ranges of text that the parser will include when parsing,
+    /// to keep them in sync with source code that has been edited.
+    ///
+    /// The ranges are adjusted in the same way as [`Tree::edit`] adjusts the
+    /// old tree's ranges, so when both are edited with the same edits, no
+    /// part of the document is reparsed just because the ranges were set
+    /// anew.
+    #[doc(alias = "ts_parser_edit_included_ranges")]
+    pub fn edit_included_ranges(&mut self, edit: &InputEdit) {
+        let edit = edit.into();
+        unsafe { ffi::ts_parser_edit_included_ranges(self.0.as_ptr(), &edit) };
+    }
+
     /// Get the ranges of text that the parser will include when parsing.
     #[doc(alias = "ts_parser_included_ranges")]
     #[must_use]
@@ -855,6 +1727,78 @@ impl Drop for Parser {
     }
 }
 
+#[cfg(feature = "std")]
+impl ParserPool {
+    /// Create a pool of `thread_count` parsers that all use the given
+    /// language.
+    pub fn new(language: &Language, thread_count: usize) -> Result<Self, LanguageError> {
+        let parsers = (0..thread_count.max(1))
+            .map(|_| {
+                let mut parser = Parser::new();
+                parser.set_language(language)?;
+                Ok(parser)
+            })
+            .collect::<Result<_, _>>()?;
+        Ok(Self { parsers })
+    }
+
+    /// Get the pool's parsers, in order to configure them.
+    pub fn parsers_mut(&mut self) -> &mut [Parser] {
+        &mut self.parsers
+    }
+
+    /// Parse each of the given documents, returning the results in the same
+    /// order as the documents.
+    ///
+    /// Each thread takes the next document as soon as it has finished the
+    /// previous one, so documents of very different sizes are spread evenly
+    /// across the threads. Each parser is reused for all of the documents that
+    /// its thread parses, so its internal buffers are only allocated once.
+    pub fn parse_many<T: AsRef<[u8]> + Sync>(&mut self, documents: &[T]) -> Vec<BatchParseResult> {
+        let next_index = AtomicUsize::new(0);
+        let mut results = std::thread::scope(|scope| {
+            let handles = self
+                .parsers
+                .iter_mut()
+                .take(documents.len())
+                .map(|parser| {
+                    let next_index = &next_index;
+                    scope.spawn(move || {
+                        let mut results = Vec::new();
+                        loop {
+                            let index =
+                                next_index.fetch_add(1, core::sync::atomic::Ordering::Relaxed);
+                            let Some(document) = documents.get(index) else {
+                                break;
+                            };
+                            let start = std::time::Instant::now();
+                            let tree = parser.parse(document, None);
+                            let duration = start.elapsed();
+
+                            // Don't resume a halted parse with the next document.
+                            if tree.is_none() {
+                                parser.reset();
+                            }
+                            results.push((index, BatchParseResult { tree, duration }));
+                        }
+                        results
+                    })
+                })
+                .collect::<Vec<_>>();
+            handles
+                .into_iter()
+                .flat_map(|handle| {
+                    handle
+                        .join()
+                        .unwrap_or_else(|e| std::panic::resume_unwind(e))
+                })
+                .collect::<Vec<_>>()
+        });
+        results.sort_unstable_by_key(|(index, _)| *index);
+        results.into_iter().map(|(_, result)| result).collect()
+    }
+}
+
 impl Tree {
     /// Get the root node of the syntax tree.
     #[doc(alias = "ts_tree_root_node")]
@@ -878,6 +1822,94 @@ impl Tree {
         .unwrap()
     }
 
+    /// Build an index of the children of the nodes in this tree that have
+    /// many children.
+    ///
+    /// With an index, [`Node::child`] and [`Node::named_child`] take constant
+    /// time for wide nodes, and finding a node's siblings no longer requires
+    /// searching its parent's children. The index is shared with the tree's
+    /// clones, and discarded by [`Tree::edit`].
+    #[doc(alias = "ts_tree_build_child_index")]
+    pub fn build_child_index(&mut self) {
+        unsafe { ffi::ts_tree_build_child_index(self.0.as_ptr()) }
+    }
+
+    /// Build an index of the parents of the nodes in this tree.
+    ///
+    /// With an index, [`Node::parent`] takes constant time instead of time
+    /// proportional to the node's depth. The index is shared with the tree's
+    /// clones, and discarded by [`Tree::edit`].
+    #[doc(alias = "ts_tree_build_parent_index")]
+    pub fn build_parent_index(&mut self) {
+        unsafe { ffi::ts_tree_build_parent_index(self.0.as_ptr()) }
+    }
+
+    /// Move all of this tree's nodes into one new block of memory, in the
+    /// order in which they are visited, and rebalance its repetitions.
+    ///
+    /// This is useful for a tree that has been edited and reparsed many times,
+    /// because it makes walking the tree as fast as walking a freshly parsed
+    /// one, and lets the memory of the earlier versions be freed. Like
+    /// [`Tree::edit`], this discards the tree's child and parent indices.
+    #[doc(alias = "ts_tree_compact")]
+    pub fn compact(&mut self) {
+        unsafe { ffi::ts_tree_compact(self.0.as_ptr()) }
+    }
+
+    /// Get the number of bytes of memory used by this tree's child index and
+    /// parent index.
+    #[doc(alias = "ts_tree_index_size")]
+    #[must_use]
+    pub fn index_size(&self) -> usize {
+        unsafe { ffi::ts_tree_index_size(self.0.as_ptr()) }
+    }
+
+    /// Estimate the memory used by this tree, in constant time.
+    ///
+    /// The node counts are exact, but all of the nodes' bytes are counted as
+    /// shared if the tree has been cloned, and as exclusive otherwise, and the
+    /// external scanner states are not counted. Use
+    /// [`memory_usage_exact`](Tree::memory_usage_exact) to tell which nodes
+    /// are shared with other trees.
+    #[doc(alias = "ts_tree_memory_usage")]
+    #[must_use]
+    pub fn memory_usage(&self) -> MemoryReport {
+        let mut report = MaybeUninit::<ffi::TSMemoryReport>::uninit();
+        unsafe {
+            ffi::ts_tree_memory_usage(self.0.as_ptr(), report.as_mut_ptr());
+            report.assume_init()
+        }
+        .into()
+    }
+
+    /// Measure the memory used by this tree, by visiting all of its nodes.
+    ///
+    /// This splits the bytes exactly into the memory that would be freed by
+    /// dropping this tree, and the memory that it shares with other trees.
+    /// It takes time proportional to the size of the tree.
+    #[doc(alias = "ts_tree_memory_usage_exact")]
+    #[must_use]
+    pub fn memory_usage_exact(&self) -> MemoryReport {
+        let mut report = MaybeUninit::<ffi::TSMemoryReport>::uninit();
+        unsafe {
+            ffi::ts_tree_memory_usage_exact(self.0.as_ptr(), report.as_mut_ptr());
+            report.assume_init()
+        }
+        .into()
+    }
+
+    /// Create a flat, read-only snapshot of this tree.
+    ///
+    /// The snapshot stores the tree's visible nodes in preorder, with each of
+    /// their properties in a separate contiguous array, so scanning the whole
+    /// tree repeatedly is much faster than with a [`TreeCursor`]. It remains
+    /// valid after this tree is edited or dropped.
+    #[doc(alias = "ts_tree_flatten")]
+    #[must_use]
+    pub fn flatten(&self) -> FlatTree {
+        FlatTree(unsafe { NonNull::new_unchecked(ffi::ts_tree_flatten(self.0.as_ptr())) })
+    }
+
     /// Get the language that was used to parse the syntax tree.
     #[doc(alias = "ts_tree_language")]
     #[must_use]
@@ -928,6 +1960,30 @@ impl Tree {
         }
     }
 
+    /// Compare this old edited syntax tree to a new syntax tree representing
+    /// the same document, returning the nodes of the new tree whose syntactic
+    /// structure has changed.
+    ///
+    /// For each range returned by [`changed_ranges`](Tree::changed_ranges),
+    /// this returns the smallest node of the new tree that contains the range,
+    /// omitting any node that is contained by another returned node.
+    #[doc(alias = "ts_tree_get_changed_nodes")]
+    #[must_use]
+    pub fn changed_nodes<'tree>(
+        &self,
+        other: &'tree Self,
+    ) -> impl ExactSizeIterator<Item = Node<'tree>> {
+        let mut count = 0u32;
+        unsafe {
+            let ptr = ffi::ts_tree_get_changed_nodes(
+                self.0.as_ptr(),
+                other.0.as_ptr(),
+                core::ptr::addr_of_mut!(count),
+            );
+            util::CBufferIter::new(ptr, count as usize).map(|node| Node::new(node).unwrap())
+        }
+    }
+
     /// Get the included ranges that were used to parse the syntax tree.
     #[doc(alias = "ts_tree_included_ranges")]
     #[must_use]
@@ -942,6 +1998,41 @@ impl Tree {
         }
     }
 
+    /// Serialize the syntax tree into a compact binary buffer, which can be
+    /// loaded again with [`Tree::deserialize`].
+    ///
+    /// The buffer uses the host's byte order, and can only be read by the
+    /// same version of the library, using the same language.
+    #[doc(alias = "ts_tree_serialize")]
+    #[must_use]
+    pub fn serialize(&self) -> Vec<u8> {
+        let mut length = 0u32;
+        unsafe {
+            let ptr = ffi::ts_tree_serialize(self.0.as_ptr(), core::ptr::addr_of_mut!(length));
+            let result = slice::from_raw_parts(ptr.cast::<u8>(), length as usize).to_vec();
+            (FREE_FN)(ptr.cast::<c_void>());
+            result
+        }
+    }
+
+    /// Load a syntax tree from a buffer that was created with
+    /// [`Tree::serialize`].
+    ///
+    /// The tree's source code must be the same as that of the tree that was
+    /// serialized. Returns `None` if the buffer is malformed, or if it was
+    /// created by a different version of the library or for a different
+    /// language. Every node is checked against the language and against its
+    /// children, so the buffer doesn't need to come from a trusted source.
+    #[doc(alias = "ts_tree_deserialize")]
+    #[must_use]
+    pub fn deserialize(language: &Language, data: &[u8]) -> Option<Self> {
+        let length = u32::try_from(data.len()).ok()?;
+        unsafe {
+            let ptr = ffi::ts_tree_deserialize(language.0, data.as_ptr().cast::<c_char>(), length);
+            NonNull::new(ptr).map(Self)
+        }
+    }
+
     /// Print a graph of the tree to the given file descriptor.
     /// The graph is formatted in the DOT language. You may want to pipe this
     /// graph directly to a `dot(1)` process in order to generate SVG
@@ -1348,13 +2439,23 @@ impl<'tree> Node<'tree> {
 
     /// Get this node's immediate parent.
     /// Prefer [`child_containing_descendant`](Node::child_containing_descendant)
-    /// for iterating over this node's ancestors.
+    /// for iterating over this node's ancestors, unless the tree has a parent
+    /// index. See [`Tree::build_parent_index`].
     #[doc(alias = "ts_node_parent")]
     #[must_use]
     pub fn parent(&self) -> Option<Self> {
         Self::new(unsafe { ffi::ts_node_parent(self.0) })
     }
 
+    /// Iterate over this node's ancestors, starting with its parent and
+    /// ending with the root node.
+    ///
+    /// Each step takes constant time if the tree has a parent index. See
+    /// [`Tree::build_parent_index`].
+    pub fn ancestors(&self) -> impl Iterator<Item = Node<'tree>> {
+        iter::successors(self.parent(), Node::parent)
+    }
+
     /// Get this node's child that contains `descendant`.
     #[doc(alias = "ts_node_child_containing_descendant")]
     #[must_use]
@@ -1411,6 +2512,24 @@ impl<'tree> Node<'tree> {
         unsafe { ffi::ts_node_descendant_count(self.0) as usize }
     }
 
+    /// Get a hash of this node's structure: its kind, and the kinds, the order,
+    /// and the lengths of its descendants.
+    ///
+    /// Unlike the [`Hash`](hash::Hash) implementation, which identifies a
+    /// node within its tree, this does not depend on the node's position or
+    /// on the tree that contains it, so nodes with the same structure have the
+    /// same hash. The text of the tokens is not included, so nodes with the
+    /// same hash can have different text.
+    ///
+    /// The hashes within a node are computed the first time this is called
+    /// for it, in time proportional to its number of descendants. After that,
+    /// this takes constant time for the node and for its descendants.
+    #[doc(alias = "ts_node_hash")]
+    #[must_use]
+    pub fn structure_hash(&self) -> u64 {
+        unsafe { ffi::ts_node_hash(self.0) }
+    }
+
     /// Get the smallest node within this node that spans the given range.
     #[doc(alias = "ts_node_descendant_for_byte_range")]
     #[must_use]
@@ -1606,93 +2725,299 @@ impl<'cursor> TreeCursor<'cursor> {
     /// This returns `true` if the cursor successfully moved, and returns
     /// `false` if there was no parent node (the cursor was already on the
     /// root node).
-    #[doc(alias = "ts_tree_cursor_goto_parent")]
+    #[doc(alias = "ts_tree_cursor_goto_parent")]
+    pub fn goto_parent(&mut self) -> bool {
+        unsafe { ffi::ts_tree_cursor_goto_parent(&mut self.0) }
+    }
+
+    /// Move this cursor to the next sibling of its current node.
+    ///
+    /// This returns `true` if the cursor successfully moved, and returns
+    /// `false` if there was no next sibling node.
+    #[doc(alias = "ts_tree_cursor_goto_next_sibling")]
+    pub fn goto_next_sibling(&mut self) -> bool {
+        unsafe { ffi::ts_tree_cursor_goto_next_sibling(&mut self.0) }
+    }
+
+    /// Move the cursor to the node that is the nth descendant of
+    /// the original node that the cursor was constructed with, where
+    /// zero represents the original node itself.
+    #[doc(alias = "ts_tree_cursor_goto_descendant")]
+    pub fn goto_descendant(&mut self, descendant_index: usize) {
+        unsafe { ffi::ts_tree_cursor_goto_descendant(&mut self.0, descendant_index as u32) }
+    }
+
+    /// Move this cursor to the previous sibling of its current node.
+    ///
+    /// This returns `true` if the cursor successfully moved, and returns
+    /// `false` if there was no previous sibling node.
+    ///
+    /// Note, that this function may be slower than
+    /// [`goto_next_sibling`](TreeCursor::goto_next_sibling) due to how node
+    /// positions are stored. In the worst case, this will need to iterate
+    /// through all the children upto the previous sibling node to recalculate
+    /// its position.
+    #[doc(alias = "ts_tree_cursor_goto_previous_sibling")]
+    pub fn goto_previous_sibling(&mut self) -> bool {
+        unsafe { ffi::ts_tree_cursor_goto_previous_sibling(&mut self.0) }
+    }
+
+    /// Move this cursor to the first child of its current node that extends
+    /// beyond the given byte offset.
+    ///
+    /// This returns the index of the child node if one was found, and returns
+    /// `None` if no such child was found.
+    #[doc(alias = "ts_tree_cursor_goto_first_child_for_byte")]
+    pub fn goto_first_child_for_byte(&mut self, index: usize) -> Option<usize> {
+        let result =
+            unsafe { ffi::ts_tree_cursor_goto_first_child_for_byte(&mut self.0, index as u32) };
+        (result >= 0).then_some(result as usize)
+    }
+
+    /// Move this cursor to the first child of its current node that extends
+    /// beyond the given byte offset.
+    ///
+    /// This returns the index of the child node if one was found, and returns
+    /// `None` if no such child was found.
+    #[doc(alias = "ts_tree_cursor_goto_first_child_for_point")]
+    pub fn goto_first_child_for_point(&mut self, point: Point) -> Option<usize> {
+        let result =
+            unsafe { ffi::ts_tree_cursor_goto_first_child_for_point(&mut self.0, point.into()) };
+        (result >= 0).then_some(result as usize)
+    }
+
+    /// Walk the tree in preorder, starting at the cursor's current node, and
+    /// append up to `limit` of the nodes that pass the given filter to
+    /// `entries`. This visits many nodes in one call, which is much faster
+    /// than moving the cursor one node at a time through a binding.
+    ///
+    /// The walk doesn't leave the original node that the cursor was
+    /// constructed with. Nodes that are filtered out are not appended, but
+    /// their descendants are still visited.
+    ///
+    /// Returns `true` if the walk stopped because `limit` nodes were appended.
+    /// The cursor is then on the next node to append, so calling this again
+    /// continues the walk. Otherwise, the walk is finished, and the cursor is
+    /// moved back to its original node.
+    #[doc(alias = "ts_tree_cursor_walk")]
+    pub fn walk_nodes(
+        &mut self,
+        options: &TreeCursorWalkOptions,
+        entries: &mut Vec<TreeCursorWalkEntry<'cursor>>,
+        limit: usize,
+    ) -> bool {
+        let c_options = ffi::TSTreeCursorWalkOptions {
+            symbols: options.symbols.map_or(ptr::null(), <[u8]>::as_ptr),
+            symbol_count: options.symbols.map_or(0, |symbols| {
+                symbols.len().saturating_mul(8).min(u32::MAX as usize) as u32
+            }),
+            max_depth: options.max_depth,
+            named_only: options.named_only,
+        };
+        let capacity = limit.min(u32::MAX as usize) as u32;
+        entries.reserve(capacity as usize);
+        let mut count = 0;
+        unsafe {
+            // A `TreeCursorWalkEntry` has the same layout as the C struct, so
+            // the entries are written directly into the vector.
+            let more = ffi::ts_tree_cursor_walk(
+                &mut self.0,
+                &c_options,
+                entries
+                    .as_mut_ptr()
+                    .add(entries.len())
+                    .cast::<ffi::TSTreeCursorWalkEntry>(),
+                capacity,
+                &mut count,
+            );
+            entries.set_len(entries.len() + count as usize);
+            more
+        }
+    }
+
+    /// Re-initialize this tree cursor to start at the original node that the
+    /// cursor was constructed with.
+    #[doc(alias = "ts_tree_cursor_reset")]
+    pub fn reset(&mut self, node: Node<'cursor>) {
+        unsafe { ffi::ts_tree_cursor_reset(&mut self.0, node.0) };
+    }
+
+    /// Re-initialize a tree cursor to the same position as another cursor.
+    ///
+    /// Unlike [`reset`](TreeCursor::reset), this will not lose parent
+    /// information and allows reusing already created cursors.
+    #[doc(alias = "ts_tree_cursor_reset_to")]
+    pub fn reset_to(&mut self, cursor: &Self) {
+        unsafe { ffi::ts_tree_cursor_reset_to(&mut self.0, &cursor.0) };
+    }
+}
+
+impl Clone for TreeCursor<'_> {
+    fn clone(&self) -> Self {
+        TreeCursor(unsafe { ffi::ts_tree_cursor_copy(&self.0) }, PhantomData)
+    }
+}
+
+impl Drop for TreeCursor<'_> {
+    fn drop(&mut self) {
+        unsafe { ffi::ts_tree_cursor_delete(&mut self.0) }
+    }
+}
+
+impl FlatTree {
+    /// Get the number of nodes in this flat tree.
+    #[doc(alias = "ts_flat_tree_node_count")]
+    #[must_use]
+    pub fn node_count(&self) -> usize {
+        unsafe { ffi::ts_flat_tree_node_count(self.0.as_ptr()) as usize }
+    }
+
+    /// Get the language of the syntax tree from which this flat tree was
+    /// created.
+    #[doc(alias = "ts_flat_tree_language")]
+    #[must_use]
+    pub fn language(&self) -> LanguageRef<'_> {
+        LanguageRef(
+            unsafe { ffi::ts_flat_tree_language(self.0.as_ptr()) },
+            PhantomData,
+        )
+    }
+
+    /// Create a new [`FlatTreeCursor`] starting from the root node.
+    #[doc(alias = "ts_flat_tree_cursor_new")]
+    #[must_use]
+    pub fn walk(&self) -> FlatTreeCursor<'_> {
+        FlatTreeCursor(
+            unsafe { ffi::ts_flat_tree_cursor_new(self.0.as_ptr()) },
+            PhantomData,
+        )
+    }
+}
+
+impl fmt::Debug for FlatTree {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "{{FlatTree {} nodes}}", self.node_count())
+    }
+}
+
+impl Drop for FlatTree {
+    fn drop(&mut self) {
+        unsafe { ffi::ts_flat_tree_delete(self.0.as_ptr()) }
+    }
+}
+
+impl<'tree> FlatTreeCursor<'tree> {
+    /// Get the properties of the cursor's current node.
+    #[doc(alias = "ts_flat_tree_cursor_current_node")]
+    #[must_use]
+    pub fn node(&self) -> FlatNode {
+        let node = unsafe { ffi::ts_flat_tree_cursor_current_node(&self.0) };
+        FlatNode {
+            kind_id: node.symbol,
+            field_id: FieldId::new(node.field_id),
+            range: Range {
+                start_byte: node.start_byte as usize,
+                end_byte: node.end_byte as usize,
+                start_point: node.start_point.into(),
+                end_point: node.end_point.into(),
+            },
+            is_named: node.is_named,
+            is_extra: node.is_extra,
+            is_missing: node.is_missing,
+            has_error: node.has_error,
+        }
+    }
+
+    /// Get the index of the cursor's current node out of all of the nodes in
+    /// the flat tree, in preorder.
+    #[doc(alias = "ts_flat_tree_cursor_current_descendant_index")]
+    #[must_use]
+    pub fn descendant_index(&self) -> usize {
+        unsafe { ffi::ts_flat_tree_cursor_current_descendant_index(&self.0) as usize }
+    }
+
+    /// Move this cursor to the first child of its current node.
+    ///
+    /// This returns `true` if the cursor successfully moved, and returns
+    /// `false` if there were no children.
+    #[doc(alias = "ts_flat_tree_cursor_goto_first_child")]
+    pub fn goto_first_child(&mut self) -> bool {
+        unsafe { ffi::ts_flat_tree_cursor_goto_first_child(&mut self.0) }
+    }
+
+    /// Move this cursor to the next sibling of its current node.
+    ///
+    /// This returns `true` if the cursor successfully moved, and returns
+    /// `false` if there was no next sibling node.
+    #[doc(alias = "ts_flat_tree_cursor_goto_next_sibling")]
+    pub fn goto_next_sibling(&mut self) -> bool {
+        unsafe { ffi::ts_flat_tree_cursor_goto_next_sibling(&mut self.0) }
+    }
+
+    /// Move this cursor to the parent of its current node.
+    ///
+    /// This returns `true` if the cursor successfully moved, and returns
+    /// `false` if there was no parent node (the cursor was already on the
+    /// root node).
+    #[doc(alias = "ts_flat_tree_cursor_goto_parent")]
     pub fn goto_parent(&mut self) -> bool {
-        unsafe { ffi::ts_tree_cursor_goto_parent(&mut self.0) }
-    }
-
-    /// Move this cursor to the next sibling of its current node.
-    ///
-    /// This returns `true` if the cursor successfully moved, and returns
-    /// `false` if there was no next sibling node.
-    #[doc(alias = "ts_tree_cursor_goto_next_sibling")]
-    pub fn goto_next_sibling(&mut self) -> bool {
-        unsafe { ffi::ts_tree_cursor_goto_next_sibling(&mut self.0) }
+        unsafe { ffi::ts_flat_tree_cursor_goto_parent(&mut self.0) }
     }
 
-    /// Move the cursor to the node that is the nth descendant of
-    /// the original node that the cursor was constructed with, where
-    /// zero represents the original node itself.
-    #[doc(alias = "ts_tree_cursor_goto_descendant")]
+    /// Move the cursor to the node that is the nth descendant of the root
+    /// node in preorder, where zero represents the root node itself. If the
+    /// index is out of bounds, the cursor does not move.
+    #[doc(alias = "ts_flat_tree_cursor_goto_descendant")]
     pub fn goto_descendant(&mut self, descendant_index: usize) {
-        unsafe { ffi::ts_tree_cursor_goto_descendant(&mut self.0, descendant_index as u32) }
+        unsafe { ffi::ts_flat_tree_cursor_goto_descendant(&mut self.0, descendant_index as u32) }
     }
+}
 
-    /// Move this cursor to the previous sibling of its current node.
-    ///
-    /// This returns `true` if the cursor successfully moved, and returns
-    /// `false` if there was no previous sibling node.
-    ///
-    /// Note, that this function may be slower than
-    /// [`goto_next_sibling`](TreeCursor::goto_next_sibling) due to how node
-    /// positions are stored. In the worst case, this will need to iterate
-    /// through all the children upto the previous sibling node to recalculate
-    /// its position.
-    #[doc(alias = "ts_tree_cursor_goto_previous_sibling")]
-    pub fn goto_previous_sibling(&mut self) -> bool {
-        unsafe { ffi::ts_tree_cursor_goto_previous_sibling(&mut self.0) }
+impl TreeSnapshot {
+    /// Create a new snapshot, holding a copy of the given tree, if any.
+    #[doc(alias = "ts_tree_snapshot_new")]
+    #[must_use]
+    pub fn new(tree: Option<&Tree>) -> Self {
+        let tree = tree.map_or(ptr::null(), |t| t.0.as_ptr().cast_const());
+        Self(unsafe { NonNull::new_unchecked(ffi::ts_tree_snapshot_new(tree)) })
     }
 
-    /// Move this cursor to the first child of its current node that extends
-    /// beyond the given byte offset.
+    /// Replace the snapshot's tree with a copy of the given tree, if any.
     ///
-    /// This returns the index of the child node if one was found, and returns
-    /// `None` if no such child was found.
-    #[doc(alias = "ts_tree_cursor_goto_first_child_for_byte")]
-    pub fn goto_first_child_for_byte(&mut self, index: usize) -> Option<usize> {
-        let result =
-            unsafe { ffi::ts_tree_cursor_goto_first_child_for_byte(&mut self.0, index as u32) };
-        (result >= 0).then_some(result as usize)
+    /// The given tree can still be edited and reparsed afterwards, without
+    /// affecting the copy that readers see.
+    #[doc(alias = "ts_tree_snapshot_publish")]
+    pub fn publish(&self, tree: Option<&Tree>) {
+        let tree = tree.map_or(ptr::null(), |t| t.0.as_ptr().cast_const());
+        unsafe { ffi::ts_tree_snapshot_publish(self.0.as_ptr(), tree) }
     }
 
-    /// Move this cursor to the first child of its current node that extends
-    /// beyond the given byte offset.
+    /// Get a copy of the snapshot's current tree, if it has one.
     ///
-    /// This returns the index of the child node if one was found, and returns
-    /// `None` if no such child was found.
-    #[doc(alias = "ts_tree_cursor_goto_first_child_for_point")]
-    pub fn goto_first_child_for_point(&mut self, point: Point) -> Option<usize> {
-        let result =
-            unsafe { ffi::ts_tree_cursor_goto_first_child_for_point(&mut self.0, point.into()) };
-        (result >= 0).then_some(result as usize)
-    }
-
-    /// Re-initialize this tree cursor to start at the original node that the
-    /// cursor was constructed with.
-    #[doc(alias = "ts_tree_cursor_reset")]
-    pub fn reset(&mut self, node: Node<'cursor>) {
-        unsafe { ffi::ts_tree_cursor_reset(&mut self.0, node.0) };
+    /// This never waits for other readers or for writers, and the returned
+    /// tree stays valid after newer versions are published.
+    #[doc(alias = "ts_tree_snapshot_acquire")]
+    #[must_use]
+    pub fn acquire(&self) -> Option<Tree> {
+        NonNull::new(unsafe { ffi::ts_tree_snapshot_acquire(self.0.as_ptr()) }).map(Tree)
     }
+}
 
-    /// Re-initialize a tree cursor to the same position as another cursor.
-    ///
-    /// Unlike [`reset`](TreeCursor::reset), this will not lose parent
-    /// information and allows reusing already created cursors.
-    #[doc(alias = "ts_tree_cursor_reset_to")]
-    pub fn reset_to(&mut self, cursor: &Self) {
-        unsafe { ffi::ts_tree_cursor_reset_to(&mut self.0, &cursor.0) };
+impl Default for TreeSnapshot {
+    fn default() -> Self {
+        Self::new(None)
     }
 }
 
-impl Clone for TreeCursor<'_> {
-    fn clone(&self) -> Self {
-        TreeCursor(unsafe { ffi::ts_tree_cursor_copy(&self.0) }, PhantomData)
+impl fmt::Debug for TreeSnapshot {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "{{TreeSnapshot}}")
     }
 }
 
-impl Drop for TreeCursor<'_> {
+impl Drop for TreeSnapshot {
     fn drop(&mut self) {
-        unsafe { ffi::ts_tree_cursor_delete(&mut self.0) }
+        unsafe { ffi::ts_tree_snapshot_delete(self.0.as_ptr()) }
     }
 }
 
@@ -1874,6 +3199,41 @@ impl Query {
         unsafe { Self::from_raw_parts(ptr, source) }
     }
 
+    /// Serialize the query into a compact binary buffer, so that it can be
+    /// stored and later reloaded with [`Query::deserialize`] without parsing
+    /// its source or analyzing its patterns again.
+    ///
+    /// The buffer can only be read by the same version of the library, on a
+    /// machine with the same byte order, using the same language.
+    #[doc(alias = "ts_query_serialize")]
+    #[must_use]
+    pub fn serialize(&self) -> Vec<u8> {
+        let mut length = 0u32;
+        unsafe {
+            let ptr = ffi::ts_query_serialize(self.ptr.as_ptr(), core::ptr::addr_of_mut!(length));
+            let result = slice::from_raw_parts(ptr.cast::<u8>(), length as usize).to_vec();
+            (FREE_FN)(ptr.cast::<c_void>());
+            result
+        }
+    }
+
+    /// Load a query from a buffer that was created with [`Query::serialize`].
+    ///
+    /// Returns `None` if the buffer is malformed, or if it was created by a
+    /// different version of the library or for a different language.
+    #[doc(alias = "ts_query_deserialize")]
+    #[must_use]
+    pub fn deserialize(language: &Language, data: &[u8]) -> Option<Self> {
+        let length = u32::try_from(data.len()).ok()?;
+        let ptr = unsafe {
+            ffi::ts_query_deserialize(language.0, data.as_ptr().cast::<c_char>(), length)
+        };
+        if ptr.is_null() {
+            return None;
+        }
+        unsafe { Self::from_raw_parts(ptr, "") }.ok()
+    }
+
     #[doc(hidden)]
     unsafe fn from_raw_parts(ptr: *mut ffi::TSQuery, source: &str) -> Result<Self, QueryError> {
         let ptr = {
@@ -1965,11 +3325,18 @@ impl Query {
             let mut property_predicates = Vec::new();
             let mut property_settings = Vec::new();
             let mut general_predicates = Vec::new();
-            for p in predicate_steps.split(|s| s.type_ == TYPE_DONE) {
+            for (predicate_index, p) in predicate_steps.split(|s| s.type_ == TYPE_DONE).enumerate()
+            {
                 if p.is_empty() {
                     continue;
                 }
 
+                // Text predicates that the C library evaluates by itself are
+                // still validated here, but not stored.
+                let is_built_in = unsafe {
+                    ffi::ts_query_is_predicate_built_in(ptr.0, i as u32, predicate_index as u32)
+                };
+
                 if p[0].type_ != TYPE_STRING {
                     return Err(predicate_error(
                         row,
@@ -2006,7 +3373,7 @@ impl Query {
                             "any-eq?" | "any-not-eq?" => false,
                             _ => unreachable!(),
                         };
-                        text_predicates.push(if p[2].type_ == TYPE_CAPTURE {
+                        let predicate = if p[2].type_ == TYPE_CAPTURE {
                             TextPredicateCapture::EqCapture(
                                 p[1].value_id,
                                 p[2].value_id,
@@ -2020,7 +3387,10 @@ impl Query {
                                 is_positive,
                                 match_all,
                             )
-                        });
+                        };
+                        if !is_built_in {
+                            text_predicates.push(predicate);
+                        }
                     }
 
                     "match?" | "not-match?" | "any-match?" | "any-not-match?" => {
@@ -2051,14 +3421,17 @@ impl Query {
                             _ => unreachable!(),
                         };
                         let regex = &string_values[p[2].value_id as usize];
-                        text_predicates.push(TextPredicateCapture::MatchString(
+                        let predicate = TextPredicateCapture::MatchString(
                             p[1].value_id,
                             regex::bytes::Regex::new(regex).map_err(|_| {
                                 predicate_error(row, format!("Invalid regex '{regex}'"))
                             })?,
                             is_positive,
                             match_all,
-                        ));
+                        );
+                        if !is_built_in {
+                            text_predicates.push(predicate);
+                        }
                     }
 
                     "set!" => property_settings.push(Self::parse_property(
@@ -2105,15 +3478,17 @@ impl Query {
                             }
                             values.push(string_values[arg.value_id as usize]);
                         }
-                        text_predicates.push(TextPredicateCapture::AnyString(
-                            p[1].value_id,
-                            values
-                                .iter()
-                                .map(|x| (*x).to_string().into())
-                                .collect::<Vec<_>>()
-                                .into(),
-                            is_positive,
-                        ));
+                        if !is_built_in {
+                            text_predicates.push(TextPredicateCapture::AnyString(
+                                p[1].value_id,
+                                values
+                                    .iter()
+                                    .map(|x| (*x).to_string().into())
+                                    .collect::<Vec<_>>()
+                                    .into(),
+                                is_positive,
+                            ));
+                        }
                     }
 
                     _ => general_predicates.push(QueryPredicate {
@@ -2366,6 +3741,7 @@ impl QueryCursor {
     pub fn new() -> Self {
         Self {
             ptr: unsafe { NonNull::new_unchecked(ffi::ts_query_cursor_new()) },
+            buffers: ptr::null_mut(),
         }
     }
 
@@ -2405,6 +3781,18 @@ impl QueryCursor {
         unsafe { ffi::ts_query_cursor_timeout_micros(self.ptr.as_ptr()) }
     }
 
+    /// Get the number of operations that this cursor has performed since it
+    /// last started executing a query.
+    ///
+    /// Each step onto or off of a node counts as one operation, plus one for
+    /// each match that is in progress at that step. Unlike the time taken,
+    /// this is deterministic.
+    #[doc(alias = "ts_query_cursor_operation_count")]
+    #[must_use]
+    pub fn operation_count(&self) -> u64 {
+        unsafe { ffi::ts_query_cursor_operation_count(self.ptr.as_ptr()) }
+    }
+
     /// Check if, on its last execution, this cursor exceeded its maximum number
     /// of in-progress matches.
     #[doc(alias = "ts_query_cursor_did_exceed_match_limit")]
@@ -2413,6 +3801,15 @@ impl QueryCursor {
         unsafe { ffi::ts_query_cursor_did_exceed_match_limit(self.ptr.as_ptr()) }
     }
 
+    /// Get the buffers that this cursor's iterators use to join the chunks of a node's text,
+    /// allocating them on first use.
+    fn text_buffers(&mut self) -> *mut QueryTextBuffers {
+        if self.buffers.is_null() {
+            self.buffers = Box::into_raw(Box::default());
+        }
+        self.buffers
+    }
+
     /// Iterate over all of the matches in the order that they were found.
     ///
     /// Each match contains the index of the pattern that matched, and a list of
@@ -2430,10 +3827,9 @@ impl QueryCursor {
         unsafe { ffi::ts_query_cursor_exec(ptr, query.ptr.as_ptr(), node.0) };
         QueryMatches {
             ptr,
+            buffers: self.text_buffers(),
             query,
             text_provider,
-            buffer1: Vec::default(),
-            buffer2: Vec::default(),
             _phantom: PhantomData,
         }
     }
@@ -2454,10 +3850,9 @@ impl QueryCursor {
         unsafe { ffi::ts_query_cursor_exec(ptr, query.ptr.as_ptr(), node.0) };
         QueryCaptures {
             ptr,
+            buffers: self.text_buffers(),
             query,
             text_provider,
-            buffer1: Vec::default(),
-            buffer2: Vec::default(),
             _phantom: PhantomData,
         }
     }
@@ -2476,6 +3871,51 @@ impl QueryCursor {
         self
     }
 
+    /// Set several disjoint ranges in which the query will be executed, in
+    /// terms of byte offsets, so that one execution finds the matches in all
+    /// of them.
+    ///
+    /// The ranges must be sorted, and must not overlap. If this requirement is
+    /// not satisfied, this returns an [`IncludedRangesError`] with the index of
+    /// the first incorrect range, and the cursor is unchanged. A match is
+    /// returned if it would be returned when executing the query in any one of
+    /// the ranges, and it is returned only once.
+    #[doc(alias = "ts_query_cursor_set_byte_ranges")]
+    pub fn set_byte_ranges(
+        &mut self,
+        ranges: &[ops::Range<usize>],
+    ) -> Result<&mut Self, IncludedRangesError> {
+        let ts_ranges = ranges
+            .iter()
+            .map(|range| ffi::TSRange {
+                start_point: ffi::TSPoint { row: 0, column: 0 },
+                end_point: ffi::TSPoint { row: 0, column: 0 },
+                start_byte: range.start as u32,
+                end_byte: range.end as u32,
+            })
+            .collect::<Vec<_>>();
+        let result = unsafe {
+            ffi::ts_query_cursor_set_byte_ranges(
+                self.ptr.as_ptr(),
+                ts_ranges.as_ptr(),
+                ts_ranges.len() as u32,
+            )
+        };
+
+        if result {
+            Ok(self)
+        } else {
+            let mut prev_end = 0;
+            for (i, range) in ranges.iter().enumerate() {
+                if range.start < prev_end || range.end < range.start {
+                    return Err(IncludedRangesError(i));
+                }
+                prev_end = range.end;
+            }
+            Err(IncludedRangesError(0))
+        }
+    }
+
     /// Set the range in which the query will be executed, in terms of rows and
     /// columns.
     #[doc(alias = "ts_query_cursor_set_point_range")]
@@ -2514,6 +3954,171 @@ impl QueryCursor {
         }
         self
     }
+
+    /// Preallocate all of the memory that this cursor uses to track matches,
+    /// so that running a query does not allocate memory once the cursor has
+    /// been used on a tree of a given depth.
+    ///
+    /// The cursor will track at most `state_count` in-progress and finished
+    /// matches at once, and each match can hold at most `capture_count`
+    /// captures. Matches that would exceed these limits are dropped, and
+    /// [`did_exceed_match_limit`](QueryCursor::did_exceed_match_limit) will
+    /// return `true`.
+    ///
+    /// Set `state_count` to zero to remove both limits. `capture_count` is
+    /// then ignored.
+    #[doc(alias = "ts_query_cursor_set_capacity")]
+    pub fn set_capacity(&mut self, state_count: u32, capture_count: u32) -> &mut Self {
+        unsafe {
+            ffi::ts_query_cursor_set_capacity(self.ptr.as_ptr(), state_count, capture_count);
+        }
+        self
+    }
+
+    /// Disable a certain pattern for every query that is subsequently run with
+    /// this cursor.
+    ///
+    /// Unlike [`Query::disable_pattern`], this does not modify the query, so a
+    /// single query can be shared by many threads, each using its own cursor.
+    #[doc(alias = "ts_query_cursor_disable_pattern")]
+    pub fn disable_pattern(&mut self, index: usize) -> &mut Self {
+        unsafe { ffi::ts_query_cursor_disable_pattern(self.ptr.as_ptr(), index as u32) }
+        self
+    }
+
+    /// Disable a certain capture for every query that is subsequently run with
+    /// this cursor. The capture is identified by its index, as returned by
+    /// [`Query::capture_index_for_name`].
+    ///
+    /// Unlike [`Query::disable_capture`], this does not modify the query.
+    #[doc(alias = "ts_query_cursor_disable_capture")]
+    pub fn disable_capture(&mut self, index: u32) -> &mut Self {
+        unsafe { ffi::ts_query_cursor_disable_capture(self.ptr.as_ptr(), index) }
+        self
+    }
+
+    /// Re-enable all of the patterns and captures that were disabled on this
+    /// cursor.
+    #[doc(alias = "ts_query_cursor_enable_all")]
+    pub fn enable_all(&mut self) -> &mut Self {
+        unsafe { ffi::ts_query_cursor_enable_all(self.ptr.as_ptr()) }
+        self
+    }
+
+    /// Collect all of the captures of a query on several threads at once.
+    ///
+    /// The given node is split into up to `thread_count` byte ranges whose
+    /// boundaries fall between sibling nodes, and each range is searched by
+    /// its own cursor on its own thread. A match that crosses a boundary is
+    /// found by every range that it intersects, and each of its captures is
+    /// kept only by the range that contains the capture's start byte, so the
+    /// result contains the same captures, in the same order, as iterating
+    /// over [`captures`](QueryCursor::captures).
+    ///
+    /// The number of threads is also limited by the available parallelism,
+    /// since every range must still step over the earlier siblings of the
+    /// nodes that it contains. Each worker cursor uses this cursor's match
+    /// limit and timeout. Any byte or point range set on this cursor is not
+    /// used.
+    #[cfg(feature = "std")]
+    pub fn captures_parallel<'tree, T, I>(
+        &self,
+        query: &Query,
+        node: Node<'tree>,
+        text_provider: T,
+        thread_count: usize,
+    ) -> Vec<(usize, QueryCapture<'tree>)>
+    where
+        T: TextProvider<I> + Clone + Send,
+        I: AsRef<[u8]>,
+    {
+        let match_limit = self.match_limit();
+        let timeout = self.timeout_micros();
+        let run_range = |range: ops::Range<usize>, text_provider: T| {
+            let mut cursor = Self::new();
+            cursor.set_match_limit(match_limit);
+            cursor.set_timeout_micros(timeout);
+            cursor.set_byte_range(range.clone());
+            cursor
+                .captures(query, node, text_provider)
+                .filter_map(|(m, i)| {
+                    let capture = m.captures[i];
+                    range
+                        .contains(&capture.node.start_byte())
+                        .then_some((m.pattern_index, capture))
+                })
+                .collect::<Vec<_>>()
+        };
+
+        let thread_count = std::thread::available_parallelism()
+            .map_or(1, usize::from)
+            .min(thread_count)
+            .max(1);
+        let mut boundaries = Self::partition_node(node, thread_count);
+        *boundaries.first_mut().unwrap() = 0;
+        *boundaries.last_mut().unwrap() = u32::MAX as usize;
+        if boundaries.len() == 2 {
+            return run_range(boundaries[0]..boundaries[1], text_provider);
+        }
+
+        std::thread::scope(|scope| {
+            let handles = boundaries
+                .windows(2)
+                .map(|bounds| {
+                    let text_provider = text_provider.clone();
+                    let run_range = &run_range;
+                    scope.spawn(move || run_range(bounds[0]..bounds[1], text_provider))
+                })
+                .collect::<Vec<_>>();
+            handles
+                .into_iter()
+                .flat_map(|handle| {
+                    handle
+                        .join()
+                        .unwrap_or_else(|e| std::panic::resume_unwind(e))
+                })
+                .collect()
+        })
+    }
+
+    /// Split a node into at most `count` contiguous byte ranges of roughly
+    /// equal size, returning the boundaries of those ranges. Every boundary
+    /// other than the first and last is the end byte of some descendant node,
+    /// descending into a node only when it is too large to fit in one range.
+    #[cfg(feature = "std")]
+    fn partition_node(node: Node, count: usize) -> Vec<usize> {
+        let start_byte = node.start_byte();
+        let end_byte = node.end_byte();
+        let target_size = ((end_byte - start_byte) / count).max(1);
+        let mut boundaries = vec![start_byte];
+
+        let mut cursor = node.walk();
+        if count > 1 && cursor.goto_first_child() {
+            'outer: loop {
+                let child = cursor.node();
+                if child.byte_range().len() > target_size && cursor.goto_first_child() {
+                    continue;
+                }
+
+                let last_boundary = *boundaries.last().unwrap();
+                if boundaries.len() < count
+                    && child.end_byte() >= last_boundary + target_size
+                    && child.end_byte() < end_byte
+                {
+                    boundaries.push(child.end_byte());
+                }
+
+                while !cursor.goto_next_sibling() {
+                    if !cursor.goto_parent() {
+                        break 'outer;
+                    }
+                }
+            }
+        }
+
+        boundaries.push(end_byte);
+        boundaries
+    }
 }
 
 impl<'tree> QueryMatch<'_, 'tree> {
@@ -2555,8 +4160,7 @@ impl<'tree> QueryMatch<'_, 'tree> {
     fn satisfies_text_predicates<I: AsRef<[u8]>>(
         &self,
         query: &Query,
-        buffer1: &mut Vec<u8>,
-        buffer2: &mut Vec<u8>,
+        buffer: &mut Vec<u8>,
         text_provider: &mut impl TextProvider<I>,
     ) -> bool {
         struct NodeText<'a, T> {
@@ -2590,8 +4194,7 @@ impl<'tree> QueryMatch<'_, 'tree> {
             }
         }
 
-        let mut node_text1 = NodeText::new(buffer1);
-        let mut node_text2 = NodeText::new(buffer2);
+        let mut node_text = NodeText::new(buffer);
 
         query.text_predicates[self.pattern_index]
             .iter()
@@ -2600,11 +4203,9 @@ impl<'tree> QueryMatch<'_, 'tree> {
                     let mut nodes_1 = self.nodes_for_capture_index(*i);
                     let mut nodes_2 = self.nodes_for_capture_index(*j);
                     while let (Some(node1), Some(node2)) = (nodes_1.next(), nodes_2.next()) {
-                        let mut text1 = text_provider.text(node1);
-                        let mut text2 = text_provider.text(node2);
-                        let text1 = node_text1.get_text(&mut text1);
-                        let text2 = node_text2.get_text(&mut text2);
-                        let is_positive_match = text1 == text2;
+                        let text1 = text_provider.text(node1);
+                        let text2 = text_provider.text(node2);
+                        let is_positive_match = chunks_eq(text1, text2);
                         if is_positive_match != *is_positive && *match_all_nodes {
                             return false;
                         }
@@ -2616,24 +4217,26 @@ impl<'tree> QueryMatch<'_, 'tree> {
                 }
                 TextPredicateCapture::EqString(i, s, is_positive, match_all_nodes) => {
                     let nodes = self.nodes_for_capture_index(*i);
+                    let mut has_nodes = false;
                     for node in nodes {
-                        let mut text = text_provider.text(node);
-                        let text = node_text1.get_text(&mut text);
-                        let is_positive_match = text == s.as_bytes();
+                        let text = text_provider.text(node);
+                        let is_positive_match = chunks_eq(text, iter::once(s.as_bytes()));
                         if is_positive_match != *is_positive && *match_all_nodes {
                             return false;
                         }
                         if is_positive_match == *is_positive && !*match_all_nodes {
                             return true;
                         }
+                        has_nodes = true;
                     }
-                    true
+                    *match_all_nodes || !has_nodes
                 }
                 TextPredicateCapture::MatchString(i, r, is_positive, match_all_nodes) => {
                     let nodes = self.nodes_for_capture_index(*i);
+                    let mut has_nodes = false;
                     for node in nodes {
                         let mut text = text_provider.text(node);
-                        let text = node_text1.get_text(&mut text);
+                        let text = node_text.get_text(&mut text);
                         let is_positive_match = r.is_match(text);
                         if is_positive_match != *is_positive && *match_all_nodes {
                             return false;
@@ -2641,14 +4244,15 @@ impl<'tree> QueryMatch<'_, 'tree> {
                         if is_positive_match == *is_positive && !*match_all_nodes {
                             return true;
                         }
+                        has_nodes = true;
                     }
-                    true
+                    *match_all_nodes || !has_nodes
                 }
                 TextPredicateCapture::AnyString(i, v, is_positive) => {
                     let nodes = self.nodes_for_capture_index(*i);
                     for node in nodes {
                         let mut text = text_provider.text(node);
-                        let text = node_text1.get_text(&mut text);
+                        let text = node_text.get_text(&mut text);
                         if (v.iter().any(|s| text == s.as_bytes())) != *is_positive {
                             return false;
                         }
@@ -2670,6 +4274,109 @@ impl QueryProperty {
     }
 }
 
+/// Check whether two sequences of chunks contain the same text, comparing them in place
+/// instead of joining them first.
+fn chunks_eq<A: AsRef<[u8]>, B: AsRef<[u8]>>(
+    mut chunks_a: impl Iterator<Item = A>,
+    mut chunks_b: impl Iterator<Item = B>,
+) -> bool {
+    let (mut chunk_a, mut offset_a) = (chunks_a.next(), 0);
+    let (mut chunk_b, mut offset_b) = (chunks_b.next(), 0);
+    loop {
+        while chunk_a
+            .as_ref()
+            .is_some_and(|chunk| offset_a == chunk.as_ref().len())
+        {
+            (chunk_a, offset_a) = (chunks_a.next(), 0);
+        }
+        while chunk_b
+            .as_ref()
+            .is_some_and(|chunk| offset_b == chunk.as_ref().len())
+        {
+            (chunk_b, offset_b) = (chunks_b.next(), 0);
+        }
+        let (Some(a), Some(b)) = (&chunk_a, &chunk_b) else {
+            return chunk_a.is_none() && chunk_b.is_none();
+        };
+        let (a, b) = (&a.as_ref()[offset_a..], &b.as_ref()[offset_b..]);
+        let length = a.len().min(b.len());
+        if a[..length] != b[..length] {
+            return false;
+        }
+        offset_a += length;
+        offset_b += length;
+    }
+}
+
+/// Run a function while the query cursor uses the given text provider to
+/// evaluate the text predicates that the C library supports.
+///
+/// The provider is only installed for the duration of the call, because the
+/// iterators that own it can be moved between calls.
+fn with_text_provider<T: TextProvider<I>, I: AsRef<[u8]>, R>(
+    cursor: *mut ffi::TSQueryCursor,
+    text_provider: &mut T,
+    buffer: &mut Vec<u8>,
+    f: impl FnOnce() -> R,
+) -> R {
+    struct Payload<'a, T, I> {
+        text_provider: &'a mut T,
+        buffer: &'a mut Vec<u8>,
+        chunk: Option<I>,
+    }
+
+    unsafe extern "C" fn text<T: TextProvider<I>, I: AsRef<[u8]>>(
+        payload: *mut c_void,
+        node: ffi::TSNode,
+        length: *mut u32,
+    ) -> *const c_char {
+        let payload = &mut *payload.cast::<Payload<T, I>>();
+        let mut chunks = payload.text_provider.text(Node::new(node).unwrap());
+        payload.chunk = chunks.next();
+        let text = if let Some(next_chunk) = chunks.next() {
+            payload.buffer.clear();
+            payload
+                .buffer
+                .extend_from_slice(payload.chunk.as_ref().unwrap().as_ref());
+            payload.buffer.extend_from_slice(next_chunk.as_ref());
+            for chunk in chunks {
+                payload.buffer.extend_from_slice(chunk.as_ref());
+            }
+            payload.buffer.as_slice()
+        } else {
+            payload.chunk.as_ref().map_or(&[][..], AsRef::as_ref)
+        };
+        *length = text.len() as u32;
+        text.as_ptr().cast::<c_char>()
+    }
+
+    let mut payload = Payload::<T, I> {
+        text_provider,
+        buffer,
+        chunk: None,
+    };
+    unsafe {
+        ffi::ts_query_cursor_set_text_provider(
+            cursor,
+            ffi::TSQueryTextProvider {
+                payload: core::ptr::addr_of_mut!(payload).cast::<c_void>(),
+                text: Some(text::<T, I>),
+            },
+        );
+    }
+    let result = f();
+    unsafe {
+        ffi::ts_query_cursor_set_text_provider(
+            cursor,
+            ffi::TSQueryTextProvider {
+                payload: core::ptr::null_mut(),
+                text: None,
+            },
+        );
+    }
+    result
+}
+
 impl<'query, 'tree: 'query, T: TextProvider<I>, I: AsRef<[u8]>> Iterator
     for QueryMatches<'query, 'tree, T, I>
 {
@@ -2679,12 +4386,18 @@ impl<'query, 'tree: 'query, T: TextProvider<I>, I: AsRef<[u8]>> Iterator
         unsafe {
             loop {
                 let mut m = MaybeUninit::<ffi::TSQueryMatch>::uninit();
-                if ffi::ts_query_cursor_next_match(self.ptr, m.as_mut_ptr()) {
+                let buffers = &mut *self.buffers;
+                let has_match = with_text_provider(
+                    self.ptr,
+                    &mut self.text_provider,
+                    &mut buffers.provider_text,
+                    || ffi::ts_query_cursor_next_match(self.ptr, m.as_mut_ptr()),
+                );
+                if has_match {
                     let result = QueryMatch::new(&m.assume_init(), self.ptr);
                     if result.satisfies_text_predicates(
                         self.query,
-                        &mut self.buffer1,
-                        &mut self.buffer2,
+                        &mut buffers.predicate_text,
                         &mut self.text_provider,
                     ) {
                         return Some(result);
@@ -2707,16 +4420,24 @@ impl<'query, 'tree: 'query, T: TextProvider<I>, I: AsRef<[u8]>> Iterator
             loop {
                 let mut capture_index = 0u32;
                 let mut m = MaybeUninit::<ffi::TSQueryMatch>::uninit();
-                if ffi::ts_query_cursor_next_capture(
+                let buffers = &mut *self.buffers;
+                let has_capture = with_text_provider(
                     self.ptr,
-                    m.as_mut_ptr(),
-                    core::ptr::addr_of_mut!(capture_index),
-                ) {
+                    &mut self.text_provider,
+                    &mut buffers.provider_text,
+                    || {
+                        ffi::ts_query_cursor_next_capture(
+                            self.ptr,
+                            m.as_mut_ptr(),
+                            core::ptr::addr_of_mut!(capture_index),
+                        )
+                    },
+                );
+                if has_capture {
                     let result = QueryMatch::new(&m.assume_init(), self.ptr);
                     if result.satisfies_text_predicates(
                         self.query,
-                        &mut self.buffer1,
-                        &mut self.buffer2,
+                        &mut buffers.predicate_text,
                         &mut self.text_provider,
                     ) {
                         return Some((result, capture_index as usize));
@@ -2807,7 +4528,12 @@ impl Drop for Query {
 
 impl Drop for QueryCursor {
     fn drop(&mut self) {
-        unsafe { ffi::ts_query_cursor_delete(self.ptr.as_ptr()) }
+        unsafe {
+            ffi::ts_query_cursor_delete(self.ptr.as_ptr());
+            if !self.buffers.is_null() {
+                drop(Box::from_raw(self.buffers));
+            }
+        }
     }
 }
 
@@ -2941,6 +4667,12 @@ impl fmt::Display for IncludedRangesError {
     }
 }
 
+impl fmt::Display for ParserConfigError {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "Invalid parser config")
+    }
+}
+
 impl fmt::Display for LanguageError {
     fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
         write!(
@@ -2951,6 +4683,35 @@ impl fmt::Display for LanguageError {
     }
 }
 
+impl LanguageLoadError {
+    fn check(
+        language: *const ffi::TSLanguage,
+        error: ffi::TSLanguageLoadError,
+    ) -> Result<Language, Self> {
+        if !language.is_null() {
+            return Ok(Language(language));
+        }
+        Err(match error {
+            ffi::TSLanguageLoadErrorIO => Self::IO,
+            ffi::TSLanguageLoadErrorVersion => Self::Version,
+            ffi::TSLanguageLoadErrorScanner => Self::Scanner,
+            _ => Self::Format,
+        })
+    }
+}
+
+impl fmt::Display for LanguageLoadError {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        let msg = match self {
+            Self::IO => "Failed to read the language data file",
+            Self::Format => "Invalid language data file",
+            Self::Version => "Incompatible language data file version",
+            Self::Scanner => "The language requires an external scanner",
+        };
+        f.write_str(msg)
+    }
+}
+
 impl fmt::Display for QueryError {
     fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
         let msg = match self.kind {
@@ -3109,13 +4870,89 @@ pub unsafe fn set_allocator(
     ffi::ts_set_allocator(new_malloc, new_calloc, new_realloc, new_free);
 }
 
+extern "C" {
+    static ts_current_free: unsafe extern "C" fn(ptr: *mut c_void);
+}
+
+unsafe extern "C" fn current_free(ptr: *mut c_void) {
+    ts_current_free(ptr);
+}
+
+/// Sets whether the core library should keep statistics about the memory it
+/// allocates, attributing each allocation to an [`AllocationCategory`].
+///
+/// Tracking wraps the allocation functions that are current when it is
+/// enabled, so it must be enabled after any call to [`set_allocator`].
+///
+/// # Safety
+///
+/// Like [`set_allocator`], this can only be called while no parsers, trees,
+/// queries or other objects created by the library exist.
+#[doc(alias = "ts_set_allocation_tracking")]
+pub unsafe fn set_allocation_tracking(enabled: bool) {
+    static mut UNTRACKED_FREE_FN: unsafe extern "C" fn(ptr: *mut c_void) = free;
+    if enabled == ffi::ts_allocation_tracking_enabled() {
+        return;
+    }
+    if enabled {
+        UNTRACKED_FREE_FN = FREE_FN;
+        FREE_FN = current_free;
+    } else {
+        FREE_FN = UNTRACKED_FREE_FN;
+    }
+    ffi::ts_set_allocation_tracking(enabled);
+}
+
+/// Checks whether the core library is keeping statistics about its
+/// allocations.
+#[doc(alias = "ts_allocation_tracking_enabled")]
+#[must_use]
+pub fn allocation_tracking_enabled() -> bool {
+    unsafe { ffi::ts_allocation_tracking_enabled() }
+}
+
+/// Gets the allocation statistics for the given category.
+#[doc(alias = "ts_allocation_stats")]
+#[must_use]
+pub fn allocation_stats(category: AllocationCategory) -> AllocationStats {
+    unsafe { ffi::ts_allocation_stats(category as ffi::TSAllocationCategory) }.into()
+}
+
+/// Gets the allocation statistics for all categories combined.
+///
+/// The peak is the highest number of bytes that were allocated at once, which
+/// can be lower than the sum of the peaks of each category.
+#[doc(alias = "ts_allocation_total_stats")]
+#[must_use]
+pub fn total_allocation_stats() -> AllocationStats {
+    unsafe { ffi::ts_allocation_total_stats() }.into()
+}
+
+/// Resets the allocation counts of every category to zero, and their peaks
+/// to the number of bytes that are currently allocated, so that the
+/// allocations made by a single operation can be measured.
+#[doc(alias = "ts_allocation_stats_reset")]
+pub fn reset_allocation_stats() {
+    unsafe { ffi::ts_allocation_stats_reset() }
+}
+
 #[cfg(feature = "std")]
 impl error::Error for IncludedRangesError {}
 #[cfg(feature = "std")]
 impl error::Error for LanguageError {}
 #[cfg(feature = "std")]
+impl error::Error for LanguageLoadError {}
+#[cfg(feature = "std")]
+impl error::Error for ParserConfigError {}
+#[cfg(feature = "std")]
 impl error::Error for QueryError {}
 
+unsafe impl Send for FlatTree {}
+unsafe impl Sync for FlatTree {}
+
+unsafe impl Send for FlatTreeCursor<'_> {}
+unsafe impl Sync for FlatTreeCursor<'_> {}
+
 unsafe impl Send for Language {}
 unsafe impl Sync for Language {}
 
@@ -3140,5 +4977,8 @@ unsafe impl Sync for QueryCursor {}
 unsafe impl Send for Tree {}
 unsafe impl Sync for Tree {}
 
+unsafe impl Send for TreeSnapshot {}
+unsafe impl Sync for TreeSnapshot {}
+
 unsafe impl Send for TreeCursor<'_> {}
 unsafe impl Sync for TreeCursor<'_> {}
@@ -4,6 +4,7 @@ use std::{
     fmt,
     mem::{self, MaybeUninit},
     os::raw::c_char,
+    path::Path,
 };
 
 pub use wasmtime_c_api::wasmtime;
@@ -26,6 +27,10 @@ pub struct wasm_engine_t {
 
 pub struct WasmStore(*mut ffi::TSWasmStore);
 
+/// A cache of compiled wasm modules that can be shared by many [`WasmStore`]s,
+/// so that each language's wasm code is only compiled once.
+pub struct WasmModuleCache(*mut ffi::TSWasmModuleCache);
+
 #[derive(Debug, PartialEq, Eq)]
 pub struct WasmError {
     pub kind: WasmErrorKind,
@@ -56,6 +61,20 @@ impl WasmStore {
         }
     }
 
+    /// Create a store that takes its compiled modules from the given cache,
+    /// and uses the cache's engine.
+    pub fn with_cache(cache: &WasmModuleCache) -> Result<Self, WasmError> {
+        unsafe {
+            let mut error = MaybeUninit::<ffi::TSWasmError>::uninit();
+            let store = ffi::ts_wasm_store_new_with_cache(cache.0, error.as_mut_ptr());
+            if store.is_null() {
+                Err(WasmError::new(error.assume_init()))
+            } else {
+                Ok(Self(store))
+            }
+        }
+    }
+
     pub fn load_language(&mut self, name: &str, bytes: &[u8]) -> Result<Language, WasmError> {
         let name = CString::new(name).unwrap();
         unsafe {
@@ -81,6 +100,39 @@ impl WasmStore {
     }
 }
 
+impl WasmModuleCache {
+    #[must_use]
+    pub fn new(engine: &wasmtime::Engine) -> Self {
+        Self(unsafe {
+            ffi::ts_wasm_module_cache_new(
+                (engine as *const wasmtime::Engine as *mut wasmtime::Engine).cast(),
+            )
+        })
+    }
+
+    /// Also store precompiled modules in the given directory, so that later
+    /// processes can load them instead of compiling them again.
+    ///
+    /// # Safety
+    ///
+    /// Precompiled modules are loaded without being validated, so the
+    /// directory must only be writable by trusted users. This must be called
+    /// before any store is created with the cache.
+    pub unsafe fn set_directory(&mut self, path: &Path) {
+        let path = CString::new(path.to_string_lossy().as_bytes()).unwrap();
+        ffi::ts_wasm_module_cache_set_directory(self.0, path.as_ptr());
+    }
+}
+
+impl Drop for WasmModuleCache {
+    fn drop(&mut self) {
+        unsafe { ffi::ts_wasm_module_cache_delete(self.0) };
+    }
+}
+
+unsafe impl Send for WasmModuleCache {}
+unsafe impl Sync for WasmModuleCache {}
+
 impl WasmError {
     unsafe fn new(error: ffi::TSWasmError) -> Self {
         let message = CStr::from_ptr(error.message).to_str().unwrap().to_string();
@@ -1,4 +1,5 @@
 #include "array.h"
+#include "lexer.h"
 #include "point.h"
 
 #include <emscripten.h>
@@ -8,9 +9,18 @@
 /* Section - Data marshaling */
 /*****************************/
 
+// In a build with wasm threads, each thread that uses the library has its own
+// transfer buffer and scratch cursors, so threads can call into the binding
+// concurrently. Each thread must call `ts_init` to find its transfer buffer.
+#ifdef __EMSCRIPTEN_PTHREADS__
+#define THREAD_LOCAL _Thread_local
+#else
+#define THREAD_LOCAL
+#endif
+
 static const uint32_t INPUT_BUFFER_SIZE = 10 * 1024;
 
-const void *TRANSFER_BUFFER[12] = {
+THREAD_LOCAL const void *TRANSFER_BUFFER[12] = {
   NULL, NULL, NULL, NULL,
   NULL, NULL, NULL, NULL,
   NULL, NULL, NULL, NULL,
@@ -198,6 +208,27 @@ void ts_parser_included_ranges_wasm(TSParser *self) {
   TRANSFER_BUFFER[1] = copied_ranges;
 }
 
+/*******************/
+/* Section - Lexer */
+/*******************/
+
+// These are imported by external scanners, via the lexer helpers in
+// `parser.h`. Here the scanners share memory with the library, so they can
+// just operate on the lexer directly.
+
+uint32_t tree_sitter_lexer_peek(TSLexer *lexer, int32_t *characters, uint32_t capacity) {
+  return ts_lexer_decode_ahead((Lexer *)lexer, characters, capacity);
+}
+
+uint32_t tree_sitter_lexer_advance_by(TSLexer *lexer, uint32_t count, bool skip) {
+  uint32_t result = 0;
+  while (result < count && !lexer->eof(lexer)) {
+    lexer->advance(lexer, skip);
+    result++;
+  }
+  return result;
+}
+
 /**********************/
 /* Section - Language */
 /**********************/
@@ -420,8 +451,8 @@ void ts_tree_cursor_current_node_wasm(const TSTree *tree) {
 /* Section - Node */
 /******************/
 
-static TSTreeCursor scratch_cursor = {0};
-static TSQueryCursor *scratch_query_cursor = NULL;
+static THREAD_LOCAL TSTreeCursor scratch_cursor = {0};
+static THREAD_LOCAL TSQueryCursor *scratch_query_cursor = NULL;
 
 uint16_t ts_node_symbol_wasm(const TSTree *tree) {
   TSNode node = unmarshal_node(tree);
@@ -738,6 +769,91 @@ void ts_node_descendants_of_type_wasm(
   TRANSFER_BUFFER[1] = result.contents;
 }
 
+// The number of 32-bit values in each node record written by
+// `ts_node_flatten_wasm`, and the bits of each record's flags value.
+static const uint32_t FLAT_NODE_SIZE = 13;
+enum {
+  FLAT_NODE_IS_NAMED = 1 << 0,
+  FLAT_NODE_IS_MISSING = 1 << 1,
+  FLAT_NODE_IS_EXTRA = 1 << 2,
+  FLAT_NODE_IS_ERROR = 1 << 3,
+  FLAT_NODE_HAS_ERROR = 1 << 4,
+  FLAT_NODE_HAS_CHANGES = 1 << 5,
+};
+
+// Write a record for the given node and each of its descendants, in preorder,
+// into one array, so that JavaScript can read a whole tree without a call per
+// node. Nodes that don't intersect the given range of code units are omitted.
+// Each record holds the node's id, its alias context, its type id, its field
+// id, its start and end index, its start and end point, its child count, the
+// index of its parent's record, and its flags.
+void ts_node_flatten_wasm(const TSTree *tree, uint32_t start_index, uint32_t end_index) {
+  TSNode node = unmarshal_node(tree);
+  Array(uint32_t) result = array_new();
+  Array(uint32_t) parents = array_new();
+
+  ts_tree_cursor_reset(&scratch_cursor, node);
+  for (;;) {
+    TSNode descendant = ts_tree_cursor_current_node(&scratch_cursor);
+    uint32_t descendant_start = byte_to_code_unit(ts_node_start_byte(descendant));
+    uint32_t descendant_end = byte_to_code_unit(ts_node_end_byte(descendant));
+
+    // Stop walking upon reaching a node after the selected range.
+    if (descendant_start > end_index) break;
+
+    // Record every node that intersects the range, and visit its children.
+    // Skip over any node before the range.
+    bool visit_children = false;
+    if (descendant_end >= start_index) {
+      TSPoint start_point = ts_node_start_point(descendant);
+      TSPoint end_point = ts_node_end_point(descendant);
+      uint32_t flags = 0;
+      if (ts_node_is_named(descendant)) flags |= FLAT_NODE_IS_NAMED;
+      if (ts_node_is_missing(descendant)) flags |= FLAT_NODE_IS_MISSING;
+      if (ts_node_is_extra(descendant)) flags |= FLAT_NODE_IS_EXTRA;
+      if (ts_node_is_error(descendant)) flags |= FLAT_NODE_IS_ERROR;
+      if (ts_node_has_error(descendant)) flags |= FLAT_NODE_HAS_ERROR;
+      if (ts_node_has_changes(descendant)) flags |= FLAT_NODE_HAS_CHANGES;
+
+      uint32_t record_index = result.size / FLAT_NODE_SIZE;
+      array_grow_by(&result, FLAT_NODE_SIZE);
+      uint32_t *record = &result.contents[result.size - FLAT_NODE_SIZE];
+      record[0] = (uint32_t)descendant.id;
+      record[1] = descendant.context[3];
+      record[2] = ts_node_symbol(descendant);
+      record[3] = ts_tree_cursor_current_field_id(&scratch_cursor);
+      record[4] = descendant_start;
+      record[5] = descendant_end;
+      record[6] = start_point.row;
+      record[7] = byte_to_code_unit(start_point.column);
+      record[8] = end_point.row;
+      record[9] = byte_to_code_unit(end_point.column);
+      record[10] = ts_node_child_count(descendant);
+      record[11] = parents.size ? *array_back(&parents) : UINT32_MAX;
+      record[12] = flags;
+
+      if (ts_tree_cursor_goto_first_child(&scratch_cursor)) {
+        array_push(&parents, record_index);
+        visit_children = true;
+      }
+    }
+
+    if (!visit_children) {
+      bool has_next = false;
+      while (!(has_next = ts_tree_cursor_goto_next_sibling(&scratch_cursor))) {
+        if (!parents.size) break;
+        ts_tree_cursor_goto_parent(&scratch_cursor);
+        array_pop(&parents);
+      }
+      if (!has_next) break;
+    }
+  }
+
+  array_delete(&parents);
+  TRANSFER_BUFFER[0] = (const void *)(result.size / FLAT_NODE_SIZE);
+  TRANSFER_BUFFER[1] = result.contents;
+}
+
 int ts_node_is_named_wasm(const TSTree *tree) {
   TSNode node = unmarshal_node(tree);
   return ts_node_is_named(node);
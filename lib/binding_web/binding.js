@@ -10,6 +10,7 @@ const SIZE_OF_CURSOR = 4 * SIZE_OF_INT;
 const SIZE_OF_NODE = 5 * SIZE_OF_INT;
 const SIZE_OF_POINT = 2 * SIZE_OF_INT;
 const SIZE_OF_RANGE = 2 * SIZE_OF_INT + 2 * SIZE_OF_POINT;
+const FLAT_NODE_SIZE = 13;
 const ZERO_POINT = {row: 0, column: 0};
 const QUERY_WORD_REGEX = /[\w-.]*/g;
 
@@ -516,6 +517,14 @@ class Node {
     return result;
   }
 
+  flatten(startIndex = 0, endIndex = 0xFFFFFFFF) {
+    marshalNode(this);
+    C._ts_node_flatten_wasm(this.tree[0], startIndex, endIndex);
+    const count = getValue(TRANSFER_BUFFER, 'i32');
+    const address = getValue(TRANSFER_BUFFER + SIZE_OF_INT, 'i32');
+    return new FlatTree(INTERNAL, this.tree, address, count);
+  }
+
   get nextSibling() {
     marshalNode(this);
     C._ts_node_next_sibling_wasm(this.tree[0]);
@@ -618,6 +627,105 @@ class Node {
   }
 }
 
+// A preorder list of nodes, stored in wasm memory as records of 32-bit
+// values, so that a whole tree can be read without a wasm call per node.
+// The layout of each record matches `ts_node_flatten_wasm` in `binding.c`.
+class FlatTree {
+  constructor(internal, tree, address, length) {
+    assertInternal(internal);
+    this.tree = tree;
+    this.length = length;
+    this[0] = address;
+  }
+
+  delete() {
+    C._free(this[0]);
+    this[0] = 0;
+  }
+
+  get data() {
+    return new Uint32Array(HEAPU32.buffer, this[0], this.length * FLAT_NODE_SIZE);
+  }
+
+  field(index, offset) {
+    return HEAPU32[(this[0] >> 2) + index * FLAT_NODE_SIZE + offset];
+  }
+
+  node(index) {
+    const result = new Node(INTERNAL, this.tree);
+    result.id = this.field(index, 0) | 0;
+    result.startIndex = this.field(index, 4);
+    result.startPosition = this.startPosition(index);
+    result[0] = this.field(index, 1);
+    return result;
+  }
+
+  typeId(index) {
+    return this.field(index, 2);
+  }
+
+  type(index) {
+    return this.tree.language.types[this.typeId(index)] || 'ERROR';
+  }
+
+  fieldId(index) {
+    return this.field(index, 3);
+  }
+
+  fieldName(index) {
+    return this.tree.language.fields[this.fieldId(index)] || null;
+  }
+
+  startIndex(index) {
+    return this.field(index, 4);
+  }
+
+  endIndex(index) {
+    return this.field(index, 5);
+  }
+
+  startPosition(index) {
+    return {row: this.field(index, 6), column: this.field(index, 7)};
+  }
+
+  endPosition(index) {
+    return {row: this.field(index, 8), column: this.field(index, 9)};
+  }
+
+  childCount(index) {
+    return this.field(index, 10);
+  }
+
+  parentIndex(index) {
+    const result = this.field(index, 11);
+    return result === 0xFFFFFFFF ? -1 : result;
+  }
+
+  isNamed(index) {
+    return (this.field(index, 12) & 1) !== 0;
+  }
+
+  isMissing(index) {
+    return (this.field(index, 12) & 2) !== 0;
+  }
+
+  isExtra(index) {
+    return (this.field(index, 12) & 4) !== 0;
+  }
+
+  isError(index) {
+    return (this.field(index, 12) & 8) !== 0;
+  }
+
+  hasError(index) {
+    return (this.field(index, 12) & 16) !== 0;
+  }
+
+  hasChanges(index) {
+    return (this.field(index, 12) & 32) !== 0;
+  }
+}
+
 class TreeCursor {
   constructor(internal, tree) {
     assertInternal(internal);
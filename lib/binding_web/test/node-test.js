@@ -550,6 +550,82 @@ describe('Node', () => {
     });
   });
 
+  describe('.flatten(startIndex, endIndex)', () => {
+    it('returns the node and all of its descendants in preorder', () => {
+      tree = parser.parse('let a = 5; b(c);');
+      const nodes = getAllNodes(tree);
+      const flatTree = tree.rootNode.flatten();
+      assert.equal(flatTree.length, nodes.length);
+      assert.equal(flatTree.data.length, nodes.length * 13);
+      for (let i = 0; i < nodes.length; i++) {
+        const node = nodes[i];
+        assert(flatTree.node(i).equals(node));
+        assert.equal(flatTree.type(i), node.type);
+        assert.equal(flatTree.isNamed(i), node.isNamed);
+        assert.equal(flatTree.startIndex(i), node.startIndex);
+        assert.equal(flatTree.endIndex(i), node.endIndex);
+        assert.deepEqual(flatTree.startPosition(i), node.startPosition);
+        assert.deepEqual(flatTree.endPosition(i), node.endPosition);
+        assert.equal(flatTree.childCount(i), node.childCount);
+        const parentIndex = flatTree.parentIndex(i);
+        if (i === 0) {
+          assert.equal(parentIndex, -1);
+        } else {
+          assert(nodes[parentIndex].equals(node.parent));
+        }
+      }
+
+      const declarator = nodes.findIndex((node) => node.type === 'variable_declarator');
+      assert.equal(flatTree.fieldName(declarator + 1), 'name');
+      assert.equal(flatTree.fieldName(declarator + 3), 'value');
+      flatTree.delete();
+    });
+
+    it('omits nodes outside of the given range', () => {
+      tree = parser.parse('a + 1 * b * 2 + c + 3');
+      const flatTree = tree.rootNode.flatten(8, 9);
+      const types = [];
+      for (let i = 0; i < flatTree.length; i++) {
+        if (flatTree.isNamed(i)) types.push(flatTree.type(i));
+      }
+      assert.deepEqual(types, [
+        'program',
+        'expression_statement',
+        'binary_expression',
+        'binary_expression',
+        'binary_expression',
+        'binary_expression',
+        'binary_expression',
+        'identifier',
+      ]);
+      flatTree.delete();
+    });
+
+    it('marks the nodes that have changed after an edit', () => {
+      tree = parser.parse('a + b');
+      tree.edit({
+        startIndex: 4,
+        oldEndIndex: 5,
+        newEndIndex: 5,
+        startPosition: {row: 0, column: 4},
+        oldEndPosition: {row: 0, column: 5},
+        newEndPosition: {row: 0, column: 5},
+      });
+      const flatTree = tree.rootNode.flatten();
+      const changedTypes = [];
+      for (let i = 0; i < flatTree.length; i++) {
+        if (flatTree.hasChanges(i)) changedTypes.push(flatTree.type(i));
+      }
+      assert.deepEqual(changedTypes, [
+        'program',
+        'expression_statement',
+        'binary_expression',
+        'identifier',
+      ]);
+      flatTree.delete();
+    });
+  });
+
   describe.skip('.closest(type)', () => {
     it('returns the closest ancestor of the given type', () => {
       tree = parser.parse('a(b + -d.e)');
@@ -109,10 +109,36 @@ declare module 'web-tree-sitter' {
       namedDescendantForPosition(position: Point): SyntaxNode;
       namedDescendantForPosition(startPosition: Point, endPosition: Point): SyntaxNode;
       descendantsOfType(types: String | Array<String>, startPosition?: Point, endPosition?: Point): Array<SyntaxNode>;
+      flatten(startIndex?: number, endIndex?: number): FlatTree;
 
       walk(): TreeCursor;
     }
 
+    export interface FlatTree {
+      readonly tree: Tree;
+      readonly length: number;
+      readonly data: Uint32Array;
+
+      delete(): void;
+      node(index: number): SyntaxNode;
+      typeId(index: number): number;
+      type(index: number): string;
+      fieldId(index: number): number;
+      fieldName(index: number): string | null;
+      startIndex(index: number): number;
+      endIndex(index: number): number;
+      startPosition(index: number): Point;
+      endPosition(index: number): Point;
+      childCount(index: number): number;
+      parentIndex(index: number): number;
+      isNamed(index: number): boolean;
+      isMissing(index: number): boolean;
+      isExtra(index: number): boolean;
+      isError(index: number): boolean;
+      hasError(index: number): boolean;
+      hasChanges(index: number): boolean;
+    }
+
     export interface TreeCursor {
       nodeType: string;
       nodeTypeId: number;
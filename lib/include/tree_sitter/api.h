@@ -46,11 +46,16 @@ typedef struct TSParser TSParser;
 typedef struct TSTree TSTree;
 typedef struct TSQuery TSQuery;
 typedef struct TSQueryCursor TSQueryCursor;
+typedef struct TSQueryMatchSet TSQueryMatchSet;
 typedef struct TSLookaheadIterator TSLookaheadIterator;
+typedef struct TSFlatTree TSFlatTree;
+typedef struct TSTreeSnapshot TSTreeSnapshot;
+typedef struct TSLexer TSLexer;
 
 typedef enum TSInputEncoding {
   TSInputEncodingUTF8,
   TSInputEncodingUTF16,
+  TSInputEncodingLatin1,
 } TSInputEncoding;
 
 typedef enum TSSymbolType {
@@ -77,6 +82,12 @@ typedef struct TSInput {
   TSInputEncoding encoding;
 } TSInput;
 
+typedef struct TSInputSpan {
+  uint32_t byte_offset;
+  const char *bytes;
+  uint32_t length;
+} TSInputSpan;
+
 typedef enum TSLogType {
   TSLogTypeParse,
   TSLogTypeLex,
@@ -87,6 +98,58 @@ typedef struct TSLogger {
   void (*log)(void *payload, TSLogType log_type, const char *buffer);
 } TSLogger;
 
+typedef struct TSParserStats {
+  uint32_t lexed_token_count;
+  uint32_t heap_token_count;
+  uint32_t cached_token_count;
+  uint32_t token_cache_miss_count;
+  uint32_t reused_node_count;
+  uint32_t reuse_miss_count;
+  uint32_t version_split_count;
+  uint32_t version_merge_count;
+  uint32_t recovery_count;
+  uint32_t bounded_recovery_count;
+  uint64_t operation_count;
+  uint64_t lex_time_micros;
+  uint64_t recovery_time_micros;
+  uint64_t total_time_micros;
+} TSParserStats;
+
+typedef enum TSAllocationCategory {
+  TSAllocationCategoryOther,
+  TSAllocationCategorySubtreePool,
+  TSAllocationCategoryStackNodes,
+  TSAllocationCategoryIncludedRanges,
+  TSAllocationCategoryQueryCursorStates,
+  TSAllocationCategoryQueryCaptureLists,
+  TSAllocationCategoryWasmStore,
+} TSAllocationCategory;
+
+typedef struct TSAllocationStats {
+  size_t allocation_count;
+  size_t live_allocation_count;
+  size_t live_bytes;
+  size_t peak_bytes;
+} TSAllocationStats;
+
+typedef struct TSMemoryReport {
+  size_t exclusive_bytes;
+  size_t shared_bytes;
+  size_t scanner_state_bytes;
+  uint32_t inline_node_count;
+  uint32_t heap_node_count;
+} TSMemoryReport;
+
+typedef struct TSParserConfig {
+  uint32_t max_version_count;
+  uint32_t max_version_count_overflow;
+  uint32_t max_summary_depth;
+  uint32_t max_cost_difference;
+  uint32_t adaptive_threshold;
+  uint32_t adaptive_min_version_count;
+  uint32_t recovery_budget_per_byte;
+} TSParserConfig;
+
 typedef struct TSInputEdit {
   uint32_t start_byte;
   uint32_t old_end_byte;
@@ -102,12 +165,61 @@ typedef struct TSNode {
   const TSTree *tree;
 } TSNode;
 
+typedef struct TSStreamCallback {
+  void *payload;
+  void (*emit)(void *payload, TSNode node);
+} TSStreamCallback;
+
+typedef struct TSParseState {
+  void *payload;
+  uint32_t current_byte_offset;
+  uint64_t operation_count;
+  bool has_error;
+} TSParseState;
+
+typedef struct TSParseOptions {
+  void *payload;
+  bool (*progress_callback)(TSParseState *state);
+  uint32_t byte_budget;
+} TSParseOptions;
+
 typedef struct TSTreeCursor {
   const void *tree;
   const void *id;
   uint32_t context[3];
 } TSTreeCursor;
 
+typedef struct TSTreeCursorWalkOptions {
+  const uint8_t *symbols;
+  uint32_t symbol_count;
+  uint32_t max_depth;
+  bool named_only;
+} TSTreeCursorWalkOptions;
+
+typedef struct TSTreeCursorWalkEntry {
+  TSNode node;
+  TSFieldId field_id;
+  uint32_t depth;
+} TSTreeCursorWalkEntry;
+
+typedef struct TSFlatNode {
+  TSSymbol symbol;
+  TSFieldId field_id;
+  uint32_t start_byte;
+  uint32_t end_byte;
+  TSPoint start_point;
+  TSPoint end_point;
+  bool is_named;
+  bool is_extra;
+  bool is_missing;
+  bool has_error;
+} TSFlatNode;
+
+typedef struct TSFlatTreeCursor {
+  const TSFlatTree *tree;
+  uint32_t index;
+} TSFlatTreeCursor;
+
 typedef struct TSQueryCapture {
   TSNode node;
   uint32_t index;
@@ -139,6 +251,22 @@ typedef struct TSQueryPredicateStep {
   uint32_t value_id;
 } TSQueryPredicateStep;
 
+typedef struct TSQueryTextProvider {
+  void *payload;
+  const char *(*text)(void *payload, TSNode node, uint32_t *length);
+} TSQueryTextProvider;
+
+typedef struct TSQueryStoredCapture {
+  TSRange range;
+  uint32_t index;
+} TSQueryStoredCapture;
+
+typedef struct TSQueryStoredMatch {
+  uint32_t pattern_index;
+  uint32_t capture_count;
+  const TSQueryStoredCapture *captures;
+} TSQueryStoredMatch;
+
 typedef enum TSQueryError {
   TSQueryErrorNone = 0,
   TSQueryErrorSyntax,
@@ -149,6 +277,22 @@ typedef enum TSQueryError {
   TSQueryErrorLanguage,
 } TSQueryError;
 
+typedef enum TSLanguageLoadError {
+  TSLanguageLoadErrorNone = 0,
+  TSLanguageLoadErrorIO,
+  TSLanguageLoadErrorFormat,
+  TSLanguageLoadErrorVersion,
+  TSLanguageLoadErrorScanner,
+} TSLanguageLoadError;
+
+typedef struct TSExternalScanner {
+  void *(*create)(void);
+  void (*destroy)(void *);
+  bool (*scan)(void *, TSLexer *, const bool *symbol_whitelist);
+  unsigned (*serialize)(void *, char *);
+  void (*deserialize)(void *, const char *, unsigned);
+} TSExternalScanner;
+
 /********************/
 /* Section - Parser */
 /********************/
@@ -208,6 +352,37 @@ bool ts_parser_set_included_ranges(
   uint32_t count
 );
 
+/**
+ * Replace some of the ranges of text that the parser should include when
+ * parsing, without copying the rest of them.
+ *
+ * The `old_count` ranges starting at `index` are replaced with the `count`
+ * ranges in the given array. The resulting ranges must satisfy the same
+ * requirements as those passed to [`ts_parser_set_included_ranges`]. If they
+ * don't, or if the replaced ranges extend past the end of the parser's
+ * ranges, the operation will fail, the ranges will not be changed, and this
+ * function will return `false`. If no ranges remain, the entire document will
+ * be parsed.
+ */
+bool ts_parser_splice_included_ranges(
+  TSParser *self,
+  uint32_t index,
+  uint32_t old_count,
+  const TSRange *ranges,
+  uint32_t count
+);
+
+/**
+ * Edit the ranges of text that the parser will include when parsing, to keep
+ * them in sync with source code that has been edited.
+ *
+ * This adjusts the ranges in the same way as [`ts_tree_edit`] adjusts the
+ * old syntax tree's ranges, so that when both are edited with the same edits,
+ * no part of the document is reparsed just because its ranges were set anew.
+ * Ranges that end before the edit are not visited.
+ */
+void ts_parser_edit_included_ranges(TSParser *self, const TSInputEdit *edit);
+
 /**
  * Get the ranges of text that the parser will include when parsing.
  *
@@ -220,6 +395,164 @@ const TSRange *ts_parser_included_ranges(
   uint32_t *count
 );
 
+/**
+ * Set whether the parser should allocate the nodes of each new syntax tree
+ * from an arena.
+ *
+ * In arena mode, the nodes created during a parse are allocated in large slabs
+ * instead of individually, and they are all freed at once when the last tree
+ * that uses them is deleted, rather than by visiting every node. This makes
+ * both parsing and [`ts_tree_delete`] faster for large documents.
+ *
+ * Incremental parsing still works: when an arena-allocated tree is passed as
+ * the `old_tree`, the new tree keeps the old tree's arena alive for as long as
+ * it may share nodes with it. Because of this, a long chain of incremental
+ * parses may hold onto memory from earlier versions of the document until
+ * the document is parsed again from scratch.
+ *
+ * This setting takes effect at the start of the next parse. It is disabled
+ * by default.
+ */
+void ts_parser_set_arena_enabled(TSParser *self, bool enabled);
+
+/**
+ * Get whether the parser allocates the nodes of new syntax trees from an arena.
+ */
+bool ts_parser_arena_enabled(const TSParser *self);
+
+/**
+ * Set whether the parser should build an index of its language's parse table.
+ *
+ * Most of the states in a large grammar's parse table are stored in a compact
+ * form that must be searched linearly whenever the parser looks up an action.
+ * When this setting is enabled, the parser builds a bitmap index over those
+ * states, so that every lookup takes constant time. The index is built once
+ * each time a language is assigned, and uses additional memory proportional
+ * to the number of states times the number of symbols in the grammar.
+ *
+ * This is disabled by default.
+ */
+void ts_parser_set_lookup_index_enabled(TSParser *self, bool enabled);
+
+/**
+ * Get whether the parser builds an index of its language's parse table.
+ */
+bool ts_parser_lookup_index_enabled(const TSParser *self);
+
+/**
+ * Set the number of chunks of source code that the parser remembers from its
+ * input's [`read`] callback.
+ *
+ * By default, the parser calls the callback again whenever it needs text
+ * outside of the chunk that it read most recently, which happens often when
+ * it moves back to an earlier position during incremental parsing or error
+ * recovery. When this is set to a non-zero value, the parser keeps that many
+ * of the most recently used chunks, and only calls the callback for text that
+ * none of them contain.
+ *
+ * When this is enabled, every buffer that the callback returns must remain
+ * valid and unchanged until the call to [`ts_parser_parse`] returns.
+ *
+ * This is not needed for [`ts_parser_parse_string`], which never calls a
+ * callback once it has the whole buffer. It is zero by default.
+ *
+ * [`read`]: TSInput::read
+ */
+void ts_parser_set_chunk_cache_size(TSParser *self, uint32_t size);
+
+/**
+ * Get the number of chunks of source code that the parser remembers from its
+ * input's `read` callback.
+ */
+uint32_t ts_parser_chunk_cache_size(const TSParser *self);
+
+/**
+ * Set the limits that the parser places on its search for a valid parse.
+ *
+ * When the input is ambiguous or contains errors, the parser pursues several
+ * interpretations of it at once, using a separate version of its stack for
+ * each one. These settings bound that work:
+ *
+ * 1. `max_version_count` - The number of stack versions that are kept after
+ *    each token. The least promising versions beyond this are discarded.
+ * 2. `max_version_count_overflow` - The number of extra versions that may be
+ *    created while processing a single token, before they are discarded.
+ * 3. `max_summary_depth` - The number of stack entries that are examined
+ *    when searching for a recovery from a syntax error.
+ * 4. `max_cost_difference` - The difference in error cost, scaled by the
+ *    number of nodes since the error, at which a version is discarded in
+ *    favor of a better one instead of being kept as an alternative.
+ *
+ * If `adaptive_threshold` is non-zero, the parser also lowers its limit on
+ * the number of versions by one each time the number of versions has stayed
+ * at that limit for more than `adaptive_threshold` consecutive tokens, down
+ * to `adaptive_min_version_count`. The limit is restored at the start of each
+ * new parse. This bounds the time spent parsing ambiguous or malformed input,
+ * at the cost of less precise error recovery.
+ *
+ * If `recovery_budget_per_byte` is non-zero, it limits the work that the
+ * parser spends searching for ways to recover from syntax errors, such as
+ * examining the entries of its stack, to about that many units for each byte
+ * of input that it has consumed. Once that budget is used up, the parser
+ * recovers by skipping tokens, only returning to states near the top of its
+ * stack, until it has consumed enough input to earn more budget. This makes
+ * the parse time of binary, minified or adversarial input grow linearly
+ * with its length, at the cost of larger `ERROR` nodes.
+ *
+ * Pass `NULL` to restore the defaults, which are the values returned by
+ * [`ts_parser_config`] for a new parser, with adaptive mode and the recovery
+ * budget disabled. This returns `false` and leaves the settings unchanged if
+ * `max_version_count` is zero, if the sum of `max_version_count` and
+ * `max_version_count_overflow` does not fit in 32 bits, or if adaptive mode
+ * is enabled and `adaptive_min_version_count` is zero or greater than
+ * `max_version_count`.
+ */
+bool ts_parser_set_config(TSParser *self, const TSParserConfig *config);
+
+/**
+ * Get the limits that the parser places on its search for a valid parse.
+ */
+TSParserConfig ts_parser_config(const TSParser *self);
+
+/**
+ * Set whether the parser should collect statistics about its parses.
+ *
+ * When this is enabled, the parser counts the work done during each call to
+ * [`ts_parser_parse`]: the number of tokens that were lexed, the number that
+ * were taken from its cache of recently lexed tokens, the number of times
+ * that cache had no usable token, the number of nodes that were or
+ * could not be reused from the old tree, the number of times its stack split
+ * into several versions or merged them back together, the number of error
+ * recoveries, and how many of those were limited because the parser's
+ * `recovery_budget_per_byte` was used up. It also counts the operations
+ * that the parse performed: the parse actions applied to the stack, plus the
+ * stack entries examined and the versions created while recovering from
+ * errors. Unlike the timings, which it also measures for lexing, error
+ * recovery and the parse as a whole, this count is deterministic, so dividing
+ * it by the length of the input gives a stable measure of how expensive a
+ * document is to parse.
+ *
+ * The statistics are cleared at the start of each new parse. If a parse is
+ * halted by a timeout or a cancellation and later resumed, they accumulate
+ * across both calls.
+ *
+ * This is disabled by default.
+ */
+void ts_parser_set_stats_enabled(TSParser *self, bool enabled);
+
+/**
+ * Get whether the parser collects statistics about its parses.
+ */
+bool ts_parser_stats_enabled(const TSParser *self);
+
+/**
+ * Get the statistics collected during the parser's most recent parse.
+ *
+ * All of the values are zero unless statistics were enabled with
+ * [`ts_parser_set_stats_enabled`].
+ */
+TSParserStats ts_parser_stats(const TSParser *self);
+
 /**
  * Use the parser to parse some source code and create a syntax tree.
  *
@@ -242,10 +575,12 @@ const TSRange *ts_parser_included_ranges(
  * 2. [`payload`]: An arbitrary pointer that will be passed to each invocation
  *    of the [`read`] function.
  * 3. [`encoding`]: An indication of how the text is encoded. Either
- *    `TSInputEncodingUTF8` or `TSInputEncodingUTF16`.
+ *    `TSInputEncodingUTF8`, `TSInputEncodingUTF16`, or `TSInputEncodingLatin1`.
+ *    Latin1 text is read one byte per character, so it can also be used for
+ *    ASCII text.
  *
  * This function returns a syntax tree on success, and `NULL` on failure. There
- * are three possible reasons for failure:
+ * are four possible reasons for failure:
  * 1. The parser does not have a language assigned. Check for this using the
       [`ts_parser_language`] function.
  * 2. Parsing was cancelled due to a timeout that was set by an earlier call to
@@ -257,6 +592,9 @@ const TSRange *ts_parser_included_ranges(
  *    earlier call to [`ts_parser_set_cancellation_flag`]. You can resume parsing
  *    from where the parser left out by calling [`ts_parser_parse`] again with
  *    the same arguments.
+ * 4. Parsing was halted by the progress callback or the byte budget that were
+ *    passed to [`ts_parser_parse_with_options`]. You can resume parsing in
+ *    the same way.
  *
  * [`read`]: TSInput::read
  * [`payload`]: TSInput::payload
@@ -274,6 +612,10 @@ TSTree *ts_parser_parse(
  * The first two parameters are the same as in the [`ts_parser_parse`] function
  * above. The second two parameters indicate the location of the buffer and its
  * length in bytes.
+ *
+ * Because the whole buffer is available up front, the parser reads from it
+ * directly instead of requesting the text in chunks, so this is the fastest
+ * way to parse a document that is already in memory.
  */
 TSTree *ts_parser_parse_string(
   TSParser *self,
@@ -286,7 +628,7 @@ TSTree *ts_parser_parse_string(
  * Use the parser to parse some source code stored in one contiguous buffer with
  * a given encoding. The first four parameters work the same as in the
  * [`ts_parser_parse_string`] method above. The final parameter indicates whether
- * the text is encoded as UTF8 or UTF16.
+ * the text is encoded as UTF8, UTF16, or Latin1.
  */
 TSTree *ts_parser_parse_string_encoding(
   TSParser *self,
@@ -296,6 +638,102 @@ TSTree *ts_parser_parse_string_encoding(
   TSInputEncoding encoding
 );
 
+/**
+ * Use the parser to parse some source code that is stored in several buffers,
+ * such as the leaves of a rope. The first two parameters are the same as in the
+ * [`ts_parser_parse`] function above. The next two parameters are an array of
+ * spans, ordered by their byte offsets, which together contain the whole text
+ * of the document. The final parameter indicates whether the text is encoded as
+ * UTF8, UTF16, or Latin1.
+ *
+ * Each span must begin where the previous one ends, the first one must begin
+ * at offset zero, and their total length must fit in a `uint32_t`. Otherwise,
+ * this function returns `NULL` without parsing anything. It also returns `NULL`
+ * in the same cases as [`ts_parser_parse`], so use
+ * [`ts_input_spans_are_valid`] to tell invalid spans apart from a parse that
+ * can be resumed. As with the [`read`] function of a [`TSInput`], a character
+ * should not be split between two spans.
+ *
+ * The parser finds the text at a given position by searching the spans
+ * directly, instead of calling a function to read each chunk, so this is faster
+ * than [`ts_parser_parse`] for documents that are split into many small pieces.
+ * The spans are not copied: the array and the text that it points to must stay
+ * valid until this function returns.
+ */
+TSTree *ts_parser_parse_spans(
+  TSParser *self,
+  const TSTree *old_tree,
+  const TSInputSpan *spans,
+  uint32_t span_count,
+  TSInputEncoding encoding
+);
+
+/**
+ * Check whether the given spans can be passed to [`ts_parser_parse_spans`],
+ * as described there. This takes time proportional to the number of spans.
+ */
+bool ts_input_spans_are_valid(const TSInputSpan *spans, uint32_t span_count);
+
+/**
+ * Use the parser to parse a long document, passing each of the root node's
+ * children to a callback as soon as the parser has finished it, instead of
+ * keeping the whole syntax tree in memory.
+ *
+ * This is useful for documents that consist of a long sequence of independent
+ * top-level nodes, such as logs or JSON Lines. A top-level node is passed to
+ * the [`emit`] function of the [`TSStreamCallback`] once it has been reduced
+ * and no longer depends on the text that follows it. The node belongs to a
+ * temporary tree, which is deleted after the [`emit`] function returns, so
+ * the function must copy anything that it needs, or copy the node's tree with
+ * [`ts_tree_copy`].
+ *
+ * The returned tree contains the remaining top-level nodes, which were not
+ * passed to the callback. The text covered by the streamed nodes is skipped
+ * over by a hidden placeholder node, so the positions of the remaining nodes
+ * are correct. If this tree is passed as the old tree in a later parse, none
+ * of the streamed nodes can be reused.
+ *
+ * The parser can only determine that a node is finished when there is no
+ * ambiguity about how the text before it was parsed. If a syntax error later
+ * in the document would have caused a normal parse to include a streamed node
+ * inside of an `ERROR` node, that node will have been streamed as it was. If
+ * parsing is cancelled, it should be resumed by calling this function again.
+ *
+ * [`emit`]: TSStreamCallback::emit
+ */
+TSTree *ts_parser_parse_streaming(
+  TSParser *self,
+  TSInput input,
+  TSStreamCallback callback
+);
+
+/**
+ * Use the parser to parse some source code, like [`ts_parser_parse`], with
+ * some options that allow the parse to be interleaved with other work:
+ *
+ * 1. [`progress_callback`]: A function that is called periodically during
+ *    parsing, with a [`TSParseState`] that holds the given [`payload`], the
+ *    byte offset that the parser has reached, the number of parse actions
+ *    that it has processed so far, and whether it has encountered a syntax
+ *    error. If the function returns `true`, the parse halts early.
+ * 2. [`byte_budget`]: If this is not zero, the parse halts early once it has
+ *    advanced over this many bytes since the start of this call.
+ *
+ * When the parse halts early, this function returns `NULL`, and the parse can
+ * be resumed as described in [`ts_parser_parse`], with the same or different
+ * options. The operation count and the statistics accumulate across calls.
+ *
+ * [`progress_callback`]: TSParseOptions::progress_callback
+ * [`payload`]: TSParseOptions::payload
+ * [`byte_budget`]: TSParseOptions::byte_budget
+ */
+TSTree *ts_parser_parse_with_options(
+  TSParser *self,
+  const TSTree *old_tree,
+  TSInput input,
+  TSParseOptions options
+);
+
 /**
  * Instruct the parser to start the next parse from the beginning.
  *
@@ -362,7 +800,8 @@ void ts_parser_print_dot_graphs(TSParser *self, int fd);
 /******************/
 
 /**
- * Create a shallow copy of the syntax tree. This is very fast.
+ * Create a shallow copy of the syntax tree. This is very fast, because the
+ * copy shares the tree's nodes and its child and parent indices.
  *
  * You need to copy a syntax tree in order to use it on more than one thread at
  * a time, as syntax trees are not thread safe.
@@ -389,6 +828,101 @@ TSNode ts_tree_root_node_with_offset(
   TSPoint offset_extent
 );
 
+/**
+ * Build an index of the children of the nodes in the syntax tree that have
+ * many children.
+ *
+ * Without an index, finding a node's child by its index requires descending
+ * through the hidden nodes that contain it, which takes time proportional to
+ * the logarithm of the node's child count. With an index, [`ts_node_child`]
+ * and [`ts_node_named_child`] take constant time for any node with many
+ * visible children, and [`ts_node_prev_sibling`], [`ts_node_next_sibling`],
+ * and their named variants no longer need to search their parent's children.
+ * Building the index takes time proportional to the size of the tree.
+ *
+ * The index is shared by copies made with [`ts_tree_copy`], and discarded by
+ * [`ts_tree_edit`].
+ */
+void ts_tree_build_child_index(TSTree *self);
+
+/**
+ * Build an index of the parents of the nodes in the syntax tree.
+ *
+ * Without an index, [`ts_node_parent`] finds a node's parent by descending
+ * from the root node, which takes time proportional to the node's depth.
+ * With an index, it takes constant time, so walking up from a node to all of
+ * its ancestors takes time proportional to their number. Building the index
+ * takes time proportional to the size of the tree.
+ *
+ * The index is shared by copies made with [`ts_tree_copy`], and discarded by
+ * [`ts_tree_edit`].
+ */
+void ts_tree_build_parent_index(TSTree *self);
+
+/**
+ * Get the number of bytes of memory used by the syntax tree's child index and
+ * parent index. See [`ts_tree_build_child_index`] and
+ * [`ts_tree_build_parent_index`].
+ */
+size_t ts_tree_index_size(const TSTree *self);
+
+/**
+ * Estimate the memory used by the syntax tree, in constant time.
+ *
+ * The report counts the tree's nodes: the small leaves that are stored
+ * inline in their parent's array of children, and the nodes that are
+ * allocated on the heap. These counts are exact, because every node keeps
+ * track of its descendants. Its bytes are the memory used by the heap nodes
+ * and the arrays of children, along with the tree's own data and the
+ * indices described in [`ts_tree_index_size`]. The nodes are counted as
+ * shared if the tree has been copied with [`ts_tree_copy`], and otherwise as
+ * exclusive, even though some of them may also be part of an earlier or later
+ * version of the tree, and the indices are counted as shared if a copy of the
+ * tree refers to them. The `scanner_state_bytes` are always zero, because
+ * finding the external scanner states requires visiting the tokens.
+ *
+ * Use [`ts_tree_memory_usage_exact`] to tell which nodes are shared.
+ */
+void ts_tree_memory_usage(const TSTree *self, TSMemoryReport *report);
+
+/**
+ * Measure the memory used by the syntax tree, by visiting all of its nodes.
+ *
+ * This reports the same node counts as [`ts_tree_memory_usage`], but splits
+ * the bytes exactly into the memory that is used only by this tree, and the
+ * memory that it shares with other trees, such as its copies and the trees
+ * that it was incrementally parsed from or into. Deleting the tree frees its
+ * exclusive memory, and the shared memory is freed once the last tree that
+ * uses it is deleted. The report also includes the bytes of the long external
+ * scanner states that the tree's tokens refer to, which are counted once even
+ * if several tokens share a state, and which are also included in the
+ * exclusive or shared bytes.
+ *
+ * For a tree that was parsed in arena mode or compacted with
+ * [`ts_tree_compact`], the bytes are those used by the tree's nodes. The
+ * arena itself can be larger, because it is only freed as a whole.
+ *
+ * This takes time proportional to the size of the tree.
+ */
+void ts_tree_memory_usage_exact(const TSTree *self, TSMemoryReport *report);
+
+/**
+ * Move all of the syntax tree's nodes into one new block of memory, in the
+ * order in which they are visited, and rebalance its repetitions.
+ *
+ * A tree that has been edited and reparsed many times shares its nodes with
+ * the earlier versions of the document, and those nodes are spread across the
+ * memory that was allocated for each parse. Compacting the tree makes walking
+ * it as fast as walking a freshly parsed tree, and lets the memory of the
+ * earlier versions be freed once no other tree refers to it. Compacting takes
+ * time proportional to the size of the tree, and it does not change the
+ * tree's visible nodes.
+ *
+ * Like [`ts_tree_edit`], this invalidates any nodes and tree cursors that were
+ * obtained from the tree, and discards its child and parent indices.
+ */
+void ts_tree_compact(TSTree *self);
+
 /**
  * Get the language that was used to parse the syntax tree.
  */
@@ -430,6 +964,57 @@ TSRange *ts_tree_get_changed_ranges(
   uint32_t *length
 );
 
+/**
+ * Compare an old edited syntax tree to a new syntax tree representing the same
+ * document, returning the nodes of the new tree whose syntactic structure has
+ * changed.
+ *
+ * For each range returned by [`ts_tree_get_changed_ranges`], this returns the
+ * smallest node of the new tree that contains the range, omitting any node
+ * that is contained by another returned node. Work such as syntax highlighting
+ * can be redone for just these nodes.
+ *
+ * The returned array is allocated using `malloc` and the caller is responsible
+ * for freeing it using `free`. The length of the array will be written to the
+ * given `length` pointer.
+ */
+TSNode *ts_tree_get_changed_nodes(
+  const TSTree *old_tree,
+  const TSTree *new_tree,
+  uint32_t *length
+);
+
+/**
+ * Serialize a syntax tree into a compact binary buffer, so that it can be
+ * stored and later reloaded with [`ts_tree_deserialize`] without parsing the
+ * document again.
+ *
+ * The buffer contains no pointers, but it uses the host's byte order, and
+ * it can only be read by the same version of the library, using the same
+ * language that produced the tree.
+ *
+ * The returned buffer is allocated using `malloc` and the caller is
+ * responsible for freeing it using `free`. The length of the buffer will be
+ * written to the given `length` pointer.
+ */
+char *ts_tree_serialize(const TSTree *self, uint32_t *length);
+
+/**
+ * Load a syntax tree from a buffer that was created with [`ts_tree_serialize`].
+ *
+ * The resulting tree does not refer to the buffer, and can be used like any
+ * other tree, including as the old tree for an incremental parse, or with
+ * [`ts_tree_get_changed_ranges`]. Its source code must be the same as that of
+ * the tree that was serialized.
+ *
+ * This returns `NULL` if the buffer is malformed, if it was created by a
+ * different version of the library, or if it was created for a different
+ * language. Every node is checked against the language and against its
+ * children, so a buffer from an untrusted source can't produce a tree that
+ * the library would read out of bounds.
+ */
+TSTree *ts_tree_deserialize(const TSLanguage *language, const char *data, uint32_t length);
+
 /**
  * Write a DOT graph describing the syntax tree to the given file.
  */
@@ -639,6 +1224,26 @@ TSNode ts_node_first_named_child_for_byte(TSNode self, uint32_t byte);
  */
 uint32_t ts_node_descendant_count(TSNode self);
 
+/**
+ * Get a hash of the node's structure.
+ *
+ * The hash depends on the node's type, and on the types and the order of all
+ * of its descendants, along with the length in bytes of each leaf node. It
+ * does not depend on the node's position, on the whitespace between its
+ * tokens, or on the tree that contains it, so nodes with the same structure
+ * in different trees with the same language have the same hash. The text of
+ * the tokens is not included, so two nodes with the same hash can still have
+ * different text, and nodes with different structures can very rarely have
+ * the same hash.
+ *
+ * Parsing doesn't compute any hashes. The first call for a node computes the
+ * hashes within it, in time proportional to its number of descendants, and
+ * later calls for it or for its descendants take constant time, including in
+ * copies of the tree and in new trees that reuse it. In an edited tree, the
+ * hash reflects the edited lengths of the leaf nodes.
+ */
+uint64_t ts_node_hash(TSNode self);
+
 /**
  * Get the smallest node within this node that spans the given range of bytes
  * or (row, column) positions.
@@ -800,8 +1405,174 @@ uint32_t ts_tree_cursor_current_depth(const TSTreeCursor *self);
 int64_t ts_tree_cursor_goto_first_child_for_byte(TSTreeCursor *self, uint32_t goal_byte);
 int64_t ts_tree_cursor_goto_first_child_for_point(TSTreeCursor *self, TSPoint goal_point);
 
+/**
+ * Walk the tree in preorder, starting at the cursor's current node and
+ * continuing through the nodes after it, without leaving the original node
+ * that the cursor was constructed with. Each visited node that passes the
+ * given filter is written to `entries`, along with its field id and its
+ * depth relative to the original node. The filter has three parts:
+ *
+ * 1. [`symbols`]: If this is not `NULL`, it is a bitset of [`symbol_count`]
+ *    bits, where bit `i % 8` of byte `i / 8` says whether to include nodes
+ *    whose symbol is `i`. Nodes whose symbol is not in the bitset are
+ *    excluded.
+ * 2. [`max_depth`]: If this is not zero, the walk does not visit nodes that
+ *    are deeper than this.
+ * 3. [`named_only`]: If this is `true`, anonymous nodes are excluded.
+ *
+ * Excluded nodes are not written, but their descendants are still visited.
+ *
+ * The number of entries written is stored in `count`. If the walk stops
+ * because `capacity` entries have been written, this returns `true`, and
+ * the cursor is left on the next node to be written, so that the walk can
+ * be continued with another call. Otherwise, the walk is finished, the
+ * cursor is moved back to the original node, and this returns `false`.
+ *
+ * [`symbols`]: TSTreeCursorWalkOptions::symbols
+ * [`symbol_count`]: TSTreeCursorWalkOptions::symbol_count
+ * [`max_depth`]: TSTreeCursorWalkOptions::max_depth
+ * [`named_only`]: TSTreeCursorWalkOptions::named_only
+ */
+bool ts_tree_cursor_walk(
+  TSTreeCursor *self,
+  const TSTreeCursorWalkOptions *options,
+  TSTreeCursorWalkEntry *entries,
+  uint32_t capacity,
+  uint32_t *count
+);
+
 TSTreeCursor ts_tree_cursor_copy(const TSTreeCursor *cursor);
 
+/***********************/
+/* Section - Flat Tree */
+/***********************/
+
+/**
+ * Create a flat, read-only snapshot of the given syntax tree.
+ *
+ * The snapshot stores the tree's visible nodes in preorder, with each of their
+ * properties in a separate contiguous array, so scanning the whole tree
+ * repeatedly reads memory sequentially instead of following pointers. Nodes
+ * are numbered in the same order as by [`ts_tree_cursor_goto_descendant`].
+ *
+ * The snapshot does not refer to the syntax tree, so it remains valid after
+ * the tree is edited or deleted. It is never modified after it is created, so
+ * it can be read from several threads at once.
+ */
+TSFlatTree *ts_tree_flatten(const TSTree *self);
+
+/**
+ * Delete a flat tree, freeing all of the memory that it used.
+ */
+void ts_flat_tree_delete(TSFlatTree *self);
+
+/**
+ * Get the number of nodes in a flat tree.
+ */
+uint32_t ts_flat_tree_node_count(const TSFlatTree *self);
+
+/**
+ * Get the language of the syntax tree from which a flat tree was created.
+ */
+const TSLanguage *ts_flat_tree_language(const TSFlatTree *self);
+
+/**
+ * Create a cursor for a flat tree, starting at its root node.
+ *
+ * A flat tree cursor does not own any memory, so it can be copied freely and
+ * does not need to be deleted. Each of its movements takes constant time.
+ */
+TSFlatTreeCursor ts_flat_tree_cursor_new(const TSFlatTree *self);
+
+/**
+ * Move the cursor to the first child of its current node.
+ *
+ * This returns `true` if the cursor successfully moved, and returns `false`
+ * if there were no children.
+ */
+bool ts_flat_tree_cursor_goto_first_child(TSFlatTreeCursor *self);
+
+/**
+ * Move the cursor to the next sibling of its current node.
+ *
+ * This returns `true` if the cursor successfully moved, and returns `false`
+ * if there was no next sibling node.
+ */
+bool ts_flat_tree_cursor_goto_next_sibling(TSFlatTreeCursor *self);
+
+/**
+ * Move the cursor to the parent of its current node.
+ *
+ * This returns `true` if the cursor successfully moved, and returns `false`
+ * if there was no parent node (the cursor was already on the root node).
+ */
+bool ts_flat_tree_cursor_goto_parent(TSFlatTreeCursor *self);
+
+/**
+ * Move the cursor to the node that is the nth descendant of the root node in
+ * preorder, where zero represents the root node itself. If the index is out
+ * of bounds, the cursor does not move.
+ */
+void ts_flat_tree_cursor_goto_descendant(TSFlatTreeCursor *self, uint32_t descendant_index);
+
+/**
+ * Get the index of the cursor's current node out of all of the nodes in the
+ * flat tree, in preorder.
+ */
+uint32_t ts_flat_tree_cursor_current_descendant_index(const TSFlatTreeCursor *self);
+
+/**
+ * Get the properties of the cursor's current node.
+ */
+TSFlatNode ts_flat_tree_cursor_current_node(const TSFlatTreeCursor *self);
+
+/***************************/
+/* Section - Tree Snapshot */
+/***************************/
+
+/**
+ * Create a tree snapshot, which holds the latest version of a syntax tree so
+ * that other threads can read it while it is being edited and reparsed.
+ *
+ * The snapshot starts out holding a copy of the given tree, which may be
+ * `NULL`. It can be shared between threads: one or more writers replace its
+ * tree with [`ts_tree_snapshot_publish`], and any number of readers get the
+ * current tree with [`ts_tree_snapshot_acquire`], without ever blocking.
+ */
+TSTreeSnapshot *ts_tree_snapshot_new(const TSTree *tree);
+
+/**
+ * Delete a tree snapshot, along with its reference to the current tree.
+ *
+ * This must not be called while another thread is using the snapshot. Trees
+ * that were acquired from the snapshot remain valid.
+ */
+void ts_tree_snapshot_delete(TSTreeSnapshot *self);
+
+/**
+ * Replace the snapshot's tree with a copy of the given tree, which may be
+ * `NULL`.
+ *
+ * The caller keeps ownership of the given tree, and can go on editing it and
+ * passing it to [`ts_parser_parse`] as the old tree, because the copies share
+ * their nodes, and editing a tree never modifies nodes that another copy
+ * refers to. This waits for any readers that are in the middle of acquiring
+ * the previous tree before releasing it, which takes only as long as a call
+ * to [`ts_tree_copy`], and doesn't depend on the size of the tree.
+ */
+void ts_tree_snapshot_publish(TSTreeSnapshot *self, const TSTree *tree);
+
+/**
+ * Get a copy of the snapshot's current tree, or `NULL` if it has none.
+ *
+ * This can be called from any thread, at the same time as other readers and
+ * writers, and never waits for them. The result is an ordinary shallow copy,
+ * made with [`ts_tree_copy`], which the caller must delete with
+ * [`ts_tree_delete`]. It keeps its version of the tree alive, so the caller
+ * can go on reading it after newer versions are published.
+ */
+TSTree *ts_tree_snapshot_acquire(TSTreeSnapshot *self);
+
 /*******************/
 /* Section - Query */
 /*******************/
@@ -830,6 +1601,33 @@ TSQuery *ts_query_new(
  */
 void ts_query_delete(TSQuery *self);
 
+/**
+ * Serialize a query into a compact binary buffer, so that it can be stored
+ * and later reloaded with [`ts_query_deserialize`] without parsing its source
+ * or analyzing its patterns again.
+ *
+ * The buffer contains no pointers, but it uses the host's byte order, and it
+ * can only be read by the same version of the library. Because the query's
+ * analysis depends on the language's parse table, it must also be read with
+ * the same language: the language's version, its numbers of symbols, states
+ * and fields, and a hash of its symbol and field names are checked. Patterns
+ * and captures that were disabled remain disabled.
+ *
+ * The returned buffer is allocated using `malloc` and the caller is
+ * responsible for freeing it using `free`. The length of the buffer will be
+ * written to the given `length` pointer.
+ */
+char *ts_query_serialize(const TSQuery *self, uint32_t *length);
+
+/**
+ * Load a query from a buffer that was created with [`ts_query_serialize`].
+ *
+ * This returns `NULL` if the buffer is malformed, if it was created by a
+ * different version of the library, or if it was created for a different
+ * language.
+ */
+TSQuery *ts_query_deserialize(const TSLanguage *language, const char *data, uint32_t length);
+
 /**
  * Get the number of patterns, captures, or string literals in the query.
  */
@@ -896,6 +1694,21 @@ bool ts_query_is_pattern_non_local(const TSQuery *self, uint32_t pattern_index);
  */
 bool ts_query_is_pattern_guaranteed_at_step(const TSQuery *self, uint32_t byte_offset);
 
+/**
+ * Check if the given predicate of a pattern is evaluated by query cursors that
+ * have a text provider. See [`ts_query_cursor_set_text_provider`].
+ *
+ * The predicate is specified by its index among the pattern's predicates, in
+ * the order returned by [`ts_query_predicates_for_pattern`]. Bindings that
+ * evaluate predicates themselves can skip the ones for which this returns
+ * `true`.
+ */
+bool ts_query_is_predicate_built_in(
+  const TSQuery *self,
+  uint32_t pattern_index,
+  uint32_t predicate_index
+);
+
 /**
  * Get the name and length of one of the query's captures, or one of the
  * query's string literals. Each capture and string is associated with a
@@ -929,6 +1742,10 @@ const char *ts_query_string_value_for_id(
  * This prevents the capture from being returned in matches, and also avoids
  * any resource usage associated with recording the capture. Currently, there
  * is no way to undo this.
+ *
+ * This modifies the query, so it must not be called while the query is being
+ * used by another thread. To disable a capture for only one use of a shared
+ * query, see [`ts_query_cursor_disable_capture`].
  */
 void ts_query_disable_capture(TSQuery *self, const char *name, uint32_t length);
 
@@ -937,6 +1754,10 @@ void ts_query_disable_capture(TSQuery *self, const char *name, uint32_t length);
  *
  * This prevents the pattern from matching and removes most of the overhead
  * associated with the pattern. Currently, there is no way to undo this.
+ *
+ * This modifies the query, so it must not be called while the query is being
+ * used by another thread. To disable a pattern for only one use of a shared
+ * query, see [`ts_query_cursor_disable_pattern`].
  */
 void ts_query_disable_pattern(TSQuery *self, uint32_t pattern_index);
 
@@ -1005,6 +1826,18 @@ void ts_query_cursor_set_timeout_micros(TSQueryCursor *self, uint64_t timeout_mi
  */
 uint64_t ts_query_cursor_timeout_micros(const TSQueryCursor *self);
 
+/**
+ * Get the number of operations that the query cursor has performed since
+ * the last call to [`ts_query_cursor_exec`].
+ *
+ * Each step that the cursor takes onto or off of a node counts as one
+ * operation, plus one for each match that is in progress at that step. The
+ * count is deterministic, so dividing it by the length of the searched text
+ * gives a stable measure of how expensive a query is to execute on a
+ * document.
+ */
+uint64_t ts_query_cursor_operation_count(const TSQueryCursor *self);
+
 /**
  * Set the range of bytes or (row, column) positions in which the query
  * will be executed.
@@ -1012,6 +1845,46 @@ uint64_t ts_query_cursor_timeout_micros(const TSQueryCursor *self);
 void ts_query_cursor_set_byte_range(TSQueryCursor *self, uint32_t start_byte, uint32_t end_byte);
 void ts_query_cursor_set_point_range(TSQueryCursor *self, TSPoint start_point, TSPoint end_point);
 
+/**
+ * Set several disjoint ranges of bytes in which the query will be executed,
+ * so that one execution finds the matches in all of them, without searching
+ * the text in between. Only the ranges' byte offsets are used. The ranges
+ * must be sorted and must not overlap, although one may end where the next
+ * begins. A match is found if it would be found when executing the query in
+ * any one of the ranges, and it is found only once.
+ *
+ * These ranges replace the byte range set with
+ * [`ts_query_cursor_set_byte_range`], and are replaced by it in turn.
+ * They are combined with the range set with
+ * [`ts_query_cursor_set_point_range`]. An empty array of ranges removes the
+ * restriction.
+ *
+ * Returns `false` and leaves the cursor unchanged if the ranges are not
+ * sorted or they overlap.
+ */
+bool ts_query_cursor_set_byte_ranges(TSQueryCursor *self, const TSRange *ranges, uint32_t count);
+
+/**
+ * Set the text provider that a query cursor uses to evaluate the text
+ * predicates of its query.
+ *
+ * When a cursor has a text provider, it evaluates well-formed `#eq?`,
+ * `#match?` and `#any-of?` predicates itself, along with their `not-` and
+ * `any-` variants, and never returns matches that fail them. The provider's
+ * `text` function must return the UTF8 text of the given node and write its
+ * length to `*length`. The text only needs to stay valid until the next call.
+ *
+ * The plain variants require every node of a capture to satisfy the predicate,
+ * while the `any-` variants require at least one of them to satisfy it. A
+ * predicate on a capture with no nodes is always satisfied. A `#match?`
+ * predicate whose regex uses syntax that the library does not support, like
+ * Perl or Unicode classes, is left to the caller, as is any other predicate.
+ * Use [`ts_query_is_predicate_built_in`] to tell them apart.
+ *
+ * Set the `text` function to `NULL` to stop evaluating predicates.
+ */
+void ts_query_cursor_set_text_provider(TSQueryCursor *self, TSQueryTextProvider provider);
+
 /**
  * Advance to the next match of the currently running query.
  *
@@ -1049,6 +1922,121 @@ bool ts_query_cursor_next_capture(
  */
 void ts_query_cursor_set_max_start_depth(TSQueryCursor *self, uint32_t max_start_depth);
 
+/**
+ * Preallocate all of the memory that the query cursor uses to track matches,
+ * so that running a query does not allocate memory after the first call to
+ * [`ts_query_cursor_exec`] for a tree of a given depth.
+ *
+ * The cursor will track at most `state_count` in-progress and finished
+ * matches at once, and each match can hold at most `capture_count` captures.
+ * Matches that would exceed these limits are dropped, as with the match limit,
+ * and [`ts_query_cursor_did_exceed_match_limit`] will return `true`.
+ *
+ * Set `state_count` to zero to remove both limits. `capture_count` is then
+ * ignored.
+ */
+void ts_query_cursor_set_capacity(TSQueryCursor *self, uint32_t state_count, uint32_t capture_count);
+
+/**
+ * Disable a certain pattern for every query that is subsequently executed
+ * with this cursor.
+ *
+ * Unlike [`ts_query_disable_pattern`], this does not modify the query, so a
+ * single query can be shared by many threads, each using its own cursor with
+ * its own set of disabled patterns. The pattern remains disabled until
+ * [`ts_query_cursor_enable_all`] is called.
+ */
+void ts_query_cursor_disable_pattern(TSQueryCursor *self, uint32_t pattern_index);
+
+/**
+ * Disable a certain capture for every query that is subsequently executed
+ * with this cursor. The capture is identified by its index, as accepted by
+ * [`ts_query_capture_name_for_id`].
+ *
+ * Unlike [`ts_query_disable_capture`], this does not modify the query. The
+ * capture remains disabled until [`ts_query_cursor_enable_all`] is called.
+ */
+void ts_query_cursor_disable_capture(TSQueryCursor *self, uint32_t capture_index);
+
+/**
+ * Re-enable all of the patterns and captures that were disabled with
+ * [`ts_query_cursor_disable_pattern`] and [`ts_query_cursor_disable_capture`].
+ */
+void ts_query_cursor_enable_all(TSQueryCursor *self);
+
+/**
+ * Run a query incrementally, updating a set of matches that was computed for
+ * an older version of a syntax tree so that it holds the matches for a newer
+ * version, and reporting the difference.
+ *
+ * The `matches` set must hold the matches of `query` in `old_tree`, as left
+ * by a previous call to this function, and it must have received the same
+ * edits as `old_tree` via [`ts_query_match_set_edit`]. Only the parts of the
+ * new tree that are affected by those edits or by the tree's changed ranges
+ * are searched again: a match is searched for again if the node that matches
+ * the root of its pattern, or the parent of its first node if the pattern has
+ * several top-level nodes, overlaps them. Patterns that are marked as non-local
+ * by [`ts_query_is_pattern_non_local`] are handled in the same way, because
+ * their nodes are all children of that parent.
+ *
+ * Pass `NULL` for `old_tree` to search the whole tree and fill an empty set.
+ * Either of `added` and `removed` may be `NULL`. Otherwise, they are cleared,
+ * and the matches that the update added to and removed from `matches` are
+ * stored in them.
+ *
+ * The cursor's byte and point ranges are not used, and its text provider is
+ * used to evaluate any text predicates. This returns `false` and leaves the
+ * sets unchanged if the cursor's timeout or match limit was reached.
+ */
+bool ts_query_cursor_exec_incremental(
+  TSQueryCursor *self,
+  const TSQuery *query,
+  TSQueryMatchSet *matches,
+  const TSTree *old_tree,
+  const TSTree *new_tree,
+  TSQueryMatchSet *added,
+  TSQueryMatchSet *removed
+);
+
+/**
+ * Create a new, empty set of query matches.
+ *
+ * A match set stores the pattern index and the captured ranges of each match,
+ * so that it remains valid after the syntax tree that it was computed from
+ * has been edited or deleted. Identical matches are stored once. The matches
+ * are ordered by position, but not in the same order in which a query cursor
+ * returns them.
+ */
+TSQueryMatchSet *ts_query_match_set_new(void);
+
+/**
+ * Delete a match set, freeing all of the memory that it used.
+ */
+void ts_query_match_set_delete(TSQueryMatchSet *self);
+
+/**
+ * Remove all of the matches from a match set.
+ */
+void ts_query_match_set_clear(TSQueryMatchSet *self);
+
+/**
+ * Get the number of matches in a match set.
+ */
+uint32_t ts_query_match_set_count(const TSQueryMatchSet *self);
+
+/**
+ * Get the match at the given index in a match set. Its captures remain valid
+ * until the set is next modified.
+ */
+TSQueryStoredMatch ts_query_match_set_match(const TSQueryMatchSet *self, uint32_t index);
+
+/**
+ * Edit the positions of the matches in a set, so that they correspond to the
+ * edited source code. Apply each edit that is applied to a syntax tree with
+ * [`ts_tree_edit`] to the set of matches computed for it as well.
+ */
+void ts_query_match_set_edit(TSQueryMatchSet *self, const TSInputEdit *edit);
+
 /**********************/
 /* Section - Language */
 /**********************/
@@ -1128,6 +2116,43 @@ uint32_t ts_language_version(const TSLanguage *self);
 */
 TSStateId ts_language_next_state(const TSLanguage *self, TSStateId state, TSSymbol symbol);
 
+/**
+ * Load a language from a language data file, which is written by
+ * `tree-sitter generate --emit-language-data`. The file is mapped into memory
+ * read-only, and the language's tables point directly into it, so loading a
+ * language does not require compiling its parser, and processes that load the
+ * same file share its pages.
+ *
+ * A language data file does not contain code, so a grammar's external scanner
+ * cannot be stored in it. For a grammar with an external scanner, pass the
+ * scanner's functions, which must be compiled natively. Otherwise, pass `NULL`.
+ *
+ * The structure of the file is validated, but the contents of its tables are
+ * trusted, just as the code of a compiled parser is, so the file must come from
+ * a trusted source.
+ *
+ * This returns `NULL` if the language cannot be loaded, and writes the reason
+ * to `error`, if it is not `NULL`. Delete the language with
+ * [`ts_language_delete`] when it is no longer needed.
+ */
+const TSLanguage *ts_language_load_mmap(
+  const char *path,
+  const TSExternalScanner *scanner,
+  TSLanguageLoadError *error
+);
+
+/**
+ * Load a language from the contents of a language data file, like
+ * [`ts_language_load_mmap`]. The data is copied, so it does not need to
+ * outlive the language.
+ */
+const TSLanguage *ts_language_load_data(
+  const void *data,
+  size_t length,
+  const TSExternalScanner *scanner,
+  TSLanguageLoadError *error
+);
+
 /********************************/
 /* Section - Lookahead Iterator */
 /********************************/
@@ -1199,6 +2224,7 @@ const char *ts_lookahead_iterator_current_symbol_name(const TSLookaheadIterator
 
 typedef struct wasm_engine_t TSWasmEngine;
 typedef struct TSWasmStore TSWasmStore;
+typedef struct TSWasmModuleCache TSWasmModuleCache;
 
 typedef enum {
   TSWasmErrorKindNone = 0,
@@ -1221,11 +2247,50 @@ TSWasmStore *ts_wasm_store_new(
   TSWasmError *error
 );
 
+/**
+ * Create a Wasm store that uses the given module cache and the cache's
+ * engine. Stores that share a cache only compile the Wasm standard library,
+ * and each language's Wasm code, once.
+ */
+TSWasmStore *ts_wasm_store_new_with_cache(
+  TSWasmModuleCache *cache,
+  TSWasmError *error
+);
+
 /**
  * Free the memory associated with the given Wasm store.
  */
 void ts_wasm_store_delete(TSWasmStore *);
 
+/**
+ * Create a cache of compiled Wasm modules for the given engine.
+ *
+ * Wasm stores that are created with [`ts_wasm_store_new_with_cache`] look up
+ * each module they need in the cache, by a hash of its Wasm bytes, and only
+ * compile the modules that it doesn't contain yet. Each store still has its
+ * own instance of every language that it loads. A cache can be shared by
+ * stores that are used on different threads.
+ */
+TSWasmModuleCache *ts_wasm_module_cache_new(TSWasmEngine *engine);
+
+/**
+ * Free the given module cache. Its modules are kept until the last store
+ * that was created with it is deleted.
+ */
+void ts_wasm_module_cache_delete(TSWasmModuleCache *);
+
+/**
+ * Set a directory in which the module cache stores precompiled modules, so
+ * that they can be reused by later processes instead of compiling them
+ * again. Pass `NULL` to stop using a directory. This must be called before
+ * the cache is used by any store.
+ *
+ * Precompiled modules are loaded without being validated, so the directory
+ * must only be writable by trusted users. Files that cannot be loaded, such
+ * as ones written by a different version of the Wasm runtime, are replaced.
+ */
+void ts_wasm_module_cache_set_directory(TSWasmModuleCache *, const char *path);
+
 /**
  * Create a language from a buffer of Wasm. The resulting language behaves
  * like any other Tree-sitter language, except that in order to use it with
@@ -1291,6 +2356,63 @@ void ts_set_allocator(
 	void (*new_free)(void *)
 );
 
+/**
+ * Set whether the library should keep statistics about the memory it
+ * allocates.
+ *
+ * While tracking is enabled, each allocation is attributed to a category
+ * that describes what the memory is used for:
+ *  - `TSAllocationCategorySubtreePool`: syntax tree nodes and their arrays
+ *    of children, including arena slabs.
+ *  - `TSAllocationCategoryStackNodes`: the slabs of nodes in the parse stack.
+ *  - `TSAllocationCategoryIncludedRanges`: the lexer's included ranges.
+ *  - `TSAllocationCategoryQueryCursorStates`: the in-progress and finished
+ *    states of query cursors.
+ *  - `TSAllocationCategoryQueryCaptureLists`: the capture lists of query
+ *    cursors.
+ *  - `TSAllocationCategoryWasmStore`: Wasm stores and the languages loaded
+ *    into them. The memory that the Wasm runtime allocates itself is not
+ *    counted.
+ *  - `TSAllocationCategoryOther`: everything else.
+ *
+ * Tracking works by storing the size and category of each allocation in a
+ * small header in front of it, and wraps the allocation functions that are
+ * current when it is enabled. So it must be enabled after any call to
+ * [`ts_set_allocator`], and, like that function, it can only be enabled or
+ * disabled while no objects allocated by the library exist. While it is
+ * enabled, buffers that the library returns to the caller, such as the
+ * string returned by [`ts_node_string`], must be released with
+ * `ts_current_free` instead of `free`.
+ *
+ * Enabling tracking resets all of the statistics.
+ */
+void ts_set_allocation_tracking(bool enabled);
+
+/**
+ * Check whether the library is keeping statistics about its allocations.
+ */
+bool ts_allocation_tracking_enabled(void);
+
+/**
+ * Get the allocation statistics for the given category. These are only
+ * collected while tracking is enabled with [`ts_set_allocation_tracking`].
+ */
+TSAllocationStats ts_allocation_stats(TSAllocationCategory category);
+
+/**
+ * Get the allocation statistics for all categories combined. The peak is
+ * the highest number of bytes that were live at once, which can be lower
+ * than the sum of the peaks of each category.
+ */
+TSAllocationStats ts_allocation_total_stats(void);
+
+/**
+ * Reset the allocation counts of every category to zero, and their peaks to
+ * the number of bytes that are currently live, so that the allocations made
+ * by a single operation can be measured. The live counts are not changed.
+ */
+void ts_allocation_stats_reset(void);
+
 #ifdef __cplusplus
 }
 #endif
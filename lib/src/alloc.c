@@ -1,6 +1,9 @@
 #include "alloc.h"
+#include "atomic.h"
 #include "tree_sitter/api.h"
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 static void *ts_malloc_default(size_t size) {
   void *result = malloc(size);
@@ -46,3 +49,192 @@ void ts_set_allocator(
   ts_current_realloc = new_realloc ? new_realloc : ts_realloc_default;
   ts_current_free = new_free ? new_free : free;
 }
+
+// Allocation tracking
+
+#define ALLOCATION_CATEGORY_COUNT (TSAllocationCategoryWasmStore + 1)
+
+// Every tracked block starts with a header that records its size and
+// category. The header is padded to keep the block's contents aligned.
+typedef union {
+  struct {
+    size_t size;
+    TSAllocationCategory category;
+  } info;
+  long double alignment;
+  void *pointer;
+  long long integer;
+} AllocationHeader;
+
+typedef struct {
+  volatile size_t allocation_count;
+  volatile size_t live_allocation_count;
+  volatile size_t live_bytes;
+  volatile size_t peak_bytes;
+} AllocationCounters;
+
+bool ts_allocation_tracking = false;
+
+// The last entry holds the totals for all categories.
+static AllocationCounters allocation_counters[ALLOCATION_CATEGORY_COUNT + 1];
+
+// The allocation functions that were current when tracking was enabled.
+static void *(*untracked_malloc)(size_t);
+static void *(*untracked_calloc)(size_t, size_t);
+static void *(*untracked_realloc)(void *, size_t);
+static void (*untracked_free)(void *);
+
+static inline AllocationHeader *allocation_header(void *buffer) {
+  return (AllocationHeader *)buffer - 1;
+}
+
+static void allocation_counters__add(AllocationCounters *self, size_t size, bool is_new) {
+  if (is_new) {
+    atomic_add(&self->allocation_count, 1);
+    atomic_add(&self->live_allocation_count, 1);
+  }
+  size_t live_bytes = atomic_add(&self->live_bytes, size);
+  size_t peak_bytes = atomic_load(&self->peak_bytes);
+  while (live_bytes > peak_bytes && !atomic_compare_exchange(&self->peak_bytes, peak_bytes, live_bytes)) {
+    peak_bytes = atomic_load(&self->peak_bytes);
+  }
+}
+
+static void allocation_counters__remove(AllocationCounters *self, size_t size, bool is_freed) {
+  if (is_freed) atomic_sub(&self->live_allocation_count, 1);
+  atomic_sub(&self->live_bytes, size);
+}
+
+static void *ts_allocation__track(void *block, TSAllocationCategory category, size_t size) {
+  if (!block) return NULL;
+  AllocationHeader *header = block;
+  header->info.size = size;
+  header->info.category = category;
+  allocation_counters__add(&allocation_counters[category], size, true);
+  allocation_counters__add(&allocation_counters[ALLOCATION_CATEGORY_COUNT], size, true);
+  return header + 1;
+}
+
+static size_t ts_allocation__block_size(size_t size) {
+  if (size > SIZE_MAX - sizeof(AllocationHeader)) {
+    fprintf(stderr, "tree-sitter failed to allocate %zu bytes", size);
+    abort();
+  }
+  return sizeof(AllocationHeader) + size;
+}
+
+void *ts_tracked_malloc(TSAllocationCategory category, size_t size) {
+  void *block = untracked_malloc(ts_allocation__block_size(size));
+  return ts_allocation__track(block, category, size);
+}
+
+void *ts_tracked_calloc(TSAllocationCategory category, size_t count, size_t size) {
+  if (size > 0 && count > SIZE_MAX / size) {
+    fprintf(stderr, "tree-sitter failed to allocate %zu * %zu bytes", count, size);
+    abort();
+  }
+  void *block = untracked_calloc(1, ts_allocation__block_size(count * size));
+  return ts_allocation__track(block, category, count * size);
+}
+
+void *ts_tracked_realloc(TSAllocationCategory category, void *buffer, size_t size) {
+  if (!buffer) return ts_tracked_malloc(category, size);
+
+  AllocationHeader *header = allocation_header(buffer);
+  size_t old_size = header->info.size;
+  TSAllocationCategory old_category = header->info.category;
+  header = untracked_realloc(header, ts_allocation__block_size(size));
+  if (!header) return NULL;
+
+  header->info.size = size;
+  header->info.category = category;
+  allocation_counters__remove(&allocation_counters[old_category], old_size, old_category != category);
+  allocation_counters__add(&allocation_counters[category], size, old_category != category);
+  allocation_counters__remove(&allocation_counters[ALLOCATION_CATEGORY_COUNT], old_size, false);
+  allocation_counters__add(&allocation_counters[ALLOCATION_CATEGORY_COUNT], size, false);
+  return header + 1;
+}
+
+void ts_tracked_set_category(void *buffer, TSAllocationCategory category) {
+  AllocationHeader *header = allocation_header(buffer);
+  TSAllocationCategory old_category = header->info.category;
+  if (old_category == category) return;
+  header->info.category = category;
+  allocation_counters__remove(&allocation_counters[old_category], header->info.size, true);
+  allocation_counters__add(&allocation_counters[category], header->info.size, true);
+}
+
+static void *ts_tracked_malloc_other(size_t size) {
+  return ts_tracked_malloc(TSAllocationCategoryOther, size);
+}
+
+static void *ts_tracked_calloc_other(size_t count, size_t size) {
+  return ts_tracked_calloc(TSAllocationCategoryOther, count, size);
+}
+
+// Blocks that are reallocated without a category keep the one they have.
+static void *ts_tracked_realloc_same(void *buffer, size_t size) {
+  TSAllocationCategory category = buffer
+    ? allocation_header(buffer)->info.category
+    : TSAllocationCategoryOther;
+  return ts_tracked_realloc(category, buffer, size);
+}
+
+static void ts_tracked_free(void *buffer) {
+  if (!buffer) return;
+  AllocationHeader *header = allocation_header(buffer);
+  allocation_counters__remove(&allocation_counters[header->info.category], header->info.size, true);
+  allocation_counters__remove(&allocation_counters[ALLOCATION_CATEGORY_COUNT], header->info.size, true);
+  untracked_free(header);
+}
+
+void ts_set_allocation_tracking(bool enabled) {
+  if (enabled == ts_allocation_tracking) return;
+  if (enabled) {
+    memset(allocation_counters, 0, sizeof(allocation_counters));
+    untracked_malloc = ts_current_malloc;
+    untracked_calloc = ts_current_calloc;
+    untracked_realloc = ts_current_realloc;
+    untracked_free = ts_current_free;
+    ts_current_malloc = ts_tracked_malloc_other;
+    ts_current_calloc = ts_tracked_calloc_other;
+    ts_current_realloc = ts_tracked_realloc_same;
+    ts_current_free = ts_tracked_free;
+  } else {
+    ts_current_malloc = untracked_malloc;
+    ts_current_calloc = untracked_calloc;
+    ts_current_realloc = untracked_realloc;
+    ts_current_free = untracked_free;
+  }
+  ts_allocation_tracking = enabled;
+}
+
+bool ts_allocation_tracking_enabled(void) {
+  return ts_allocation_tracking;
+}
+
+static TSAllocationStats allocation_counters__stats(const AllocationCounters *self) {
+  return (TSAllocationStats) {
+    .allocation_count = atomic_load(&self->allocation_count),
+    .live_allocation_count = atomic_load(&self->live_allocation_count),
+    .live_bytes = atomic_load(&self->live_bytes),
+    .peak_bytes = atomic_load(&self->peak_bytes),
+  };
+}
+
+TSAllocationStats ts_allocation_stats(TSAllocationCategory category) {
+  if ((unsigned)category >= ALLOCATION_CATEGORY_COUNT) return (TSAllocationStats) {0};
+  return allocation_counters__stats(&allocation_counters[category]);
+}
+
+TSAllocationStats ts_allocation_total_stats(void) {
+  return allocation_counters__stats(&allocation_counters[ALLOCATION_CATEGORY_COUNT]);
+}
+
+void ts_allocation_stats_reset(void) {
+  for (unsigned i = 0; i <= ALLOCATION_CATEGORY_COUNT; i++) {
+    AllocationCounters *counters = &allocation_counters[i];
+    counters->allocation_count = 0;
+    counters->peak_bytes = atomic_load(&counters->live_bytes);
+  }
+}
@@ -9,6 +9,8 @@ extern "C" {
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "tree_sitter/api.h"
+
 #if defined(TREE_SITTER_HIDDEN_SYMBOLS) || defined(_WIN32)
 #define TS_PUBLIC
 #else
@@ -34,6 +36,34 @@ TS_PUBLIC extern void (*ts_current_free)(void *);
 #define ts_free    ts_current_free
 #endif
 
+// When allocation tracking is enabled, the `ts_*_in` functions attribute the
+// memory that they allocate to the given category. Reallocating a block keeps
+// its category. Otherwise they are the same as the plain allocation functions.
+extern bool ts_allocation_tracking;
+
+void *ts_tracked_malloc(TSAllocationCategory category, size_t size);
+void *ts_tracked_calloc(TSAllocationCategory category, size_t count, size_t size);
+void *ts_tracked_realloc(TSAllocationCategory category, void *buffer, size_t size);
+void ts_tracked_set_category(void *buffer, TSAllocationCategory category);
+
+static inline void *ts_malloc_in(TSAllocationCategory category, size_t size) {
+  return ts_allocation_tracking ? ts_tracked_malloc(category, size) : ts_malloc(size);
+}
+
+static inline void *ts_calloc_in(TSAllocationCategory category, size_t count, size_t size) {
+  return ts_allocation_tracking ? ts_tracked_calloc(category, count, size) : ts_calloc(count, size);
+}
+
+static inline void *ts_realloc_in(TSAllocationCategory category, void *buffer, size_t size) {
+  return ts_allocation_tracking ? ts_tracked_realloc(category, buffer, size) : ts_realloc(buffer, size);
+}
+
+// Attribute an existing block, such as the contents of an array, to the given
+// category.
+static inline void ts_set_allocation_category(void *buffer, TSAllocationCategory category) {
+  if (ts_allocation_tracking && buffer) ts_tracked_set_category(buffer, category);
+}
+
 #ifdef __cplusplus
 }
 #endif
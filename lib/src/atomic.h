@@ -1,11 +1,59 @@
 #ifndef TREE_SITTER_ATOMIC_H_
 #define TREE_SITTER_ATOMIC_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 
-#ifdef __TINYC__
+// When the library is built with `TREE_SITTER_SINGLE_THREADED`, reference
+// counts are updated with plain arithmetic. This is only valid for programs
+// that never use syntax trees, languages or Wasm stores from more than one
+// thread. Loads still use atomics, because cancellation flags are set from
+// other threads.
+#if defined(TREE_SITTER_SINGLE_THREADED) && !defined(__TINYC__)
+
+static inline size_t atomic_load(const volatile size_t *p) {
+#ifdef _WIN32
+  return *p;
+#elif defined(__ATOMIC_RELAXED)
+  return __atomic_load_n(p, __ATOMIC_RELAXED);
+#else
+  return __sync_fetch_and_add((volatile size_t *)p, 0);
+#endif
+}
+
+static inline uint32_t atomic_inc(volatile uint32_t *p) {
+  return ++*(uint32_t *)p;
+}
+
+static inline uint32_t atomic_dec(volatile uint32_t *p) {
+  return --*(uint32_t *)p;
+}
+
+static inline size_t atomic_add(volatile size_t *p, size_t n) {
+  return *(size_t *)p += n;
+}
+
+static inline size_t atomic_sub(volatile size_t *p, size_t n) {
+  return *(size_t *)p -= n;
+}
+
+static inline bool atomic_compare_exchange(volatile size_t *p, size_t expected, size_t desired) {
+  if (*p != expected) return false;
+  *(size_t *)p = desired;
+  return true;
+}
+
+static inline uint64_t atomic_load_u64(const volatile uint64_t *p) {
+  return *(const uint64_t *)p;
+}
+
+static inline void atomic_store_u64(volatile uint64_t *p, uint64_t value) {
+  *(uint64_t *)p = value;
+}
+
+#elif defined(__TINYC__)
 
 static inline size_t atomic_load(const volatile size_t *p) {
   return *p;
@@ -21,6 +69,30 @@ static inline uint32_t atomic_dec(volatile uint32_t *p) {
   return *p;
 }
 
+static inline size_t atomic_add(volatile size_t *p, size_t n) {
+  *p += n;
+  return *p;
+}
+
+static inline size_t atomic_sub(volatile size_t *p, size_t n) {
+  *p -= n;
+  return *p;
+}
+
+static inline bool atomic_compare_exchange(volatile size_t *p, size_t expected, size_t desired) {
+  if (*p != expected) return false;
+  *p = desired;
+  return true;
+}
+
+static inline uint64_t atomic_load_u64(const volatile uint64_t *p) {
+  return *p;
+}
+
+static inline void atomic_store_u64(volatile uint64_t *p, uint64_t value) {
+  *p = value;
+}
+
 #elif defined(_WIN32)
 
 #include <windows.h>
@@ -37,6 +109,34 @@ static inline uint32_t atomic_dec(volatile uint32_t *p) {
   return InterlockedDecrement((long volatile *)p);
 }
 
+static inline size_t atomic_add(volatile size_t *p, size_t n) {
+#ifdef _WIN64
+  return (size_t)InterlockedExchangeAdd64((LONG64 volatile *)p, (LONG64)n) + n;
+#else
+  return (size_t)InterlockedExchangeAdd((long volatile *)p, (long)n) + n;
+#endif
+}
+
+static inline size_t atomic_sub(volatile size_t *p, size_t n) {
+  return atomic_add(p, (size_t)0 - n);
+}
+
+static inline bool atomic_compare_exchange(volatile size_t *p, size_t expected, size_t desired) {
+#ifdef _WIN64
+  return InterlockedCompareExchange64((LONG64 volatile *)p, (LONG64)desired, (LONG64)expected) == (LONG64)expected;
+#else
+  return InterlockedCompareExchange((long volatile *)p, (long)desired, (long)expected) == (long)expected;
+#endif
+}
+
+static inline uint64_t atomic_load_u64(const volatile uint64_t *p) {
+  return (uint64_t)InterlockedCompareExchange64((LONG64 volatile *)p, 0, 0);
+}
+
+static inline void atomic_store_u64(volatile uint64_t *p, uint64_t value) {
+  InterlockedExchange64((LONG64 volatile *)p, (LONG64)value);
+}
+
 #else
 
 static inline size_t atomic_load(const volatile size_t *p) {
@@ -63,6 +163,46 @@ static inline uint32_t atomic_dec(volatile uint32_t *p) {
   #endif
 }
 
+static inline size_t atomic_add(volatile size_t *p, size_t n) {
+  #ifdef __ATOMIC_RELAXED
+    return __atomic_add_fetch(p, n, __ATOMIC_RELAXED);
+  #else
+    return __sync_add_and_fetch(p, n);
+  #endif
+}
+
+static inline size_t atomic_sub(volatile size_t *p, size_t n) {
+  #ifdef __ATOMIC_RELAXED
+    return __atomic_sub_fetch(p, n, __ATOMIC_RELAXED);
+  #else
+    return __sync_sub_and_fetch(p, n);
+  #endif
+}
+
+static inline bool atomic_compare_exchange(volatile size_t *p, size_t expected, size_t desired) {
+  #ifdef __ATOMIC_RELAXED
+    return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  #else
+    return __sync_bool_compare_and_swap(p, expected, desired);
+  #endif
+}
+
+static inline uint64_t atomic_load_u64(const volatile uint64_t *p) {
+  #ifdef __ATOMIC_RELAXED
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+  #else
+    return __sync_fetch_and_add((volatile uint64_t *)p, 0);
+  #endif
+}
+
+static inline void atomic_store_u64(volatile uint64_t *p, uint64_t value) {
+  #ifdef __ATOMIC_RELAXED
+    __atomic_store_n(p, value, __ATOMIC_RELAXED);
+  #else
+    __sync_lock_test_and_set(p, value);
+  #endif
+}
+
 #endif
 
 #endif  // TREE_SITTER_ATOMIC_H_
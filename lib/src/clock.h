@@ -49,6 +49,16 @@ static inline bool clock_is_gt(TSClock self, TSClock other) {
   return self > other;
 }
 
+static inline uint64_t clock_nanos_between(TSClock start, TSClock end) {
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  uint64_t ticks = end > start ? end - start : 0;
+  uint64_t ticks_per_second = (uint64_t)frequency.QuadPart;
+  return
+    ticks / ticks_per_second * 1000000000 +
+    ticks % ticks_per_second * 1000000000 / ticks_per_second;
+}
+
 #elif defined(CLOCK_MONOTONIC) && !defined(__APPLE__)
 
 // POSIX with monotonic clock support (Linux)
@@ -100,6 +110,13 @@ static inline bool clock_is_gt(TSClock self, TSClock other) {
   return self.tv_nsec > other.tv_nsec;
 }
 
+static inline uint64_t clock_nanos_between(TSClock start, TSClock end) {
+  if (!clock_is_gt(end, start)) return 0;
+  return
+    (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000 +
+    (uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+}
+
 #else
 
 // macOS or POSIX without monotonic clock support
@@ -141,6 +158,13 @@ static inline bool clock_is_gt(TSClock self, TSClock other) {
   return self > other;
 }
 
+static inline uint64_t clock_nanos_between(TSClock start, TSClock end) {
+  uint64_t ticks = end > start ? end - start : 0;
+  return
+    ticks / (uint64_t)CLOCKS_PER_SEC * 1000000000 +
+    ticks % (uint64_t)CLOCKS_PER_SEC * 1000000000 / (uint64_t)CLOCKS_PER_SEC;
+}
+
 #endif
 
 #endif  // TREE_SITTER_CLOCK_H_
@@ -0,0 +1,179 @@
+#include <assert.h>
+#include "tree_sitter/api.h"
+#include "./alloc.h"
+#include "./array.h"
+#include "./language.h"
+#include "./subtree.h"
+#include "./tree.h"
+
+#define FLAT_TREE_NONE UINT32_MAX
+
+typedef enum {
+  FlatNodeNamed = 1 << 0,
+  FlatNodeExtra = 1 << 1,
+  FlatNodeMissing = 1 << 2,
+  FlatNodeHasError = 1 << 3,
+} FlatNodeFlags;
+
+// The visible nodes of a tree in preorder, stored as one array per property,
+// so that a scan which reads a few properties of every node only touches the
+// memory holding those properties. All of the arrays live in one allocation.
+struct TSFlatTree {
+  const TSLanguage *language;
+  uint32_t node_count;
+  uint32_t *start_bytes;
+  uint32_t *end_bytes;
+  TSPoint *start_points;
+  TSPoint *end_points;
+  uint32_t *parents;
+  uint32_t *next_siblings;
+  TSSymbol *symbols;
+  TSFieldId *field_ids;
+  uint8_t *flags;
+};
+
+static void ts_flat_tree__push(
+  TSFlatTree *self,
+  const TSTreeCursor *cursor,
+  uint32_t index,
+  uint32_t parent
+) {
+  TSNode node = ts_tree_cursor_current_node(cursor);
+  self->start_bytes[index] = ts_node_start_byte(node);
+  self->end_bytes[index] = ts_node_end_byte(node);
+  self->start_points[index] = ts_node_start_point(node);
+  self->end_points[index] = ts_node_end_point(node);
+  self->parents[index] = parent;
+  self->next_siblings[index] = FLAT_TREE_NONE;
+  self->symbols[index] = ts_node_symbol(node);
+  self->field_ids[index] = ts_tree_cursor_current_field_id(cursor);
+  self->flags[index] =
+    (ts_node_is_named(node) ? FlatNodeNamed : 0) |
+    (ts_node_is_extra(node) ? FlatNodeExtra : 0) |
+    (ts_node_is_missing(node) ? FlatNodeMissing : 0) |
+    (ts_node_has_error(node) ? FlatNodeHasError : 0);
+}
+
+TSFlatTree *ts_tree_flatten(const TSTree *tree) {
+  uint32_t node_count = ts_subtree_visible_descendant_count(tree->root) + 1;
+
+  // Place the wider properties first, so that every array is aligned.
+  size_t size =
+    sizeof(TSFlatTree) +
+    node_count * (4 * sizeof(uint32_t) + 2 * sizeof(TSPoint)) +
+    node_count * (sizeof(TSSymbol) + sizeof(TSFieldId)) +
+    node_count * sizeof(uint8_t);
+  TSFlatTree *self = ts_malloc(size);
+  char *buffer = (char *)(self + 1);
+  self->language = ts_language_copy(tree->language);
+  self->node_count = node_count;
+  self->start_bytes = (uint32_t *)buffer; buffer += node_count * sizeof(uint32_t);
+  self->end_bytes = (uint32_t *)buffer; buffer += node_count * sizeof(uint32_t);
+  self->start_points = (TSPoint *)buffer; buffer += node_count * sizeof(TSPoint);
+  self->end_points = (TSPoint *)buffer; buffer += node_count * sizeof(TSPoint);
+  self->parents = (uint32_t *)buffer; buffer += node_count * sizeof(uint32_t);
+  self->next_siblings = (uint32_t *)buffer; buffer += node_count * sizeof(uint32_t);
+  self->symbols = (TSSymbol *)buffer; buffer += node_count * sizeof(TSSymbol);
+  self->field_ids = (TSFieldId *)buffer; buffer += node_count * sizeof(TSFieldId);
+  self->flags = (uint8_t *)buffer;
+
+  // Walk the tree with a cursor, keeping track of the index of the current
+  // node at each depth, so that each node can be linked to its parent and
+  // to its previous sibling.
+  Array(uint32_t) path = array_new();
+  TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+  uint32_t index = 0;
+  ts_flat_tree__push(self, &cursor, index, FLAT_TREE_NONE);
+  array_push(&path, index);
+  for (;;) {
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+      index++;
+      ts_flat_tree__push(self, &cursor, index, *array_back(&path));
+      array_push(&path, index);
+      continue;
+    }
+
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) goto done;
+      path.size--;
+    }
+    index++;
+    uint32_t previous_sibling = array_pop(&path);
+    self->next_siblings[previous_sibling] = index;
+    ts_flat_tree__push(self, &cursor, index, *array_back(&path));
+    array_push(&path, index);
+  }
+
+done:
+  assert(index + 1 == node_count);
+  ts_tree_cursor_delete(&cursor);
+  array_delete(&path);
+  return self;
+}
+
+void ts_flat_tree_delete(TSFlatTree *self) {
+  if (!self) return;
+  ts_language_delete(self->language);
+  ts_free(self);
+}
+
+uint32_t ts_flat_tree_node_count(const TSFlatTree *self) {
+  return self->node_count;
+}
+
+const TSLanguage *ts_flat_tree_language(const TSFlatTree *self) {
+  return self->language;
+}
+
+TSFlatTreeCursor ts_flat_tree_cursor_new(const TSFlatTree *tree) {
+  return (TSFlatTreeCursor) {.tree = tree, .index = 0};
+}
+
+bool ts_flat_tree_cursor_goto_first_child(TSFlatTreeCursor *self) {
+  uint32_t child = self->index + 1;
+  if (child < self->tree->node_count && self->tree->parents[child] == self->index) {
+    self->index = child;
+    return true;
+  }
+  return false;
+}
+
+bool ts_flat_tree_cursor_goto_next_sibling(TSFlatTreeCursor *self) {
+  uint32_t sibling = self->tree->next_siblings[self->index];
+  if (sibling == FLAT_TREE_NONE) return false;
+  self->index = sibling;
+  return true;
+}
+
+bool ts_flat_tree_cursor_goto_parent(TSFlatTreeCursor *self) {
+  uint32_t parent = self->tree->parents[self->index];
+  if (parent == FLAT_TREE_NONE) return false;
+  self->index = parent;
+  return true;
+}
+
+void ts_flat_tree_cursor_goto_descendant(TSFlatTreeCursor *self, uint32_t descendant_index) {
+  if (descendant_index < self->tree->node_count) self->index = descendant_index;
+}
+
+uint32_t ts_flat_tree_cursor_current_descendant_index(const TSFlatTreeCursor *self) {
+  return self->index;
+}
+
+TSFlatNode ts_flat_tree_cursor_current_node(const TSFlatTreeCursor *self) {
+  const TSFlatTree *tree = self->tree;
+  uint32_t i = self->index;
+  uint8_t flags = tree->flags[i];
+  return (TSFlatNode) {
+    .symbol = tree->symbols[i],
+    .field_id = tree->field_ids[i],
+    .start_byte = tree->start_bytes[i],
+    .end_byte = tree->end_bytes[i],
+    .start_point = tree->start_points[i],
+    .end_point = tree->end_points[i],
+    .is_named = flags & FlatNodeNamed,
+    .is_extra = flags & FlatNodeExtra,
+    .is_missing = flags & FlatNodeMissing,
+    .has_error = flags & FlatNodeHasError,
+  };
+}
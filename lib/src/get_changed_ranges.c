@@ -33,14 +33,70 @@ bool ts_range_array_intersects(
   uint32_t start_byte,
   uint32_t end_byte
 ) {
-  for (unsigned i = start_index; i < self->size; i++) {
-    TSRange *range = &self->contents[i];
-    if (range->end_byte > start_byte) {
-      if (range->start_byte >= end_byte) break;
-      return true;
+  // The ranges are sorted and disjoint, so find the first one that ends after
+  // the start position with a binary search.
+  unsigned index = start_index;
+  unsigned size = index < self->size ? self->size - index : 0;
+  while (size > 0) {
+    unsigned half_size = size / 2;
+    if (self->contents[index + half_size].end_byte > start_byte) {
+      size = half_size;
+    } else {
+      index += half_size + 1;
+      size -= half_size + 1;
+    }
+  }
+  return index < self->size && self->contents[index].start_byte < end_byte;
+}
+
+void ts_range_array_edit(TSRange *ranges, unsigned count, const TSInputEdit *edit) {
+  // The ranges' end bytes are in increasing order, and a range that ends
+  // before the edit starts can't be affected by it.
+  unsigned index = 0;
+  unsigned size = count;
+  while (size > 0) {
+    unsigned half_size = size / 2;
+    if (ranges[index + half_size].end_byte >= edit->start_byte) {
+      size = half_size;
+    } else {
+      index += half_size + 1;
+      size -= half_size + 1;
+    }
+  }
+
+  for (unsigned i = index; i < count; i++) {
+    TSRange *range = &ranges[i];
+    if (range->end_byte >= edit->old_end_byte) {
+      if (range->end_byte != UINT32_MAX) {
+        range->end_byte = edit->new_end_byte + (range->end_byte - edit->old_end_byte);
+        range->end_point = point_add(
+          edit->new_end_point,
+          point_sub(range->end_point, edit->old_end_point)
+        );
+        if (range->end_byte < edit->new_end_byte) {
+          range->end_byte = UINT32_MAX;
+          range->end_point = POINT_MAX;
+        }
+      }
+    } else if (range->end_byte > edit->start_byte) {
+      range->end_byte = edit->start_byte;
+      range->end_point = edit->start_point;
+    }
+    if (range->start_byte >= edit->old_end_byte) {
+      range->start_byte = edit->new_end_byte + (range->start_byte - edit->old_end_byte);
+      range->start_point = point_add(
+        edit->new_end_point,
+        point_sub(range->start_point, edit->old_end_point)
+      );
+      if (range->start_byte < edit->new_end_byte) {
+        range->start_byte = UINT32_MAX;
+        range->start_point = POINT_MAX;
+      }
+    } else if (range->start_byte > edit->start_byte) {
+      range->start_byte = edit->start_byte;
+      range->start_point = edit->start_point;
     }
   }
-  return false;
 }
 
 void ts_range_array_get_changed_ranges(
@@ -295,6 +351,62 @@ static void iterator_advance(Iterator *self) {
   }
 }
 
+// If both iterators are inside a subtree that the new tree reused from the
+// old tree without changes, and they are at the same node within it, then
+// the rest of that subtree must be identical in both trees. Move both
+// iterators up to the outermost such subtree, so that it can be skipped
+// without visiting its remaining nodes.
+static bool iterator_ascend_to_shared_subtree(
+  Iterator *old_iter,
+  Iterator *new_iter,
+  const TSRangeArray *included_range_differences,
+  unsigned included_range_difference_index
+) {
+  if (old_iter->in_padding || new_iter->in_padding) return false;
+  if (old_iter->visible_depth != new_iter->visible_depth) return false;
+
+  const TreeCursorEntry *old_stack = old_iter->cursor.stack.contents;
+  const TreeCursorEntry *new_stack = new_iter->cursor.stack.contents;
+  uint32_t old_size = old_iter->cursor.stack.size;
+  uint32_t new_size = new_iter->cursor.stack.size;
+
+  // Find the outermost ancestor such that it, and every entry below it, is the
+  // same subtree at the same position in both stacks.
+  uint32_t shared_depth = 0;
+  while (shared_depth < old_size && shared_depth < new_size) {
+    const TreeCursorEntry *old_entry = &old_stack[old_size - shared_depth - 1];
+    const TreeCursorEntry *new_entry = &new_stack[new_size - shared_depth - 1];
+    if (
+      old_entry->subtree->ptr != new_entry->subtree->ptr ||
+      old_entry->position.bytes != new_entry->position.bytes ||
+      ts_subtree_has_changes(*old_entry->subtree)
+    ) break;
+    shared_depth++;
+  }
+
+  // Subtrees without hidden children are already skipped in one step.
+  if (shared_depth < 2) return false;
+
+  const TreeCursorEntry *shared_entry = &old_stack[old_size - shared_depth];
+  Length start = iterator_start_position(old_iter);
+  Length end = length_add(
+    length_add(shared_entry->position, ts_subtree_padding(*shared_entry->subtree)),
+    ts_subtree_size(*shared_entry->subtree)
+  );
+  if (ts_range_array_intersects(
+    included_range_differences,
+    included_range_difference_index,
+    start.bytes,
+    end.bytes
+  )) return false;
+
+  for (uint32_t i = 1; i < shared_depth; i++) {
+    iterator_ascend(old_iter);
+    iterator_ascend(new_iter);
+  }
+  return true;
+}
+
 typedef enum {
   IteratorDiffers,
   IteratorMayDiffer,
@@ -387,8 +499,14 @@ unsigned ts_subtree_get_changed_ranges(
     puts("");
     #endif
 
-    // Compare the old and new subtrees.
-    IteratorComparison comparison = iterator_compare(&old_iter, &new_iter);
+    // Compare the old and new subtrees. If the iterators are within a subtree
+    // that the new tree reuses from the old tree, then skip that entire subtree.
+    IteratorComparison comparison = iterator_ascend_to_shared_subtree(
+      &old_iter,
+      &new_iter,
+      included_range_differences,
+      included_range_difference_index
+    ) ? IteratorMatches : iterator_compare(&old_iter, &new_iter);
 
     // Even if the two subtrees appear to be identical, they could differ
     // internally if they contain a range of text that was previously
@@ -21,6 +21,8 @@ bool ts_range_array_intersects(
   uint32_t start_byte, uint32_t end_byte
 );
 
+void ts_range_array_edit(TSRange *ranges, unsigned count, const TSInputEdit *edit);
+
 unsigned ts_subtree_get_changed_ranges(
   const Subtree *old_tree, const Subtree *new_tree,
   TreeCursor *cursor1, TreeCursor *cursor2,
@@ -1,11 +1,15 @@
 #include "./language.h"
+#include "./language_data.h"
 #include "./wasm_store.h"
 #include "tree_sitter/api.h"
+#include <stdlib.h>
 #include <string.h>
 
 const TSLanguage *ts_language_copy(const TSLanguage *self) {
   if (self && ts_language_is_wasm(self)) {
     ts_wasm_language_retain(self);
+  } else if (self && ts_language_is_data(self)) {
+    ts_language_data_retain(self);
   }
   return self;
 }
@@ -13,6 +17,8 @@ const TSLanguage *ts_language_copy(const TSLanguage *self) {
 void ts_language_delete(const TSLanguage *self) {
   if (self && ts_language_is_wasm(self)) {
     ts_wasm_language_release(self);
+  } else if (self && ts_language_is_data(self)) {
+    ts_language_data_release(self);
   }
 }
 
@@ -37,6 +43,16 @@ void ts_language_table_entry(
   TSStateId state,
   TSSymbol symbol,
   TableEntry *result
+) {
+  ts_language_indexed_table_entry(self, NULL, state, symbol, result);
+}
+
+void ts_language_indexed_table_entry(
+  const TSLanguage *self,
+  const LookupIndex *index,
+  TSStateId state,
+  TSSymbol symbol,
+  TableEntry *result
 ) {
   if (symbol == ts_builtin_sym_error || symbol == ts_builtin_sym_error_repeat) {
     result->action_count = 0;
@@ -44,7 +60,7 @@ void ts_language_table_entry(
     result->actions = NULL;
   } else {
     assert(symbol < self->token_count);
-    uint32_t action_index = ts_language_lookup(self, state, symbol);
+    uint32_t action_index = ts_language_indexed_lookup(self, index, state, symbol);
     const TSParseActionEntry *entry = &self->parse_actions[action_index];
     result->action_count = entry->entry.count;
     result->is_reusable = entry->entry.reusable;
@@ -77,24 +93,164 @@ TSStateId ts_language_next_state(
   const TSLanguage *self,
   TSStateId state,
   TSSymbol symbol
+) {
+  return ts_language_indexed_next_state(self, NULL, state, symbol);
+}
+
+TSStateId ts_language_indexed_next_state(
+  const TSLanguage *self,
+  const LookupIndex *index,
+  TSStateId state,
+  TSSymbol symbol
 ) {
   if (symbol == ts_builtin_sym_error || symbol == ts_builtin_sym_error_repeat) {
     return 0;
   } else if (symbol < self->token_count) {
-    uint32_t count;
-    const TSParseAction *actions = ts_language_actions(self, state, symbol, &count);
-    if (count > 0) {
-      TSParseAction action = actions[count - 1];
+    TableEntry entry;
+    ts_language_indexed_table_entry(self, index, state, symbol, &entry);
+    if (entry.action_count > 0) {
+      TSParseAction action = entry.actions[entry.action_count - 1];
       if (action.type == TSParseActionTypeShift) {
         return action.shift.extra ? state : action.shift.state;
       }
     }
     return 0;
   } else {
-    return ts_language_lookup(self, state, symbol);
+    return ts_language_indexed_lookup(self, index, state, symbol);
   }
 }
 
+// LookupIndex
+
+void ts_lookup_index_init(LookupIndex *self, const TSLanguage *language) {
+  *self = (LookupIndex) {0};
+  uint32_t small_state_count = language->state_count - language->large_state_count;
+  if (small_state_count == 0) return;
+
+  uint32_t words_per_state = (language->symbol_count + 63) / 64;
+  uint32_t word_count = small_state_count * words_per_state;
+  self->words_per_state = words_per_state;
+  self->bitmaps = ts_calloc(word_count, sizeof(uint64_t));
+  self->ranks = ts_calloc(word_count, sizeof(uint16_t));
+  self->offsets = ts_calloc(small_state_count, sizeof(uint32_t));
+
+  // Mark the symbols that appear in each state, and compute the number of
+  // values that precede each word of the bitmaps.
+  uint32_t value_count = 0;
+  for (uint32_t i = 0; i < small_state_count; i++) {
+    uint64_t *bitmap = &self->bitmaps[i * words_per_state];
+    const uint16_t *data = &language->small_parse_table[language->small_parse_table_map[i]];
+    uint16_t group_count = *(data++);
+    for (unsigned j = 0; j < group_count; j++) {
+      data++;
+      uint16_t symbol_count = *(data++);
+      for (unsigned k = 0; k < symbol_count; k++) {
+        TSSymbol symbol = *(data++);
+        bitmap[symbol / 64] |= (uint64_t)1 << (symbol % 64);
+      }
+    }
+
+    self->offsets[i] = value_count;
+    uint16_t rank = 0;
+    for (uint32_t j = 0; j < words_per_state; j++) {
+      self->ranks[i * words_per_state + j] = rank;
+      rank += ts_lookup_index__popcount(bitmap[j]);
+    }
+    value_count += rank;
+  }
+
+  // Store each symbol's value in its slot. If a symbol appears more than once
+  // in a state, the first occurrence wins, as in `ts_language_lookup`. To
+  // achieve that, the groups are visited in reverse order.
+  self->values = ts_calloc(value_count > 0 ? value_count : 1, sizeof(uint16_t));
+  Array(const uint16_t *) groups = array_new();
+  for (uint32_t i = 0; i < small_state_count; i++) {
+    const uint16_t *data = &language->small_parse_table[language->small_parse_table_map[i]];
+    uint16_t group_count = *(data++);
+    array_clear(&groups);
+    for (unsigned j = 0; j < group_count; j++) {
+      array_push(&groups, data);
+      data += 2 + data[1];
+    }
+    for (unsigned j = groups.size; j > 0; j--) {
+      const uint16_t *group = groups.contents[j - 1];
+      uint16_t value = group[0];
+      for (unsigned k = 0; k < group[1]; k++) {
+        TSSymbol symbol = group[2 + k];
+        uint32_t word_index = i * words_per_state + symbol / 64;
+        uint64_t bit = (uint64_t)1 << (symbol % 64);
+        uint32_t rank =
+          self->ranks[word_index] +
+          ts_lookup_index__popcount(self->bitmaps[word_index] & (bit - 1));
+        self->values[self->offsets[i] + rank] = value;
+      }
+    }
+  }
+  array_delete(&groups);
+}
+
+void ts_lookup_index_delete(LookupIndex *self) {
+  ts_free(self->bitmaps);
+  ts_free(self->ranks);
+  ts_free(self->offsets);
+  ts_free(self->values);
+  *self = (LookupIndex) {0};
+}
+
+// ValidSymbolIndex
+
+static int ts_valid_symbol_index__compare(const void *a, const void *b) {
+  return (int)*(const TSSymbol *)a - (int)*(const TSSymbol *)b;
+}
+
+void ts_valid_symbol_index_delete(ValidSymbolIndex *self) {
+  ts_free(self->offsets);
+  array_delete(&self->symbols);
+  *self = (ValidSymbolIndex) {0};
+}
+
+// Get the symbols that are valid in the given state. The returned list
+// remains valid until the list of another state is built.
+const TSSymbol *ts_valid_symbol_index_get(
+  ValidSymbolIndex *self,
+  const TSLanguage *language,
+  TSStateId state,
+  uint32_t *count
+) {
+  if (!self->offsets) {
+    self->offsets = ts_calloc(language->state_count, sizeof(uint32_t));
+  }
+
+  uint32_t offset = self->offsets[state];
+  if (offset == 0) {
+    offset = self->symbols.size + 1;
+    array_push(&self->symbols, 0);
+    LookaheadIterator iterator = ts_language_lookaheads(language, state);
+    while (ts_lookahead_iterator__next(&iterator)) {
+      array_push(&self->symbols, iterator.symbol);
+    }
+
+    // A small state lists its symbols grouped by their table value, and may
+    // list a symbol more than once.
+    TSSymbol *list = &self->symbols.contents[offset];
+    uint32_t list_size = self->symbols.size - offset;
+    if (state >= language->large_state_count && list_size > 1) {
+      qsort(list, list_size, sizeof(TSSymbol), ts_valid_symbol_index__compare);
+      uint32_t unique_size = 1;
+      for (uint32_t i = 1; i < list_size; i++) {
+        if (list[i] != list[unique_size - 1]) list[unique_size++] = list[i];
+      }
+      self->symbols.size = offset + unique_size;
+      list_size = unique_size;
+    }
+    self->symbols.contents[offset - 1] = (TSSymbol)list_size;
+    self->offsets[state] = offset;
+  }
+
+  *count = self->symbols.contents[offset - 1];
+  return &self->symbols.contents[offset];
+}
+
 const char *ts_language_symbol_name(
   const TSLanguage *self,
   TSSymbol symbol
@@ -110,6 +266,19 @@ const char *ts_language_symbol_name(
   }
 }
 
+static inline bool ts_language__symbol_has_name(
+  const TSLanguage *self,
+  TSSymbol symbol,
+  const char *string,
+  uint32_t length,
+  bool is_named
+) {
+  TSSymbolMetadata metadata = ts_language_symbol_metadata(self, symbol);
+  if ((!metadata.visible && !metadata.supertype) || metadata.named != is_named) return false;
+  const char *symbol_name = self->symbol_names[symbol];
+  return !strncmp(symbol_name, string, length) && !symbol_name[length];
+}
+
 TSSymbol ts_language_symbol_for_name(
   const TSLanguage *self,
   const char *string,
@@ -119,16 +288,81 @@ TSSymbol ts_language_symbol_for_name(
   if (!strncmp(string, "ERROR", length)) return ts_builtin_sym_error;
   uint16_t count = (uint16_t)ts_language_symbol_count(self);
   for (TSSymbol i = 0; i < count; i++) {
-    TSSymbolMetadata metadata = ts_language_symbol_metadata(self, i);
-    if ((!metadata.visible && !metadata.supertype) || metadata.named != is_named) continue;
-    const char *symbol_name = self->symbol_names[i];
-    if (!strncmp(symbol_name, string, length) && !symbol_name[length]) {
+    if (ts_language__symbol_has_name(self, i, string, length, is_named)) {
       return self->public_symbol_map[i];
     }
   }
   return 0;
 }
 
+#define SYMBOL_NAME_INDEX_EMPTY UINT32_MAX
+
+static inline uint32_t ts_symbol_name_index__hash(
+  const char *string,
+  uint32_t length,
+  bool is_named
+) {
+  uint32_t hash = 2166136261u;
+  for (uint32_t i = 0; i < length; i++) {
+    hash = (hash ^ (uint8_t)string[i]) * 16777619u;
+  }
+  return (hash ^ is_named) * 16777619u;
+}
+
+void ts_symbol_name_index_init(SymbolNameIndex *self, const TSLanguage *language) {
+  uint32_t count = ts_language_symbol_count(language);
+  uint32_t capacity = 16;
+  while (capacity < count * 2) capacity *= 2;
+  self->capacity = capacity;
+  self->slots = ts_malloc(capacity * sizeof(uint32_t));
+  memset(self->slots, 0xff, capacity * sizeof(uint32_t));
+
+  // Insert the symbols in order, and skip any whose name has already been
+  // inserted, so that lookups find the same symbol as a linear search.
+  for (uint32_t i = 0; i < count; i++) {
+    TSSymbolMetadata metadata = ts_language_symbol_metadata(language, i);
+    if (!metadata.visible && !metadata.supertype) continue;
+    const char *name = language->symbol_names[i];
+    uint32_t length = (uint32_t)strlen(name);
+    uint32_t slot = ts_symbol_name_index__hash(name, length, metadata.named) & (capacity - 1);
+    for (;;) {
+      uint32_t symbol = self->slots[slot];
+      if (symbol == SYMBOL_NAME_INDEX_EMPTY) {
+        self->slots[slot] = i;
+        break;
+      }
+      if (ts_language__symbol_has_name(language, symbol, name, length, metadata.named)) break;
+      slot = (slot + 1) & (capacity - 1);
+    }
+  }
+}
+
+void ts_symbol_name_index_delete(SymbolNameIndex *self) {
+  ts_free(self->slots);
+  *self = (SymbolNameIndex) {0};
+}
+
+// Look up a symbol by name, with the same result as `ts_language_symbol_for_name`.
+TSSymbol ts_symbol_name_index_lookup(
+  const SymbolNameIndex *self,
+  const TSLanguage *language,
+  const char *string,
+  uint32_t length,
+  bool is_named
+) {
+  if (!self->slots) return ts_language_symbol_for_name(language, string, length, is_named);
+  if (!strncmp(string, "ERROR", length)) return ts_builtin_sym_error;
+  uint32_t slot = ts_symbol_name_index__hash(string, length, is_named) & (self->capacity - 1);
+  for (;;) {
+    uint32_t symbol = self->slots[slot];
+    if (symbol == SYMBOL_NAME_INDEX_EMPTY) return 0;
+    if (ts_language__symbol_has_name(language, symbol, string, length, is_named)) {
+      return language->public_symbol_map[symbol];
+    }
+    slot = (slot + 1) & (self->capacity - 1);
+  }
+}
+
 TSSymbolType ts_language_symbol_type(
   const TSLanguage *self,
   TSSymbol symbol
@@ -155,67 +389,98 @@ const char *ts_language_field_name_for_id(
   }
 }
 
+// The field names are sorted, so they can be searched by bisection.
 TSFieldId ts_language_field_id_for_name(
   const TSLanguage *self,
   const char *name,
   uint32_t name_length
 ) {
-  uint16_t count = (uint16_t)ts_language_field_count(self);
-  for (TSSymbol i = 1; i < count + 1; i++) {
-    switch (strncmp(name, self->field_names[i], name_length)) {
-      case 0:
-        if (self->field_names[i][name_length] == 0) return i;
-        break;
-      case -1:
-        return 0;
-      default:
-        break;
+  uint32_t index = 1;
+  uint32_t size = ts_language_field_count(self);
+  while (size > 0) {
+    uint32_t half_size = size / 2;
+    const char *field_name = self->field_names[index + half_size];
+    int comparison = strncmp(field_name, name, name_length);
+    if (comparison == 0) {
+      if (!field_name[name_length]) return (TSFieldId)(index + half_size);
+      comparison = 1;
+    }
+    if (comparison > 0) {
+      size = half_size;
+    } else {
+      index += half_size + 1;
+      size -= half_size + 1;
     }
   }
   return 0;
 }
 
+// The public lookahead iterator also remembers the valid symbols of each
+// large state that it visits, so that moving it back to one of those states
+// doesn't require scanning the state's table row again. Small states already
+// list their valid symbols explicitly.
+struct TSLookaheadIterator {
+  LookaheadIterator iterator;
+  ValidSymbolIndex valid_symbol_index;
+};
+
+static void ts_lookahead_iterator__reset(
+  TSLookaheadIterator *self,
+  const TSLanguage *language,
+  TSStateId state
+) {
+  if (language != self->iterator.language) {
+    ts_valid_symbol_index_delete(&self->valid_symbol_index);
+  }
+  self->iterator = ts_language_lookaheads(language, state);
+  if (state < language->large_state_count) {
+    uint32_t count;
+    const TSSymbol *symbols = ts_valid_symbol_index_get(
+      &self->valid_symbol_index, language, state, &count
+    );
+    self->iterator.symbols = symbols;
+    self->iterator.symbols_end = symbols + count;
+  }
+}
+
 TSLookaheadIterator *ts_lookahead_iterator_new(const TSLanguage *self, TSStateId state) {
   if (state >= self->state_count) return NULL;
-  LookaheadIterator *iterator = ts_malloc(sizeof(LookaheadIterator));
-  *iterator = ts_language_lookaheads(self, state);
-  return (TSLookaheadIterator *)iterator;
+  TSLookaheadIterator *iterator = ts_malloc(sizeof(TSLookaheadIterator));
+  iterator->iterator.language = self;
+  iterator->valid_symbol_index = (ValidSymbolIndex) {0};
+  ts_lookahead_iterator__reset(iterator, self, state);
+  return iterator;
 }
 
 void ts_lookahead_iterator_delete(TSLookaheadIterator *self) {
+  ts_valid_symbol_index_delete(&self->valid_symbol_index);
   ts_free(self);
 }
 
 bool ts_lookahead_iterator_reset_state(TSLookaheadIterator * self, TSStateId state) {
-  LookaheadIterator *iterator = (LookaheadIterator *)self;
-  if (state >= iterator->language->state_count) return false;
-  *iterator = ts_language_lookaheads(iterator->language, state);
+  if (state >= self->iterator.language->state_count) return false;
+  ts_lookahead_iterator__reset(self, self->iterator.language, state);
   return true;
 }
 
 const TSLanguage *ts_lookahead_iterator_language(const TSLookaheadIterator *self) {
-  const LookaheadIterator *iterator = (const LookaheadIterator *)self;
-  return iterator->language;
+  return self->iterator.language;
 }
 
 bool ts_lookahead_iterator_reset(TSLookaheadIterator *self, const TSLanguage *language, TSStateId state) {
   if (state >= language->state_count) return false;
-  LookaheadIterator *iterator = (LookaheadIterator *)self;
-  *iterator = ts_language_lookaheads(language, state);
+  ts_lookahead_iterator__reset(self, language, state);
   return true;
 }
 
 bool ts_lookahead_iterator_next(TSLookaheadIterator *self) {
-  LookaheadIterator *iterator = (LookaheadIterator *)self;
-  return ts_lookahead_iterator__next(iterator);
+  return ts_lookahead_iterator__next(&self->iterator);
 }
 
 TSSymbol ts_lookahead_iterator_current_symbol(const TSLookaheadIterator *self) {
-  const LookaheadIterator *iterator = (const LookaheadIterator *)self;
-  return iterator->symbol;
+  return self->iterator.symbol;
 }
 
 const char *ts_lookahead_iterator_current_symbol_name(const TSLookaheadIterator *self) {
-  const LookaheadIterator *iterator = (const LookaheadIterator *)self;
-  return ts_language_symbol_name(iterator->language, iterator->symbol);
+  return ts_language_symbol_name(self->iterator.language, self->iterator.symbol);
 }
@@ -33,9 +33,62 @@ typedef struct {
   TSSymbol symbol;
   TSStateId next_state;
   uint16_t action_count;
+
+  // For a large state, the list of its valid symbols, if it is known. The
+  // iterator then visits only these symbols, instead of the whole table row.
+  const TSSymbol *symbols;
+  const TSSymbol *symbols_end;
 } LookaheadIterator;
 
+// An index over a language's 'small' parse states, which allows their table
+// values to be looked up in constant time, rather than by searching through
+// the state's symbol groups.
+//
+// For each small state, a bitmap records which symbols have a table value.
+// The values themselves are stored densely, in symbol order, so a symbol's
+// value is found by counting the bits that precede it in the bitmap.
+typedef struct {
+  uint64_t *bitmaps;
+  uint16_t *ranks;
+  uint32_t *offsets;
+  uint16_t *values;
+  uint32_t words_per_state;
+} LookupIndex;
+
+void ts_lookup_index_init(LookupIndex *, const TSLanguage *);
+void ts_lookup_index_delete(LookupIndex *);
+
+// A hash table of a language's visible symbols, keyed by name and by whether
+// the symbol is named, for callers that look up many symbols by name. The
+// language itself can't hold this, because it is a static, read-only struct.
+typedef struct {
+  uint32_t *slots;
+  uint32_t capacity;
+} SymbolNameIndex;
+
+void ts_symbol_name_index_init(SymbolNameIndex *, const TSLanguage *);
+void ts_symbol_name_index_delete(SymbolNameIndex *);
+TSSymbol ts_symbol_name_index_lookup(const SymbolNameIndex *, const TSLanguage *, const char *, uint32_t, bool);
+
+// Lists of the symbols that have actions in each parse state, in ascending
+// order, for callers that repeatedly need all of the valid symbols of a
+// state. Each list is built the first time that its state is requested, so
+// that visiting it again is a single read, without scanning the large
+// state's table row or decoding the small state's groups.
+//
+// The lists are stored one after another in `symbols`, each preceded by its
+// length. `offsets` holds the position of each state's list, which is never
+// zero because of the preceding length, or zero if it has not been built yet.
+typedef struct {
+  uint32_t *offsets;
+  Array(TSSymbol) symbols;
+} ValidSymbolIndex;
+
+void ts_valid_symbol_index_delete(ValidSymbolIndex *);
+const TSSymbol *ts_valid_symbol_index_get(ValidSymbolIndex *, const TSLanguage *, TSStateId, uint32_t *);
+
 void ts_language_table_entry(const TSLanguage *, TSStateId, TSSymbol, TableEntry *);
+void ts_language_indexed_table_entry(const TSLanguage *, const LookupIndex *, TSStateId, TSSymbol, TableEntry *);
 
 TSSymbolMetadata ts_language_symbol_metadata(const TSLanguage *, TSSymbol);
 
@@ -43,6 +96,8 @@ TSSymbol ts_language_public_symbol(const TSLanguage *, TSSymbol);
 
 TSStateId ts_language_next_state(const TSLanguage *self, TSStateId state, TSSymbol symbol);
 
+TSStateId ts_language_indexed_next_state(const TSLanguage *, const LookupIndex *, TSStateId, TSSymbol);
+
 static inline bool ts_language_is_symbol_external(const TSLanguage *self, TSSymbol symbol) {
   return 0 < symbol && symbol < self->external_token_count + 1;
 }
@@ -98,6 +153,38 @@ static inline uint16_t ts_language_lookup(
   }
 }
 
+static inline unsigned ts_lookup_index__popcount(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+  return (unsigned)__builtin_popcountll(value);
+#else
+  value = value - ((value >> 1) & 0x5555555555555555ULL);
+  value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+  value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (unsigned)((value * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// Lookup the table value for a given symbol and state, using the given
+// index for small parse states if it has been built.
+static inline uint16_t ts_language_indexed_lookup(
+  const TSLanguage *self,
+  const LookupIndex *index,
+  TSStateId state,
+  TSSymbol symbol
+) {
+  if (index && index->bitmaps && state >= self->large_state_count) {
+    if (symbol >= self->symbol_count) return 0;
+    uint32_t word_index =
+      (state - self->large_state_count) * index->words_per_state + symbol / 64;
+    uint64_t bit = (uint64_t)1 << (symbol % 64);
+    uint64_t word = index->bitmaps[word_index];
+    if (!(word & bit)) return 0;
+    uint32_t rank = index->ranks[word_index] + ts_lookup_index__popcount(word & (bit - 1));
+    return index->values[index->offsets[state - self->large_state_count] + rank];
+  }
+  return ts_language_lookup(self, state, symbol);
+}
+
 static inline bool ts_language_has_actions(
   const TSLanguage *self,
   TSStateId state,
@@ -136,6 +223,8 @@ static inline LookaheadIterator ts_language_lookaheads(
     .is_small_state = is_small_state,
     .symbol = UINT16_MAX,
     .next_state = 0,
+    .symbols = NULL,
+    .symbols_end = NULL,
   };
 }
 
@@ -158,7 +247,15 @@ static inline bool ts_lookahead_iterator__next(LookaheadIterator *self) {
     }
   }
 
-  // For large parse states, iterate through every symbol until one
+  // For large parse states whose valid symbols are known, read the table
+  // value of each of those symbols directly.
+  else if (self->symbols) {
+    if (self->symbols == self->symbols_end) return false;
+    self->symbol = *(self->symbols++);
+    self->table_value = self->data[self->symbol + 1];
+  }
+
+  // For other large parse states, iterate through every symbol until one
   // is found that has valid actions.
   else {
     do {
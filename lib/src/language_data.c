@@ -0,0 +1,580 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "tree_sitter/api.h"
+#include "./alloc.h"
+#include "./atomic.h"
+#include "./language.h"
+#include "./language_data.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#define TS_LANGUAGE_DATA_MMAP
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TS_LANGUAGE_DATA_MMAP
+#endif
+
+// A language data file contains a language's tables, laid out exactly as the
+// runtime reads them, so that a language can be loaded by pointing into the
+// file's bytes instead of by compiling its generated C code. The file is
+// written by `tree-sitter generate --emit-language-data`.
+//
+// The file starts with a header, which holds the language's counts and the
+// offset and size in bytes of each of its sections. Every section starts at a
+// multiple of 8 bytes, and holds an array of one of the types in `parser.h`, in
+// the native layout of a little-endian platform. Names are stored as offsets
+// into a section of null-terminated strings, because they are the only part
+// of a language that the runtime reads through pointers. The lexer's states
+// are stored as the transition tables that `ts_lex_with_table` runs.
+
+#define LANGUAGE_DATA_MAGIC 0x474c5354  // "TSLG"
+#define LANGUAGE_DATA_FORMAT_VERSION 1
+#define LANGUAGE_DATA_ALIGNMENT 8
+
+typedef enum {
+  LanguageDataSectionParseTable,
+  LanguageDataSectionSmallParseTable,
+  LanguageDataSectionSmallParseTableMap,
+  LanguageDataSectionParseActions,
+  LanguageDataSectionStrings,
+  LanguageDataSectionSymbolNames,
+  LanguageDataSectionFieldNames,
+  LanguageDataSectionFieldMapSlices,
+  LanguageDataSectionFieldMapEntries,
+  LanguageDataSectionSymbolMetadata,
+  LanguageDataSectionPublicSymbolMap,
+  LanguageDataSectionAliasMap,
+  LanguageDataSectionAliasSequences,
+  LanguageDataSectionLexModes,
+  LanguageDataSectionLexStates,
+  LanguageDataSectionLexAsciiClasses,
+  LanguageDataSectionLexAsciiRows,
+  LanguageDataSectionLexRanges,
+  LanguageDataSectionKeywordLexStates,
+  LanguageDataSectionKeywordLexAsciiClasses,
+  LanguageDataSectionKeywordLexAsciiRows,
+  LanguageDataSectionKeywordLexRanges,
+  LanguageDataSectionExternalScannerStates,
+  LanguageDataSectionExternalScannerSymbolMap,
+  LanguageDataSectionPrimaryStateIds,
+  LanguageDataSectionCount,
+} LanguageDataSection;
+
+typedef struct {
+  uint32_t offset;
+  uint32_t size;
+} LanguageDataSectionEntry;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t format_version;
+  uint32_t version;
+  uint32_t symbol_count;
+  uint32_t alias_count;
+  uint32_t token_count;
+  uint32_t external_token_count;
+  uint32_t state_count;
+  uint32_t large_state_count;
+  uint32_t production_id_count;
+  uint32_t field_count;
+  uint32_t max_alias_sequence_length;
+  uint32_t keyword_capture_token;
+  uint32_t lex_ascii_class_count;
+  uint32_t keyword_lex_ascii_class_count;
+  uint32_t section_count;
+  LanguageDataSectionEntry sections[LanguageDataSectionCount];
+} LanguageDataHeader;
+
+// LanguageData - A language whose tables point into the bytes of a language
+// data file. The language is the first field, so that a pointer to the
+// language is also a pointer to this struct.
+typedef struct {
+  TSLanguage language;
+  TSLexTable lex_table;
+  TSLexTable keyword_lex_table;
+  const char **symbol_names;
+  const char **field_names;
+  const uint8_t *data;
+  size_t length;
+  bool is_mapped;
+  volatile uint32_t ref_count;
+} LanguageData;
+
+// The lex functions are not called for languages that are loaded from data,
+// because the parser runs their lex tables directly. This function marks the
+// language as one that was loaded from data.
+static bool ts_language_data__sentinel_lex_fn(TSLexer *lexer, TSStateId state) {
+  (void)lexer;
+  (void)state;
+  return false;
+}
+
+bool ts_language_is_data(const TSLanguage *self) {
+  return self->lex_fn == ts_language_data__sentinel_lex_fn;
+}
+
+const TSLexTable *ts_language_data_lex_table(const TSLanguage *self) {
+  return &((const LanguageData *)self)->lex_table;
+}
+
+const TSLexTable *ts_language_data_keyword_lex_table(const TSLanguage *self) {
+  return &((const LanguageData *)self)->keyword_lex_table;
+}
+
+/*
+ *  Reading and mapping files
+ */
+
+static void ts_language_data__unmap(const uint8_t *data, size_t length, bool is_mapped) {
+  if (!is_mapped) {
+    ts_free((void *)data);
+    return;
+  }
+#if defined(_WIN32)
+  (void)length;
+  UnmapViewOfFile(data);
+#elif defined(TS_LANGUAGE_DATA_MMAP)
+  munmap((void *)data, length);
+#else
+  (void)length;
+#endif
+}
+
+#if defined(_WIN32)
+
+static const uint8_t *ts_language_data__map(const char *path, size_t *length) {
+  int path_length = MultiByteToWideChar(CP_UTF8, 0, path, -1, NULL, 0);
+  if (path_length == 0) return NULL;
+  wchar_t *wide_path = ts_malloc(path_length * sizeof(wchar_t));
+  MultiByteToWideChar(CP_UTF8, 0, path, -1, wide_path, path_length);
+  HANDLE file = CreateFileW(
+    wide_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL
+  );
+  ts_free(wide_path);
+  if (file == INVALID_HANDLE_VALUE) return NULL;
+
+  const uint8_t *result = NULL;
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0 && (uint64_t)size.QuadPart <= SIZE_MAX) {
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping) {
+      result = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      *length = (size_t)size.QuadPart;
+      // The view keeps the mapping alive after its handle is closed.
+      CloseHandle(mapping);
+    }
+  }
+  CloseHandle(file);
+  return result;
+}
+
+#elif defined(TS_LANGUAGE_DATA_MMAP)
+
+static const uint8_t *ts_language_data__map(const char *path, size_t *length) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+
+  const uint8_t *result = NULL;
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0 && (uint64_t)info.st_size <= SIZE_MAX) {
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data != MAP_FAILED) {
+      result = data;
+      *length = (size_t)info.st_size;
+    }
+  }
+  close(fd);
+  return result;
+}
+
+#endif
+
+// Read the file into memory, on platforms without memory-mapped files, or
+// when the file can't be mapped.
+static const uint8_t *ts_language_data__read(const char *path, size_t *length) {
+  FILE *file = fopen(path, "rb");
+  if (!file) return NULL;
+
+  uint8_t *result = NULL;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    long size = ftell(file);
+    if (size > 0 && fseek(file, 0, SEEK_SET) == 0) {
+      result = ts_malloc((size_t)size);
+      if (fread(result, 1, (size_t)size, file) == (size_t)size) {
+        *length = (size_t)size;
+      } else {
+        ts_free(result);
+        result = NULL;
+      }
+    }
+  }
+  fclose(file);
+  return result;
+}
+
+/*
+ *  Validation
+ */
+
+static inline const void *ts_language_data__section(
+  const uint8_t *data,
+  const LanguageDataHeader *header,
+  LanguageDataSection section
+) {
+  LanguageDataSectionEntry entry = header->sections[section];
+  return entry.size > 0 ? data + entry.offset : NULL;
+}
+
+static inline uint32_t ts_language_data__size(
+  const LanguageDataHeader *header,
+  LanguageDataSection section
+) {
+  return header->sections[section].size;
+}
+
+static inline bool ts_language_data__has_size(
+  const LanguageDataHeader *header,
+  LanguageDataSection section,
+  uint64_t size
+) {
+  return header->sections[section].size == size;
+}
+
+static inline bool ts_language_data__has_elements(
+  const LanguageDataHeader *header,
+  LanguageDataSection section,
+  size_t element_size
+) {
+  uint32_t size = header->sections[section].size;
+  return size > 0 && size % element_size == 0;
+}
+
+static bool ts_language_data__has_valid_names(
+  const uint8_t *data,
+  const LanguageDataHeader *header,
+  LanguageDataSection section,
+  uint32_t count
+) {
+  if (!ts_language_data__has_size(header, section, (uint64_t)count * sizeof(uint32_t))) return false;
+  const uint32_t *offsets = ts_language_data__section(data, header, section);
+  uint32_t strings_size = ts_language_data__size(header, LanguageDataSectionStrings);
+  for (uint32_t i = 0; i < count; i++) {
+    if (offsets[i] >= strings_size) return false;
+  }
+  return true;
+}
+
+static bool ts_language_data__has_valid_lex_table(
+  const LanguageDataHeader *header,
+  LanguageDataSection states,
+  uint32_t ascii_class_count
+) {
+  return
+    ts_language_data__has_elements(header, states, sizeof(TSLexTableState)) &&
+    ts_language_data__size(header, states) / sizeof(TSLexTableState) < TS_LEX_TABLE_SKIP &&
+    ts_language_data__has_size(header, states + 1, 129 * sizeof(uint8_t)) &&
+    ascii_class_count > 0 && ascii_class_count <= 129 &&
+    ts_language_data__has_elements(header, states + 2, ascii_class_count * sizeof(uint16_t)) &&
+    ts_language_data__size(header, states + 3) % sizeof(TSLexTableRange) == 0;
+}
+
+// Check that the file has a header that this version of the library can read,
+// and that the size of each section matches the language's counts. The
+// contents of the tables are trusted, as the code of a compiled parser is.
+static TSLanguageLoadError ts_language_data__validate(const uint8_t *data, size_t length) {
+  if (length < sizeof(LanguageDataHeader)) return TSLanguageLoadErrorFormat;
+  const LanguageDataHeader *header = (const LanguageDataHeader *)data;
+  if (header->magic != LANGUAGE_DATA_MAGIC) return TSLanguageLoadErrorFormat;
+  if (
+    header->format_version != LANGUAGE_DATA_FORMAT_VERSION ||
+    header->version < TREE_SITTER_MIN_COMPATIBLE_LANGUAGE_VERSION ||
+    header->version > TREE_SITTER_LANGUAGE_VERSION
+  ) return TSLanguageLoadErrorVersion;
+  if (header->section_count != LanguageDataSectionCount) return TSLanguageLoadErrorFormat;
+
+  for (unsigned i = 0; i < LanguageDataSectionCount; i++) {
+    LanguageDataSectionEntry entry = header->sections[i];
+    if (
+      entry.offset % LANGUAGE_DATA_ALIGNMENT != 0 ||
+      entry.offset < sizeof(LanguageDataHeader) ||
+      (uint64_t)entry.offset + entry.size > length
+    ) return TSLanguageLoadErrorFormat;
+  }
+
+  uint64_t name_count = (uint64_t)header->symbol_count + header->alias_count;
+  uint32_t small_state_count = header->state_count - header->large_state_count;
+  uint32_t strings_size = ts_language_data__size(header, LanguageDataSectionStrings);
+  const char *strings = ts_language_data__section(data, header, LanguageDataSectionStrings);
+  if (
+    header->large_state_count > header->state_count ||
+    header->symbol_count > UINT16_MAX ||
+    header->alias_count > UINT16_MAX ||
+    header->field_count > UINT16_MAX ||
+    !strings || strings[strings_size - 1] != '\0' ||
+    !ts_language_data__has_valid_names(data, header, LanguageDataSectionSymbolNames, (uint32_t)name_count) ||
+    !ts_language_data__has_valid_names(data, header, LanguageDataSectionFieldNames, header->field_count) ||
+    !ts_language_data__has_size(
+      header, LanguageDataSectionParseTable,
+      (uint64_t)header->large_state_count * header->symbol_count * sizeof(uint16_t)
+    ) ||
+    !ts_language_data__has_size(
+      header, LanguageDataSectionSmallParseTableMap,
+      (uint64_t)small_state_count * sizeof(uint32_t)
+    ) ||
+    (small_state_count > 0) != ts_language_data__has_elements(
+      header, LanguageDataSectionSmallParseTable, sizeof(uint16_t)
+    ) ||
+    !ts_language_data__has_elements(header, LanguageDataSectionParseActions, sizeof(TSParseActionEntry)) ||
+    !ts_language_data__has_size(
+      header, LanguageDataSectionFieldMapSlices,
+      header->field_count > 0 ? (uint64_t)header->production_id_count * sizeof(TSFieldMapSlice) : 0
+    ) ||
+    ts_language_data__size(header, LanguageDataSectionFieldMapEntries) % sizeof(TSFieldMapEntry) != 0 ||
+    !ts_language_data__has_size(header, LanguageDataSectionSymbolMetadata, name_count * sizeof(TSSymbolMetadata)) ||
+    !ts_language_data__has_size(header, LanguageDataSectionPublicSymbolMap, name_count * sizeof(TSSymbol)) ||
+    !ts_language_data__has_elements(header, LanguageDataSectionAliasMap, sizeof(uint16_t)) ||
+    !ts_language_data__has_size(
+      header, LanguageDataSectionAliasSequences,
+      (uint64_t)header->production_id_count * header->max_alias_sequence_length * sizeof(TSSymbol)
+    ) ||
+    !ts_language_data__has_size(header, LanguageDataSectionLexModes, (uint64_t)header->state_count * sizeof(TSLexMode)) ||
+    !ts_language_data__has_valid_lex_table(header, LanguageDataSectionLexStates, header->lex_ascii_class_count) ||
+    !ts_language_data__has_size(
+      header, LanguageDataSectionPrimaryStateIds,
+      header->version >= LANGUAGE_VERSION_WITH_PRIMARY_STATES
+        ? (uint64_t)header->state_count * sizeof(TSStateId)
+        : 0
+    )
+  ) return TSLanguageLoadErrorFormat;
+
+  const uint32_t *small_parse_table_map = ts_language_data__section(
+    data, header, LanguageDataSectionSmallParseTableMap
+  );
+  uint32_t small_parse_table_length =
+    ts_language_data__size(header, LanguageDataSectionSmallParseTable) / sizeof(uint16_t);
+  for (uint32_t i = 0; i < small_state_count; i++) {
+    if (small_parse_table_map[i] >= small_parse_table_length) return TSLanguageLoadErrorFormat;
+  }
+
+  if (header->keyword_capture_token) {
+    if (!ts_language_data__has_valid_lex_table(
+      header, LanguageDataSectionKeywordLexStates, header->keyword_lex_ascii_class_count
+    )) return TSLanguageLoadErrorFormat;
+  } else {
+    for (unsigned i = LanguageDataSectionKeywordLexStates; i <= LanguageDataSectionKeywordLexRanges; i++) {
+      if (header->sections[i].size > 0) return TSLanguageLoadErrorFormat;
+    }
+  }
+
+  if (header->external_token_count > 0) {
+    if (
+      !ts_language_data__has_elements(
+        header, LanguageDataSectionExternalScannerStates, header->external_token_count * sizeof(bool)
+      ) ||
+      !ts_language_data__has_size(
+        header, LanguageDataSectionExternalScannerSymbolMap,
+        (uint64_t)header->external_token_count * sizeof(TSSymbol)
+      )
+    ) return TSLanguageLoadErrorFormat;
+  } else if (
+    ts_language_data__size(header, LanguageDataSectionExternalScannerStates) > 0 ||
+    ts_language_data__size(header, LanguageDataSectionExternalScannerSymbolMap) > 0
+  ) return TSLanguageLoadErrorFormat;
+
+  return TSLanguageLoadErrorNone;
+}
+
+/*
+ *  Loading
+ */
+
+static const char **ts_language_data__names(
+  const uint8_t *data,
+  const LanguageDataHeader *header,
+  LanguageDataSection section,
+  uint32_t count,
+  uint32_t first_index
+) {
+  const uint32_t *offsets = ts_language_data__section(data, header, section);
+  const char *strings = ts_language_data__section(data, header, LanguageDataSectionStrings);
+  const char **result = ts_calloc(first_index + count, sizeof(const char *));
+  for (uint32_t i = 0; i < count; i++) {
+    result[first_index + i] = strings + offsets[i];
+  }
+  return result;
+}
+
+static TSLexTable ts_language_data__lex_table(
+  const uint8_t *data,
+  const LanguageDataHeader *header,
+  LanguageDataSection states,
+  uint32_t ascii_class_count
+) {
+  return (TSLexTable) {
+    .states = ts_language_data__section(data, header, states),
+    .ascii_classes = ts_language_data__section(data, header, states + 1),
+    .ascii_rows = ts_language_data__section(data, header, states + 2),
+    .ranges = ts_language_data__section(data, header, states + 3),
+    .ascii_class_count = (uint16_t)ascii_class_count,
+  };
+}
+
+// Create a language that points into the given bytes, which it takes ownership
+// of if it is created successfully.
+static const TSLanguage *ts_language_data__new(
+  const uint8_t *data,
+  size_t length,
+  bool is_mapped,
+  const TSExternalScanner *scanner,
+  TSLanguageLoadError *error
+) {
+  *error = ts_language_data__validate(data, length);
+  if (*error != TSLanguageLoadErrorNone) return NULL;
+
+  const LanguageDataHeader *header = (const LanguageDataHeader *)data;
+  if (header->external_token_count > 0 && (
+    !scanner || !scanner->create || !scanner->destroy || !scanner->scan ||
+    !scanner->serialize || !scanner->deserialize
+  )) {
+    *error = TSLanguageLoadErrorScanner;
+    return NULL;
+  }
+
+  LanguageData *self = ts_calloc(1, sizeof(LanguageData));
+  self->data = data;
+  self->length = length;
+  self->is_mapped = is_mapped;
+  self->ref_count = 1;
+  self->symbol_names = ts_language_data__names(
+    data, header, LanguageDataSectionSymbolNames, header->symbol_count + header->alias_count, 0
+  );
+  if (header->field_count > 0) {
+    self->field_names = ts_language_data__names(
+      data, header, LanguageDataSectionFieldNames, header->field_count, 1
+    );
+  }
+  self->lex_table = ts_language_data__lex_table(
+    data, header, LanguageDataSectionLexStates, header->lex_ascii_class_count
+  );
+
+  self->language = (TSLanguage) {
+    .version = header->version,
+    .symbol_count = header->symbol_count,
+    .alias_count = header->alias_count,
+    .token_count = header->token_count,
+    .external_token_count = header->external_token_count,
+    .state_count = header->state_count,
+    .large_state_count = header->large_state_count,
+    .production_id_count = header->production_id_count,
+    .field_count = header->field_count,
+    .max_alias_sequence_length = (uint16_t)header->max_alias_sequence_length,
+    .parse_table = ts_language_data__section(data, header, LanguageDataSectionParseTable),
+    .small_parse_table = ts_language_data__section(data, header, LanguageDataSectionSmallParseTable),
+    .small_parse_table_map = ts_language_data__section(data, header, LanguageDataSectionSmallParseTableMap),
+    .parse_actions = ts_language_data__section(data, header, LanguageDataSectionParseActions),
+    .symbol_names = self->symbol_names,
+    .field_names = self->field_names,
+    .field_map_slices = ts_language_data__section(data, header, LanguageDataSectionFieldMapSlices),
+    .field_map_entries = ts_language_data__section(data, header, LanguageDataSectionFieldMapEntries),
+    .symbol_metadata = ts_language_data__section(data, header, LanguageDataSectionSymbolMetadata),
+    .public_symbol_map = ts_language_data__section(data, header, LanguageDataSectionPublicSymbolMap),
+    .alias_map = ts_language_data__section(data, header, LanguageDataSectionAliasMap),
+    .alias_sequences = ts_language_data__section(data, header, LanguageDataSectionAliasSequences),
+    .lex_modes = ts_language_data__section(data, header, LanguageDataSectionLexModes),
+    .lex_fn = ts_language_data__sentinel_lex_fn,
+    .primary_state_ids = ts_language_data__section(data, header, LanguageDataSectionPrimaryStateIds),
+  };
+
+  if (header->keyword_capture_token) {
+    self->keyword_lex_table = ts_language_data__lex_table(
+      data, header, LanguageDataSectionKeywordLexStates, header->keyword_lex_ascii_class_count
+    );
+    self->language.keyword_lex_fn = ts_language_data__sentinel_lex_fn;
+    self->language.keyword_capture_token = (TSSymbol)header->keyword_capture_token;
+  }
+
+  if (header->external_token_count > 0) {
+    self->language.external_scanner.states =
+      ts_language_data__section(data, header, LanguageDataSectionExternalScannerStates);
+    self->language.external_scanner.symbol_map =
+      ts_language_data__section(data, header, LanguageDataSectionExternalScannerSymbolMap);
+    self->language.external_scanner.create = scanner->create;
+    self->language.external_scanner.destroy = scanner->destroy;
+    self->language.external_scanner.scan = scanner->scan;
+    self->language.external_scanner.serialize = scanner->serialize;
+    self->language.external_scanner.deserialize = scanner->deserialize;
+  }
+
+  return &self->language;
+}
+
+const TSLanguage *ts_language_load_mmap(
+  const char *path,
+  const TSExternalScanner *scanner,
+  TSLanguageLoadError *error
+) {
+  TSLanguageLoadError unused_error;
+  if (!error) error = &unused_error;
+
+  size_t length = 0;
+  bool is_mapped = false;
+  const uint8_t *data = NULL;
+#ifdef TS_LANGUAGE_DATA_MMAP
+  data = ts_language_data__map(path, &length);
+  is_mapped = data != NULL;
+#endif
+  if (!data) data = ts_language_data__read(path, &length);
+  if (!data) {
+    *error = TSLanguageLoadErrorIO;
+    return NULL;
+  }
+
+  const TSLanguage *result = ts_language_data__new(data, length, is_mapped, scanner, error);
+  if (!result) ts_language_data__unmap(data, length, is_mapped);
+  return result;
+}
+
+const TSLanguage *ts_language_load_data(
+  const void *data,
+  size_t length,
+  const TSExternalScanner *scanner,
+  TSLanguageLoadError *error
+) {
+  TSLanguageLoadError unused_error;
+  if (!error) error = &unused_error;
+  if (length < sizeof(LanguageDataHeader)) {
+    *error = TSLanguageLoadErrorFormat;
+    return NULL;
+  }
+
+  // Copy the data into a buffer that is suitably aligned for its tables.
+  uint8_t *copy = ts_malloc(length);
+  memcpy(copy, data, length);
+  const TSLanguage *result = ts_language_data__new(copy, length, false, scanner, error);
+  if (!result) ts_free(copy);
+  return result;
+}
+
+void ts_language_data_retain(const TSLanguage *self) {
+  LanguageData *data = (LanguageData *)self;
+  assert(data->ref_count > 0);
+  atomic_inc(&data->ref_count);
+}
+
+void ts_language_data_release(const TSLanguage *self) {
+  LanguageData *data = (LanguageData *)self;
+  assert(data->ref_count > 0);
+  if (atomic_dec(&data->ref_count) == 0) {
+    ts_language_data__unmap(data->data, data->length, data->is_mapped);
+    ts_free(data->symbol_names);
+    ts_free(data->field_names);
+    ts_free(data);
+  }
+}
@@ -0,0 +1,22 @@
+#ifndef TREE_SITTER_LANGUAGE_DATA_H_
+#define TREE_SITTER_LANGUAGE_DATA_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tree_sitter/api.h"
+#include "./parser.h"
+
+bool ts_language_is_data(const TSLanguage *);
+const TSLexTable *ts_language_data_lex_table(const TSLanguage *);
+const TSLexTable *ts_language_data_keyword_lex_table(const TSLanguage *);
+
+void ts_language_data_retain(const TSLanguage *);
+void ts_language_data_release(const TSLanguage *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TREE_SITTER_LANGUAGE_DATA_H_
@@ -3,6 +3,7 @@
 #include "./subtree.h"
 #include "./length.h"
 #include "./unicode.h"
+#include "./get_changed_ranges.h"
 #include <stdarg.h>
 
 #define LOG(message, character)              \
@@ -55,7 +56,7 @@ static void ts_lexer__clear_chunk(Lexer *self) {
 
 // Call the lexer's input callback to obtain a new chunk of source code
 // for the current position.
-static void ts_lexer__get_chunk(Lexer *self) {
+static void ts_lexer__read_chunk(Lexer *self) {
   self->chunk_start = self->current_position.bytes;
   self->chunk = self->input.read(
     self->input.payload,
@@ -66,6 +67,147 @@ static void ts_lexer__get_chunk(Lexer *self) {
   if (!self->chunk_size) {
     self->current_included_range_index = self->included_range_count;
     self->chunk = NULL;
+    return;
+  }
+
+  // Remember the chunk, discarding the least recently used one if the
+  // cache is full.
+  if (self->chunk_cache_capacity) {
+    if (self->chunk_cache.size == self->chunk_cache_capacity) {
+      self->chunk_cache.size--;
+    }
+    LexerChunk chunk = {self->chunk, self->chunk_start, self->chunk_size};
+    array_insert(&self->chunk_cache, 0, chunk);
+  }
+}
+
+// Find the index of the span that contains the given byte offset, or the
+// number of spans if the offset is past the end of the text. The search
+// starts with the given span and the one after it, because the lexer
+// usually moves forward through the text.
+uint32_t ts_lexer_find_input_span(
+  const TSInputSpan *spans,
+  uint32_t count,
+  uint32_t hint,
+  uint32_t position
+) {
+  for (uint32_t i = hint; i < count && i < hint + 2; i++) {
+    if (spans[i].byte_offset <= position && position - spans[i].byte_offset < spans[i].length) {
+      return i;
+    }
+  }
+
+  // Find the last span that starts at or before the position. Because the
+  // spans are adjacent, it contains the position unless the position is past
+  // the end of the text.
+  uint32_t lower = 0, upper = count;
+  while (lower < upper) {
+    uint32_t middle = lower + (upper - lower) / 2;
+    if (spans[middle].byte_offset <= position) {
+      lower = middle + 1;
+    } else {
+      upper = middle;
+    }
+  }
+  if (lower > 0) {
+    const TSInputSpan *span = &spans[lower - 1];
+    if (position - span->byte_offset < span->length) return lower - 1;
+  }
+  return count;
+}
+
+// Obtain a chunk of source code that spans the current position, calling
+// the input callback only if the position is not within the input spans
+// or within one of the recently read chunks.
+static void ts_lexer__get_chunk(Lexer *self) {
+  uint32_t position = self->current_position.bytes;
+  if (self->input_spans) {
+    uint32_t index = ts_lexer_find_input_span(
+      self->input_spans,
+      self->input_span_count,
+      self->input_span_index,
+      position
+    );
+    if (index < self->input_span_count) {
+      const TSInputSpan *span = &self->input_spans[index];
+      self->input_span_index = index;
+      self->chunk = span->bytes;
+      self->chunk_start = span->byte_offset;
+      self->chunk_size = span->length;
+    } else {
+      self->chunk = NULL;
+      self->chunk_start = position;
+      self->chunk_size = 0;
+      self->current_included_range_index = self->included_range_count;
+    }
+    return;
+  }
+
+  for (uint32_t i = 0; i < self->chunk_cache.size; i++) {
+    LexerChunk chunk = self->chunk_cache.contents[i];
+    if (chunk.start <= position && position - chunk.start < chunk.size) {
+      if (i > 0) {
+        array_erase(&self->chunk_cache, i);
+        array_insert(&self->chunk_cache, 0, chunk);
+      }
+      self->chunk = chunk.contents;
+      self->chunk_start = chunk.start;
+      self->chunk_size = chunk.size;
+      return;
+    }
+  }
+
+  ts_lexer__read_chunk(self);
+}
+
+// Find the length of the longest prefix of the given UTF8 text that
+// consists only of ASCII characters. The text is examined eight bytes
+// at a time.
+static uint32_t ts_lexer__ascii_prefix_length(const uint8_t *string, uint32_t length) {
+  uint32_t i = 0;
+  for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, &string[i], sizeof(word));
+    if (word & 0x8080808080808080ULL) break;
+  }
+  while (i < length && string[i] < 0x80) i++;
+  return i;
+}
+
+// Decode a character that is encoded as a single code unit, which is most
+// characters in practice, without going through the general decoder for the
+// input's encoding. Returns the size of the character in bytes, or zero if
+// it is encoded as several code units.
+static inline uint32_t ts_lexer__decode_code_unit(
+  TSInputEncoding encoding,
+  const uint8_t *string,
+  uint32_t length,
+  int32_t *code_point
+) {
+  switch (encoding) {
+    case TSInputEncodingLatin1:
+      *code_point = string[0];
+      return 1;
+    case TSInputEncodingUTF16: {
+      if (length < 2) return 0;
+      uint16_t code_unit;
+      memcpy(&code_unit, string, sizeof(code_unit));
+      if (U16_IS_LEAD(code_unit) || U16_IS_TRAIL(code_unit)) return 0;
+      *code_point = code_unit;
+      return 2;
+    }
+    default:
+      if (string[0] >= 0x80) return 0;
+      *code_point = string[0];
+      return 1;
+  }
+}
+
+static UnicodeDecodeFunction ts_lexer__decode_function(const Lexer *self) {
+  switch (self->input.encoding) {
+    case TSInputEncodingUTF16: return ts_decode_utf16;
+    case TSInputEncodingLatin1: return ts_decode_latin1;
+    default: return ts_decode_utf8;
   }
 }
 
@@ -83,16 +225,22 @@ static void ts_lexer__get_lookahead(Lexer *self) {
   }
 
   const uint8_t *chunk = (const uint8_t *)self->chunk + position_in_chunk;
-  UnicodeDecodeFunction decode = self->input.encoding == TSInputEncodingUTF8
-    ? ts_decode_utf8
-    : ts_decode_utf16;
 
+  self->lookahead_size = ts_lexer__decode_code_unit(
+    self->input.encoding,
+    chunk,
+    size,
+    &self->data.lookahead
+  );
+  if (self->lookahead_size) return;
+
+  UnicodeDecodeFunction decode = ts_lexer__decode_function(self);
   self->lookahead_size = decode(chunk, size, &self->data.lookahead);
 
   // If this chunk ended in the middle of a multi-byte character,
-  // try again with a fresh chunk.
+  // try again with a fresh chunk that starts at the current position.
   if (self->data.lookahead == TS_DECODE_ERROR && size < 4) {
-    ts_lexer__get_chunk(self);
+    ts_lexer__read_chunk(self);
     chunk = (const uint8_t *)self->chunk;
     size = self->chunk_size;
     self->lookahead_size = decode(chunk, size, &self->data.lookahead);
@@ -106,25 +254,36 @@ static void ts_lexer__get_lookahead(Lexer *self) {
 static void ts_lexer_goto(Lexer *self, Length position) {
   self->current_position = position;
 
-  // Move to the first valid position at or after the given position.
-  bool found_included_range = false;
-  for (unsigned i = 0; i < self->included_range_count; i++) {
-    TSRange *included_range = &self->included_ranges[i];
-    if (
-      included_range->end_byte > self->current_position.bytes &&
-      included_range->end_byte > included_range->start_byte
-    ) {
-      if (included_range->start_byte >= self->current_position.bytes) {
-        self->current_position = (Length) {
-          .bytes = included_range->start_byte,
-          .extent = included_range->start_point,
-        };
-      }
+  // Move to the first valid position at or after the given position. The
+  // ranges' end bytes are in increasing order, so find the first range that
+  // ends after the position with a binary search, and then skip any empty
+  // ranges.
+  uint32_t index = 0;
+  uint32_t size = self->included_range_count;
+  while (size > 0) {
+    uint32_t half_size = size / 2;
+    if (self->included_ranges[index + half_size].end_byte > position.bytes) {
+      size = half_size;
+    } else {
+      index += half_size + 1;
+      size -= half_size + 1;
+    }
+  }
+  while (
+    index < self->included_range_count &&
+    self->included_ranges[index].end_byte == self->included_ranges[index].start_byte
+  ) index++;
 
-      self->current_included_range_index = i;
-      found_included_range = true;
-      break;
+  bool found_included_range = index < self->included_range_count;
+  if (found_included_range) {
+    TSRange *included_range = &self->included_ranges[index];
+    if (included_range->start_byte >= self->current_position.bytes) {
+      self->current_position = (Length) {
+        .bytes = included_range->start_byte,
+        .extent = included_range->start_point,
+      };
     }
+    self->current_included_range_index = index;
   }
 
   if (found_included_range) {
@@ -246,29 +405,120 @@ static void ts_lexer__mark_end(TSLexer *_self) {
   self->token_end_position = self->current_position;
 }
 
+// Count the characters between the given byte on the current line and the
+// current position, if that text is contained in the current chunk of
+// source code. In UTF8, runs of ASCII text are counted in bulk. In UTF16,
+// only surrogate pairs need to be examined, and in Latin1, each byte is a
+// character. Returns false if the count cannot be computed this way.
+static bool ts_lexer__count_column_in_chunk(
+  Lexer *self,
+  uint32_t start_byte,
+  uint32_t *result
+) {
+  if (!self->chunk) return false;
+
+  uint32_t goal_byte = self->current_position.bytes;
+  uint32_t chunk_end_byte = self->chunk_start + self->chunk_size;
+  if (start_byte < self->chunk_start || goal_byte > chunk_end_byte) return false;
+
+  const uint8_t *chunk = (const uint8_t *)self->chunk + (start_byte - self->chunk_start);
+  uint32_t length = goal_byte - start_byte;
+  uint32_t available = chunk_end_byte - start_byte;
+  uint32_t count = 0;
+  uint32_t i = 0;
+
+  if (self->input.encoding == TSInputEncodingLatin1) {
+    *result = length;
+    return true;
+  }
+
+  if (self->input.encoding == TSInputEncodingUTF16) {
+    if (length % 2) return false;
+    while (i < length) {
+      uint16_t code_unit;
+      memcpy(&code_unit, &chunk[i], sizeof(code_unit));
+      i += 2;
+      count++;
+      if (U16_IS_LEAD(code_unit) && i + 2 <= available) {
+        memcpy(&code_unit, &chunk[i], sizeof(code_unit));
+        if (U16_IS_TRAIL(code_unit)) i += 2;
+      }
+    }
+    *result = count;
+    return true;
+  }
+
+  while (i < length) {
+    uint32_t ascii_length = ts_lexer__ascii_prefix_length(&chunk[i], length - i);
+    count += ascii_length;
+    i += ascii_length;
+    if (i < length) {
+      int32_t code_point;
+      uint32_t size = ts_decode_utf8(&chunk[i], available - i, &code_point);
+      i += code_point == TS_DECODE_ERROR ? 1 : size;
+      count++;
+    }
+  }
+
+  *result = count;
+  return true;
+}
+
+static void ts_lexer__clear_column_checkpoint(Lexer *self) {
+  self->column_checkpoint = (LexerColumnCheckpoint) {
+    .line_start_byte = UINT32_MAX,
+    .byte = 0,
+    .column = 0,
+  };
+}
+
 static uint32_t ts_lexer__get_column(TSLexer *_self) {
   Lexer *self = (Lexer *)_self;
 
   uint32_t goal_byte = self->current_position.bytes;
+  uint32_t line_start_byte = goal_byte - self->current_position.extent.column;
 
   self->did_get_column = true;
-  self->current_position.bytes -= self->current_position.extent.column;
-  self->current_position.extent.column = 0;
 
-  if (self->current_position.bytes < self->chunk_start) {
-    ts_lexer__get_chunk(self);
+  uint32_t result = 0;
+  if (ts_lexer__eof(_self)) return result;
+
+  // External scanners often ask for the column at every token, so rather
+  // than counting from the start of the line each time, resume from the
+  // last position whose column was computed, if it is earlier on this line.
+  LexerColumnCheckpoint *checkpoint = &self->column_checkpoint;
+  uint32_t start_byte = line_start_byte;
+  if (checkpoint->line_start_byte == line_start_byte && checkpoint->byte <= goal_byte) {
+    start_byte = checkpoint->byte;
+    result = checkpoint->column;
   }
 
-  uint32_t result = 0;
-  if (!ts_lexer__eof(_self)) {
+  uint32_t count;
+  if (ts_lexer__count_column_in_chunk(self, start_byte, &count)) {
+    result += count;
+  } else {
+    self->current_position.bytes = start_byte;
+    self->current_position.extent.column = start_byte - line_start_byte;
+
+    if (self->current_position.bytes < self->chunk_start) {
+      ts_lexer__get_chunk(self);
+    }
+
     ts_lexer__get_lookahead(self);
     while (self->current_position.bytes < goal_byte && self->chunk) {
       result++;
       ts_lexer__do_advance(self, false);
       if (ts_lexer__eof(_self)) break;
     }
+
+    if (self->current_position.bytes != goal_byte) return result;
   }
 
+  *checkpoint = (LexerColumnCheckpoint) {
+    .line_start_byte = line_start_byte,
+    .byte = goal_byte,
+    .column = result,
+  };
   return result;
 }
 
@@ -314,6 +564,11 @@ void ts_lexer_init(Lexer *self) {
     .chunk = NULL,
     .chunk_size = 0,
     .chunk_start = 0,
+    .input_spans = NULL,
+    .input_span_count = 0,
+    .input_span_index = 0,
+    .chunk_cache = array_new(),
+    .chunk_cache_capacity = 0,
     .current_position = {0, {0, 0}},
     .logger = {
       .payload = NULL,
@@ -321,21 +576,47 @@ void ts_lexer_init(Lexer *self) {
     },
     .included_ranges = NULL,
     .included_range_count = 0,
+    .included_range_capacity = 0,
     .current_included_range_index = 0,
   };
+  ts_lexer__clear_column_checkpoint(self);
   ts_lexer_set_included_ranges(self, NULL, 0);
 }
 
 void ts_lexer_delete(Lexer *self) {
   ts_free(self->included_ranges);
+  array_delete(&self->chunk_cache);
 }
 
 void ts_lexer_set_input(Lexer *self, TSInput input) {
   self->input = input;
+  self->input_spans = NULL;
+  self->input_span_count = 0;
+  self->input_span_index = 0;
+  array_clear(&self->chunk_cache);
   ts_lexer__clear_chunk(self);
+  ts_lexer__clear_column_checkpoint(self);
   ts_lexer_goto(self, self->current_position);
 }
 
+// Give the lexer direct access to the entire text of the current input,
+// stored in a sequence of adjacent spans, so that it never needs to call
+// the input callback for a new chunk.
+void ts_lexer_set_input_spans(Lexer *self, const TSInputSpan *spans, uint32_t count) {
+  self->input_spans = spans;
+  self->input_span_count = count;
+  self->input_span_index = 0;
+}
+
+// Set the number of chunks returned by the input callback that the lexer
+// remembers, so that moving back to a position within one of them does
+// not require calling the callback again.
+void ts_lexer_set_chunk_cache_capacity(Lexer *self, uint32_t capacity) {
+  self->chunk_cache_capacity = capacity;
+  array_clear(&self->chunk_cache);
+  array_reserve(&self->chunk_cache, capacity);
+}
+
 // Move the lexer to the given position. This doesn't do any work
 // if the parser is already at the given position.
 void ts_lexer_reset(Lexer *self, Length position) {
@@ -396,6 +677,65 @@ void ts_lexer_mark_end(Lexer *self) {
   ts_lexer__mark_end(&self->data);
 }
 
+// Decode up to `capacity` of the characters that the lexer would visit next,
+// starting with the lookahead character, without advancing. Decoding stops at
+// the end of the current chunk or included range, so the result may be shorter
+// than the remaining text. Returns the number of characters written.
+uint32_t ts_lexer_decode_ahead(Lexer *self, int32_t *characters, uint32_t capacity) {
+  if (capacity == 0 || !self->chunk || ts_lexer__eof(&self->data)) return 0;
+
+  characters[0] = self->data.lookahead;
+  uint32_t count = 1;
+
+  // Positions are relative to the start of the current chunk.
+  const TSRange *current_range = &self->included_ranges[self->current_included_range_index];
+  uint32_t position = self->current_position.bytes + self->lookahead_size - self->chunk_start;
+  uint32_t end = self->chunk_size;
+  if (current_range->end_byte - self->chunk_start < end) {
+    end = current_range->end_byte - self->chunk_start;
+  }
+
+  UnicodeDecodeFunction decode = ts_lexer__decode_function(self);
+  const uint8_t *chunk = (const uint8_t *)self->chunk;
+  while (count < capacity && position < end) {
+    int32_t character;
+    uint32_t size = ts_lexer__decode_code_unit(
+      self->input.encoding,
+      &chunk[position],
+      self->chunk_size - position,
+      &character
+    );
+    if (!size) {
+      size = decode(&chunk[position], self->chunk_size - position, &character);
+      if (character == TS_DECODE_ERROR) {
+        // A character that is split across chunks can only be decoded
+        // by advancing to it.
+        if (self->chunk_size - position < 4) break;
+        size = 1;
+      }
+    }
+    characters[count++] = character;
+    position += size;
+  }
+
+  return count;
+}
+
+// Grow the included ranges' buffer to hold at least the given number of
+// ranges. The buffer is never shrunk, so that setting new ranges on every
+// parse doesn't reallocate it.
+static void ts_lexer__reserve_included_ranges(Lexer *self, uint32_t count) {
+  if (count <= self->included_range_capacity) return;
+  uint32_t capacity = self->included_range_capacity * 2;
+  if (capacity < count) capacity = count;
+  self->included_ranges = ts_realloc_in(
+    TSAllocationCategoryIncludedRanges,
+    self->included_ranges,
+    capacity * sizeof(TSRange)
+  );
+  self->included_range_capacity = capacity;
+}
+
 bool ts_lexer_set_included_ranges(
   Lexer *self,
   const TSRange *ranges,
@@ -416,14 +756,58 @@ bool ts_lexer_set_included_ranges(
     }
   }
 
-  size_t size = count * sizeof(TSRange);
-  self->included_ranges = ts_realloc(self->included_ranges, size);
-  memcpy(self->included_ranges, ranges, size);
+  ts_lexer__reserve_included_ranges(self, count);
+  memcpy(self->included_ranges, ranges, count * sizeof(TSRange));
   self->included_range_count = count;
   ts_lexer_goto(self, self->current_position);
   return true;
 }
 
+bool ts_lexer_splice_included_ranges(
+  Lexer *self,
+  uint32_t index,
+  uint32_t old_count,
+  const TSRange *ranges,
+  uint32_t count
+) {
+  if (index > self->included_range_count) return false;
+  if (old_count > self->included_range_count - index) return false;
+
+  uint32_t previous_byte = index > 0 ? self->included_ranges[index - 1].end_byte : 0;
+  for (unsigned i = 0; i < count; i++) {
+    const TSRange *range = &ranges[i];
+    if (
+      range->start_byte < previous_byte ||
+      range->end_byte < range->start_byte
+    ) return false;
+    previous_byte = range->end_byte;
+  }
+  uint32_t tail_index = index + old_count;
+  uint32_t tail_count = self->included_range_count - tail_index;
+  if (tail_count > 0 && self->included_ranges[tail_index].start_byte < previous_byte) {
+    return false;
+  }
+
+  uint32_t new_count = self->included_range_count - old_count + count;
+  if (new_count == 0) return ts_lexer_set_included_ranges(self, NULL, 0);
+
+  ts_lexer__reserve_included_ranges(self, new_count);
+  memmove(
+    &self->included_ranges[index + count],
+    &self->included_ranges[tail_index],
+    tail_count * sizeof(TSRange)
+  );
+  if (count > 0) memcpy(&self->included_ranges[index], ranges, count * sizeof(TSRange));
+  self->included_range_count = new_count;
+  ts_lexer_goto(self, self->current_position);
+  return true;
+}
+
+void ts_lexer_edit_included_ranges(Lexer *self, const TSInputEdit *edit) {
+  ts_range_array_edit(self->included_ranges, self->included_range_count, edit);
+  ts_lexer_goto(self, self->current_position);
+}
+
 TSRange *ts_lexer_included_ranges(const Lexer *self, uint32_t *count) {
   *count = self->included_range_count;
   return self->included_ranges;
@@ -10,6 +10,21 @@ extern "C" {
 #include "tree_sitter/api.h"
 #include "./parser.h"
 
+typedef struct {
+  const char *contents;
+  uint32_t start;
+  uint32_t size;
+} LexerChunk;
+
+// The column of a position on the current line, saved so that later calls
+// to `get_column` on the same line can count from there instead of from
+// the start of the line.
+typedef struct {
+  uint32_t line_start_byte;
+  uint32_t byte;
+  uint32_t column;
+} LexerColumnCheckpoint;
+
 typedef struct {
   TSLexer data;
   Length current_position;
@@ -20,12 +35,19 @@ typedef struct {
   const char *chunk;
   TSInput input;
   TSLogger logger;
+  const TSInputSpan *input_spans;
+  Array(LexerChunk) chunk_cache;
+  LexerColumnCheckpoint column_checkpoint;
 
   uint32_t included_range_count;
+  uint32_t included_range_capacity;
   uint32_t current_included_range_index;
   uint32_t chunk_start;
   uint32_t chunk_size;
   uint32_t lookahead_size;
+  uint32_t input_span_count;
+  uint32_t input_span_index;
+  uint32_t chunk_cache_capacity;
   bool did_get_column;
 
   char debug_buffer[TREE_SITTER_SERIALIZATION_BUFFER_SIZE];
@@ -34,12 +56,18 @@ typedef struct {
 void ts_lexer_init(Lexer *);
 void ts_lexer_delete(Lexer *);
 void ts_lexer_set_input(Lexer *, TSInput);
+void ts_lexer_set_input_spans(Lexer *, const TSInputSpan *, uint32_t);
+uint32_t ts_lexer_find_input_span(const TSInputSpan *, uint32_t, uint32_t, uint32_t);
+void ts_lexer_set_chunk_cache_capacity(Lexer *, uint32_t);
 void ts_lexer_reset(Lexer *, Length);
 void ts_lexer_start(Lexer *);
 void ts_lexer_finish(Lexer *, uint32_t *);
 void ts_lexer_advance_to_end(Lexer *);
 void ts_lexer_mark_end(Lexer *);
+uint32_t ts_lexer_decode_ahead(Lexer *, int32_t *, uint32_t);
 bool ts_lexer_set_included_ranges(Lexer *self, const TSRange *ranges, uint32_t count);
+bool ts_lexer_splice_included_ranges(Lexer *self, uint32_t index, uint32_t old_count, const TSRange *ranges, uint32_t count);
+void ts_lexer_edit_included_ranges(Lexer *self, const TSInputEdit *edit);
 TSRange *ts_lexer_included_ranges(const Lexer *self, uint32_t *count);
 
 #ifdef __cplusplus
@@ -1,14 +1,18 @@
 #define _POSIX_C_SOURCE 200112L
 
 #include "./alloc.c"
+#include "./flat_tree.c"
 #include "./get_changed_ranges.c"
 #include "./language.c"
+#include "./language_data.c"
 #include "./lexer.c"
 #include "./node.c"
 #include "./parser.c"
 #include "./query.c"
+#include "./regex.c"
 #include "./stack.c"
 #include "./subtree.c"
 #include "./tree_cursor.c"
 #include "./tree.c"
+#include "./tree_snapshot.c"
 #include "./wasm_store.c"
@@ -1,4 +1,5 @@
 #include <stdbool.h>
+#include "./atomic.h"
 #include "./subtree.h"
 #include "./tree.h"
 #include "./language.h"
@@ -118,6 +119,76 @@ static inline bool ts_node_child_iterator_next_sibling_is_empty_adjacent(NodeChi
   return ts_node_end_byte(previous) == ts_node_end_byte(next) && ts_node__is_relevant(next, true);
 }
 
+// ChildIndex
+
+// Nodes with fewer visible children than this are not indexed, because
+// finding one of their children by iterating is already fast.
+static const uint32_t CHILD_INDEX_MIN_CHILD_COUNT = 16;
+
+static inline uint32_t ts_child_index__hash(const SubtreeHeapData *node) {
+  return (uint32_t)(((uintptr_t)node >> 3) * 2654435761u);
+}
+
+// Get the array of the given node's visible or named children, or NULL
+// if the node is not indexed.
+static inline const ChildIndexEntry *ts_node__child_index(
+  const TSNode *node,
+  bool include_anonymous
+) {
+  if (!node->tree) return NULL;
+  const ChildIndex *index = node->tree->child_index;
+  if (!index) return NULL;
+  Subtree subtree = ts_node__subtree(*node);
+  if (
+    ts_subtree_child_count(subtree) == 0 ||
+    subtree.ptr->visible_child_count < CHILD_INDEX_MIN_CHILD_COUNT
+  ) return NULL;
+
+  uint32_t mask = index->capacity - 1;
+  for (uint32_t i = ts_child_index__hash(subtree.ptr) & mask;; i = (i + 1) & mask) {
+    const SubtreeHeapData *entry = index->nodes[i];
+    if (!entry) return NULL;
+    if (entry == subtree.ptr) {
+      uint32_t offset = include_anonymous
+        ? index->visible_entry_offsets[i]
+        : index->named_entry_offsets[i];
+      return &index->entries.contents[offset];
+    }
+  }
+}
+
+static inline TSNode ts_node__indexed_child(const TSNode *node, const ChildIndexEntry *entry) {
+  Length start = {ts_node_start_byte(*node), ts_node_start_point(*node)};
+  return ts_node_new(
+    node->tree,
+    entry->subtree,
+    length_add(start, entry->offset),
+    entry->alias_symbol
+  );
+}
+
+// ParentIndex
+
+static inline uint32_t ts_parent_index__hash(const Subtree *node, uint32_t start_byte) {
+  return (uint32_t)((((uintptr_t)node >> 3) ^ start_byte) * 2654435761u);
+}
+
+// Find the entry for the given node in the tree's parent index, or return
+// NULL if the tree has no parent index.
+static inline const ParentIndexEntry *ts_node__parent_index_entry(const TSNode *node) {
+  const ParentIndex *index = node->tree->parent_index;
+  if (!index) return NULL;
+
+  uint32_t start_byte = ts_node_start_byte(*node);
+  uint32_t mask = index->capacity - 1;
+  for (uint32_t i = ts_parent_index__hash(node->id, start_byte) & mask;; i = (i + 1) & mask) {
+    uint32_t slot = index->slots[i];
+    if (!slot) return NULL;
+    const ParentIndexEntry *entry = &index->entries.contents[slot - 1];
+    if (entry->node == node->id && entry->position.bytes == start_byte) return entry;
+  }
+}
+
 // TSNode - private
 
 static inline bool ts_node__is_relevant(TSNode self, bool include_anonymous) {
@@ -150,11 +221,54 @@ static inline uint32_t ts_node__relevant_child_count(
   }
 }
 
+// Find the index of a node within the indexed array of its parent's
+// relevant children.
+static inline bool ts_node__find_indexed_child(
+  const TSNode *parent,
+  const ChildIndexEntry *entries,
+  bool include_anonymous,
+  TSNode node,
+  uint32_t *result
+) {
+  uint32_t parent_start_byte = ts_node_start_byte(*parent);
+  uint32_t node_start_byte = ts_node_start_byte(node);
+  if (node_start_byte < parent_start_byte) return false;
+
+  uint32_t goal = node_start_byte - parent_start_byte;
+  uint32_t count = ts_node__relevant_child_count(*parent, include_anonymous);
+  uint32_t low = 0, high = count;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (entries[mid].offset.bytes < goal) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  // Several zero-width children may start at the same position.
+  for (uint32_t i = low; i < count && entries[i].offset.bytes == goal; i++) {
+    if (entries[i].subtree == node.id) {
+      *result = i;
+      return true;
+    }
+  }
+  return false;
+}
+
 static inline TSNode ts_node__child(
   TSNode self,
   uint32_t child_index,
   bool include_anonymous
 ) {
+  const ChildIndexEntry *entries = ts_node__child_index(&self, include_anonymous);
+  if (entries) {
+    if (child_index >= ts_node__relevant_child_count(self, include_anonymous)) {
+      return ts_node__null();
+    }
+    return ts_node__indexed_child(&self, &entries[child_index]);
+  }
+
   TSNode result = self;
   bool did_descend = true;
 
@@ -207,6 +321,19 @@ static inline TSNode ts_node__prev_sibling(TSNode self, bool include_anonymous)
   uint32_t target_end_byte = ts_node_end_byte(self);
 
   TSNode node = ts_node_parent(self);
+
+  // If the parent is indexed, the previous sibling is the preceding entry
+  // in its array of children. Empty nodes are excluded, because their order
+  // relative to other empty nodes at the same position is ambiguous.
+  const ChildIndexEntry *entries = ts_node__child_index(&node, include_anonymous);
+  uint32_t index;
+  if (
+    entries && !self_is_empty &&
+    ts_node__find_indexed_child(&node, entries, include_anonymous, self, &index)
+  ) {
+    return index > 0 ? ts_node__indexed_child(&node, &entries[index - 1]) : ts_node__null();
+  }
+
   TSNode earlier_node = ts_node__null();
   bool earlier_node_is_relevant = false;
 
@@ -266,6 +393,20 @@ static inline TSNode ts_node__next_sibling(TSNode self, bool include_anonymous)
   uint32_t target_end_byte = ts_node_end_byte(self);
 
   TSNode node = ts_node_parent(self);
+
+  // If the parent is indexed, the next sibling is the following entry in
+  // its array of children.
+  const ChildIndexEntry *entries = ts_node__child_index(&node, include_anonymous);
+  uint32_t index;
+  if (
+    entries && ts_subtree_total_bytes(ts_node__subtree(self)) > 0 &&
+    ts_node__find_indexed_child(&node, entries, include_anonymous, self, &index)
+  ) {
+    return index + 1 < ts_node__relevant_child_count(node, include_anonymous)
+      ? ts_node__indexed_child(&node, &entries[index + 1])
+      : ts_node__null();
+  }
+
   TSNode later_node = ts_node__null();
   bool later_node_is_relevant = false;
 
@@ -520,6 +661,10 @@ uint32_t ts_node_descendant_count(TSNode self) {
   return ts_subtree_visible_descendant_count(ts_node__subtree(self)) + 1;
 }
 
+uint64_t ts_node_hash(TSNode self) {
+  return ts_subtree_hash(ts_node__subtree(self), ts_node_symbol(self), self.tree->language);
+}
+
 TSStateId ts_node_parse_state(TSNode self) {
   return ts_subtree_parse_state(ts_node__subtree(self));
 }
@@ -538,6 +683,13 @@ TSNode ts_node_parent(TSNode self) {
   TSNode node = ts_tree_root_node(self.tree);
   if (node.id == self.id) return ts_node__null();
 
+  const ParentIndexEntry *entry = ts_node__parent_index_entry(&self);
+  if (entry) {
+    if (entry->parent == PARENT_INDEX_ROOT) return node;
+    const ParentIndexEntry *parent = &self.tree->parent_index->entries.contents[entry->parent];
+    return ts_node_new(self.tree, parent->node, parent->position, parent->alias_symbol);
+  }
+
   while (true) {
    TSNode next_node = ts_node_child_containing_descendant(node, self);
    if (ts_node_is_null(next_node)) break;
@@ -868,3 +1020,208 @@ void ts_node_edit(TSNode *self, const TSInputEdit *edit) {
   self->context[1] = start_point.row;
   self->context[2] = start_point.column;
 }
+
+// ChildIndex - construction
+
+typedef Array(NodeChildIterator) NodeChildIteratorArray;
+
+// Append the relevant children of the given node to the index's entries,
+// descending into any children that are not relevant themselves. The node
+// must start at zero, so that the children's positions are relative to it.
+static void ts_child_index__push_children(
+  ChildIndex *self,
+  TSNode node,
+  bool include_anonymous,
+  NodeChildIteratorArray *stack
+) {
+  array_clear(stack);
+  array_push(stack, ts_node_iterate_children(&node));
+  while (stack->size > 0) {
+    TSNode child;
+    if (!ts_node_child_iterator_next(array_back(stack), &child)) {
+      stack->size--;
+    } else if (ts_node__is_relevant(child, include_anonymous)) {
+      array_push(&self->entries, ((ChildIndexEntry) {
+        .subtree = child.id,
+        .offset = {ts_node_start_byte(child), ts_node_start_point(child)},
+        .alias_symbol = ts_node__alias(&child),
+      }));
+    } else if (ts_node__relevant_child_count(child, include_anonymous) > 0) {
+      array_push(stack, ts_node_iterate_children(&child));
+    }
+  }
+}
+
+// Build an index of the tree's nodes, or return NULL if none of them has
+// enough children to be indexed.
+ChildIndex *ts_child_index_new(const TSTree *tree) {
+  ChildIndex index = {.entries = array_new(), .ref_count = 1};
+  Array(const SubtreeHeapData *) nodes = array_new();
+  Array(uint32_t) entry_offsets = array_new();
+  Array(TSNode) stack = array_new();
+  NodeChildIteratorArray iterator_stack = array_new();
+
+  // Index the nodes that can be visited through the public API: the root
+  // node, and the nodes that are visible or aliased.
+  array_push(&stack, ts_node_new(tree, &tree->root, length_zero(), 0));
+  bool is_root = true;
+  while (stack.size > 0) {
+    TSNode node = array_pop(&stack);
+    Subtree subtree = ts_node__subtree(node);
+
+    if (
+      (is_root || ts_node__is_relevant(node, true)) &&
+      subtree.ptr->visible_child_count >= CHILD_INDEX_MIN_CHILD_COUNT
+    ) {
+      TSNode indexed_node = ts_node_new(tree, node.id, length_zero(), ts_node__alias(&node));
+      array_push(&nodes, subtree.ptr);
+      array_push(&entry_offsets, index.entries.size);
+      ts_child_index__push_children(&index, indexed_node, true, &iterator_stack);
+      array_push(&entry_offsets, index.entries.size);
+      ts_child_index__push_children(&index, indexed_node, false, &iterator_stack);
+    }
+    is_root = false;
+
+    TSNode child;
+    NodeChildIterator iterator = ts_node_iterate_children(&node);
+    while (ts_node_child_iterator_next(&iterator, &child)) {
+      if (ts_subtree_child_count(ts_node__subtree(child)) > 0) array_push(&stack, child);
+    }
+  }
+
+  ChildIndex *self = NULL;
+  if (nodes.size > 0) {
+    index.capacity = 1;
+    while (index.capacity < nodes.size * 2) index.capacity *= 2;
+    index.nodes = ts_calloc(index.capacity, sizeof(const SubtreeHeapData *));
+    index.visible_entry_offsets = ts_calloc(index.capacity, sizeof(uint32_t));
+    index.named_entry_offsets = ts_calloc(index.capacity, sizeof(uint32_t));
+    uint32_t mask = index.capacity - 1;
+    for (uint32_t i = 0; i < nodes.size; i++) {
+      const SubtreeHeapData *node = nodes.contents[i];
+      uint32_t j = ts_child_index__hash(node) & mask;
+      while (index.nodes[j] && index.nodes[j] != node) j = (j + 1) & mask;
+      index.nodes[j] = node;
+      index.visible_entry_offsets[j] = entry_offsets.contents[2 * i];
+      index.named_entry_offsets[j] = entry_offsets.contents[2 * i + 1];
+    }
+    self = ts_malloc(sizeof(ChildIndex));
+    *self = index;
+  } else {
+    array_delete(&index.entries);
+  }
+
+  array_delete(&nodes);
+  array_delete(&entry_offsets);
+  array_delete(&stack);
+  array_delete(&iterator_stack);
+  return self;
+}
+
+void ts_child_index_retain(ChildIndex *self) {
+  assert(self->ref_count > 0);
+  atomic_inc(&self->ref_count);
+}
+
+void ts_child_index_release(ChildIndex *self) {
+  if (!self) return;
+  assert(self->ref_count > 0);
+  if (atomic_dec(&self->ref_count) > 0) return;
+  ts_free(self->nodes);
+  ts_free(self->visible_entry_offsets);
+  ts_free(self->named_entry_offsets);
+  array_delete(&self->entries);
+  ts_free(self);
+}
+
+size_t ts_child_index_size(const ChildIndex *self) {
+  if (!self) return 0;
+  return
+    self->capacity * (sizeof(const SubtreeHeapData *) + 2 * sizeof(uint32_t)) +
+    self->entries.capacity * sizeof(ChildIndexEntry);
+}
+
+// ParentIndex - construction
+
+typedef struct {
+  TSNode node;
+  uint32_t parent;
+} ParentIndexStackEntry;
+
+// Build an index of the tree's visible nodes, or return NULL if the root node
+// has no visible descendants.
+ParentIndex *ts_parent_index_new(const TSTree *tree) {
+  ParentIndex index = {.entries = array_new(), .ref_count = 1};
+
+  // Walk the tree, keeping track of each node's nearest visible ancestor.
+  // Hidden nodes are not added to the index, because they can't be visited
+  // through the public API.
+  Array(ParentIndexStackEntry) stack = array_new();
+  array_push(&stack, ((ParentIndexStackEntry) {
+    .node = ts_node_new(tree, &tree->root, ts_subtree_padding(tree->root), 0),
+    .parent = PARENT_INDEX_ROOT,
+  }));
+  bool is_root = true;
+  while (stack.size > 0) {
+    ParentIndexStackEntry stack_entry = array_pop(&stack);
+    TSNode node = stack_entry.node;
+    uint32_t parent = stack_entry.parent;
+    if (!is_root && ts_node__is_relevant(node, true)) {
+      array_push(&index.entries, ((ParentIndexEntry) {
+        .node = node.id,
+        .position = {ts_node_start_byte(node), ts_node_start_point(node)},
+        .alias_symbol = ts_node__alias(&node),
+        .parent = stack_entry.parent,
+      }));
+      parent = index.entries.size - 1;
+    }
+    is_root = false;
+
+    TSNode child;
+    NodeChildIterator iterator = ts_node_iterate_children(&node);
+    while (ts_node_child_iterator_next(&iterator, &child)) {
+      array_push(&stack, ((ParentIndexStackEntry) {.node = child, .parent = parent}));
+    }
+  }
+  array_delete(&stack);
+
+  if (index.entries.size == 0) {
+    array_delete(&index.entries);
+    return NULL;
+  }
+
+  index.capacity = 1;
+  while (index.capacity < index.entries.size * 2) index.capacity *= 2;
+  index.slots = ts_calloc(index.capacity, sizeof(uint32_t));
+  uint32_t mask = index.capacity - 1;
+  for (uint32_t i = 0; i < index.entries.size; i++) {
+    const ParentIndexEntry *entry = &index.entries.contents[i];
+    uint32_t j = ts_parent_index__hash(entry->node, entry->position.bytes) & mask;
+    while (index.slots[j]) j = (j + 1) & mask;
+    index.slots[j] = i + 1;
+  }
+  ParentIndex *self = ts_malloc(sizeof(ParentIndex));
+  *self = index;
+  return self;
+}
+
+void ts_parent_index_retain(ParentIndex *self) {
+  assert(self->ref_count > 0);
+  atomic_inc(&self->ref_count);
+}
+
+void ts_parent_index_release(ParentIndex *self) {
+  if (!self) return;
+  assert(self->ref_count > 0);
+  if (atomic_dec(&self->ref_count) > 0) return;
+  ts_free(self->slots);
+  array_delete(&self->entries);
+  ts_free(self);
+}
+
+size_t ts_parent_index_size(const ParentIndex *self) {
+  if (!self) return 0;
+  return
+    self->capacity * sizeof(uint32_t) +
+    self->entries.capacity * sizeof(ParentIndexEntry);
+}
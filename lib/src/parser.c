@@ -14,6 +14,7 @@
 #include "./error_costs.h"
 #include "./get_changed_ranges.h"
 #include "./language.h"
+#include "./language_data.h"
 #include "./length.h"
 #include "./lexer.h"
 #include "./reduce_action.h"
@@ -79,16 +80,37 @@
 
 #define TREE_NAME(tree) SYM_NAME(ts_subtree_symbol(tree))
 
-static const unsigned MAX_VERSION_COUNT = 6;
-static const unsigned MAX_VERSION_COUNT_OVERFLOW = 4;
-static const unsigned MAX_SUMMARY_DEPTH = 16;
-static const unsigned MAX_COST_DIFFERENCE = 16 * ERROR_COST_PER_SKIPPED_TREE;
+#define STATS_ADD(field, amount) \
+  if (self->stats_enabled) self->stats.field += (amount)
+
+#define STATS_INCREMENT(field) STATS_ADD(field, 1)
+
+static const unsigned DEFAULT_MAX_VERSION_COUNT = 6;
+static const unsigned DEFAULT_MAX_VERSION_COUNT_OVERFLOW = 4;
+static const unsigned DEFAULT_MAX_SUMMARY_DEPTH = 16;
+static const unsigned DEFAULT_MAX_COST_DIFFERENCE = 16 * ERROR_COST_PER_SKIPPED_TREE;
+static const unsigned BOUNDED_RECOVERY_SUMMARY_DEPTH = 1;
 static const unsigned OP_COUNT_PER_PARSER_TIMEOUT_CHECK = 100;
 
+#define TOKEN_CACHE_SIZE 8
+#define MAX_STREAMED_SUBTREE_COUNT 8
+
+// A token that was lexed at a given position, along with the state that the
+// lexer was in when it was lexed.
 typedef struct {
   Subtree token;
   Subtree last_external_token;
   uint32_t byte_index;
+  uint32_t external_scanner_state_hash;
+  TSLexMode lex_mode;
+} TokenCacheEntry;
+
+// The most recently lexed tokens, so that tokens don't need to be lexed
+// again when several stack versions, or an error recovery, return to the
+// same positions. Entries are replaced in the order that they were added.
+typedef struct {
+  TokenCacheEntry entries[TOKEN_CACHE_SIZE];
+  unsigned next_index;
 } TokenCache;
 
 struct TSParser {
@@ -112,9 +134,28 @@ struct TSParser {
   unsigned operation_count;
   const volatile size_t *cancellation_flag;
   Subtree old_tree;
+  SubtreeArena *old_tree_arena;
   TSRangeArray included_range_differences;
   unsigned included_range_difference_index;
+  LookupIndex lookup_index;
+  ValidSymbolIndex valid_symbol_index;
   bool has_scanner_error;
+  bool arena_enabled;
+  bool lookup_index_enabled;
+  bool stats_enabled;
+  TSParserStats stats;
+  TSParserConfig config;
+  unsigned max_version_count;
+  unsigned saturated_condense_count;
+  uint64_t recovery_work;
+  uint64_t lex_nanos;
+  uint64_t recovery_nanos;
+  uint64_t total_nanos;
+  TSStreamCallback stream_callback;
+  bool has_new_bottom_of_stack;
+  TSParseOptions parse_options;
+  TSParseState parse_state;
+  uint32_t budget_end_byte;
 };
 
 typedef struct {
@@ -133,26 +174,30 @@ typedef enum {
 } ErrorComparison;
 
 typedef struct {
-  const char *string;
-  uint32_t length;
-} TSStringInput;
+  const TSInputSpan *spans;
+  uint32_t count;
+  uint32_t index;
+} TSSpanInput;
 
-// StringInput
+// SpanInput
 
-static const char *ts_string_input_read(
+static const char *ts_span_input_read(
   void *_self,
   uint32_t byte,
   TSPoint point,
   uint32_t *length
 ) {
   (void)point;
-  TSStringInput *self = (TSStringInput *)_self;
-  if (byte >= self->length) {
+  TSSpanInput *self = (TSSpanInput *)_self;
+  self->index = ts_lexer_find_input_span(self->spans, self->count, self->index, byte);
+  if (self->index == self->count) {
+    self->index = 0;
     *length = 0;
     return "";
   } else {
-    *length = self->length - byte;
-    return self->string + byte;
+    const TSInputSpan *span = &self->spans[self->index];
+    *length = span->length - (byte - span->byte_offset);
+    return span->bytes + (byte - span->byte_offset);
   }
 }
 
@@ -177,6 +222,20 @@ static void ts_parser__log(TSParser *self) {
   }
 }
 
+// Read the clock only when statistics are being collected, so that
+// parsing does no extra work when they are disabled.
+static inline TSClock ts_parser__stats_clock(const TSParser *self) {
+  return self->stats_enabled ? clock_now() : clock_null();
+}
+
+static inline void ts_parser__stats_add_time(
+  const TSParser *self,
+  uint64_t *nanos,
+  TSClock start
+) {
+  if (self->stats_enabled) *nanos += clock_nanos_between(start, clock_now());
+}
+
 static bool ts_parser__breakdown_top_of_stack(
   TSParser *self,
   StackVersion version
@@ -202,7 +261,9 @@ static bool ts_parser__breakdown_top_of_stack(
         if (ts_subtree_is_error(child)) {
           state = ERROR_STATE;
         } else if (!ts_subtree_extra(child)) {
-          state = ts_language_next_state(self->language, state, ts_subtree_symbol(child));
+          state = ts_language_indexed_next_state(
+            self->language, &self->lookup_index, state, ts_subtree_symbol(child)
+          );
         }
 
         ts_subtree_retain(child);
@@ -270,7 +331,7 @@ static ErrorComparison ts_parser__compare_versions(
   }
 
   if (a.cost < b.cost) {
-    if ((b.cost - a.cost) * (1 + a.node_count) > MAX_COST_DIFFERENCE) {
+    if ((b.cost - a.cost) * (1 + a.node_count) > self->config.max_cost_difference) {
       return ErrorComparisonTakeLeft;
     } else {
       return ErrorComparisonPreferLeft;
@@ -278,7 +339,7 @@ static ErrorComparison ts_parser__compare_versions(
   }
 
   if (b.cost < a.cost) {
-    if ((a.cost - b.cost) * (1 + b.node_count) > MAX_COST_DIFFERENCE) {
+    if ((a.cost - b.cost) * (1 + b.node_count) > self->config.max_cost_difference) {
       return ErrorComparisonTakeRight;
     } else {
       return ErrorComparisonPreferRight;
@@ -345,6 +406,12 @@ static bool ts_parser__better_version_exists(
 static bool ts_parser__call_main_lex_fn(TSParser *self, TSLexMode lex_mode) {
   if (ts_language_is_wasm(self->language)) {
     return ts_wasm_store_call_lex_main(self->wasm_store, lex_mode.lex_state);
+  } else if (ts_language_is_data(self->language)) {
+    return ts_lex_with_table(
+      &self->lexer.data,
+      ts_language_data_lex_table(self->language),
+      lex_mode.lex_state
+    );
   } else {
     return self->language->lex_fn(&self->lexer.data, lex_mode.lex_state);
   }
@@ -353,6 +420,8 @@ static bool ts_parser__call_main_lex_fn(TSParser *self, TSLexMode lex_mode) {
 static bool ts_parser__call_keyword_lex_fn(TSParser *self, TSLexMode lex_mode) {
   if (ts_language_is_wasm(self->language)) {
     return ts_wasm_store_call_lex_keyword(self->wasm_store, 0);
+  } else if (ts_language_is_data(self->language)) {
+    return ts_lex_with_table(&self->lexer.data, ts_language_data_keyword_lex_table(self->language), 0);
   } else {
     return self->language->keyword_lex_fn(&self->lexer.data, 0);
   }
@@ -656,7 +725,9 @@ static Subtree ts_parser__lex(
       if (
         is_keyword &&
         self->lexer.token_end_position.bytes == end_byte &&
-        ts_language_has_actions(self->language, parse_state, self->lexer.data.result_symbol)
+        ts_language_indexed_lookup(
+          self->language, &self->lookup_index, parse_state, self->lexer.data.result_symbol
+        ) != 0
       ) {
         symbol = self->lexer.data.result_symbol;
       }
@@ -677,8 +748,9 @@ static Subtree ts_parser__lex(
 
     if (found_external_token) {
       MutableSubtree mut_result = ts_subtree_to_mut_unsafe(result);
-      ts_external_scanner_state_init(
-        &mut_result.ptr->external_scanner_state,
+      ts_subtree_set_external_scanner_state(
+        &self->tree_pool,
+        mut_result,
         self->lexer.debug_buffer,
         external_scanner_state_len
       );
@@ -693,6 +765,11 @@ static Subtree ts_parser__lex(
   return result;
 }
 
+static uint32_t ts_parser__external_scanner_state_hash(Subtree last_external_token) {
+  if (!last_external_token.ptr) return 0;
+  return ts_external_scanner_state_hash(ts_subtree_external_scanner_state(last_external_token));
+}
+
 static Subtree ts_parser__get_cached_token(
   TSParser *self,
   TSStateId state,
@@ -701,14 +778,24 @@ static Subtree ts_parser__get_cached_token(
   TableEntry *table_entry
 ) {
   TokenCache *cache = &self->token_cache;
-  if (
-    cache->token.ptr && cache->byte_index == position &&
-    ts_subtree_external_scanner_state_eq(cache->last_external_token, last_external_token)
-  ) {
-    ts_language_table_entry(self->language, state, ts_subtree_symbol(cache->token), table_entry);
-    if (ts_parser__can_reuse_first_leaf(self, state, cache->token, table_entry)) {
-      ts_subtree_retain(cache->token);
-      return cache->token;
+  uint32_t hash = UINT32_MAX;
+  for (unsigned i = 1; i <= TOKEN_CACHE_SIZE; i++) {
+    TokenCacheEntry *entry = &cache->entries[
+      (cache->next_index + TOKEN_CACHE_SIZE - i) % TOKEN_CACHE_SIZE
+    ];
+    if (!entry->token.ptr || entry->byte_index != position) continue;
+    if (hash == UINT32_MAX) hash = ts_parser__external_scanner_state_hash(last_external_token);
+    if (
+      entry->external_scanner_state_hash == hash &&
+      ts_subtree_external_scanner_state_eq(entry->last_external_token, last_external_token)
+    ) {
+      ts_language_indexed_table_entry(
+        self->language, &self->lookup_index, state, ts_subtree_symbol(entry->token), table_entry
+      );
+      if (ts_parser__can_reuse_first_leaf(self, state, entry->token, table_entry)) {
+        ts_subtree_retain(entry->token);
+        return entry->token;
+      }
     }
   }
   return NULL_SUBTREE;
@@ -716,18 +803,56 @@ static Subtree ts_parser__get_cached_token(
 
 static void ts_parser__set_cached_token(
   TSParser *self,
+  TSStateId state,
   uint32_t byte_index,
   Subtree last_external_token,
   Subtree token
 ) {
   TokenCache *cache = &self->token_cache;
-  if (token.ptr) ts_subtree_retain(token);
+  TSLexMode lex_mode = self->language->lex_modes[state];
+  uint32_t hash = ts_parser__external_scanner_state_hash(last_external_token);
+
+  // Replace any token that was lexed in the same way, or else the oldest one.
+  TokenCacheEntry *entry = &cache->entries[cache->next_index];
+  for (unsigned i = 0; i < TOKEN_CACHE_SIZE; i++) {
+    TokenCacheEntry *existing_entry = &cache->entries[i];
+    if (
+      existing_entry->token.ptr &&
+      existing_entry->byte_index == byte_index &&
+      existing_entry->external_scanner_state_hash == hash &&
+      memcmp(&existing_entry->lex_mode, &lex_mode, sizeof(TSLexMode)) == 0 &&
+      ts_subtree_external_scanner_state_eq(existing_entry->last_external_token, last_external_token)
+    ) {
+      entry = existing_entry;
+      break;
+    }
+  }
+  if (entry == &cache->entries[cache->next_index]) {
+    cache->next_index = (cache->next_index + 1) % TOKEN_CACHE_SIZE;
+  }
+
+  ts_subtree_retain(token);
   if (last_external_token.ptr) ts_subtree_retain(last_external_token);
-  if (cache->token.ptr) ts_subtree_release(&self->tree_pool, cache->token);
-  if (cache->last_external_token.ptr) ts_subtree_release(&self->tree_pool, cache->last_external_token);
-  cache->token = token;
-  cache->byte_index = byte_index;
-  cache->last_external_token = last_external_token;
+  if (entry->token.ptr) ts_subtree_release(&self->tree_pool, entry->token);
+  if (entry->last_external_token.ptr) ts_subtree_release(&self->tree_pool, entry->last_external_token);
+  *entry = (TokenCacheEntry) {
+    .token = token,
+    .last_external_token = last_external_token,
+    .byte_index = byte_index,
+    .external_scanner_state_hash = hash,
+    .lex_mode = lex_mode,
+  };
+}
+
+static void ts_parser__clear_token_cache(TSParser *self) {
+  TokenCache *cache = &self->token_cache;
+  for (unsigned i = 0; i < TOKEN_CACHE_SIZE; i++) {
+    TokenCacheEntry *entry = &cache->entries[i];
+    if (entry->token.ptr) ts_subtree_release(&self->tree_pool, entry->token);
+    if (entry->last_external_token.ptr) ts_subtree_release(&self->tree_pool, entry->last_external_token);
+    *entry = (TokenCacheEntry) {.token = NULL_SUBTREE, .last_external_token = NULL_SUBTREE};
+  }
+  cache->next_index = 0;
 }
 
 static bool ts_parser__has_included_range_difference(
@@ -775,6 +900,7 @@ static Subtree ts_parser__reuse_node(
 
     if (!ts_subtree_external_scanner_state_eq(self->reusable_node.last_external_token, last_external_token)) {
       LOG("reusable_node_has_different_external_scanner_state symbol:%s", TREE_NAME(result));
+      STATS_INCREMENT(reuse_miss_count);
       reusable_node_advance(&self->reusable_node);
       continue;
     }
@@ -794,6 +920,7 @@ static Subtree ts_parser__reuse_node(
 
     if (reason) {
       LOG("cant_reuse_node_%s tree:%s", reason, TREE_NAME(result));
+      STATS_INCREMENT(reuse_miss_count);
       if (!reusable_node_descend(&self->reusable_node)) {
         reusable_node_advance(&self->reusable_node);
         ts_parser__breakdown_top_of_stack(self, version);
@@ -803,18 +930,20 @@ static Subtree ts_parser__reuse_node(
     }
 
     TSSymbol leaf_symbol = ts_subtree_leaf_symbol(result);
-    ts_language_table_entry(self->language, *state, leaf_symbol, table_entry);
+    ts_language_indexed_table_entry(self->language, &self->lookup_index, *state, leaf_symbol, table_entry);
     if (!ts_parser__can_reuse_first_leaf(self, *state, result, table_entry)) {
       LOG(
         "cant_reuse_node symbol:%s, first_leaf_symbol:%s",
         TREE_NAME(result),
         SYM_NAME(leaf_symbol)
       );
+      STATS_INCREMENT(reuse_miss_count);
       reusable_node_advance_past_leaf(&self->reusable_node);
       break;
     }
 
     LOG("reuse_node symbol:%s", TREE_NAME(result));
+    STATS_INCREMENT(reused_node_count);
     ts_subtree_retain(result);
     return result;
   }
@@ -885,6 +1014,7 @@ static bool ts_parser__select_children(
   // room for its own heap data. The scratch tree is never explicitly released,
   // so the same 'scratch trees' array can be reused again later.
   MutableSubtree scratch_tree = ts_subtree_new_node(
+    NULL,
     ts_subtree_symbol(left),
     &self->scratch_trees,
     0,
@@ -948,7 +1078,7 @@ static StackVersion ts_parser__reduce(
     // will all be sorted and truncated at the end of the outer parsing loop.
     // Allow the maximum version count to be temporarily exceeded, but only
     // by a limited threshold.
-    if (slice_version > MAX_VERSION_COUNT + MAX_VERSION_COUNT_OVERFLOW) {
+    if (slice_version > self->max_version_count + self->config.max_version_count_overflow) {
       ts_stack_remove_version(self->stack, slice_version);
       ts_subtree_array_delete(&self->tree_pool, &slice.subtrees);
       removed_version_count++;
@@ -968,7 +1098,7 @@ static StackVersion ts_parser__reduce(
     ts_subtree_array_remove_trailing_extras(&children, &self->trailing_extras);
 
     MutableSubtree parent = ts_subtree_new_node(
-      symbol, &children, production_id, self->language
+      &self->tree_pool, symbol, &children, production_id, self->language
     );
 
     // This pop operation may have caused multiple stack versions to collapse
@@ -992,7 +1122,7 @@ static StackVersion ts_parser__reduce(
         ts_subtree_release(&self->tree_pool, ts_subtree_from_mut(parent));
         array_swap(&self->trailing_extras, &self->trailing_extras2);
         parent = ts_subtree_new_node(
-          symbol, &next_slice_children, production_id, self->language
+          &self->tree_pool, symbol, &next_slice_children, production_id, self->language
         );
       } else {
         array_clear(&self->trailing_extras2);
@@ -1001,7 +1131,13 @@ static StackVersion ts_parser__reduce(
     }
 
     TSStateId state = ts_stack_state(self->stack, slice_version);
-    TSStateId next_state = ts_language_next_state(self->language, state, symbol);
+    TSStateId next_state = ts_language_indexed_next_state(
+      self->language, &self->lookup_index, state, symbol
+    );
+
+    // Only the bottom of the stack is in the start state, aside from any
+    // extras that have been pushed on top of it.
+    if (state == 1) self->has_new_bottom_of_stack = true;
     if (end_of_non_terminal_extra && next_state == state) {
       parent.ptr->extra = true;
     }
@@ -1060,6 +1196,7 @@ static void ts_parser__accept(
         }
         array_splice(&trees, j, 1, child_count, children);
         root = ts_subtree_from_mut(ts_subtree_new_node(
+          &self->tree_pool,
           ts_subtree_symbol(tree),
           &trees,
           tree.ptr->production_id,
@@ -1089,6 +1226,88 @@ static void ts_parser__accept(
   ts_stack_halt(self->stack, version);
 }
 
+// Determine whether a subtree at the bottom of the stack is a child of the
+// root node, by checking whether reaching the end of the input in the state
+// that follows it would reduce it on its own into a node that is accepted.
+static bool ts_parser__is_top_level_subtree(
+  TSParser *self,
+  TSStateId state,
+  TSStateId next_state
+) {
+  TableEntry entry;
+  ts_language_indexed_table_entry(self->language, &self->lookup_index, next_state, ts_builtin_sym_end, &entry);
+  if (entry.action_count != 1) return false;
+  TSParseAction action = entry.actions[0];
+  if (action.type != TSParseActionTypeReduce || action.reduce.child_count != 1) return false;
+
+  // If the root node's production aliased the subtree, the streamed nodes
+  // would lack the alias, and the placeholder would be visible.
+  if (ts_language_alias_at(self->language, action.reduce.production_id, 0)) return false;
+
+  TSStateId root_state = ts_language_indexed_next_state(
+    self->language, &self->lookup_index, state, action.reduce.symbol
+  );
+  ts_language_indexed_table_entry(self->language, &self->lookup_index, root_state, ts_builtin_sym_end, &entry);
+  return entry.action_count == 1 && entry.actions[0].type == TSParseActionTypeAccept;
+}
+
+// Pass the visible nodes within a top-level subtree to the stream callback.
+// The nodes belong to a temporary tree, which is deleted afterward.
+static void ts_parser__emit_subtree(TSParser *self, Subtree tree, Length position) {
+  ts_subtree_retain(tree);
+  TSTree *stream_tree = ts_tree_new(
+    tree,
+    self->language,
+    self->lexer.included_ranges,
+    self->lexer.included_range_count,
+    NULL
+  );
+  TSNode node = ts_node_new(
+    stream_tree, &stream_tree->root,
+    length_add(position, ts_subtree_padding(tree)), 0
+  );
+  if (ts_subtree_visible(tree)) {
+    self->stream_callback.emit(self->stream_callback.payload, node);
+  } else {
+    TSTreeCursor cursor = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+      do {
+        self->stream_callback.emit(self->stream_callback.payload, ts_tree_cursor_current_node(&cursor));
+      } while (ts_tree_cursor_goto_next_sibling(&cursor));
+    }
+    ts_tree_cursor_delete(&cursor);
+  }
+  ts_tree_delete(stream_tree);
+}
+
+// When streaming, pass the top-level nodes that have been completed at the
+// bottom of the stack to the stream callback, and replace them on the stack
+// with placeholders of the same size, so that they can be freed. Once a
+// subtree has reached the bottom of the only stack version, it can no longer
+// be changed, except by error recovery.
+static void ts_parser__stream_bottom_of_stack(TSParser *self) {
+  StackBottomEntry entries[MAX_STREAMED_SUBTREE_COUNT];
+  uint32_t count = ts_stack_get_bottom(self->stack, 0, entries, MAX_STREAMED_SUBTREE_COUNT);
+  for (uint32_t i = 0; i < count; i++) {
+    StackBottomEntry *entry = &entries[i];
+    Subtree tree = *entry->subtree;
+    bool is_empty = !ts_subtree_visible(tree) && ts_subtree_visible_descendant_count(tree) == 0;
+    bool is_extra = ts_subtree_extra(tree);
+
+    // Placeholders of previously streamed subtrees are skipped. Extras at the
+    // bottom of the stack always become children of the root node, but other
+    // subtrees only do once they have been reduced as far as they can be.
+    if (is_empty) continue;
+    if (!is_extra && !ts_parser__is_top_level_subtree(self, entry->state, entry->next_state)) break;
+
+    LOG("stream symbol:%s", TREE_NAME(tree));
+    ts_parser__emit_subtree(self, tree, entry->position);
+    *entry->subtree = ts_subtree_new_placeholder(&self->tree_pool, tree, self->language);
+    ts_subtree_release(&self->tree_pool, tree);
+    if (!is_extra) break;
+  }
+}
+
 static bool ts_parser__do_all_potential_reductions(
   TSParser *self,
   StackVersion starting_version,
@@ -1115,18 +1334,24 @@ static bool ts_parser__do_all_potential_reductions(
     bool has_shift_action = false;
     array_clear(&self->reduce_actions);
 
-    TSSymbol first_symbol, end_symbol;
-    if (lookahead_symbol != 0) {
-      first_symbol = lookahead_symbol;
-      end_symbol = lookahead_symbol + 1;
-    } else {
-      first_symbol = 1;
-      end_symbol = self->language->token_count;
+    // Without a lookahead symbol, consider every token that is valid in the
+    // state, other than the end of the input.
+    const TSSymbol *symbols = &lookahead_symbol;
+    uint32_t symbol_count = 1;
+    if (lookahead_symbol == 0) {
+      symbols = ts_valid_symbol_index_get(
+        &self->valid_symbol_index, self->language, state, &symbol_count
+      );
     }
 
-    for (TSSymbol symbol = first_symbol; symbol < end_symbol; symbol++) {
+    for (uint32_t k = 0; k < symbol_count; k++) {
+      TSSymbol symbol = symbols[k];
+      if (lookahead_symbol == 0) {
+        if (symbol == 0) continue;
+        if (symbol >= self->language->token_count) break;
+      }
       TableEntry entry;
-      ts_language_table_entry(self->language, state, symbol, &entry);
+      ts_language_indexed_table_entry(self->language, &self->lookup_index, state, symbol, &entry);
       for (uint32_t j = 0; j < entry.action_count; j++) {
         TSParseAction action = entry.actions[j];
         switch (action.type) {
@@ -1162,7 +1387,7 @@ static bool ts_parser__do_all_potential_reductions(
 
     if (has_shift_action) {
       can_shift_lookahead_symbol = true;
-    } else if (reduction_version != STACK_VERSION_NONE && i < MAX_VERSION_COUNT) {
+    } else if (reduction_version != STACK_VERSION_NONE && i < self->max_version_count) {
       ts_stack_renumber_version(self->stack, reduction_version, version);
       continue;
     } else if (lookahead_symbol != 0) {
@@ -1221,7 +1446,7 @@ static bool ts_parser__recover_to_state(
     ts_subtree_array_remove_trailing_extras(&slice.subtrees, &self->trailing_extras);
 
     if (slice.subtrees.size > 0) {
-      Subtree error = ts_subtree_new_error_node(&slice.subtrees, true, self->language);
+      Subtree error = ts_subtree_new_error_node(&self->tree_pool, &slice.subtrees, true, self->language);
       ts_stack_push(self->stack, slice.version, error, false, goal_state);
     } else {
       array_delete(&slice.subtrees);
@@ -1238,11 +1463,28 @@ static bool ts_parser__recover_to_state(
   return previous_version != STACK_VERSION_NONE;
 }
 
+// Whether the work spent on error recovery during the current parse has
+// reached the budget for the amount of input that the given version has
+// consumed. Work is counted in stack entries examined and stack versions
+// created. Once the budget is used up, the parser only skips tokens and
+// looks for recoveries near the top of the stack, until it has consumed
+// enough input to earn more budget.
+static bool ts_parser__recovery_budget_is_exhausted(TSParser *self, StackVersion version) {
+  if (!self->config.recovery_budget_per_byte) return false;
+  uint64_t budget =
+    (uint64_t)self->config.recovery_budget_per_byte *
+    (ts_stack_position(self->stack, version).bytes + 1);
+  return self->recovery_work >= budget;
+}
+
 static void ts_parser__recover(
   TSParser *self,
   StackVersion version,
   Subtree lookahead
 ) {
+  STATS_INCREMENT(recovery_count);
+  bool is_bounded = ts_parser__recovery_budget_is_exhausted(self, version);
+  if (is_bounded) STATS_INCREMENT(bounded_recovery_count);
   bool did_recover = false;
   unsigned previous_version_count = ts_stack_version_count(self->stack);
   Length position = ts_stack_position(self->stack, version);
@@ -1265,6 +1507,11 @@ static void ts_parser__recover(
   if (summary && !ts_subtree_is_error(lookahead)) {
     for (unsigned i = 0; i < summary->size; i++) {
       StackSummaryEntry entry = summary->contents[i];
+      if (is_bounded) {
+        if (entry.depth > BOUNDED_RECOVERY_SUMMARY_DEPTH) break;
+      } else {
+        self->recovery_work++;
+      }
 
       if (entry.state == ERROR_STATE) continue;
       if (entry.position.bytes == position.bytes) continue;
@@ -1294,7 +1541,10 @@ static void ts_parser__recover(
 
       // If the current lookahead token is valid in some previous state, recover to that state.
       // Then stop looking for further recoveries.
-      if (ts_language_has_actions(self->language, entry.state, ts_subtree_symbol(lookahead))) {
+      if (ts_language_indexed_lookup(
+        self->language, &self->lookup_index, entry.state, ts_subtree_symbol(lookahead)
+      )) {
+        if (!is_bounded) self->recovery_work += depth;
         if (ts_parser__recover_to_state(self, version, depth, entry.state)) {
           did_recover = true;
           LOG("recover_to_previous state:%u, depth:%u", entry.state, depth);
@@ -1318,7 +1568,7 @@ static void ts_parser__recover(
   // current lookahead token by wrapping it in an ERROR node.
 
   // Don't pursue this additional strategy if there are already too many stack versions.
-  if (did_recover && ts_stack_version_count(self->stack) > MAX_VERSION_COUNT) {
+  if (did_recover && ts_stack_version_count(self->stack) > self->max_version_count) {
     ts_stack_halt(self->stack, version);
     ts_subtree_release(&self->tree_pool, lookahead);
     return;
@@ -1338,7 +1588,7 @@ static void ts_parser__recover(
   if (ts_subtree_is_eof(lookahead)) {
     LOG("recover_eof");
     SubtreeArray children = array_new();
-    Subtree parent = ts_subtree_new_error_node(&children, false, self->language);
+    Subtree parent = ts_subtree_new_error_node(&self->tree_pool, &children, false, self->language);
     ts_stack_push(self->stack, version, parent, false, 1);
     ts_parser__accept(self, version, lookahead);
     return;
@@ -1371,6 +1621,7 @@ static void ts_parser__recover(
   array_reserve(&children, 1);
   array_push(&children, lookahead);
   MutableSubtree error_repeat = ts_subtree_new_node(
+    &self->tree_pool,
     ts_builtin_sym_error_repeat,
     &children,
     0,
@@ -1399,6 +1650,7 @@ static void ts_parser__recover(
     ts_stack_renumber_version(self->stack, pop.contents[0].version, version);
     array_push(&pop.contents[0].subtrees, ts_subtree_from_mut(error_repeat));
     error_repeat = ts_subtree_new_node(
+      &self->tree_pool,
       ts_builtin_sym_error_repeat,
       &pop.contents[0].subtrees,
       0,
@@ -1422,26 +1674,37 @@ static void ts_parser__handle_error(
 ) {
   uint32_t previous_version_count = ts_stack_version_count(self->stack);
 
+  // Once the budget for error recovery is used up, skip the search for reductions and
+  // missing tokens below, and only summarize the top of the stack.
+  bool is_bounded = ts_parser__recovery_budget_is_exhausted(self, version);
+
   // Perform any reductions that can happen in this state, regardless of the lookahead. After
   // skipping one or more invalid tokens, the parser might find a token that would have allowed
   // a reduction to take place.
-  ts_parser__do_all_potential_reductions(self, version, 0);
+  if (!is_bounded) ts_parser__do_all_potential_reductions(self, version, 0);
   uint32_t version_count = ts_stack_version_count(self->stack);
   Length position = ts_stack_position(self->stack, version);
+  if (!is_bounded) self->recovery_work += 1 + version_count - previous_version_count;
 
   // Push a discontinuity onto the stack. Merge all of the stack versions that
   // were created in the previous step.
-  bool did_insert_missing_token = false;
+  bool did_insert_missing_token = is_bounded;
   for (StackVersion v = version; v < version_count;) {
     if (!did_insert_missing_token) {
       TSStateId state = ts_stack_state(self->stack, v);
-      for (
-        TSSymbol missing_symbol = 1;
-        missing_symbol < (uint16_t)self->language->token_count;
-        missing_symbol++
-      ) {
-        TSStateId state_after_missing_symbol = ts_language_next_state(
-          self->language, state, missing_symbol
+      uint32_t valid_symbol_count;
+      ts_valid_symbol_index_get(&self->valid_symbol_index, self->language, state, &valid_symbol_count);
+      for (uint32_t k = 0; k < valid_symbol_count; k++) {
+        // Look up the list again on each iteration, because the reductions
+        // below can build the lists of other states, which moves this one.
+        TSSymbol missing_symbol = ts_valid_symbol_index_get(
+          &self->valid_symbol_index, self->language, state, &valid_symbol_count
+        )[k];
+        if (missing_symbol == 0) continue;
+        if (missing_symbol >= self->language->token_count) break;
+        self->recovery_work++;
+        TSStateId state_after_missing_symbol = ts_language_indexed_next_state(
+          self->language, &self->lookup_index, state, missing_symbol
         );
         if (state_after_missing_symbol == 0 || state_after_missing_symbol == state) {
           continue;
@@ -1498,7 +1761,12 @@ static void ts_parser__handle_error(
     (void)did_merge;	//	fix warning/error with clang -Os
   }
 
-  ts_stack_record_summary(self->stack, version, MAX_SUMMARY_DEPTH);
+  if (is_bounded) {
+    ts_stack_record_summary(self->stack, version, BOUNDED_RECOVERY_SUMMARY_DEPTH);
+  } else {
+    ts_stack_record_summary(self->stack, version, self->config.max_summary_depth);
+    self->recovery_work += ts_stack_get_summary(self->stack, version)->size;
+  }
 
   // Begin recovery with the current lookahead node, rather than waiting for the
   // next turn of the parse loop. This ensures that the tree accounts for the
@@ -1513,6 +1781,18 @@ static void ts_parser__handle_error(
   LOG_STACK();
 }
 
+static bool ts_parser__should_halt(TSParser *self, StackVersion version) {
+  if (self->cancellation_flag && atomic_load(self->cancellation_flag)) return true;
+  if (!clock_is_null(self->end_clock) && clock_is_gt(clock_now(), self->end_clock)) return true;
+  if (self->parse_options.progress_callback) {
+    self->parse_state.payload = self->parse_options.payload;
+    self->parse_state.current_byte_offset = ts_stack_position(self->stack, version).bytes;
+    self->parse_state.has_error = ts_stack_error_cost(self->stack, version) > 0;
+    return self->parse_options.progress_callback(&self->parse_state);
+  }
+  return false;
+}
+
 static bool ts_parser__advance(
   TSParser *self,
   StackVersion version,
@@ -1540,6 +1820,11 @@ static bool ts_parser__advance(
     lookahead = ts_parser__get_cached_token(
       self, state, position, last_external_token, &table_entry
     );
+    if (lookahead.ptr) {
+      STATS_INCREMENT(cached_token_count);
+    } else {
+      STATS_INCREMENT(token_cache_miss_count);
+    }
   }
 
   bool needs_lex = !lookahead.ptr;
@@ -1547,31 +1832,44 @@ static bool ts_parser__advance(
     // Otherwise, re-run the lexer.
     if (needs_lex) {
       needs_lex = false;
+      TSClock lex_start = ts_parser__stats_clock(self);
       lookahead = ts_parser__lex(self, version, state);
+      ts_parser__stats_add_time(self, &self->lex_nanos, lex_start);
       if (self->has_scanner_error) return false;
 
       if (lookahead.ptr) {
-        ts_parser__set_cached_token(self, position, last_external_token, lookahead);
-        ts_language_table_entry(self->language, state, ts_subtree_symbol(lookahead), &table_entry);
+        STATS_INCREMENT(lexed_token_count);
+        if (!lookahead.data.is_inline) STATS_INCREMENT(heap_token_count);
+        ts_parser__set_cached_token(self, state, position, last_external_token, lookahead);
+        ts_language_indexed_table_entry(
+          self->language, &self->lookup_index, state, ts_subtree_symbol(lookahead), &table_entry
+        );
       }
 
       // When parsing a non-terminal extra, a null lookahead indicates the
       // end of the rule. The reduction is stored in the EOF table entry.
       // After the reduction, the lexer needs to be run again.
       else {
-        ts_language_table_entry(self->language, state, ts_builtin_sym_end, &table_entry);
+        ts_language_indexed_table_entry(
+          self->language, &self->lookup_index, state, ts_builtin_sym_end, &table_entry
+        );
       }
     }
 
-    // If a cancellation flag or a timeout was provided, then check every
-    // time a fixed number of parse actions has been processed.
+    // If a cancellation flag, a timeout or a progress callback was provided,
+    // then check every time a fixed number of parse actions has been processed.
+    // A byte budget is cheap to check, so it is checked after every action.
+    self->parse_state.operation_count++;
+    STATS_INCREMENT(operation_count);
     if (++self->operation_count == OP_COUNT_PER_PARSER_TIMEOUT_CHECK) {
       self->operation_count = 0;
     }
     if (
-      self->operation_count == 0 &&
-      ((self->cancellation_flag && atomic_load(self->cancellation_flag)) ||
-       (!clock_is_null(self->end_clock) && clock_is_gt(clock_now(), self->end_clock)))
+      (self->operation_count == 0 && ts_parser__should_halt(self, version)) ||
+      (
+        self->parse_options.byte_budget &&
+        ts_stack_position(self->stack, version).bytes >= self->budget_end_byte
+      )
     ) {
       if (lookahead.ptr) {
         ts_subtree_release(&self->tree_pool, lookahead);
@@ -1584,6 +1882,16 @@ static bool ts_parser__advance(
     // an ambiguous state. REDUCE actions always create a new stack
     // version, whereas SHIFT actions update the existing stack version
     // and terminate this loop.
+    //
+    // Shift actions that continue a repetition are never taken, so they
+    // don't make the state ambiguous. Nodes created by a reduction are only
+    // marked as fragile if some other action was available.
+    uint32_t taken_action_count = 0;
+    for (uint32_t i = 0; i < table_entry.action_count; i++) {
+      TSParseAction action = table_entry.actions[i];
+      if (action.type != TSParseActionTypeShift || !action.shift.repetition) taken_action_count++;
+    }
+
     StackVersion last_reduction_version = STACK_VERSION_NONE;
     for (uint32_t i = 0; i < table_entry.action_count; i++) {
       TSParseAction action = table_entry.actions[i];
@@ -1602,7 +1910,9 @@ static bool ts_parser__advance(
 
           if (ts_subtree_child_count(lookahead) > 0) {
             ts_parser__breakdown_lookahead(self, &lookahead, state, &self->reusable_node);
-            next_state = ts_language_next_state(self->language, state, ts_subtree_symbol(lookahead));
+            next_state = ts_language_indexed_next_state(
+              self->language, &self->lookup_index, state, ts_subtree_symbol(lookahead)
+            );
           }
 
           ts_parser__shift(self, version, next_state, lookahead, action.shift.extra);
@@ -1611,7 +1921,7 @@ static bool ts_parser__advance(
         }
 
         case TSParseActionTypeReduce: {
-          bool is_fragile = table_entry.action_count > 1;
+          bool is_fragile = taken_action_count > 1;
           bool end_of_non_terminal_extra = lookahead.ptr == NULL;
           LOG("reduce sym:%s, child_count:%u", SYM_NAME(action.reduce.symbol), action.reduce.child_count);
           StackVersion reduction_version = ts_parser__reduce(
@@ -1636,7 +1946,9 @@ static bool ts_parser__advance(
             ts_parser__breakdown_lookahead(self, &lookahead, ERROR_STATE, &self->reusable_node);
           }
 
+          TSClock recovery_start = ts_parser__stats_clock(self);
           ts_parser__recover(self, version, lookahead);
+          ts_parser__stats_add_time(self, &self->recovery_nanos, recovery_start);
           if (did_reuse) reusable_node_advance(&self->reusable_node);
           return true;
         }
@@ -1659,8 +1971,8 @@ static bool ts_parser__advance(
       if (!lookahead.ptr) {
         needs_lex = true;
       } else {
-        ts_language_table_entry(
-          self->language,
+        ts_language_indexed_table_entry(
+          self->language, &self->lookup_index,
           state,
           ts_subtree_leaf_symbol(lookahead),
           &table_entry
@@ -1685,7 +1997,10 @@ static bool ts_parser__advance(
       ts_subtree_is_keyword(lookahead) &&
       ts_subtree_symbol(lookahead) != self->language->keyword_capture_token
     ) {
-      ts_language_table_entry(self->language, state, self->language->keyword_capture_token, &table_entry);
+      ts_language_indexed_table_entry(
+        self->language, &self->lookup_index, state,
+        self->language->keyword_capture_token, &table_entry
+      );
       if (table_entry.action_count > 0) {
         LOG(
           "switch from_keyword:%s, to_word_token:%s",
@@ -1694,7 +2009,7 @@ static bool ts_parser__advance(
         );
 
         MutableSubtree mutable_lookahead = ts_subtree_make_mut(&self->tree_pool, lookahead);
-        ts_subtree_set_symbol(&mutable_lookahead, self->language->keyword_capture_token, self->language);
+        ts_subtree_set_symbol(&self->tree_pool, &mutable_lookahead, self->language->keyword_capture_token, self->language);
         lookahead = ts_subtree_from_mut(mutable_lookahead);
         continue;
       }
@@ -1704,7 +2019,9 @@ static bool ts_parser__advance(
     // already in the error state, restart the error recovery process.
     // TODO - can this be unified with the other `RECOVER` case above?
     if (state == ERROR_STATE) {
+      TSClock recovery_start = ts_parser__stats_clock(self);
       ts_parser__recover(self, version, lookahead);
+      ts_parser__stats_add_time(self, &self->recovery_nanos, recovery_start);
       return true;
     }
 
@@ -1766,6 +2083,7 @@ static unsigned ts_parser__condense_stack(TSParser *self) {
         case ErrorComparisonPreferLeft:
         case ErrorComparisonNone:
           if (ts_stack_merge(self->stack, j, i)) {
+            STATS_INCREMENT(version_merge_count);
             made_changes = true;
             i--;
             j = i;
@@ -1775,6 +2093,7 @@ static unsigned ts_parser__condense_stack(TSParser *self) {
         case ErrorComparisonPreferRight:
           made_changes = true;
           if (ts_stack_merge(self->stack, j, i)) {
+            STATS_INCREMENT(version_merge_count);
             i--;
             j = i;
           } else {
@@ -1794,11 +2113,29 @@ static unsigned ts_parser__condense_stack(TSParser *self) {
 
   // Enforce a hard upper bound on the number of stack versions by
   // discarding the least promising versions.
-  while (ts_stack_version_count(self->stack) > MAX_VERSION_COUNT) {
-    ts_stack_remove_version(self->stack, MAX_VERSION_COUNT);
+  while (ts_stack_version_count(self->stack) > self->max_version_count) {
+    ts_stack_remove_version(self->stack, self->max_version_count);
     made_changes = true;
   }
 
+  // In adaptive mode, if the stack has been held at its upper bound for too
+  // long, lower the bound for the rest of the parse, so that an ambiguous or
+  // malformed input can't keep the parser processing many versions at once.
+  if (self->config.adaptive_threshold) {
+    if (
+      self->max_version_count > self->config.adaptive_min_version_count &&
+      ts_stack_version_count(self->stack) == self->max_version_count
+    ) {
+      if (++self->saturated_condense_count > self->config.adaptive_threshold) {
+        self->max_version_count--;
+        self->saturated_condense_count = 0;
+        LOG("lower_max_version_count count:%u", self->max_version_count);
+      }
+    } else {
+      self->saturated_condense_count = 0;
+    }
+  }
+
   // If the best-performing stack version is currently paused, or all
   // versions are paused, then resume the best paused version and begin
   // the error recovery process. Otherwise, remove the paused versions.
@@ -1806,11 +2143,13 @@ static unsigned ts_parser__condense_stack(TSParser *self) {
     bool has_unpaused_version = false;
     for (StackVersion i = 0, n = ts_stack_version_count(self->stack); i < n; i++) {
       if (ts_stack_is_paused(self->stack, i)) {
-        if (!has_unpaused_version && self->accept_count < MAX_VERSION_COUNT) {
+        if (!has_unpaused_version && self->accept_count < self->max_version_count) {
           LOG("resume version:%u", i);
           min_error_cost = ts_stack_error_cost(self->stack, i);
           Subtree lookahead = ts_stack_resume(self->stack, i);
+          TSClock recovery_start = ts_parser__stats_clock(self);
           ts_parser__handle_error(self, i, lookahead);
+          ts_parser__stats_add_time(self, &self->recovery_nanos, recovery_start);
           has_unpaused_version = true;
         } else {
           ts_stack_remove_version(self->stack, i);
@@ -1859,9 +2198,25 @@ TSParser *ts_parser_new(void) {
   self->end_clock = clock_null();
   self->operation_count = 0;
   self->old_tree = NULL_SUBTREE;
+  self->old_tree_arena = NULL;
+  self->arena_enabled = false;
+  self->lookup_index = (LookupIndex) {0};
+  self->lookup_index_enabled = false;
+  self->valid_symbol_index = (ValidSymbolIndex) {0};
+  self->stats_enabled = false;
+  self->stats = (TSParserStats) {0};
+  ts_parser_set_config(self, NULL);
+  self->lex_nanos = 0;
+  self->recovery_nanos = 0;
+  self->total_nanos = 0;
+  self->recovery_work = 0;
   self->included_range_differences = (TSRangeArray) array_new();
   self->included_range_difference_index = 0;
-  ts_parser__set_cached_token(self, 0, NULL_SUBTREE, NULL_SUBTREE);
+  self->stream_callback = (TSStreamCallback) {NULL, NULL};
+  self->has_new_bottom_of_stack = false;
+  self->parse_options = (TSParseOptions) {NULL, NULL, 0};
+  self->parse_state = (TSParseState) {0};
+  ts_parser__clear_token_cache(self);
   return self;
 }
 
@@ -1882,7 +2237,7 @@ void ts_parser_delete(TSParser *self) {
   }
   ts_wasm_store_delete(self->wasm_store);
   ts_lexer_delete(&self->lexer);
-  ts_parser__set_cached_token(self, 0, NULL_SUBTREE, NULL_SUBTREE);
+  ts_parser__clear_token_cache(self);
   ts_subtree_pool_delete(&self->tree_pool);
   reusable_node_delete(&self->reusable_node);
   array_delete(&self->trailing_extras);
@@ -1897,6 +2252,8 @@ const TSLanguage *ts_parser_language(const TSParser *self) {
 
 bool ts_parser_set_language(TSParser *self, const TSLanguage *language) {
   ts_parser_reset(self);
+  ts_lookup_index_delete(&self->lookup_index);
+  ts_valid_symbol_index_delete(&self->valid_symbol_index);
   ts_language_delete(self->language);
   self->language = NULL;
 
@@ -1915,6 +2272,9 @@ bool ts_parser_set_language(TSParser *self, const TSLanguage *language) {
   }
 
   self->language = ts_language_copy(language);
+  if (self->language && self->lookup_index_enabled) {
+    ts_lookup_index_init(&self->lookup_index, self->language);
+  }
   return true;
 }
 
@@ -1966,10 +2326,100 @@ bool ts_parser_set_included_ranges(
   return ts_lexer_set_included_ranges(&self->lexer, ranges, count);
 }
 
+bool ts_parser_splice_included_ranges(
+  TSParser *self,
+  uint32_t index,
+  uint32_t old_count,
+  const TSRange *ranges,
+  uint32_t count
+) {
+  return ts_lexer_splice_included_ranges(&self->lexer, index, old_count, ranges, count);
+}
+
+void ts_parser_edit_included_ranges(TSParser *self, const TSInputEdit *edit) {
+  ts_lexer_edit_included_ranges(&self->lexer, edit);
+}
+
 const TSRange *ts_parser_included_ranges(const TSParser *self, uint32_t *count) {
   return ts_lexer_included_ranges(&self->lexer, count);
 }
 
+bool ts_parser_arena_enabled(const TSParser *self) {
+  return self->arena_enabled;
+}
+
+void ts_parser_set_arena_enabled(TSParser *self, bool enabled) {
+  self->arena_enabled = enabled;
+}
+
+bool ts_parser_lookup_index_enabled(const TSParser *self) {
+  return self->lookup_index_enabled;
+}
+
+void ts_parser_set_lookup_index_enabled(TSParser *self, bool enabled) {
+  if (enabled == self->lookup_index_enabled) return;
+  self->lookup_index_enabled = enabled;
+  if (enabled && self->language) {
+    ts_lookup_index_init(&self->lookup_index, self->language);
+  } else {
+    ts_lookup_index_delete(&self->lookup_index);
+  }
+}
+
+uint32_t ts_parser_chunk_cache_size(const TSParser *self) {
+  return self->lexer.chunk_cache_capacity;
+}
+
+void ts_parser_set_chunk_cache_size(TSParser *self, uint32_t size) {
+  ts_lexer_set_chunk_cache_capacity(&self->lexer, size);
+}
+
+bool ts_parser_stats_enabled(const TSParser *self) {
+  return self->stats_enabled;
+}
+
+void ts_parser_set_stats_enabled(TSParser *self, bool enabled) {
+  self->stats_enabled = enabled;
+}
+
+TSParserConfig ts_parser_config(const TSParser *self) {
+  return self->config;
+}
+
+bool ts_parser_set_config(TSParser *self, const TSParserConfig *config) {
+  if (!config) {
+    self->config = (TSParserConfig) {
+      .max_version_count = DEFAULT_MAX_VERSION_COUNT,
+      .max_version_count_overflow = DEFAULT_MAX_VERSION_COUNT_OVERFLOW,
+      .max_summary_depth = DEFAULT_MAX_SUMMARY_DEPTH,
+      .max_cost_difference = DEFAULT_MAX_COST_DIFFERENCE,
+      .adaptive_threshold = 0,
+      .adaptive_min_version_count = 1,
+      .recovery_budget_per_byte = 0,
+    };
+  } else {
+    if (config->max_version_count == 0) return false;
+    if (config->max_version_count_overflow > UINT32_MAX - config->max_version_count) return false;
+    if (config->adaptive_threshold && (
+      config->adaptive_min_version_count == 0 ||
+      config->adaptive_min_version_count > config->max_version_count
+    )) return false;
+    self->config = *config;
+  }
+  self->max_version_count = self->config.max_version_count;
+  self->saturated_condense_count = 0;
+  return true;
+}
+
+TSParserStats ts_parser_stats(const TSParser *self) {
+  TSParserStats result = self->stats;
+  if (self->stats_enabled) result.operation_count += self->recovery_work;
+  result.lex_time_micros = self->lex_nanos / 1000;
+  result.recovery_time_micros = self->recovery_nanos / 1000;
+  result.total_time_micros = self->total_nanos / 1000;
+  return result;
+}
+
 void ts_parser_reset(TSParser *self) {
   ts_parser__external_scanner_destroy(self);
   if (self->wasm_store) {
@@ -1984,13 +2434,24 @@ void ts_parser_reset(TSParser *self) {
   reusable_node_clear(&self->reusable_node);
   ts_lexer_reset(&self->lexer, length_zero());
   ts_stack_clear(self->stack);
-  ts_parser__set_cached_token(self, 0, NULL_SUBTREE, NULL_SUBTREE);
+  ts_parser__clear_token_cache(self);
   if (self->finished_tree.ptr) {
     ts_subtree_release(&self->tree_pool, self->finished_tree);
     self->finished_tree = NULL_SUBTREE;
   }
+
+  // The arenas must be released last, once nothing else refers to their nodes.
+  if (self->tree_pool.arena) {
+    ts_subtree_arena_release(self->tree_pool.arena);
+    self->tree_pool.arena = NULL;
+  }
+  if (self->old_tree_arena) {
+    ts_subtree_arena_release(self->old_tree_arena);
+    self->old_tree_arena = NULL;
+  }
   self->accept_count = 0;
   self->has_scanner_error = false;
+  self->has_new_bottom_of_stack = false;
 }
 
 TSTree *ts_parser_parse(
@@ -2000,6 +2461,7 @@ TSTree *ts_parser_parse(
 ) {
   TSTree *result = NULL;
   if (!self->language || !input.read) return NULL;
+  TSClock start_clock = ts_parser__stats_clock(self);
 
   if (ts_language_is_wasm(self->language)) {
     if (!self->wasm_store) return NULL;
@@ -2007,12 +2469,25 @@ TSTree *ts_parser_parse(
   }
 
   ts_lexer_set_input(&self->lexer, input);
+  if (input.read == ts_span_input_read) {
+    const TSSpanInput *span_input = input.payload;
+    ts_lexer_set_input_spans(&self->lexer, span_input->spans, span_input->count);
+  }
   array_clear(&self->included_range_differences);
   self->included_range_difference_index = 0;
 
   if (ts_parser_has_outstanding_parse(self)) {
     LOG("resume_parsing");
   } else {
+    self->stats = (TSParserStats) {0};
+    self->parse_state = (TSParseState) {0};
+    self->lex_nanos = 0;
+    self->recovery_nanos = 0;
+    self->total_nanos = 0;
+    self->max_version_count = self->config.max_version_count;
+    self->saturated_condense_count = 0;
+    self->recovery_work = 0;
+
     ts_parser__external_scanner_create(self);
     if (self->has_scanner_error) goto exit;
 
@@ -2025,6 +2500,10 @@ TSTree *ts_parser_parse(
         &self->included_range_differences
       );
       reusable_node_reset(&self->reusable_node, old_tree->root);
+      if (old_tree->arena) {
+        ts_subtree_arena_retain(old_tree->arena);
+        self->old_tree_arena = old_tree->arena;
+      }
       LOG("parse_after_edit");
       LOG_TREE(self->old_tree);
       for (unsigned i = 0; i < self->included_range_differences.size; i++) {
@@ -2035,6 +2514,12 @@ TSTree *ts_parser_parse(
       reusable_node_clear(&self->reusable_node);
       LOG("new_parse");
     }
+
+    // Streamed subtrees are freed as soon as they have been passed to the
+    // callback, which is not possible for subtrees in an arena.
+    if (self->arena_enabled && !self->stream_callback.emit) {
+      self->tree_pool.arena = ts_subtree_arena_new(self->old_tree_arena);
+    }
   }
 
   self->operation_count = 0;
@@ -2044,6 +2529,18 @@ TSTree *ts_parser_parse(
     self->end_clock = clock_null();
   }
 
+  // The byte budget is measured from the furthest position that any stack
+  // version has reached, so that a resumed parse makes the same progress.
+  if (self->parse_options.byte_budget) {
+    uint32_t start_byte = 0;
+    for (StackVersion i = 0, n = ts_stack_version_count(self->stack); i < n; i++) {
+      uint32_t byte = ts_stack_position(self->stack, i).bytes;
+      if (byte > start_byte) start_byte = byte;
+    }
+    self->budget_end_byte = start_byte + self->parse_options.byte_budget;
+    if (self->budget_end_byte < start_byte) self->budget_end_byte = UINT32_MAX;
+  }
+
   uint32_t position = 0, last_position = 0, version_count = 0;
   do {
     for (
@@ -2063,11 +2560,20 @@ TSTree *ts_parser_parse(
           ts_stack_position(self->stack, version).extent.column
         );
 
+        uint32_t previous_version_count = ts_stack_version_count(self->stack);
         if (!ts_parser__advance(self, version, allow_node_reuse)) {
+          ts_parser__stats_add_time(self, &self->total_nanos, start_clock);
           if (self->has_scanner_error) goto exit;
           return NULL;
         }
 
+        // Stack versions that remain after advancing are the result of
+        // ambiguities that split the stack.
+        uint32_t new_version_count = ts_stack_version_count(self->stack);
+        if (new_version_count > previous_version_count) {
+          STATS_ADD(version_split_count, new_version_count - previous_version_count);
+        }
+
         LOG_STACK();
 
         position = ts_stack_position(self->stack, version).bytes;
@@ -2091,6 +2597,16 @@ TSTree *ts_parser_parse(
       break;
     }
 
+    if (
+      self->stream_callback.emit &&
+      self->has_new_bottom_of_stack &&
+      ts_stack_version_count(self->stack) == 1 &&
+      ts_stack_is_active(self->stack, 0)
+    ) {
+      self->has_new_bottom_of_stack = false;
+      ts_parser__stream_bottom_of_stack(self);
+    }
+
     while (self->included_range_difference_index < self->included_range_differences.size) {
       TSRange *range = &self->included_range_differences.contents[self->included_range_difference_index];
       if (range->end_byte <= position) {
@@ -2110,9 +2626,11 @@ TSTree *ts_parser_parse(
     self->finished_tree,
     self->language,
     self->lexer.included_ranges,
-    self->lexer.included_range_count
+    self->lexer.included_range_count,
+    self->tree_pool.arena ? self->tree_pool.arena : self->old_tree_arena
   );
   self->finished_tree = NULL_SUBTREE;
+  ts_parser__stats_add_time(self, &self->total_nanos, start_clock);
 
 exit:
   ts_parser_reset(self);
@@ -2135,14 +2653,60 @@ TSTree *ts_parser_parse_string_encoding(
   uint32_t length,
   TSInputEncoding encoding
 ) {
-  TSStringInput input = {string, length};
+  TSInputSpan span = {0, string, length};
+  return ts_parser_parse_spans(self, old_tree, &span, 1, encoding);
+}
+
+TSTree *ts_parser_parse_spans(
+  TSParser *self,
+  const TSTree *old_tree,
+  const TSInputSpan *spans,
+  uint32_t span_count,
+  TSInputEncoding encoding
+) {
+  if (!ts_input_spans_are_valid(spans, span_count)) return NULL;
+
+  TSSpanInput input = {spans, span_count, 0};
   return ts_parser_parse(self, old_tree, (TSInput) {
     &input,
-    ts_string_input_read,
+    ts_span_input_read,
     encoding,
   });
 }
 
+bool ts_input_spans_are_valid(const TSInputSpan *spans, uint32_t span_count) {
+  uint32_t byte_offset = 0;
+  for (uint32_t i = 0; i < span_count; i++) {
+    if (spans[i].byte_offset != byte_offset) return false;
+    if (spans[i].length > UINT32_MAX - byte_offset) return false;
+    byte_offset += spans[i].length;
+  }
+  return true;
+}
+
+TSTree *ts_parser_parse_streaming(
+  TSParser *self,
+  TSInput input,
+  TSStreamCallback callback
+) {
+  self->stream_callback = callback;
+  TSTree *result = ts_parser_parse(self, NULL, input);
+  self->stream_callback = (TSStreamCallback) {NULL, NULL};
+  return result;
+}
+
+TSTree *ts_parser_parse_with_options(
+  TSParser *self,
+  const TSTree *old_tree,
+  TSInput input,
+  TSParseOptions options
+) {
+  self->parse_options = options;
+  TSTree *result = ts_parser_parse(self, old_tree, input);
+  self->parse_options = (TSParseOptions) {NULL, NULL, 0};
+  return result;
+}
+
 void ts_parser_set_wasm_store(TSParser *self, TSWasmStore *store) {
   if (self->language && ts_language_is_wasm(self->language)) {
     // Copy the assigned language into the new store.
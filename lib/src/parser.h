@@ -50,6 +50,51 @@ struct TSLexer {
   void (*log)(const TSLexer *, const char *, ...);
 };
 
+/*
+ * Lexer helpers for external scanners
+ * ------------------------------------
+ *
+ * In a scanner that is compiled to wasm, each call to a `TSLexer` function
+ * is a call into the host, so scanners that examine long runs of text can
+ * use these functions to do that with a single call:
+ *
+ * - `ts_lexer_peek` writes up to `capacity` of the upcoming characters,
+ *   starting with the lookahead character, into the given buffer, without
+ *   advancing. It returns the number of characters written, which may be
+ *   less than the number of characters remaining in the input. It always
+ *   writes at least the lookahead character, unless the lexer is at EOF.
+ * - `ts_lexer_advance_by` advances over `count` characters, stopping early
+ *   at EOF, and returns the number of characters that were advanced over.
+ */
+
+#ifdef __wasm__
+uint32_t tree_sitter_lexer_peek(TSLexer *, int32_t *, uint32_t);
+uint32_t tree_sitter_lexer_advance_by(TSLexer *, uint32_t, bool);
+#endif
+
+static inline uint32_t ts_lexer_peek(TSLexer *lexer, int32_t *characters, uint32_t capacity) {
+#ifdef __wasm__
+  return tree_sitter_lexer_peek(lexer, characters, capacity);
+#else
+  if (capacity == 0 || lexer->eof(lexer)) return 0;
+  characters[0] = lexer->lookahead;
+  return 1;
+#endif
+}
+
+static inline uint32_t ts_lexer_advance_by(TSLexer *lexer, uint32_t count, bool skip) {
+#ifdef __wasm__
+  return tree_sitter_lexer_advance_by(lexer, count, skip);
+#else
+  uint32_t result = 0;
+  while (result < count && !lexer->eof(lexer)) {
+    lexer->advance(lexer, skip);
+    result++;
+  }
+  return result;
+#endif
+}
+
 typedef enum {
   TSParseActionTypeShift,
   TSParseActionTypeReduce,
@@ -92,6 +137,29 @@ typedef struct {
   int32_t end;
 } TSCharacterRange;
 
+typedef struct {
+  int32_t start;
+  int32_t end;
+  uint16_t action;
+} TSLexTableRange;
+
+typedef struct {
+  TSSymbol accept_symbol;
+  bool accepts;
+  uint16_t eof_action;
+  uint16_t ascii_row;
+  uint16_t range_count;
+  uint32_t range_index;
+} TSLexTableState;
+
+typedef struct {
+  const TSLexTableState *states;
+  const uint8_t *ascii_classes;
+  const uint16_t *ascii_rows;
+  const TSLexTableRange *ranges;
+  uint16_t ascii_class_count;
+} TSLexTable;
+
 struct TSLanguage {
   uint32_t version;
   uint32_t symbol_count;
@@ -203,6 +271,61 @@ static inline bool set_contains(TSCharacterRange *ranges, uint32_t len, int32_t
 
 #define END_STATE() return result;
 
+/*
+ *  Lex Tables
+ *
+ *  A lex table action is zero if there is no transition, or else one more than
+ *  the next state, with `TS_LEX_TABLE_SKIP` set if the character is skipped.
+ *  ASCII characters, and the value -1 for invalid UTF-8, are mapped to classes
+ *  of lookahead values that every state treats the same way, which index the
+ *  state's row of actions. Other characters are looked up in the state's sorted
+ *  ranges.
+ */
+
+#define TS_LEX_TABLE_SKIP 0x8000
+
+static inline bool ts_lex_with_table(TSLexer *lexer, const TSLexTable *table, TSStateId state) {
+  bool result = false;
+  for (;;) {
+    const TSLexTableState *entry = &table->states[state];
+    if (entry->accepts) {
+      result = true;
+      lexer->result_symbol = entry->accept_symbol;
+      lexer->mark_end(lexer);
+    }
+
+    uint16_t action = 0;
+    int32_t lookahead = lexer->lookahead;
+    if (lexer->eof(lexer)) {
+      action = entry->eof_action;
+    } else if (lookahead < 128) {
+      uint8_t ascii_class = table->ascii_classes[lookahead + 1];
+      action = table->ascii_rows[entry->ascii_row * table->ascii_class_count + ascii_class];
+    } else if (entry->range_count > 0) {
+      const TSLexTableRange *ranges = &table->ranges[entry->range_index];
+      uint32_t index = 0;
+      uint32_t size = entry->range_count;
+      while (size > 0) {
+        uint32_t half_size = size / 2;
+        const TSLexTableRange *range = &ranges[index + half_size];
+        if (lookahead < range->start) {
+          size = half_size;
+        } else if (lookahead > range->end) {
+          index += half_size + 1;
+          size -= half_size + 1;
+        } else {
+          action = range->action;
+          break;
+        }
+      }
+    }
+
+    if (action == 0) return result;
+    lexer->advance(lexer, (action & TS_LEX_TABLE_SKIP) != 0);
+    state = (TSStateId)((action & ~TS_LEX_TABLE_SKIP) - 1);
+  }
+}
+
 /*
  *  Parse Table Macros
  */
@@ -4,8 +4,10 @@
 #include "./clock.h"
 #include "./language.h"
 #include "./point.h"
+#include "./regex.h"
 #include "./tree_cursor.h"
 #include "./unicode.h"
+#include <stdlib.h>
 #include <wctype.h>
 
 // #define DEBUG_ANALYZE_QUERY
@@ -146,6 +148,7 @@ typedef struct {
 typedef struct {
   Slice steps;
   Slice predicate_steps;
+  Slice text_predicates;
   uint32_t start_byte;
   uint32_t end_byte;
   bool is_non_local;
@@ -156,6 +159,39 @@ typedef struct {
   uint16_t step_index;
 } StepOffset;
 
+/*
+ * TextPredicate - A predicate on the text of a pattern's captures, which a
+ * query cursor can evaluate while executing the query. Fields:
+ * - `predicate_index` - The index of the predicate among its pattern's
+ *   predicates.
+ * - `capture_id` - The capture whose nodes' text is tested.
+ * - `value_id` - The other capture for `EqCapture` predicates, or the string
+ *   value for the others.
+ * - `values` - The slice of `predicate_steps` holding the string values of an
+ *   `AnyString` predicate.
+ * - `regex` - The compiled regex of a `MatchString` predicate.
+ * - `is_positive` - Whether the test must pass or fail.
+ * - `match_all` - Whether every captured node must satisfy the predicate, or
+ *   only one of them.
+ */
+typedef enum {
+  TextPredicateTypeEqString,
+  TextPredicateTypeEqCapture,
+  TextPredicateTypeMatchString,
+  TextPredicateTypeAnyString,
+} TextPredicateType;
+
+typedef struct {
+  TextPredicateType type;
+  uint32_t predicate_index;
+  uint16_t capture_id;
+  uint16_t value_id;
+  Slice values;
+  Regex *regex;
+  bool is_positive;
+  bool match_all;
+} TextPredicate;
+
 /*
  * QueryState - The state of an in-progress match of a particular pattern
  * in a query. While executing, a `TSQueryCursor` must keep track of a number
@@ -171,6 +207,10 @@ typedef struct {
  *    have already been returned.
  * - `capture_list_id` - A numeric id that can be used to retrieve the state's
  *    list of captures from the `CaptureListPool`.
+ * - `anchor_start_byte`, `anchor_end_byte` - The extent of the node whose
+ *    subtree determines whether the match exists: the node that matched the
+ *    pattern's entry step, or its parent if the pattern is not rooted. This
+ *    is used by `TSQueryMatchSet`.
  * - `seeking_immediate_match` - A flag that indicates that the state's next
  *    step must be matched by the very next sibling. This is used when
  *    processing repetitions.
@@ -183,6 +223,8 @@ typedef struct {
 typedef struct {
   uint32_t id;
   uint32_t capture_list_id;
+  uint32_t anchor_start_byte;
+  uint32_t anchor_end_byte;
   uint16_t start_depth;
   uint16_t step_index;
   uint16_t pattern_index;
@@ -208,11 +250,11 @@ typedef struct {
   // never allow `list` to allocate more entries than this, dropping pending
   // matches if needed to stay under the limit.
   uint32_t max_capture_list_count;
-  // The number of capture lists allocated in `list` that are not currently in
+  // The ids of the capture lists allocated in `list` that are not currently in
   // use. We reuse those existing-but-unused capture lists before trying to
   // allocate any new ones. We use an invalid value (UINT32_MAX) for a capture
   // list's length to indicate that it's not in use.
-  uint32_t free_capture_list_count;
+  Array(uint16_t) free_capture_list_ids;
 } CaptureListPool;
 
 /*
@@ -287,18 +329,51 @@ struct TSQuery {
   Array(CaptureQuantifiers) capture_quantifiers;
   Array(QueryStep) steps;
   Array(PatternEntry) pattern_map;
+  Array(uint32_t) pattern_map_offsets;
   Array(TSQueryPredicateStep) predicate_steps;
+  Array(TextPredicate) text_predicates;
   Array(QueryPattern) patterns;
   Array(StepOffset) step_offsets;
   Array(TSFieldId) negated_fields;
   Array(char) string_buffer;
   Array(TSSymbol) repeat_symbols_with_rootless_patterns;
+  SymbolNameIndex symbol_name_index;
   const TSLanguage *language;
   uint16_t wildcard_root_pattern_count;
 };
 
+/*
+ * IndexSet - A bitset of pattern or capture indices. The query cursor uses
+ * these to hold the patterns and captures that are disabled for its own use
+ * of a query, so that the query itself can be shared without modification.
+ */
+typedef Array(uint32_t) IndexSet;
+
+/*
+ * InProgressCapture - The earliest capture of an in-progress match that has
+ * not been returned yet, as found by `ts_query_cursor__first_in_progress_capture`.
+ * The query cursor caches this while returning captures from finished matches,
+ * because it only changes when the in-progress states change.
+ */
+typedef struct {
+  uint32_t state_index;
+  uint32_t byte_offset;
+  uint32_t pattern_index;
+  bool is_definite;
+} InProgressCapture;
+
+typedef struct {
+  uint32_t start_byte;
+  uint32_t end_byte;
+} ByteRange;
+
+typedef Array(ByteRange) ByteRangeArray;
+
 /*
  * TSQueryCursor - A stateful struct used to execute a query on a tree.
+ * When it is restricted to several byte ranges, they are stored in
+ * `byte_ranges`. Otherwise, that array is empty, and the cursor's single
+ * range is stored in `start_byte` and `end_byte`.
  */
 struct TSQueryCursor {
   const TSQuery *query;
@@ -306,8 +381,15 @@ struct TSQueryCursor {
   Array(QueryState) states;
   Array(QueryState) finished_states;
   CaptureListPool capture_list_pool;
+  TSQueryTextProvider text_provider;
+  Array(char) text_buffer;
+  RegexScratch regex_scratch;
+  InProgressCapture first_in_progress_capture;
+  IndexSet disabled_patterns;
+  IndexSet disabled_captures;
   uint32_t depth;
   uint32_t max_start_depth;
+  ByteRangeArray byte_ranges;
   uint32_t start_byte;
   uint32_t end_byte;
   TSPoint start_point;
@@ -316,12 +398,52 @@ struct TSQueryCursor {
   TSClock end_clock;
   TSDuration timeout_duration;
   unsigned operation_count;
+  uint64_t total_operation_count;
+  uint32_t state_capacity;
+  uint32_t capture_capacity;
   bool on_visible_node;
   bool ascending;
   bool halted;
   bool did_exceed_match_limit;
+  bool first_in_progress_capture_is_valid;
+};
+
+/*
+ * MatchSetEntry - A match that is stored in a `TSQueryMatchSet`. Its captures
+ * are the `capture_count` elements of the set's capture array that start at
+ * `capture_offset`. Its anchor is copied from the `QueryState` that produced
+ * it. An entry is marked as dirty when an edit touches its anchor, so that it
+ * is searched for again by the next incremental execution.
+ */
+typedef struct {
+  uint32_t pattern_index;
+  uint32_t anchor_start_byte;
+  uint32_t anchor_end_byte;
+  uint32_t capture_offset;
+  uint32_t capture_count;
+  bool is_dirty;
+} MatchSetEntry;
+
+/*
+ * TSQueryMatchSet - A set of matches that does not refer to any syntax tree.
+ * The entries are sorted using `ts_query_match_set__compare`. The byte ranges
+ * of the edits that were applied since the last incremental execution are
+ * kept in `edited_ranges`, so that they can be searched again.
+ */
+struct TSQueryMatchSet {
+  Array(MatchSetEntry) entries;
+  Array(TSQueryStoredCapture) captures;
+  ByteRangeArray edited_ranges;
 };
 
+// A reference to a match set entry and its captures, used while merging sets.
+typedef struct {
+  const MatchSetEntry *entry;
+  const TSQueryStoredCapture *captures;
+} MatchSetRef;
+
+typedef Array(MatchSetRef) MatchSetRefArray;
+
 static const TSQueryError PARENT_DONE = -1;
 static const uint16_t PATTERN_DONE_MARKER = UINT16_MAX;
 static const uint16_t NONE = UINT16_MAX;
@@ -408,6 +530,24 @@ static uint32_t stream_offset(Stream *self) {
   return (uint32_t)(self->input - self->start);
 }
 
+/***********
+ * IndexSet
+ ***********/
+
+static inline bool index_set_contains(const IndexSet *self, uint32_t index) {
+  uint32_t word = index / 32;
+  return word < self->size && (self->contents[word] & (1u << (index % 32)));
+}
+
+static void index_set_insert(IndexSet *self, uint32_t index) {
+  uint32_t word = index / 32;
+  if (word >= self->size) {
+    uint32_t old_size = self->size;
+    array_grow_by(self, word + 1 - old_size);
+  }
+  self->contents[word] |= 1u << (index % 32);
+}
+
 /******************
  * CaptureListPool
  ******************/
@@ -417,16 +557,17 @@ static CaptureListPool capture_list_pool_new(void) {
     .list = array_new(),
     .empty_list = array_new(),
     .max_capture_list_count = UINT32_MAX,
-    .free_capture_list_count = 0,
+    .free_capture_list_ids = array_new(),
   };
 }
 
 static void capture_list_pool_reset(CaptureListPool *self) {
-  for (uint16_t i = 0; i < (uint16_t)self->list.size; i++) {
+  array_clear(&self->free_capture_list_ids);
+  for (uint16_t i = (uint16_t)self->list.size; i > 0; i--) {
     // This invalid size means that the list is not in use.
-    self->list.contents[i].size = UINT32_MAX;
+    self->list.contents[i - 1].size = UINT32_MAX;
+    array_push(&self->free_capture_list_ids, i - 1);
   }
-  self->free_capture_list_count = self->list.size;
 }
 
 static void capture_list_pool_delete(CaptureListPool *self) {
@@ -434,6 +575,7 @@ static void capture_list_pool_delete(CaptureListPool *self) {
     array_delete(&self->list.contents[i]);
   }
   array_delete(&self->list);
+  array_delete(&self->free_capture_list_ids);
 }
 
 static const CaptureList *capture_list_pool_get(const CaptureListPool *self, uint16_t id) {
@@ -449,19 +591,15 @@ static CaptureList *capture_list_pool_get_mut(CaptureListPool *self, uint16_t id
 static bool capture_list_pool_is_empty(const CaptureListPool *self) {
   // The capture list pool is empty if all allocated lists are in use, and we
   // have reached the maximum allowed number of allocated lists.
-  return self->free_capture_list_count == 0 && self->list.size >= self->max_capture_list_count;
+  return self->free_capture_list_ids.size == 0 && self->list.size >= self->max_capture_list_count;
 }
 
 static uint16_t capture_list_pool_acquire(CaptureListPool *self) {
   // First see if any already allocated capture list is currently unused.
-  if (self->free_capture_list_count > 0) {
-    for (uint16_t i = 0; i < (uint16_t)self->list.size; i++) {
-      if (self->list.contents[i].size == UINT32_MAX) {
-        array_clear(&self->list.contents[i]);
-        self->free_capture_list_count--;
-        return i;
-      }
-    }
+  if (self->free_capture_list_ids.size > 0) {
+    uint16_t i = array_pop(&self->free_capture_list_ids);
+    array_clear(&self->list.contents[i]);
+    return i;
   }
 
   // Otherwise allocate and initialize a new capture list, as long as that
@@ -473,13 +611,34 @@ static uint16_t capture_list_pool_acquire(CaptureListPool *self) {
   CaptureList list;
   array_init(&list);
   array_push(&self->list, list);
+  ts_set_allocation_category(self->list.contents, TSAllocationCategoryQueryCaptureLists);
   return i;
 }
 
+// Allocate unused capture lists until the pool has at least the given number
+// of lists, each with room for the given number of captures.
+static void capture_list_pool_reserve(CaptureListPool *self, uint32_t list_count, uint32_t capture_count) {
+  for (uint32_t i = 0; i < self->list.size; i++) {
+    CaptureList *list = &self->list.contents[i];
+    array_reserve(list, capture_count);
+    ts_set_allocation_category(list->contents, TSAllocationCategoryQueryCaptureLists);
+  }
+  while (self->list.size < list_count) {
+    CaptureList list;
+    array_init(&list);
+    array_reserve(&list, capture_count);
+    ts_set_allocation_category(list.contents, TSAllocationCategoryQueryCaptureLists);
+    list.size = UINT32_MAX;
+    array_push(&self->free_capture_list_ids, (uint16_t)self->list.size);
+    array_push(&self->list, list);
+  }
+  ts_set_allocation_category(self->list.contents, TSAllocationCategoryQueryCaptureLists);
+}
+
 static void capture_list_pool_release(CaptureListPool *self, uint16_t id) {
-  if (id >= self->list.size) return;
+  if (id >= self->list.size || self->list.contents[id].size == UINT32_MAX) return;
   self->list.contents[id].size = UINT32_MAX;
-  self->free_capture_list_count++;
+  array_push(&self->free_capture_list_ids, id);
 }
 
 /**************
@@ -1129,6 +1288,40 @@ static inline bool ts_query__pattern_map_search(
   return needle == symbol;
 }
 
+// Find the first entry in the pattern map whose root symbol is the given
+// symbol, for use while executing the query.
+//
+// Once a query is built, this looks the symbol up in a table indexed by
+// symbol, so that the cost of checking each node for new matches does not
+// depend on the number of patterns. Symbols outside of the table, such as
+// `ERROR`, fall back to the binary search.
+static inline bool ts_query__pattern_map_find(
+  const TSQuery *self,
+  TSSymbol symbol,
+  uint32_t *result
+) {
+  if (symbol < self->pattern_map_offsets.size) {
+    *result = self->pattern_map_offsets.contents[symbol];
+    return *result != UINT32_MAX;
+  }
+  return ts_query__pattern_map_search(self, symbol, result);
+}
+
+// Rebuild the table used by `ts_query__pattern_map_find`. This must be called
+// whenever the pattern map changes after the query has been parsed.
+static void ts_query__build_pattern_map_offsets(TSQuery *self) {
+  uint32_t symbol_count = ts_language_symbol_count(self->language);
+  array_clear(&self->pattern_map_offsets);
+  array_grow_by(&self->pattern_map_offsets, symbol_count);
+  memset(self->pattern_map_offsets.contents, 0xff, symbol_count * sizeof(uint32_t));
+  for (uint32_t i = self->wildcard_root_pattern_count; i < self->pattern_map.size; i++) {
+    TSSymbol symbol = self->steps.contents[self->pattern_map.contents[i].step_index].symbol;
+    if (symbol < symbol_count && self->pattern_map_offsets.contents[symbol] == UINT32_MAX) {
+      self->pattern_map_offsets.contents[symbol] = i;
+    }
+  }
+}
+
 // Insert a new pattern's start index into the pattern map, maintaining
 // the pattern map's ordering invariant.
 static inline void ts_query__pattern_map_insert(
@@ -2324,7 +2517,8 @@ static TSQueryError ts_query__parse_pattern(
         }
 
         else {
-          symbol = ts_language_symbol_for_name(
+          symbol = ts_symbol_name_index_lookup(
+            &self->symbol_name_index,
             self->language,
             node_name,
             length,
@@ -2362,7 +2556,8 @@ static TSQueryError ts_query__parse_pattern(
         stream_scan_identifier(stream);
         uint32_t length = (uint32_t)(stream->input - node_name);
 
-        step->symbol = ts_language_symbol_for_name(
+        step->symbol = ts_symbol_name_index_lookup(
+          &self->symbol_name_index,
           self->language,
           node_name,
           length,
@@ -2486,7 +2681,8 @@ static TSQueryError ts_query__parse_pattern(
     if (e) return e;
 
     // Add a step for the node
-    TSSymbol symbol = ts_language_symbol_for_name(
+    TSSymbol symbol = ts_symbol_name_index_lookup(
+      &self->symbol_name_index,
       self->language,
       self->string_buffer.contents,
       self->string_buffer.size,
@@ -2666,40 +2862,151 @@ static TSQueryError ts_query__parse_pattern(
   return 0;
 }
 
-TSQuery *ts_query_new(
-  const TSLanguage *language,
-  const char *source,
-  uint32_t source_len,
-  uint32_t *error_offset,
-  TSQueryError *error_type
+typedef struct {
+  const char *name;
+  TextPredicateType type;
+  bool is_positive;
+  bool match_all;
+} TextPredicateName;
+
+static const TextPredicateName TEXT_PREDICATE_NAMES[] = {
+  {"eq?", TextPredicateTypeEqString, true, true},
+  {"not-eq?", TextPredicateTypeEqString, false, true},
+  {"any-eq?", TextPredicateTypeEqString, true, false},
+  {"any-not-eq?", TextPredicateTypeEqString, false, false},
+  {"match?", TextPredicateTypeMatchString, true, true},
+  {"not-match?", TextPredicateTypeMatchString, false, true},
+  {"any-match?", TextPredicateTypeMatchString, true, false},
+  {"any-not-match?", TextPredicateTypeMatchString, false, false},
+  {"any-of?", TextPredicateTypeAnyString, true, true},
+  {"not-any-of?", TextPredicateTypeAnyString, false, true},
+};
+
+// Compile the predicate whose steps are given, if the query cursor knows how
+// to evaluate it. Predicates with the wrong kinds or numbers of arguments, or
+// with regexes that are not supported, are left for the caller to handle.
+static bool ts_query__compile_text_predicate(
+  TSQuery *self,
+  const TSQueryPredicateStep *steps,
+  uint32_t arg_count,
+  TextPredicate *predicate
 ) {
-  if (
-    !language ||
-    language->version > TREE_SITTER_LANGUAGE_VERSION ||
-    language->version < TREE_SITTER_MIN_COMPATIBLE_LANGUAGE_VERSION
-  ) {
-    *error_type = TSQueryErrorLanguage;
-    return NULL;
+  uint32_t length;
+  const char *name = symbol_table_name_for_id(&self->predicate_values, steps[0].value_id, &length);
+  const TextPredicateName *entry = NULL;
+  for (unsigned i = 0; i < sizeof(TEXT_PREDICATE_NAMES) / sizeof(TextPredicateName); i++) {
+    const char *entry_name = TEXT_PREDICATE_NAMES[i].name;
+    if (length == strlen(entry_name) && memcmp(name, entry_name, length) == 0) {
+      entry = &TEXT_PREDICATE_NAMES[i];
+      break;
+    }
   }
+  if (!entry || arg_count < 1 || steps[1].type != TSQueryPredicateStepTypeCapture) return false;
+
+  predicate->type = entry->type;
+  predicate->capture_id = (uint16_t)steps[1].value_id;
+  predicate->is_positive = entry->is_positive;
+  predicate->match_all = entry->match_all;
+  predicate->regex = NULL;
+  switch (entry->type) {
+    case TextPredicateTypeEqString:
+      if (arg_count != 2) return false;
+      if (steps[2].type == TSQueryPredicateStepTypeCapture) {
+        predicate->type = TextPredicateTypeEqCapture;
+      }
+      predicate->value_id = (uint16_t)steps[2].value_id;
+      return true;
+    case TextPredicateTypeMatchString: {
+      if (arg_count != 2 || steps[2].type != TSQueryPredicateStepTypeString) return false;
+      const char *regex = symbol_table_name_for_id(&self->predicate_values, steps[2].value_id, &length);
+      predicate->regex = ts_regex_new(regex, length);
+      return predicate->regex != NULL;
+    }
+    case TextPredicateTypeAnyString:
+      for (unsigned i = 2; i <= arg_count; i++) {
+        if (steps[i].type != TSQueryPredicateStepTypeString) return false;
+      }
+      predicate->values = (Slice) {
+        .offset = (uint32_t)(steps + 2 - self->predicate_steps.contents),
+        .length = arg_count - 1,
+      };
+      return true;
+    default:
+      return false;
+  }
+}
+
+static void ts_query__compile_text_predicates(TSQuery *self) {
+  for (unsigned i = 0; i < self->patterns.size; i++) {
+    QueryPattern *pattern = &self->patterns.contents[i];
+    pattern->text_predicates.offset = self->text_predicates.size;
+
+    uint32_t predicate_index = 0;
+    uint32_t start = pattern->predicate_steps.offset;
+    uint32_t end = start + pattern->predicate_steps.length;
+    while (start < end) {
+      uint32_t done = start;
+      while (self->predicate_steps.contents[done].type != TSQueryPredicateStepTypeDone) done++;
+
+      TextPredicate predicate = {.predicate_index = predicate_index};
+      if (ts_query__compile_text_predicate(
+        self,
+        &self->predicate_steps.contents[start],
+        done - start - 1,
+        &predicate
+      )) {
+        array_push(&self->text_predicates, predicate);
+      }
+      predicate_index++;
+      start = done + 1;
+    }
+
+    pattern->text_predicates.length = self->text_predicates.size - pattern->text_predicates.offset;
+  }
+}
 
+static TSQuery *ts_query__new(const TSLanguage *language) {
   TSQuery *self = ts_malloc(sizeof(TSQuery));
   *self = (TSQuery) {
     .steps = array_new(),
     .pattern_map = array_new(),
+    .pattern_map_offsets = array_new(),
     .captures = symbol_table_new(),
     .capture_quantifiers = array_new(),
     .predicate_values = symbol_table_new(),
     .predicate_steps = array_new(),
+    .text_predicates = array_new(),
     .patterns = array_new(),
     .step_offsets = array_new(),
     .string_buffer = array_new(),
     .negated_fields = array_new(),
     .repeat_symbols_with_rootless_patterns = array_new(),
+    .symbol_name_index = {0},
     .wildcard_root_pattern_count = 0,
     .language = ts_language_copy(language),
   };
+  return self;
+}
 
+TSQuery *ts_query_new(
+  const TSLanguage *language,
+  const char *source,
+  uint32_t source_len,
+  uint32_t *error_offset,
+  TSQueryError *error_type
+) {
+  if (
+    !language ||
+    language->version > TREE_SITTER_LANGUAGE_VERSION ||
+    language->version < TREE_SITTER_MIN_COMPATIBLE_LANGUAGE_VERSION
+  ) {
+    *error_type = TSQueryErrorLanguage;
+    return NULL;
+  }
+
+  TSQuery *self = ts_query__new(language);
   array_push(&self->negated_fields, 0);
+  ts_symbol_name_index_init(&self->symbol_name_index, language);
 
   // Parse all of the S-expressions in the given string.
   Stream stream = stream_new(source, source_len);
@@ -2791,13 +3098,17 @@ TSQuery *ts_query_new(
     }
   }
 
+  ts_query__compile_text_predicates(self);
+
   if (!ts_query__analyze_patterns(self, error_offset)) {
     *error_type = TSQueryErrorStructure;
     ts_query_delete(self);
     return NULL;
   }
 
+  ts_query__build_pattern_map_offsets(self);
   array_delete(&self->string_buffer);
+  ts_symbol_name_index_delete(&self->symbol_name_index);
   return self;
 }
 
@@ -2805,12 +3116,18 @@ void ts_query_delete(TSQuery *self) {
   if (self) {
     array_delete(&self->steps);
     array_delete(&self->pattern_map);
+    array_delete(&self->pattern_map_offsets);
     array_delete(&self->predicate_steps);
+    for (unsigned i = 0; i < self->text_predicates.size; i++) {
+      ts_regex_delete(self->text_predicates.contents[i].regex);
+    }
+    array_delete(&self->text_predicates);
     array_delete(&self->patterns);
     array_delete(&self->step_offsets);
     array_delete(&self->string_buffer);
     array_delete(&self->negated_fields);
     array_delete(&self->repeat_symbols_with_rootless_patterns);
+    ts_symbol_name_index_delete(&self->symbol_name_index);
     ts_language_delete(self->language);
     symbol_table_delete(&self->captures);
     symbol_table_delete(&self->predicate_values);
@@ -2823,6 +3140,473 @@ void ts_query_delete(TSQuery *self) {
   }
 }
 
+/*****************
+ * Serialization
+ *****************/
+
+// The header of a serialized query identifies the format and the language.
+// A query's analysis depends on the language's parse table, so besides the
+// language's version and its numbers of symbols, states and fields, the
+// header holds a hash of its symbol and field names.
+#define TS_QUERY_SERIALIZATION_MAGIC 0x71737374
+#define TS_QUERY_SERIALIZATION_VERSION 1
+
+typedef struct {
+  uint32_t magic;
+  uint32_t format_version;
+  uint32_t language_version;
+  uint32_t symbol_count;
+  uint32_t alias_count;
+  uint32_t state_count;
+  uint32_t field_count;
+  uint32_t name_hash;
+} SerializedQueryHeader;
+
+typedef Array(char) QueryByteArray;
+
+typedef struct {
+  const char *data;
+  const char *end;
+  bool failed;
+} QueryReader;
+
+static inline uint32_t ts_query__hash_name(uint32_t hash, const char *name) {
+  if (!name) return hash;
+  for (const char *c = name;; c++) {
+    hash = (hash ^ (uint8_t)*c) * 16777619u;
+    if (!*c) break;
+  }
+  return hash;
+}
+
+static SerializedQueryHeader ts_query__serialization_header(const TSLanguage *language) {
+  uint32_t name_hash = 2166136261u;
+  uint32_t symbol_count = ts_language_symbol_count(language);
+  for (TSSymbol symbol = 0; symbol < symbol_count; symbol++) {
+    name_hash = ts_query__hash_name(name_hash, ts_language_symbol_name(language, symbol));
+  }
+  for (TSFieldId field_id = 1; field_id <= language->field_count; field_id++) {
+    name_hash = ts_query__hash_name(name_hash, ts_language_field_name_for_id(language, field_id));
+  }
+  return (SerializedQueryHeader) {
+    .magic = TS_QUERY_SERIALIZATION_MAGIC,
+    .format_version = TS_QUERY_SERIALIZATION_VERSION,
+    .language_version = language->version,
+    .symbol_count = language->symbol_count,
+    .alias_count = language->alias_count,
+    .state_count = language->state_count,
+    .field_count = language->field_count,
+    .name_hash = name_hash,
+  };
+}
+
+static inline void ts_query__write(QueryByteArray *buffer, const void *value, size_t size) {
+  array_extend(buffer, (uint32_t)size, (const char *)value);
+}
+
+static inline void ts_query__write_u8(QueryByteArray *buffer, uint8_t value) {
+  ts_query__write(buffer, &value, sizeof(value));
+}
+
+static inline void ts_query__write_u16(QueryByteArray *buffer, uint16_t value) {
+  ts_query__write(buffer, &value, sizeof(value));
+}
+
+static inline void ts_query__write_u32(QueryByteArray *buffer, uint32_t value) {
+  ts_query__write(buffer, &value, sizeof(value));
+}
+
+static inline void ts_query__write_slice(QueryByteArray *buffer, Slice slice) {
+  ts_query__write_u32(buffer, slice.offset);
+  ts_query__write_u32(buffer, slice.length);
+}
+
+static void ts_query__write_symbol_table(QueryByteArray *buffer, const SymbolTable *table) {
+  ts_query__write_u32(buffer, table->slices.size);
+  for (unsigned i = 0; i < table->slices.size; i++) {
+    Slice slice = table->slices.contents[i];
+    ts_query__write_u32(buffer, slice.length);
+    ts_query__write(buffer, &table->characters.contents[slice.offset], slice.length);
+  }
+}
+
+static inline bool query_reader__read(QueryReader *self, void *value, size_t size) {
+  if (self->failed || (size_t)(self->end - self->data) < size) {
+    self->failed = true;
+    memset(value, 0, size);
+    return false;
+  }
+  memcpy(value, self->data, size);
+  self->data += size;
+  return true;
+}
+
+static inline uint8_t query_reader__u8(QueryReader *self) {
+  uint8_t value;
+  query_reader__read(self, &value, sizeof(value));
+  return value;
+}
+
+static inline uint16_t query_reader__u16(QueryReader *self) {
+  uint16_t value;
+  query_reader__read(self, &value, sizeof(value));
+  return value;
+}
+
+static inline uint32_t query_reader__u32(QueryReader *self) {
+  uint32_t value;
+  query_reader__read(self, &value, sizeof(value));
+  return value;
+}
+
+static inline Slice query_reader__slice(QueryReader *self) {
+  Slice slice;
+  slice.offset = query_reader__u32(self);
+  slice.length = query_reader__u32(self);
+  return slice;
+}
+
+// Read the length of an array whose elements each take at least the given
+// number of bytes, so that a corrupt length can't cause a huge allocation.
+static inline uint32_t query_reader__count(QueryReader *self, size_t element_size) {
+  uint32_t count = query_reader__u32(self);
+  if ((size_t)(self->end - self->data) / element_size < count) self->failed = true;
+  return self->failed ? 0 : count;
+}
+
+static void query_reader__symbol_table(QueryReader *self, SymbolTable *table) {
+  uint32_t count = query_reader__count(self, sizeof(uint32_t));
+  array_reserve(&table->slices, count);
+  for (unsigned i = 0; i < count && !self->failed; i++) {
+    uint32_t length = query_reader__count(self, 1);
+    const char *name = self->data;
+    self->data += length;
+
+    // Names are exposed as UTF8 strings, so their encoding is checked.
+    for (uint32_t j = 0; j < length;) {
+      int32_t code_point;
+      j += ts_decode_utf8((const uint8_t *)&name[j], length - j, &code_point);
+      if (code_point < 0) self->failed = true;
+    }
+
+    Slice slice = {.offset = table->characters.size, .length = length};
+    array_extend(&table->characters, length, name);
+    array_push(&table->characters, 0);
+    array_push(&table->slices, slice);
+  }
+}
+
+static inline bool ts_query__slice_is_within(Slice slice, uint32_t size) {
+  return slice.offset <= size && slice.length <= size - slice.offset;
+}
+
+// Check that no state can move between steps forever without matching a
+// node, by following a cycle of alternatives and pass-through steps. The
+// steps are sorted topologically, following those moves, and any step that
+// is left over is part of a cycle.
+static bool ts_query__has_alternative_cycle(const TSQuery *self) {
+  uint32_t step_count = self->steps.size;
+  Array(uint32_t) in_degrees = array_new();
+  Array(uint32_t) ready_steps = array_new();
+  array_grow_by(&in_degrees, step_count);
+  for (unsigned i = 0; i < step_count; i++) {
+    const QueryStep *step = &self->steps.contents[i];
+    if (step->alternative_index != NONE) in_degrees.contents[step->alternative_index]++;
+    if (step->is_pass_through && i + 1 < step_count) in_degrees.contents[i + 1]++;
+  }
+  for (unsigned i = 0; i < step_count; i++) {
+    if (in_degrees.contents[i] == 0) array_push(&ready_steps, i);
+  }
+
+  uint32_t sorted_count = 0;
+  while (ready_steps.size > 0) {
+    uint32_t index = array_pop(&ready_steps);
+    const QueryStep *step = &self->steps.contents[index];
+    sorted_count++;
+    if (step->alternative_index != NONE && --in_degrees.contents[step->alternative_index] == 0) {
+      array_push(&ready_steps, step->alternative_index);
+    }
+    if (step->is_pass_through && index + 1 < step_count && --in_degrees.contents[index + 1] == 0) {
+      array_push(&ready_steps, index + 1);
+    }
+  }
+
+  array_delete(&in_degrees);
+  array_delete(&ready_steps);
+  return sorted_count < step_count;
+}
+
+// Check that the indices within a deserialized query are consistent, so that
+// executing the query never reads outside of its arrays, or loops forever.
+static bool ts_query__is_valid(const TSQuery *self) {
+  uint32_t capture_count = self->captures.slices.size;
+  uint32_t string_count = self->predicate_values.slices.size;
+
+  if (self->negated_fields.size == 0 || *array_back(&self->negated_fields) != 0) return false;
+  if (self->steps.size == 0 || array_back(&self->steps)->depth != PATTERN_DONE_MARKER) return false;
+  for (unsigned i = 0; i < self->steps.size; i++) {
+    const QueryStep *step = &self->steps.contents[i];
+    if (step->alternative_index != NONE && step->alternative_index >= self->steps.size) return false;
+    if (step->negated_field_list_id >= self->negated_fields.size) return false;
+    for (unsigned j = 0; j < MAX_STEP_CAPTURE_COUNT; j++) {
+      if (step->capture_ids[j] != NONE && step->capture_ids[j] >= capture_count) return false;
+    }
+  }
+  if (ts_query__has_alternative_cycle(self)) return false;
+
+  if (self->capture_quantifiers.size != self->patterns.size) return false;
+  for (unsigned i = 0; i < self->patterns.size; i++) {
+    const QueryPattern *pattern = &self->patterns.contents[i];
+    if (
+      pattern->steps.length == 0 ||
+      !ts_query__slice_is_within(pattern->steps, self->steps.size) ||
+      self->steps.contents[pattern->steps.offset + pattern->steps.length - 1].depth != PATTERN_DONE_MARKER ||
+      !ts_query__slice_is_within(pattern->predicate_steps, self->predicate_steps.size)
+    ) return false;
+
+    // Each predicate starts with its name and ends with a `Done` step.
+    bool is_at_predicate_start = true;
+    for (unsigned j = 0; j < pattern->predicate_steps.length; j++) {
+      const TSQueryPredicateStep *step = &self->predicate_steps.contents[pattern->predicate_steps.offset + j];
+      switch (step->type) {
+        case TSQueryPredicateStepTypeDone:
+          if (is_at_predicate_start) return false;
+          is_at_predicate_start = true;
+          break;
+        case TSQueryPredicateStepTypeCapture:
+          if (is_at_predicate_start || step->value_id >= capture_count) return false;
+          break;
+        case TSQueryPredicateStepTypeString:
+          if (step->value_id >= string_count) return false;
+          is_at_predicate_start = false;
+          break;
+        default:
+          return false;
+      }
+    }
+    if (!is_at_predicate_start) return false;
+
+    const CaptureQuantifiers *capture_quantifiers = &self->capture_quantifiers.contents[i];
+    if (capture_quantifiers->size > capture_count) return false;
+    for (unsigned j = 0; j < capture_quantifiers->size; j++) {
+      if (capture_quantifiers->contents[j] > TSQuantifierOneOrMore) return false;
+    }
+  }
+
+  if (self->wildcard_root_pattern_count > self->pattern_map.size) return false;
+  for (unsigned i = 0; i < self->pattern_map.size; i++) {
+    const PatternEntry *entry = &self->pattern_map.contents[i];
+    if (entry->step_index >= self->steps.size || entry->pattern_index >= self->patterns.size) return false;
+  }
+
+  return true;
+}
+
+char *ts_query_serialize(const TSQuery *self, uint32_t *length) {
+  QueryByteArray buffer = array_new();
+  SerializedQueryHeader header = ts_query__serialization_header(self->language);
+  ts_query__write(&buffer, &header, sizeof(header));
+
+  ts_query__write_symbol_table(&buffer, &self->captures);
+  ts_query__write_symbol_table(&buffer, &self->predicate_values);
+
+  ts_query__write_u32(&buffer, self->steps.size);
+  for (unsigned i = 0; i < self->steps.size; i++) {
+    const QueryStep *step = &self->steps.contents[i];
+    ts_query__write_u16(&buffer, step->symbol);
+    ts_query__write_u16(&buffer, step->supertype_symbol);
+    ts_query__write_u16(&buffer, step->field);
+    for (unsigned j = 0; j < MAX_STEP_CAPTURE_COUNT; j++) {
+      ts_query__write_u16(&buffer, step->capture_ids[j]);
+    }
+    ts_query__write_u16(&buffer, step->depth);
+    ts_query__write_u16(&buffer, step->alternative_index);
+    ts_query__write_u16(&buffer, step->negated_field_list_id);
+    ts_query__write_u16(&buffer, (uint16_t)(
+      step->is_named << 0 |
+      step->is_immediate << 1 |
+      step->is_last_child << 2 |
+      step->is_pass_through << 3 |
+      step->is_dead_end << 4 |
+      step->alternative_is_immediate << 5 |
+      step->contains_captures << 6 |
+      step->root_pattern_guaranteed << 7 |
+      step->parent_pattern_guaranteed << 8
+    ));
+  }
+
+  ts_query__write_u32(&buffer, self->patterns.size);
+  for (unsigned i = 0; i < self->patterns.size; i++) {
+    const QueryPattern *pattern = &self->patterns.contents[i];
+    ts_query__write_slice(&buffer, pattern->steps);
+    ts_query__write_slice(&buffer, pattern->predicate_steps);
+    ts_query__write_u32(&buffer, pattern->start_byte);
+    ts_query__write_u32(&buffer, pattern->end_byte);
+    ts_query__write_u8(&buffer, pattern->is_non_local);
+
+    const CaptureQuantifiers *capture_quantifiers = &self->capture_quantifiers.contents[i];
+    ts_query__write_u32(&buffer, capture_quantifiers->size);
+    ts_query__write(&buffer, capture_quantifiers->contents, capture_quantifiers->size);
+  }
+
+  ts_query__write_u32(&buffer, self->predicate_steps.size);
+  for (unsigned i = 0; i < self->predicate_steps.size; i++) {
+    const TSQueryPredicateStep *step = &self->predicate_steps.contents[i];
+    ts_query__write_u8(&buffer, (uint8_t)step->type);
+    ts_query__write_u32(&buffer, step->value_id);
+  }
+
+  ts_query__write_u32(&buffer, self->pattern_map.size);
+  for (unsigned i = 0; i < self->pattern_map.size; i++) {
+    const PatternEntry *entry = &self->pattern_map.contents[i];
+    ts_query__write_u16(&buffer, entry->step_index);
+    ts_query__write_u16(&buffer, entry->pattern_index);
+    ts_query__write_u8(&buffer, entry->is_rooted);
+  }
+  ts_query__write_u16(&buffer, self->wildcard_root_pattern_count);
+
+  ts_query__write_u32(&buffer, self->step_offsets.size);
+  for (unsigned i = 0; i < self->step_offsets.size; i++) {
+    ts_query__write_u32(&buffer, self->step_offsets.contents[i].byte_offset);
+    ts_query__write_u16(&buffer, self->step_offsets.contents[i].step_index);
+  }
+
+  ts_query__write_u32(&buffer, self->negated_fields.size);
+  for (unsigned i = 0; i < self->negated_fields.size; i++) {
+    ts_query__write_u16(&buffer, self->negated_fields.contents[i]);
+  }
+
+  ts_query__write_u32(&buffer, self->repeat_symbols_with_rootless_patterns.size);
+  for (unsigned i = 0; i < self->repeat_symbols_with_rootless_patterns.size; i++) {
+    ts_query__write_u16(&buffer, self->repeat_symbols_with_rootless_patterns.contents[i]);
+  }
+
+  *length = buffer.size;
+  return buffer.contents;
+}
+
+TSQuery *ts_query_deserialize(const TSLanguage *language, const char *data, uint32_t length) {
+  if (
+    !language ||
+    language->version > TREE_SITTER_LANGUAGE_VERSION ||
+    language->version < TREE_SITTER_MIN_COMPATIBLE_LANGUAGE_VERSION
+  ) return NULL;
+
+  SerializedQueryHeader header;
+  if (length < sizeof(header)) return NULL;
+  memcpy(&header, data, sizeof(header));
+  SerializedQueryHeader expected_header = ts_query__serialization_header(language);
+  if (memcmp(&header, &expected_header, sizeof(header)) != 0) return NULL;
+
+  QueryReader reader = {
+    .data = data + sizeof(header),
+    .end = data + length,
+    .failed = false,
+  };
+  TSQuery *self = ts_query__new(language);
+
+  query_reader__symbol_table(&reader, &self->captures);
+  query_reader__symbol_table(&reader, &self->predicate_values);
+
+  uint32_t step_count = query_reader__count(&reader, 10 * sizeof(uint16_t));
+  array_reserve(&self->steps, step_count);
+  for (unsigned i = 0; i < step_count; i++) {
+    QueryStep step;
+    step.symbol = query_reader__u16(&reader);
+    step.supertype_symbol = query_reader__u16(&reader);
+    step.field = query_reader__u16(&reader);
+    for (unsigned j = 0; j < MAX_STEP_CAPTURE_COUNT; j++) {
+      step.capture_ids[j] = query_reader__u16(&reader);
+    }
+    step.depth = query_reader__u16(&reader);
+    step.alternative_index = query_reader__u16(&reader);
+    step.negated_field_list_id = query_reader__u16(&reader);
+    uint16_t flags = query_reader__u16(&reader);
+    step.is_named = flags & 1 << 0;
+    step.is_immediate = flags & 1 << 1;
+    step.is_last_child = flags & 1 << 2;
+    step.is_pass_through = flags & 1 << 3;
+    step.is_dead_end = flags & 1 << 4;
+    step.alternative_is_immediate = flags & 1 << 5;
+    step.contains_captures = flags & 1 << 6;
+    step.root_pattern_guaranteed = flags & 1 << 7;
+    step.parent_pattern_guaranteed = flags & 1 << 8;
+    array_push(&self->steps, step);
+  }
+
+  uint32_t pattern_count = query_reader__count(&reader, 5 * sizeof(uint32_t) + 1);
+  array_reserve(&self->patterns, pattern_count);
+  array_reserve(&self->capture_quantifiers, pattern_count);
+  for (unsigned i = 0; i < pattern_count && !reader.failed; i++) {
+    QueryPattern pattern = {0};
+    pattern.steps = query_reader__slice(&reader);
+    pattern.predicate_steps = query_reader__slice(&reader);
+    pattern.start_byte = query_reader__u32(&reader);
+    pattern.end_byte = query_reader__u32(&reader);
+    pattern.is_non_local = query_reader__u8(&reader);
+    array_push(&self->patterns, pattern);
+
+    CaptureQuantifiers capture_quantifiers = capture_quantifiers_new();
+    uint32_t capture_count = query_reader__count(&reader, 1);
+    array_extend(&capture_quantifiers, capture_count, (const uint8_t *)reader.data);
+    reader.data += capture_count;
+    array_push(&self->capture_quantifiers, capture_quantifiers);
+  }
+
+  uint32_t predicate_step_count = query_reader__count(&reader, 1 + sizeof(uint32_t));
+  array_reserve(&self->predicate_steps, predicate_step_count);
+  for (unsigned i = 0; i < predicate_step_count; i++) {
+    TSQueryPredicateStep step;
+    step.type = (TSQueryPredicateStepType)query_reader__u8(&reader);
+    step.value_id = query_reader__u32(&reader);
+    array_push(&self->predicate_steps, step);
+  }
+
+  uint32_t pattern_entry_count = query_reader__count(&reader, 2 * sizeof(uint16_t) + 1);
+  array_reserve(&self->pattern_map, pattern_entry_count);
+  for (unsigned i = 0; i < pattern_entry_count; i++) {
+    PatternEntry entry;
+    entry.step_index = query_reader__u16(&reader);
+    entry.pattern_index = query_reader__u16(&reader);
+    entry.is_rooted = query_reader__u8(&reader);
+    array_push(&self->pattern_map, entry);
+  }
+  self->wildcard_root_pattern_count = query_reader__u16(&reader);
+
+  uint32_t step_offset_count = query_reader__count(&reader, sizeof(uint32_t) + sizeof(uint16_t));
+  array_reserve(&self->step_offsets, step_offset_count);
+  for (unsigned i = 0; i < step_offset_count; i++) {
+    StepOffset step_offset;
+    step_offset.byte_offset = query_reader__u32(&reader);
+    step_offset.step_index = query_reader__u16(&reader);
+    array_push(&self->step_offsets, step_offset);
+  }
+
+  uint32_t negated_field_count = query_reader__count(&reader, sizeof(uint16_t));
+  array_reserve(&self->negated_fields, negated_field_count);
+  for (unsigned i = 0; i < negated_field_count; i++) {
+    array_push(&self->negated_fields, query_reader__u16(&reader));
+  }
+
+  uint32_t repeat_symbol_count = query_reader__count(&reader, sizeof(uint16_t));
+  array_reserve(&self->repeat_symbols_with_rootless_patterns, repeat_symbol_count);
+  for (unsigned i = 0; i < repeat_symbol_count; i++) {
+    array_push(&self->repeat_symbols_with_rootless_patterns, query_reader__u16(&reader));
+  }
+
+  if (reader.failed || reader.data != reader.end || !ts_query__is_valid(self)) {
+    ts_query_delete(self);
+    return NULL;
+  }
+
+  // The regexes of the text predicates are compiled again, since they
+  // contain pointers.
+  ts_query__compile_text_predicates(self);
+  ts_query__build_pattern_map_offsets(self);
+  array_delete(&self->string_buffer);
+  return self;
+}
+
 uint32_t ts_query_pattern_count(const TSQuery *self) {
   return self->patterns.size;
 }
@@ -2928,6 +3712,19 @@ bool ts_query_is_pattern_guaranteed_at_step(
   }
 }
 
+bool ts_query_is_predicate_built_in(
+  const TSQuery *self,
+  uint32_t pattern_index,
+  uint32_t predicate_index
+) {
+  if (pattern_index >= self->patterns.size) return false;
+  Slice slice = self->patterns.contents[pattern_index].text_predicates;
+  for (unsigned i = slice.offset; i < slice.offset + slice.length; i++) {
+    if (self->text_predicates.contents[i].predicate_index == predicate_index) return true;
+  }
+  return false;
+}
+
 bool ts_query__step_is_fallible(
   const TSQuery *self,
   uint16_t step_index
@@ -2971,6 +3768,7 @@ void ts_query_disable_pattern(
       i--;
     }
   }
+  ts_query__build_pattern_map_offsets(self);
 }
 
 /***************
@@ -2981,11 +3779,18 @@ TSQueryCursor *ts_query_cursor_new(void) {
   TSQueryCursor *self = ts_malloc(sizeof(TSQueryCursor));
   *self = (TSQueryCursor) {
     .did_exceed_match_limit = false,
+    .first_in_progress_capture_is_valid = false,
     .ascending = false,
     .halted = false,
     .states = array_new(),
     .finished_states = array_new(),
     .capture_list_pool = capture_list_pool_new(),
+    .text_provider = {NULL, NULL},
+    .text_buffer = array_new(),
+    .regex_scratch = array_new(),
+    .disabled_patterns = array_new(),
+    .disabled_captures = array_new(),
+    .byte_ranges = array_new(),
     .start_byte = 0,
     .end_byte = UINT32_MAX,
     .start_point = {0, 0},
@@ -2994,15 +3799,25 @@ TSQueryCursor *ts_query_cursor_new(void) {
     .timeout_duration = 0,
     .end_clock = clock_null(),
     .operation_count = 0,
+    .total_operation_count = 0,
+    .state_capacity = 0,
+    .capture_capacity = 0,
   };
   array_reserve(&self->states, 8);
   array_reserve(&self->finished_states, 8);
+  ts_set_allocation_category(self->states.contents, TSAllocationCategoryQueryCursorStates);
+  ts_set_allocation_category(self->finished_states.contents, TSAllocationCategoryQueryCursorStates);
   return self;
 }
 
 void ts_query_cursor_delete(TSQueryCursor *self) {
   array_delete(&self->states);
   array_delete(&self->finished_states);
+  array_delete(&self->text_buffer);
+  array_delete(&self->regex_scratch);
+  array_delete(&self->disabled_patterns);
+  array_delete(&self->disabled_captures);
+  array_delete(&self->byte_ranges);
   ts_tree_cursor_delete(&self->cursor);
   capture_list_pool_delete(&self->capture_list_pool);
   ts_free(self);
@@ -3020,6 +3835,10 @@ void ts_query_cursor_set_match_limit(TSQueryCursor *self, uint32_t limit) {
   self->capture_list_pool.max_capture_list_count = limit;
 }
 
+uint64_t ts_query_cursor_operation_count(const TSQueryCursor *self) {
+  return self->total_operation_count;
+}
+
 uint64_t ts_query_cursor_timeout_micros(const TSQueryCursor *self) {
   return duration_to_micros(self->timeout_duration);
 }
@@ -3028,6 +3847,33 @@ void ts_query_cursor_set_timeout_micros(TSQueryCursor *self, uint64_t timeout_mi
   self->timeout_duration = duration_from_micros(timeout_micros);
 }
 
+void ts_query_cursor_set_capacity(TSQueryCursor *self, uint32_t state_count, uint32_t capture_count) {
+  // Capture list ids are 16 bits wide, and the maximum value is reserved.
+  if (state_count >= NONE) state_count = NONE - 1;
+  self->state_capacity = state_count;
+  self->capture_capacity = state_count > 0 ? capture_count : 0;
+  if (state_count == 0) return;
+
+  // Every in-progress or finished state has its own capture list, so one list
+  // is needed per state.
+  array_reserve(&self->states, state_count);
+  array_reserve(&self->finished_states, state_count);
+  capture_list_pool_reserve(&self->capture_list_pool, state_count, capture_count);
+}
+
+// Check if the cursor has room for another state. When the cursor has a fixed
+// capacity, its states are never allowed to outgrow the preallocated arrays.
+static inline bool ts_query_cursor__has_room_for_state(TSQueryCursor *self) {
+  if (
+    self->state_capacity &&
+    self->states.size + self->finished_states.size >= self->state_capacity
+  ) {
+    self->did_exceed_match_limit = true;
+    return false;
+  }
+  return true;
+}
+
 #ifdef DEBUG_EXECUTE_QUERY
 #define LOG(...) fprintf(stderr, __VA_ARGS__)
 #else
@@ -3076,7 +3922,9 @@ void ts_query_cursor_exec(
   self->halted = false;
   self->query = query;
   self->did_exceed_match_limit = false;
+  self->first_in_progress_capture_is_valid = false;
   self->operation_count = 0;
+  self->total_operation_count = 0;
   if (self->timeout_duration) {
     self->end_clock = clock_after(clock_now(), self->timeout_duration);
   } else {
@@ -3092,8 +3940,43 @@ void ts_query_cursor_set_byte_range(
   if (end_byte == 0) {
     end_byte = UINT32_MAX;
   }
+  array_clear(&self->byte_ranges);
   self->start_byte = start_byte;
   self->end_byte = end_byte;
+  self->first_in_progress_capture_is_valid = false;
+}
+
+bool ts_query_cursor_set_byte_ranges(
+  TSQueryCursor *self,
+  const TSRange *ranges,
+  uint32_t count
+) {
+  for (unsigned i = 0; i < count; i++) {
+    if (ranges[i].start_byte > ranges[i].end_byte) return false;
+    if (i > 0 && ranges[i].start_byte < ranges[i - 1].end_byte) return false;
+  }
+
+  if (count <= 1) {
+    ts_query_cursor_set_byte_range(
+      self,
+      count ? ranges[0].start_byte : 0,
+      count ? ranges[0].end_byte : UINT32_MAX
+    );
+    return true;
+  }
+
+  array_clear(&self->byte_ranges);
+  array_reserve(&self->byte_ranges, count);
+  for (unsigned i = 0; i < count; i++) {
+    array_push(&self->byte_ranges, ((ByteRange) {
+      .start_byte = ranges[i].start_byte,
+      .end_byte = ranges[i].end_byte,
+    }));
+  }
+  self->start_byte = ranges[0].start_byte;
+  self->end_byte = ranges[count - 1].end_byte;
+  self->first_in_progress_capture_is_valid = false;
+  return true;
 }
 
 void ts_query_cursor_set_point_range(
@@ -3106,6 +3989,66 @@ void ts_query_cursor_set_point_range(
   }
   self->start_point = start_point;
   self->end_point = end_point;
+  self->first_in_progress_capture_is_valid = false;
+}
+
+void ts_query_cursor_set_text_provider(TSQueryCursor *self, TSQueryTextProvider provider) {
+  self->text_provider = provider;
+}
+
+// Determine whether a state's pattern is guaranteed to match, now that the
+// state has reached its current step. This is never the case for patterns
+// whose text predicates are evaluated by the cursor, until they finish.
+static inline bool ts_query_cursor__state_is_definite(
+  const TSQueryCursor *self,
+  const QueryState *state
+) {
+  return (
+    self->query->steps.contents[state->step_index].root_pattern_guaranteed &&
+    (
+      !self->text_provider.text ||
+      self->query->patterns.contents[state->pattern_index].text_predicates.length == 0
+    )
+  );
+}
+
+// Determine whether the cursor's range has a start or an end, outside of which
+// captures must be skipped. When there are several byte ranges, the gaps
+// between them must be skipped too. Checking this first avoids computing the
+// position of every capture when the range is not restricted.
+static inline bool ts_query_cursor__has_start(const TSQueryCursor *self) {
+  return
+    self->start_byte > 0 ||
+    self->byte_ranges.size > 0 ||
+    !point_eq(self->start_point, POINT_ZERO);
+}
+
+static inline bool ts_query_cursor__has_end(const TSQueryCursor *self) {
+  return
+    self->end_byte < UINT32_MAX ||
+    self->byte_ranges.size > 0 ||
+    !point_eq(self->end_point, POINT_MAX);
+}
+
+// Get the byte range that a node starting at the given byte should be compared
+// with. Of the cursor's ranges, this is the first one that ends after the byte,
+// or the last one. A node that intersects any of the ranges intersects this one.
+static inline ByteRange ts_query_cursor__byte_range_at(const TSQueryCursor *self, uint32_t byte) {
+  if (self->byte_ranges.size == 0) {
+    return (ByteRange) {.start_byte = self->start_byte, .end_byte = self->end_byte};
+  }
+  uint32_t index = 0;
+  uint32_t size = self->byte_ranges.size - 1;
+  while (size > 0) {
+    uint32_t half_size = size / 2;
+    if (self->byte_ranges.contents[index + half_size].end_byte > byte) {
+      size = half_size;
+    } else {
+      index += half_size + 1;
+      size -= half_size + 1;
+    }
+  }
+  return self->byte_ranges.contents[index];
 }
 
 // Search through all of the in-progress states, and find the captured
@@ -3121,6 +4064,7 @@ static bool ts_query_cursor__first_in_progress_capture(
   *state_index = UINT32_MAX;
   *byte_offset = UINT32_MAX;
   *pattern_index = UINT32_MAX;
+  bool has_start = ts_query_cursor__has_start(self);
   for (unsigned i = 0; i < self->states.size; i++) {
     QueryState *state = &self->states.contents[i];
     if (state->dead) continue;
@@ -3134,10 +4078,10 @@ static bool ts_query_cursor__first_in_progress_capture(
     }
 
     TSNode node = captures->contents[state->consumed_capture_count].node;
-    if (
-      ts_node_end_byte(node) <= self->start_byte ||
+    if (has_start && (
+      ts_node_end_byte(node) <= ts_query_cursor__byte_range_at(self, ts_node_start_byte(node)).start_byte ||
       point_lte(ts_node_end_point(node), self->start_point)
-    ) {
+    )) {
       state->consumed_capture_count++;
       i--;
       continue;
@@ -3149,10 +4093,10 @@ static bool ts_query_cursor__first_in_progress_capture(
       node_start_byte < *byte_offset ||
       (node_start_byte == *byte_offset && state->pattern_index < *pattern_index)
     ) {
-      QueryStep *step = &self->query->steps.contents[state->step_index];
+      bool is_definite = ts_query_cursor__state_is_definite(self, state);
       if (root_pattern_guaranteed) {
-        *root_pattern_guaranteed = step->root_pattern_guaranteed;
-      } else if (step->root_pattern_guaranteed) {
+        *root_pattern_guaranteed = is_definite;
+      } else if (is_definite) {
         continue;
       }
 
@@ -3240,8 +4184,11 @@ void ts_query_cursor__compare_captures(
 
 static void ts_query_cursor__add_state(
   TSQueryCursor *self,
-  const PatternEntry *pattern
+  const PatternEntry *pattern,
+  uint32_t anchor_start_byte,
+  uint32_t anchor_end_byte
 ) {
+  if (index_set_contains(&self->disabled_patterns, pattern->pattern_index)) return;
   QueryStep *step = &self->query->steps.contents[pattern->step_index];
   uint32_t start_depth = self->depth - step->depth;
 
@@ -3280,6 +4227,8 @@ static void ts_query_cursor__add_state(
     index--;
   }
 
+  if (!ts_query_cursor__has_room_for_state(self)) return;
+
   LOG(
     "  start state. pattern:%u, step:%u\n",
     pattern->pattern_index,
@@ -3288,6 +4237,8 @@ static void ts_query_cursor__add_state(
   array_insert(&self->states, index, ((QueryState) {
     .id = UINT32_MAX,
     .capture_list_id = NONE,
+    .anchor_start_byte = anchor_start_byte,
+    .anchor_end_byte = anchor_end_byte,
     .step_index = pattern->step_index,
     .pattern_index = pattern->pattern_index,
     .start_depth = start_depth,
@@ -3365,7 +4316,16 @@ static void ts_query_cursor__capture(
   for (unsigned j = 0; j < MAX_STEP_CAPTURE_COUNT; j++) {
     uint16_t capture_id = step->capture_ids[j];
     if (step->capture_ids[j] == NONE) break;
+    if (index_set_contains(&self->disabled_captures, capture_id)) continue;
+    if (self->capture_capacity && capture_list->size >= self->capture_capacity) {
+      LOG("  ran out of room for captures");
+      self->did_exceed_match_limit = true;
+      state->dead = true;
+      return;
+    }
+    bool had_storage = capture_list->capacity > 0;
     array_push(capture_list, ((TSQueryCapture) { node, capture_id }));
+    if (!had_storage) ts_set_allocation_category(capture_list->contents, TSAllocationCategoryQueryCaptureLists);
     LOG(
       "  capture node. type:%s, pattern:%u, capture_id:%u, capture_count:%u\n",
       ts_node_type(node),
@@ -3383,6 +4343,8 @@ static QueryState *ts_query_cursor__copy_state(
   TSQueryCursor *self,
   QueryState **state_ref
 ) {
+  if (!ts_query_cursor__has_room_for_state(self)) return NULL;
+
   const QueryState *state = *state_ref;
   uint32_t state_index = (uint32_t)(state - self->states.contents);
   QueryState copy = *state;
@@ -3396,7 +4358,9 @@ static QueryState *ts_query_cursor__copy_state(
       &self->capture_list_pool,
       state->capture_list_id
     );
+    bool had_storage = new_captures->capacity > 0;
     array_push_all(new_captures, old_captures);
+    if (!had_storage) ts_set_allocation_category(new_captures->contents, TSAllocationCategoryQueryCaptureLists);
   }
 
   array_insert(&self->states, state_index + 1, copy);
@@ -3458,6 +4422,112 @@ static inline bool ts_query_cursor__should_descend(
   return false;
 }
 
+static inline const char *ts_query_cursor__node_text(
+  TSQueryCursor *self,
+  TSNode node,
+  uint32_t *length
+) {
+  const char *text = self->text_provider.text(self->text_provider.payload, node, length);
+  if (!text) *length = 0;
+  return text;
+}
+
+// Determine whether the text of a single captured node satisfies a predicate,
+// ignoring whether the predicate is negated.
+static bool ts_query_cursor__node_text_matches(
+  TSQueryCursor *self,
+  const TextPredicate *predicate,
+  TSNode node
+) {
+  uint32_t length;
+  const char *text = ts_query_cursor__node_text(self, node, &length);
+  const SymbolTable *values = &self->query->predicate_values;
+  switch (predicate->type) {
+    case TextPredicateTypeEqString: {
+      uint32_t value_length;
+      const char *value = symbol_table_name_for_id(values, predicate->value_id, &value_length);
+      return length == value_length && (length == 0 || memcmp(text, value, length) == 0);
+    }
+    case TextPredicateTypeMatchString:
+      return ts_regex_is_match(predicate->regex, text, length, &self->regex_scratch);
+    case TextPredicateTypeAnyString:
+      for (unsigned i = 0; i < predicate->values.length; i++) {
+        const TSQueryPredicateStep *step = &self->query->predicate_steps.contents[predicate->values.offset + i];
+        uint32_t value_length;
+        const char *value = symbol_table_name_for_id(values, step->value_id, &value_length);
+        if (length == value_length && (length == 0 || memcmp(text, value, length) == 0)) return true;
+      }
+      return false;
+    default:
+      return false;
+  }
+}
+
+// Determine whether the texts of a pair of nodes are equal. The text of the
+// first node is copied, because the text provider may reuse its memory.
+static bool ts_query_cursor__node_texts_are_equal(TSQueryCursor *self, TSNode node1, TSNode node2) {
+  uint32_t length1, length2;
+  const char *text1 = ts_query_cursor__node_text(self, node1, &length1);
+  array_clear(&self->text_buffer);
+  array_extend(&self->text_buffer, length1, text1);
+  const char *text2 = ts_query_cursor__node_text(self, node2, &length2);
+  return length1 == length2 && (length1 == 0 || memcmp(self->text_buffer.contents, text2, length1) == 0);
+}
+
+static bool ts_query_cursor__satisfies_text_predicate(
+  TSQueryCursor *self,
+  const TextPredicate *predicate,
+  const CaptureList *captures
+) {
+  // Nodes of two captures are compared in pairs, and both captures must have
+  // the same number of nodes for every pair to be compared.
+  if (predicate->type == TextPredicateTypeEqCapture) {
+    uint32_t i = 0, j = 0, pair_count = 0;
+    for (;;) {
+      while (i < captures->size && captures->contents[i].index != predicate->capture_id) i++;
+      while (j < captures->size && captures->contents[j].index != predicate->value_id) j++;
+      if (i == captures->size || j == captures->size) break;
+      bool is_satisfied = ts_query_cursor__node_texts_are_equal(
+        self,
+        captures->contents[i].node,
+        captures->contents[j].node
+      ) == predicate->is_positive;
+      if (is_satisfied != predicate->match_all) return is_satisfied;
+      pair_count++;
+      i++;
+      j++;
+    }
+    if (!predicate->match_all && pair_count > 0) return false;
+    return i == captures->size && j == captures->size;
+  }
+
+  bool has_nodes = false;
+  for (unsigned i = 0; i < captures->size; i++) {
+    const TSQueryCapture *capture = &captures->contents[i];
+    if (capture->index != predicate->capture_id) continue;
+    has_nodes = true;
+    bool is_satisfied = ts_query_cursor__node_text_matches(self, predicate, capture->node) == predicate->is_positive;
+    if (is_satisfied != predicate->match_all) return is_satisfied;
+  }
+  return predicate->match_all || !has_nodes;
+}
+
+// Determine whether a finished state satisfies the text predicates of its
+// pattern. The predicates are only evaluated when the cursor has a text
+// provider.
+static bool ts_query_cursor__satisfies_text_predicates(TSQueryCursor *self, const QueryState *state) {
+  if (!self->text_provider.text) return true;
+  Slice slice = self->query->patterns.contents[state->pattern_index].text_predicates;
+  if (slice.length == 0) return true;
+  const CaptureList *captures = capture_list_pool_get(&self->capture_list_pool, state->capture_list_id);
+  for (unsigned i = slice.offset; i < slice.offset + slice.length; i++) {
+    if (!ts_query_cursor__satisfies_text_predicate(self, &self->query->text_predicates.contents[i], captures)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 // Walk the tree, processing patterns until at least one pattern finishes,
 // If one or more patterns finish, return `true` and store their states in the
 // `finished_states` array. Multiple patterns can finish on the same node. If
@@ -3467,6 +4537,7 @@ static inline bool ts_query_cursor__advance(
   bool stop_on_definite_step
 ) {
   bool did_match = false;
+  self->first_in_progress_capture_is_valid = false;
   for (;;) {
     if (self->halted) {
       while (self->states.size > 0) {
@@ -3492,6 +4563,10 @@ static inline bool ts_query_cursor__advance(
       return did_match;
     }
 
+    // Each step onto or off of a node costs one operation, plus one for each
+    // in-progress state, since every one of them is compared against the node.
+    self->total_operation_count += 1 + self->states.size;
+
     // Exit the current node.
     if (self->ascending) {
       if (self->on_visible_node) {
@@ -3513,9 +4588,17 @@ static inline bool ts_query_cursor__advance(
             step->depth == PATTERN_DONE_MARKER &&
             (state->start_depth > self->depth || self->depth == 0)
           ) {
-            LOG("  finish pattern %u\n", state->pattern_index);
-            array_push(&self->finished_states, *state);
-            did_match = true;
+            if (ts_query_cursor__satisfies_text_predicates(self, state)) {
+              LOG("  finish pattern %u\n", state->pattern_index);
+              array_push(&self->finished_states, *state);
+              did_match = true;
+            } else {
+              LOG("  failed text predicates. pattern:%u\n", state->pattern_index);
+              capture_list_pool_release(
+                &self->capture_list_pool,
+                state->capture_list_id
+              );
+            }
             deleted_count++;
           }
 
@@ -3581,24 +4664,32 @@ static inline bool ts_query_cursor__advance(
       TSPoint start_point = ts_node_start_point(node);
       TSPoint end_point = ts_node_end_point(node);
       bool is_empty = start_byte == end_byte;
+      uint32_t parent_start_byte = 0;
+      uint32_t parent_end_byte = UINT32_MAX;
+      if (!ts_node_is_null(parent_node)) {
+        parent_start_byte = ts_node_start_byte(parent_node);
+        parent_end_byte = ts_node_end_byte(parent_node);
+      }
 
+      ByteRange parent_range = ts_query_cursor__byte_range_at(self, parent_start_byte);
+      ByteRange range = ts_query_cursor__byte_range_at(self, start_byte);
       bool parent_precedes_range = !ts_node_is_null(parent_node) && (
-        ts_node_end_byte(parent_node) <= self->start_byte ||
+        parent_end_byte <= parent_range.start_byte ||
         point_lte(ts_node_end_point(parent_node), self->start_point)
       );
       bool parent_follows_range = !ts_node_is_null(parent_node) && (
-        ts_node_start_byte(parent_node) >= self->end_byte ||
+        parent_start_byte >= parent_range.end_byte ||
         point_gte(ts_node_start_point(parent_node), self->end_point)
       );
       bool node_precedes_range =
         parent_precedes_range ||
-        end_byte < self->start_byte ||
+        end_byte < range.start_byte ||
         point_lt(end_point, self->start_point) ||
-        (!is_empty && end_byte == self->start_byte) ||
+        (!is_empty && end_byte == range.start_byte) ||
         (!is_empty && point_eq(end_point, self->start_point));
 
       bool node_follows_range = parent_follows_range || (
-        start_byte >= self->end_byte ||
+        start_byte >= range.end_byte ||
         point_gte(start_point, self->end_point)
       );
       bool parent_intersects_range = !parent_precedes_range && !parent_follows_range;
@@ -3654,14 +4745,19 @@ static inline bool ts_query_cursor__advance(
               (!step->supertype_symbol || supertype_count > 0) &&
               (start_depth <= self->max_start_depth)
             ) {
-              ts_query_cursor__add_state(self, pattern);
+              ts_query_cursor__add_state(
+                self,
+                pattern,
+                pattern->is_rooted ? start_byte : parent_start_byte,
+                pattern->is_rooted ? end_byte : parent_end_byte
+              );
             }
           }
         }
 
         // Add new states for any patterns whose root node matches this node.
         unsigned i;
-        if (ts_query__pattern_map_search(self->query, symbol, &i)) {
+        if (ts_query__pattern_map_find(self->query, symbol, &i)) {
           PatternEntry *pattern = &self->query->pattern_map.contents[i];
 
           QueryStep *step = &self->query->steps.contents[pattern->step_index];
@@ -3676,7 +4772,12 @@ static inline bool ts_query_cursor__advance(
               (!step->field || field_id == step->field) &&
               (start_depth <= self->max_start_depth)
             ) {
-              ts_query_cursor__add_state(self, pattern);
+              ts_query_cursor__add_state(
+                self,
+                pattern,
+                pattern->is_rooted ? start_byte : parent_start_byte,
+                pattern->is_rooted ? end_byte : parent_end_byte
+              );
             }
 
             // Advance to the next pattern whose root node matches this node.
@@ -3837,8 +4938,7 @@ static inline bool ts_query_cursor__advance(
             state->step_index
           );
 
-          QueryStep *next_step = &self->query->steps.contents[state->step_index];
-          if (stop_on_definite_step && next_step->root_pattern_guaranteed) did_match = true;
+          if (stop_on_definite_step && ts_query_cursor__state_is_definite(self, state)) did_match = true;
 
           // If this state's next step has an alternative step, then copy the state in order
           // to pursue both alternatives. The alternative step itself may have an alternative,
@@ -3963,12 +5063,20 @@ static inline bool ts_query_cursor__advance(
             if (next_step->depth == PATTERN_DONE_MARKER) {
               if (state->has_in_progress_alternatives) {
                 LOG("  defer finishing pattern %u\n", state->pattern_index);
-              } else {
+              } else if (ts_query_cursor__satisfies_text_predicates(self, state)) {
                 LOG("  finish pattern %u\n", state->pattern_index);
                 array_push(&self->finished_states, *state);
                 array_erase(&self->states, (uint32_t)(state - self->states.contents));
                 did_match = true;
                 j--;
+              } else {
+                LOG("  failed text predicates. pattern:%u\n", state->pattern_index);
+                capture_list_pool_release(
+                  &self->capture_list_pool,
+                  state->capture_list_id
+                );
+                array_erase(&self->states, (uint32_t)(state - self->states.contents));
+                j--;
               }
             }
           }
@@ -3994,9 +5102,10 @@ static inline bool ts_query_cursor__advance(
   }
 }
 
-bool ts_query_cursor_next_match(
+static bool ts_query_cursor__next_match(
   TSQueryCursor *self,
-  TSQueryMatch *match
+  TSQueryMatch *match,
+  ByteRange *anchor
 ) {
   if (self->finished_states.size == 0) {
     if (!ts_query_cursor__advance(self, false)) {
@@ -4006,6 +5115,8 @@ bool ts_query_cursor_next_match(
 
   QueryState *state = &self->finished_states.contents[0];
   if (state->id == UINT32_MAX) state->id = self->next_state_id++;
+  anchor->start_byte = state->anchor_start_byte;
+  anchor->end_byte = state->anchor_end_byte;
   match->id = state->id;
   match->pattern_index = state->pattern_index;
   const CaptureList *captures = capture_list_pool_get(
@@ -4019,6 +5130,14 @@ bool ts_query_cursor_next_match(
   return true;
 }
 
+bool ts_query_cursor_next_match(
+  TSQueryCursor *self,
+  TSQueryMatch *match
+) {
+  ByteRange anchor;
+  return ts_query_cursor__next_match(self, match, &anchor);
+}
+
 void ts_query_cursor_remove_match(
   TSQueryCursor *self,
   uint32_t match_id
@@ -4045,6 +5164,7 @@ void ts_query_cursor_remove_match(
         state->capture_list_id
       );
       array_erase(&self->states, i);
+      self->first_in_progress_capture_is_valid = false;
       return;
     }
   }
@@ -4059,24 +5179,32 @@ bool ts_query_cursor_next_capture(
   // be discovered in order, because patterns can overlap. Search for matches
   // until there is a finished capture that is before any unfinished capture.
   for (;;) {
-    // First, find the earliest capture in an unfinished match.
-    uint32_t first_unfinished_capture_byte;
-    uint32_t first_unfinished_pattern_index;
-    uint32_t first_unfinished_state_index;
-    bool first_unfinished_state_is_definite = false;
-    ts_query_cursor__first_in_progress_capture(
-      self,
-      &first_unfinished_state_index,
-      &first_unfinished_capture_byte,
-      &first_unfinished_pattern_index,
-      &first_unfinished_state_is_definite
-    );
+    // First, find the earliest capture in an unfinished match. This does not
+    // change while captures are returned from finished matches.
+    InProgressCapture *first_unfinished = &self->first_in_progress_capture;
+    if (!self->first_in_progress_capture_is_valid) {
+      first_unfinished->is_definite = false;
+      ts_query_cursor__first_in_progress_capture(
+        self,
+        &first_unfinished->state_index,
+        &first_unfinished->byte_offset,
+        &first_unfinished->pattern_index,
+        &first_unfinished->is_definite
+      );
+      self->first_in_progress_capture_is_valid = true;
+    }
+    uint32_t first_unfinished_capture_byte = first_unfinished->byte_offset;
+    uint32_t first_unfinished_pattern_index = first_unfinished->pattern_index;
+    uint32_t first_unfinished_state_index = first_unfinished->state_index;
+    bool first_unfinished_state_is_definite = first_unfinished->is_definite;
 
     // Then find the earliest capture in a finished match. It must occur
     // before the first capture in an *unfinished* match.
     QueryState *first_finished_state = NULL;
     uint32_t first_finished_capture_byte = first_unfinished_capture_byte;
     uint32_t first_finished_pattern_index = first_unfinished_pattern_index;
+    bool has_start = ts_query_cursor__has_start(self);
+    bool has_end = ts_query_cursor__has_end(self);
     for (unsigned i = 0; i < self->finished_states.size;) {
       QueryState *state = &self->finished_states.contents[i];
       const CaptureList *captures = capture_list_pool_get(
@@ -4096,12 +5224,13 @@ bool ts_query_cursor_next_capture(
 
       TSNode node = captures->contents[state->consumed_capture_count].node;
 
-      bool node_precedes_range = (
-        ts_node_end_byte(node) <= self->start_byte ||
+      ByteRange range = ts_query_cursor__byte_range_at(self, ts_node_start_byte(node));
+      bool node_precedes_range = has_start && (
+        ts_node_end_byte(node) <= range.start_byte ||
         point_lte(ts_node_end_point(node), self->start_point)
       );
-      bool node_follows_range = (
-        ts_node_start_byte(node) >= self->end_byte ||
+      bool node_follows_range = has_end && (
+        ts_node_start_byte(node) >= range.end_byte ||
         point_gte(ts_node_start_point(node), self->end_point)
       );
       bool node_outside_of_range = node_precedes_range || node_follows_range;
@@ -4135,6 +5264,7 @@ bool ts_query_cursor_next_capture(
       state = first_finished_state;
     } else if (first_unfinished_state_is_definite) {
       state = &self->states.contents[first_unfinished_state_index];
+      self->first_in_progress_capture_is_valid = false;
     } else {
       state = NULL;
     }
@@ -4166,6 +5296,7 @@ bool ts_query_cursor_next_capture(
         self->states.contents[first_unfinished_state_index].capture_list_id
       );
       array_erase(&self->states, first_unfinished_state_index);
+      self->first_in_progress_capture_is_valid = false;
     }
 
     // If there are no finished matches that are ready to be returned, then
@@ -4184,4 +5315,389 @@ void ts_query_cursor_set_max_start_depth(
   self->max_start_depth = max_start_depth;
 }
 
+void ts_query_cursor_disable_pattern(
+  TSQueryCursor *self,
+  uint32_t pattern_index
+) {
+  index_set_insert(&self->disabled_patterns, pattern_index);
+}
+
+void ts_query_cursor_disable_capture(
+  TSQueryCursor *self,
+  uint32_t capture_index
+) {
+  index_set_insert(&self->disabled_captures, capture_index);
+}
+
+void ts_query_cursor_enable_all(TSQueryCursor *self) {
+  array_clear(&self->disabled_patterns);
+  array_clear(&self->disabled_captures);
+}
+
+
+/*******************
+ * TSQueryMatchSet
+ *******************/
+
+TSQueryMatchSet *ts_query_match_set_new(void) {
+  TSQueryMatchSet *self = ts_malloc(sizeof(TSQueryMatchSet));
+  array_init(&self->entries);
+  array_init(&self->captures);
+  array_init(&self->edited_ranges);
+  return self;
+}
+
+void ts_query_match_set_delete(TSQueryMatchSet *self) {
+  array_delete(&self->entries);
+  array_delete(&self->captures);
+  array_delete(&self->edited_ranges);
+  ts_free(self);
+}
+
+void ts_query_match_set_clear(TSQueryMatchSet *self) {
+  array_clear(&self->entries);
+  array_clear(&self->captures);
+  array_clear(&self->edited_ranges);
+}
+
+uint32_t ts_query_match_set_count(const TSQueryMatchSet *self) {
+  return self->entries.size;
+}
+
+TSQueryStoredMatch ts_query_match_set_match(const TSQueryMatchSet *self, uint32_t index) {
+  const MatchSetEntry *entry = &self->entries.contents[index];
+  return (TSQueryStoredMatch) {
+    .pattern_index = entry->pattern_index,
+    .capture_count = entry->capture_count,
+    .captures = entry->capture_count ? &self->captures.contents[entry->capture_offset] : NULL,
+  };
+}
+
+// Move a position in the same way that `ts_node_edit` moves a node's start.
+static inline uint32_t ts_query_match_set__edit_byte(uint32_t byte, const TSInputEdit *edit) {
+  if (byte == UINT32_MAX) return byte;
+  if (byte >= edit->old_end_byte) return edit->new_end_byte + (byte - edit->old_end_byte);
+  if (byte > edit->start_byte) return edit->new_end_byte;
+  return byte;
+}
+
+static inline TSPoint ts_query_match_set__edit_point(
+  TSPoint point,
+  uint32_t byte,
+  const TSInputEdit *edit
+) {
+  if (byte >= edit->old_end_byte) {
+    return point_add(edit->new_end_point, point_sub(point, edit->old_end_point));
+  }
+  if (byte > edit->start_byte) return edit->new_end_point;
+  return point;
+}
+
+void ts_query_match_set_edit(TSQueryMatchSet *self, const TSInputEdit *edit) {
+  for (unsigned i = 0; i < self->entries.size; i++) {
+    MatchSetEntry *entry = &self->entries.contents[i];
+    if (
+      entry->anchor_end_byte >= edit->start_byte &&
+      entry->anchor_start_byte <= edit->old_end_byte
+    ) entry->is_dirty = true;
+    entry->anchor_start_byte = ts_query_match_set__edit_byte(entry->anchor_start_byte, edit);
+    entry->anchor_end_byte = ts_query_match_set__edit_byte(entry->anchor_end_byte, edit);
+  }
+
+  for (unsigned i = 0; i < self->captures.size; i++) {
+    TSRange *range = &self->captures.contents[i].range;
+    range->start_point = ts_query_match_set__edit_point(range->start_point, range->start_byte, edit);
+    range->end_point = ts_query_match_set__edit_point(range->end_point, range->end_byte, edit);
+    range->start_byte = ts_query_match_set__edit_byte(range->start_byte, edit);
+    range->end_byte = ts_query_match_set__edit_byte(range->end_byte, edit);
+  }
+
+  for (unsigned i = 0; i < self->edited_ranges.size; i++) {
+    ByteRange *range = &self->edited_ranges.contents[i];
+    range->start_byte = ts_query_match_set__edit_byte(range->start_byte, edit);
+    range->end_byte = ts_query_match_set__edit_byte(range->end_byte, edit);
+  }
+  array_push(&self->edited_ranges, ((ByteRange) {
+    .start_byte = edit->start_byte,
+    .end_byte = edit->new_end_byte,
+  }));
+}
+
+static inline MatchSetRef ts_query_match_set__ref(const TSQueryMatchSet *self, uint32_t index) {
+  const MatchSetEntry *entry = &self->entries.contents[index];
+  return (MatchSetRef) {
+    .entry = entry,
+    .captures = entry->capture_count ? &self->captures.contents[entry->capture_offset] : NULL,
+  };
+}
+
+static inline int ts_query_match_set__compare_u32(uint32_t left, uint32_t right) {
+  return left < right ? -1 : left > right ? 1 : 0;
+}
+
+// Order matches by their anchors, then by their patterns and captures.
+static int ts_query_match_set__compare(const MatchSetRef *left, const MatchSetRef *right) {
+  const MatchSetEntry *a = left->entry;
+  const MatchSetEntry *b = right->entry;
+  int result;
+  if ((result = ts_query_match_set__compare_u32(a->anchor_start_byte, b->anchor_start_byte))) return result;
+  if ((result = ts_query_match_set__compare_u32(a->anchor_end_byte, b->anchor_end_byte))) return result;
+  if ((result = ts_query_match_set__compare_u32(a->pattern_index, b->pattern_index))) return result;
+  if ((result = ts_query_match_set__compare_u32(a->capture_count, b->capture_count))) return result;
+  for (unsigned i = 0; i < a->capture_count; i++) {
+    const TSQueryStoredCapture *c = &left->captures[i];
+    const TSQueryStoredCapture *d = &right->captures[i];
+    if ((result = ts_query_match_set__compare_u32(c->range.start_byte, d->range.start_byte))) return result;
+    if ((result = ts_query_match_set__compare_u32(c->range.end_byte, d->range.end_byte))) return result;
+    if ((result = ts_query_match_set__compare_u32(c->index, d->index))) return result;
+  }
+  return 0;
+}
+
+static int ts_query_match_set__compare_for_sort(const void *left, const void *right) {
+  return ts_query_match_set__compare(left, right);
+}
+
+static inline bool ts_query_match_set__refs_contain(
+  const MatchSetRefArray *refs,
+  const MatchSetRef *ref
+) {
+  unsigned index, exists;
+  array_search_sorted_with(refs, ts_query_match_set__compare, ref, &index, &exists);
+  return exists;
+}
+
+static void ts_query_match_set__push(TSQueryMatchSet *self, const MatchSetRef *ref) {
+  MatchSetEntry entry = *ref->entry;
+  entry.capture_offset = self->captures.size;
+  entry.is_dirty = false;
+  array_push(&self->entries, entry);
+  if (entry.capture_count > 0) {
+    array_extend(&self->captures, entry.capture_count, ref->captures);
+  }
+}
+
+// Determine whether a match's anchor touches any of the given ranges, which
+// are sorted and disjoint.
+static bool ts_query_match_set__anchor_touches_ranges(
+  const MatchSetEntry *entry,
+  const TSRange *ranges,
+  uint32_t range_count
+) {
+  uint32_t start = 0, end = range_count;
+  while (start < end) {
+    uint32_t mid = start + (end - start) / 2;
+    if (ranges[mid].end_byte < entry->anchor_start_byte) {
+      start = mid + 1;
+    } else {
+      end = mid;
+    }
+  }
+  return start < range_count && ranges[start].start_byte <= entry->anchor_end_byte;
+}
+
+// Add a range that must be searched again, widened by one byte on either side
+// so that it also covers the nodes that merely touch it.
+static inline void ts_query_match_set__push_range(
+  ByteRangeArray *ranges,
+  uint32_t start_byte,
+  uint32_t end_byte
+) {
+  array_push(ranges, ((ByteRange) {
+    .start_byte = start_byte > 0 ? start_byte - 1 : 0,
+    .end_byte = end_byte < UINT32_MAX ? end_byte + 1 : UINT32_MAX,
+  }));
+}
+
+static int ts_query_match_set__compare_ranges(const void *left, const void *right) {
+  const ByteRange *a = left;
+  const ByteRange *b = right;
+  return ts_query_match_set__compare_u32(a->start_byte, b->start_byte);
+}
+
+bool ts_query_cursor_exec_incremental(
+  TSQueryCursor *self,
+  const TSQuery *query,
+  TSQueryMatchSet *matches,
+  const TSTree *old_tree,
+  const TSTree *new_tree,
+  TSQueryMatchSet *added,
+  TSQueryMatchSet *removed
+) {
+  ByteRangeArray ranges = array_new();
+  MatchSetRefArray kept = array_new();
+  MatchSetRefArray candidates = array_new();
+  MatchSetRefArray found_refs = array_new();
+  TSQueryMatchSet found = {array_new(), array_new(), array_new()};
+
+  // Find the ranges that must be searched again, and the existing matches that
+  // may have been invalidated: those whose anchors were touched by an edit, or
+  // touch one of the ranges whose syntax has changed. Every other match still
+  // exists, because its anchor's subtree has not changed. If an invalidated
+  // match still exists, then its anchor still touches one of these ranges, so
+  // it will be found again.
+  if (old_tree) {
+    uint32_t changed_range_count;
+    TSRange *changed_ranges = ts_tree_get_changed_ranges(old_tree, new_tree, &changed_range_count);
+    for (unsigned i = 0; i < changed_range_count; i++) {
+      ts_query_match_set__push_range(&ranges, changed_ranges[i].start_byte, changed_ranges[i].end_byte);
+    }
+    for (unsigned i = 0; i < matches->edited_ranges.size; i++) {
+      ByteRange *range = &matches->edited_ranges.contents[i];
+      ts_query_match_set__push_range(&ranges, range->start_byte, range->end_byte);
+    }
+    for (unsigned i = 0; i < matches->entries.size; i++) {
+      MatchSetRef ref = ts_query_match_set__ref(matches, i);
+      if (
+        ref.entry->is_dirty ||
+        ts_query_match_set__anchor_touches_ranges(ref.entry, changed_ranges, changed_range_count)
+      ) {
+        array_push(&candidates, ref);
+      } else {
+        array_push(&kept, ref);
+      }
+    }
+    ts_free(changed_ranges);
+  } else {
+    for (unsigned i = 0; i < matches->entries.size; i++) {
+      array_push(&candidates, ts_query_match_set__ref(matches, i));
+    }
+    array_push(&ranges, ((ByteRange) {.start_byte = 0, .end_byte = UINT32_MAX}));
+  }
+
+  // Merge the overlapping ranges.
+  if (ranges.size > 1) {
+    qsort(ranges.contents, ranges.size, sizeof(ByteRange), ts_query_match_set__compare_ranges);
+    uint32_t merged_count = 1;
+    for (unsigned i = 1; i < ranges.size; i++) {
+      ByteRange *last = &ranges.contents[merged_count - 1];
+      ByteRange *range = &ranges.contents[i];
+      if (range->start_byte <= last->end_byte) {
+        if (range->end_byte > last->end_byte) last->end_byte = range->end_byte;
+      } else {
+        ranges.contents[merged_count++] = *range;
+      }
+    }
+    ranges.size = merged_count;
+  }
+
+  // Search all of the ranges in one pass, collecting the matches whose anchors
+  // intersect them.
+  ByteRangeArray byte_ranges = self->byte_ranges;
+  uint32_t start_byte = self->start_byte;
+  uint32_t end_byte = self->end_byte;
+  TSPoint start_point = self->start_point;
+  TSPoint end_point = self->end_point;
+  bool completed = true;
+  if (ranges.size > 0) {
+    self->byte_ranges = ranges.size > 1 ? ranges : (ByteRangeArray) array_new();
+    self->start_byte = ranges.contents[0].start_byte;
+    self->end_byte = ranges.contents[ranges.size - 1].end_byte;
+    self->start_point = POINT_ZERO;
+    self->end_point = POINT_MAX;
+    ts_query_cursor_exec(self, query, ts_tree_root_node(new_tree));
+
+    TSQueryMatch match;
+    ByteRange anchor;
+    while (ts_query_cursor__next_match(self, &match, &anchor)) {
+      array_push(&found.entries, ((MatchSetEntry) {
+        .pattern_index = match.pattern_index,
+        .anchor_start_byte = anchor.start_byte,
+        .anchor_end_byte = anchor.end_byte,
+        .capture_offset = found.captures.size,
+        .capture_count = match.capture_count,
+        .is_dirty = false,
+      }));
+      for (unsigned j = 0; j < match.capture_count; j++) {
+        TSNode node = match.captures[j].node;
+        array_push(&found.captures, ((TSQueryStoredCapture) {
+          .range = {
+            .start_point = ts_node_start_point(node),
+            .end_point = ts_node_end_point(node),
+            .start_byte = ts_node_start_byte(node),
+            .end_byte = ts_node_end_byte(node),
+          },
+          .index = match.captures[j].index,
+        }));
+      }
+    }
+    completed = self->halted && !self->did_exceed_match_limit;
+  }
+  self->byte_ranges = byte_ranges;
+  self->start_byte = start_byte;
+  self->end_byte = end_byte;
+  self->start_point = start_point;
+  self->end_point = end_point;
+
+  if (completed) {
+    // Sort the matches that were found, and remove any duplicates.
+    for (unsigned i = 0; i < found.entries.size; i++) {
+      array_push(&found_refs, ts_query_match_set__ref(&found, i));
+    }
+    if (found_refs.size > 1) {
+      qsort(found_refs.contents, found_refs.size, sizeof(MatchSetRef), ts_query_match_set__compare_for_sort);
+    }
+    uint32_t unique_count = 0;
+    for (unsigned i = 0; i < found_refs.size; i++) {
+      if (
+        unique_count == 0 ||
+        ts_query_match_set__compare(&found_refs.contents[unique_count - 1], &found_refs.contents[i]) != 0
+      ) found_refs.contents[unique_count++] = found_refs.contents[i];
+    }
+    found_refs.size = unique_count;
+    if (candidates.size > 1) {
+      qsort(candidates.contents, candidates.size, sizeof(MatchSetRef), ts_query_match_set__compare_for_sort);
+    }
+
+    if (removed) {
+      ts_query_match_set_clear(removed);
+      for (unsigned i = 0; i < candidates.size; i++) {
+        if (!ts_query_match_set__refs_contain(&found_refs, &candidates.contents[i])) {
+          ts_query_match_set__push(removed, &candidates.contents[i]);
+        }
+      }
+    }
+    if (added) {
+      ts_query_match_set_clear(added);
+      for (unsigned i = 0; i < found_refs.size; i++) {
+        MatchSetRef *ref = &found_refs.contents[i];
+        if (
+          !ts_query_match_set__refs_contain(&kept, ref) &&
+          !ts_query_match_set__refs_contain(&candidates, ref)
+        ) ts_query_match_set__push(added, ref);
+      }
+    }
+
+    // The matches that were kept are still sorted, because none of their
+    // positions were inside of an edit. Merge them with the ones that were found.
+    TSQueryMatchSet result = {array_new(), array_new(), array_new()};
+    array_reserve(&result.entries, kept.size + found_refs.size);
+    unsigned i = 0, j = 0;
+    while (i < kept.size || j < found_refs.size) {
+      int comparison;
+      if (i == kept.size) comparison = 1;
+      else if (j == found_refs.size) comparison = -1;
+      else comparison = ts_query_match_set__compare(&kept.contents[i], &found_refs.contents[j]);
+      if (comparison <= 0) {
+        ts_query_match_set__push(&result, &kept.contents[i++]);
+        if (comparison == 0) j++;
+      } else {
+        ts_query_match_set__push(&result, &found_refs.contents[j++]);
+      }
+    }
+    array_delete(&matches->entries);
+    array_delete(&matches->captures);
+    array_delete(&matches->edited_ranges);
+    *matches = result;
+  }
+
+  array_delete(&ranges);
+  array_delete(&kept);
+  array_delete(&candidates);
+  array_delete(&found_refs);
+  array_delete(&found.entries);
+  array_delete(&found.captures);
+  return completed;
+}
+
 #undef LOG
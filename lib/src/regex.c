@@ -0,0 +1,649 @@
+#include <string.h>
+#include "./alloc.h"
+#include "./array.h"
+#include "./regex.h"
+#include "./unicode.h"
+
+#define REGEX_NONE UINT32_MAX
+#define REGEX_UNBOUNDED UINT32_MAX
+#define REGEX_MAX_DEPTH 32
+#define REGEX_MAX_REPETITION_COUNT 1000
+#define REGEX_MAX_INSTRUCTION_COUNT 4096
+
+typedef enum {
+  RegexNodeChar,
+  RegexNodeAny,
+  RegexNodeClass,
+  RegexNodeStart,
+  RegexNodeEnd,
+  RegexNodeConcatenation,
+  RegexNodeAlternation,
+  RegexNodeRepetition,
+} RegexNodeType;
+
+// A node in the syntax tree of a regex. The children of concatenations and
+// alternations are linked through their `next` fields, and a repetition has
+// a single child.
+typedef struct {
+  RegexNodeType type;
+  bool negated;
+  int32_t code_point;
+  uint32_t range_index;
+  uint32_t range_count;
+  uint32_t child;
+  uint32_t next;
+  uint32_t min;
+  uint32_t max;
+} RegexNode;
+
+typedef enum {
+  RegexOpChar,
+  RegexOpAny,
+  RegexOpClass,
+  RegexOpNegatedClass,
+  RegexOpSplit,
+  RegexOpJump,
+  RegexOpStart,
+  RegexOpEnd,
+  RegexOpMatch,
+} RegexOpcode;
+
+// An instruction for the matching automaton. The meaning of `x` and `y`
+// depends on the opcode: a code point, a slice of the regex's ranges, or the
+// targets of a jump or a split.
+typedef struct {
+  RegexOpcode opcode;
+  uint32_t x;
+  uint32_t y;
+} RegexInstruction;
+
+typedef struct {
+  int32_t start;
+  int32_t end;
+} RegexRange;
+
+struct Regex {
+  Array(RegexInstruction) program;
+  Array(RegexRange) ranges;
+};
+
+typedef struct {
+  const char *input;
+  const char *end;
+  int32_t next;
+  uint8_t next_size;
+  unsigned depth;
+  bool failed;
+  Array(RegexNode) nodes;
+  Regex *regex;
+} RegexParser;
+
+/*****************
+ * RegexParser
+ *****************/
+
+static void ts_regex_parser__advance(RegexParser *self) {
+  self->input += self->next_size;
+  if (self->input < self->end) {
+    self->next_size = (uint8_t)ts_decode_utf8(
+      (const uint8_t *)self->input,
+      (uint32_t)(self->end - self->input),
+      &self->next
+    );
+    if (self->next < 0) {
+      self->failed = true;
+      self->next_size = 0;
+    }
+  } else {
+    self->next = -1;
+    self->next_size = 0;
+  }
+}
+
+static int32_t ts_regex_parser__peek_after_next(const RegexParser *self) {
+  const char *input = self->input + self->next_size;
+  if (input >= self->end) return -1;
+  int32_t code_point;
+  ts_decode_utf8((const uint8_t *)input, (uint32_t)(self->end - input), &code_point);
+  return code_point;
+}
+
+static uint32_t ts_regex_parser__push(RegexParser *self, RegexNode node) {
+  node.next = REGEX_NONE;
+  array_push(&self->nodes, node);
+  return self->nodes.size - 1;
+}
+
+// Parse the character after a backslash, returning the code point that it
+// stands for, or -1 if the escape is not supported.
+static int32_t ts_regex_parser__parse_escape(RegexParser *self) {
+  int32_t c = self->next;
+  ts_regex_parser__advance(self);
+  switch (c) {
+    case 'a': return '\a';
+    case 'f': return '\f';
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 't': return '\t';
+    case 'v': return '\v';
+    default:
+      // Any other ASCII character that isn't a letter, a digit, or one of
+      // the word boundary assertions `\<` and `\>` stands for itself.
+      if (
+        c < 0 || c > 0x7f ||
+        (c >= '0' && c <= '9') ||
+        (c >= 'a' && c <= 'z') ||
+        (c >= 'A' && c <= 'Z') ||
+        c == '<' || c == '>'
+      ) {
+        self->failed = true;
+        return -1;
+      }
+      return c;
+  }
+}
+
+static int32_t ts_regex_parser__parse_class_member(RegexParser *self) {
+  int32_t c = self->next;
+  if (c == '\\') {
+    ts_regex_parser__advance(self);
+    return ts_regex_parser__parse_escape(self);
+  }
+
+  // Nested classes and set operations are not supported.
+  if (c == '[' || ((c == '&' || c == '~') && ts_regex_parser__peek_after_next(self) == c)) {
+    self->failed = true;
+    return -1;
+  }
+  ts_regex_parser__advance(self);
+  return c;
+}
+
+static uint32_t ts_regex_parser__parse_class(RegexParser *self) {
+  ts_regex_parser__advance(self);
+  bool negated = false;
+  if (self->next == '^') {
+    negated = true;
+    ts_regex_parser__advance(self);
+  }
+
+  uint32_t range_index = self->regex->ranges.size;
+  for (bool is_first = true;; is_first = false) {
+    if (self->next < 0) {
+      self->failed = true;
+      return REGEX_NONE;
+    }
+
+    // A closing bracket at the start of a class stands for itself.
+    if (self->next == ']' && !is_first) {
+      ts_regex_parser__advance(self);
+      break;
+    }
+
+    // A hyphen stands for itself only at the start or the end of a class.
+    if (self->next == '-' && !is_first && ts_regex_parser__peek_after_next(self) != ']') {
+      self->failed = true;
+      return REGEX_NONE;
+    }
+
+    int32_t start = ts_regex_parser__parse_class_member(self);
+    int32_t end = start;
+    if (self->next == '-' && ts_regex_parser__peek_after_next(self) != ']') {
+      ts_regex_parser__advance(self);
+      end = ts_regex_parser__parse_class_member(self);
+      if (end < start) self->failed = true;
+    }
+    if (self->failed) return REGEX_NONE;
+    array_push(&self->regex->ranges, ((RegexRange) {start, end}));
+  }
+
+  return ts_regex_parser__push(self, (RegexNode) {
+    .type = RegexNodeClass,
+    .negated = negated,
+    .range_index = range_index,
+    .range_count = self->regex->ranges.size - range_index,
+  });
+}
+
+static uint32_t ts_regex_parser__parse_alternation(RegexParser *self);
+
+static uint32_t ts_regex_parser__parse_atom(RegexParser *self) {
+  switch (self->next) {
+    case '(': {
+      ts_regex_parser__advance(self);
+
+      // Groups never need to capture, but flags are not supported.
+      if (self->next == '?') {
+        ts_regex_parser__advance(self);
+        if (self->next != ':') {
+          self->failed = true;
+          return REGEX_NONE;
+        }
+        ts_regex_parser__advance(self);
+      }
+      uint32_t result = ts_regex_parser__parse_alternation(self);
+      if (self->next != ')') {
+        self->failed = true;
+        return REGEX_NONE;
+      }
+      ts_regex_parser__advance(self);
+      return result;
+    }
+    case '[':
+      return ts_regex_parser__parse_class(self);
+    case '.':
+      ts_regex_parser__advance(self);
+      return ts_regex_parser__push(self, (RegexNode) {.type = RegexNodeAny});
+    case '^':
+      ts_regex_parser__advance(self);
+      return ts_regex_parser__push(self, (RegexNode) {.type = RegexNodeStart});
+    case '$':
+      ts_regex_parser__advance(self);
+      return ts_regex_parser__push(self, (RegexNode) {.type = RegexNodeEnd});
+    case '\\': {
+      ts_regex_parser__advance(self);
+      int32_t code_point = ts_regex_parser__parse_escape(self);
+      return ts_regex_parser__push(self, (RegexNode) {.type = RegexNodeChar, .code_point = code_point});
+    }
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+    case '}':
+    case ']':
+      self->failed = true;
+      return REGEX_NONE;
+    default: {
+      int32_t code_point = self->next;
+      ts_regex_parser__advance(self);
+      return ts_regex_parser__push(self, (RegexNode) {.type = RegexNodeChar, .code_point = code_point});
+    }
+  }
+}
+
+static bool ts_regex_parser__parse_count(RegexParser *self, uint32_t *count) {
+  if (self->next < '0' || self->next > '9') return false;
+  *count = 0;
+  while (self->next >= '0' && self->next <= '9') {
+    *count = *count * 10 + (uint32_t)(self->next - '0');
+    if (*count > REGEX_MAX_REPETITION_COUNT) return false;
+    ts_regex_parser__advance(self);
+  }
+  return true;
+}
+
+static uint32_t ts_regex_parser__parse_repetition(RegexParser *self) {
+  uint32_t atom = ts_regex_parser__parse_atom(self);
+  if (self->failed) return REGEX_NONE;
+
+  uint32_t min, max;
+  switch (self->next) {
+    case '*':
+      min = 0;
+      max = REGEX_UNBOUNDED;
+      ts_regex_parser__advance(self);
+      break;
+    case '+':
+      min = 1;
+      max = REGEX_UNBOUNDED;
+      ts_regex_parser__advance(self);
+      break;
+    case '?':
+      min = 0;
+      max = 1;
+      ts_regex_parser__advance(self);
+      break;
+    case '{':
+      ts_regex_parser__advance(self);
+      if (!ts_regex_parser__parse_count(self, &min)) {
+        self->failed = true;
+        return REGEX_NONE;
+      }
+      max = min;
+      if (self->next == ',') {
+        ts_regex_parser__advance(self);
+        max = REGEX_UNBOUNDED;
+        if (self->next != '}' && (!ts_regex_parser__parse_count(self, &max) || max < min)) {
+          self->failed = true;
+          return REGEX_NONE;
+        }
+      }
+      if (self->next != '}') {
+        self->failed = true;
+        return REGEX_NONE;
+      }
+      ts_regex_parser__advance(self);
+      break;
+    default:
+      return atom;
+  }
+
+  // Lazy repetitions match the same texts as greedy ones. Repetitions of
+  // repetitions are not supported.
+  if (self->next == '?') ts_regex_parser__advance(self);
+  if (self->next == '*' || self->next == '+' || self->next == '?' || self->next == '{') {
+    self->failed = true;
+    return REGEX_NONE;
+  }
+
+  return ts_regex_parser__push(self, (RegexNode) {
+    .type = RegexNodeRepetition,
+    .child = atom,
+    .min = min,
+    .max = max,
+  });
+}
+
+static uint32_t ts_regex_parser__parse_concatenation(RegexParser *self) {
+  uint32_t result = ts_regex_parser__push(self, (RegexNode) {
+    .type = RegexNodeConcatenation,
+    .child = REGEX_NONE,
+  });
+  uint32_t last_child = REGEX_NONE;
+  while (!self->failed && self->next >= 0 && self->next != '|' && self->next != ')') {
+    uint32_t child = ts_regex_parser__parse_repetition(self);
+    if (self->failed) break;
+    if (last_child == REGEX_NONE) {
+      self->nodes.contents[result].child = child;
+    } else {
+      self->nodes.contents[last_child].next = child;
+    }
+    last_child = child;
+  }
+  return result;
+}
+
+static uint32_t ts_regex_parser__parse_alternation(RegexParser *self) {
+  if (++self->depth > REGEX_MAX_DEPTH) {
+    self->failed = true;
+    return REGEX_NONE;
+  }
+
+  uint32_t result = ts_regex_parser__parse_concatenation(self);
+  if (self->next == '|') {
+    uint32_t first_child = result;
+    result = ts_regex_parser__push(self, (RegexNode) {.type = RegexNodeAlternation, .child = first_child});
+    uint32_t last_child = first_child;
+    while (!self->failed && self->next == '|') {
+      ts_regex_parser__advance(self);
+      uint32_t child = ts_regex_parser__parse_concatenation(self);
+      self->nodes.contents[last_child].next = child;
+      last_child = child;
+    }
+  }
+
+  self->depth--;
+  return result;
+}
+
+/*****************
+ * Compilation
+ *****************/
+
+static uint32_t ts_regex__emit(Regex *self, RegexOpcode opcode, uint32_t x, uint32_t y) {
+  array_push(&self->program, ((RegexInstruction) {opcode, x, y}));
+  return self->program.size - 1;
+}
+
+static bool ts_regex__compile(Regex *self, const RegexNode *nodes, uint32_t index) {
+  if (self->program.size > REGEX_MAX_INSTRUCTION_COUNT) return false;
+  const RegexNode *node = &nodes[index];
+  switch (node->type) {
+    case RegexNodeChar:
+      ts_regex__emit(self, RegexOpChar, (uint32_t)node->code_point, 0);
+      break;
+    case RegexNodeAny:
+      ts_regex__emit(self, RegexOpAny, 0, 0);
+      break;
+    case RegexNodeClass:
+      ts_regex__emit(
+        self,
+        node->negated ? RegexOpNegatedClass : RegexOpClass,
+        node->range_index,
+        node->range_count
+      );
+      break;
+    case RegexNodeStart:
+      ts_regex__emit(self, RegexOpStart, 0, 0);
+      break;
+    case RegexNodeEnd:
+      ts_regex__emit(self, RegexOpEnd, 0, 0);
+      break;
+    case RegexNodeConcatenation:
+      for (uint32_t child = node->child; child != REGEX_NONE; child = nodes[child].next) {
+        if (!ts_regex__compile(self, nodes, child)) return false;
+      }
+      break;
+
+    // Each alternative but the last is preceded by a split to the next one,
+    // and followed by a jump to the end. The jumps are linked through their
+    // targets until the end is known.
+    case RegexNodeAlternation: {
+      uint32_t last_jump = REGEX_NONE;
+      for (uint32_t child = node->child; child != REGEX_NONE; child = nodes[child].next) {
+        if (nodes[child].next == REGEX_NONE) {
+          if (!ts_regex__compile(self, nodes, child)) return false;
+        } else {
+          uint32_t split = ts_regex__emit(self, RegexOpSplit, self->program.size + 1, 0);
+          if (!ts_regex__compile(self, nodes, child)) return false;
+          last_jump = ts_regex__emit(self, RegexOpJump, last_jump, 0);
+          self->program.contents[split].y = self->program.size;
+        }
+      }
+      while (last_jump != REGEX_NONE) {
+        uint32_t previous_jump = self->program.contents[last_jump].x;
+        self->program.contents[last_jump].x = self->program.size;
+        last_jump = previous_jump;
+      }
+      break;
+    }
+
+    // The child is repeated the minimum number of times, and then followed
+    // either by a loop or by optional copies, whose splits are linked through
+    // their second targets until the end is known.
+    case RegexNodeRepetition: {
+      for (uint32_t i = 0; i < node->min; i++) {
+        if (!ts_regex__compile(self, nodes, node->child)) return false;
+      }
+      if (node->max == REGEX_UNBOUNDED) {
+        uint32_t split = ts_regex__emit(self, RegexOpSplit, self->program.size + 1, 0);
+        if (!ts_regex__compile(self, nodes, node->child)) return false;
+        ts_regex__emit(self, RegexOpJump, split, 0);
+        self->program.contents[split].y = self->program.size;
+      } else {
+        uint32_t last_split = REGEX_NONE;
+        for (uint32_t i = node->min; i < node->max; i++) {
+          last_split = ts_regex__emit(self, RegexOpSplit, self->program.size + 1, last_split);
+          if (!ts_regex__compile(self, nodes, node->child)) return false;
+        }
+        while (last_split != REGEX_NONE) {
+          uint32_t previous_split = self->program.contents[last_split].y;
+          self->program.contents[last_split].y = self->program.size;
+          last_split = previous_split;
+        }
+      }
+      break;
+    }
+  }
+  return self->program.size <= REGEX_MAX_INSTRUCTION_COUNT;
+}
+
+Regex *ts_regex_new(const char *pattern, uint32_t length) {
+  Regex *self = ts_malloc(sizeof(Regex));
+  array_init(&self->program);
+  array_init(&self->ranges);
+
+  RegexParser parser = {
+    .input = pattern,
+    .end = pattern + length,
+    .next_size = 0,
+    .depth = 0,
+    .failed = false,
+    .nodes = array_new(),
+    .regex = self,
+  };
+  ts_regex_parser__advance(&parser);
+  uint32_t root = ts_regex_parser__parse_alternation(&parser);
+
+  // An unmatched closing parenthesis stops the parser early.
+  bool succeeded = !parser.failed && parser.next < 0;
+  if (succeeded) {
+    succeeded = ts_regex__compile(self, parser.nodes.contents, root);
+    ts_regex__emit(self, RegexOpMatch, 0, 0);
+  }
+  array_delete(&parser.nodes);
+
+  if (!succeeded) {
+    ts_regex_delete(self);
+    return NULL;
+  }
+  return self;
+}
+
+void ts_regex_delete(Regex *self) {
+  if (!self) return;
+  array_delete(&self->program);
+  array_delete(&self->ranges);
+  ts_free(self);
+}
+
+/*****************
+ * Matching
+ *****************/
+
+static inline bool ts_regex__class_contains(const Regex *self, const RegexInstruction *instruction, int32_t c) {
+  for (uint32_t i = 0; i < instruction->y; i++) {
+    const RegexRange *range = &self->ranges.contents[instruction->x + i];
+    if (c >= range->start && c <= range->end) return true;
+  }
+  return false;
+}
+
+// The state of a breadth-first simulation of the automaton. Each list holds
+// the instructions that consume a character, and which are reachable at the
+// current or the next position. An instruction is added to a list at most
+// once, which is tracked by marking it with the list's generation.
+typedef struct {
+  const Regex *regex;
+  uint32_t *marks;
+  uint32_t *stack;
+  uint32_t generation;
+  uint32_t length;
+} RegexMatcher;
+
+// Add the instructions that are reachable from the given one, without
+// consuming a character, to a list. Return true if the match instruction is
+// reachable.
+static bool ts_regex_matcher__add(
+  RegexMatcher *self,
+  uint32_t *list,
+  uint32_t *list_size,
+  uint32_t pc,
+  uint32_t position
+) {
+  if (self->marks[pc] == self->generation) return false;
+  self->marks[pc] = self->generation;
+  uint32_t stack_size = 0;
+  self->stack[stack_size++] = pc;
+
+  #define PUSH(target)                                \
+    do {                                              \
+      uint32_t t = target;                            \
+      if (self->marks[t] != self->generation) {       \
+        self->marks[t] = self->generation;            \
+        self->stack[stack_size++] = t;                \
+      }                                               \
+    } while (0)
+
+  while (stack_size > 0) {
+    pc = self->stack[--stack_size];
+    const RegexInstruction *instruction = &self->regex->program.contents[pc];
+    switch (instruction->opcode) {
+      case RegexOpMatch:
+        return true;
+      case RegexOpJump:
+        PUSH(instruction->x);
+        break;
+      case RegexOpSplit:
+        PUSH(instruction->y);
+        PUSH(instruction->x);
+        break;
+      case RegexOpStart:
+        if (position == 0) PUSH(pc + 1);
+        break;
+      case RegexOpEnd:
+        if (position == self->length) PUSH(pc + 1);
+        break;
+      default:
+        list[(*list_size)++] = pc;
+        break;
+    }
+  }
+
+  #undef PUSH
+  return false;
+}
+
+bool ts_regex_is_match(const Regex *self, const char *text, uint32_t length, RegexScratch *scratch) {
+  uint32_t instruction_count = self->program.size;
+  array_reserve(scratch, 4 * instruction_count);
+  memset(scratch->contents, 0, instruction_count * sizeof(uint32_t));
+  uint32_t *current_list = scratch->contents + instruction_count;
+  uint32_t *next_list = current_list + instruction_count;
+  RegexMatcher matcher = {
+    .regex = self,
+    .marks = scratch->contents,
+    .stack = next_list + instruction_count,
+    .generation = 1,
+    .length = length,
+  };
+
+  uint32_t current_size = 0;
+  if (ts_regex_matcher__add(&matcher, current_list, &current_size, 0, 0)) return true;
+
+  uint32_t position = 0;
+  while (position < length) {
+    int32_t c;
+    uint32_t size = ts_decode_utf8((const uint8_t *)&text[position], length - position, &c);
+    if (size == 0) size = 1;
+    matcher.generation++;
+
+    uint32_t next_size = 0;
+    for (uint32_t i = 0; i < current_size; i++) {
+      uint32_t pc = current_list[i];
+      const RegexInstruction *instruction = &self->program.contents[pc];
+      bool is_match;
+      switch (instruction->opcode) {
+        case RegexOpChar:
+          is_match = c >= 0 && (uint32_t)c == instruction->x;
+          break;
+        case RegexOpAny:
+          is_match = c >= 0 && c != '\n';
+          break;
+        case RegexOpClass:
+          is_match = c >= 0 && ts_regex__class_contains(self, instruction, c);
+          break;
+        case RegexOpNegatedClass:
+          is_match = c >= 0 && !ts_regex__class_contains(self, instruction, c);
+          break;
+        default:
+          is_match = false;
+          break;
+      }
+      if (is_match && ts_regex_matcher__add(&matcher, next_list, &next_size, pc + 1, position + size)) {
+        return true;
+      }
+    }
+    position += size;
+
+    // The regex can start matching at any position.
+    if (ts_regex_matcher__add(&matcher, next_list, &next_size, 0, position)) return true;
+
+    uint32_t *list = current_list;
+    current_list = next_list;
+    next_list = list;
+    current_size = next_size;
+  }
+
+  return false;
+}
@@ -0,0 +1,40 @@
+#ifndef TREE_SITTER_REGEX_H_
+#define TREE_SITTER_REGEX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "./array.h"
+
+// A regular expression that is used by a query's `#match?` predicates.
+//
+// Only the subset of the syntax of Rust's `regex` crate whose meaning does not
+// depend on Unicode tables is supported: literals, `.`, bracketed classes of
+// characters and ranges, anchors, groups, alternations and repetitions. Perl
+// classes like `\w`, Unicode classes, flags and word boundaries are not, so
+// that the text is matched exactly as the `regex` crate would match it.
+// Matching takes time proportional to the length of the text times the
+// size of the regex.
+typedef struct Regex Regex;
+
+// The memory needed while matching a regex, which can be reused between
+// matches.
+typedef Array(uint32_t) RegexScratch;
+
+// Compile a regex, returning `NULL` if it is invalid or uses syntax that is
+// not supported.
+Regex *ts_regex_new(const char *pattern, uint32_t length);
+
+void ts_regex_delete(Regex *self);
+
+// Determine whether the regex matches anywhere within the given UTF8 text.
+bool ts_regex_is_match(const Regex *self, const char *text, uint32_t length, RegexScratch *scratch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TREE_SITTER_REGEX_H_
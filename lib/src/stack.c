@@ -9,7 +9,7 @@
 #include <stdio.h>
 
 #define MAX_LINK_COUNT 8
-#define MAX_NODE_POOL_SIZE 50
+#define NODE_SLAB_SIZE 64
 #define MAX_ITERATOR_COUNT 64
 
 #if defined _WIN32 && !defined __GNUC__
@@ -23,14 +23,16 @@ typedef struct StackNode StackNode;
 typedef struct {
   StackNode *node;
   Subtree subtree;
-  bool is_pending;
 } StackLink;
 
+// Whether each link is pending is stored in a bitmask on the node rather
+// than in the link itself, which would otherwise be padded to 24 bytes.
 struct StackNode {
   TSStateId state;
   Length position;
   StackLink links[MAX_LINK_COUNT];
-  short unsigned int link_count;
+  uint8_t link_count;
+  uint8_t pending_links;
   uint32_t ref_count;
   unsigned error_cost;
   unsigned node_count;
@@ -44,7 +46,13 @@ typedef struct {
   bool is_pending;
 } StackIterator;
 
-typedef Array(StackNode *) StackNodeArray;
+// Stack nodes are allocated in slabs of `NODE_SLAB_SIZE`, which are kept
+// until the stack is deleted. Released nodes are added to a free list, which
+// is linked through each node's first link.
+typedef struct {
+  StackNode *free_nodes;
+  Array(StackNode *) slabs;
+} StackNodePool;
 
 typedef enum {
   StackStatusActive,
@@ -65,7 +73,7 @@ struct Stack {
   Array(StackHead) heads;
   StackSliceArray slices;
   Array(StackIterator) iterators;
-  StackNodeArray node_pool;
+  StackNodePool node_pool;
   StackNode *base_node;
   SubtreePool *subtree_pool;
 };
@@ -89,7 +97,7 @@ static void stack_node_retain(StackNode *self) {
 
 static void stack_node_release(
   StackNode *self,
-  StackNodeArray *pool,
+  StackNodePool *pool,
   SubtreePool *subtree_pool
 ) {
 recur:
@@ -109,11 +117,8 @@ recur:
     first_predecessor = self->links[0].node;
   }
 
-  if (pool->size < MAX_NODE_POOL_SIZE) {
-    array_push(pool, self);
-  } else {
-    ts_free(self);
-  }
+  self->links[0].node = pool->free_nodes;
+  pool->free_nodes = self;
 
   if (first_predecessor) {
     self = first_predecessor;
@@ -140,11 +145,19 @@ static StackNode *stack_node_new(
   Subtree subtree,
   bool is_pending,
   TSStateId state,
-  StackNodeArray *pool
+  StackNodePool *pool
 ) {
-  StackNode *node = pool->size > 0
-    ? array_pop(pool)
-    : ts_malloc(sizeof(StackNode));
+  if (!pool->free_nodes) {
+    StackNode *slab = ts_malloc_in(TSAllocationCategoryStackNodes, NODE_SLAB_SIZE * sizeof(StackNode));
+    array_push(&pool->slabs, slab);
+    for (unsigned i = 0; i < NODE_SLAB_SIZE; i++) {
+      slab[i].links[0].node = pool->free_nodes;
+      pool->free_nodes = &slab[i];
+    }
+  }
+
+  StackNode *node = pool->free_nodes;
+  pool->free_nodes = node->links[0].node;
   *node = (StackNode) {
     .ref_count = 1,
     .link_count = 0,
@@ -153,10 +166,10 @@ static StackNode *stack_node_new(
 
   if (previous_node) {
     node->link_count = 1;
+    node->pending_links = is_pending ? 1 : 0;
     node->links[0] = (StackLink) {
       .node = previous_node,
       .subtree = subtree,
-      .is_pending = is_pending,
     };
 
     node->position = previous_node->position;
@@ -197,9 +210,14 @@ static bool stack__subtree_is_equivalent(Subtree left, Subtree right) {
   );
 }
 
+static inline bool stack_node__link_is_pending(const StackNode *self, unsigned index) {
+  return self->pending_links & (1 << index);
+}
+
 static void stack_node_add_link(
   StackNode *self,
   StackLink link,
+  bool is_pending,
   SubtreePool *subtree_pool
 ) {
   if (link.node == self) return;
@@ -232,7 +250,12 @@ static void stack_node_add_link(
         existing_link->node->error_cost == link.node->error_cost
       ) {
         for (int j = 0; j < link.node->link_count; j++) {
-          stack_node_add_link(existing_link->node, link.node->links[j], subtree_pool);
+          stack_node_add_link(
+            existing_link->node,
+            link.node->links[j],
+            stack_node__link_is_pending(link.node, j),
+            subtree_pool
+          );
         }
         int32_t dynamic_precedence = link.node->dynamic_precedence;
         if (link.subtree.ptr) {
@@ -251,6 +274,7 @@ static void stack_node_add_link(
   stack_node_retain(link.node);
   unsigned node_count = link.node->node_count;
   int dynamic_precedence = link.node->dynamic_precedence;
+  if (is_pending) self->pending_links |= 1 << self->link_count;
   self->links[self->link_count++] = link;
 
   if (link.subtree.ptr) {
@@ -265,7 +289,7 @@ static void stack_node_add_link(
 
 static void stack_head_delete(
   StackHead *self,
-  StackNodeArray *pool,
+  StackNodePool *pool,
   SubtreePool *subtree_pool
 ) {
   if (self->node) {
@@ -381,19 +405,20 @@ static StackSliceArray stack__iter(
 
       for (uint32_t j = 1; j <= node->link_count; j++) {
         StackIterator *next_iterator;
-        StackLink link;
+        uint32_t link_index;
         if (j == node->link_count) {
-          link = node->links[0];
+          link_index = 0;
           next_iterator = &self->iterators.contents[i];
         } else {
           if (self->iterators.size >= MAX_ITERATOR_COUNT) continue;
-          link = node->links[j];
+          link_index = j;
           StackIterator current_iterator = self->iterators.contents[i];
           array_push(&self->iterators, current_iterator);
           next_iterator = array_back(&self->iterators);
           ts_subtree_array_copy(next_iterator->subtrees, &next_iterator->subtrees);
         }
 
+        StackLink link = node->links[link_index];
         next_iterator->node = link.node;
         if (link.subtree.ptr) {
           if (include_subtrees) {
@@ -403,7 +428,7 @@ static StackSliceArray stack__iter(
 
           if (!ts_subtree_extra(link.subtree)) {
             next_iterator->subtree_count++;
-            if (!link.is_pending) {
+            if (!stack_node__link_is_pending(node, link_index)) {
               next_iterator->is_pending = false;
             }
           }
@@ -424,11 +449,10 @@ Stack *ts_stack_new(SubtreePool *subtree_pool) {
   array_init(&self->heads);
   array_init(&self->slices);
   array_init(&self->iterators);
-  array_init(&self->node_pool);
+  self->node_pool = (StackNodePool) {.free_nodes = NULL, .slabs = array_new()};
   array_reserve(&self->heads, 4);
   array_reserve(&self->slices, 4);
   array_reserve(&self->iterators, 4);
-  array_reserve(&self->node_pool, MAX_NODE_POOL_SIZE);
 
   self->subtree_pool = subtree_pool;
   self->base_node = stack_node_new(NULL, NULL_SUBTREE, false, 1, &self->node_pool);
@@ -447,11 +471,10 @@ void ts_stack_delete(Stack *self) {
     stack_head_delete(&self->heads.contents[i], &self->node_pool, self->subtree_pool);
   }
   array_clear(&self->heads);
-  if (self->node_pool.contents) {
-    for (uint32_t i = 0; i < self->node_pool.size; i++)
-      ts_free(self->node_pool.contents[i]);
-    array_delete(&self->node_pool);
+  for (uint32_t i = 0; i < self->node_pool.slabs.size; i++) {
+    ts_free(self->node_pool.slabs.contents[i]);
   }
+  array_delete(&self->node_pool.slabs);
   array_delete(&self->heads);
   ts_free(self);
 }
@@ -628,6 +651,36 @@ StackSummary *ts_stack_get_summary(Stack *self, StackVersion version) {
   return array_get(&self->heads, version)->summary;
 }
 
+uint32_t ts_stack_get_bottom(
+  Stack *self,
+  StackVersion version,
+  StackBottomEntry *entries,
+  uint32_t max_count
+) {
+  StackHead *head = array_get(&self->heads, version);
+  uint32_t depth = 0;
+  for (StackNode *node = head->node; node->link_count > 0; node = node->links[0].node) {
+    if (node->link_count > 1 || node->pending_links || !node->links[0].subtree.ptr) return 0;
+    depth++;
+  }
+
+  uint32_t count = depth < max_count ? depth : max_count;
+  uint32_t index = depth;
+  for (StackNode *node = head->node; node->link_count > 0; node = node->links[0].node) {
+    index--;
+    if (index < count) {
+      StackNode *previous_node = node->links[0].node;
+      entries[index] = (StackBottomEntry) {
+        .subtree = &node->links[0].subtree,
+        .position = previous_node->position,
+        .state = previous_node->state,
+        .next_state = node->state,
+      };
+    }
+  }
+  return count;
+}
+
 int ts_stack_dynamic_precedence(Stack *self, StackVersion version) {
   return array_get(&self->heads, version)->node->dynamic_precedence;
 }
@@ -697,7 +750,12 @@ bool ts_stack_merge(Stack *self, StackVersion version1, StackVersion version2) {
   StackHead *head1 = &self->heads.contents[version1];
   StackHead *head2 = &self->heads.contents[version2];
   for (uint32_t i = 0; i < head2->node->link_count; i++) {
-    stack_node_add_link(head1->node, head2->node->links[i], self->subtree_pool);
+    stack_node_add_link(
+      head1->node,
+      head2->node->links[i],
+      stack_node__link_is_pending(head2->node, i),
+      self->subtree_pool
+    );
   }
   if (head1->node->state == ERROR_STATE) {
     head1->node_count_at_last_error = head1->node->node_count;
@@ -854,7 +912,7 @@ bool ts_stack_print_dot_graph(Stack *self, const TSLanguage *language, FILE *f)
       for (int j = 0; j < node->link_count; j++) {
         StackLink link = node->links[j];
         fprintf(f, "node_%p -> node_%p [", (void *)node, (void *)link.node);
-        if (link.is_pending) fprintf(f, "style=dashed ");
+        if (stack_node__link_is_pending(node, j)) fprintf(f, "style=dashed ");
         if (link.subtree.ptr && ts_subtree_extra(link.subtree)) fprintf(f, "fontcolor=gray ");
 
         if (!link.subtree.ptr) {
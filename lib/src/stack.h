@@ -28,6 +28,15 @@ typedef struct {
 } StackSummaryEntry;
 typedef Array(StackSummaryEntry) StackSummary;
 
+// A subtree near the bottom of the stack, along with the position and state
+// that precede it, and the state that follows it.
+typedef struct {
+  Subtree *subtree;
+  Length position;
+  TSStateId state;
+  TSStateId next_state;
+} StackBottomEntry;
+
 // Create a stack.
 Stack *ts_stack_new(SubtreePool *);
 
@@ -89,6 +98,15 @@ void ts_stack_record_summary(Stack *, StackVersion, unsigned max_depth);
 // given version of the stack.
 StackSummary *ts_stack_get_summary(Stack *, StackVersion);
 
+// Get up to `max_count` of the subtrees at the bottom of the given version
+// of the stack, starting from the bottom. This returns zero unless there is
+// exactly one path from the version's head to the bottom of the stack, and
+// none of the subtrees on that path are pending.
+//
+// The returned subtrees can be replaced in place with subtrees of the same
+// size, which the stack then takes ownership of.
+uint32_t ts_stack_get_bottom(Stack *, StackVersion, StackBottomEntry *, uint32_t max_count);
+
 // Get the total cost of all errors on the given version of the stack.
 unsigned ts_stack_error_cost(const Stack *, StackVersion version);
 
@@ -2,6 +2,7 @@
 #include <ctype.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include "./alloc.h"
@@ -20,40 +21,63 @@ typedef struct {
 } Edit;
 
 #define TS_MAX_INLINE_TREE_LENGTH UINT8_MAX
+#define TS_MAX_WIDE_INLINE_SIZE 1024
+#define TS_MAX_WIDE_INLINE_PADDING_ROWS 8
+#define TS_MAX_WIDE_INLINE_LOOKAHEAD_BYTES 8
 #define TS_MAX_TREE_POOL_SIZE 32
+#define TS_ARENA_SLAB_SIZE (64 * 1024)
+#define TS_ARENA_ALIGNMENT sizeof(void *)
+
+typedef struct SubtreeArenaSlab {
+  struct SubtreeArenaSlab *next;
+} SubtreeArenaSlab;
+
+struct SubtreeArena {
+  volatile uint32_t ref_count;
+  SubtreeArena *parent;
+  SubtreeArenaSlab *slabs;
+  char *cursor;
+  char *end;
+
+  // Heap-allocated subtrees and external scanner states that are referenced
+  // by nodes within this arena. Each entry owns one reference, which is
+  // released when the arena is freed.
+  SubtreeArray foreign_trees;
+  Array(ExternalScannerStateData *) scanner_states;
+};
 
 // ExternalScannerState
 
-void ts_external_scanner_state_init(ExternalScannerState *self, const char *data, unsigned length) {
-  self->length = length;
-  if (length > sizeof(self->short_data)) {
-    self->long_data = ts_malloc(length);
-    memcpy(self->long_data, data, length);
-  } else {
-    memcpy(self->short_data, data, length);
+uint32_t ts_external_scanner_state_hash_bytes(const char *data, unsigned length) {
+  uint32_t hash = 2166136261u;
+  for (unsigned i = 0; i < length; i++) {
+    hash = (hash ^ (uint8_t)data[i]) * 16777619u;
   }
+  return hash;
 }
 
-ExternalScannerState ts_external_scanner_state_copy(const ExternalScannerState *self) {
-  ExternalScannerState result = *self;
+void ts_external_scanner_state_delete(ExternalScannerState *self) {
   if (self->length > sizeof(self->short_data)) {
-    result.long_data = ts_malloc(self->length);
-    memcpy(result.long_data, self->long_data, self->length);
+    assert(self->long_data->ref_count > 0);
+    if (atomic_dec(&self->long_data->ref_count) == 0) {
+      ts_free(self->long_data);
+    }
   }
-  return result;
 }
 
-void ts_external_scanner_state_delete(ExternalScannerState *self) {
+const char *ts_external_scanner_state_data(const ExternalScannerState *self) {
   if (self->length > sizeof(self->short_data)) {
-    ts_free(self->long_data);
+    return (const char *)(self->long_data + 1);
+  } else {
+    return self->short_data;
   }
 }
 
-const char *ts_external_scanner_state_data(const ExternalScannerState *self) {
+uint32_t ts_external_scanner_state_hash(const ExternalScannerState *self) {
   if (self->length > sizeof(self->short_data)) {
-    return self->long_data;
+    return self->long_data->hash;
   } else {
-    return self->short_data;
+    return ts_external_scanner_state_hash_bytes(self->short_data, self->length);
   }
 }
 
@@ -63,6 +87,117 @@ bool ts_external_scanner_state_eq(const ExternalScannerState *self, const char *
     memcmp(ts_external_scanner_state_data(self), buffer, length) == 0;
 }
 
+// Long states that were interned by the same pool are equal only if they are
+// the same object, but states from different pools may still be equal, so
+// their bytes are compared when their hashes match.
+static bool ts_external_scanner_state__eq(const ExternalScannerState *self, const ExternalScannerState *other) {
+  if (self->length != other->length) return false;
+  if (self->length > sizeof(self->short_data)) {
+    if (self->long_data == other->long_data) return true;
+    if (self->long_data->hash != other->long_data->hash) return false;
+  }
+  return memcmp(
+    ts_external_scanner_state_data(self),
+    ts_external_scanner_state_data(other),
+    self->length
+  ) == 0;
+}
+
+// ExternalScannerStateTable
+
+static void ts_external_scanner_state_table__insert(
+  ExternalScannerStateTable *self,
+  ExternalScannerStateData *state
+) {
+  uint32_t mask = self->capacity - 1;
+  uint32_t index = state->hash & mask;
+  while (self->entries[index]) index = (index + 1) & mask;
+  self->entries[index] = state;
+  self->size++;
+}
+
+// Make room for one more entry. The states that are only referenced by the
+// table are removed first, and then the table is grown if it's still more
+// than half full.
+static void ts_external_scanner_state_table__reserve(ExternalScannerStateTable *self) {
+  if ((self->size + 1) * 4 <= self->capacity * 3) return;
+
+  ExternalScannerStateData **old_entries = self->entries;
+  uint32_t old_capacity = self->capacity;
+  uint32_t live_count = 0;
+  for (uint32_t i = 0; i < old_capacity; i++) {
+    ExternalScannerStateData *state = old_entries[i];
+    if (!state) continue;
+    if (state->ref_count == 1) {
+      ts_free(state);
+      old_entries[i] = NULL;
+    } else {
+      live_count++;
+    }
+  }
+
+  uint32_t capacity = old_capacity > 0 ? old_capacity : 16;
+  while ((live_count + 1) * 2 > capacity) capacity *= 2;
+  self->entries = ts_calloc_in(
+    TSAllocationCategorySubtreePool,
+    capacity,
+    sizeof(ExternalScannerStateData *)
+  );
+  self->capacity = capacity;
+  self->size = 0;
+  for (uint32_t i = 0; i < old_capacity; i++) {
+    if (old_entries[i]) ts_external_scanner_state_table__insert(self, old_entries[i]);
+  }
+  ts_free(old_entries);
+}
+
+static void ts_external_scanner_state_table__delete(ExternalScannerStateTable *self) {
+  for (uint32_t i = 0; i < self->capacity; i++) {
+    ExternalScannerStateData *state = self->entries[i];
+    if (state && atomic_dec(&state->ref_count) == 0) ts_free(state);
+  }
+  ts_free(self->entries);
+  self->entries = NULL;
+  self->size = 0;
+  self->capacity = 0;
+}
+
+// Find or create a state with the given bytes, and return a new reference
+// to it.
+static ExternalScannerStateData *ts_external_scanner_state_table__intern(
+  ExternalScannerStateTable *self,
+  const char *data,
+  unsigned length
+) {
+  uint32_t hash = ts_external_scanner_state_hash_bytes(data, length);
+  if (self->capacity > 0) {
+    uint32_t mask = self->capacity - 1;
+    for (uint32_t i = hash & mask; self->entries[i]; i = (i + 1) & mask) {
+      ExternalScannerStateData *state = self->entries[i];
+      if (
+        state->hash == hash &&
+        state->length == length &&
+        memcmp(state + 1, data, length) == 0
+      ) {
+        atomic_inc(&state->ref_count);
+        return state;
+      }
+    }
+  }
+
+  ts_external_scanner_state_table__reserve(self);
+  ExternalScannerStateData *state = ts_malloc_in(
+    TSAllocationCategorySubtreePool,
+    sizeof(ExternalScannerStateData) + length
+  );
+  state->ref_count = 2;
+  state->hash = hash;
+  state->length = length;
+  memcpy(state + 1, data, length);
+  ts_external_scanner_state_table__insert(self, state);
+  return state;
+}
+
 // SubtreeArray
 
 void ts_subtree_array_copy(SubtreeArray self, SubtreeArray *dest) {
@@ -119,8 +254,9 @@ void ts_subtree_array_reverse(SubtreeArray *self) {
 // SubtreePool
 
 SubtreePool ts_subtree_pool_new(uint32_t capacity) {
-  SubtreePool self = {array_new(), array_new()};
+  SubtreePool self = {array_new(), array_new(), NULL, {NULL, 0, 0}};
   array_reserve(&self.free_trees, capacity);
+  ts_set_allocation_category(self.free_trees.contents, TSAllocationCategorySubtreePool);
   return self;
 }
 
@@ -132,13 +268,18 @@ void ts_subtree_pool_delete(SubtreePool *self) {
     array_delete(&self->free_trees);
   }
   if (self->tree_stack.contents) array_delete(&self->tree_stack);
+  ts_external_scanner_state_table__delete(&self->scanner_states);
 }
 
+static void *ts_subtree_arena__allocate(SubtreeArena *self, size_t size);
+
 static SubtreeHeapData *ts_subtree_pool_allocate(SubtreePool *self) {
-  if (self->free_trees.size > 0) {
+  if (self->arena) {
+    return ts_subtree_arena__allocate(self->arena, sizeof(SubtreeHeapData));
+  } else if (self->free_trees.size > 0) {
     return array_pop(&self->free_trees).ptr;
   } else {
-    return ts_malloc(sizeof(SubtreeHeapData));
+    return ts_malloc_in(TSAllocationCategorySubtreePool, sizeof(SubtreeHeapData));
   }
 }
 
@@ -150,16 +291,190 @@ static void ts_subtree_pool_free(SubtreePool *self, SubtreeHeapData *tree) {
   }
 }
 
+// SubtreeArena
+
+SubtreeArena *ts_subtree_arena_new(SubtreeArena *parent) {
+  SubtreeArena *self = ts_malloc_in(TSAllocationCategorySubtreePool, sizeof(SubtreeArena));
+  self->ref_count = 1;
+  self->parent = parent;
+  self->slabs = NULL;
+  self->cursor = NULL;
+  self->end = NULL;
+  array_init(&self->foreign_trees);
+  array_init(&self->scanner_states);
+  if (parent) ts_subtree_arena_retain(parent);
+  return self;
+}
+
+void ts_subtree_arena_retain(SubtreeArena *self) {
+  assert(self->ref_count > 0);
+  atomic_inc(&self->ref_count);
+}
+
+// Release a reference to an arena. When the last reference goes away, all of
+// its nodes are freed at once, without visiting them individually.
+void ts_subtree_arena_release(SubtreeArena *self) {
+  while (self) {
+    assert(self->ref_count > 0);
+    if (atomic_dec(&self->ref_count) > 0) break;
+
+    if (self->foreign_trees.size > 0) {
+      SubtreePool pool = ts_subtree_pool_new(0);
+      ts_subtree_array_delete(&pool, &self->foreign_trees);
+      ts_subtree_pool_delete(&pool);
+    } else {
+      array_delete(&self->foreign_trees);
+    }
+    for (uint32_t i = 0; i < self->scanner_states.size; i++) {
+      ExternalScannerStateData *state = self->scanner_states.contents[i];
+      if (atomic_dec(&state->ref_count) == 0) ts_free(state);
+    }
+    array_delete(&self->scanner_states);
+
+    SubtreeArenaSlab *slab = self->slabs;
+    while (slab) {
+      SubtreeArenaSlab *next = slab->next;
+      ts_free(slab);
+      slab = next;
+    }
+
+    SubtreeArena *parent = self->parent;
+    ts_free(self);
+    self = parent;
+  }
+}
+
+static void *ts_subtree_arena__allocate(SubtreeArena *self, size_t size) {
+  size = (size + TS_ARENA_ALIGNMENT - 1) & ~(TS_ARENA_ALIGNMENT - 1);
+  if ((size_t)(self->end - self->cursor) < size) {
+    // Large allocations get a dedicated slab, so that the unused space at the
+    // end of the current slab is not wasted.
+    if (size > TS_ARENA_SLAB_SIZE / 4) {
+      SubtreeArenaSlab *slab = ts_malloc_in(TSAllocationCategorySubtreePool, sizeof(SubtreeArenaSlab) + size);
+      if (self->slabs) {
+        slab->next = self->slabs->next;
+        self->slabs->next = slab;
+      } else {
+        slab->next = NULL;
+        self->slabs = slab;
+      }
+      return slab + 1;
+    }
+
+    SubtreeArenaSlab *slab = ts_malloc_in(TSAllocationCategorySubtreePool, sizeof(SubtreeArenaSlab) + TS_ARENA_SLAB_SIZE);
+    slab->next = self->slabs;
+    self->slabs = slab;
+    self->cursor = (char *)(slab + 1);
+    self->end = self->cursor + TS_ARENA_SLAB_SIZE;
+  }
+
+  void *result = self->cursor;
+  self->cursor += size;
+  return result;
+}
+
+// Take ownership of the references that an arena-allocated node holds to
+// children that live outside of the arena. Because arena-allocated nodes are
+// never individually freed, these references are instead released along with
+// the arena.
+static void ts_subtree_arena__adopt_children(
+  SubtreeArena *self,
+  const Subtree *children,
+  uint32_t child_count
+) {
+  for (uint32_t i = 0; i < child_count; i++) {
+    Subtree child = children[i];
+    if (!child.data.is_inline && !child.ptr->in_arena) {
+      array_push(&self->foreign_trees, child);
+    }
+  }
+}
+
 // Subtree
 
-static inline bool ts_subtree_can_inline(Length padding, Length size, uint32_t lookahead_bytes) {
-  return
+// Store a leaf's symbol, parse state and lengths in an inline subtree, using
+// the narrow layout if they fit into it, and otherwise the wide layout. The
+// subtree's flags are left unchanged. This returns false if they don't fit
+// into either layout, in which case the subtree is also left unchanged.
+// Error leaves are never stored inline, because they also store the
+// character that caused the error.
+static inline bool ts_subtree__set_inline_fields(
+  MutableSubtree *self, TSSymbol symbol, TSStateId parse_state,
+  Length padding, Length size, uint32_t lookahead_bytes
+) {
+  if (size.extent.row != 0 || symbol == ts_builtin_sym_error) return false;
+
+  if (
+    symbol <= UINT8_MAX &&
     padding.bytes < TS_MAX_INLINE_TREE_LENGTH &&
     padding.extent.row < 16 &&
     padding.extent.column < TS_MAX_INLINE_TREE_LENGTH &&
-    size.extent.row == 0 &&
     size.extent.column < TS_MAX_INLINE_TREE_LENGTH &&
-    lookahead_bytes < 16;
+    lookahead_bytes < 16
+  ) {
+    self->data.is_wide = false;
+    self->data.symbol = symbol;
+    self->data.parse_state = parse_state;
+    self->data.padding_bytes = padding.bytes;
+    self->data.padding_rows = padding.extent.row;
+    self->data.padding_columns = padding.extent.column;
+    self->data.size_bytes = size.bytes;
+    self->data.lookahead_bytes = lookahead_bytes;
+    return true;
+  }
+
+  if (
+    padding.extent.row < TS_MAX_WIDE_INLINE_PADDING_ROWS &&
+    padding.extent.column <= UINT8_MAX &&
+    padding.bytes == padding.extent.row + padding.extent.column &&
+    size.extent.column < TS_MAX_WIDE_INLINE_SIZE &&
+    lookahead_bytes < TS_MAX_WIDE_INLINE_LOOKAHEAD_BYTES
+  ) {
+    self->wide_data.is_wide = true;
+    self->wide_data.symbol = symbol;
+    self->wide_data.parse_state = parse_state;
+    self->wide_data.padding_rows = padding.extent.row;
+    self->wide_data.padding_columns = padding.extent.column;
+    self->wide_data.size_bytes = size.bytes;
+    self->wide_data.lookahead_bytes = lookahead_bytes;
+    return true;
+  }
+
+  return false;
+}
+
+// Replace an inline subtree with an equivalent heap-allocated leaf, which
+// has the given lengths.
+static void ts_subtree__move_inline_to_heap(
+  SubtreePool *pool, MutableSubtree *self,
+  Length padding, Length size, uint32_t lookahead_bytes
+) {
+  Subtree tree = ts_subtree_from_mut(*self);
+  SubtreeHeapData *data = ts_subtree_pool_allocate(pool);
+  *data = (SubtreeHeapData) {
+    .ref_count = 1,
+    .padding = padding,
+    .size = size,
+    .lookahead_bytes = lookahead_bytes,
+    .error_cost = 0,
+    .child_count = 0,
+    .symbol = ts_subtree_symbol(tree),
+    .parse_state = ts_subtree_parse_state(tree),
+    .visible = tree.data.visible,
+    .named = tree.data.named,
+    .extra = tree.data.extra,
+    .fragile_left = false,
+    .fragile_right = false,
+    .has_changes = false,
+    .has_external_tokens = false,
+    .has_external_scanner_state_change = false,
+    .depends_on_column = false,
+    .is_missing = tree.data.is_missing,
+    .is_keyword = tree.data.is_keyword,
+    .in_arena = pool->arena != NULL,
+    {{.first_leaf = {.symbol = 0, .parse_state = 0}}}
+  };
+  self->ptr = data;
 }
 
 Subtree ts_subtree_new_leaf(
@@ -171,29 +486,21 @@ Subtree ts_subtree_new_leaf(
   TSSymbolMetadata metadata = ts_language_symbol_metadata(language, symbol);
   bool extra = symbol == ts_builtin_sym_end;
 
-  bool is_inline = (
-    symbol <= UINT8_MAX &&
-    !has_external_tokens &&
-    ts_subtree_can_inline(padding, size, lookahead_bytes)
-  );
+  MutableSubtree result = {.data = {
+    .visible = metadata.visible,
+    .named = metadata.named,
+    .extra = extra,
+    .has_changes = false,
+    .is_missing = false,
+    .is_keyword = is_keyword,
+    .is_inline = true,
+  }};
 
-  if (is_inline) {
-    return (Subtree) {{
-      .parse_state = parse_state,
-      .symbol = symbol,
-      .padding_bytes = padding.bytes,
-      .padding_rows = padding.extent.row,
-      .padding_columns = padding.extent.column,
-      .size_bytes = size.bytes,
-      .lookahead_bytes = lookahead_bytes,
-      .visible = metadata.visible,
-      .named = metadata.named,
-      .extra = extra,
-      .has_changes = false,
-      .is_missing = false,
-      .is_keyword = is_keyword,
-      .is_inline = true,
-    }};
+  if (
+    !has_external_tokens &&
+    ts_subtree__set_inline_fields(&result, symbol, parse_state, padding, size, lookahead_bytes)
+  ) {
+    return ts_subtree_from_mut(result);
   } else {
     SubtreeHeapData *data = ts_subtree_pool_allocate(pool);
     *data = (SubtreeHeapData) {
@@ -216,6 +523,7 @@ Subtree ts_subtree_new_leaf(
       .depends_on_column = depends_on_column,
       .is_missing = false,
       .is_keyword = is_keyword,
+      .in_arena = pool->arena != NULL,
       {{.first_leaf = {.symbol = 0, .parse_state = 0}}}
     };
     return (Subtree) {.ptr = data};
@@ -223,14 +531,24 @@ Subtree ts_subtree_new_leaf(
 }
 
 void ts_subtree_set_symbol(
+  SubtreePool *pool,
   MutableSubtree *self,
   TSSymbol symbol,
   const TSLanguage *language
 ) {
   TSSymbolMetadata metadata = ts_language_symbol_metadata(language, symbol);
   if (self->data.is_inline) {
-    assert(symbol < UINT8_MAX);
-    self->data.symbol = symbol;
+    Subtree tree = ts_subtree_from_mut(*self);
+    Length padding = ts_subtree_padding(tree);
+    Length size = ts_subtree_size(tree);
+    uint32_t lookahead_bytes = ts_subtree_lookahead_bytes(tree);
+    TSStateId parse_state = ts_subtree_parse_state(tree);
+    if (!ts_subtree__set_inline_fields(self, symbol, parse_state, padding, size, lookahead_bytes)) {
+      ts_subtree__move_inline_to_heap(pool, self, padding, size, lookahead_bytes);
+    }
+  }
+
+  if (self->data.is_inline) {
     self->data.named = metadata.named;
     self->data.visible = metadata.visible;
   } else {
@@ -255,39 +573,109 @@ Subtree ts_subtree_new_error(
   return result;
 }
 
+// Store the serialized state of an external scanner on a newly-created
+// external token. Long states are interned in the pool's table, so tokens
+// with the same state share one copy of it.
+void ts_subtree_set_external_scanner_state(
+  SubtreePool *pool,
+  MutableSubtree self,
+  const char *data,
+  unsigned length
+) {
+  ExternalScannerState *state = &self.ptr->external_scanner_state;
+  state->length = length;
+  if (length > sizeof(state->short_data)) {
+    state->long_data = ts_external_scanner_state_table__intern(&pool->scanner_states, data, length);
+    if (pool->arena) array_push(&pool->arena->scanner_states, state->long_data);
+  } else {
+    memcpy(state->short_data, data, length);
+  }
+}
+
 // Clone a subtree.
-MutableSubtree ts_subtree_clone(Subtree self) {
+MutableSubtree ts_subtree_clone(SubtreePool *pool, Subtree self) {
   size_t alloc_size = ts_subtree_alloc_size(self.ptr->child_count);
-  Subtree *new_children = ts_malloc(alloc_size);
+  Subtree *new_children = pool->arena
+    ? ts_subtree_arena__allocate(pool->arena, alloc_size)
+    : ts_malloc_in(TSAllocationCategorySubtreePool, alloc_size);
   Subtree *old_children = ts_subtree_children(self);
   memcpy(new_children, old_children, alloc_size);
-  SubtreeHeapData *result = (SubtreeHeapData *)&new_children[self.ptr->child_count];
+  MutableSubtree result = {.ptr = (SubtreeHeapData *)&new_children[self.ptr->child_count]};
   if (self.ptr->child_count > 0) {
     for (uint32_t i = 0; i < self.ptr->child_count; i++) {
       ts_subtree_retain(new_children[i]);
     }
+    if (pool->arena) {
+      ts_subtree_arena__adopt_children(pool->arena, new_children, self.ptr->child_count);
+    }
   } else if (self.ptr->has_external_tokens) {
-    result->external_scanner_state = ts_external_scanner_state_copy(
-      &self.ptr->external_scanner_state
-    );
+    const ExternalScannerState *state = &self.ptr->external_scanner_state;
+    if (state->length > sizeof(state->short_data)) {
+      atomic_inc(&state->long_data->ref_count);
+      if (pool->arena) array_push(&pool->arena->scanner_states, state->long_data);
+    }
   }
-  result->ref_count = 1;
-  return (MutableSubtree) {.ptr = result};
+  result.ptr->ref_count = 1;
+  result.ptr->in_arena = pool->arena != NULL;
+  return result;
 }
 
 // Get mutable version of a subtree.
 //
 // This takes ownership of the subtree. If the subtree has only one owner,
 // this will directly convert it into a mutable version. Otherwise, it will
-// perform a copy.
+// perform a copy. Subtrees that live in an arena are only mutated in place
+// while their own parse is still in progress.
 MutableSubtree ts_subtree_make_mut(SubtreePool *pool, Subtree self) {
   if (self.data.is_inline) return (MutableSubtree) {self.data};
-  if (self.ptr->ref_count == 1) return ts_subtree_to_mut_unsafe(self);
-  MutableSubtree result = ts_subtree_clone(self);
+  if (self.ptr->ref_count == 1 && (!self.ptr->in_arena || pool->arena)) {
+    return ts_subtree_to_mut_unsafe(self);
+  }
+  MutableSubtree result = ts_subtree_clone(pool, self);
   ts_subtree_release(pool, self);
   return result;
 }
 
+// Copy a subtree and all of its descendants into the pool's arena. The nodes
+// are allocated in preorder, so that walking the copy visits its memory in
+// order. The original subtree is left unchanged.
+Subtree ts_subtree_copy_into_arena(SubtreePool *pool, Subtree self) {
+  assert(pool->arena);
+  Subtree result = self;
+  if (self.data.is_inline) return result;
+
+  // Each entry is a slot that still holds an original subtree, which is
+  // replaced with its copy when the entry is popped.
+  Array(Subtree *) slots = array_new();
+  array_push(&slots, &result);
+  while (slots.size > 0) {
+    Subtree *slot = array_pop(&slots);
+    uint32_t child_count = slot->ptr->child_count;
+    size_t alloc_size = ts_subtree_alloc_size(child_count);
+    Subtree *contents = ts_subtree_arena__allocate(pool->arena, alloc_size);
+    memcpy(contents, (const Subtree *)slot->ptr - child_count, alloc_size);
+
+    SubtreeHeapData *data = (SubtreeHeapData *)&contents[child_count];
+    data->ref_count = 1;
+    data->in_arena = true;
+    if (child_count == 0 && data->has_external_tokens) {
+      ExternalScannerState *state = &data->external_scanner_state;
+      if (state->length > sizeof(state->short_data)) {
+        atomic_inc(&state->long_data->ref_count);
+        array_push(&pool->arena->scanner_states, state->long_data);
+      }
+    }
+    *slot = (Subtree) {.ptr = data};
+
+    for (uint32_t i = child_count; i > 0; i--) {
+      if (!contents[i - 1].data.is_inline) array_push(&slots, &contents[i - 1]);
+    }
+  }
+
+  array_delete(&slots);
+  return result;
+}
+
 static void ts_subtree__compress(
   MutableSubtree self,
   unsigned count,
@@ -306,7 +694,8 @@ static void ts_subtree__compress(
       child.data.is_inline ||
       child.ptr->child_count < 2 ||
       child.ptr->ref_count > 1 ||
-      child.ptr->symbol != symbol
+      child.ptr->symbol != symbol ||
+      child.ptr->in_arena != tree.ptr->in_arena
     ) break;
 
     MutableSubtree grandchild = ts_subtree_to_mut_unsafe(ts_subtree_children(child)[0]);
@@ -314,12 +703,25 @@ static void ts_subtree__compress(
       grandchild.data.is_inline ||
       grandchild.ptr->child_count < 2 ||
       grandchild.ptr->ref_count > 1 ||
-      grandchild.ptr->symbol != symbol
+      grandchild.ptr->symbol != symbol ||
+      grandchild.ptr->in_arena != tree.ptr->in_arena
     ) break;
 
     ts_subtree_children(tree)[0] = ts_subtree_from_mut(grandchild);
     ts_subtree_children(child)[0] = ts_subtree_children(grandchild)[grandchild.ptr->child_count - 1];
     ts_subtree_children(grandchild)[grandchild.ptr->child_count - 1] = ts_subtree_from_mut(child);
+
+    // The child now starts where its new first child starts. If that is
+    // another repetition, then the child is still a valid repetition, which
+    // would be parsed in that child's state. Otherwise, it was split from
+    // the middle of a single element, and it must never be reused.
+    Subtree new_first_child = ts_subtree_children(child)[0];
+    if (ts_subtree_symbol(new_first_child) == symbol) {
+      child.ptr->parse_state = ts_subtree_parse_state(new_first_child);
+    } else {
+      child.ptr->fragile_left = true;
+      child.ptr->fragile_right = true;
+    }
     array_push(stack, tree);
     tree = grandchild;
   }
@@ -366,6 +768,242 @@ void ts_subtree_balance(Subtree self, SubtreePool *pool, const TSLanguage *langu
   }
 }
 
+// Check if a subtree is a repetition node that joins two smaller repetitions,
+// and that can be replaced with an equivalent one.
+static inline bool ts_subtree__is_rebuildable_repetition(Subtree self) {
+  return
+    !self.data.is_inline &&
+    self.ptr->repeat_depth > 0 &&
+    self.ptr->child_count == 2 &&
+    self.ptr->ref_count == 1 &&
+    !self.ptr->fragile_left &&
+    !self.ptr->fragile_right &&
+    !self.ptr->has_changes &&
+    ts_subtree_symbol(ts_subtree_children(self)[1]) == self.ptr->symbol;
+}
+
+// Rebuild each chain of repetition nodes within a subtree as a balanced tree,
+// if it is much deeper than that.
+//
+// `ts_subtree_balance` only rotates the left spine of each repetition, which
+// balances the chains that the parser builds, but when a tree is edited and
+// reparsed many times, its chains can take any shape. This instead gathers
+// all of the elements of a chain, and joins them in pairs with new nodes. The
+// subtree and its descendants must be in the pool's arena, and only owned by
+// their parents. The old repetition nodes are left in the arena. Returns true
+// if any chain was rebuilt.
+bool ts_subtree_rebuild_repetitions(Subtree self, SubtreePool *pool, const TSLanguage *language) {
+  typedef struct {
+    Subtree tree;
+    unsigned depth;
+  } ChainEntry;
+
+  assert(pool->arena);
+  bool did_rebuild = false;
+  Array(ChainEntry) chain = array_new();
+  SubtreeArray elements = array_new();
+  array_clear(&pool->tree_stack);
+
+  if (ts_subtree_child_count(self) > 0 && self.ptr->ref_count == 1) {
+    array_push(&pool->tree_stack, ts_subtree_to_mut_unsafe(self));
+  }
+
+  while (pool->tree_stack.size > 0) {
+    MutableSubtree tree = array_pop(&pool->tree_stack);
+    bool did_rebuild_child = false;
+
+    for (uint32_t i = 0; i < tree.ptr->child_count; i++) {
+      Subtree *child = &ts_subtree_children(tree)[i];
+      if (!ts_subtree__is_rebuildable_repetition(*child)) {
+        if (ts_subtree_child_count(*child) > 0 && child->ptr->ref_count == 1) {
+          array_push(&pool->tree_stack, ts_subtree_to_mut_unsafe(*child));
+        }
+        continue;
+      }
+
+      // Gather the elements of the chain from left to right, and visit them
+      // later, because their positions within the tree don't matter.
+      TSSymbol symbol = child->ptr->symbol;
+      unsigned depth = 0;
+      array_clear(&elements);
+      array_push(&chain, ((ChainEntry) {*child, 0}));
+      while (chain.size > 0) {
+        ChainEntry entry = array_pop(&chain);
+        if (ts_subtree__is_rebuildable_repetition(entry.tree) && entry.tree.ptr->symbol == symbol) {
+          const Subtree *pair = ts_subtree_children(entry.tree);
+          array_push(&chain, ((ChainEntry) {pair[1], entry.depth + 1}));
+          array_push(&chain, ((ChainEntry) {pair[0], entry.depth + 1}));
+          if (entry.depth + 1 > depth) depth = entry.depth + 1;
+        } else {
+          array_push(&elements, entry.tree);
+          if (ts_subtree_child_count(entry.tree) > 0 && entry.tree.ptr->ref_count == 1) {
+            array_push(&pool->tree_stack, ts_subtree_to_mut_unsafe(entry.tree));
+          }
+        }
+      }
+
+      unsigned balanced_depth = 0;
+      while ((1u << balanced_depth) < elements.size) balanced_depth++;
+      if (depth <= 2 * balanced_depth) continue;
+
+      // Join adjacent pairs of elements, and then adjacent pairs of those
+      // nodes, until only one is left. Each new node is parsed in the same
+      // state as its first element.
+      unsigned production_id = child->ptr->production_id;
+      for (uint32_t count = elements.size; count > 1; count = (count + 1) / 2) {
+        for (uint32_t j = 0; j < count; j += 2) {
+          if (j + 1 == count) {
+            elements.contents[j / 2] = elements.contents[j];
+            break;
+          }
+          SubtreeArray pair = array_new();
+          array_push(&pair, elements.contents[j]);
+          array_push(&pair, elements.contents[j + 1]);
+          MutableSubtree node = ts_subtree_new_node(pool, symbol, &pair, production_id, language);
+          if (node.ptr->parse_state != TS_TREE_STATE_NONE) {
+            node.ptr->parse_state = ts_subtree_parse_state(ts_subtree_children(node)[0]);
+          }
+          elements.contents[j / 2] = ts_subtree_from_mut(node);
+        }
+      }
+      *child = elements.contents[0];
+      did_rebuild_child = true;
+    }
+
+    if (did_rebuild_child) {
+      ts_subtree_summarize_children(tree, language);
+      did_rebuild = true;
+    }
+  }
+
+  array_delete(&chain);
+  array_delete(&elements);
+  return did_rebuild;
+}
+
+// The hashes of the visible nodes within a subtree are combined as the
+// coefficients of a polynomial in this base. Appending a sequence of `n` hashes
+// multiplies the combined hash by the base to the power of `n`, so a hidden
+// node's children can be appended all at once.
+#define TS_SUBTREE_HASH_BASE 0x9e3779b97f4a7c15ull
+
+static inline uint64_t ts_subtree__hash_mix(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+static inline uint64_t ts_subtree__hash_base_power(uint32_t exponent) {
+  uint64_t result = 1;
+  uint64_t base = TS_SUBTREE_HASH_BASE;
+  while (exponent > 0) {
+    if (exponent & 1) result *= base;
+    base *= base;
+    exponent >>= 1;
+  }
+  return result;
+}
+
+static uint64_t ts_subtree__children_hash(Subtree self, const TSLanguage *language);
+
+// Hash a subtree as a visible node with the given public symbol.
+//
+// The hash depends on the node's symbol, and on the symbols and the order of
+// its visible descendants, with the byte length of each one that has no
+// visible children, but not on its position, on the text between those
+// nodes, or on the structure of its hidden descendants.
+uint64_t ts_subtree_hash(Subtree self, TSSymbol symbol, const TSLanguage *language) {
+  if (ts_subtree_visible_child_count(self) == 0) {
+    return ts_subtree__hash_mix(
+      symbol |
+      (uint64_t)ts_subtree_size(self).bytes << 16 |
+      (uint64_t)ts_subtree_missing(self) << 48
+    );
+  }
+  return ts_subtree__hash_mix(
+    (symbol | (uint64_t)self.ptr->visible_child_count << 16 | 1ull << 63) * TS_SUBTREE_HASH_BASE ^
+    ts_subtree__children_hash(self, language)
+  );
+}
+
+// Whether the hash of a node's children is already known, either because it
+// has no visible children or because the hash has been computed.
+static inline bool ts_subtree__has_children_hash(Subtree self) {
+  return
+    ts_subtree_visible_child_count(self) == 0 ||
+    atomic_load_u64(&self.ptr->children_hash) != 0;
+}
+
+// Combine the hashes of a node's children. The hashes of the children's own
+// children must already be known.
+static uint64_t ts_subtree__combine_children_hashes(Subtree self, const TSLanguage *language) {
+  uint64_t hash = 0;
+  uint32_t structural_index = 0;
+  const TSSymbol *alias_sequence = ts_language_alias_sequence(language, self.ptr->production_id);
+  const Subtree *children = ts_subtree_children(self);
+  for (uint32_t i = 0; i < self.ptr->child_count; i++) {
+    Subtree child = children[i];
+    if (alias_sequence && alias_sequence[structural_index] != 0 && !ts_subtree_extra(child)) {
+      TSSymbol symbol = ts_language_public_symbol(language, alias_sequence[structural_index]);
+      hash = hash * TS_SUBTREE_HASH_BASE + ts_subtree_hash(child, symbol, language);
+    } else if (ts_subtree_visible(child)) {
+      TSSymbol symbol = ts_language_public_symbol(language, ts_subtree_symbol(child));
+      hash = hash * TS_SUBTREE_HASH_BASE + ts_subtree_hash(child, symbol, language);
+    } else if (ts_subtree_visible_child_count(child) > 0) {
+      // A repetition's first child is often much larger than the rest, so avoid
+      // computing the power when it wouldn't change the result.
+      if (hash != 0) hash *= ts_subtree__hash_base_power(child.ptr->visible_child_count);
+      hash += atomic_load_u64(&child.ptr->children_hash);
+    }
+    if (!ts_subtree_extra(child)) structural_index++;
+  }
+
+  // Zero marks a hash that hasn't been computed yet.
+  return hash != 0 ? hash : 1;
+}
+
+// Get the hash of a node's children, computing it on first use.
+//
+// The hashes aren't computed during parsing, so that parsing doesn't pay
+// for them. Instead, the hashes that are missing below the node are computed
+// in post-order, using an explicit stack because trees can be very deep.
+// Subtrees are shared between trees, which may be used from different threads,
+// so the hashes are stored atomically. Two threads may both compute the same
+// hash, but they always store the same value.
+static uint64_t ts_subtree__children_hash(Subtree self, const TSLanguage *language) {
+  uint64_t hash = atomic_load_u64(&self.ptr->children_hash);
+  if (hash != 0) return hash;
+
+  Array(Subtree) stack = array_new();
+  array_push(&stack, self);
+  while (stack.size > 0) {
+    Subtree tree = *array_back(&stack);
+    bool is_ready = true;
+    const Subtree *children = ts_subtree_children(tree);
+    for (uint32_t i = 0; i < tree.ptr->child_count; i++) {
+      if (!ts_subtree__has_children_hash(children[i])) {
+        array_push(&stack, children[i]);
+        is_ready = false;
+      }
+    }
+    if (is_ready) {
+      stack.size--;
+      if (!ts_subtree__has_children_hash(tree)) {
+        atomic_store_u64(
+          &((SubtreeHeapData *)tree.ptr)->children_hash,
+          ts_subtree__combine_children_hashes(tree, language)
+        );
+      }
+    }
+  }
+  array_delete(&stack);
+
+  return atomic_load_u64(&self.ptr->children_hash);
+}
+
 // Assign all of the node's properties that depend on its children.
 void ts_subtree_summarize_children(
   MutableSubtree self,
@@ -378,6 +1016,8 @@ void ts_subtree_summarize_children(
   self.ptr->error_cost = 0;
   self.ptr->repeat_depth = 0;
   self.ptr->visible_descendant_count = 0;
+  self.ptr->descendant_count = 0;
+  self.ptr->heap_descendant_count = 0;
   self.ptr->has_external_tokens = false;
   self.ptr->depends_on_column = false;
   self.ptr->has_external_scanner_state_change = false;
@@ -437,11 +1077,16 @@ void ts_subtree_summarize_children(
 
     self.ptr->dynamic_precedence += ts_subtree_dynamic_precedence(child);
     self.ptr->visible_descendant_count += ts_subtree_visible_descendant_count(child);
+    self.ptr->descendant_count += 1 + ts_subtree_descendant_count(child);
+    if (!child.data.is_inline) {
+      self.ptr->heap_descendant_count += 1 + ts_subtree_heap_descendant_count(child);
+    }
 
     if (alias_sequence && alias_sequence[structural_index] != 0 && !ts_subtree_extra(child)) {
+      TSSymbol alias = alias_sequence[structural_index];
       self.ptr->visible_descendant_count++;
       self.ptr->visible_child_count++;
-      if (ts_language_symbol_metadata(language, alias_sequence[structural_index]).named) {
+      if (ts_language_symbol_metadata(language, alias).named) {
         self.ptr->named_child_count++;
       }
     } else if (ts_subtree_visible(child)) {
@@ -464,6 +1109,7 @@ void ts_subtree_summarize_children(
   }
 
   self.ptr->lookahead_bytes = lookahead_end_byte - self.ptr->size.bytes - self.ptr->padding.bytes;
+  self.ptr->children_hash = 0;
 
   if (
     self.ptr->symbol == ts_builtin_sym_error ||
@@ -502,8 +1148,11 @@ void ts_subtree_summarize_children(
 
 // Create a new parent node with the given children.
 //
-// This takes ownership of the children array.
+// This takes ownership of the children array. If the pool has an arena, the
+// children are copied into the arena and the array is freed. Otherwise, or if
+// no pool is given, the node's data is stored at the end of the array itself.
 MutableSubtree ts_subtree_new_node(
+  SubtreePool *pool,
   TSSymbol symbol,
   SubtreeArray *children,
   unsigned production_id,
@@ -511,19 +1160,34 @@ MutableSubtree ts_subtree_new_node(
 ) {
   TSSymbolMetadata metadata = ts_language_symbol_metadata(language, symbol);
   bool fragile = symbol == ts_builtin_sym_error || symbol == ts_builtin_sym_error_repeat;
+  uint32_t child_count = children->size;
+  SubtreeArena *arena = pool ? pool->arena : NULL;
 
   // Allocate the node's data at the end of the array of children.
-  size_t new_byte_size = ts_subtree_alloc_size(children->size);
-  if (children->capacity * sizeof(Subtree) < new_byte_size) {
-    children->contents = ts_realloc(children->contents, new_byte_size);
-    children->capacity = (uint32_t)(new_byte_size / sizeof(Subtree));
+  size_t new_byte_size = ts_subtree_alloc_size(child_count);
+  Subtree *contents;
+  if (arena) {
+    contents = ts_subtree_arena__allocate(arena, new_byte_size);
+    if (child_count > 0) {
+      memcpy(contents, children->contents, child_count * sizeof(Subtree));
+      ts_subtree_arena__adopt_children(arena, contents, child_count);
+    }
+    array_delete(children);
+  } else {
+    if (children->capacity * sizeof(Subtree) < new_byte_size) {
+      children->contents = ts_realloc_in(TSAllocationCategorySubtreePool, children->contents, new_byte_size);
+      children->capacity = (uint32_t)(new_byte_size / sizeof(Subtree));
+    } else {
+      ts_set_allocation_category(children->contents, TSAllocationCategorySubtreePool);
+    }
+    contents = children->contents;
   }
-  SubtreeHeapData *data = (SubtreeHeapData *)&children->contents[children->size];
+  SubtreeHeapData *data = (SubtreeHeapData *)&contents[child_count];
 
   *data = (SubtreeHeapData) {
     .ref_count = 1,
     .symbol = symbol,
-    .child_count = children->size,
+    .child_count = child_count,
     .visible = metadata.visible,
     .named = metadata.named,
     .has_changes = false,
@@ -531,6 +1195,7 @@ MutableSubtree ts_subtree_new_node(
     .fragile_left = fragile,
     .fragile_right = fragile,
     .is_keyword = false,
+    .in_arena = arena != NULL,
     {{
       .visible_descendant_count = 0,
       .production_id = production_id,
@@ -547,12 +1212,13 @@ MutableSubtree ts_subtree_new_node(
 // This node is treated as 'extra'. Its children are prevented from having
 // having any effect on the parse state.
 Subtree ts_subtree_new_error_node(
+  SubtreePool *pool,
   SubtreeArray *children,
   bool extra,
   const TSLanguage *language
 ) {
   MutableSubtree result = ts_subtree_new_node(
-    ts_builtin_sym_error, children, 0, language
+    pool, ts_builtin_sym_error, children, 0, language
   );
   result.ptr->extra = extra;
   return ts_subtree_from_mut(result);
@@ -581,6 +1247,37 @@ Subtree ts_subtree_new_missing_leaf(
   return result;
 }
 
+// Create an invisible leaf that takes the place of the given subtree, so that
+// the subtree can be freed without changing the positions of the nodes after
+// it.
+//
+// The leaf is marked as changed, so that it is never reused.
+Subtree ts_subtree_new_placeholder(
+  SubtreePool *pool,
+  Subtree original,
+  const TSLanguage *language
+) {
+  Subtree result = ts_subtree_new_leaf(
+    pool, ts_subtree_symbol(original), ts_subtree_padding(original),
+    ts_subtree_size(original), ts_subtree_lookahead_bytes(original),
+    ts_subtree_parse_state(original), false,
+    ts_subtree_depends_on_column(original), false, language
+  );
+  if (result.data.is_inline) {
+    result.data.visible = false;
+    result.data.named = false;
+    result.data.extra = ts_subtree_extra(original);
+    result.data.has_changes = true;
+  } else {
+    SubtreeHeapData *data = (SubtreeHeapData *)result.ptr;
+    data->visible = false;
+    data->named = false;
+    data->extra = ts_subtree_extra(original);
+    data->has_changes = true;
+  }
+  return result;
+}
+
 void ts_subtree_retain(Subtree self) {
   if (self.data.is_inline) return;
   assert(self.ptr->ref_count > 0);
@@ -597,20 +1294,24 @@ void ts_subtree_release(SubtreePool *pool, Subtree self) {
     array_push(&pool->tree_stack, ts_subtree_to_mut_unsafe(self));
   }
 
+  // Nodes that live in an arena are not freed here. Their references to
+  // children outside of the arena are owned by the arena itself.
   while (pool->tree_stack.size > 0) {
     MutableSubtree tree = array_pop(&pool->tree_stack);
+    bool in_arena = tree.ptr->in_arena;
     if (tree.ptr->child_count > 0) {
       Subtree *children = ts_subtree_children(tree);
       for (uint32_t i = 0; i < tree.ptr->child_count; i++) {
         Subtree child = children[i];
         if (child.data.is_inline) continue;
+        if (in_arena && !child.ptr->in_arena) continue;
         assert(child.ptr->ref_count > 0);
         if (atomic_dec((volatile uint32_t *)&child.ptr->ref_count) == 0) {
           array_push(&pool->tree_stack, ts_subtree_to_mut_unsafe(child));
         }
       }
-      ts_free(children);
-    } else {
+      if (!in_arena) ts_free(children);
+    } else if (!in_arena) {
       if (tree.ptr->has_external_tokens) {
         ts_external_scanner_state_delete(&tree.ptr->external_scanner_state);
       }
@@ -619,6 +1320,94 @@ void ts_subtree_release(SubtreePool *pool, Subtree self) {
   }
 }
 
+typedef struct {
+  Subtree tree;
+  bool is_shared;
+} MemoryUsageEntry;
+
+typedef struct {
+  const ExternalScannerStateData *state;
+  bool is_shared;
+} MemoryUsageScannerState;
+
+static int ts_subtree__compare_scanner_states(const void *left, const void *right) {
+  uintptr_t a = (uintptr_t)((const MemoryUsageScannerState *)left)->state;
+  uintptr_t b = (uintptr_t)((const MemoryUsageScannerState *)right)->state;
+  return a < b ? -1 : a > b ? 1 : 0;
+}
+
+// Add up the memory used by the nodes of a subtree by visiting each of them.
+// A node is shared if anything besides its parent refers to it, and then so
+// are all of its descendants. A long external scanner state may be referenced
+// by several tokens, so it is counted once, and it is shared if anything
+// besides the tokens of this subtree refers to it.
+void ts_subtree_memory_usage(Subtree self, TSMemoryReport *report) {
+  Array(MemoryUsageEntry) stack = array_new();
+  Array(MemoryUsageScannerState) scanner_states = array_new();
+
+  array_push(&stack, ((MemoryUsageEntry) {self, false}));
+  while (stack.size > 0) {
+    MemoryUsageEntry entry = array_pop(&stack);
+    Subtree tree = entry.tree;
+    if (tree.data.is_inline) {
+      report->inline_node_count++;
+      continue;
+    }
+
+    bool is_shared = entry.is_shared || tree.ptr->ref_count > 1;
+    size_t bytes = ts_subtree_alloc_size(tree.ptr->child_count);
+    if (is_shared) {
+      report->shared_bytes += bytes;
+    } else {
+      report->exclusive_bytes += bytes;
+    }
+    report->heap_node_count++;
+
+    if (tree.ptr->child_count > 0) {
+      const Subtree *children = ts_subtree_children(tree);
+      for (uint32_t i = 0; i < tree.ptr->child_count; i++) {
+        array_push(&stack, ((MemoryUsageEntry) {children[i], is_shared}));
+      }
+    } else if (
+      tree.ptr->has_external_tokens &&
+      tree.ptr->external_scanner_state.length > sizeof(tree.ptr->external_scanner_state.short_data)
+    ) {
+      array_push(&scanner_states, ((MemoryUsageScannerState) {
+        tree.ptr->external_scanner_state.long_data,
+        is_shared,
+      }));
+    }
+  }
+
+  if (scanner_states.size > 1) {
+    qsort(
+      scanner_states.contents,
+      scanner_states.size,
+      sizeof(MemoryUsageScannerState),
+      ts_subtree__compare_scanner_states
+    );
+  }
+  for (uint32_t i = 0, j; i < scanner_states.size; i = j) {
+    const ExternalScannerStateData *state = scanner_states.contents[i].state;
+    bool is_shared = false;
+    for (j = i; j < scanner_states.size && scanner_states.contents[j].state == state; j++) {
+      if (scanner_states.contents[j].is_shared) is_shared = true;
+    }
+    if (state->ref_count > j - i) is_shared = true;
+
+    size_t bytes = sizeof(ExternalScannerStateData) + state->length;
+    if (is_shared) {
+      report->shared_bytes += bytes;
+    } else {
+      report->exclusive_bytes += bytes;
+    }
+    report->scanner_state_bytes += bytes;
+  }
+
+  array_delete(&scanner_states);
+  array_delete(&stack);
+}
+
 int ts_subtree_compare(Subtree left, Subtree right, SubtreePool *pool) {
   array_push(&pool->tree_stack, ts_subtree_to_mut_unsafe(left));
   array_push(&pool->tree_stack, ts_subtree_to_mut_unsafe(right));
@@ -719,36 +1508,20 @@ Subtree ts_subtree_edit(Subtree self, const TSInputEdit *input_edit, SubtreePool
     MutableSubtree result = ts_subtree_make_mut(pool, *entry.tree);
 
     if (result.data.is_inline) {
-      if (ts_subtree_can_inline(padding, size, lookahead_bytes)) {
-        result.data.padding_bytes = padding.bytes;
-        result.data.padding_rows = padding.extent.row;
-        result.data.padding_columns = padding.extent.column;
-        result.data.size_bytes = size.bytes;
-      } else {
-        SubtreeHeapData *data = ts_subtree_pool_allocate(pool);
-        data->ref_count = 1;
-        data->padding = padding;
-        data->size = size;
-        data->lookahead_bytes = lookahead_bytes;
-        data->error_cost = 0;
-        data->child_count = 0;
-        data->symbol = result.data.symbol;
-        data->parse_state = result.data.parse_state;
-        data->visible = result.data.visible;
-        data->named = result.data.named;
-        data->extra = result.data.extra;
-        data->fragile_left = false;
-        data->fragile_right = false;
-        data->has_changes = false;
-        data->has_external_tokens = false;
-        data->depends_on_column = false;
-        data->is_missing = result.data.is_missing;
-        data->is_keyword = result.data.is_keyword;
-        result.ptr = data;
+      Subtree tree = ts_subtree_from_mut(result);
+      if (!ts_subtree__set_inline_fields(
+        &result, ts_subtree_symbol(tree), ts_subtree_parse_state(tree),
+        padding, size, lookahead_bytes
+      )) {
+        ts_subtree__move_inline_to_heap(pool, &result, padding, size, lookahead_bytes);
       }
     } else {
       result.ptr->padding = padding;
       result.ptr->size = size;
+
+      // The lengths of the node's descendants may change, so its hash must be
+      // computed again.
+      if (result.ptr->child_count > 0) result.ptr->children_hash = 0;
     }
 
     ts_subtree_set_has_changes(&result);
@@ -1052,9 +1825,447 @@ const ExternalScannerState *ts_subtree_external_scanner_state(Subtree self) {
 bool ts_subtree_external_scanner_state_eq(Subtree self, Subtree other) {
   const ExternalScannerState *state_self = ts_subtree_external_scanner_state(self);
   const ExternalScannerState *state_other = ts_subtree_external_scanner_state(other);
-  return ts_external_scanner_state_eq(
-    state_self,
-    ts_external_scanner_state_data(state_other),
-    state_other->length
+  return ts_external_scanner_state__eq(state_self, state_other);
+}
+
+// Serialization
+//
+// A subtree is serialized as a count of nodes, followed by the nodes in
+// post-order, so that every node's children have already been read by the
+// time the node itself is read. Each node begins with a tag byte that says
+// whether it is an inline subtree, in either layout, or a heap-allocated one.
+// Most numbers are
+// small, so they are stored as variable-length integers, seven bits per byte.
+
+#define TS_SERIALIZED_INLINE_TAG 0
+#define TS_SERIALIZED_HEAP_TAG 1
+#define TS_SERIALIZED_WIDE_INLINE_TAG 2
+
+typedef struct {
+  Subtree tree;
+  uint32_t child_index;
+} SubtreeSerializationEntry;
+
+static inline void ts_subtree__write(SubtreeByteArray *buffer, const void *value, size_t size) {
+  array_grow_by(buffer, (uint32_t)size);
+  memcpy(&buffer->contents[buffer->size - size], value, size);
+}
+
+static inline void ts_subtree__write_varint(SubtreeByteArray *buffer, uint32_t value) {
+  uint8_t bytes[5];
+  size_t length = 0;
+  while (value >= 0x80) {
+    bytes[length++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  bytes[length++] = (uint8_t)value;
+  ts_subtree__write(buffer, bytes, length);
+}
+
+// Signed numbers are zig-zag encoded, so that small negative numbers are short.
+static inline void ts_subtree__write_signed_varint(SubtreeByteArray *buffer, int32_t value) {
+  ts_subtree__write_varint(buffer, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+static inline void ts_subtree__write_length(SubtreeByteArray *buffer, Length length) {
+  ts_subtree__write_varint(buffer, length.bytes);
+  ts_subtree__write_varint(buffer, length.extent.row);
+  ts_subtree__write_varint(buffer, length.extent.column);
+}
+
+static inline bool ts_subtree__read(const char **data, const char *end, void *value, size_t size) {
+  if ((size_t)(end - *data) < size) return false;
+  memcpy(value, *data, size);
+  *data += size;
+  return true;
+}
+
+static inline bool ts_subtree__read_varint(const char **data, const char *end, uint32_t *value) {
+  uint32_t result = 0;
+  for (unsigned shift = 0; shift < 35; shift += 7) {
+    if (*data == end) return false;
+    uint8_t byte = (uint8_t)*(*data)++;
+    if (shift == 28 && byte > 0x0f) return false;
+    result |= (uint32_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+static inline bool ts_subtree__read_short_varint(const char **data, const char *end, uint16_t *value) {
+  uint32_t result;
+  if (!ts_subtree__read_varint(data, end, &result) || result > UINT16_MAX) return false;
+  *value = (uint16_t)result;
+  return true;
+}
+
+static inline bool ts_subtree__read_signed_varint(const char **data, const char *end, int32_t *value) {
+  uint32_t result;
+  if (!ts_subtree__read_varint(data, end, &result)) return false;
+  *value = (int32_t)(result >> 1) ^ -(int32_t)(result & 1);
+  return true;
+}
+
+static inline bool ts_subtree__read_length(const char **data, const char *end, Length *length) {
+  return
+    ts_subtree__read_varint(data, end, &length->bytes) &&
+    ts_subtree__read_varint(data, end, &length->extent.row) &&
+    ts_subtree__read_varint(data, end, &length->extent.column);
+}
+
+static inline bool ts_subtree__is_valid_symbol(TSSymbol symbol, const TSLanguage *language) {
+  return
+    symbol < ts_language_symbol_count(language) ||
+    symbol == ts_builtin_sym_error ||
+    symbol == ts_builtin_sym_error_repeat;
+}
+
+static inline bool ts_subtree__is_valid_state(TSStateId state, const TSLanguage *language) {
+  return state < language->state_count || state == TS_TREE_STATE_NONE;
+}
+
+static void ts_subtree__serialize_node(Subtree self, SubtreeByteArray *buffer) {
+  if (self.data.is_inline && self.data.is_wide) {
+    uint8_t fields[2] = {
+      TS_SERIALIZED_WIDE_INLINE_TAG,
+      self.data.visible |
+        self.data.named << 1 |
+        self.data.extra << 2 |
+        self.data.has_changes << 3 |
+        self.data.is_missing << 4 |
+        self.data.is_keyword << 5,
+    };
+    ts_subtree__write(buffer, fields, sizeof(fields));
+    ts_subtree__write_varint(buffer, self.wide_data.symbol);
+    ts_subtree__write_varint(buffer, self.wide_data.parse_state);
+    ts_subtree__write_varint(buffer, self.wide_data.padding_rows);
+    ts_subtree__write_varint(buffer, self.wide_data.padding_columns);
+    ts_subtree__write_varint(buffer, self.wide_data.size_bytes);
+    ts_subtree__write_varint(buffer, self.wide_data.lookahead_bytes);
+    return;
+  }
+
+  if (self.data.is_inline) {
+    uint8_t fields[8] = {
+      TS_SERIALIZED_INLINE_TAG,
+      self.data.visible |
+        self.data.named << 1 |
+        self.data.extra << 2 |
+        self.data.has_changes << 3 |
+        self.data.is_missing << 4 |
+        self.data.is_keyword << 5,
+      self.data.symbol,
+      self.data.padding_bytes,
+      self.data.padding_rows,
+      self.data.padding_columns,
+      self.data.size_bytes,
+      self.data.lookahead_bytes,
+    };
+    ts_subtree__write(buffer, fields, sizeof(fields));
+    ts_subtree__write_varint(buffer, self.data.parse_state);
+    return;
+  }
+
+  const SubtreeHeapData *data = self.ptr;
+  uint8_t tag = TS_SERIALIZED_HEAP_TAG;
+  ts_subtree__write(buffer, &tag, sizeof(tag));
+  ts_subtree__write_varint(buffer,
+    data->visible |
+    data->named << 1 |
+    data->extra << 2 |
+    data->fragile_left << 3 |
+    data->fragile_right << 4 |
+    data->has_changes << 5 |
+    data->has_external_tokens << 6 |
+    data->has_external_scanner_state_change << 7 |
+    data->depends_on_column << 8 |
+    data->is_missing << 9 |
+    data->is_keyword << 10
   );
+  ts_subtree__write_length(buffer, data->padding);
+  ts_subtree__write_length(buffer, data->size);
+  ts_subtree__write_varint(buffer, data->lookahead_bytes);
+  ts_subtree__write_varint(buffer, data->error_cost);
+  ts_subtree__write_varint(buffer, data->child_count);
+  ts_subtree__write_varint(buffer, data->symbol);
+  ts_subtree__write_varint(buffer, data->parse_state);
+
+  if (data->child_count > 0) {
+    ts_subtree__write_varint(buffer, data->visible_child_count);
+    ts_subtree__write_varint(buffer, data->named_child_count);
+    ts_subtree__write_varint(buffer, data->visible_descendant_count);
+    ts_subtree__write_signed_varint(buffer, data->dynamic_precedence);
+    ts_subtree__write_varint(buffer, data->repeat_depth);
+    ts_subtree__write_varint(buffer, data->production_id);
+    ts_subtree__write_varint(buffer, data->first_leaf.symbol);
+    ts_subtree__write_varint(buffer, data->first_leaf.parse_state);
+  } else if (data->has_external_tokens) {
+    const ExternalScannerState *state = &data->external_scanner_state;
+    ts_subtree__write_varint(buffer, state->length);
+    ts_subtree__write(buffer, ts_external_scanner_state_data(state), state->length);
+  } else if (data->symbol == ts_builtin_sym_error) {
+    ts_subtree__write_signed_varint(buffer, data->lookahead_char);
+  }
+}
+
+// Append a serialized copy of the given subtree to the buffer.
+void ts_subtree_serialize(Subtree self, SubtreeByteArray *buffer) {
+  uint32_t count_offset = buffer->size;
+  uint32_t count = 0;
+  ts_subtree__write(buffer, &count, sizeof(count));
+
+  Array(SubtreeSerializationEntry) stack = array_new();
+  array_push(&stack, ((SubtreeSerializationEntry) {self, 0}));
+  while (stack.size > 0) {
+    SubtreeSerializationEntry *entry = array_back(&stack);
+    if (entry->child_index < ts_subtree_child_count(entry->tree)) {
+      Subtree child = ts_subtree_children(entry->tree)[entry->child_index++];
+      array_push(&stack, ((SubtreeSerializationEntry) {child, 0}));
+    } else {
+      ts_subtree__serialize_node(entry->tree, buffer);
+      stack.size--;
+      count++;
+    }
+  }
+
+  memcpy(&buffer->contents[count_offset], &count, sizeof(count));
+  array_delete(&stack);
+}
+
+static bool ts_subtree__deserialize_node(
+  SubtreePool *pool,
+  const char **data,
+  const char *end,
+  SubtreeArray *stack,
+  const TSLanguage *language,
+  Subtree *result
+) {
+  uint8_t tag;
+  if (!ts_subtree__read(data, end, &tag, sizeof(tag))) return false;
+
+  if (tag == TS_SERIALIZED_INLINE_TAG) {
+    uint8_t fields[7];
+    uint16_t parse_state;
+    if (
+      !ts_subtree__read(data, end, fields, sizeof(fields)) ||
+      !ts_subtree__read_short_varint(data, end, &parse_state)
+    ) return false;
+    uint8_t flags = fields[0];
+    if (
+      !ts_subtree__is_valid_symbol(fields[1], language) ||
+      !ts_subtree__is_valid_state(parse_state, language) ||
+      fields[3] >= 16 ||
+      fields[6] >= 16
+    ) return false;
+    *result = (Subtree) {{
+      .is_inline = true,
+      .visible = flags & 1,
+      .named = flags >> 1 & 1,
+      .extra = flags >> 2 & 1,
+      .has_changes = flags >> 3 & 1,
+      .is_missing = flags >> 4 & 1,
+      .is_keyword = flags >> 5 & 1,
+      .symbol = fields[1],
+      .parse_state = parse_state,
+      .padding_bytes = fields[2],
+      .padding_rows = fields[3],
+      .padding_columns = fields[4],
+      .size_bytes = fields[5],
+      .lookahead_bytes = fields[6],
+    }};
+    return true;
+  }
+
+  if (tag == TS_SERIALIZED_WIDE_INLINE_TAG) {
+    uint8_t flags;
+    uint16_t symbol, parse_state;
+    uint32_t padding_rows, padding_columns, size_bytes, lookahead_bytes;
+    if (
+      !ts_subtree__read(data, end, &flags, sizeof(flags)) ||
+      !ts_subtree__read_short_varint(data, end, &symbol) ||
+      !ts_subtree__read_short_varint(data, end, &parse_state) ||
+      !ts_subtree__read_varint(data, end, &padding_rows) ||
+      !ts_subtree__read_varint(data, end, &padding_columns) ||
+      !ts_subtree__read_varint(data, end, &size_bytes) ||
+      !ts_subtree__read_varint(data, end, &lookahead_bytes)
+    ) return false;
+    if (
+      !ts_subtree__is_valid_symbol(symbol, language) ||
+      !ts_subtree__is_valid_state(parse_state, language) ||
+      padding_rows >= TS_MAX_WIDE_INLINE_PADDING_ROWS ||
+      padding_columns > UINT8_MAX
+    ) return false;
+    MutableSubtree tree = {.data = {
+      .is_inline = true,
+      .visible = flags & 1,
+      .named = flags >> 1 & 1,
+      .extra = flags >> 2 & 1,
+      .has_changes = flags >> 3 & 1,
+      .is_missing = flags >> 4 & 1,
+      .is_keyword = flags >> 5 & 1,
+    }};
+    Length padding = {padding_rows + padding_columns, {padding_rows, padding_columns}};
+    Length size = {size_bytes, {0, size_bytes}};
+    if (!ts_subtree__set_inline_fields(&tree, symbol, parse_state, padding, size, lookahead_bytes)) {
+      return false;
+    }
+    *result = ts_subtree_from_mut(tree);
+    return true;
+  }
+
+  if (tag != TS_SERIALIZED_HEAP_TAG) return false;
+
+  SubtreeHeapData node = {.ref_count = 1, .in_arena = pool->arena != NULL};
+  uint32_t flags;
+  if (
+    !ts_subtree__read_varint(data, end, &flags) ||
+    !ts_subtree__read_length(data, end, &node.padding) ||
+    !ts_subtree__read_length(data, end, &node.size) ||
+    !ts_subtree__read_varint(data, end, &node.lookahead_bytes) ||
+    !ts_subtree__read_varint(data, end, &node.error_cost) ||
+    !ts_subtree__read_varint(data, end, &node.child_count) ||
+    !ts_subtree__read_short_varint(data, end, &node.symbol) ||
+    !ts_subtree__read_short_varint(data, end, &node.parse_state)
+  ) return false;
+  if (
+    !ts_subtree__is_valid_symbol(node.symbol, language) ||
+    !ts_subtree__is_valid_state(node.parse_state, language) ||
+    node.child_count > stack->size
+  ) return false;
+  node.visible = flags & 1;
+  node.named = flags >> 1 & 1;
+  node.extra = flags >> 2 & 1;
+  node.fragile_left = flags >> 3 & 1;
+  node.fragile_right = flags >> 4 & 1;
+  node.has_changes = flags >> 5 & 1;
+  node.has_external_tokens = flags >> 6 & 1;
+  node.has_external_scanner_state_change = flags >> 7 & 1;
+  node.depends_on_column = flags >> 8 & 1;
+  node.is_missing = flags >> 9 & 1;
+  node.is_keyword = flags >> 10 & 1;
+
+  if (node.child_count > 0) {
+    if (
+      !ts_subtree__read_varint(data, end, &node.visible_child_count) ||
+      !ts_subtree__read_varint(data, end, &node.named_child_count) ||
+      !ts_subtree__read_varint(data, end, &node.visible_descendant_count) ||
+      !ts_subtree__read_signed_varint(data, end, &node.dynamic_precedence) ||
+      !ts_subtree__read_short_varint(data, end, &node.repeat_depth) ||
+      !ts_subtree__read_short_varint(data, end, &node.production_id) ||
+      !ts_subtree__read_short_varint(data, end, &node.first_leaf.symbol) ||
+      !ts_subtree__read_short_varint(data, end, &node.first_leaf.parse_state)
+    ) return false;
+    if (
+      (node.production_id >= language->production_id_count && node.production_id != 0) ||
+      !ts_subtree__is_valid_symbol(node.first_leaf.symbol, language) ||
+      !ts_subtree__is_valid_state(node.first_leaf.parse_state, language)
+    ) return false;
+
+    // Every structural child is looked up in the node's alias sequence.
+    const Subtree *children = &stack->contents[stack->size - node.child_count];
+    if (node.production_id != 0) {
+      uint32_t structural_child_count = 0;
+      for (uint32_t i = 0; i < node.child_count; i++) {
+        if (!ts_subtree_extra(children[i])) structural_child_count++;
+      }
+      if (structural_child_count > language->max_alias_sequence_length) return false;
+    }
+
+    size_t alloc_size = ts_subtree_alloc_size(node.child_count);
+    Subtree *contents = pool->arena
+      ? ts_subtree_arena__allocate(pool->arena, alloc_size)
+      : ts_malloc_in(TSAllocationCategorySubtreePool, alloc_size);
+    memcpy(contents, children, node.child_count * sizeof(Subtree));
+    SubtreeHeapData *result_data = (SubtreeHeapData *)&contents[node.child_count];
+    *result_data = node;
+
+    // The fields that describe the node's children must match the ones that
+    // are derived from them. The node's extent must be the combined extent of
+    // its children, except in edited trees, where sizes are adjusted
+    // independently. The descendant counts aren't serialized, so they are taken
+    // from the derived fields, and the hash is computed when it's needed.
+    MutableSubtree summary = {.ptr = result_data};
+    ts_subtree_summarize_children(summary, language);
+    if (
+      result_data->visible_child_count != node.visible_child_count ||
+      result_data->named_child_count != node.named_child_count ||
+      result_data->visible_descendant_count != node.visible_descendant_count ||
+      result_data->repeat_depth != node.repeat_depth ||
+      result_data->first_leaf.symbol != node.first_leaf.symbol ||
+      result_data->first_leaf.parse_state != node.first_leaf.parse_state ||
+      (!node.has_changes && (
+        !length_eq(result_data->padding, node.padding) ||
+        !length_eq(result_data->size, node.size)
+      ))
+    ) {
+      if (!pool->arena) ts_free(contents);
+      return false;
+    }
+    node.children_hash = result_data->children_hash;
+    node.descendant_count = result_data->descendant_count;
+    node.heap_descendant_count = result_data->heap_descendant_count;
+    *result_data = node;
+
+    stack->size -= node.child_count;
+    *result = (Subtree) {.ptr = result_data};
+    return true;
+  }
+
+  uint32_t state_length = 0;
+  if (node.has_external_tokens) {
+    if (
+      !ts_subtree__read_varint(data, end, &state_length) ||
+      (size_t)(end - *data) < state_length
+    ) return false;
+  } else if (node.symbol == ts_builtin_sym_error) {
+    if (!ts_subtree__read_signed_varint(data, end, &node.lookahead_char)) return false;
+  }
+
+  SubtreeHeapData *result_data = ts_subtree_pool_allocate(pool);
+  *result_data = node;
+  if (node.has_external_tokens) {
+    MutableSubtree mutable = {.ptr = result_data};
+    ts_subtree_set_external_scanner_state(pool, mutable, *data, state_length);
+    *data += state_length;
+  }
+  *result = (Subtree) {.ptr = result_data};
+  return true;
+}
+
+// Read a subtree that was written by `ts_subtree_serialize`, advancing the
+// data pointer past it. If the pool has an arena, all of the subtree's nodes
+// are allocated in it.
+//
+// This returns a null subtree if the data is malformed or does not describe a
+// valid tree for the given language.
+Subtree ts_subtree_deserialize(
+  SubtreePool *pool,
+  const char **data,
+  const char *end,
+  const TSLanguage *language
+) {
+  uint32_t count;
+  if (!ts_subtree__read(data, end, &count, sizeof(count))) return NULL_SUBTREE;
+
+  SubtreeArray stack = array_new();
+  for (uint32_t i = 0; i < count; i++) {
+    Subtree tree;
+    if (!ts_subtree__deserialize_node(pool, data, end, &stack, language, &tree)) {
+      ts_subtree_array_delete(pool, &stack);
+      return NULL_SUBTREE;
+    }
+    array_push(&stack, tree);
+  }
+
+  if (stack.size != 1) {
+    ts_subtree_array_delete(pool, &stack);
+    return NULL_SUBTREE;
+  }
+
+  Subtree result = stack.contents[0];
+  array_delete(&stack);
+  return result;
 }
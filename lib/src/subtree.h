@@ -26,11 +26,18 @@ extern "C" {
 // onto the subtree itself so that the scanner's state can later be
 // restored using its `deserialize` function.
 //
-// Small byte arrays are stored inline, and long ones are allocated
-// separately on the heap.
+// Small byte arrays are stored inline. Long ones are interned: they are
+// allocated separately on the heap, along with their hash and a reference
+// count, and shared by all of the subtrees with the same state.
+typedef struct {
+  volatile uint32_t ref_count;
+  uint32_t hash;
+  uint32_t length;
+} ExternalScannerStateData;
+
 typedef struct {
   union {
-    char *long_data;
+    ExternalScannerStateData *long_data;
     char short_data[24];
   };
   uint32_t length;
@@ -47,7 +54,15 @@ typedef struct {
 // Because of alignment, for any valid pointer this will be 0, giving
 // us the opportunity to make use of this bit to signify whether to use
 // the pointer or the inline struct.
+//
+// There are two layouts of inline subtrees, which share the same byte of
+// flags. If the `is_wide` flag is not set, the subtree has an 8-bit symbol
+// and each of its lengths is stored separately in a byte. Otherwise, it has
+// a 16-bit symbol and a longer size, but its padding must consist of a few
+// newlines followed by other characters, so that the padding's byte count
+// is the sum of its rows and columns.
 typedef struct SubtreeInlineData SubtreeInlineData;
+typedef struct SubtreeWideInlineData SubtreeWideInlineData;
 
 #define SUBTREE_BITS    \
   bool visible : 1;     \
@@ -64,6 +79,11 @@ typedef struct SubtreeInlineData SubtreeInlineData;
   uint8_t padding_bytes;       \
   uint8_t size_bytes;
 
+#define SUBTREE_WIDE_SIZE       \
+  uint16_t size_bytes : 10;     \
+  uint16_t padding_rows : 3;    \
+  uint16_t lookahead_bytes : 3;
+
 #if TS_BIG_ENDIAN
 #if TS_PTR_SIZE == 32
 
@@ -71,11 +91,21 @@ struct SubtreeInlineData {
   uint16_t parse_state;
   uint8_t symbol;
   SUBTREE_BITS
-  bool unused : 1;
+  bool is_wide : 1;
   bool is_inline : 1;
   SUBTREE_SIZE
 };
 
+struct SubtreeWideInlineData {
+  uint16_t parse_state;
+  uint8_t padding_columns;
+  SUBTREE_BITS
+  bool is_wide : 1;
+  bool is_inline : 1;
+  uint16_t symbol;
+  SUBTREE_WIDE_SIZE
+};
+
 #else
 
 struct SubtreeInlineData {
@@ -83,7 +113,17 @@ struct SubtreeInlineData {
   uint16_t parse_state;
   uint8_t symbol;
   SUBTREE_BITS
-  bool unused : 1;
+  bool is_wide : 1;
+  bool is_inline : 1;
+};
+
+struct SubtreeWideInlineData {
+  SUBTREE_WIDE_SIZE
+  uint16_t symbol;
+  uint16_t parse_state;
+  uint8_t padding_columns;
+  SUBTREE_BITS
+  bool is_wide : 1;
   bool is_inline : 1;
 };
 
@@ -93,15 +133,27 @@ struct SubtreeInlineData {
 struct SubtreeInlineData {
   bool is_inline : 1;
   SUBTREE_BITS
+  bool is_wide : 1;
   uint8_t symbol;
   uint16_t parse_state;
   SUBTREE_SIZE
 };
 
+struct SubtreeWideInlineData {
+  bool is_inline : 1;
+  SUBTREE_BITS
+  bool is_wide : 1;
+  uint8_t padding_columns;
+  uint16_t symbol;
+  uint16_t parse_state;
+  SUBTREE_WIDE_SIZE
+};
+
 #endif
 
 #undef SUBTREE_BITS
 #undef SUBTREE_SIZE
+#undef SUBTREE_WIDE_SIZE
 
 // A heap-allocated representation of a subtree.
 //
@@ -129,6 +181,7 @@ typedef struct {
   bool depends_on_column: 1;
   bool is_missing : 1;
   bool is_keyword : 1;
+  bool in_arena : 1;
 
   union {
     // Non-terminal subtrees (`child_count > 0`)
@@ -143,6 +196,16 @@ typedef struct {
         TSSymbol symbol;
         TSStateId parse_state;
       } first_leaf;
+
+      // The number of nodes below this one, and how many of those are stored
+      // on the heap, for estimating the memory that the subtree uses.
+      uint32_t descendant_count;
+      uint32_t heap_descendant_count;
+
+      // A hash of the visible nodes within this node's children, as if the
+      // children of its hidden children were its own, or zero if it hasn't
+      // been computed yet. See `ts_subtree_hash`.
+      uint64_t children_hash;
     };
 
     // External terminal subtrees (`child_count == 0 && has_external_tokens`)
@@ -156,25 +219,49 @@ typedef struct {
 // The fundamental building block of a syntax tree.
 typedef union {
   SubtreeInlineData data;
+  SubtreeWideInlineData wide_data;
   const SubtreeHeapData *ptr;
 } Subtree;
 
 // Like Subtree, but mutable.
 typedef union {
   SubtreeInlineData data;
+  SubtreeWideInlineData wide_data;
   SubtreeHeapData *ptr;
 } MutableSubtree;
 
 typedef Array(Subtree) SubtreeArray;
 typedef Array(MutableSubtree) MutableSubtreeArray;
+typedef Array(char) SubtreeByteArray;
+
+// A block of memory from which all of the subtrees created during a single
+// parse can be bump-allocated, and later freed all at once.
+//
+// An arena is reference counted. It is retained by the parser while the parse
+// is in progress, by every tree whose nodes live in it, and by any arena that
+// was created for a later parse which reused some of its nodes.
+typedef struct SubtreeArena SubtreeArena;
+
+// A hash set of the long external scanner states that have been created
+// from a pool. Each entry holds a reference to its state, so that later
+// tokens with the same state can share it. Entries that no subtree refers
+// to anymore are removed when the table fills up.
+typedef struct {
+  ExternalScannerStateData **entries;
+  uint32_t size;
+  uint32_t capacity;
+} ExternalScannerStateTable;
 
 typedef struct {
   MutableSubtreeArray free_trees;
   MutableSubtreeArray tree_stack;
+  SubtreeArena *arena;
+  ExternalScannerStateTable scanner_states;
 } SubtreePool;
 
-void ts_external_scanner_state_init(ExternalScannerState *, const char *, unsigned);
+uint32_t ts_external_scanner_state_hash_bytes(const char *, unsigned);
 const char *ts_external_scanner_state_data(const ExternalScannerState *);
+uint32_t ts_external_scanner_state_hash(const ExternalScannerState *);
 bool ts_external_scanner_state_eq(const ExternalScannerState *self, const char *, unsigned);
 void ts_external_scanner_state_delete(ExternalScannerState *self);
 
@@ -187,6 +274,10 @@ void ts_subtree_array_reverse(SubtreeArray *);
 SubtreePool ts_subtree_pool_new(uint32_t capacity);
 void ts_subtree_pool_delete(SubtreePool *);
 
+SubtreeArena *ts_subtree_arena_new(SubtreeArena *parent);
+void ts_subtree_arena_retain(SubtreeArena *);
+void ts_subtree_arena_release(SubtreeArena *);
+
 Subtree ts_subtree_new_leaf(
   SubtreePool *, TSSymbol, Length, Length, uint32_t,
   TSStateId, bool, bool, bool, const TSLanguage *
@@ -194,35 +285,55 @@ Subtree ts_subtree_new_leaf(
 Subtree ts_subtree_new_error(
   SubtreePool *, int32_t, Length, Length, uint32_t, TSStateId, const TSLanguage *
 );
-MutableSubtree ts_subtree_new_node(TSSymbol, SubtreeArray *, unsigned, const TSLanguage *);
-Subtree ts_subtree_new_error_node(SubtreeArray *, bool, const TSLanguage *);
+MutableSubtree ts_subtree_new_node(SubtreePool *, TSSymbol, SubtreeArray *, unsigned, const TSLanguage *);
+Subtree ts_subtree_new_error_node(SubtreePool *, SubtreeArray *, bool, const TSLanguage *);
 Subtree ts_subtree_new_missing_leaf(SubtreePool *, TSSymbol, Length, uint32_t, const TSLanguage *);
+Subtree ts_subtree_new_placeholder(SubtreePool *, Subtree, const TSLanguage *);
+void ts_subtree_set_external_scanner_state(SubtreePool *, MutableSubtree, const char *, unsigned);
 MutableSubtree ts_subtree_make_mut(SubtreePool *, Subtree);
+Subtree ts_subtree_copy_into_arena(SubtreePool *, Subtree);
 void ts_subtree_retain(Subtree);
 void ts_subtree_release(SubtreePool *, Subtree);
 int ts_subtree_compare(Subtree, Subtree, SubtreePool *);
-void ts_subtree_set_symbol(MutableSubtree *, TSSymbol, const TSLanguage *);
+void ts_subtree_set_symbol(SubtreePool *, MutableSubtree *, TSSymbol, const TSLanguage *);
 void ts_subtree_summarize(MutableSubtree, const Subtree *, uint32_t, const TSLanguage *);
 void ts_subtree_summarize_children(MutableSubtree, const TSLanguage *);
+void ts_subtree_memory_usage(Subtree, TSMemoryReport *);
+uint64_t ts_subtree_hash(Subtree, TSSymbol, const TSLanguage *);
 void ts_subtree_balance(Subtree, SubtreePool *, const TSLanguage *);
+bool ts_subtree_rebuild_repetitions(Subtree, SubtreePool *, const TSLanguage *);
 Subtree ts_subtree_edit(Subtree, const TSInputEdit *edit, SubtreePool *);
 char *ts_subtree_string(Subtree, TSSymbol, bool, const TSLanguage *, bool include_all);
 void ts_subtree_print_dot_graph(Subtree, const TSLanguage *, FILE *);
 Subtree ts_subtree_last_external_token(Subtree);
 const ExternalScannerState *ts_subtree_external_scanner_state(Subtree self);
 bool ts_subtree_external_scanner_state_eq(Subtree, Subtree);
+void ts_subtree_serialize(Subtree, SubtreeByteArray *);
+Subtree ts_subtree_deserialize(SubtreePool *, const char **, const char *, const TSLanguage *);
 
 #define SUBTREE_GET(self, name) ((self).data.is_inline ? (self).data.name : (self).ptr->name)
 
-static inline TSSymbol ts_subtree_symbol(Subtree self) { return SUBTREE_GET(self, symbol); }
+// Get a field of an inline subtree, in either layout.
+#define SUBTREE_INLINE_GET(self, name) ((self).data.is_wide ? (self).wide_data.name : (self).data.name)
+
+static inline TSSymbol ts_subtree_symbol(Subtree self) {
+  return self.data.is_inline ? SUBTREE_INLINE_GET(self, symbol) : self.ptr->symbol;
+}
+
 static inline bool ts_subtree_visible(Subtree self) { return SUBTREE_GET(self, visible); }
 static inline bool ts_subtree_named(Subtree self) { return SUBTREE_GET(self, named); }
 static inline bool ts_subtree_extra(Subtree self) { return SUBTREE_GET(self, extra); }
 static inline bool ts_subtree_has_changes(Subtree self) { return SUBTREE_GET(self, has_changes); }
 static inline bool ts_subtree_missing(Subtree self) { return SUBTREE_GET(self, is_missing); }
 static inline bool ts_subtree_is_keyword(Subtree self) { return SUBTREE_GET(self, is_keyword); }
-static inline TSStateId ts_subtree_parse_state(Subtree self) { return SUBTREE_GET(self, parse_state); }
-static inline uint32_t ts_subtree_lookahead_bytes(Subtree self) { return SUBTREE_GET(self, lookahead_bytes); }
+
+static inline TSStateId ts_subtree_parse_state(Subtree self) {
+  return self.data.is_inline ? SUBTREE_INLINE_GET(self, parse_state) : self.ptr->parse_state;
+}
+
+static inline uint32_t ts_subtree_lookahead_bytes(Subtree self) {
+  return self.data.is_inline ? SUBTREE_INLINE_GET(self, lookahead_bytes) : self.ptr->lookahead_bytes;
+}
 
 #undef SUBTREE_GET
 
@@ -246,19 +357,24 @@ static inline void ts_subtree_set_extra(MutableSubtree *self, bool is_extra) {
 }
 
 static inline TSSymbol ts_subtree_leaf_symbol(Subtree self) {
-  if (self.data.is_inline) return self.data.symbol;
+  if (self.data.is_inline) return SUBTREE_INLINE_GET(self, symbol);
   if (self.ptr->child_count == 0) return self.ptr->symbol;
   return self.ptr->first_leaf.symbol;
 }
 
 static inline TSStateId ts_subtree_leaf_parse_state(Subtree self) {
-  if (self.data.is_inline) return self.data.parse_state;
+  if (self.data.is_inline) return SUBTREE_INLINE_GET(self, parse_state);
   if (self.ptr->child_count == 0) return self.ptr->parse_state;
   return self.ptr->first_leaf.parse_state;
 }
 
 static inline Length ts_subtree_padding(Subtree self) {
-  if (self.data.is_inline) {
+  if (self.data.is_inline && self.data.is_wide) {
+    uint32_t rows = self.wide_data.padding_rows;
+    uint32_t columns = self.wide_data.padding_columns;
+    Length result = {rows + columns, {rows, columns}};
+    return result;
+  } else if (self.data.is_inline) {
     Length result = {self.data.padding_bytes, {self.data.padding_rows, self.data.padding_columns}};
     return result;
   } else {
@@ -268,13 +384,16 @@ static inline Length ts_subtree_padding(Subtree self) {
 
 static inline Length ts_subtree_size(Subtree self) {
   if (self.data.is_inline) {
-    Length result = {self.data.size_bytes, {0, self.data.size_bytes}};
+    uint32_t bytes = SUBTREE_INLINE_GET(self, size_bytes);
+    Length result = {bytes, {0, bytes}};
     return result;
   } else {
     return self.ptr->size;
   }
 }
 
+#undef SUBTREE_INLINE_GET
+
 static inline Length ts_subtree_total_size(Subtree self) {
   return length_add(ts_subtree_padding(self), ts_subtree_size(self));
 }
@@ -303,6 +422,18 @@ static inline uint32_t ts_subtree_visible_descendant_count(Subtree self) {
     : self.ptr->visible_descendant_count;
 }
 
+static inline uint32_t ts_subtree_descendant_count(Subtree self) {
+  return (self.data.is_inline || self.ptr->child_count == 0)
+    ? 0
+    : self.ptr->descendant_count;
+}
+
+static inline uint32_t ts_subtree_heap_descendant_count(Subtree self) {
+  return (self.data.is_inline || self.ptr->child_count == 0)
+    ? 0
+    : self.ptr->heap_descendant_count;
+}
+
 static inline uint32_t ts_subtree_visible_child_count(Subtree self) {
   if (ts_subtree_child_count(self) > 0) {
     return self.ptr->visible_child_count;
@@ -355,6 +486,10 @@ static inline bool ts_subtree_is_fragile(Subtree self) {
   return self.data.is_inline ? false : (self.ptr->fragile_left || self.ptr->fragile_right);
 }
 
+static inline bool ts_subtree_in_arena(Subtree self) {
+  return self.data.is_inline ? false : self.ptr->in_arena;
+}
+
 static inline bool ts_subtree_is_error(Subtree self) {
   return ts_subtree_symbol(self) == ts_builtin_sym_error;
 }
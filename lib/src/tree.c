@@ -10,30 +10,53 @@
 
 TSTree *ts_tree_new(
   Subtree root, const TSLanguage *language,
-  const TSRange *included_ranges, unsigned included_range_count
+  const TSRange *included_ranges, unsigned included_range_count,
+  SubtreeArena *arena
 ) {
   TSTree *result = ts_malloc(sizeof(TSTree));
   result->root = root;
   result->language = ts_language_copy(language);
   result->included_ranges = ts_calloc(included_range_count, sizeof(TSRange));
-  memcpy(result->included_ranges, included_ranges, included_range_count * sizeof(TSRange));
+  if (included_range_count > 0) {
+    memcpy(result->included_ranges, included_ranges, included_range_count * sizeof(TSRange));
+  }
   result->included_range_count = included_range_count;
+  result->arena = arena;
+  if (arena) ts_subtree_arena_retain(arena);
+  result->child_index = NULL;
+  result->parent_index = NULL;
   return result;
 }
 
 TSTree *ts_tree_copy(const TSTree *self) {
   ts_subtree_retain(self->root);
-  return ts_tree_new(self->root, self->language, self->included_ranges, self->included_range_count);
+  TSTree *result = ts_tree_new(
+    self->root, self->language,
+    self->included_ranges, self->included_range_count,
+    self->arena
+  );
+  if (self->child_index) ts_child_index_retain(self->child_index);
+  if (self->parent_index) ts_parent_index_retain(self->parent_index);
+  result->child_index = self->child_index;
+  result->parent_index = self->parent_index;
+  return result;
 }
 
 void ts_tree_delete(TSTree *self) {
   if (!self) return;
 
-  SubtreePool pool = ts_subtree_pool_new(0);
-  ts_subtree_release(&pool, self->root);
-  ts_subtree_pool_delete(&pool);
+  // If the root node lives in an arena, the whole tree is freed along with the
+  // arena, so there is no need to walk it.
+  if (!ts_subtree_in_arena(self->root)) {
+    SubtreePool pool = ts_subtree_pool_new(0);
+    ts_subtree_release(&pool, self->root);
+    ts_subtree_pool_delete(&pool);
+  }
+  if (self->arena) ts_subtree_arena_release(self->arena);
   ts_language_delete(self->language);
   ts_free(self->included_ranges);
+  ts_child_index_release(self->child_index);
+  ts_parent_index_release(self->parent_index);
   ts_free(self);
 }
 
@@ -50,50 +73,118 @@ TSNode ts_tree_root_node_with_offset(
   return ts_node_new(self, &self->root, length_add(offset, ts_subtree_padding(self->root)), 0);
 }
 
+// Copies of the tree may share the old index, so it is released and replaced
+// rather than rebuilt in place.
+void ts_tree_build_child_index(TSTree *self) {
+  ts_child_index_release(self->child_index);
+  self->child_index = NULL;
+  self->child_index = ts_child_index_new(self);
+}
+
+void ts_tree_build_parent_index(TSTree *self) {
+  ts_parent_index_release(self->parent_index);
+  self->parent_index = NULL;
+  self->parent_index = ts_parent_index_new(self);
+}
+
+size_t ts_tree_index_size(const TSTree *self) {
+  return ts_child_index_size(self->child_index) + ts_parent_index_size(self->parent_index);
+}
+
+// The memory used by the tree itself, rather than by its nodes.
+static size_t ts_tree__own_bytes(const TSTree *self) {
+  return sizeof(TSTree) + self->included_range_count * sizeof(TSRange);
+}
+
+// Add the memory used by the tree's indices to a report, as shared if a copy
+// of the tree also refers to them.
+static void ts_tree__add_index_bytes(const TSTree *self, TSMemoryReport *report) {
+  if (self->child_index) {
+    size_t size = ts_child_index_size(self->child_index);
+    if (self->child_index->ref_count > 1) report->shared_bytes += size;
+    else report->exclusive_bytes += size;
+  }
+  if (self->parent_index) {
+    size_t size = ts_parent_index_size(self->parent_index);
+    if (self->parent_index->ref_count > 1) report->shared_bytes += size;
+    else report->exclusive_bytes += size;
+  }
+}
+
+void ts_tree_memory_usage(const TSTree *self, TSMemoryReport *report) {
+  Subtree root = self->root;
+  uint32_t node_count = 1 + ts_subtree_descendant_count(root);
+  uint32_t heap_node_count = root.data.is_inline ? 0 : 1 + ts_subtree_heap_descendant_count(root);
+
+  // Every node but the root occupies a slot in its parent's array of children.
+  size_t node_bytes =
+    heap_node_count * sizeof(SubtreeHeapData) +
+    (node_count - 1) * sizeof(Subtree);
+  bool is_shared = !root.data.is_inline && root.ptr->ref_count > 1;
+
+  *report = (TSMemoryReport) {
+    .exclusive_bytes = ts_tree__own_bytes(self) + (is_shared ? 0 : node_bytes),
+    .shared_bytes = is_shared ? node_bytes : 0,
+    .scanner_state_bytes = 0,
+    .inline_node_count = node_count - heap_node_count,
+    .heap_node_count = heap_node_count,
+  };
+  ts_tree__add_index_bytes(self, report);
+}
+
+void ts_tree_memory_usage_exact(const TSTree *self, TSMemoryReport *report) {
+  *report = (TSMemoryReport) {.exclusive_bytes = ts_tree__own_bytes(self)};
+  ts_tree__add_index_bytes(self, report);
+  ts_subtree_memory_usage(self->root, report);
+}
+
 const TSLanguage *ts_tree_language(const TSTree *self) {
   return self->language;
 }
 
 void ts_tree_edit(TSTree *self, const TSInputEdit *edit) {
-  for (unsigned i = 0; i < self->included_range_count; i++) {
-    TSRange *range = &self->included_ranges[i];
-    if (range->end_byte >= edit->old_end_byte) {
-      if (range->end_byte != UINT32_MAX) {
-        range->end_byte = edit->new_end_byte + (range->end_byte - edit->old_end_byte);
-        range->end_point = point_add(
-          edit->new_end_point,
-          point_sub(range->end_point, edit->old_end_point)
-        );
-        if (range->end_byte < edit->new_end_byte) {
-          range->end_byte = UINT32_MAX;
-          range->end_point = POINT_MAX;
-        }
-      }
-    } else if (range->end_byte > edit->start_byte) {
-      range->end_byte = edit->start_byte;
-      range->end_point = edit->start_point;
-    }
-    if (range->start_byte >= edit->old_end_byte) {
-      range->start_byte = edit->new_end_byte + (range->start_byte - edit->old_end_byte);
-      range->start_point = point_add(
-        edit->new_end_point,
-        point_sub(range->start_point, edit->old_end_point)
-      );
-      if (range->start_byte < edit->new_end_byte) {
-        range->start_byte = UINT32_MAX;
-        range->start_point = POINT_MAX;
-      }
-    } else if (range->start_byte > edit->start_byte) {
-      range->start_byte = edit->start_byte;
-      range->start_point = edit->start_point;
-    }
-  }
+  // Editing may change the nodes' sizes in place.
+  ts_child_index_release(self->child_index);
+  ts_parent_index_release(self->parent_index);
+  self->child_index = NULL;
+  self->parent_index = NULL;
+
+  ts_range_array_edit(self->included_ranges, self->included_range_count, edit);
 
   SubtreePool pool = ts_subtree_pool_new(0);
   self->root = ts_subtree_edit(self->root, edit, &pool);
   ts_subtree_pool_delete(&pool);
 }
 
+void ts_tree_compact(TSTree *self) {
+  // The indices refer to the nodes that are about to be replaced.
+  ts_child_index_release(self->child_index);
+  ts_parent_index_release(self->parent_index);
+  self->child_index = NULL;
+  self->parent_index = NULL;
+
+  SubtreePool pool = ts_subtree_pool_new(0);
+  pool.arena = ts_subtree_arena_new(NULL);
+  Subtree root = ts_subtree_copy_into_arena(&pool, self->root);
+
+  // The rebuilt repetition nodes are allocated after all of the others, so if
+  // there are any, the tree is copied once more to put them in preorder.
+  if (ts_subtree_rebuild_repetitions(root, &pool, self->language)) {
+    SubtreeArena *unordered_arena = pool.arena;
+    pool.arena = ts_subtree_arena_new(NULL);
+    root = ts_subtree_copy_into_arena(&pool, root);
+    ts_subtree_arena_release(unordered_arena);
+  }
+  SubtreeArena *arena = pool.arena;
+  pool.arena = NULL;
+
+  if (!ts_subtree_in_arena(self->root)) ts_subtree_release(&pool, self->root);
+  if (self->arena) ts_subtree_arena_release(self->arena);
+  ts_subtree_pool_delete(&pool);
+  self->root = root;
+  self->arena = arena;
+}
+
 TSRange *ts_tree_included_ranges(const TSTree *self, uint32_t *length) {
   *length = self->included_range_count;
   TSRange *ranges = ts_calloc(self->included_range_count, sizeof(TSRange));
@@ -126,6 +217,130 @@ TSRange *ts_tree_get_changed_ranges(const TSTree *old_tree, const TSTree *new_tr
   return result;
 }
 
+TSNode *ts_tree_get_changed_nodes(const TSTree *old_tree, const TSTree *new_tree, uint32_t *length) {
+  uint32_t range_count;
+  TSRange *ranges = ts_tree_get_changed_ranges(old_tree, new_tree, &range_count);
+  TSNode root = ts_tree_root_node(new_tree);
+  TSNode *result = ts_malloc(range_count * sizeof(TSNode));
+  *length = 0;
+  for (uint32_t i = 0; i < range_count; i++) {
+    TSNode node = ts_node_descendant_for_byte_range(root, ranges[i].start_byte, ranges[i].end_byte);
+    uint32_t start_byte = ts_node_start_byte(node);
+    uint32_t end_byte = ts_node_end_byte(node);
+
+    // Several nearby ranges may be contained by the same node. Because the
+    // ranges are ordered, any nodes that this node contains are at the end of
+    // the result.
+    if (*length > 0) {
+      TSNode previous = result[*length - 1];
+      if (start_byte >= ts_node_start_byte(previous) && end_byte <= ts_node_end_byte(previous)) continue;
+    }
+    while (
+      *length > 0 &&
+      start_byte <= ts_node_start_byte(result[*length - 1]) &&
+      end_byte >= ts_node_end_byte(result[*length - 1])
+    ) (*length)--;
+    result[(*length)++] = node;
+  }
+  ts_free(ranges);
+  return result;
+}
+
+// The header of a serialized tree identifies the format and the language,
+// so that data written by a different version of the library, or for a
+// different grammar, is rejected rather than misinterpreted.
+#define TS_TREE_SERIALIZATION_MAGIC 0x72747374
+#define TS_TREE_SERIALIZATION_VERSION 1
+
+typedef struct {
+  uint32_t magic;
+  uint32_t format_version;
+  uint32_t language_version;
+  uint32_t symbol_count;
+  uint32_t alias_count;
+  uint32_t state_count;
+  uint32_t field_count;
+  uint32_t production_id_count;
+  uint32_t included_range_count;
+} SerializedTreeHeader;
+
+static SerializedTreeHeader ts_tree__serialization_header(
+  const TSLanguage *language,
+  uint32_t included_range_count
+) {
+  return (SerializedTreeHeader) {
+    .magic = TS_TREE_SERIALIZATION_MAGIC,
+    .format_version = TS_TREE_SERIALIZATION_VERSION,
+    .language_version = language->version,
+    .symbol_count = language->symbol_count,
+    .alias_count = language->alias_count,
+    .state_count = language->state_count,
+    .field_count = language->field_count,
+    .production_id_count = language->production_id_count,
+    .included_range_count = included_range_count,
+  };
+}
+
+char *ts_tree_serialize(const TSTree *self, uint32_t *length) {
+  SubtreeByteArray buffer = array_new();
+  SerializedTreeHeader header = ts_tree__serialization_header(
+    self->language,
+    self->included_range_count
+  );
+  array_extend(&buffer, sizeof(header), (const char *)&header);
+  array_extend(
+    &buffer,
+    self->included_range_count * sizeof(TSRange),
+    (const char *)self->included_ranges
+  );
+  ts_subtree_serialize(self->root, &buffer);
+  *length = buffer.size;
+  return buffer.contents;
+}
+
+TSTree *ts_tree_deserialize(const TSLanguage *language, const char *data, uint32_t length) {
+  const char *end = data + length;
+  SerializedTreeHeader header;
+  if (length < sizeof(header)) return NULL;
+  memcpy(&header, data, sizeof(header));
+  data += sizeof(header);
+
+  SerializedTreeHeader expected_header = ts_tree__serialization_header(
+    language,
+    header.included_range_count
+  );
+  if (memcmp(&header, &expected_header, sizeof(header)) != 0) return NULL;
+
+  size_t ranges_size = (size_t)header.included_range_count * sizeof(TSRange);
+  if ((size_t)(end - data) < ranges_size) return NULL;
+  const char *included_range_data = data;
+  data += ranges_size;
+
+  // All of the tree's nodes are allocated together, so they can be freed
+  // without walking the tree.
+  SubtreePool pool = ts_subtree_pool_new(0);
+  pool.arena = ts_subtree_arena_new(NULL);
+  Subtree root = ts_subtree_deserialize(&pool, &data, end, language);
+
+  TSTree *result = NULL;
+  if (root.ptr && data == end) {
+    result = ts_tree_new(root, language, NULL, 0, pool.arena);
+
+    // The ranges aren't necessarily aligned within the data, so their bytes
+    // are copied rather than read in place.
+    if (ranges_size > 0) {
+      result->included_ranges = ts_realloc(result->included_ranges, ranges_size);
+      memcpy(result->included_ranges, included_range_data, ranges_size);
+      result->included_range_count = header.included_range_count;
+    }
+  }
+
+  ts_subtree_arena_release(pool.arena);
+  pool.arena = NULL;
+  ts_subtree_pool_delete(&pool);
+  return result;
+}
+
 #ifdef _WIN32
 
 #include <io.h>
@@ -14,15 +14,71 @@ typedef struct {
   TSSymbol alias_symbol;
 } ParentCacheEntry;
 
+// A child of an indexed node, with its position stored relative to the
+// start of that node.
+typedef struct {
+  const Subtree *subtree;
+  Length offset;
+  TSSymbol alias_symbol;
+} ChildIndexEntry;
+
+// A hash table from nodes with many children to flat arrays of those
+// children, so that they can be accessed by index in constant time instead
+// of by iterating over them and descending into their hidden children.
+// Each node has an array of its visible children and one of its named
+// children. An index is never modified after it is built, so copies of a
+// tree share it, and it is freed when the last of them lets go of it.
+typedef struct {
+  const SubtreeHeapData **nodes;
+  uint32_t *visible_entry_offsets;
+  uint32_t *named_entry_offsets;
+  uint32_t capacity;
+  Array(ChildIndexEntry) entries;
+  volatile uint32_t ref_count;
+} ChildIndex;
+
+// A visible node, along with the index of the entry for its nearest visible
+// ancestor, or `PARENT_INDEX_ROOT` if that ancestor is the root node.
+typedef struct {
+  const Subtree *node;
+  Length position;
+  TSSymbol alias_symbol;
+  uint32_t parent;
+} ParentIndexEntry;
+
+// A hash table from nodes, identified by their address and start byte, to
+// their parents, so that a node's parent can be found in constant time
+// instead of by descending from the root node. Like a `ChildIndex`, it is
+// shared by copies of a tree.
+typedef struct {
+  uint32_t *slots;
+  uint32_t capacity;
+  Array(ParentIndexEntry) entries;
+  volatile uint32_t ref_count;
+} ParentIndex;
+
+#define PARENT_INDEX_ROOT UINT32_MAX
+
 struct TSTree {
   Subtree root;
   const TSLanguage *language;
   TSRange *included_ranges;
   unsigned included_range_count;
+  SubtreeArena *arena;
+  ChildIndex *child_index;
+  ParentIndex *parent_index;
 };
 
-TSTree *ts_tree_new(Subtree root, const TSLanguage *language, const TSRange *, unsigned);
+TSTree *ts_tree_new(Subtree root, const TSLanguage *language, const TSRange *, unsigned, SubtreeArena *);
 TSNode ts_node_new(const TSTree *, const Subtree *, Length, TSSymbol);
+ChildIndex *ts_child_index_new(const TSTree *);
+void ts_child_index_retain(ChildIndex *);
+void ts_child_index_release(ChildIndex *);
+size_t ts_child_index_size(const ChildIndex *);
+ParentIndex *ts_parent_index_new(const TSTree *);
+void ts_parent_index_retain(ParentIndex *);
+void ts_parent_index_release(ParentIndex *);
+size_t ts_parent_index_size(const ParentIndex *);
 
 #ifdef __cplusplus
 }
@@ -626,6 +626,52 @@ uint32_t ts_tree_cursor_current_depth(const TSTreeCursor *_self) {
   return depth;
 }
 
+bool ts_tree_cursor_walk(
+  TSTreeCursor *self,
+  const TSTreeCursorWalkOptions *options,
+  TSTreeCursorWalkEntry *entries,
+  uint32_t capacity,
+  uint32_t *count
+) {
+  uint32_t depth = ts_tree_cursor_current_depth(self);
+  uint32_t entry_count = 0;
+  for (;;) {
+    TSNode node = ts_tree_cursor_current_node(self);
+    TSSymbol symbol = ts_node_symbol(node);
+    bool is_included =
+      (!options->symbols || (
+        symbol < options->symbol_count &&
+        (options->symbols[symbol / 8] & (1 << (symbol % 8)))
+      )) &&
+      (!options->named_only || ts_node_is_named(node));
+
+    // Stop on the node that doesn't fit, so that the next call begins there.
+    if (is_included) {
+      if (entry_count == capacity) {
+        *count = entry_count;
+        return true;
+      }
+      entries[entry_count++] = (TSTreeCursorWalkEntry) {
+        .node = node,
+        .field_id = ts_tree_cursor_current_field_id(self),
+        .depth = depth,
+      };
+    }
+
+    if ((!options->max_depth || depth < options->max_depth) && ts_tree_cursor_goto_first_child(self)) {
+      depth++;
+      continue;
+    }
+    while (!ts_tree_cursor_goto_next_sibling(self)) {
+      if (!ts_tree_cursor_goto_parent(self)) {
+        *count = entry_count;
+        return false;
+      }
+      depth--;
+    }
+  }
+}
+
 TSNode ts_tree_cursor_parent_node(const TSTreeCursor *_self) {
   const TreeCursor *self = (const TreeCursor *)_self;
   for (int i = (int)self->stack.size - 2; i >= 0; i--) {
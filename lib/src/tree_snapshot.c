@@ -0,0 +1,98 @@
+#include <stdint.h>
+#include "tree_sitter/api.h"
+#include "./alloc.h"
+#include "./atomic.h"
+#include "./tree.h"
+
+// The latest published version of a tree, which readers copy while a writer
+// replaces it.
+//
+// The published tree is never modified, and the trees that readers acquire
+// are ordinary copies of it, so their nodes are kept alive by the subtrees'
+// own reference counts, and a writer that edits its own copy of the tree
+// clones any shared subtree before changing it. The only thing that needs
+// protecting is the short window in which a reader has loaded the published
+// tree's address but has not yet retained it. Copying a tree doesn't copy its
+// nodes or its indices, so that window doesn't grow with the size of the tree.
+//
+// Readers announce that window in one of two counters, chosen by the parity
+// of the current epoch. A writer swaps in the new tree, advances the epoch so
+// that new readers use the other counter, and waits for the counter of the
+// previous epoch to drain before deleting the old tree. Readers never wait,
+// and writers wait at most for the readers that are in the middle of copying a
+// tree. Writers are serialized with a flag, so that a waiting writer only ever
+// has to account for one epoch.
+struct TSTreeSnapshot {
+  volatile size_t tree;
+  volatile size_t epoch;
+  volatile size_t reader_counts[2];
+  volatile size_t is_publishing;
+};
+
+// Add to a shared word with a compare-and-swap, which is sequentially
+// consistent on every platform, unlike `atomic_add`. Adding zero reads the
+// latest value of the word.
+static size_t ts_tree_snapshot__add(volatile size_t *value, size_t delta) {
+  for (;;) {
+    size_t current = atomic_load(value);
+    if (atomic_compare_exchange(value, current, current + delta)) {
+      return current + delta;
+    }
+  }
+}
+
+static inline size_t ts_tree_snapshot__read(volatile size_t *value) {
+  return ts_tree_snapshot__add(value, 0);
+}
+
+TSTreeSnapshot *ts_tree_snapshot_new(const TSTree *tree) {
+  TSTreeSnapshot *self = ts_malloc(sizeof(TSTreeSnapshot));
+  self->tree = (size_t)(uintptr_t)(tree ? ts_tree_copy(tree) : NULL);
+  self->epoch = 0;
+  self->reader_counts[0] = 0;
+  self->reader_counts[1] = 0;
+  self->is_publishing = 0;
+  return self;
+}
+
+void ts_tree_snapshot_delete(TSTreeSnapshot *self) {
+  if (!self) return;
+  ts_tree_delete((TSTree *)(uintptr_t)self->tree);
+  ts_free(self);
+}
+
+void ts_tree_snapshot_publish(TSTreeSnapshot *self, const TSTree *tree) {
+  TSTree *copy = tree ? ts_tree_copy(tree) : NULL;
+
+  while (!atomic_compare_exchange(&self->is_publishing, 0, 1)) {}
+
+  size_t old_tree = ts_tree_snapshot__read(&self->tree);
+  atomic_compare_exchange(&self->tree, old_tree, (size_t)(uintptr_t)copy);
+
+  // Readers that start after this see the new epoch, and so they can only
+  // load the new tree. Wait for the ones that may still be copying the old one.
+  size_t epoch = ts_tree_snapshot__read(&self->epoch);
+  atomic_compare_exchange(&self->epoch, epoch, epoch + 1);
+  while (ts_tree_snapshot__read(&self->reader_counts[epoch & 1]) != 0) {}
+
+  atomic_compare_exchange(&self->is_publishing, 1, 0);
+  ts_tree_delete((TSTree *)(uintptr_t)old_tree);
+}
+
+TSTree *ts_tree_snapshot_acquire(TSTreeSnapshot *self) {
+  // Register in the counter of the current epoch. If the epoch advanced in the
+  // meantime, the writer that advanced it may not have seen the registration,
+  // so register again in the new epoch.
+  size_t epoch;
+  for (;;) {
+    epoch = ts_tree_snapshot__read(&self->epoch);
+    ts_tree_snapshot__add(&self->reader_counts[epoch & 1], 1);
+    if (ts_tree_snapshot__read(&self->epoch) == epoch) break;
+    ts_tree_snapshot__add(&self->reader_counts[epoch & 1], (size_t)0 - 1);
+  }
+
+  const TSTree *tree = (const TSTree *)(uintptr_t)ts_tree_snapshot__read(&self->tree);
+  TSTree *result = tree ? ts_tree_copy(tree) : NULL;
+  ts_tree_snapshot__add(&self->reader_counts[epoch & 1], (size_t)0 - 1);
+  return result;
+}
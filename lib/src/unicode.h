@@ -43,6 +43,16 @@ static inline uint32_t ts_decode_utf16(
   return i * 2;
 }
 
+static inline uint32_t ts_decode_latin1(
+  const uint8_t *string,
+  uint32_t length,
+  int32_t *code_point
+) {
+  (void)length;
+  *code_point = string[0];
+  return 1;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200112L
+
 #include "tree_sitter/api.h"
 #include "./parser.h"
 #include <stdint.h>
@@ -12,12 +14,64 @@
 #include "./wasm/wasm-stdlib.h"
 #include "./wasm_store.h"
 
+#include <stdio.h>
 #include <string.h>
 #include <wasm.h>
 #include <wasmtime.h>
 
 #define array_len(a) (sizeof(a) / sizeof(a[0]))
 
+#ifdef _WIN32
+
+// Windows: Guard the module cache with a slim reader-writer lock, which,
+// unlike a critical section, needs no cleanup.
+
+#include <windows.h>
+#include <process.h>
+
+typedef SRWLOCK WasmMutex;
+typedef CONDITION_VARIABLE WasmCondition;
+
+static inline void wasm_mutex_init(WasmMutex *self) { InitializeSRWLock(self); }
+static inline void wasm_mutex_delete(WasmMutex *self) { (void)self; }
+static inline void wasm_mutex_lock(WasmMutex *self) { AcquireSRWLockExclusive(self); }
+static inline void wasm_mutex_unlock(WasmMutex *self) { ReleaseSRWLockExclusive(self); }
+
+static inline void wasm_condition_init(WasmCondition *self) { InitializeConditionVariable(self); }
+static inline void wasm_condition_delete(WasmCondition *self) { (void)self; }
+static inline void wasm_condition_broadcast(WasmCondition *self) { WakeAllConditionVariable(self); }
+static inline void wasm_condition_wait(WasmCondition *self, WasmMutex *mutex) {
+  SleepConditionVariableSRW(self, mutex, INFINITE, 0);
+}
+
+static inline unsigned long wasm_process_id(void) { return (unsigned long)_getpid(); }
+
+#else
+
+// POSIX: Guard the module cache with a pthread mutex.
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_mutex_t WasmMutex;
+typedef pthread_cond_t WasmCondition;
+
+static inline void wasm_mutex_init(WasmMutex *self) { pthread_mutex_init(self, NULL); }
+static inline void wasm_mutex_delete(WasmMutex *self) { pthread_mutex_destroy(self); }
+static inline void wasm_mutex_lock(WasmMutex *self) { pthread_mutex_lock(self); }
+static inline void wasm_mutex_unlock(WasmMutex *self) { pthread_mutex_unlock(self); }
+
+static inline void wasm_condition_init(WasmCondition *self) { pthread_cond_init(self, NULL); }
+static inline void wasm_condition_delete(WasmCondition *self) { pthread_cond_destroy(self); }
+static inline void wasm_condition_broadcast(WasmCondition *self) { pthread_cond_broadcast(self); }
+static inline void wasm_condition_wait(WasmCondition *self, WasmMutex *mutex) {
+  pthread_cond_wait(self, mutex);
+}
+
+static inline unsigned long wasm_process_id(void) { return (unsigned long)getpid(); }
+
+#endif
+
 // The following symbols from the C and C++ standard libraries are available
 // for external scanners to use.
 const char *STDLIB_SYMBOLS[] = {
@@ -71,6 +125,51 @@ typedef struct {
   int32_t scanner_scan_fn_index;
 } LanguageWasmInstance;
 
+// WasmCachedModule - A compiled wasm module in a `TSWasmModuleCache`, along
+// with the hash and the length of the wasm bytes that it was compiled from.
+// The module is NULL while it is being compiled.
+typedef struct {
+  uint64_t hash;
+  uint32_t length;
+  wasmtime_module_t *module;
+} WasmCachedModule;
+
+// TSWasmModuleCache - A set of compiled wasm modules that is shared by all of
+// the wasm stores created with it, so that each module only needs to be
+// compiled once. This struct is reference-counted, so that it stays alive
+// while any of those stores exist. Its list of modules is guarded by a mutex,
+// but modules are compiled outside of it. Threads that need a module that
+// another thread is compiling wait for the `module_compiled` condition.
+struct TSWasmModuleCache {
+  wasm_engine_t *engine;
+  char *directory;
+  Array(WasmCachedModule) modules;
+  volatile uint32_t ref_count;
+  WasmMutex mutex;
+  WasmCondition module_compiled;
+};
+
+// WasmCacheFileHeader - The header of a precompiled module in a cache
+// directory. wasmtime trusts the contents of precompiled modules, so a file
+// whose header doesn't match the module that is being looked up, or the size
+// of the file, is never deserialized.
+typedef struct {
+  char magic[8];
+  uint64_t hash;
+  uint64_t size;
+  uint32_t length;
+  uint32_t padding;
+} WasmCacheFileHeader;
+
+static const char WASM_CACHE_FILE_MAGIC[8] = "tscwasm";
+
+// wasmtime's precompiled modules are ELF images.
+static const char ELF_MAGIC[4] = {0x7f, 'E', 'L', 'F'};
+
+// The number of temporary files created by this process, which makes their
+// names unique.
+static volatile uint32_t wasm_cache_temp_file_count;
+
 typedef struct {
   uint32_t reset_heap;
   uint32_t proc_exit;
@@ -81,6 +180,8 @@ typedef struct {
   uint32_t at_exit;
   uint32_t args_get;
   uint32_t args_sizes_get;
+  uint32_t lexer_peek;
+  uint32_t lexer_advance_by;
 } BuiltinFunctionIndices;
 
 // TSWasmStore - A struct that allows a given `Parser` to use wasm-backed
@@ -102,6 +203,7 @@ struct TSWasmStore {
   wasm_globaltype_t *const_i32_type;
   bool has_error;
   uint32_t lexer_address;
+  TSWasmModuleCache *module_cache;
 };
 
 typedef Array(char) StringData;
@@ -345,6 +447,66 @@ static wasm_trap_t *callback__lexer_eof(
   return NULL;
 }
 
+// The most characters that `ts_lexer_peek` can return from one call.
+#define MAX_PEEK_LENGTH 256
+
+static wasm_trap_t *callback__lexer_peek(
+  void *env,
+  wasmtime_caller_t* caller,
+  wasmtime_val_raw_t *args_and_results,
+  size_t args_and_results_len
+) {
+  wasmtime_context_t *context = wasmtime_caller_context(caller);
+  assert(args_and_results_len == 3);
+
+  TSWasmStore *store = env;
+  uint32_t buffer_address = args_and_results[1].i32;
+  uint32_t capacity = args_and_results[2].i32;
+  if (capacity > MAX_PEEK_LENGTH) capacity = MAX_PEEK_LENGTH;
+
+  size_t memory_size = wasmtime_memory_data_size(context, &store->memory);
+  if (
+    buffer_address > memory_size ||
+    (memory_size - buffer_address) / sizeof(int32_t) < capacity
+  ) {
+    const char *message = "wasm module called ts_lexer_peek with an invalid buffer";
+    return wasmtime_trap_new(message, strlen(message));
+  }
+
+  int32_t characters[MAX_PEEK_LENGTH];
+  uint32_t count = ts_lexer_decode_ahead((Lexer *)store->current_lexer, characters, capacity);
+
+  uint8_t *memory = wasmtime_memory_data(context, &store->memory);
+  memcpy(&memory[buffer_address], characters, count * sizeof(int32_t));
+  args_and_results[0].i32 = count;
+  return NULL;
+}
+
+static wasm_trap_t *callback__lexer_advance_by(
+  void *env,
+  wasmtime_caller_t* caller,
+  wasmtime_val_raw_t *args_and_results,
+  size_t args_and_results_len
+) {
+  wasmtime_context_t *context = wasmtime_caller_context(caller);
+  assert(args_and_results_len == 3);
+
+  TSWasmStore *store = env;
+  TSLexer *lexer = store->current_lexer;
+  uint32_t count = args_and_results[1].i32;
+  bool skip = args_and_results[2].i32;
+  uint32_t result = 0;
+  while (result < count && !lexer->eof(lexer)) {
+    lexer->advance(lexer, skip);
+    result++;
+  }
+
+  uint8_t *memory = wasmtime_memory_data(context, &store->memory);
+  memcpy(&memory[store->lexer_address], &lexer->lookahead, sizeof(lexer->lookahead));
+  args_and_results[0].i32 = result;
+  return NULL;
+}
+
 typedef struct {
   uint32_t *storage_location;
   wasmtime_func_unchecked_callback_t callback;
@@ -352,7 +514,7 @@ typedef struct {
 } FunctionDefinition;
 
 static void *copy(const void *data, size_t size) {
-  void *result = ts_malloc(size);
+  void *result = ts_malloc_in(TSAllocationCategoryWasmStore, size);
   memcpy(result, data, size);
   return result;
 }
@@ -374,7 +536,7 @@ static void *copy_unsized_static_array(
 
   if (!end_address) return NULL;
   size_t size = end_address - start_address;
-  void *result = ts_malloc(size);
+  void *result = ts_malloc_in(TSAllocationCategoryWasmStore, size);
   memcpy(result, &data[start_address], size);
   return result;
 }
@@ -385,7 +547,7 @@ static void *copy_strings(
   size_t count,
   StringData *string_data
 ) {
-  const char **result = ts_malloc(count * sizeof(char *));
+  const char **result = ts_malloc_in(TSAllocationCategoryWasmStore, count * sizeof(char *));
   for (unsigned i = 0; i < count; i++) {
     int32_t address;
     memcpy(&address, &data[array_address + i * sizeof(address)], sizeof(address));
@@ -433,7 +595,7 @@ static inline wasm_functype_t* wasm_functype_new_4_0(
   } while (0)
 
 WasmLanguageId *language_id_new() {
-  WasmLanguageId *self = ts_malloc(sizeof(WasmLanguageId));
+  WasmLanguageId *self = ts_malloc_in(TSAllocationCategoryWasmStore, sizeof(WasmLanguageId));
   self->is_language_deleted = false;
   self->ref_count = 1;
   return self;
@@ -509,6 +671,10 @@ static bool ts_wasm_store__provide_builtin_import(
     *import = get_builtin_extern(&self->function_table, self->builtin_fn_indices.notify_memory_growth);
   } else if (name_eq(import_name, "tree_sitter_debug_message")) {
     *import = get_builtin_extern(&self->function_table, self->builtin_fn_indices.debug_message);
+  } else if (name_eq(import_name, "tree_sitter_lexer_peek")) {
+    *import = get_builtin_extern(&self->function_table, self->builtin_fn_indices.lexer_peek);
+  } else if (name_eq(import_name, "tree_sitter_lexer_advance_by")) {
+    *import = get_builtin_extern(&self->function_table, self->builtin_fn_indices.lexer_advance_by);
   } else {
     return false;
   }
@@ -537,8 +703,256 @@ static bool ts_wasm_store__call_module_initializer(
   }
 }
 
-TSWasmStore *ts_wasm_store_new(TSWasmEngine *engine, TSWasmError *wasm_error) {
-  TSWasmStore *self = ts_calloc(1, sizeof(TSWasmStore));
+/************************
+ * TSWasmModuleCache
+ ************************/
+
+static uint64_t wasm_module__hash(const uint8_t *bytes, size_t length) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+TSWasmModuleCache *ts_wasm_module_cache_new(TSWasmEngine *engine) {
+  TSWasmModuleCache *self = ts_malloc_in(TSAllocationCategoryWasmStore, sizeof(TSWasmModuleCache));
+  *self = (TSWasmModuleCache) {
+    .engine = wasmtime_engine_clone(engine),
+    .directory = NULL,
+    .modules = array_new(),
+    .ref_count = 1,
+  };
+  wasm_mutex_init(&self->mutex);
+  wasm_condition_init(&self->module_compiled);
+  return self;
+}
+
+static void ts_wasm_module_cache__release(TSWasmModuleCache *self) {
+  assert(self->ref_count > 0);
+  if (atomic_dec(&self->ref_count) > 0) return;
+  for (unsigned i = 0; i < self->modules.size; i++) {
+    wasmtime_module_delete(self->modules.contents[i].module);
+  }
+  array_delete(&self->modules);
+  ts_free(self->directory);
+  wasm_condition_delete(&self->module_compiled);
+  wasm_mutex_delete(&self->mutex);
+  wasm_engine_delete(self->engine);
+  ts_free(self);
+}
+
+void ts_wasm_module_cache_delete(TSWasmModuleCache *self) {
+  if (self) ts_wasm_module_cache__release(self);
+}
+
+void ts_wasm_module_cache_set_directory(TSWasmModuleCache *self, const char *path) {
+  ts_free(self->directory);
+  self->directory = NULL;
+  if (path) {
+    size_t length = strlen(path);
+    self->directory = ts_malloc_in(TSAllocationCategoryWasmStore, length + 1);
+    memcpy(self->directory, path, length + 1);
+  }
+}
+
+// Find a module's entry in the cache. The cache must be locked.
+static WasmCachedModule *ts_wasm_module_cache__find(
+  TSWasmModuleCache *self,
+  uint64_t hash,
+  uint32_t length
+) {
+  for (unsigned i = 0; i < self->modules.size; i++) {
+    WasmCachedModule *entry = &self->modules.contents[i];
+    if (entry->hash == hash && entry->length == length) return entry;
+  }
+  return NULL;
+}
+
+// The path at which a precompiled module is stored in the cache's directory.
+static char *ts_wasm_module_cache__path(
+  const TSWasmModuleCache *self,
+  uint64_t hash,
+  uint32_t length,
+  const char *extension
+) {
+  const char *format_string = "%s/%016llx-%u.%s";
+  int path_length = snprintf(
+    NULL, 0, format_string,
+    self->directory, (unsigned long long)hash, length, extension
+  );
+  char *result = ts_malloc(path_length + 1);
+  snprintf(
+    result, path_length + 1, format_string,
+    self->directory, (unsigned long long)hash, length, extension
+  );
+  return result;
+}
+
+// Load a precompiled module from the cache's directory. Any failure, such as a
+// missing or truncated file, or one written by an incompatible version of
+// wasmtime, just means that the module has to be compiled again.
+static wasmtime_module_t *ts_wasm_module_cache__read_file(
+  const TSWasmModuleCache *self,
+  uint64_t hash,
+  uint32_t length
+) {
+  if (!self->directory) return NULL;
+  char *path = ts_wasm_module_cache__path(self, hash, length, "cwasm");
+  FILE *file = fopen(path, "rb");
+  ts_free(path);
+  if (!file) return NULL;
+
+  WasmCacheFileHeader header;
+  long file_size = -1;
+  if (fseek(file, 0, SEEK_END) == 0) file_size = ftell(file);
+  if (
+    file_size < (long)sizeof(header) ||
+    fseek(file, 0, SEEK_SET) != 0 ||
+    fread(&header, sizeof(header), 1, file) != 1 ||
+    memcmp(header.magic, WASM_CACHE_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+    header.hash != hash ||
+    header.length != length ||
+    header.size != (uint64_t)file_size - sizeof(header) ||
+    header.size < sizeof(ELF_MAGIC)
+  ) {
+    fclose(file);
+    return NULL;
+  }
+
+  wasmtime_module_t *module = NULL;
+  uint8_t *serialized = ts_malloc((size_t)header.size);
+  if (
+    fread(serialized, 1, (size_t)header.size, file) == header.size &&
+    memcmp(serialized, ELF_MAGIC, sizeof(ELF_MAGIC)) == 0
+  ) {
+    wasmtime_error_t *error = wasmtime_module_deserialize(
+      self->engine,
+      serialized,
+      (size_t)header.size,
+      &module
+    );
+    if (error) {
+      wasmtime_error_delete(error);
+      module = NULL;
+    }
+  }
+  ts_free(serialized);
+  fclose(file);
+  return module;
+}
+
+// Store a precompiled module in the cache's directory. The module is written
+// to a new temporary file first, so that other processes never see a partially
+// written file. The temporary file's name is unique within this process, and
+// it is opened in exclusive mode, so that it can't be shared with another
+// process either. Failures are ignored.
+static void ts_wasm_module_cache__write_file(
+  const TSWasmModuleCache *self,
+  uint64_t hash,
+  uint32_t length,
+  wasmtime_module_t *module
+) {
+  if (!self->directory) return;
+  wasm_byte_vec_t serialized = WASM_EMPTY_VEC;
+  wasmtime_error_t *error = wasmtime_module_serialize(module, &serialized);
+  if (error) {
+    wasmtime_error_delete(error);
+    return;
+  }
+
+  WasmCacheFileHeader header = {
+    .hash = hash,
+    .size = serialized.size,
+    .length = length,
+  };
+  memcpy(header.magic, WASM_CACHE_FILE_MAGIC, sizeof(header.magic));
+
+  char *path = ts_wasm_module_cache__path(self, hash, length, "cwasm");
+  char temp_extension[48];
+  snprintf(
+    temp_extension, sizeof(temp_extension), "%lu-%u.tmp",
+    wasm_process_id(), atomic_inc(&wasm_cache_temp_file_count)
+  );
+  char *temp_path = ts_wasm_module_cache__path(self, hash, length, temp_extension);
+  FILE *file = fopen(temp_path, "wbx");
+  if (file) {
+    bool written =
+      fwrite(&header, sizeof(header), 1, file) == 1 &&
+      fwrite(serialized.data, 1, serialized.size, file) == serialized.size;
+    if (fclose(file) != 0) written = false;
+    if (!written || rename(temp_path, path) != 0) remove(temp_path);
+  }
+  ts_free(temp_path);
+  ts_free(path);
+  wasm_byte_vec_delete(&serialized);
+}
+
+// Compile the given wasm bytes, reusing a module from the given cache if
+// possible. The caller owns the resulting module.
+static wasmtime_error_t *ts_wasm_module_cache__compile(
+  TSWasmModuleCache *self,
+  wasm_engine_t *engine,
+  const uint8_t *wasm,
+  uint32_t wasm_len,
+  wasmtime_module_t **result
+) {
+  if (!self) return wasmtime_module_new(engine, wasm, wasm_len, result);
+
+  uint64_t hash = wasm_module__hash(wasm, wasm_len);
+  wasm_mutex_lock(&self->mutex);
+  for (;;) {
+    WasmCachedModule *entry = ts_wasm_module_cache__find(self, hash, wasm_len);
+    if (!entry) break;
+    if (entry->module) {
+      *result = wasmtime_module_clone(entry->module);
+      wasm_mutex_unlock(&self->mutex);
+      return NULL;
+    }
+
+    // Another thread is compiling the same module. If that fails, its entry
+    // is removed, and this thread compiles the module itself.
+    wasm_condition_wait(&self->module_compiled, &self->mutex);
+  }
+  array_push(&self->modules, ((WasmCachedModule) {
+    .hash = hash,
+    .length = wasm_len,
+    .module = NULL,
+  }));
+  ts_set_allocation_category(self->modules.contents, TSAllocationCategoryWasmStore);
+  wasm_mutex_unlock(&self->mutex);
+
+  wasmtime_error_t *error = NULL;
+  wasmtime_module_t *module = ts_wasm_module_cache__read_file(self, hash, wasm_len);
+  if (!module) {
+    error = wasmtime_module_new(self->engine, wasm, wasm_len, &module);
+    if (!error) ts_wasm_module_cache__write_file(self, hash, wasm_len, module);
+  }
+
+  wasm_mutex_lock(&self->mutex);
+  WasmCachedModule *entry = ts_wasm_module_cache__find(self, hash, wasm_len);
+  if (error) {
+    array_erase(&self->modules, entry - self->modules.contents);
+    *result = NULL;
+  } else {
+    entry->module = module;
+    *result = wasmtime_module_clone(module);
+  }
+  wasm_condition_broadcast(&self->module_compiled);
+  wasm_mutex_unlock(&self->mutex);
+  return error;
+}
+
+/************************
+ * TSWasmStore
+ ************************/
+
+static TSWasmStore *ts_wasm_store__new(
+  TSWasmEngine *engine,
+  TSWasmModuleCache *module_cache,
+  TSWasmError *wasm_error
+) {
+  TSWasmStore *self = ts_calloc_in(TSAllocationCategoryWasmStore, 1, sizeof(TSWasmStore));
   wasmtime_store_t *store = wasmtime_store_new(engine, self, NULL);
   wasmtime_context_t *context = wasmtime_store_context(store);
   wasmtime_error_t *error = NULL;
@@ -626,6 +1040,16 @@ TSWasmStore *ts_wasm_store_new(TSWasmEngine *engine, TSWasmError *wasm_error) {
       callback__noop,
       wasm_functype_new_2_1(wasm_valtype_new_i32(), wasm_valtype_new_i32(), wasm_valtype_new_i32())
     },
+    {
+      &builtin_fn_indices.lexer_peek,
+      callback__lexer_peek,
+      wasm_functype_new_3_1(wasm_valtype_new_i32(), wasm_valtype_new_i32(), wasm_valtype_new_i32(), wasm_valtype_new_i32())
+    },
+    {
+      &builtin_fn_indices.lexer_advance_by,
+      callback__lexer_advance_by,
+      wasm_functype_new_3_1(wasm_valtype_new_i32(), wasm_valtype_new_i32(), wasm_valtype_new_i32(), wasm_valtype_new_i32())
+    },
   };
 
   // Create all of the wasm functions.
@@ -647,7 +1071,7 @@ TSWasmStore *ts_wasm_store_new(TSWasmEngine *engine, TSWasmError *wasm_error) {
   }
 
   // Compile the stdlib module.
-  error = wasmtime_module_new(engine, STDLIB_WASM, STDLIB_WASM_LEN, &stdlib_module);
+  error = ts_wasm_module_cache__compile(module_cache, engine, STDLIB_WASM, STDLIB_WASM_LEN, &stdlib_module);
   if (error) {
     wasmtime_error_message(error, &message);
     wasm_error->kind = TSWasmErrorKindCompile;
@@ -737,12 +1161,13 @@ TSWasmStore *ts_wasm_store_new(TSWasmEngine *engine, TSWasmError *wasm_error) {
     .memory = memory,
     .function_table = function_table,
     .language_instances = array_new(),
-    .stdlib_fn_indices = ts_calloc(stdlib_symbols_len, sizeof(uint32_t)),
+    .stdlib_fn_indices = ts_calloc_in(TSAllocationCategoryWasmStore, stdlib_symbols_len, sizeof(uint32_t)),
     .builtin_fn_indices = builtin_fn_indices,
     .stack_pointer_global = stack_pointer_global,
     .current_memory_offset = 0,
     .current_function_table_offset = 0,
     .const_i32_type = const_i32_type,
+    .module_cache = module_cache,
   };
 
   // Set up the imports for the stdlib module.
@@ -897,6 +1322,7 @@ TSWasmStore *ts_wasm_store_new(TSWasmEngine *engine, TSWasmError *wasm_error) {
 
   uint8_t *memory_data = wasmtime_memory_data(context, &memory);
   memcpy(&memory_data[self->lexer_address], &lexer, sizeof(lexer));
+  if (module_cache) atomic_inc(&module_cache->ref_count);
   return self;
 
 error:
@@ -914,6 +1340,14 @@ error:
   return NULL;
 }
 
+TSWasmStore *ts_wasm_store_new(TSWasmEngine *engine, TSWasmError *wasm_error) {
+  return ts_wasm_store__new(engine, NULL, wasm_error);
+}
+
+TSWasmStore *ts_wasm_store_new_with_cache(TSWasmModuleCache *cache, TSWasmError *wasm_error) {
+  return ts_wasm_store__new(cache->engine, cache, wasm_error);
+}
+
 void ts_wasm_store_delete(TSWasmStore *self) {
   if (!self) return;
   ts_free(self->stdlib_fn_indices);
@@ -925,6 +1359,7 @@ void ts_wasm_store_delete(TSWasmStore *self) {
     language_id_delete(instance->language_id);
   }
   array_delete(&self->language_instances);
+  if (self->module_cache) ts_wasm_module_cache__release(self->module_cache);
   ts_free(self);
 }
 
@@ -1161,8 +1596,15 @@ const TSLanguage *ts_wasm_store_load_language(
     goto error;
   }
 
-  // Compile the wasm code.
-  error = wasmtime_module_new(self->engine, (const uint8_t *)wasm, wasm_len, &module);
+  // Compile the wasm code, or reuse a module that was already compiled from the
+  // same code.
+  error = ts_wasm_module_cache__compile(
+    self->module_cache,
+    self->engine,
+    (const uint8_t *)wasm,
+    wasm_len,
+    &module
+  );
   if (error) {
     wasm_message_t message;
     wasmtime_error_message(error, &message);
@@ -1232,7 +1674,7 @@ const TSLanguage *ts_wasm_store_load_language(
   };
   uint32_t address_count = array_len(addresses);
 
-  TSLanguage *language = ts_calloc(1, sizeof(TSLanguage));
+  TSLanguage *language = ts_calloc_in(TSAllocationCategoryWasmStore, 1, sizeof(TSLanguage));
   StringData symbol_name_buffer = array_new();
   StringData field_name_buffer = array_new();
 
@@ -1359,11 +1801,13 @@ const TSLanguage *ts_wasm_store_load_language(
   }
 
   unsigned name_len = strlen(language_name);
-  char *name = ts_malloc(name_len + 1);
+  char *name = ts_malloc_in(TSAllocationCategoryWasmStore, name_len + 1);
   memcpy(name, language_name, name_len);
   name[name_len] = '\0';
 
-  LanguageWasmModule *language_module = ts_malloc(sizeof(LanguageWasmModule));
+  ts_set_allocation_category(symbol_name_buffer.contents, TSAllocationCategoryWasmStore);
+  ts_set_allocation_category(field_name_buffer.contents, TSAllocationCategoryWasmStore);
+  LanguageWasmModule *language_module = ts_malloc_in(TSAllocationCategoryWasmStore, sizeof(LanguageWasmModule));
   *language_module = (LanguageWasmModule) {
     .language_id = language_id_new(),
     .module = module,
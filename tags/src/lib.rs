@@ -6,22 +6,28 @@ use std::{
     char,
     collections::HashMap,
     ffi::{CStr, CString},
-    mem,
+    io, mem,
     ops::Range,
     os::raw::c_char,
     str,
-    sync::atomic::{AtomicUsize, Ordering},
+    sync::{
+        atomic::{AtomicBool, AtomicUsize, Ordering},
+        Mutex,
+    },
+    thread,
 };
 
-use memchr::memchr;
+use memchr::{memchr, memrchr};
 use regex::Regex;
 use thiserror::Error;
 use tree_sitter::{
-    Language, LossyUtf8, Parser, Point, Query, QueryCursor, QueryError, QueryPredicateArg, Tree,
+    InputEdit, Language, LossyUtf8, Node, Parser, Point, Query, QueryCursor, QueryError,
+    QueryMatches, QueryPredicateArg, Tree,
 };
 
 const MAX_LINE_LEN: usize = 180;
 const CANCELLATION_CHECK_INTERVAL: usize = 100;
+const PARALLEL_OUTPUT_FLUSH_LEN: usize = 64 * 1024;
 
 /// Contains the data needed to compute tags for code written in a
 /// particular language.
@@ -41,6 +47,11 @@ pub struct TagsConfiguration {
     pattern_info: Vec<PatternInfo>,
 }
 
+// The raw pointers in `c_syntax_type_names` point into `syntax_type_names`, which is never
+// modified after the configuration is created.
+unsafe impl Send for TagsConfiguration {}
+unsafe impl Sync for TagsConfiguration {}
+
 #[derive(Debug)]
 pub struct NamedCapture {
     pub syntax_type_id: u32,
@@ -52,7 +63,19 @@ pub struct TagsContext {
     cursor: QueryCursor,
 }
 
-#[derive(Debug, Clone)]
+/// Keeps the syntax tree and the tags of a document, so that after the document is edited,
+/// its tags can be updated by reparsing it incrementally and tagging only the top-level nodes
+/// that changed.
+#[derive(Default)]
+pub struct TagsSession {
+    tree: Option<Tree>,
+    tags: Vec<Tag>,
+    root_defs: Vec<Range<usize>>,
+    changed_range: Option<Range<usize>>,
+    retag_all: bool,
+}
+
+#[derive(Debug, Clone, PartialEq, Eq)]
 pub struct Tag {
     pub range: Range<usize>,
     pub name_range: Range<usize>,
@@ -84,11 +107,13 @@ struct PatternInfo {
     local_scope_inherits: bool,
     name_must_be_non_local: bool,
     doc_strip_regex: Option<Regex>,
+    is_rooted: bool,
 }
 
 #[derive(Debug)]
 struct LocalDef<'a> {
     name: &'a [u8],
+    range: Range<usize>,
 }
 
 #[derive(Debug)]
@@ -185,7 +210,10 @@ impl TagsConfiguration {
 
         let pattern_info = (0..query.pattern_count())
             .map(|pattern_index| {
-                let mut info = PatternInfo::default();
+                let mut info = PatternInfo {
+                    is_rooted: query.is_pattern_rooted(pattern_index),
+                    ..Default::default()
+                };
                 for (property, is_positive) in query.property_predicates(pattern_index) {
                     if !is_positive && property.key.as_ref() == "local" {
                         info.name_must_be_non_local = true;
@@ -279,41 +307,389 @@ impl TagsContext {
         source: &'a [u8],
         cancellation_flag: Option<&'a AtomicUsize>,
     ) -> Result<(impl Iterator<Item = Result<Tag, Error>> + 'a, bool), Error> {
+        let tree = self.parse(config, source, None, cancellation_flag)?;
+        let has_error = tree.root_node().has_error();
+        Ok((
+            self.tags_iter(
+                config,
+                source,
+                tree,
+                0..usize::MAX,
+                Vec::new(),
+                cancellation_flag,
+            ),
+            has_error,
+        ))
+    }
+
+    fn parse(
+        &mut self,
+        config: &TagsConfiguration,
+        source: &[u8],
+        old_tree: Option<&Tree>,
+        cancellation_flag: Option<&AtomicUsize>,
+    ) -> Result<Tree, Error> {
         self.parser
             .set_language(&config.language)
             .map_err(|_| Error::InvalidLanguage)?;
         self.parser.reset();
         unsafe { self.parser.set_cancellation_flag(cancellation_flag) };
-        let tree = self.parser.parse(source, None).ok_or(Error::Cancelled)?;
+        self.parser.parse(source, old_tree).ok_or(Error::Cancelled)
+    }
 
+    // Tag the part of the tree within `byte_range`, starting with the given definitions in the
+    // scope of the whole document.
+    fn tags_iter<'a>(
+        &'a mut self,
+        config: &'a TagsConfiguration,
+        source: &'a [u8],
+        tree: Tree,
+        byte_range: Range<usize>,
+        root_defs: Vec<LocalDef<'a>>,
+        cancellation_flag: Option<&'a AtomicUsize>,
+    ) -> TagsIter<'a, QueryMatches<'a, 'a, &'a [u8], &'a [u8]>> {
         // The `matches` iterator borrows the `Tree`, which prevents it from being
         // moved. But the tree is really just a pointer, so it's actually ok to
         // move it.
         let tree_ref = unsafe { mem::transmute::<&Tree, &'static Tree>(&tree) };
-        let matches = self
-            .cursor
-            .matches(&config.query, tree_ref.root_node(), source);
-        Ok((
-            TagsIter {
-                _tree: tree,
-                matches,
+        let matches = self.cursor.set_byte_range(byte_range).matches(
+            &config.query,
+            tree_ref.root_node(),
+            source,
+        );
+        TagsIter {
+            _tree: tree,
+            matches,
+            source,
+            config,
+            cancellation_flag,
+            prev_line_info: None,
+            tag_queue: Vec::new(),
+            iter_count: 0,
+            scopes: vec![LocalScope {
+                range: 0..source.len(),
+                inherits: false,
+                local_defs: root_defs,
+            }],
+        }
+    }
+}
+
+impl TagsSession {
+    #[must_use]
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// The tags from the last call to [`generate_tags`](Self::generate_tags).
+    #[must_use]
+    pub fn tags(&self) -> &[Tag] {
+        &self.tags
+    }
+
+    /// Record an edit to the document. This must be called for each edit made since the
+    /// last call to [`generate_tags`](Self::generate_tags), before calling it again.
+    pub fn edit(&mut self, edit: &InputEdit) {
+        let Some(tree) = &mut self.tree else {
+            return;
+        };
+        tree.edit(edit);
+
+        // Discard the tags that the edit touches, and move the ones after it. The lines that
+        // the edit touches are always tagged again.
+        self.tags.retain_mut(|tag| {
+            if tag.range.end <= edit.start_byte {
+                true
+            } else if tag.range.start >= edit.old_end_byte {
+                tag.edit(edit);
+                true
+            } else {
+                false
+            }
+        });
+        for def in &mut self.root_defs {
+            if def.start >= edit.old_end_byte {
+                *def = edited_byte(def.start, edit)..edited_byte(def.end, edit);
+            } else if def.end > edit.start_byte {
+                self.retag_all = true;
+            }
+        }
+
+        self.changed_range = Some(self.changed_range.as_ref().map_or(
+            edit.start_byte..edit.new_end_byte,
+            |range| {
+                range.start.min(edit.start_byte)
+                    ..edited_byte(range.end, edit).max(edit.new_end_byte)
+            },
+        ));
+    }
+
+    /// Update the tags of the document after it has been edited, or generate them if this is
+    /// the first call.
+    ///
+    /// Only the lines and the top-level nodes that changed are tagged again, along with the
+    /// nodes that patterns with several top-level nodes match together with them. The whole
+    /// document is tagged again when the change could affect tags elsewhere: when it adds or
+    /// removes a local definition that is not within any local scope, or when it is within a
+    /// local scope or a tag that spans several top-level nodes.
+    pub fn generate_tags(
+        &mut self,
+        context: &mut TagsContext,
+        config: &TagsConfiguration,
+        source: &[u8],
+        cancellation_flag: Option<&AtomicUsize>,
+    ) -> Result<&[Tag], Error> {
+        let tree = context.parse(config, source, self.tree.as_ref(), cancellation_flag)?;
+
+        let mut retagged = false;
+        if let (Some(old_tree), Some(changed_range), false) =
+            (&self.tree, &self.changed_range, self.retag_all)
+        {
+            let range =
+                old_tree
+                    .changed_ranges(&tree)
+                    .fold(changed_range.clone(), |range, changed| {
+                        range.start.min(changed.start_byte)..range.end.max(changed.end_byte)
+                    });
+            let window = tags_window(config, &tree, source, range);
+            retagged =
+                self.tag_window(context, config, source, &tree, window, cancellation_flag)?;
+        }
+        if !retagged {
+            let mut iter = context.tags_iter(
+                config,
                 source,
+                tree.clone(),
+                0..usize::MAX,
+                Vec::new(),
+                cancellation_flag,
+            );
+            self.tags = iter.by_ref().collect::<Result<_, _>>()?;
+            self.root_defs = iter.scopes[0]
+                .local_defs
+                .iter()
+                .map(|def| def.range.clone())
+                .collect();
+        }
+
+        self.tree = Some(tree);
+        self.changed_range = None;
+        self.retag_all = false;
+        Ok(&self.tags)
+    }
+
+    // Tag a window of the new tree again, and replace the previous tags within it. The
+    // window grows to contain any tag outside of it that changed, which patterns with several
+    // top-level nodes can produce. Returns false, leaving the tags unchanged, if tags outside
+    // of the window could have changed in another way.
+    fn tag_window(
+        &mut self,
+        context: &mut TagsContext,
+        config: &TagsConfiguration,
+        source: &[u8],
+        tree: &Tree,
+        mut window: Range<usize>,
+        cancellation_flag: Option<&AtomicUsize>,
+    ) -> Result<bool, Error> {
+        let root = tree.root_node();
+        loop {
+            let is_within =
+                |range: &Range<usize>| range.start >= window.start && range.end <= window.end;
+            let intersects =
+                |range: &Range<usize>| range.start < window.end && range.end > window.start;
+            if is_within(&(0..source.len())) || self.root_defs.iter().any(intersects) {
+                return Ok(false);
+            }
+
+            let root_defs = self
+                .root_defs
+                .iter()
+                .filter(|def| def.end <= window.start)
+                .map(|def| LocalDef {
+                    name: &source[def.clone()],
+                    range: def.clone(),
+                })
+                .collect::<Vec<_>>();
+            let root_def_count = root_defs.len();
+            let mut iter = context.tags_iter(
                 config,
+                source,
+                tree.clone(),
+                window.clone(),
+                root_defs,
                 cancellation_flag,
-                prev_line_info: None,
-                tag_queue: Vec::new(),
-                iter_count: 0,
-                scopes: vec![LocalScope {
-                    range: 0..source.len(),
-                    inherits: false,
-                    local_defs: Vec::new(),
-                }],
-            },
-            tree_ref.root_node().has_error(),
-        ))
+            );
+            let mut tags = iter.by_ref().collect::<Result<Vec<_>, _>>()?;
+            if iter.scopes[0].local_defs.len() > root_def_count
+                || iter.scopes[1..]
+                    .iter()
+                    .any(|scope| intersects(&scope.range) && !is_within(&scope.range))
+            {
+                return Ok(false);
+            }
+
+            let mut widened = window.clone();
+            tags.retain(|tag| {
+                if is_within(&tag.range) {
+                    return true;
+                }
+                let i = self
+                    .tags
+                    .partition_point(|old| old.name_range.start < tag.name_range.start);
+                if self.tags.get(i) != Some(tag) {
+                    widened.start = widened.start.min(tag.range.start);
+                    widened.end = widened.end.max(tag.range.end);
+                }
+                false
+            });
+            if widened == window {
+                let start = self
+                    .tags
+                    .partition_point(|tag| tag.name_range.start < window.start);
+                let end = self
+                    .tags
+                    .partition_point(|tag| tag.name_range.start < window.end);
+                self.tags.splice(start..end, tags);
+                return Ok(true);
+            }
+            window = widen_to_top_level_nodes(root, source, widened);
+        }
+    }
+}
+
+// Find the part of a document to tag again after an edit: the lines and the top-level nodes
+// that contain the changed range. If some patterns match several top-level nodes, the node
+// after them is included too, as its tags can depend on the nodes before it.
+fn tags_window(
+    config: &TagsConfiguration,
+    tree: &Tree,
+    source: &[u8],
+    range: Range<usize>,
+) -> Range<usize> {
+    let root = tree.root_node();
+    let window = widen_to_top_level_nodes(root, source, range);
+    if config.pattern_info.iter().all(|info| info.is_rooted) {
+        return window;
+    }
+    root.first_child_for_byte(window.end)
+        .map_or(window.clone(), |next| {
+            widen_to_top_level_nodes(root, source, window.start..next.end_byte())
+        })
+}
+
+// Widen a range to whole lines and to whole children of the root node.
+fn widen_to_top_level_nodes(root: Node, source: &[u8], range: Range<usize>) -> Range<usize> {
+    let mut range = range.start.min(source.len())..range.end.min(source.len());
+    loop {
+        let mut widened = range.clone();
+        widened.start = memrchr(b'\n', &source[..range.start]).map_or(0, |i| i + 1);
+        if range.is_empty() || source[range.end - 1] != b'\n' {
+            widened.end =
+                memchr(b'\n', &source[range.end..]).map_or(source.len(), |i| range.end + i + 1);
+        }
+        if let Some(child) = root.first_child_for_byte(widened.start) {
+            widened.start = widened.start.min(child.start_byte());
+        }
+        if let Some(child) = root.first_child_for_byte(widened.end.saturating_sub(1)) {
+            if child.start_byte() < widened.end {
+                widened.end = widened.end.max(child.end_byte());
+            }
+        }
+        if widened == range {
+            return range;
+        }
+        range = widened;
     }
 }
 
+/// Generate the tags of many documents on `thread_count` threads, which share the
+/// configurations, but each use their own [`TagsContext`].
+///
+/// * `load` - Called on the worker threads to get the configuration and the source code of a
+///   document, or `None` to skip the document.
+/// * `write` - Called with each document's tags, or the error that stopped its tagging, to
+///   write its output to a buffer of the thread that tagged it.
+///
+/// The buffers are written to `output` whenever they grow large, and always between the
+/// output of two documents, so the output of each document stays together, but the
+/// documents may be written in any order. Tagging stops early if the cancellation flag is
+/// set, or if writing fails.
+pub fn generate_tags_in_parallel<'c, D, W, L, F>(
+    documents: &[D],
+    thread_count: usize,
+    cancellation_flag: Option<&AtomicUsize>,
+    output: &Mutex<W>,
+    load: L,
+    write: F,
+) -> io::Result<()>
+where
+    D: Sync,
+    W: io::Write + Send,
+    L: Fn(&D) -> Option<(&'c TagsConfiguration, Vec<u8>)> + Sync,
+    F: Fn(&mut Vec<u8>, &D, &TagsConfiguration, &[u8], Result<&[Tag], Error>) -> io::Result<()>
+        + Sync,
+{
+    let next_index = AtomicUsize::new(0);
+    let failed = AtomicBool::new(false);
+    let flush = |buffer: &mut Vec<u8>| {
+        let result = output.lock().unwrap().write_all(buffer);
+        buffer.clear();
+        result
+    };
+    let work = || -> io::Result<()> {
+        let mut context = TagsContext::new();
+        let mut tags = Vec::new();
+        let mut buffer = Vec::new();
+        while cancellation_flag.map_or(true, |flag| flag.load(Ordering::Relaxed) == 0)
+            && !failed.load(Ordering::Relaxed)
+        {
+            let Some(document) = documents.get(next_index.fetch_add(1, Ordering::Relaxed)) else {
+                break;
+            };
+            let Some((config, source)) = load(document) else {
+                continue;
+            };
+            tags.clear();
+            let result = context
+                .generate_tags(config, &source, cancellation_flag)
+                .and_then(|(iter, _)| {
+                    for tag in iter {
+                        tags.push(tag?);
+                    }
+                    Ok(())
+                });
+            let result = write(
+                &mut buffer,
+                document,
+                config,
+                &source,
+                result.map(|()| tags.as_slice()),
+            )
+            .and_then(|()| {
+                if buffer.len() >= PARALLEL_OUTPUT_FLUSH_LEN {
+                    flush(&mut buffer)
+                } else {
+                    Ok(())
+                }
+            });
+            if result.is_err() {
+                failed.store(true, Ordering::Relaxed);
+                return result;
+            }
+        }
+        flush(&mut buffer)
+    };
+
+    thread::scope(|scope| {
+        let workers = (0..thread_count.max(1))
+            .map(|_| scope.spawn(work))
+            .collect::<Vec<_>>();
+        workers
+            .into_iter()
+            .try_for_each(|worker| worker.join().unwrap())
+    })
+}
+
 impl<'a, I> Iterator for TagsIter<'a, I>
 where
     I: Iterator<Item = tree_sitter::QueryMatch<'a, 'a>>,
@@ -369,6 +745,7 @@ where
                             }) {
                                 scope.local_defs.push(LocalDef {
                                     name: &self.source[range.clone()],
+                                    range,
                                 });
                             }
                         }
@@ -587,6 +964,39 @@ impl Tag {
     const fn is_ignored(&self) -> bool {
         self.range.start == usize::MAX
     }
+
+    // Move a tag that is after an edit. Its columns only change if it is on the line where
+    // the edit ends, and then it is tagged again.
+    fn edit(&mut self, edit: &InputEdit) {
+        for range in [&mut self.range, &mut self.name_range, &mut self.line_range] {
+            *range = edited_byte(range.start, edit)..edited_byte(range.end, edit);
+        }
+        self.span = edited_point(self.span.start, edit)..edited_point(self.span.end, edit);
+    }
+}
+
+fn edited_byte(byte: usize, edit: &InputEdit) -> usize {
+    if byte >= edit.old_end_byte {
+        byte - edit.old_end_byte + edit.new_end_byte
+    } else {
+        byte.min(edit.new_end_byte)
+    }
+}
+
+fn edited_point(point: Point, edit: &InputEdit) -> Point {
+    if point < edit.old_end_position {
+        point.min(edit.new_end_position)
+    } else if point.row == edit.old_end_position.row {
+        Point::new(
+            edit.new_end_position.row,
+            point.column - edit.old_end_position.column + edit.new_end_position.column,
+        )
+    } else {
+        Point::new(
+            point.row - edit.old_end_position.row + edit.new_end_position.row,
+            point.column,
+        )
+    }
 }
 
 fn line_range(
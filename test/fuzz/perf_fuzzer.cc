@@ -0,0 +1,116 @@
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include "tree_sitter/api.h"
+
+// A fuzzer that looks for inputs that are pathologically expensive, rather
+// than ones that crash. It counts the operations performed while parsing each
+// input and while running the language's query on the resulting tree, and
+// aborts if either cost per byte exceeds a multiple of a baseline, so that
+// libFuzzer saves the input and can minimize it.
+//
+// The limits are read from the environment:
+//   TS_PERF_PARSE_BASELINE - parse operations per byte of a typical input.
+//   TS_PERF_QUERY_BASELINE - query operations per byte of a typical input.
+//   TS_PERF_MULTIPLE       - the multiple of the baseline that is too slow.
+//   TS_PERF_MIN_BYTES      - inputs shorter than this are never flagged.
+// The `tree-sitter fuzz-perf` command measures the baselines on a grammar's
+// corpus, and writes them in this form alongside the inputs that it flags.
+
+extern "C" const TSLanguage *TS_LANG();
+
+static TSQuery *lang_query;
+static double parse_limit;
+static double query_limit;
+static size_t min_bytes;
+
+static double env_double(const char *name, double default_value) {
+  const char *value = getenv(name);
+  return value ? strtod(value, nullptr) : default_value;
+}
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv) {
+  if(TS_LANG_QUERY_FILENAME[0]) {
+    // The query filename is relative to the fuzzing binary. Convert it
+    // to an absolute path first
+    auto binary_filename = std::string((*argv)[0]);
+    auto binary_directory = binary_filename.substr(0, binary_filename.find_last_of("\\/"));
+    auto lang_query_filename = binary_directory + "/" + TS_LANG_QUERY_FILENAME;
+
+    auto f = std::ifstream(lang_query_filename);
+    assert(f.good());
+    std::string lang_query_source((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+    uint32_t error_offset = 0;
+    TSQueryError error_type = TSQueryErrorNone;
+
+    lang_query = ts_query_new(
+      TS_LANG(),
+      lang_query_source.c_str(),
+      lang_query_source.size(),
+      &error_offset,
+      &error_type
+    );
+
+    assert(lang_query);
+  }
+
+  double multiple = env_double("TS_PERF_MULTIPLE", 10);
+  parse_limit = env_double("TS_PERF_PARSE_BASELINE", 0) * multiple;
+  query_limit = env_double("TS_PERF_QUERY_BASELINE", 0) * multiple;
+  min_bytes = (size_t)env_double("TS_PERF_MIN_BYTES", 32);
+  if (parse_limit <= 0) {
+    fprintf(stderr, "TS_PERF_PARSE_BASELINE must be set to a positive number of operations per byte\n");
+    exit(1);
+  }
+
+  return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  const char *str = reinterpret_cast<const char *>(data);
+
+  TSParser *parser = ts_parser_new();
+
+  // This can fail if the language version doesn't match the runtime version
+  bool language_ok = ts_parser_set_language(parser, TS_LANG());
+  assert(language_ok);
+
+  ts_parser_set_stats_enabled(parser, true);
+  TSTree *tree = ts_parser_parse_string(parser, NULL, str, size);
+  TSNode root_node = ts_tree_root_node(tree);
+  double byte_count = size ? (double)size : 1;
+  double parse_cost = (double)ts_parser_stats(parser).operation_count / byte_count;
+
+  double query_cost = 0;
+  if (lang_query != nullptr) {
+    TSQueryCursor *cursor = ts_query_cursor_new();
+
+    ts_query_cursor_exec(cursor, lang_query, root_node);
+    TSQueryMatch match;
+    uint32_t capture_index;
+    while (ts_query_cursor_next_capture(cursor, &match, &capture_index)) {
+    }
+    query_cost = (double)ts_query_cursor_operation_count(cursor) / byte_count;
+
+    ts_query_cursor_delete(cursor);
+  }
+
+  ts_tree_delete(tree);
+  ts_parser_delete(parser);
+
+  if (size >= min_bytes) {
+    if (parse_cost > parse_limit) {
+      fprintf(stderr, "Parsing took %.2f operations per byte, more than the limit of %.2f\n", parse_cost, parse_limit);
+      abort();
+    }
+    if (query_limit > 0 && query_cost > query_limit) {
+      fprintf(stderr, "Querying took %.2f operations per byte, more than the limit of %.2f\n", query_cost, query_limit);
+      abort();
+    }
+  }
+
+  return 0;
+}
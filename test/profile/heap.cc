@@ -11,7 +11,40 @@ extern "C" {
 #define LANGUAGE tree_sitter_javascript
 #define SOURCE_PATH "javascript/examples/jquery.js"
 
+static const char *CATEGORY_NAMES[] = {
+  "other",
+  "subtree pool",
+  "stack nodes",
+  "included ranges",
+  "query cursor states",
+  "query capture lists",
+  "wasm store",
+};
+
+static void print_allocation_stats() {
+  for (unsigned i = 0; i < sizeof(CATEGORY_NAMES) / sizeof(CATEGORY_NAMES[0]); i++) {
+    TSAllocationStats stats = ts_allocation_stats((TSAllocationCategory)i);
+    printf(
+      "  %-20s live: %10zu bytes in %8zu blocks, peak: %10zu bytes\n",
+      CATEGORY_NAMES[i],
+      stats.live_bytes,
+      stats.live_allocation_count,
+      stats.peak_bytes
+    );
+  }
+  TSAllocationStats total = ts_allocation_total_stats();
+  printf(
+    "  %-20s live: %10zu bytes in %8zu blocks, peak: %10zu bytes\n",
+    "total",
+    total.live_bytes,
+    total.live_allocation_count,
+    total.peak_bytes
+  );
+}
+
 int main() {
+  ts_set_allocation_tracking(true);
+
   TSParser *parser = ts_parser_new();
   if (!ts_parser_set_language(parser, LANGUAGE())) {
     fprintf(stderr, "Invalid language\n");
@@ -39,4 +72,10 @@ int main() {
     source_code.c_str(),
     source_code.size()
   );
+
+  printf("Allocations after parsing:\n");
+  print_allocation_stats();
+
+  ts_tree_delete(tree);
+  ts_parser_delete(parser);
 }